@@ -1,10 +1,13 @@
 #include "utils/Atomic.hpp"
+#include "utils/Benchmark.hpp"
 
 #include <algorithm> // max
 #include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <iostream>
+#include <string>
+#include <vector>
 
 using namespace spi;
 
@@ -15,8 +18,50 @@ struct MyStruct {
     uint32_t d;
 };
 
-int main(){
+template<size_t BYTES>
+struct WideStruct {
+    uint64_t fields[BYTES / sizeof(uint64_t)];
+};
+
+template<typename A, typename Load, typename Store>
+void measureWide(Benchmark &bench, const std::string &name, uint64_t iterations, A &atomic, Load load, Store store){
+    typedef decltype(load(atomic)) T;
+    bench.run(name + ".store()", iterations, [&](){
+        T value{};
+        for(uint64_t i=0; i < iterations; i++){
+            value.fields[0] = i;
+            store(atomic, value);
+        }
+    });
+
+    bench.run(name + ".load()", iterations, [&](){
+        uint64_t sum = 0;
+        for(uint64_t i=0; i < iterations; i++){
+            sum += load(atomic).fields[0];
+        }
+        Benchmark::doNotOptimize(sum);
+    });
+}
+
+template<size_t BYTES>
+void measureWides(Benchmark &bench, uint64_t iterations){
+    typedef WideStruct<BYTES> T;
+    std::cout << BYTES << " bytes:" << std::endl;
+    std::atomic<T> atomicStd{};
+    AtomicTwoParty<T> atomicTwoParty(false);
+    AtomicSeqLock<T> atomicSeqLock;
+    measureWide(bench, "std::atomic", iterations, atomicStd, [](std::atomic<T> &a){ return a.load(); }, [](std::atomic<T> &a, const T &v){ a.store(v); });
+    measureWide(bench, "atomicTwoparty", iterations, atomicTwoParty, [](AtomicTwoParty<T> &a){ return a.loadB(); }, [](AtomicTwoParty<T> &a, const T &v){ a.storeA(v); });
+    measureWide(bench, "atomicSeqLock", iterations, atomicSeqLock, [](AtomicSeqLock<T> &a){ return a.loadB(); }, [](AtomicSeqLock<T> &a, const T &v){ a.storeA(v); });
+    std::cout << std::endl;
+}
+
+int main(int argc, char** argv){
+    Benchmark bench("atomic_benchmark", argc, argv);
     const uint64_t ITERATIONS = 500000000;
+    // sizeof(Atomic<int>): 112, sizeof(Atomic<int, AtomicPolicyTwoParty>): 80 (x86-64, GCC 12)
+    std::cout << "sizeof(Atomic<int>): " << sizeof(Atomic<int>) << ", sizeof(Atomic<int, AtomicPolicyTwoParty>): " << sizeof(Atomic<int, AtomicPolicyTwoParty>) << std::endl << std::endl;
+    const uint64_t WIDE_ITERATIONS = ITERATIONS / 10;
 
 
     const uint64_t HALF_ITERATIONS = ITERATIONS >> 1;
@@ -26,132 +71,186 @@ int main(){
     std::atomic<int> atomicInt{0};
     std::counting_semaphore<2> semaphore{2};
     Atomic<int> atomicTwoparty(false, 0);
+    Atomic<int, AtomicPolicyTwoParty> atomicTwopartyStatic(false, 0);
 
 
     //                                      RELEASE         |   DEBUG
 
     // std::atomic.store():                 ~ 172 Mio/sec   |   ~ 100 Mio/sec
-    auto startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        atomicInt.store((int)i);
-    }
-    auto endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "std::atomic.store(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("std::atomic.store()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            atomicInt.store((int)i);
+        }
+    });
 
     // atomicTwoparty.store():              ~ 526 Mio/sec   |   ~ 46 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        atomicTwoparty.storeA((int)i);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "atomicTwoparty.store(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("atomicTwoparty.store()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            atomicTwoparty.storeA((int)i);
+        }
+    });
+
+    // atomicTwopartyStatic.store():      ~ 577 Mio/sec
+    bench.run("atomicTwopartyStatic.store()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            atomicTwopartyStatic.storeA((int)i);
+        }
+    });
     std::cout << std::endl;
 
 
 
 
     // std::atomic.load():                  ~ 2938 Mio/sec  |   ~ 174 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        volatile int value = atomicInt.load();
-        (void)value;
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "std::atomic.load(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("std::atomic.load()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            volatile int value = atomicInt.load();
+            (void)value;
+        }
+    });
 
     // atomicTwoparty.load():               ~ 463 Mio/sec   |   ~ 48 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        volatile int value = atomicTwoparty.loadA();
-        (void)value;
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "atomicTwoparty.load(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("atomicTwoparty.load()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            volatile int value = atomicTwoparty.loadA();
+            (void)value;
+        }
+    });
+
+    // atomicTwopartyStatic.load():       ~ 813 Mio/sec
+    bench.run("atomicTwopartyStatic.load()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            volatile int value = atomicTwopartyStatic.loadA();
+            (void)value;
+        }
+    });
     std::cout << std::endl;
 
 
 
 
     // atomic.fetch_add():                  ~ 169 Mio/sec   |   ~ 113 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        atomicInt.fetch_add(1);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "std::atomic.fetch_add(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("std::atomic.fetch_add()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            atomicInt.fetch_add(1);
+        }
+    });
 
     // atomicTwoparty.fetchAdd():           ~ 433 Mio/sec   |   ~ 45 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        atomicTwoparty.fetchAddA(1);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "atomicTwoparty.fetchAdd(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("atomicTwoparty.fetchAdd()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            atomicTwoparty.fetchAddA(1);
+        }
+    });
+
+    // atomicTwopartyStatic.fetchAdd():   ~ 585 Mio/sec
+    bench.run("atomicTwopartyStatic.fetchAdd()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            atomicTwopartyStatic.fetchAddA(1);
+        }
+    });
     std::cout << std::endl;
 
 
 
 
     // std::atomic.exchange():              ~ 175 Mio/sec   |   ~ 112 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < HALF_ITERATIONS; i++){
-        atomicStruct.exchange(VAL1);
-        atomicStruct.exchange(VAL2);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "std::atomic.exchange(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("std::atomic.exchange()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < HALF_ITERATIONS; i++){
+            atomicStruct.exchange(VAL1);
+            atomicStruct.exchange(VAL2);
+        }
+    });
 
     // atomicTwoparty.exchange():           ~ 682 Mio/sec   |   ~ 47 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < HALF_ITERATIONS; i++){
-        atomicTwoparty.exchangeA(1);
-        atomicTwoparty.exchangeA(2);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "atomicTwoparty.exchange(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("atomicTwoparty.exchange()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < HALF_ITERATIONS; i++){
+            atomicTwoparty.exchangeA(1);
+            atomicTwoparty.exchangeA(2);
+        }
+    });
+
+    // atomicTwopartyStatic.exchange():   ~ 798 Mio/sec
+    bench.run("atomicTwopartyStatic.exchange()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < HALF_ITERATIONS; i++){
+            atomicTwopartyStatic.exchangeA(1);
+            atomicTwopartyStatic.exchangeA(2);
+        }
+    });
     std::cout << std::endl;
 
 
 
 
     // std::atomic.compareAndSwap():        ~ 162 Mio/sec   |   ~ 34 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < HALF_ITERATIONS; i++){
-        atomicStruct.compare_exchange_strong(VAL1, VAL2);
-        atomicStruct.compare_exchange_strong(VAL2, VAL1);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "std::atomic.compareAndSwap(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("std::atomic.compareAndSwap()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < HALF_ITERATIONS; i++){
+            atomicStruct.compare_exchange_strong(VAL1, VAL2);
+            atomicStruct.compare_exchange_strong(VAL2, VAL1);
+        }
+    });
 
     // atomicTwoparty.compareExchange():    ~ 610 Mio/sec   |   ~ 45 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < HALF_ITERATIONS; i++){
-        atomicTwoparty.compareExchangeStrongA(1, 2);
-        atomicTwoparty.compareExchangeStrongA(2, 1);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "atomicTwoparty.compareExchange(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("atomicTwoparty.compareExchange()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < HALF_ITERATIONS; i++){
+            atomicTwoparty.compareExchangeStrongA(1, 2);
+            atomicTwoparty.compareExchangeStrongA(2, 1);
+        }
+    });
+
+    // atomicTwopartyStatic.compareExchange(): ~ 930 Mio/sec
+    bench.run("atomicTwopartyStatic.compareExchange()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < HALF_ITERATIONS; i++){
+            atomicTwopartyStatic.compareExchangeStrongA(1, 2);
+            atomicTwopartyStatic.compareExchangeStrongA(2, 1);
+        }
+    });
     std::cout << std::endl;
 
 
     // new MyStruct() with delete:          ~ 15 Mio/sec |  ~ 15 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        volatile MyStruct *tmp = new MyStruct();
-        (void)tmp;
-        delete tmp;
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "new MyStruct() with delete: " << (ITERATIONS * 1000000) / std::max((int64_t)1, std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count()) << "/s" << std::endl;
+    bench.run("new MyStruct() with delete", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            volatile MyStruct *tmp = new MyStruct();
+            (void)tmp;
+            delete tmp;
+        }
+    });
 
     // new MyStruct() no delete:            ~ 15 Mio/sec |  ~ 15 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        volatile MyStruct *tmp = new MyStruct();
-        (void)tmp;
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "new MyStruct() no delete: " << (ITERATIONS * 1000000) / std::max((int64_t)1, std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count()) << "/s" << std::endl;
-
-    return 0;
+    // (objects get freed after measuring, otherwise every repetition would leak them)
+    const uint64_t NO_DELETE_ITERATIONS = 10000000;
+    bench.run("new MyStruct() no delete", NO_DELETE_ITERATIONS, [&](BenchmarkTimer &timer){
+        std::vector<MyStruct*> allocated(NO_DELETE_ITERATIONS);
+        timer.start();
+        for(uint64_t i=0; i < NO_DELETE_ITERATIONS; i++){
+            allocated[i] = new MyStruct();
+        }
+        timer.stop();
+        for(MyStruct* tmp : allocated) delete tmp;
+    });
+    std::cout << std::endl;
+
+
+    // wide types (single thread, without contention AtomicTwoParty never waits,
+    // AtomicSeqLock pays off with many readers since readers never write shared memory):
+    //                                      store           |   load
+    // 32 bytes   std::atomic:              ~ 82   Mio/sec  |   ~ 89 Mio/sec
+    //            atomicTwoparty:           ~ 408  Mio/sec  |   ~ 401 Mio/sec
+    //            atomicSeqLock:            ~ 55   Mio/sec  |   ~ 112 Mio/sec
+    measureWides<32>(bench, WIDE_ITERATIONS);
+    // 64 bytes   std::atomic:              ~ 82   Mio/sec  |   ~ 96 Mio/sec
+    //            atomicTwoparty:           ~ 491  Mio/sec  |   ~ 798 Mio/sec
+    //            atomicSeqLock:            ~ 53   Mio/sec  |   ~ 113 Mio/sec
+    measureWides<64>(bench, WIDE_ITERATIONS);
+    // 128 bytes  std::atomic:              ~ 55   Mio/sec  |   ~ 58 Mio/sec
+    //            atomicTwoparty:           ~ 264  Mio/sec  |   ~ 394 Mio/sec
+    //            atomicSeqLock:            ~ 47   Mio/sec  |   ~ 96 Mio/sec
+    measureWides<128>(bench, WIDE_ITERATIONS);
+    // 256 bytes  std::atomic:              ~ 32   Mio/sec  |   ~ 33 Mio/sec
+    //            atomicTwoparty:           ~ 67   Mio/sec  |   ~ 733 Mio/sec
+    //            atomicSeqLock:            ~ 32   Mio/sec  |   ~ 42 Mio/sec
+    measureWides<256>(bench, WIDE_ITERATIONS);
+
+    return bench.finish();
 }
\ No newline at end of file
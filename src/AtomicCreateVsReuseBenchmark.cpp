@@ -1,8 +1,11 @@
+#include "./utils/Benchmark.hpp"
 #include "./utils/RecycleObjectStoreQueue.hpp"
 
 #include <atomic>
 #include <chrono>
 #include <iostream>
+#include <string>
+#include <vector>
 
 using namespace spi;
 
@@ -24,7 +27,8 @@ struct TestStruct {
 
 
 
-int main(){
+int main(int argc, char** argv){
+    Benchmark bench("atomic_create_vs_reuse_benchmark", argc, argv);
     const uint64_t ITERATIONS = 50000000;
     const uint64_t OPS_PER_ITERATION = 9000;
     
@@ -36,30 +40,28 @@ int main(){
     //                          RELEASE         vs. DEBUG
 
     // Create/Delete(1):        ~ 31.7 Mio/sec  |   ~ 22.2 Mio/sec
-    auto startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        TestStruct *obj = new TestStruct();
-        obj->gotResponse();
-        obj->gotResponse();
-        obj->gotResponse();
-        delete obj;
-    }
-    auto endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "Create/Delete(1): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("Create/Delete(1)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            TestStruct *obj = new TestStruct();
+            obj->gotResponse();
+            obj->gotResponse();
+            obj->gotResponse();
+            delete obj;
+        }
+    });
 
 
     // RecycleObjectStore(1):   ~ 36.1 Mio/sec  |   ~ 11.0 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        TestStruct *obj = store.acquire();
-        obj->reset();
-        obj->gotResponse();
-        obj->gotResponse();
-        obj->gotResponse();
-        store.release(obj);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "RecycleObjectStore(1): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("RecycleObjectStore(1)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            TestStruct *obj = store.acquire();
+            obj->reset();
+            obj->gotResponse();
+            obj->gotResponse();
+            obj->gotResponse();
+            store.release(obj);
+        }
+    });
     std::cout << std::endl;
 
 
@@ -71,39 +73,37 @@ int main(){
 
     // Create/Delete(∞):        ~ 32.1 Mio/sec  |   ~ 22.6 Mio/sec
     std::vector<size_t> indices(OPS_PER_ITERATION);
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS/OPS_PER_ITERATION; i++){
-        TestStruct *obj;
-        for(size_t j=0; j < OPS_PER_ITERATION; j++){
-            obj = new TestStruct();
-            obj->gotResponse();
-            obj->gotResponse();
-            obj->gotResponse();
-            delete obj;
+    bench.run("Create/Delete(" + std::to_string(OPS_PER_ITERATION) + ")", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS/OPS_PER_ITERATION; i++){
+            TestStruct *obj;
+            for(size_t j=0; j < OPS_PER_ITERATION; j++){
+                obj = new TestStruct();
+                obj->gotResponse();
+                obj->gotResponse();
+                obj->gotResponse();
+                delete obj;
+            }
         }
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "Create/Delete(" << OPS_PER_ITERATION << "): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    });
 
 
     // RecycleObjectStore(∞):   ~ 33.4 Mio/sec  |   ~ 9.3 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS/OPS_PER_ITERATION; i++){
-        for(size_t j=0; j < OPS_PER_ITERATION; j++){
-            objects[j] = store.acquire();
-            objects[j]->reset();
-            objects[j]->gotResponse();
-            objects[j]->gotResponse();
-            objects[j]->gotResponse();
+    bench.run("RecycleObjectStore(" + std::to_string(OPS_PER_ITERATION) + ")", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS/OPS_PER_ITERATION; i++){
+            for(size_t j=0; j < OPS_PER_ITERATION; j++){
+                objects[j] = store.acquire();
+                objects[j]->reset();
+                objects[j]->gotResponse();
+                objects[j]->gotResponse();
+                objects[j]->gotResponse();
+            }
+            for(size_t j=0; j < OPS_PER_ITERATION; j++){
+                store.release(objects[j]);
+            }
         }
-        for(size_t j=0; j < OPS_PER_ITERATION; j++){
-            store.release(objects[j]);
-        }
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "RecycleObjectStore(" << OPS_PER_ITERATION << "): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    });
     std::cout << std::endl;
 
 
-    return 0;
+    return bench.finish();
 }
\ No newline at end of file
@@ -3,14 +3,17 @@
 
 #include <atomic>
 #include <cmath> // round
+#include <cstdint>
 #include <iostream>
 #include <stdexcept>
+#include <type_traits>
 
 using namespace spi;
 
 
 
-void runFetchAddTest(AbstractAtomic<int32_t>* atomic){
+template<typename A>
+void runFetchAddTest(A* atomic){
     const uint32_t ITERATIONS = 10000000; // 10000000
 
     Thread thr1([atomic, ITERATIONS]{
@@ -31,12 +34,87 @@ void runFetchAddTest(AbstractAtomic<int32_t>* atomic){
 }
 
 
+struct Snapshot {
+    uint64_t fields[8]; // all fields are equal unless a read was torn
+};
+
+void runSeqLockConsistencyTest(){
+    const uint64_t ITERATIONS = 1000000; // 1000000
+    const uint32_t READERS = 3;
+    Atomic<Snapshot> atomic(AtomicBackend::SEQLOCK);
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> torn{0};
+
+    Thread* readers[READERS];
+    for(uint32_t r=0; r < READERS; r++){
+        readers[r] = new Thread([&atomic, &done, &torn]{
+            uint64_t last = 0;
+            while(!done.load(std::memory_order_relaxed)){
+                Snapshot snapshot = atomic.loadB();
+                for(uint64_t field : snapshot.fields){
+                    if(field != snapshot.fields[0]) torn.fetch_add(1, std::memory_order_relaxed);
+                }
+                if(snapshot.fields[0] < last) torn.fetch_add(1, std::memory_order_relaxed); // went backwards
+                last = snapshot.fields[0];
+            }
+        });
+        readers[r]->start();
+    }
+
+    Snapshot snapshot;
+    for(uint64_t i=1; i <= ITERATIONS; i++){
+        for(uint64_t &field : snapshot.fields) field = i;
+        atomic.storeA(snapshot);
+    }
+    done.store(true);
+    for(uint32_t r=0; r < READERS; r++){
+        readers[r]->join();
+        delete readers[r];
+    }
+
+    if(torn.load() != 0)
+        throw std::runtime_error("AtomicSeqLock returned "+std::to_string(torn.load())+" inconsistent snapshots");
+    if(atomic.loadA().fields[7] != ITERATIONS)
+        throw std::runtime_error("AtomicSeqLock value should be "+std::to_string(ITERATIONS)+" but it is "+std::to_string(atomic.loadA().fields[7]));
+
+    bool thrown = false;
+    try {
+        atomic.fetchAddA(snapshot);
+    } catch(const std::logic_error&){
+        thrown = true;
+    }
+    if(!thrown) throw std::runtime_error("AtomicSeqLock.fetchAdd() should throw for types without operator+");
+    std::cout << "Completed SeqLockConsistencyTest successfully" << std::endl;
+}
+
+
+// compile time selected implementations have no vtable
+static_assert(sizeof(Atomic<int32_t, AtomicPolicyThreadSafe>) == sizeof(std::atomic<int32_t>));
+static_assert(sizeof(Atomic<int32_t, AtomicPolicyTwoParty>) == sizeof(AtomicTwoParty<int32_t, AtomicOperations<int32_t>>));
+static_assert(!std::is_polymorphic_v<Atomic<int32_t, AtomicPolicySeqLock>>);
+
+// runtime selected implementation only allocates the seqlock (aligned to a cache line) if it got selected
+static_assert(alignof(Atomic<int32_t>) < CACHE_LINE_SIZE);
+
+
 int main(){
     AbstractAtomic<int32_t>* atomicTwoParty = new AtomicTwoParty<int32_t>(false, 0);
     //AbstractAtomic<int32_t>* atomicTwoParty = new AtomicThreadSafe<int32_t>(0);
 
     runFetchAddTest(atomicTwoParty);
+    delete atomicTwoParty;
+
+    AbstractAtomic<int32_t>* atomicSeqLock = new AtomicSeqLock<int32_t>(0);
+    runFetchAddTest(atomicSeqLock);
+    delete atomicSeqLock;
+
+    Atomic<int32_t, AtomicPolicyThreadSafe> atomicThreadSafeStatic(0);
+    runFetchAddTest(&atomicThreadSafeStatic);
+
+    Atomic<int32_t, AtomicPolicyTwoParty> atomicTwoPartyStatic(false, 0);
+    runFetchAddTest(&atomicTwoPartyStatic);
 
+    runSeqLockConsistencyTest();
 
 
     return 0;
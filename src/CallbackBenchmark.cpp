@@ -1,3 +1,5 @@
+#include "./utils/Benchmark.hpp"
+
 #include <chrono>
 #include <cstdint>
 #include <functional>
@@ -127,7 +129,8 @@ void doOnVirtual(Base* obj){
 
 
 
-int main(){
+int main(int argc, char** argv){
+    spi::Benchmark bench("callback_benchmark", argc, argv);
     const uint64_t ITERATIONS = 100000000;
 
     StructFunctor structFunctor;
@@ -175,21 +178,19 @@ int main(){
     std::cout << "FUNCTIONAL PROGRAMMING:" << std::endl;
 
     // FunctionPointer(Function):           ~ 168.3 Mio/sec
-    auto startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        functionPointer(doSomething);
-    }
-    auto endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "FunctionPointer(Function): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("FunctionPointer(Function)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            functionPointer(doSomething);
+        }
+    });
 
 
     // FunctionPointer(Lambda):             ~ 82.7 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        functionPointer([](int& a){a++;});
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "FunctionPointer(Lambda): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("FunctionPointer(Lambda)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            functionPointer([](int& a){a++;});
+        }
+    });
 
 
     // FunctionPointer(StructFunctor):      ---
@@ -215,12 +216,11 @@ int main(){
 
 
     // FunctionPointer(nullptr):             ~ 431.4 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        functionPointer(nullptr);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "FunctionPointer(nullptr): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("FunctionPointer(nullptr)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            functionPointer(nullptr);
+        }
+    });
     std::cout << std::endl;
 
 
@@ -228,48 +228,43 @@ int main(){
 
 
     // TemplateParameter(Function):         ~ 134.9 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        templateParameter(doSomething);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "TemplateParameter(Function): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("TemplateParameter(Function)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            templateParameter(doSomething);
+        }
+    });
 
 
     // TemplateParameter(Lambda):           ~ 139.3 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        templateParameter([](int& a){a++;});
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "TemplateParameter(Lambda): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("TemplateParameter(Lambda)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            templateParameter([](int& a){a++;});
+        }
+    });
 
 
     // TemplateParameter(StructFunctor):    ~ 164.8 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        templateParameter(structFunctor);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "TemplateParameter(StructFunctor): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("TemplateParameter(StructFunctor)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            templateParameter(structFunctor);
+        }
+    });
 
 
     // TemplateParameter(ObjMethodBind):    ~ 16.0 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        templateParameter(objDoSomething);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "TemplateParameter(ObjMethodBind): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("TemplateParameter(ObjMethodBind)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            templateParameter(objDoSomething);
+        }
+    });
 
 
     // TemplateParameter(nullptr):          ~ 479.1 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        templateParameter(nullptr);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "TemplateParameter(nullptr): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("TemplateParameter(nullptr)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            templateParameter(nullptr);
+        }
+    });
     std::cout << std::endl;
 
 
@@ -277,48 +272,43 @@ int main(){
 
 
     // std::function(Function):             ~ 11.7 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        functionObject(doSomething);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "std::function(Function): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("std::function(Function)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            functionObject(doSomething);
+        }
+    });
 
 
     // std::function(Lambda):               ~ 10.8 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        functionObject([](int& a){a++;});
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "std::function(Lambda): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("std::function(Lambda)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            functionObject([](int& a){a++;});
+        }
+    });
 
 
     // std::function(StructFuntor):         ~ 11.5 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        functionObject(structFunctor);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "std::function(StructFuntor): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("std::function(StructFuntor)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            functionObject(structFunctor);
+        }
+    });
 
 
     // std::function(ObjMethodBind):        ~ 6.4 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        functionObject(objDoSomething);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "std::function(ObjMethodBind): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("std::function(ObjMethodBind)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            functionObject(objDoSomething);
+        }
+    });
 
 
     // std::function(nullptr):              ~ 58.9 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        functionObject(nullptr);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "std::function(nullptr): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("std::function(nullptr)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            functionObject(nullptr);
+        }
+    });
     std::cout << std::endl;
 
 
@@ -328,21 +318,19 @@ int main(){
     std::cout << "OBJECT ORIENTED PROGRAMMING:" << std::endl;
 
     // obj->functionPointer(Function):      ~ 93.9 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        obj->functionPointer(doSomething);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "obj->functionPointer(Function): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("obj->functionPointer(Function)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            obj->functionPointer(doSomething);
+        }
+    });
 
 
     // obj->functionPointer(Lambda):        ~ 84.6 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        obj->functionPointer([](int& a){a++;});
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "obj->functionPointer(Lambda): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("obj->functionPointer(Lambda)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            obj->functionPointer([](int& a){a++;});
+        }
+    });
 
 
     // obj->functionPointer(StructFunctor): ---
@@ -368,12 +356,11 @@ int main(){
 
 
     // obj->functionPointer(nullptr):       ~ 413.8 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        obj->functionPointer(nullptr);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "obj->functionPointer(nullptr): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("obj->functionPointer(nullptr)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            obj->functionPointer(nullptr);
+        }
+    });
     std::cout << std::endl;
 
 
@@ -385,48 +372,43 @@ int main(){
 
 
     // obj->functionObject(Function):       ~ 10.6 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        obj->functionObject(doSomething);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "obj->functionObject(Function): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("obj->functionObject(Function)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            obj->functionObject(doSomething);
+        }
+    });
     
 
     // obj->functionObject(Lambda):         ~ 10.8 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        obj->functionObject([](int& a){a++;});
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "obj->functionObject(Lambda): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("obj->functionObject(Lambda)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            obj->functionObject([](int& a){a++;});
+        }
+    });
 
 
     // obj->functionObject(StructFunctor):  ~ 10.8 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        obj->functionObject(structFunctor);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "obj->functionObject(StructFunctor): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("obj->functionObject(StructFunctor)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            obj->functionObject(structFunctor);
+        }
+    });
 
 
     // obj->functionObject(ObjMethodBind):  ~ 5.9 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        obj->functionObject(objDoSomething);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "obj->functionObject(ObjMethodBind): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("obj->functionObject(ObjMethodBind)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            obj->functionObject(objDoSomething);
+        }
+    });
 
 
     // obj->functionObject(nullptr):        ~ 55.8 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        obj->functionObject(nullptr);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "obj->functionObject(nullptr): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("obj->functionObject(nullptr)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            obj->functionObject(nullptr);
+        }
+    });
     std::cout << std::endl;
 
 
@@ -436,30 +418,27 @@ int main(){
     std::cout << "MIXED PROGRAMMING:" << std::endl;
 
     // FunctionPointerOnBase(Function):     ~ 104.9 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        functionPointerOnObject(doOnBase, obj);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "FunctionPointerOnBase(Function): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("FunctionPointerOnBase(Function)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            functionPointerOnObject(doOnBase, obj);
+        }
+    });
 
 
     // FunctionPointerOnBase(Lambda):       ~ 75.6 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        functionPointerOnObject([](Base* obj){ obj->doOnBase(); }, obj);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "FunctionPointerOnBase(Lambda): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("FunctionPointerOnBase(Lambda)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            functionPointerOnObject([](Base* obj){ obj->doOnBase(); }, obj);
+        }
+    });
 
 
     // FunctionPointerOnBase(nullptr):      ~ 450.6 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        functionPointerOnObject(nullptr, obj);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "FunctionPointerOnBase(nullptr): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("FunctionPointerOnBase(nullptr)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            functionPointerOnObject(nullptr, obj);
+        }
+    });
     std::cout << std::endl;
 
 
@@ -467,33 +446,30 @@ int main(){
 
 
     // FunctionPointerOnVirtual(Function):  ~ 68.7 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        functionPointerOnObject(doOnVirtual, obj);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "FunctionPointerOnVirtual(Function): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("FunctionPointerOnVirtual(Function)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            functionPointerOnObject(doOnVirtual, obj);
+        }
+    });
 
 
     // FunctionPointerOnVirtual(Lambda):    ~ 55.3 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        functionPointerOnObject([](Base* obj){ obj->doOnVirtual(); }, obj);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "FunctionPointerOnVirtual(Lambda): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("FunctionPointerOnVirtual(Lambda)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            functionPointerOnObject([](Base* obj){ obj->doOnVirtual(); }, obj);
+        }
+    });
 
 
     // FunctionPointerOnVirtual(nullptr):   ~ 471.5 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        functionPointerOnObject(nullptr, obj);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "FunctionPointerOnVirtual(nullptr): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("FunctionPointerOnVirtual(nullptr)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            functionPointerOnObject(nullptr, obj);
+        }
+    });
     std::cout << std::endl;
 
 
     delete obj;
-    return 0;
+    return bench.finish();
 }
\ No newline at end of file
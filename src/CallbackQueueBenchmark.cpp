@@ -1,7 +1,9 @@
+#include "./utils/Benchmark.hpp"
 #include "./utils/CallbackQueueNaive.hpp"
 #include "./utils/CallbackQueueRecycle.hpp"
 #include "./utils/CallbackQueueThreadSafe.hpp"
 #include "./utils/CallbackQueueTwoParty.hpp"
+#include "./utils/CallbackQueueTwoPartyInline.hpp"
 
 #include <chrono>
 #include <cstdint>
@@ -17,25 +19,32 @@ bool callbackFunction(){
 }
 
 
-int main(){
+int main(int argc, char** argv){
+    Benchmark bench("callback_queue_benchmark", argc, argv);
     const uint64_t ITERATIONS = 50000000; // previous 50000000
     CallbackQueueNaive queueNaive;
     CallbackQueueRecycle queueRecycle;
     CallbackQueueThreadSafe<bool(*)()> queueThreadSafe;
     CallbackQueueTwoParty<bool(*)()> queueTwoParty;
+    CallbackQueueTwoPartyInline<> queueTwoPartyInline;
+
+    uint64_t captured = 0;
+    auto capturingCallback = [&captured](){ captured++; return b; };
+    CallbackQueueTwoParty<std::function<bool()>> queueTwoPartyFunction;
+    CallbackQueueTwoPartyInline<> queueTwoPartyInlineLambda;
+    CallbackQueueTwoPartyTyped<decltype(capturingCallback)> queueTwoPartyTyped;
 
 
     //                                      RELEASE             |   DEBUG
 
 
     // plain callback:                      ~ 2177.8 Mio/sec    |   ~ 35.6 Mio/sec
-    auto startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        bool r = callbackFunction();
-        (void)r;
-    }
-    auto endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "plain callback: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("plain callback", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            bool r = callbackFunction();
+            (void)r;
+        }
+    });
     std::cout << std::endl;
 
 
@@ -43,44 +52,40 @@ int main(){
 
 
     // CallbackQueueNaive() empty:          ~ 84.7 Mio/sec      |   ~ 44.1 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        queueNaive.execute();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "CallbackQueueNaive() empty: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("CallbackQueueNaive() empty", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            queueNaive.execute();
+        }
+    });
 
     // CallbackQueueNaive() 1x:             ~ 23.6 Mio/sec      |   ~ 13.8 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        queueNaive.push(callbackFunction);
-        queueNaive.execute();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "CallbackQueueNaive() 1x: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("CallbackQueueNaive() 1x", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            queueNaive.push(callbackFunction);
+            queueNaive.execute();
+        }
+    });
 
     // CallbackQueueNaive() 2x:             ~ 14.7 Mio/sec      |   ~ 8.0 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        queueNaive.push(callbackFunction);
-        queueNaive.push(callbackFunction);
-        queueNaive.execute();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "CallbackQueueNaive() 2x: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("CallbackQueueNaive() 2x", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            queueNaive.push(callbackFunction);
+            queueNaive.push(callbackFunction);
+            queueNaive.execute();
+        }
+    });
 
     // CallbackQueueNaive() 5x:             ~ 6.7 Mio/sec       |   ~ 3.6 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        queueNaive.push(callbackFunction);
-        queueNaive.push(callbackFunction);
-        queueNaive.push(callbackFunction);
-        queueNaive.push(callbackFunction);
-        queueNaive.push(callbackFunction);
-        queueNaive.execute();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "CallbackQueueNaive() 5x: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("CallbackQueueNaive() 5x", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            queueNaive.push(callbackFunction);
+            queueNaive.push(callbackFunction);
+            queueNaive.push(callbackFunction);
+            queueNaive.push(callbackFunction);
+            queueNaive.push(callbackFunction);
+            queueNaive.execute();
+        }
+    });
     std::cout << std::endl;
     
 
@@ -88,44 +93,64 @@ int main(){
 
 
     // CallbackQueueRecycle() empty:        ~ 87.8 Mio/sec      |   ~ 43.9 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint32_t i=0; i < ITERATIONS; i++){
-        queueRecycle.execute();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "CallbackQueueRecycle() empty: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("CallbackQueueRecycle() empty", ITERATIONS, [&](){
+        for(uint32_t i=0; i < ITERATIONS; i++){
+            queueRecycle.execute();
+        }
+    });
     
     // CallbackQueueRecycle() 1x:           ~ 13.9 Mio/sec      |   ~ 9.0 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint32_t i=0; i < ITERATIONS; i++){
-        queueRecycle.push(callbackFunction);
-        queueRecycle.execute();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "CallbackQueueRecycle() 1x: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("CallbackQueueRecycle() 1x", ITERATIONS, [&](){
+        for(uint32_t i=0; i < ITERATIONS; i++){
+            queueRecycle.push(callbackFunction);
+            queueRecycle.execute();
+        }
+    });
 
     // CallbackQueueRecycle() 2x:           ~ 7.7 Mio/sec       |   ~ 4.9 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint32_t i=0; i < ITERATIONS; i++){
-        queueRecycle.push(callbackFunction);
-        queueRecycle.push(callbackFunction);
-        queueRecycle.execute();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "CallbackQueueRecycle() 2x: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("CallbackQueueRecycle() 2x", ITERATIONS, [&](){
+        for(uint32_t i=0; i < ITERATIONS; i++){
+            queueRecycle.push(callbackFunction);
+            queueRecycle.push(callbackFunction);
+            queueRecycle.execute();
+        }
+    });
 
     // CallbackQueueRecycle() 5x:          ~ 3.2 Mio/sec        |   ~ 2.0 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint32_t i=0; i < ITERATIONS; i++){
-        queueRecycle.push(callbackFunction);
-        queueRecycle.push(callbackFunction);
-        queueRecycle.push(callbackFunction);
-        queueRecycle.push(callbackFunction);
-        queueRecycle.push(callbackFunction);
-        queueRecycle.execute();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "CallbackQueueRecycle() 5x: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("CallbackQueueRecycle() 5x", ITERATIONS, [&](){
+        for(uint32_t i=0; i < ITERATIONS; i++){
+            queueRecycle.push(callbackFunction);
+            queueRecycle.push(callbackFunction);
+            queueRecycle.push(callbackFunction);
+            queueRecycle.push(callbackFunction);
+            queueRecycle.push(callbackFunction);
+            queueRecycle.execute();
+        }
+    });
+
+    // CallbackQueueRecycle(2) 5x:          ~ X Mio/sec          |   ~ X Mio/sec
+    bench.run("CallbackQueueRecycle(2) 5x", ITERATIONS, [&](){
+        for(uint32_t i=0; i < ITERATIONS; i++){
+            queueRecycle.push(callbackFunction);
+            queueRecycle.push(callbackFunction);
+            queueRecycle.push(callbackFunction);
+            queueRecycle.push(callbackFunction);
+            queueRecycle.push(callbackFunction);
+            while(!queueRecycle.execute((uint64_t)2));
+        }
+    });
+
+    // CallbackQueueRecycle(deadline) 5x:   ~ X Mio/sec          |   ~ X Mio/sec
+    bench.run("CallbackQueueRecycle(deadline) 5x", ITERATIONS, [&](){
+        for(uint32_t i=0; i < ITERATIONS; i++){
+            queueRecycle.push(callbackFunction);
+            queueRecycle.push(callbackFunction);
+            queueRecycle.push(callbackFunction);
+            queueRecycle.push(callbackFunction);
+            queueRecycle.push(callbackFunction);
+            queueRecycle.execute(std::chrono::steady_clock::now() + std::chrono::microseconds(50));
+        }
+    });
     std::cout << std::endl;
     
 
@@ -133,44 +158,40 @@ int main(){
 
 
     // CallbackQueueThreadSafe() empty:     ~ 108.4 Mio/sec     |   ~ 37.3 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint32_t i=0; i < ITERATIONS; i++){
-        queueThreadSafe.execute();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "CallbackQueueThreadSafe() empty: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("CallbackQueueThreadSafe() empty", ITERATIONS, [&](){
+        for(uint32_t i=0; i < ITERATIONS; i++){
+            queueThreadSafe.execute();
+        }
+    });
     
     // CallbackQueueThreadSafe() 1x:        ~ 45.2 Mio/sec      |   ~ 15.1 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint32_t i=0; i < ITERATIONS; i++){
-        queueThreadSafe.push(callbackFunction);
-        queueThreadSafe.execute();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "CallbackQueueThreadSafe() 1x: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("CallbackQueueThreadSafe() 1x", ITERATIONS, [&](){
+        for(uint32_t i=0; i < ITERATIONS; i++){
+            queueThreadSafe.push(callbackFunction);
+            queueThreadSafe.execute();
+        }
+    });
 
     // CallbackQueueThreadSafe() 2x:        ~ 29.3 Mio/sec      |   ~ 9.4 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint32_t i=0; i < ITERATIONS; i++){
-        queueThreadSafe.push(callbackFunction);
-        queueThreadSafe.push(callbackFunction);
-        queueThreadSafe.execute();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "CallbackQueueThreadSafe() 2x: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("CallbackQueueThreadSafe() 2x", ITERATIONS, [&](){
+        for(uint32_t i=0; i < ITERATIONS; i++){
+            queueThreadSafe.push(callbackFunction);
+            queueThreadSafe.push(callbackFunction);
+            queueThreadSafe.execute();
+        }
+    });
 
     // CallbackQueueThreadSafe() 5x:        ~ 14.9 Mio/sec      |   ~ 4.5 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint32_t i=0; i < ITERATIONS; i++){
-        queueThreadSafe.push(callbackFunction);
-        queueThreadSafe.push(callbackFunction);
-        queueThreadSafe.push(callbackFunction);
-        queueThreadSafe.push(callbackFunction);
-        queueThreadSafe.push(callbackFunction);
-        queueThreadSafe.execute();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "CallbackQueueThreadSafe() 5x: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("CallbackQueueThreadSafe() 5x", ITERATIONS, [&](){
+        for(uint32_t i=0; i < ITERATIONS; i++){
+            queueThreadSafe.push(callbackFunction);
+            queueThreadSafe.push(callbackFunction);
+            queueThreadSafe.push(callbackFunction);
+            queueThreadSafe.push(callbackFunction);
+            queueThreadSafe.push(callbackFunction);
+            queueThreadSafe.execute();
+        }
+    });
     std::cout << std::endl;
     
 
@@ -178,47 +199,152 @@ int main(){
 
 
     // CallbackQueueTwoParty() empty:       ~ 1500.8 Mio/sec    |   ~ 403.4 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint32_t i=0; i < ITERATIONS; i++){
-        queueTwoParty.execute();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "CallbackQueueTwoParty() empty: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("CallbackQueueTwoParty() empty", ITERATIONS, [&](){
+        for(uint32_t i=0; i < ITERATIONS; i++){
+            queueTwoParty.execute();
+        }
+    });
     
     // CallbackQueueTwoParty() 1x:          ~ 265.1 Mio/sec     |   ~ 61.1 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint32_t i=0; i < ITERATIONS; i++){
-        queueTwoParty.push(callbackFunction);
-        queueTwoParty.execute();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "CallbackQueueTwoParty() 1x: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("CallbackQueueTwoParty() 1x", ITERATIONS, [&](){
+        for(uint32_t i=0; i < ITERATIONS; i++){
+            queueTwoParty.push(callbackFunction);
+            queueTwoParty.execute();
+        }
+    });
 
     // CallbackQueueTwoParty() 2x:          ~ 109.9 Mio/sec     |   ~ 30.7 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint32_t i=0; i < ITERATIONS; i++){
-        queueTwoParty.push(callbackFunction);
-        queueTwoParty.push(callbackFunction);
-        queueTwoParty.execute();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "CallbackQueueTwoParty() 2x: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("CallbackQueueTwoParty() 2x", ITERATIONS, [&](){
+        for(uint32_t i=0; i < ITERATIONS; i++){
+            queueTwoParty.push(callbackFunction);
+            queueTwoParty.push(callbackFunction);
+            queueTwoParty.execute();
+        }
+    });
 
     // CallbackQueueTwoParty() 5x:          ~ 56.1 Mio/sec      |   ~ 13.7 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint32_t i=0; i < ITERATIONS; i++){
-        queueTwoParty.push(callbackFunction);
-        queueTwoParty.push(callbackFunction);
-        queueTwoParty.push(callbackFunction);
-        queueTwoParty.push(callbackFunction);
-        queueTwoParty.push(callbackFunction);
-        queueTwoParty.execute();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "CallbackQueueTwoParty() 5x: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("CallbackQueueTwoParty() 5x", ITERATIONS, [&](){
+        for(uint32_t i=0; i < ITERATIONS; i++){
+            queueTwoParty.push(callbackFunction);
+            queueTwoParty.push(callbackFunction);
+            queueTwoParty.push(callbackFunction);
+            queueTwoParty.push(callbackFunction);
+            queueTwoParty.push(callbackFunction);
+            queueTwoParty.execute();
+        }
+    });
+    std::cout << std::endl;
+
+
+
+
+
+    // CallbackQueueTwoPartyInline() empty: ~ X Mio/sec          |   ~ X Mio/sec
+    bench.run("CallbackQueueTwoPartyInline() empty", ITERATIONS, [&](){
+        for(uint32_t i=0; i < ITERATIONS; i++){
+            queueTwoPartyInline.execute();
+        }
+    });
+
+    // CallbackQueueTwoPartyInline() 1x:    ~ X Mio/sec          |   ~ X Mio/sec
+    bench.run("CallbackQueueTwoPartyInline() 1x", ITERATIONS, [&](){
+        for(uint32_t i=0; i < ITERATIONS; i++){
+            queueTwoPartyInline.push(callbackFunction);
+            queueTwoPartyInline.execute();
+        }
+    });
+
+    // CallbackQueueTwoPartyInline() 2x:    ~ X Mio/sec          |   ~ X Mio/sec
+    bench.run("CallbackQueueTwoPartyInline() 2x", ITERATIONS, [&](){
+        for(uint32_t i=0; i < ITERATIONS; i++){
+            queueTwoPartyInline.push(callbackFunction);
+            queueTwoPartyInline.push(callbackFunction);
+            queueTwoPartyInline.execute();
+        }
+    });
+
+    // CallbackQueueTwoPartyInline() 5x:    ~ X Mio/sec          |   ~ X Mio/sec
+    bench.run("CallbackQueueTwoPartyInline() 5x", ITERATIONS, [&](){
+        for(uint32_t i=0; i < ITERATIONS; i++){
+            queueTwoPartyInline.push(callbackFunction);
+            queueTwoPartyInline.push(callbackFunction);
+            queueTwoPartyInline.push(callbackFunction);
+            queueTwoPartyInline.push(callbackFunction);
+            queueTwoPartyInline.push(callbackFunction);
+            queueTwoPartyInline.execute();
+        }
+    });
+    std::cout << std::endl;
+
+
+
+
+
+    // capturing lambda (std::function needs to allocate, inline and typed queues do not)
+    // CallbackQueueTwoParty<std::function>() lambda 1x: ~ X Mio/sec          |   ~ X Mio/sec
+    bench.run("CallbackQueueTwoParty<std::function>() lambda 1x", ITERATIONS, [&](){
+        for(uint32_t i=0; i < ITERATIONS; i++){
+            queueTwoPartyFunction.push(capturingCallback);
+            queueTwoPartyFunction.execute();
+        }
+    });
+
+    // CallbackQueueTwoParty<std::function>() lambda 5x: ~ X Mio/sec          |   ~ X Mio/sec
+    bench.run("CallbackQueueTwoParty<std::function>() lambda 5x", ITERATIONS, [&](){
+        for(uint32_t i=0; i < ITERATIONS; i++){
+            queueTwoPartyFunction.push(capturingCallback);
+            queueTwoPartyFunction.push(capturingCallback);
+            queueTwoPartyFunction.push(capturingCallback);
+            queueTwoPartyFunction.push(capturingCallback);
+            queueTwoPartyFunction.push(capturingCallback);
+            queueTwoPartyFunction.execute();
+        }
+    });
+    std::cout << std::endl;
+
+    // CallbackQueueTwoPartyInline() lambda 1x: ~ X Mio/sec          |   ~ X Mio/sec
+    bench.run("CallbackQueueTwoPartyInline() lambda 1x", ITERATIONS, [&](){
+        for(uint32_t i=0; i < ITERATIONS; i++){
+            queueTwoPartyInlineLambda.push(capturingCallback);
+            queueTwoPartyInlineLambda.execute();
+        }
+    });
+
+    // CallbackQueueTwoPartyInline() lambda 5x: ~ X Mio/sec          |   ~ X Mio/sec
+    bench.run("CallbackQueueTwoPartyInline() lambda 5x", ITERATIONS, [&](){
+        for(uint32_t i=0; i < ITERATIONS; i++){
+            queueTwoPartyInlineLambda.push(capturingCallback);
+            queueTwoPartyInlineLambda.push(capturingCallback);
+            queueTwoPartyInlineLambda.push(capturingCallback);
+            queueTwoPartyInlineLambda.push(capturingCallback);
+            queueTwoPartyInlineLambda.push(capturingCallback);
+            queueTwoPartyInlineLambda.execute();
+        }
+    });
+    std::cout << std::endl;
+
+    // CallbackQueueTwoPartyTyped() lambda 1x: ~ X Mio/sec          |   ~ X Mio/sec
+    bench.run("CallbackQueueTwoPartyTyped() lambda 1x", ITERATIONS, [&](){
+        for(uint32_t i=0; i < ITERATIONS; i++){
+            queueTwoPartyTyped.push(capturingCallback);
+            queueTwoPartyTyped.execute();
+        }
+    });
+
+    // CallbackQueueTwoPartyTyped() lambda 5x: ~ X Mio/sec          |   ~ X Mio/sec
+    bench.run("CallbackQueueTwoPartyTyped() lambda 5x", ITERATIONS, [&](){
+        for(uint32_t i=0; i < ITERATIONS; i++){
+            queueTwoPartyTyped.push(capturingCallback);
+            queueTwoPartyTyped.push(capturingCallback);
+            queueTwoPartyTyped.push(capturingCallback);
+            queueTwoPartyTyped.push(capturingCallback);
+            queueTwoPartyTyped.push(capturingCallback);
+            queueTwoPartyTyped.execute();
+        }
+    });
     std::cout << std::endl;
     
 
 
-    return 0;
+    return bench.finish();
 }
\ No newline at end of file
@@ -1,19 +1,84 @@
+#include "./utils/Benchmark.hpp"
+#include "./utils/HardwareUtils.hpp"
+#include "./utils/MemoryCopy.hpp"
 #include "./utils/MetricsUtils.hpp"
+#include "./utils/Thread.hpp"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <cstdlib> // malloc
 #include <cstring> // memcpy
 #include <iostream>
+#include <string>
+#include <utility>
 
 using namespace spi;
 
 
+/**
+ * Copies between two buffers of given size that are allocated on the given NUMA node with the given page size.
+ */
+void measureCopyPlacement(Benchmark &bench, const std::string &name, uint64_t size, uint64_t iterations, int numaNode, PageSize pageSize){
+    uint8_t* buf1 = (uint8_t*)HardwareUtils::allocateMemory(size, numaNode, pageSize, true);
+    uint8_t* buf2 = (uint8_t*)HardwareUtils::allocateMemory(size, numaNode, pageSize, true);
+    for(uint64_t i=0; i < size; i++) buf1[i] = (uint8_t)i;
+
+    BenchmarkResult result = bench.run(name, 2 * iterations, [&](){
+        for(uint64_t i=0; i < iterations; i++){
+            std::memcpy(buf2, buf1, size);
+            std::memcpy(buf1, buf2, size);
+        }
+    });
+    if(result.operations > 0)
+        std::cout << "  " << MetricsUtils::bytesPerSecToString(result.opsPerSec() * size) << "  (memory on NUMA node " << HardwareUtils::getNumaNodeOfMemory(buf1) << ")" << std::endl;
+
+    HardwareUtils::freeMemory(buf1, size, pageSize);
+    HardwareUtils::freeMemory(buf2, size, pageSize);
+}
+
+
+
+/**
+ * Copies between two buffers of given size with every MemoryCopy strategy.
+ */
+void measureCopyStrategies(Benchmark &bench, const std::string &name, uint8_t* buf1, uint8_t* buf2, uint64_t size, uint64_t iterations){
+    const std::pair<const char*, CopyStrategy> strategies[] = {
+        {"memcpy", CopyStrategy::MEMCPY}, {"vector", CopyStrategy::VECTOR}, {"stream", CopyStrategy::STREAM}, {"auto", CopyStrategy::AUTO}
+    };
+    for(const auto &[strategyName, strategy] : strategies){
+        BenchmarkResult result = bench.run(name+" "+strategyName, 2 * iterations, [&](){
+            for(uint64_t i=0; i < iterations; i++){
+                MemoryCopy::copy(buf2, buf1, size, strategy);
+                MemoryCopy::copy(buf1, buf2, size, strategy);
+            }
+        });
+        if(result.operations > 0) std::cout << "  " << MetricsUtils::bytesPerSecToString(result.opsPerSec() * size) << std::endl;
+    }
+}
+
+/**
+ * Copies between two buffers of given size split across the workers of a thread pool.
+ */
+void measureCopyParallel(Benchmark &bench, const std::string &name, uint8_t* buf1, uint8_t* buf2, uint64_t size, uint64_t iterations, int threads){
+    ThreadPool pool(threads, threads);
+    const size_t chunk = std::max((size_t)CACHE_LINE_SIZE, (size_t)(size / (uint64_t)(threads + 1)));
+    BenchmarkResult result = bench.run(name+" "+std::to_string(threads)+" workers", 2 * iterations, [&](){
+        for(uint64_t i=0; i < iterations; i++){
+            MemoryCopy::copyParallel(pool, buf2, buf1, size, chunk);
+            MemoryCopy::copyParallel(pool, buf1, buf2, size, chunk);
+        }
+    });
+    if(result.operations > 0) std::cout << "  " << MetricsUtils::bytesPerSecToString(result.opsPerSec() * size) << std::endl;
+}
+
+
 
 // COPY-EDIT-COPY vs. ZERO-COPY-EDIT
 
 
-int main(){
+int main(int argc, char** argv){
+    Benchmark bench("copy_benchmark", argc, argv);
     const uint64_t ITERATIONS_SMALL = 500000000;
     const uint64_t ITERATIONS_MEDIUM = 50000000;
     const uint64_t ITERATIONS_LARGE = 500000;
@@ -59,44 +124,66 @@ int main(){
 
 
     // copy small:                  ~ 2864 Mio/sec  |   ~ 79 Mio/sec        ~ 92 GB/s   |   ~ 2.5 GB/s           
-    auto startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS_SMALL; i++){
-        std::memcpy(smallBuf2, smallBuf1, SMALL_BUF_SIZE);
-        std::memcpy(smallBuf1, smallBuf2, SMALL_BUF_SIZE);
-    }
-    auto endTime = std::chrono::high_resolution_clock::now();
-    int64_t iterationsPerSec = 2 * ITERATIONS_SMALL * 1000000 / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count();
-    std::cout << "copy small: \t" << MetricsUtils::bytesPerSecToString(iterationsPerSec * SMALL_BUF_SIZE) << " | \t" << iterationsPerSec << "op/s" << std::endl;
+    BenchmarkResult result = bench.run("copy small", 2 * ITERATIONS_SMALL, [&](){
+        for(uint64_t i=0; i < ITERATIONS_SMALL; i++){
+            std::memcpy(smallBuf2, smallBuf1, SMALL_BUF_SIZE);
+            std::memcpy(smallBuf1, smallBuf2, SMALL_BUF_SIZE);
+        }
+    });
+    if(result.operations > 0) std::cout << "  " << MetricsUtils::bytesPerSecToString(result.opsPerSec() * SMALL_BUF_SIZE) << std::endl;
 
     // copy medium:                 ~ 36 Mio/sec    |   ~ 29 Mio/sec        ~ 75 GB/s   |   ~ 60 GB/s
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS_MEDIUM; i++){
-        std::memcpy(mediumBuf2, mediumBuf1, MEDIUM_BUF_SIZE);
-        std::memcpy(mediumBuf1, mediumBuf2, MEDIUM_BUF_SIZE);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    iterationsPerSec = 2 * ITERATIONS_MEDIUM * 1000000 / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count();
-    std::cout << "copy medium: \t" << MetricsUtils::bytesPerSecToString(iterationsPerSec * MEDIUM_BUF_SIZE) << " | \t" << iterationsPerSec << "op/s" << std::endl;
+    result = bench.run("copy medium", 2 * ITERATIONS_MEDIUM, [&](){
+        for(uint64_t i=0; i < ITERATIONS_MEDIUM; i++){
+            std::memcpy(mediumBuf2, mediumBuf1, MEDIUM_BUF_SIZE);
+            std::memcpy(mediumBuf1, mediumBuf2, MEDIUM_BUF_SIZE);
+        }
+    });
+    if(result.operations > 0) std::cout << "  " << MetricsUtils::bytesPerSecToString(result.opsPerSec() * MEDIUM_BUF_SIZE) << std::endl;
 
     // copy large:                  ~ 354 Kilo/sec  |   ~ 352 Kilo/sec      ~ 46 GB/s   |   ~ 46 GB/s
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS_LARGE; i++){
-        std::memcpy(largeBuf2, largeBuf1, LARGE_BUF_SIZE);
-        std::memcpy(largeBuf1, largeBuf2, LARGE_BUF_SIZE);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    iterationsPerSec = 2 * ITERATIONS_LARGE * 1000000 / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count();
-    std::cout << "copy large: \t" << MetricsUtils::bytesPerSecToString(iterationsPerSec * LARGE_BUF_SIZE) << " | \t" << iterationsPerSec << "op/s" << std::endl;
+    result = bench.run("copy large", 2 * ITERATIONS_LARGE, [&](){
+        for(uint64_t i=0; i < ITERATIONS_LARGE; i++){
+            std::memcpy(largeBuf2, largeBuf1, LARGE_BUF_SIZE);
+            std::memcpy(largeBuf1, largeBuf2, LARGE_BUF_SIZE);
+        }
+    });
+    if(result.operations > 0) std::cout << "  " << MetricsUtils::bytesPerSecToString(result.opsPerSec() * LARGE_BUF_SIZE) << std::endl;
 
     // copy mega:                   ~ 1380 /sec     |   ~ 1394 /sec         ~ 11 GB/s   |   ~ 11 GB/s
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS_MEGA_LARGE; i++){
-        std::memcpy(megaLargeBuf2, megaLargeBuf1, MEGA_LARGE_BUF_SIZE);
-        std::memcpy(megaLargeBuf1, megaLargeBuf2, MEGA_LARGE_BUF_SIZE);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    iterationsPerSec = 2 * ITERATIONS_MEGA_LARGE * 1000000 / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count();
-    std::cout << "copy mega: \t" << MetricsUtils::bytesPerSecToString(iterationsPerSec * MEGA_LARGE_BUF_SIZE) << " | \t" << iterationsPerSec << "op/s" << std::endl;
+    result = bench.run("copy mega", 2 * ITERATIONS_MEGA_LARGE, [&](){
+        for(uint64_t i=0; i < ITERATIONS_MEGA_LARGE; i++){
+            std::memcpy(megaLargeBuf2, megaLargeBuf1, MEGA_LARGE_BUF_SIZE);
+            std::memcpy(megaLargeBuf1, megaLargeBuf2, MEGA_LARGE_BUF_SIZE);
+        }
+    });
+    if(result.operations > 0) std::cout << "  " << MetricsUtils::bytesPerSecToString(result.opsPerSec() * MEGA_LARGE_BUF_SIZE) << std::endl;
+    std::cout << std::endl;
+
+
+    // strategies of MemoryCopy (vector/stream kernels use the widest instruction set of the CPU)
+    std::cout << "MemoryCopy kernels: " << MemoryCopy::simdName() << ", auto streams from " << MetricsUtils::byteSizeToString(MemoryCopy::getStreamThreshold()) << std::endl;
+    measureCopyStrategies(bench, "MemoryCopy small", smallBuf1, smallBuf2, SMALL_BUF_SIZE, ITERATIONS_SMALL);
+    measureCopyStrategies(bench, "MemoryCopy medium", mediumBuf1, mediumBuf2, MEDIUM_BUF_SIZE, ITERATIONS_MEDIUM);
+    measureCopyStrategies(bench, "MemoryCopy large", largeBuf1, largeBuf2, LARGE_BUF_SIZE, ITERATIONS_LARGE);
+    measureCopyStrategies(bench, "MemoryCopy mega", megaLargeBuf1, megaLargeBuf2, MEGA_LARGE_BUF_SIZE, ITERATIONS_MEGA_LARGE);
+    for(int threads=1; threads <= HardwareUtils::getCpuCoreCount(); threads *= 2)
+        measureCopyParallel(bench, "MemoryCopy mega parallel", megaLargeBuf1, megaLargeBuf2, MEGA_LARGE_BUF_SIZE, ITERATIONS_MEGA_LARGE, threads);
+    std::cout << std::endl;
+
+
+    // placement of mega buffers: NUMA node of the copying thread vs. another node, regular vs. huge pages
+    const int localNode = HardwareUtils::currentNumaNode() >= 0 ? HardwareUtils::currentNumaNode() : 0;
+    int remoteNode = -1;
+    for(int node=0; remoteNode < 0 && (size_t)node < HardwareUtils::getNumaNodeCount(); node++)
+        if(node != localNode && !HardwareUtils::getCpusOfNumaNode(node).empty()) remoteNode = node;
+
+    measureCopyPlacement(bench, "copy mega local", MEGA_LARGE_BUF_SIZE, ITERATIONS_MEGA_LARGE, localNode, PageSize::DEFAULT);
+    if(remoteNode >= 0)
+        measureCopyPlacement(bench, "copy mega remote", MEGA_LARGE_BUF_SIZE, ITERATIONS_MEGA_LARGE, remoteNode, PageSize::DEFAULT);
+    else
+        std::cout << "copy mega remote: skipped (single NUMA node)" << std::endl;
+    measureCopyPlacement(bench, "copy mega local 2MB pages", MEGA_LARGE_BUF_SIZE, ITERATIONS_MEGA_LARGE, localNode, PageSize::HUGE_2MB);
     std::cout << std::endl;
 
 
@@ -104,52 +191,48 @@ int main(){
 
 
     // copy-edit-copy small:        ~ 115 Mio/sec   |   ~ 38 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS_SMALL; i++){
-        std::memcpy(smallBuf2, smallBuf1, SMALL_BUF_SIZE);
-        volatile uint32_t tmp = *(uint32_t*)(smallBuf2 + 0);
-        tmp = tmp + (uint32_t)i;
-        *(uint32_t*)(smallBuf2 + 0) = tmp;
-        std::memcpy(smallBuf1, smallBuf2, SMALL_BUF_SIZE);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "copy-edit-copy small: \t" << (ITERATIONS_SMALL * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("copy-edit-copy small", ITERATIONS_SMALL, [&](){
+        for(uint64_t i=0; i < ITERATIONS_SMALL; i++){
+            std::memcpy(smallBuf2, smallBuf1, SMALL_BUF_SIZE);
+            volatile uint32_t tmp = *(uint32_t*)(smallBuf2 + 0);
+            tmp = tmp + (uint32_t)i;
+            *(uint32_t*)(smallBuf2 + 0) = tmp;
+            std::memcpy(smallBuf1, smallBuf2, SMALL_BUF_SIZE);
+        }
+    });
 
     // copy-edit-copy medium:       ~ 16 Mio/sec    |   ~ 14 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS_MEDIUM; i++){
-        std::memcpy(mediumBuf2, mediumBuf1, MEDIUM_BUF_SIZE);
-        volatile uint32_t tmp = *(uint32_t*)(mediumBuf2 + 6);
-        tmp = tmp + (uint32_t)i;
-        *(uint32_t*)(mediumBuf2 + 6) = tmp;
-        std::memcpy(mediumBuf1, mediumBuf2, MEDIUM_BUF_SIZE);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "copy-edit-copy medium: \t" << (ITERATIONS_MEDIUM * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("copy-edit-copy medium", ITERATIONS_MEDIUM, [&](){
+        for(uint64_t i=0; i < ITERATIONS_MEDIUM; i++){
+            std::memcpy(mediumBuf2, mediumBuf1, MEDIUM_BUF_SIZE);
+            volatile uint32_t tmp = *(uint32_t*)(mediumBuf2 + 6);
+            tmp = tmp + (uint32_t)i;
+            *(uint32_t*)(mediumBuf2 + 6) = tmp;
+            std::memcpy(mediumBuf1, mediumBuf2, MEDIUM_BUF_SIZE);
+        }
+    });
 
     // copy-edit-copy large:        ~ 169 Kilo/sec  |   ~ 173 Kilo/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS_LARGE; i++){
-        std::memcpy(largeBuf2, largeBuf1, LARGE_BUF_SIZE);
-        volatile uint32_t tmp = *(uint32_t*)(largeBuf2 + 6);
-        tmp = tmp + (uint32_t)i;
-        *(uint32_t*)(largeBuf2 + 6) = tmp;
-        std::memcpy(largeBuf1, largeBuf2, LARGE_BUF_SIZE);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "copy-edit-copy large: \t" << (ITERATIONS_LARGE * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("copy-edit-copy large", ITERATIONS_LARGE, [&](){
+        for(uint64_t i=0; i < ITERATIONS_LARGE; i++){
+            std::memcpy(largeBuf2, largeBuf1, LARGE_BUF_SIZE);
+            volatile uint32_t tmp = *(uint32_t*)(largeBuf2 + 6);
+            tmp = tmp + (uint32_t)i;
+            *(uint32_t*)(largeBuf2 + 6) = tmp;
+            std::memcpy(largeBuf1, largeBuf2, LARGE_BUF_SIZE);
+        }
+    });
     
     // copy-edit-copy mega:         ~ 692 /sec      |   ~ 695 /sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS_MEGA_LARGE; i++){
-        std::memcpy(megaLargeBuf2, megaLargeBuf1, MEGA_LARGE_BUF_SIZE);
-        volatile uint32_t tmp = *(uint32_t*)(megaLargeBuf2 + 6);
-        tmp = tmp + (uint32_t)i;
-        *(uint32_t*)(megaLargeBuf2 + 6) = tmp;
-        std::memcpy(megaLargeBuf1, megaLargeBuf2, MEGA_LARGE_BUF_SIZE);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "copy-edit-copy mega: \t" << (ITERATIONS_MEGA_LARGE * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("copy-edit-copy mega", ITERATIONS_MEGA_LARGE, [&](){
+        for(uint64_t i=0; i < ITERATIONS_MEGA_LARGE; i++){
+            std::memcpy(megaLargeBuf2, megaLargeBuf1, MEGA_LARGE_BUF_SIZE);
+            volatile uint32_t tmp = *(uint32_t*)(megaLargeBuf2 + 6);
+            tmp = tmp + (uint32_t)i;
+            *(uint32_t*)(megaLargeBuf2 + 6) = tmp;
+            std::memcpy(megaLargeBuf1, megaLargeBuf2, MEGA_LARGE_BUF_SIZE);
+        }
+    });
     std::cout << std::endl;
 
 
@@ -159,44 +242,40 @@ int main(){
 
 
     // zero-copy-edit small:        ~ 313 Mio/sec   |   ~ 222 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS_ZERO_COPY; i++){
-        volatile uint32_t tmp = *(uint32_t*)(smallBuf1 + 0);
-        tmp = tmp + (uint32_t)i;
-        *(uint32_t*)(smallBuf1 + 0) = tmp;
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "zero-copy-edit small: " << (ITERATIONS_ZERO_COPY * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("zero-copy-edit small", ITERATIONS_ZERO_COPY, [&](){
+        for(uint64_t i=0; i < ITERATIONS_ZERO_COPY; i++){
+            volatile uint32_t tmp = *(uint32_t*)(smallBuf1 + 0);
+            tmp = tmp + (uint32_t)i;
+            *(uint32_t*)(smallBuf1 + 0) = tmp;
+        }
+    });
 
     // zero-copy-edit medium:       ~ 315 Mio/sec   |   ~ 240 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS_ZERO_COPY; i++){
-        volatile uint32_t tmp = *(uint32_t*)(mediumBuf1 + 6);
-        tmp = tmp + (uint32_t)i;
-        *(uint32_t*)(mediumBuf1 + 6) = tmp;
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "zero-copy-edit medium: " << (ITERATIONS_ZERO_COPY * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("zero-copy-edit medium", ITERATIONS_ZERO_COPY, [&](){
+        for(uint64_t i=0; i < ITERATIONS_ZERO_COPY; i++){
+            volatile uint32_t tmp = *(uint32_t*)(mediumBuf1 + 6);
+            tmp = tmp + (uint32_t)i;
+            *(uint32_t*)(mediumBuf1 + 6) = tmp;
+        }
+    });
 
     // zero-copy-edit large:        ~ 314 Mio/sec   |   ~ 227 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS_ZERO_COPY; i++){
-        volatile uint32_t tmp = *(uint32_t*)(largeBuf1 + 6);
-        tmp = tmp + (uint32_t)i;
-        *(uint32_t*)(largeBuf1 + 6) = tmp;
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "zero-copy-edit large: " << (ITERATIONS_ZERO_COPY * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("zero-copy-edit large", ITERATIONS_ZERO_COPY, [&](){
+        for(uint64_t i=0; i < ITERATIONS_ZERO_COPY; i++){
+            volatile uint32_t tmp = *(uint32_t*)(largeBuf1 + 6);
+            tmp = tmp + (uint32_t)i;
+            *(uint32_t*)(largeBuf1 + 6) = tmp;
+        }
+    });
 
     // zero-copy-edit mega:         ~ 314 Mio/sec   |   ~ 250 /sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS_ZERO_COPY; i++){
-        volatile uint32_t tmp = *(uint32_t*)(megaLargeBuf1 + 6);
-        tmp = tmp + (uint32_t)i;
-        *(uint32_t*)(megaLargeBuf1 + 6) = tmp;
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "zero-copy-edit mega: " << (ITERATIONS_ZERO_COPY * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("zero-copy-edit mega", ITERATIONS_ZERO_COPY, [&](){
+        for(uint64_t i=0; i < ITERATIONS_ZERO_COPY; i++){
+            volatile uint32_t tmp = *(uint32_t*)(megaLargeBuf1 + 6);
+            tmp = tmp + (uint32_t)i;
+            *(uint32_t*)(megaLargeBuf1 + 6) = tmp;
+        }
+    });
 
 
 
@@ -208,5 +287,5 @@ int main(){
     free(largeBuf2);
     free(megaLargeBuf1);
     free(megaLargeBuf2);
-    return 0;
+    return bench.finish();
 }
\ No newline at end of file
@@ -1,20 +1,102 @@
+#include "utils/Benchmark.hpp"
 #include "utils/CountingLock.hpp"
 #include "utils/Thread.hpp"
 
-#include <algorithm> // max
 #include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <iostream>
 #include <semaphore>
+#include <string>
+#include <thread>
 #include <vector>
 
 using namespace spi;
 
 
 
-
-int main(){
+/**
+ * Single thread acquires and releases the lock, sleepUs between acquire and release is not measured.
+ */
+template<typename Lock>
+void measureSimple(Benchmark &bench, const std::string &name, Lock &lock, const uint32_t iterations, const uint32_t sleepUs){
+    bench.run(name, iterations, [&](BenchmarkTimer &timer){
+        for(uint64_t i=0; i < iterations;){
+            lock.acquire();
+            if(sleepUs > 0) Thread::sleepUs(sleepUs);
+            i++;
+            lock.release();
+        }
+        timer.exclude(std::chrono::microseconds((uint64_t)iterations * sleepUs));
+    });
+}
+
+
+/**
+ * Many threads acquire and release the lock at the same time, sleepUs between acquire and release is not measured.
+ */
+template<typename Lock>
+void measureContention(Benchmark &bench, const std::string &name, Lock &lock, const uint32_t threadCount, const uint32_t iterations, const uint32_t sleepUs){
+    bench.run(name, (uint64_t)threadCount * iterations, [&](BenchmarkTimer &timer){
+        std::atomic<uint32_t> readyCounter{0};
+        std::vector<Thread*> threads;
+        for(uint32_t i=0; i < threadCount; i++){
+            threads.push_back(new Thread([&lock, threadCount, iterations, sleepUs, &readyCounter](){
+                readyCounter.fetch_add(1);
+                while(readyCounter.load() < threadCount) std::this_thread::yield();
+
+                for(uint32_t i=0; i < iterations;){
+                    lock.acquire();
+                    if(sleepUs > 0) Thread::sleepUs(sleepUs); else std::this_thread::yield();
+                    i++;
+                    lock.release();
+                }
+            }));
+            bench.pin(*threads.back(), i);
+        }
+        timer.start();
+        for(Thread* thr : threads) thr->start();
+        for(Thread* thr : threads) thr->join();
+        timer.stop();
+        timer.exclude(std::chrono::microseconds((uint64_t)iterations * sleepUs));
+        for(Thread* thr : threads) delete thr;
+    });
+}
+
+
+/**
+ * Threads acquire and release batch units at once, operations are units.
+ */
+void measureBatch(Benchmark &bench, const std::string &name, AbstractCountingLock &lock, const int32_t batch, const uint32_t threadCount, const uint32_t iterations){
+    bench.run(name, (uint64_t)threadCount * iterations * (uint64_t)batch, [&](BenchmarkTimer &timer){
+        std::atomic<uint32_t> readyCounter{0};
+        std::vector<Thread*> threads;
+        for(uint32_t i=0; i < threadCount; i++){
+            threads.push_back(new Thread([&lock, batch, threadCount, iterations, &readyCounter](){
+                readyCounter.fetch_add(1);
+                while(readyCounter.load() < threadCount) std::this_thread::yield();
+
+                for(uint32_t i=0; i < iterations; i++){
+                    lock.acquire(batch);
+                    std::this_thread::yield();
+                    lock.release(batch);
+                }
+            }));
+            bench.pin(*threads.back(), i);
+        }
+        timer.start();
+        for(Thread* thr : threads) thr->start();
+        for(Thread* thr : threads) thr->join();
+        timer.stop();
+        for(Thread* thr : threads) delete thr;
+    });
+}
+
+
+
+
+int main(int argc, char** argv){
+    Benchmark bench("counting_lock_benchmark", argc, argv);
     const uint32_t SIMPLE_ITERATIONS = 10000000; // <-  Debug: 5000000;     Release: 10000000
     const uint32_t SIMPLE_SLEEP_US = 0;
 
@@ -27,56 +109,29 @@ int main(){
     std::counting_semaphore<1> semaphoreTwoParty{1};
     CountingLockCompSwap lockCompSwapTwoParty(1, false, false);
     CountingLockFetch lockFetchTwoParty(1, false, false);
+    CountingLockFutex lockFutexTwoParty(1);
 
     // High Contention
     std::counting_semaphore<CONTENTION_MAX> semaphoreSafe(CONTENTION_MAX);
     CountingLockCompSwap lockCompSwapSafe(CONTENTION_MAX, false, true);
     CountingLockFetch lockFetchSafe(CONTENTION_MAX, false, true);
+    CountingLockFutex lockFutexSafe(CONTENTION_MAX);
 
 
 
     //                              RELEASE         |   DEBUG
 
-    // Simple std::counting_semaphore:     ~ 165 /sec   |   ~ 154 /sec         
-    auto startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < SIMPLE_ITERATIONS;){
-        semaphoreTwoParty.acquire();
-        if(SIMPLE_SLEEP_US > 0) Thread::sleepUs(SIMPLE_SLEEP_US);
-        i++;
-        semaphoreTwoParty.release();
-    }
-    auto endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "Simple counting_semaphore: " << (SIMPLE_ITERATIONS * 1000000) / 
-                    std::max((int64_t)1, std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() - 
-                            (SIMPLE_ITERATIONS * SIMPLE_SLEEP_US)) << "/s" << std::endl;
-
+    // Simple std::counting_semaphore:     ~ 165 /sec   |   ~ 154 /sec
+    measureSimple(bench, "Simple counting_semaphore", semaphoreTwoParty, SIMPLE_ITERATIONS, SIMPLE_SLEEP_US);
 
     // Simple CountingLockCompSwap:        ~ 3651 /sec  |   ~ 1071 /sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < SIMPLE_ITERATIONS;){
-        lockCompSwapTwoParty.acquire();
-        if(SIMPLE_SLEEP_US > 0) Thread::sleepUs(SIMPLE_SLEEP_US);
-        i++;
-        lockCompSwapTwoParty.release();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "Simple CountingLockCompSwap: " << (SIMPLE_ITERATIONS * 1000000) / 
-                    std::max((int64_t)1, std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() - 
-                            (SIMPLE_ITERATIONS * SIMPLE_SLEEP_US)) << "/s" << std::endl;
-
+    measureSimple(bench, "Simple CountingLockCompSwap", lockCompSwapTwoParty, SIMPLE_ITERATIONS, SIMPLE_SLEEP_US);
 
     // Simple CountingLockFetch:           ~ 4337 /sec  |   ~ 1741 /sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < SIMPLE_ITERATIONS;){
-        lockFetchTwoParty.acquire();
-        if(SIMPLE_SLEEP_US > 0) Thread::sleepUs(SIMPLE_SLEEP_US);
-        i++;
-        lockFetchTwoParty.release();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "Simple CountingLockFetch: " << (SIMPLE_ITERATIONS * 1000000) / 
-                    std::max((int64_t)1, std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() - 
-                            (SIMPLE_ITERATIONS * SIMPLE_SLEEP_US)) << "/s" << std::endl;
+    measureSimple(bench, "Simple CountingLockFetch", lockFetchTwoParty, SIMPLE_ITERATIONS, SIMPLE_SLEEP_US);
+
+    // Simple CountingLockFutex:           ~ X /sec
+    measureSimple(bench, "Simple CountingLockFutex", lockFutexTwoParty, SIMPLE_ITERATIONS, SIMPLE_SLEEP_US);
     std::cout << std::endl;
 
 
@@ -84,82 +139,35 @@ int main(){
 
 
     // Contention std::counting_semaphore:  ~ 124 /sec  |   ~ 119 /sec
-    std::atomic<uint32_t> readyCounter{0};
-    std::vector<Thread*> threads;
-    for(uint32_t i=0; i < CONTENTION_THREADS; i++){
-        threads.push_back(new Thread([&semaphoreSafe, CONTENTION_THREADS, CONTENTION_ITERATIONS, &readyCounter](){
-            readyCounter.fetch_add(1);
-            while(readyCounter.load() < CONTENTION_THREADS) std::this_thread::yield();
-
-            for(uint32_t i=0; i < CONTENTION_ITERATIONS;){
-                semaphoreSafe.acquire();
-                if(CONTENTION_SLEEP_US > 0) Thread::sleepUs(CONTENTION_SLEEP_US); else std::this_thread::yield();
-                i++;
-                semaphoreSafe.release();
-            }
-        }));
-    }
-    startTime = std::chrono::high_resolution_clock::now();
-    for(Thread* thr : threads) thr->start();
-    for(Thread* thr : threads) thr->join();
-    endTime = std::chrono::high_resolution_clock::now();
-    for(Thread* thr : threads) delete thr;
-    std::cout << "Contention counting_semaphore: " << (CONTENTION_THREADS * CONTENTION_ITERATIONS * 1000000) / 
-                std::max((int64_t )1, std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() - 
-                    (CONTENTION_ITERATIONS * CONTENTION_SLEEP_US)) << "/s" << std::endl;
-
+    measureContention(bench, "Contention counting_semaphore", semaphoreSafe, CONTENTION_THREADS, CONTENTION_ITERATIONS, CONTENTION_SLEEP_US);
 
     // Contention CountingLockCompSwap:     ~ 114 /sec  |   ~ 91 /sec
-    readyCounter.store(0);
-    threads.clear();
-    for(uint32_t i=0; i < CONTENTION_THREADS; i++){
-        threads.push_back(new Thread([&lockCompSwapSafe, CONTENTION_THREADS, CONTENTION_ITERATIONS, &readyCounter](){
-            readyCounter.fetch_add(1);
-            while(readyCounter.load() < CONTENTION_THREADS) std::this_thread::yield();
-
-            for(uint32_t i=0; i < CONTENTION_ITERATIONS; ){
-                lockCompSwapSafe.acquire();
-                if(CONTENTION_SLEEP_US > 0) Thread::sleepUs(CONTENTION_SLEEP_US); else std::this_thread::yield();
-                i++;
-                lockCompSwapSafe.release();
-            }
-        }));
-    }
-    startTime = std::chrono::high_resolution_clock::now();
-    for(Thread* thr : threads) thr->start();
-    for(Thread* thr : threads) thr->join();
-    endTime = std::chrono::high_resolution_clock::now();
-    for(Thread* thr : threads) delete thr;
-    std::cout << "Contention CountingLockCompSwap: " << (CONTENTION_THREADS * CONTENTION_ITERATIONS * 1000000) / 
-                std::max((int64_t )1, std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() - 
-                    (CONTENTION_ITERATIONS * CONTENTION_SLEEP_US)) << "/s" << std::endl;
-
+    measureContention(bench, "Contention CountingLockCompSwap", lockCompSwapSafe, CONTENTION_THREADS, CONTENTION_ITERATIONS, CONTENTION_SLEEP_US);
 
     // Contention CountingLockFetch:        ~ 128 /sec  |   ~ 127 /sec
-    readyCounter.store(0);
-    threads.clear();
-    for(uint32_t i=0; i < CONTENTION_THREADS; i++){
-        threads.push_back(new Thread([&lockFetchSafe, CONTENTION_THREADS, CONTENTION_ITERATIONS, &readyCounter](){
-            readyCounter.fetch_add(1);
-            while(readyCounter.load() < CONTENTION_THREADS) std::this_thread::yield();
-
-            for(uint32_t i=0; i < CONTENTION_ITERATIONS; ){
-                lockFetchSafe.acquire();
-                if(CONTENTION_SLEEP_US > 0) Thread::sleepUs(CONTENTION_SLEEP_US); else std::this_thread::yield();
-                i++;
-                lockFetchSafe.release();
-            }
-        }));
-    }
-    startTime = std::chrono::high_resolution_clock::now();
-    for(Thread* thr : threads) thr->start();
-    for(Thread* thr : threads) thr->join();
-    endTime = std::chrono::high_resolution_clock::now();
-    for(Thread* thr : threads) delete thr;
-    std::cout << "Contention CountingLockFetch: " << (CONTENTION_THREADS * CONTENTION_ITERATIONS * 1000000) / 
-                std::max((int64_t )1, std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() - 
-                    (CONTENTION_ITERATIONS * CONTENTION_SLEEP_US)) << "/s" << std::endl;
+    measureContention(bench, "Contention CountingLockFetch", lockFetchSafe, CONTENTION_THREADS, CONTENTION_ITERATIONS, CONTENTION_SLEEP_US);
+
+    // Contention CountingLockFutex:        ~ X /sec
+    measureContention(bench, "Contention CountingLockFutex", lockFutexSafe, CONTENTION_THREADS, CONTENTION_ITERATIONS, CONTENTION_SLEEP_US);
     std::cout << std::endl;
 
-    return 0;
+
+
+
+    // Batch acquire(n)/release(n) with CONTENTION_MAX units (units/sec):
+    //                      n=1         |   n=2         |   n=5         |   n=10
+    // CompSwap:            ~ X         |   ~ X         |   ~ X         |   ~ X
+    // Fetch:               ~ X         |   ~ X         |   ~ X         |   ~ X
+    // Futex:               ~ X         |   ~ X         |   ~ X         |   ~ X
+    const uint32_t BATCH_THREADS = 16;
+    const uint32_t BATCH_ITERATIONS = 20000;
+    for(int32_t batch : {1, 2, 5, 10}){
+        const std::string prefix = "Batch " + std::to_string(batch);
+        measureBatch(bench, prefix + " CountingLockCompSwap", lockCompSwapSafe, batch, BATCH_THREADS, BATCH_ITERATIONS);
+        measureBatch(bench, prefix + " CountingLockFetch", lockFetchSafe, batch, BATCH_THREADS, BATCH_ITERATIONS);
+        measureBatch(bench, prefix + " CountingLockFutex", lockFutexSafe, batch, BATCH_THREADS, BATCH_ITERATIONS);
+        std::cout << std::endl;
+    }
+
+    return bench.finish();
 }
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include <cmath> // round
 #include <iostream>
 #include <stdexcept>
+#include <thread>
+#include <vector>
 
 using namespace spi;
 
@@ -71,6 +73,14 @@ void runSimpleTest(){
     delete lockSemaphore;
     std::cout << "Completed Simple Test: CountingLockSemaphore" << std::endl;
     std::cout << std::endl;
+
+
+    std::cout << "Starting Simple Test: CountingLockFutex" << std::endl;
+    AbstractCountingLock* lockFutex = new CountingLockFutex(1);
+    executeSimpleTest(lockFutex);
+    delete lockFutex;
+    std::cout << "Completed Simple Test: CountingLockFutex" << std::endl;
+    std::cout << std::endl;
 }
 
 
@@ -195,6 +205,89 @@ void runHighContentionTest(){
     delete lockSemaphore;
     std::cout << "Completed High Contention Test: CountingLockSemaphore" << std::endl;
     std::cout << std::endl;
+
+
+    std::cout << "Starting High Contention Test: CountingLockFutex" << std::endl;
+    AbstractCountingLock* lockFutex = new CountingLockFutex(MAX);
+    executeMultiThreadedTest(lockFutex, (int32_t)MAX, THREADS, ITERATIONS);
+    delete lockFutex;
+    std::cout << "Completed High Contention Test: CountingLockFutex" << std::endl;
+    std::cout << std::endl;
+}
+
+
+
+
+
+void executeBatchTest(AbstractCountingLock* lock, const int32_t MAX, const uint32_t THREADS, const uint32_t ITERATIONS){
+    std::atomic<int32_t> accessCounter{0};
+    std::atomic<bool> failed{false};
+    std::vector<Thread*> threads;
+
+    for(uint32_t threadId=0; threadId < THREADS; threadId++){
+        threads.push_back(new Thread([&accessCounter, &failed, threadId, lock, MAX, ITERATIONS]{
+            for(uint32_t i=0; i < ITERATIONS; i++){
+                const int32_t count = (int32_t)((threadId + i) % (uint32_t)MAX) + 1; // 1 to MAX
+                lock->acquire(count);
+                int32_t check = accessCounter.fetch_add(count) + count;
+                if(check > MAX){
+                    std::cout << "[ERROR] Counter should be smaller than "+std::to_string(MAX)+" but it is "+std::to_string(check) << std::endl;
+                    failed.store(true);
+                }
+                std::this_thread::yield();
+                accessCounter.fetch_sub(count);
+                lock->release(count);
+            }
+        }));
+    }
+    for(Thread* thr : threads) thr->start();
+    for(Thread* thr : threads){
+        thr->join();
+        delete thr;
+    }
+
+    if(failed.load()) throw std::runtime_error("Batch acquire exceeded maximum");
+    if(lock->acquire(MAX, false) == false) throw std::runtime_error("Lock should be fully available after all threads released");
+    if(lock->acquire(1, false)) throw std::runtime_error("Lock should not be available after acquiring maximum");
+    lock->release(MAX);
+}
+
+
+void runBatchTest(){
+    const uint32_t MAX = 8;
+    const uint32_t THREADS = 16;
+    const uint32_t ITERATIONS = 2000;
+
+    std::cout << "Starting Batch Test: CountingLockCompSwap" << std::endl;
+    AbstractCountingLock* lockCompSwap = new CountingLockCompSwap(MAX, false, true);
+    executeBatchTest(lockCompSwap, (int32_t)MAX, THREADS, ITERATIONS);
+    delete lockCompSwap;
+    std::cout << "Completed Batch Test: CountingLockCompSwap" << std::endl;
+    std::cout << std::endl;
+
+
+    std::cout << "Starting Batch Test: CountingLockFetch" << std::endl;
+    AbstractCountingLock* lockFetch = new CountingLockFetch(MAX, false, true);
+    executeBatchTest(lockFetch, (int32_t)MAX, THREADS, ITERATIONS);
+    delete lockFetch;
+    std::cout << "Completed Batch Test: CountingLockFetch" << std::endl;
+    std::cout << std::endl;
+
+
+    std::cout << "Starting Batch Test: CountingLockSemaphore" << std::endl;
+    AbstractCountingLock* lockSemaphore = new CountingLockSemaphore(MAX);
+    executeBatchTest(lockSemaphore, (int32_t)MAX, THREADS, ITERATIONS);
+    delete lockSemaphore;
+    std::cout << "Completed Batch Test: CountingLockSemaphore" << std::endl;
+    std::cout << std::endl;
+
+
+    std::cout << "Starting Batch Test: CountingLockFutex" << std::endl;
+    AbstractCountingLock* lockFutex = new CountingLockFutex(MAX);
+    executeBatchTest(lockFutex, (int32_t)MAX, THREADS, ITERATIONS);
+    delete lockFutex;
+    std::cout << "Completed Batch Test: CountingLockFutex" << std::endl;
+    std::cout << std::endl;
 }
 
 
@@ -205,5 +298,7 @@ int main(){
 
     runHighContentionTest();
 
+    runBatchTest();
+
     return 0;
 }
\ No newline at end of file
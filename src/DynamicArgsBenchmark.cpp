@@ -1,3 +1,5 @@
+#include "./utils/Benchmark.hpp"
+
 #include <iostream>
 #include <functional>
 #include <tuple>
@@ -199,7 +201,8 @@ void exampleFunction2(size_t a, size_t b) {
 
 
 
-int main() {
+int main(int argc, char** argv){
+    spi::Benchmark bench("dynamic_args_benchmark", argc, argv);
     const size_t ITERATIONS = 50000000;
     size_t additionalValue = 42; // can be of any type
 
@@ -252,21 +255,19 @@ int main() {
     // [ NO DYNAMIC ARGS - REFERENCE ]
 
     // NoDynamicArgs(void):                                 ~ 1960 Mio/sec  |   ~ 171.3 Mio/sec
-    auto start = std::chrono::high_resolution_clock::now();
-    for (size_t i = 0; i < ITERATIONS; ++i) {
-        cb1NoArgs.execute(i, i);
-    }
-    auto end = std::chrono::high_resolution_clock::now();
-    std::cout << "NoDynamicArgs(void): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << "/s" << std::endl;
+    bench.run("NoDynamicArgs(void)", ITERATIONS, [&](){
+        for (size_t i = 0; i < ITERATIONS; ++i) {
+            cb1NoArgs.execute(i, i);
+        }
+    });
 
 
     // StaticCallbackAndNoDynArgs(size_t):                 ~ 1973 Mio/sec  |   ~ 16.5 Mio/sec
-    start = std::chrono::high_resolution_clock::now();
-    for (size_t i = 0; i < ITERATIONS; ++i) {
-        cb1StaticNoArgs.execute(std::make_tuple(i, i));
-    }
-    end = std::chrono::high_resolution_clock::now();
-    std::cout << "StaticCallbackAndNoDynArgs(size_t): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << "/s" << std::endl;
+    bench.run("StaticCallbackAndNoDynArgs(size_t)", ITERATIONS, [&](){
+        for (size_t i = 0; i < ITERATIONS; ++i) {
+            cb1StaticNoArgs.execute(std::make_tuple(i, i));
+        }
+    });
     std::cout << std::endl;
 
 
@@ -276,56 +277,50 @@ int main() {
     // [ NO MANDATORY ARGS ]
 
     // CallbackNoMandatoryApply(void):                      ~ 1142 Mio/sec  |   ~ 38.0 Mio/sec
-    start = std::chrono::high_resolution_clock::now();
-    for (size_t i = 0; i < ITERATIONS; ++i) {
-        cb1NoMandatoryApply.execute();
-    }
-    end = std::chrono::high_resolution_clock::now();
-    std::cout << "NoMandatoryArgs(void): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << "/s" << std::endl;
+    bench.run("NoMandatoryArgs(void)", ITERATIONS, [&](){
+        for (size_t i = 0; i < ITERATIONS; ++i) {
+            cb1NoMandatoryApply.execute();
+        }
+    });
 
     // CallbackNoMandatoryApply(size_t):                    ~ 1559 Mio/sec  |   ~ 24.1 Mio/sec
-    start = std::chrono::high_resolution_clock::now();
-    for (size_t i = 0; i < ITERATIONS; ++i) {
-        cb2NoMandatoryApply.execute();
-    }
-    end = std::chrono::high_resolution_clock::now();
-    std::cout << "NoMandatoryArgs(size_t): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << "/s" << std::endl;
+    bench.run("NoMandatoryArgs(size_t)", ITERATIONS, [&](){
+        for (size_t i = 0; i < ITERATIONS; ++i) {
+            cb2NoMandatoryApply.execute();
+        }
+    });
 
 
 
     // CallbackNoMandatoryIndexSeqHelper(void):             ~ 1029 Mio/sec  |   ~ 137.1 Mio/sec
-    start = std::chrono::high_resolution_clock::now();
-    for (size_t i = 0; i < ITERATIONS; ++i) {
-        cb1NoMandatoryIndexSeqHelper.execute();
-    }
-    end = std::chrono::high_resolution_clock::now();
-    std::cout << "NoMandatoryIndexSeqHelper(void): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << "/s" << std::endl;
+    bench.run("NoMandatoryIndexSeqHelper(void)", ITERATIONS, [&](){
+        for (size_t i = 0; i < ITERATIONS; ++i) {
+            cb1NoMandatoryIndexSeqHelper.execute();
+        }
+    });
 
     // CallbackNoMandatoryIndexSeqHelper(size_t):           ~ 2920 Mio/sec  |   ~ 53.2 Mio/sec
-    start = std::chrono::high_resolution_clock::now();
-    for (size_t i = 0; i < ITERATIONS; ++i) {
-        cb2NoMandatoryIndexSeqHelper.execute();
-    }
-    end = std::chrono::high_resolution_clock::now();
-    std::cout << "NoMandatoryIndexSeqHelper(size_t): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << "/s" << std::endl;
+    bench.run("NoMandatoryIndexSeqHelper(size_t)", ITERATIONS, [&](){
+        for (size_t i = 0; i < ITERATIONS; ++i) {
+            cb2NoMandatoryIndexSeqHelper.execute();
+        }
+    });
 
 
 
     // CallbackNoMandatoryIndexSeqLambda(void):             ~ 2656 Mio/sec  |   ~ 33.1 Mio/sec
-    start = std::chrono::high_resolution_clock::now();
-    for (size_t i = 0; i < ITERATIONS; ++i) {
-        cb1NoMandatoryIndexSeqLambda.execute();
-    }
-    end = std::chrono::high_resolution_clock::now();
-    std::cout << "NoMandatoryIndexSeqLambda(void): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << "/s" << std::endl;
+    bench.run("NoMandatoryIndexSeqLambda(void)", ITERATIONS, [&](){
+        for (size_t i = 0; i < ITERATIONS; ++i) {
+            cb1NoMandatoryIndexSeqLambda.execute();
+        }
+    });
 
     // CallbackNoMandatoryIndexSeqLambda(size_t):           ~ 1555 Mio/sec  |   ~ 22.8 Mio/sec
-    start = std::chrono::high_resolution_clock::now();
-    for (size_t i = 0; i < ITERATIONS; ++i) {
-        cb2NoMandatoryIndexSeqLambda.execute();
-    }
-    end = std::chrono::high_resolution_clock::now();
-    std::cout << "NoMandatoryIndexSeqLambda(size_t): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << "/s" << std::endl;
+    bench.run("NoMandatoryIndexSeqLambda(size_t)", ITERATIONS, [&](){
+        for (size_t i = 0; i < ITERATIONS; ++i) {
+            cb2NoMandatoryIndexSeqLambda.execute();
+        }
+    });
     std::cout << std::endl;
 
 
@@ -335,57 +330,51 @@ int main() {
     // [ WITH MANDATORY ARGS ]
 
     // CallbackWithMandatoryTupleCat(void):                 ~ 1576 Mio/sec  |   ~ 8.8 Mio/sec
-    start = std::chrono::high_resolution_clock::now();
-    for (size_t i = 0; i < ITERATIONS; ++i) {
-        cb1WithMandatoryTupleCat.execute(i);
-    }
-    end = std::chrono::high_resolution_clock::now();
-    std::cout << "WithMandatoryTupleCat(void): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << "/s" << std::endl;
+    bench.run("WithMandatoryTupleCat(void)", ITERATIONS, [&](){
+        for (size_t i = 0; i < ITERATIONS; ++i) {
+            cb1WithMandatoryTupleCat.execute(i);
+        }
+    });
 
     // CallbackWithMandatoryTupleCat(size_t):               ~ 2763 Mio/sec  |   ~ 6.7 Mio/sec
-    start = std::chrono::high_resolution_clock::now();
-    for (size_t i = 0; i < ITERATIONS; ++i) {
-        cb2WithMandatoryTupleCat.execute(i);
-    }
-    end = std::chrono::high_resolution_clock::now();
-    std::cout << "WithMandatoryTupleCat(size_t): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << "/s" << std::endl;
+    bench.run("WithMandatoryTupleCat(size_t)", ITERATIONS, [&](){
+        for (size_t i = 0; i < ITERATIONS; ++i) {
+            cb2WithMandatoryTupleCat.execute(i);
+        }
+    });
 
 
 
     // CallbackWithMandatoryIndexSeqHelper(void):           ~ 2801 Mio/sec  |   ~ 122.5 Mio/sec
-    start = std::chrono::high_resolution_clock::now();
-    for (size_t i = 0; i < ITERATIONS; ++i) {
-        cb1WithMandatoryIndexSeqHelper.execute(i);
-    }
-    end = std::chrono::high_resolution_clock::now();
-    std::cout << "WithMandatoryIndexSeqHelper(void): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << "/s" << std::endl;
+    bench.run("WithMandatoryIndexSeqHelper(void)", ITERATIONS, [&](){
+        for (size_t i = 0; i < ITERATIONS; ++i) {
+            cb1WithMandatoryIndexSeqHelper.execute(i);
+        }
+    });
 
     // CallbackWithMandatoryIndexSeqHelper(size_t):         ~ 2800 Mio/sec  |   ~ 49.8 Mio/sec
-    start = std::chrono::high_resolution_clock::now();
-    for (size_t i = 0; i < ITERATIONS; ++i) {
-        cb2WithMandatoryIndexSeqHelper.execute(i);
-    }
-    end = std::chrono::high_resolution_clock::now();
-    std::cout << "WithMandatoryIndexSeqHelper(size_t): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << "/s" << std::endl;
+    bench.run("WithMandatoryIndexSeqHelper(size_t)", ITERATIONS, [&](){
+        for (size_t i = 0; i < ITERATIONS; ++i) {
+            cb2WithMandatoryIndexSeqHelper.execute(i);
+        }
+    });
 
 
 
     // CallbackWithMandatoryIndexSeqLambda(void):           ~ 1551 Mio/sec  |   ~ 31.5 Mio/sec
-    start = std::chrono::high_resolution_clock::now();
-    for (size_t i = 0; i < ITERATIONS; ++i) {
-        cb1WithMandatoryIndexSeqLambda.execute(i);
-    }
-    end = std::chrono::high_resolution_clock::now();
-    std::cout << "WithMandatoryIndexSeqLambda(void): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << "/s" << std::endl;
+    bench.run("WithMandatoryIndexSeqLambda(void)", ITERATIONS, [&](){
+        for (size_t i = 0; i < ITERATIONS; ++i) {
+            cb1WithMandatoryIndexSeqLambda.execute(i);
+        }
+    });
 
     // CallbackWithMandatoryIndexSeqLambda(size_t):         ~ 1544 Mio/sec  |   ~ 22.4 Mio/sec
-    start = std::chrono::high_resolution_clock::now();
-    for (size_t i = 0; i < ITERATIONS; ++i) {
-        cb2WithMandatoryIndexSeqLambda.execute(i);
-    }
-    end = std::chrono::high_resolution_clock::now();
-    std::cout << "WithMandatoryIndexSeqLambda(size_t): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << "/s" << std::endl;
+    bench.run("WithMandatoryIndexSeqLambda(size_t)", ITERATIONS, [&](){
+        for (size_t i = 0; i < ITERATIONS; ++i) {
+            cb2WithMandatoryIndexSeqLambda.execute(i);
+        }
+    });
     std::cout << std::endl;
 
-    return 0;
+    return bench.finish();
 }
@@ -1,7 +1,12 @@
-#include <algorithm>
-#include <chrono>
+#include "./utils/Benchmark.hpp"
+#include "./utils/Endian.hpp"
+#include "./utils/MetricsUtils.hpp"
+
 #include <cstdint>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 #include <arpa/inet.h>
 #include <cstdlib>
@@ -9,6 +14,7 @@
 
 
 const uint64_t ITERATIONS = 5000000000;
+const uint64_t BULK_BYTES = 512ull * 1024 * 1024; // converted per bulk benchmark
 
 
 
@@ -113,7 +119,58 @@ static inline void setInt32BE(uint8_t *arr, int32_t value){
 
 
 
-int main(){
+/**
+ * Compares the bulk conversions with the scalar ones for all lengths up to 300 values (covers all vector tails).
+ */
+template<typename T>
+void verifyBulk(){
+    for(size_t count=0; count <= 300; count++){
+        std::vector<T> src(count), dst(count);
+        for(size_t i=0; i < count; i++) src[i] = (T)((i + 1) * 0x0102030405060708ull);
+        spi::Endian::swap<T>(src, dst);
+        for(size_t i=0; i < count; i++)
+            if(dst[i] != spi::Endian::swap(src[i])) throw std::runtime_error("Bulk swap of " + std::to_string(sizeof(T) * 8) + " bit values failed at length " + std::to_string(count));
+        spi::Endian::swap<T>(dst); // in place
+        if(dst != src) throw std::runtime_error("In place swap of " + std::to_string(sizeof(T) * 8) + " bit values failed at length " + std::to_string(count));
+    }
+}
+
+
+/**
+ * Converts a buffer of the given size to big endian until BULK_BYTES got converted
+ * once one value at a time and once with Endian::toBig() and prints the throughput.
+ */
+template<typename T>
+void measureBulk(spi::Benchmark &bench, size_t bufferBytes){
+    const size_t count = bufferBytes / sizeof(T);
+    const uint64_t rounds = BULK_BYTES / bufferBytes;
+    std::vector<T> src(count), dst(count);
+    for(size_t i=0; i < count; i++) src[i] = (T)(i * 0x0102030405060708ull);
+    const std::string suffix = std::to_string(sizeof(T) * 8) + " bit (" + spi::MetricsUtils::byteSizeToString(bufferBytes, 0) + ")";
+
+    spi::BenchmarkResult scalar = bench.run("Bulk scalar " + suffix, rounds * count, [&](){
+        for(uint64_t r=0; r < rounds; r++){
+            for(size_t i=0; i < count; i++) dst[i] = spi::Endian::toBig(src[i]);
+            spi::Benchmark::doNotOptimize(dst.data());
+        }
+    });
+    if(scalar.operations > 0) std::cout << "  " << spi::MetricsUtils::bytesPerSecToString(scalar.opsPerSec() * sizeof(T)) << std::endl;
+
+    spi::BenchmarkResult simd = bench.run("Bulk " + std::string(spi::Endian::simdName()) + " " + suffix, rounds * count, [&](){
+        for(uint64_t r=0; r < rounds; r++){
+            spi::Endian::toBig<T>(src, dst);
+            spi::Benchmark::doNotOptimize(dst.data());
+        }
+    });
+    if(simd.operations > 0) std::cout << "  " << spi::MetricsUtils::bytesPerSecToString(simd.opsPerSec() * sizeof(T)) << std::endl;
+
+    spi::Endian::fromBig<T>(dst);
+    if(dst != src) throw std::runtime_error("Bulk conversion of " + suffix + " is not reversible");
+}
+
+
+int main(int argc, char** argv){
+    spi::Benchmark bench("endian_benchmark", argc, argv);
     const uint64_t HALF_ITERATIONS = ITERATIONS >> 1;
     uint8_t *arr = (uint8_t*)malloc(4);
 
@@ -129,89 +186,97 @@ int main(){
 
 
     // Naive():         ~ 523 Mio/sec   |   ~ 108 Mio/sec
-    auto startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        int32_t value = (int32_t)(i - HALF_ITERATIONS);
-        setInt32Naive(arr, value);
-        int32_t result = getInt32Naive(arr);
-        if(value != result){
-            std::cout << "Naive error with " << value << " -> " << result << std::endl;
+    bench.run("Naive()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            int32_t value = (int32_t)(i - HALF_ITERATIONS);
+            setInt32Naive(arr, value);
+            int32_t result = getInt32Naive(arr);
+            if(value != result){
+                std::cout << "Naive error with " << value << " -> " << result << std::endl;
+            }
         }
-    }
-    auto endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "Naive: " << (ITERATIONS * 1000000) / std::max(std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count(), (int64_t)1) << "/s" << std::endl;
+    });
 
 
     // Optimized1():    ~ 525 Mio/sec   |   ~ 98 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        int32_t value = (int32_t)(i - HALF_ITERATIONS);    
-        setInt32Optimized1(arr, value);
-        int32_t result = getInt32Optimized1(arr);
-        if(value != result){
-            std::cout << "Optimized1 error with " << value << " -> " << result << std::endl;
+    bench.run("Optimized1()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            int32_t value = (int32_t)(i - HALF_ITERATIONS);    
+            setInt32Optimized1(arr, value);
+            int32_t result = getInt32Optimized1(arr);
+            if(value != result){
+                std::cout << "Optimized1 error with " << value << " -> " << result << std::endl;
+            }
         }
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "Optimized1(): " << (ITERATIONS * 1000000) / std::max(std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count(), (int64_t)1) << "/s" << std::endl;
+    });
 
 
     // Optimized2():    ~ 3123 Mio/sec  |   ~ 65 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        int32_t value = (int32_t)(i - HALF_ITERATIONS);    
-        setInt32Optimized2(arr, value);
-        int32_t result = getInt32Optimized2(arr);
-        if(value != result){
-            std::cout << "Optimized2 error with " << value << " -> " << result << std::endl;
+    bench.run("Optimized2()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            int32_t value = (int32_t)(i - HALF_ITERATIONS);    
+            setInt32Optimized2(arr, value);
+            int32_t result = getInt32Optimized2(arr);
+            if(value != result){
+                std::cout << "Optimized2 error with " << value << " -> " << result << std::endl;
+            }
         }
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "Optimized2(): " << (ITERATIONS * 1000000) / std::max(std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count(), (int64_t)1) << "/s" << std::endl;
+    });
 
 
     // HtoN():          ~ 3135 Mio/sec  |   ~ 144 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        int32_t value = (int32_t)(i - HALF_ITERATIONS);    
-        setInt32HTONL(arr, value);
-        int32_t result = getInt32HTONL(arr);
-        if(value != result){
-            std::cout << "HtoN error with " << value << " -> " << result << std::endl;
+    bench.run("HtoN()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            int32_t value = (int32_t)(i - HALF_ITERATIONS);    
+            setInt32HTONL(arr, value);
+            int32_t result = getInt32HTONL(arr);
+            if(value != result){
+                std::cout << "HtoN error with " << value << " -> " << result << std::endl;
+            }
         }
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "HtoN(): " << (ITERATIONS * 1000000) / std::max(std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count(), (int64_t)1) << "/s" << std::endl;
+    });
 
 
     // HtoLE():         ~ ???? Mio/sec  |   ~ 91 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        int32_t value = (int32_t)(i - HALF_ITERATIONS);    
-        setInt32LE(arr, value);
-        int32_t result = getInt32LE(arr);
-        if(value != result){
-            std::cout << "HtoLE error with " << value << " -> " << result << std::endl;
+    bench.run("HtoLE()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            int32_t value = (int32_t)(i - HALF_ITERATIONS);    
+            setInt32LE(arr, value);
+            int32_t result = getInt32LE(arr);
+            if(value != result){
+                std::cout << "HtoLE error with " << value << " -> " << result << std::endl;
+            }
         }
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "HtoLE(): " << (ITERATIONS * 1000000) / std::max(std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count(), (int64_t)1) << "/s" << std::endl;
+    });
 
 
     // HtoBE():         ~ 1570 Mio/sec  |   ~ 92 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        int32_t value = (int32_t)(i - HALF_ITERATIONS);    
-        setInt32BE(arr, value);
-        int32_t result = getInt32BE(arr);
-        if(value != result){
-            std::cout << "HtoBE error with " << value << " -> " << result << std::endl;
+    bench.run("HtoBE()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            int32_t value = (int32_t)(i - HALF_ITERATIONS);    
+            setInt32BE(arr, value);
+            int32_t result = getInt32BE(arr);
+            if(value != result){
+                std::cout << "HtoBE error with " << value << " -> " << result << std::endl;
+            }
         }
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "HtoBE(): " << (ITERATIONS * 1000000) / std::max(std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count(), (int64_t)1) << "/s" << std::endl;
+    });
 
 
     free(arr);
-    return 0;
+
+
+    // Bulk conversions (values per second)
+    std::cout << std::endl << "Bulk conversions using " << spi::Endian::simdName() << std::endl;
+    verifyBulk<uint16_t>();
+    verifyBulk<uint32_t>();
+    verifyBulk<uint64_t>();
+    static_assert(spi::Endian::swap((uint32_t)0x11223344) == 0x44332211, "Scalar swap should be constexpr");
+    for(size_t bufferBytes : {(size_t)16 * 1024, (size_t)64 * 1024 * 1024}){
+        measureBulk<uint16_t>(bench, bufferBytes);
+        measureBulk<uint32_t>(bench, bufferBytes);
+        measureBulk<uint64_t>(bench, bufferBytes);
+    }
+
+    return bench.finish();
 }
@@ -0,0 +1,127 @@
+#include "./utils/EpochReclamation.hpp"
+#include "./utils/QueueAdapter.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace spi;
+
+
+std::atomic<uint64_t> destroyed{0};
+
+struct Tracked {
+    ~Tracked(){
+        destroyed.fetch_add(1);
+    }
+};
+
+
+void runReclaimTest(){
+    const uint64_t COUNT = 1000;
+    const uint64_t before = destroyed.load();
+
+    // a thread pinned before the objects got retired keeps them alive
+    std::atomic<bool> pinned{false}, release{false};
+    std::thread reader([&]{
+        EpochReclamation::Guard guard;
+        pinned = true;
+        while(!release.load()) std::this_thread::yield();
+    });
+    while(!pinned.load()) std::this_thread::yield();
+    for(uint64_t i=0; i < COUNT; i++) EpochReclamation::retire(new Tracked());
+    for(int i=0; i < 10; i++) EpochReclamation::reclaim();
+    if(destroyed.load() != before)
+        throw std::runtime_error("ReclaimTest: "+std::to_string(destroyed.load() - before)+" objects freed while a reader was pinned");
+
+    release = true;
+    reader.join();
+    for(int i=0; i < 10 && EpochReclamation::getPending() > 0; i++) EpochReclamation::reclaim();
+    if(destroyed.load() != before + COUNT || EpochReclamation::getPending() != 0)
+        throw std::runtime_error("ReclaimTest: only "+std::to_string(destroyed.load() - before)+" of "+std::to_string(COUNT)+" objects freed");
+
+    // nested guards only unpin with the outermost one
+    {
+        EpochReclamation::Guard outer;
+        { EpochReclamation::Guard inner; }
+        const uint64_t epoch = EpochReclamation::getEpoch();
+        std::thread other([]{ for(int i=0; i < 10; i++) EpochReclamation::reclaim(); EpochReclamation::retire(new Tracked()); });
+        other.join();
+        if(EpochReclamation::getEpoch() > epoch + 1) throw std::runtime_error("ReclaimTest: epoch advanced past a pinned thread");
+    }
+    std::cout << "Completed ReclaimTest successfully" << std::endl;
+}
+
+
+void runTaggedPointerTest(){
+    int a = 1, b = 2;
+    AtomicTaggedPointer<int> pointer(&a);
+    TaggedPointer<int> stale = pointer.load();
+    TaggedPointer<int> current = stale;
+    while(!pointer.compareExchange(current, &b));
+    current = pointer.load();
+    while(!pointer.compareExchange(current, &a)); // same pointer as before but a new tag
+    TaggedPointer<int> expected = stale;
+    if(pointer.compareExchange(expected, &b) || pointer.load().ptr != &a || expected.tag != stale.tag + 2)
+        throw std::runtime_error("TaggedPointerTest: stale value got exchanged (ABA)");
+    std::cout << "Completed TaggedPointerTest successfully" << std::endl;
+}
+
+
+/**
+ * Several producers and consumers at once, every element must arrive exactly once.
+ */
+template<typename Q>
+void runQueueTest(const std::string &name, size_t batch = 1){
+    const int PRODUCERS = 4, CONSUMERS = 4;
+    const uint64_t PER_PRODUCER = 100000;
+    Q queue;
+    QueueAdapter<Q> adapter(queue);
+    std::atomic<uint64_t> popped{0}, sum{0};
+    std::vector<std::thread> threads;
+    for(int p=0; p < PRODUCERS; p++){
+        threads.emplace_back([&, p]{
+            std::vector<uint64_t> values(batch);
+            for(uint64_t i=0; i < PER_PRODUCER; i += batch){
+                const size_t count = (size_t)std::min<uint64_t>(batch, PER_PRODUCER - i);
+                for(size_t j=0; j < count; j++) values[j] = (uint64_t)p * PER_PRODUCER + i + j;
+                adapter.pushBulk(values.data(), count);
+            }
+        });
+    }
+    for(int c=0; c < CONSUMERS; c++){
+        threads.emplace_back([&]{
+            std::vector<uint64_t> values(batch);
+            uint64_t localSum = 0;
+            while(popped.load(std::memory_order_relaxed) < PRODUCERS * PER_PRODUCER){
+                const size_t count = adapter.popBulk(values.data(), batch);
+                for(size_t j=0; j < count; j++) localSum += values[j];
+                popped.fetch_add(count, std::memory_order_relaxed);
+            }
+            sum.fetch_add(localSum);
+        });
+    }
+    for(std::thread &thread : threads) thread.join();
+    const uint64_t total = PRODUCERS * PER_PRODUCER;
+    uint64_t value;
+    if(popped.load() != total || sum.load() != total * (total - 1) / 2 || adapter.pop(value) || !queue.empty())
+        throw std::runtime_error(name+": popped "+std::to_string(popped.load())+" of "+std::to_string(total)+" elements with wrong sum");
+    std::cout << "Completed " << name << " successfully" << std::endl;
+}
+
+
+int main(){
+    runReclaimTest();
+    runTaggedPointerTest();
+    runQueueTest<QueueAtomic<uint64_t>>("QueueAtomicTest");
+    runQueueTest<QueueTwoPartyHighContention<uint64_t>>("QueueTwoPartyHighContentionTest");
+    runQueueTest<QueueAtomic<uint64_t>>("QueueAtomicBulkTest", 16);
+    runQueueTest<QueueLock<uint64_t>>("QueueLockBulkTest", 16);
+    runQueueTest<QueueLockCustom<uint64_t>>("QueueLockCustomBulkTest", 16);
+    return 0;
+}
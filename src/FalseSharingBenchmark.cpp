@@ -0,0 +1,122 @@
+#include "./utils/Benchmark.hpp"
+#include "./utils/CallbackQueueRecycle.hpp"
+#include "./utils/CallbackQueueTwoParty.hpp"
+#include "./utils/CallbackQueueTwoPartyInline.hpp"
+#include "./utils/HardwareUtils.hpp"
+#include "./utils/QueueAdapter.hpp"
+#include "./utils/Thread.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+using namespace spi;
+
+/*
+ * Two-thread throughput of the classes whose fields got separated into cache lines.
+ * Built twice: false_sharing_benchmark uses the regular layout and
+ * false_sharing_benchmark_unpadded defines SPI_CACHE_LINE_SIZE=8 which packs all fields
+ * like before they were padded, so running both shows the effect of the padding.
+ */
+
+const uint64_t COUNTER_ITERATIONS = 100000000;
+const uint64_t QUEUE_ITERATIONS = 10000000;
+
+
+/**
+ * Two threads increment their own counter that lives at the given addresses.
+ */
+void runCounters(Benchmark &bench, const std::string &name, std::atomic<uint64_t> &first, std::atomic<uint64_t> &second){
+    bench.run(name, COUNTER_ITERATIONS * 2, [&](BenchmarkTimer &timer){
+        Thread a([&first]{ for(uint64_t i=0; i < COUNTER_ITERATIONS; i++) first.fetch_add(1, std::memory_order_relaxed); });
+        Thread b([&second]{ for(uint64_t i=0; i < COUNTER_ITERATIONS; i++) second.fetch_add(1, std::memory_order_relaxed); });
+        bench.pin(a, 0);
+        bench.pin(b, 1);
+        timer.start();
+        a.start();
+        b.start();
+        a.join();
+        b.join();
+        timer.stop();
+    });
+}
+
+
+/**
+ * One producer pushes and one consumer pops QUEUE_ITERATIONS elements.
+ */
+template<typename Q>
+void runQueue(Benchmark &bench, const std::string &name){
+    bench.run(name, QUEUE_ITERATIONS, [&](BenchmarkTimer &timer){
+        Q queue;
+        QueueAdapter<Q> adapter(queue);
+        Thread producer([&adapter]{ for(uint64_t i=0; i < QUEUE_ITERATIONS; i++) adapter.push(i); });
+        Thread consumer([&adapter]{
+            uint64_t value = 0, popped = 0;
+            while(popped < QUEUE_ITERATIONS) if(adapter.pop(value)) popped++;
+            Benchmark::doNotOptimize(value);
+        });
+        bench.pin(producer, 0);
+        bench.pin(consumer, 1);
+        timer.start();
+        producer.start();
+        consumer.start();
+        producer.join();
+        consumer.join();
+        timer.stop();
+    });
+}
+
+
+uint64_t executedCallbacks = 0; // only touched by the executing thread
+
+bool countCallback(){
+    executedCallbacks++;
+    return true;
+}
+
+/**
+ * One thread pushes QUEUE_ITERATIONS callbacks, another thread executes them.
+ */
+template<typename Q, typename Push>
+void runCallbackQueue(Benchmark &bench, const std::string &name, Push push){
+    bench.run(name, QUEUE_ITERATIONS, [&](BenchmarkTimer &timer){
+        Q queue;
+        executedCallbacks = 0;
+        Thread producer([&queue, &push]{ for(uint64_t i=0; i < QUEUE_ITERATIONS; i++) push(queue); });
+        Thread consumer([&queue]{
+            while(executedCallbacks < QUEUE_ITERATIONS) queue.execute();
+        });
+        bench.pin(producer, 0);
+        bench.pin(consumer, 1);
+        timer.start();
+        producer.start();
+        consumer.start();
+        producer.join();
+        consumer.join();
+        timer.stop();
+    });
+}
+
+
+int main(int argc, char** argv){
+    Benchmark bench("false_sharing_benchmark", argc, argv);
+    std::cout << "CACHE_LINE_SIZE: " << CACHE_LINE_SIZE << " bytes" << std::endl << std::endl;
+
+    struct { std::atomic<uint64_t> first{0}, second{0}; } packed;
+    runCounters(bench, "Counters adjacent", packed.first, packed.second);
+    CacheAligned<std::atomic<uint64_t>> aligned[2] = {0, 0};
+    runCounters(bench, "Counters CacheAligned", *aligned[0], *aligned[1]);
+    std::cout << std::endl;
+
+    runQueue<QueueTwoPartyAtomic<uint64_t>>(bench, "QueueTwoPartyAtomic");
+    runQueue<QueueTwoPartyNoCritical<uint64_t>>(bench, "QueueTwoPartyNoCritical");
+    std::cout << std::endl;
+
+    runCallbackQueue<CallbackQueueRecycle>(bench, "CallbackQueueRecycle", [](CallbackQueueRecycle &q){ q.push(countCallback); });
+    runCallbackQueue<CallbackQueueTwoParty<bool(*)()>>(bench, "CallbackQueueTwoParty", [](CallbackQueueTwoParty<bool(*)()> &q){ q.push(countCallback); });
+    runCallbackQueue<CallbackQueueTwoPartyInline<>>(bench, "CallbackQueueTwoPartyInline", [](CallbackQueueTwoPartyInline<> &q){ q.push(countCallback); });
+
+    return bench.finish();
+}
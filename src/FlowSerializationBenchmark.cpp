@@ -0,0 +1,118 @@
+#include "./utils/Benchmark.hpp"
+#include "./utils/Endian.hpp"
+#include "./utils/FlowExpression.hpp"
+#include "./utils/FlowRepresentation.hpp"
+#include "./utils/FlowSerialization.hpp"
+#include "./utils/MetricsUtils.hpp"
+#include "./utils/Tuple.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace spi;
+
+
+const uint64_t RECORD_BYTES = 1024ull * 1024 * 1024; // encoded/decoded per record benchmark
+const uint64_t GRAPH_ITERATIONS = 1000000;
+
+
+/**
+ * Writes and reads records of the given amount of tuples back to back through one buffer.
+ */
+void measureRecords(Benchmark &bench, size_t tuplesPerRecord){
+    const size_t recordsPerBuffer = std::max((size_t)1, (size_t)(8 * 1024 * 1024) / FlowTupleRecord::size(tuplesPerRecord));
+    const uint64_t rounds = std::max((uint64_t)1, RECORD_BYTES / (recordsPerBuffer * FlowTupleRecord::size(tuplesPerRecord)));
+    const uint64_t tuples = rounds * recordsPerBuffer * tuplesPerRecord;
+    std::vector<Tuple> source;
+    for(size_t i=0; i < tuplesPerRecord; i++) source.push_back(Tuple((uint32_t)(i * 2654435761u)));
+    std::vector<uint64_t> wire((recordsPerBuffer * FlowTupleRecord::size(tuplesPerRecord) + 7) / 8); // 8 byte aligned
+    uint8_t* buffer = reinterpret_cast<uint8_t*>(wire.data());
+    const size_t capacity = wire.size() * 8;
+    const std::string suffix = std::to_string(tuplesPerRecord) + " tuples/record";
+
+    BenchmarkResult encode = bench.run("Record encode " + suffix, tuples, [&](){
+        for(uint64_t r=0; r < rounds; r++){
+            size_t offset = 0;
+            for(size_t i=0; i < recordsPerBuffer; i++)
+                offset += FlowTupleRecord::write(buffer + offset, capacity - offset, source.data(), tuplesPerRecord, i);
+            Benchmark::doNotOptimize(buffer);
+        }
+    });
+    if(encode.operations > 0) std::cout << "  " << MetricsUtils::bytesPerSecToString(encode.opsPerSec() * sizeof(uint32_t)) << std::endl;
+
+    // records are read in place, consuming every value keeps the comparison honest
+    uint64_t checksum = 0;
+    BenchmarkResult decode = bench.run("Record decode in place " + suffix, tuples, [&](){
+        for(uint64_t r=0; r < rounds; r++){
+            size_t offset = 0;
+            for(size_t i=0; i < recordsPerBuffer; i++){
+                FlowTupleRecord record = FlowTupleRecord::open(buffer + offset, capacity - offset);
+                const uint32_t* values = record.valueColumn();
+                for(size_t j=0; j < record.count(); j++) checksum += values[j];
+                offset += record.bytes();
+            }
+        }
+        Benchmark::doNotOptimize(checksum);
+    });
+    if(decode.operations > 0) std::cout << "  " << MetricsUtils::bytesPerSecToString(decode.opsPerSec() * sizeof(uint32_t)) << std::endl;
+
+    // what a big-endian (network order) wire format would cost a little-endian host on both sides
+    std::vector<uint32_t> host(tuplesPerRecord);
+    BenchmarkResult swapped = bench.run("Record big-endian encode+decode " + suffix + " (" + Endian::simdName() + ")", tuples, [&](){
+        for(uint64_t r=0; r < rounds; r++){
+            size_t offset = 0;
+            for(size_t i=0; i < recordsPerBuffer; i++){
+                uint32_t* payload = reinterpret_cast<uint32_t*>(buffer + offset + FlowTupleRecord::HEADER_SIZE);
+                Endian::toBig<uint32_t>(std::span<const uint32_t>(reinterpret_cast<const uint32_t*>(source.data()), tuplesPerRecord),
+                                        std::span<uint32_t>(payload, tuplesPerRecord));
+                Endian::fromBig<uint32_t>(std::span<const uint32_t>(payload, tuplesPerRecord), std::span<uint32_t>(host));
+                offset += FlowTupleRecord::size(tuplesPerRecord);
+            }
+            Benchmark::doNotOptimize(host.data());
+        }
+    });
+    if(swapped.operations > 0) std::cout << "  " << MetricsUtils::bytesPerSecToString(swapped.opsPerSec() * sizeof(uint32_t)) << std::endl;
+}
+
+
+int main(int argc, char** argv){
+    Benchmark bench("flow_serialization_benchmark", argc, argv);
+    std::cout << (Endian::HOST_IS_LITTLE ? "Little endian" : "Big endian") << " host, bulk conversions use " << Endian::simdName() << std::endl;
+
+    for(size_t tuplesPerRecord : {16, 256, 4096, 65536})
+        measureRecords(bench, tuplesPerRecord);
+
+
+    // Flow graphs
+    std::cout << std::endl;
+    const FlowDynamicExpression field = FlowDynamicExpression::field();
+    std::unique_ptr<FlowOutput> graph = (new FlowInput({"worker1", "worker2"}, {"sensors"}))
+            ->filter(field % 3 != 0 || field < 100).release()
+            ->partition(field % 5, 4, true).release()
+            ->filter(FlowValueRange{50, 80000}).release()
+            ->filter(FlowValueCompare{FlowCompare::NOT_EQUAL, 1000}).release()->output();
+    const std::vector<uint8_t> bytes = FlowGraphCodec::encode(*graph);
+    std::cout << "Graph of 6 operators encodes into " << bytes.size() << " bytes" << std::endl;
+
+    bench.run("Graph encode", GRAPH_ITERATIONS, [&](){
+        for(uint64_t i=0; i < GRAPH_ITERATIONS; i++){
+            std::vector<uint8_t> encoded = FlowGraphCodec::encode(*graph);
+            Benchmark::doNotOptimize(encoded.data());
+        }
+    });
+
+    bench.run("Graph decode", GRAPH_ITERATIONS, [&](){
+        for(uint64_t i=0; i < GRAPH_ITERATIONS; i++){
+            std::unique_ptr<FlowOutput> decoded = FlowGraphCodec::decode(bytes);
+            Benchmark::doNotOptimize(decoded.get());
+        }
+    });
+
+    return bench.finish();
+}
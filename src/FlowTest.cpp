@@ -0,0 +1,603 @@
+#include "./utils/Flow.hpp"
+#include "./utils/FlowRepresentation.hpp"
+#include "./utils/FlowSerialization.hpp"
+#include "./utils/FlowWindowState.hpp"
+#include "./utils/Thread.hpp"
+#include "./utils/Tuple.hpp"
+#include "./utils/TupleBatch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace spi;
+
+
+bool isEven(const Tuple &tuple){
+    return tuple.getValue() % 2 == 0;
+}
+
+struct DivisibleBy {
+    uint32_t divisor;
+    bool operator()(const Tuple &tuple) const { return tuple.getValue() % divisor == 0; }
+};
+
+
+void runFilterChainTest(ThreadPool &pool, const std::string &name, bool fuse, bool composed = false){
+    const uint32_t COUNT = 100000;
+    FlowInput* input = new FlowInput();
+    std::unique_ptr<FlowOutput> output = composed ? input->filter(isEven, DivisibleBy{3}).release()->output() :
+                                                    input->filter(isEven).release()->filter(DivisibleBy{3}).release()->output();
+
+    Flow flow(std::move(output), pool, 64, fuse);
+    const size_t expectedStages = fuse ? 1 : (composed ? 3 : 4);
+    if(flow.getStageCount() != expectedStages)
+        throw std::runtime_error(name+": expected "+std::to_string(expectedStages)+" stages but got "+std::to_string(flow.getStageCount()));
+    std::atomic<uint64_t> received{0}, sum{0};
+    flow.subscribe([&](const Tuple &tuple){
+        received.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(tuple.getValue(), std::memory_order_relaxed);
+    });
+
+    std::vector<Tuple> tuples;
+    for(uint32_t i=0; i < COUNT; i++){
+        if(i % 2 == 0) flow.push(Tuple(i));
+        else tuples.push_back(Tuple(i));
+    }
+    flow.pushBulk(tuples.data(), tuples.size());
+    flow.drain();
+
+    uint64_t expectedCount = 0, expectedSum = 0;
+    for(uint32_t i=0; i < COUNT; i++) if(i % 6 == 0){ expectedCount++; expectedSum += i; }
+    if(received.load() != expectedCount || sum.load() != expectedSum || flow.getTuplesOut() != expectedCount)
+        throw std::runtime_error(name+": expected "+std::to_string(expectedCount)+" tuples but got "+std::to_string(received.load()));
+    if(flow.getTuplesIn() != COUNT)
+        throw std::runtime_error(name+": expected "+std::to_string(COUNT)+" pushed tuples but got "+std::to_string(flow.getTuplesIn()));
+    std::cout << "Completed " << name << " successfully" << std::endl;
+}
+
+
+void runTupleBatchTest(){
+    const FlowCompare ops[] = {FlowCompare::LESS, FlowCompare::LESS_EQUAL, FlowCompare::GREATER, FlowCompare::GREATER_EQUAL, FlowCompare::EQUAL, FlowCompare::NOT_EQUAL};
+    for(size_t count : {(size_t)0, (size_t)1, (size_t)15, (size_t)64, (size_t)100, (size_t)1000}){
+        std::vector<Tuple> tuples;
+        for(size_t i=0; i < count; i++) tuples.push_back(Tuple((uint32_t)((i * 2654435761u) % 200 + (i % 3 == 0 ? 0x80000000u : 0))));
+        for(FlowCompare op : ops){
+            for(uint32_t constant : {0u, 100u, 0x80000010u}){
+                const FlowValueCompare expression{op, constant};
+                TupleBatch batch(count);
+                batch.assign(tuples.data(), count);
+                flowEvaluate(expression, batch.valueColumn(), batch.size(), batch.selectionBitmap());
+                const size_t kept = batch.compact(batch.selectionBitmap());
+
+                std::vector<uint32_t> expected;
+                for(const Tuple &tuple : tuples) if(expression(tuple)) expected.push_back(tuple.getValue());
+                if(kept != expected.size())
+                    throw std::runtime_error("TupleBatch: expected "+std::to_string(expected.size())+" rows but kept "+std::to_string(kept));
+                for(size_t i=0; i < kept; i++)
+                    if(batch[i].getValue() != expected[i]) throw std::runtime_error("TupleBatch: compaction changed order or values");
+            }
+        }
+        const FlowAll<FlowValueRange, DivisibleBy> composed(FlowValueRange{10, 150}, DivisibleBy{3});
+        TupleBatch batch;
+        for(const Tuple &tuple : tuples) batch.append(tuple);
+        flowEvaluate(composed, batch.valueColumn(), batch.size(), batch.selectionBitmap());
+        size_t expected = 0;
+        for(const Tuple &tuple : tuples) if(composed(tuple)) expected++;
+        if(batch.compact(batch.selectionBitmap()) != expected)
+            throw std::runtime_error("TupleBatch: composed expression selected wrong rows");
+    }
+    std::cout << "Completed TupleBatchTest (" << TupleBatchKernels::simdName() << ") successfully" << std::endl;
+}
+
+
+void runColumnFilterTest(ThreadPool &pool, size_t batchSize){
+    const uint32_t COUNT = 10000;
+    FlowInput* input = new FlowInput();
+    Flow flow(input->filter(FlowValueRange{1000, 8999}).release()->filter(FlowValueCompare{FlowCompare::NOT_EQUAL, 5000}).release()->output(), pool, batchSize);
+    std::vector<uint32_t> received;
+    flow.subscribe([&](const Tuple &tuple){ received.push_back(tuple.getValue()); });
+    for(uint32_t i=0; i < COUNT; i++) flow.push(Tuple(i));
+    flow.drain();
+    if(received.size() != 7999)
+        throw std::runtime_error("ColumnFilter: expected 7999 tuples but got "+std::to_string(received.size()));
+    for(size_t i=1; i < received.size(); i++)
+        if(received[i] <= received[i - 1]) throw std::runtime_error("ColumnFilter: order of a single input should be preserved");
+    std::cout << "Completed ColumnFilterTest with batch size " << batchSize << " successfully" << std::endl;
+}
+
+
+/**
+ * Compares a compile time expression, its runtime counterpart and a reference lambda
+ * per tuple and on columns of several lengths (SIMD, bytecode and per row evaluation).
+ */
+template<typename E, typename F>
+void checkExpression(const std::string &name, const E &expression, const FlowDynamicExpression &dynamic, F reference){
+    std::vector<uint32_t> values;
+    for(uint32_t i=0; i < 5000; i++) values.push_back(i);
+    for(uint32_t v : {0xFFFFFFFFu, 0x80000000u, 0x7FFFFFFFu, 4294967000u}) values.push_back(v);
+    for(uint32_t value : values){
+        const bool expected = reference(value);
+        if((bool)expression(Tuple(value)) != expected || (bool)dynamic(Tuple(value)) != expected)
+            throw std::runtime_error("Expression "+name+" evaluated "+std::to_string(value)+" wrong");
+    }
+    for(size_t count : {(size_t)1, (size_t)63, (size_t)64, (size_t)100, values.size()}){
+        std::vector<uint64_t> compiled((count + 63) / 64), interpreted((count + 63) / 64);
+        flowEvaluate(expression, values.data() + values.size() - count, count, compiled.data());
+        flowEvaluate(dynamic, values.data() + values.size() - count, count, interpreted.data());
+        for(size_t i=0; i < count; i++){
+            const bool expected = reference(values[values.size() - count + i]);
+            if(((compiled[i / 64] >> (i % 64)) & 1) != expected || ((interpreted[i / 64] >> (i % 64)) & 1) != expected)
+                throw std::runtime_error("Expression "+name+" evaluated column of "+std::to_string(count)+" rows wrong at "+std::to_string(i));
+        }
+        if(count % 64 != 0 && ((compiled.back() | interpreted.back()) >> (count % 64)) != 0)
+            throw std::runtime_error("Expression "+name+" set bits beyond the rows");
+    }
+}
+
+void runExpressionTest(ThreadPool &pool){
+    using namespace spi::flow;
+    typedef FlowDynamicExpression D;
+    const D field = D::field();
+
+    static_assert(FlowColumnExpression<decltype(value < 10)>, "comparison with constant should evaluate columns");
+    static_assert(FlowColumnExpression<decltype(10 > value && value != 3)>, "combined comparisons should evaluate columns");
+    static_assert(!FlowColumnExpression<decltype(value % 3 == 0)>, "arithmetic gets evaluated per row");
+
+    checkExpression("value < 1000", value < 1000, field < 1000, [](uint64_t v){ return v < 1000; });
+    checkExpression("2000 <= value", 2000 <= value, 2000 <= field, [](uint64_t v){ return 2000 <= v; });
+    checkExpression("value > 1 << 40", value > ((uint64_t)1 << 40), field > ((uint64_t)1 << 40), [](uint64_t){ return false; });
+    checkExpression("value != 1 << 40", value != ((uint64_t)1 << 40), field != ((uint64_t)1 << 40), [](uint64_t){ return true; });
+    checkExpression("range", value >= 100 && value <= 4000 && value != 2500, field >= 100 && field <= 4000 && field != 2500,
+                    [](uint64_t v){ return v >= 100 && v <= 4000 && v != 2500; });
+    checkExpression("or", value < 10 || value == 4294967295u || !(value < 4990), field < 10 || field == 4294967295u || !(field < 4990),
+                    [](uint64_t v){ return v < 10 || v == 4294967295u || !(v < 4990); });
+    checkExpression("arithmetic", (value * 3 + 7) % 11 == value / 5 % 11 || value - 100 < 50, (field * 3 + 7) % 11 == field / 5 % 11 || field - 100 < 50,
+                    [](uint64_t v){ return (v * 3 + 7) % 11 == v / 5 % 11 || v - 100 < 50; });
+    checkExpression("division by zero", value / (value % 2) == 0 && value % constant(0) == 0, field / (field % 2) == 0 && field % D::constant(0) == 0,
+                    [](uint64_t v){ return v % 2 == 0; });
+    checkExpression("literal", value % literal<3> == literal<0> && literal<3000> > value, field % 3 == 0 && 3000 > field,
+                    [](uint64_t v){ return v % 3 == 0 && 3000 > v; });
+    static_assert(FlowColumnExpression<decltype(literal<3000> > value)>, "comparison with literal should evaluate columns");
+    checkExpression("mixed", value % 3 == 0 && value < 3000, field % 3 == 0 && field < 3000, [](uint64_t v){ return v % 3 == 0 && v < 3000; });
+
+    // join predicates refer to both tuples
+    auto joined = left % 10 == right % 10 && left < right;
+    const D joinedDynamic = D::field(0) % 10 == D::field(1) % 10 && D::field(0) < D::field(1);
+    for(uint32_t l=0; l < 50; l++){
+        for(uint32_t r=0; r < 50; r++){
+            const bool expected = l % 10 == r % 10 && l < r;
+            if(joined(Tuple(l), Tuple(r)) != expected || (bool)joinedDynamic(Tuple(l), Tuple(r)) != expected)
+                throw std::runtime_error("Join expression evaluated ("+std::to_string(l)+", "+std::to_string(r)+") wrong");
+        }
+    }
+    if(joinedDynamic.getDepth() != 3) throw std::runtime_error("Join expression should need 3 stack entries but needs "+std::to_string(joinedDynamic.getDepth()));
+    bool thrown = false;
+    try { D::field(2); } catch(const std::invalid_argument&){ thrown = true; }
+    if(!thrown) throw std::runtime_error("Field of a third tuple should throw");
+    D deep = field;
+    thrown = false;
+    try { for(size_t i=0; i < FlowDynamicExpression::MAX_DEPTH; i++) deep = field + deep; } catch(const std::invalid_argument&){ thrown = true; }
+    if(!thrown) throw std::runtime_error("Exceeding the stack should throw");
+
+    // both forms as flow filters
+    for(size_t batchSize : {(size_t)1, (size_t)256}){
+        Flow compiled((new FlowInput())->filter(value % 7 == 0 && value < 7000).release()->output(), pool, batchSize);
+        Flow dynamic((new FlowInput())->filter(field % 7 == 0 && field < 7000).release()->output(), pool, batchSize);
+        uint64_t compiledSum = 0, dynamicSum = 0;
+        compiled.subscribe([&](const Tuple &tuple){ compiledSum += tuple.getValue(); });
+        dynamic.subscribe([&](const Tuple &tuple){ dynamicSum += tuple.getValue(); });
+        for(uint32_t i=0; i < 10000; i++){
+            compiled.push(Tuple(i));
+            dynamic.push(Tuple(i));
+        }
+        compiled.drain();
+        dynamic.drain();
+        if(compiledSum != 3496500 || dynamicSum != 3496500)
+            throw std::runtime_error("Expression filters expected sum 3496500 but got "+std::to_string(compiledSum)+" and "+std::to_string(dynamicSum));
+    }
+    std::cout << "Completed ExpressionTest successfully" << std::endl;
+}
+
+
+void runSerializationTest(ThreadPool &pool){
+    typedef FlowDynamicExpression D;
+    const D field = D::field();
+
+    // graph round trip runs the same
+    FlowInput* input = new FlowInput({"worker1", "worker2"}, {"sensors"});
+    std::unique_ptr<FlowOutput> original = input->filter(field % 3 != 0 || field < 100).release()
+                                                ->partition(field % 5, 3, true).release()
+                                                ->filter(FlowValueRange{50, 80000}).release()
+                                                ->filter(FlowValueCompare{FlowCompare::NOT_EQUAL, 1000}).release()->output();
+    const std::vector<uint8_t> bytes = FlowGraphCodec::encode(*original);
+    std::unique_ptr<FlowOutput> decoded = FlowGraphCodec::decode(bytes);
+    if(FlowGraphCodec::encode(*decoded) != bytes) throw std::runtime_error("Serialization: decoded graph encodes differently");
+    const FlowOperator* head = decoded.get();
+    while(!head->getSources().empty()) head = *head->getSources().begin();
+    const FlowInput* decodedInput = static_cast<const FlowInput*>(head);
+    if(decodedInput->getWorkerNames() != std::vector<std::string>{"worker1", "worker2"} || decodedInput->getPublisherGroups() != std::vector<std::string>{"sensors"})
+        throw std::runtime_error("Serialization: input lost its publishers");
+
+    Flow originalFlow(std::move(original), pool, 64), decodedFlow(std::move(decoded), pool, 64);
+    std::vector<uint32_t> originalReceived, decodedReceived;
+    originalFlow.subscribe([&](const Tuple &tuple){ originalReceived.push_back(tuple.getValue()); });
+    decodedFlow.subscribe([&](const Tuple &tuple){ decodedReceived.push_back(tuple.getValue()); });
+
+    // tuples travel as records through one receive buffer
+    const uint32_t COUNT = 100000, PER_RECORD = 1000;
+    std::vector<uint64_t> wire(FlowTupleRecord::size(COUNT) / 8 + COUNT / PER_RECORD * 3); // 8 byte aligned
+    std::vector<Tuple> tuples;
+    for(uint32_t i=0; i < COUNT; i++) tuples.push_back(Tuple(i));
+    size_t written = 0;
+    for(uint32_t i=0; i < COUNT; i += PER_RECORD){
+        written += FlowTupleRecord::write(reinterpret_cast<uint8_t*>(wire.data()) + written, wire.size() * 8 - written, tuples.data() + i, PER_RECORD, i / PER_RECORD);
+        originalFlow.pushBulk(tuples.data() + i, PER_RECORD);
+    }
+    size_t offset = 0;
+    for(uint64_t sequence=0; offset < written; sequence++){
+        FlowTupleRecord record = FlowTupleRecord::open(reinterpret_cast<uint8_t*>(wire.data()) + offset, written - offset);
+        if(record.sequence() != sequence || record.count() != PER_RECORD || record[1].getValue() != sequence * PER_RECORD + 1)
+            throw std::runtime_error("Serialization: record "+std::to_string(sequence)+" read wrong");
+        if((const void*)record.valueColumn() != (const void*)(reinterpret_cast<uint8_t*>(wire.data()) + offset + FlowTupleRecord::HEADER_SIZE))
+            throw std::runtime_error("Serialization: record should be read in place");
+        decodedFlow.pushBulk(record.tuples(), record.count());
+        offset += record.bytes();
+    }
+    originalFlow.drain();
+    decodedFlow.drain();
+    if(originalReceived.empty() || originalReceived != decodedReceived)
+        throw std::runtime_error("Serialization: decoded flow delivered "+std::to_string(decodedReceived.size())+" instead of "+std::to_string(originalReceived.size())+" tuples");
+
+    // merged inputs
+    std::unique_ptr<FlowOutput> merged = (new FlowInput())->filter(field > 10).release()
+            ->merge(std::unique_ptr<FlowOperator>((new FlowInput(std::vector<std::string>{"upstream"}))->filter(FlowValueRange{1, 2}).release()))
+            .release()->output();
+    const std::vector<uint8_t> mergedBytes = FlowGraphCodec::encode(*merged);
+    if(FlowGraphCodec::encode(*FlowGraphCodec::decode(mergedBytes)).size() != mergedBytes.size())
+        throw std::runtime_error("Serialization: merged graph changed");
+
+    // inputs subscribe to flows or to workers/publishers
+    std::unique_ptr<FlowOutput> flowOnly = (new FlowInput(std::vector<std::string>{"upstream", "other"}))->output();
+    std::unique_ptr<FlowOutput> flowOnlyDecoded = FlowGraphCodec::decode(FlowGraphCodec::encode(*flowOnly));
+    const FlowOperator* flowOnlyInput = *flowOnlyDecoded->getSources().begin();
+    if(static_cast<const FlowInput*>(flowOnlyInput)->getFlowNames() != std::vector<std::string>{"upstream", "other"} ||
+       !static_cast<const FlowInput*>(flowOnlyInput)->getWorkerNames().empty())
+        throw std::runtime_error("Serialization: input lost its flow names");
+    struct MixedInput : FlowInput {
+        MixedInput(){ workerNames = {"worker1"}; flowNames = {"upstream"}; }
+    };
+    std::unique_ptr<FlowOutput> mixed = (new MixedInput())->output();
+    bool thrown = false;
+    try { FlowGraphCodec::encode(*mixed); } catch(const std::invalid_argument&){ thrown = true; }
+    if(!thrown) throw std::runtime_error("Serialization: input with flow names and workers encoded");
+
+    // malformed input is rejected
+    for(size_t length=0; length < bytes.size(); length++){
+        bool thrown = false;
+        try { FlowGraphCodec::decode(bytes.data(), length); } catch(const std::invalid_argument&){ thrown = true; }
+        if(!thrown) throw std::runtime_error("Serialization: truncated graph of "+std::to_string(length)+" bytes accepted");
+    }
+    std::vector<uint8_t> newer = bytes;
+    newer[4] = (uint8_t)(FlowGraphCodec::VERSION + 1);
+    thrown = false;
+    try { FlowGraphCodec::decode(newer); } catch(const std::invalid_argument&){ thrown = true; }
+    if(!thrown) throw std::runtime_error("Serialization: newer version accepted");
+    std::vector<uint8_t> wide = FlowGraphCodec::encode(*(new FlowInput())->partition(field, 1000).release()->output()); // parallelism varint E8 07
+    for(size_t i=0; i + 1 < wide.size(); i++){
+        if(wide[i] == 0xE8 && wide[i+1] == 0x07){ wide[i] = 0xD0; wide[i+1] = 0x0F; break; } // 2000
+    }
+    thrown = false;
+    try { FlowGraphCodec::decode(wide); } catch(const std::invalid_argument&){ thrown = true; }
+    if(!thrown) throw std::runtime_error("Serialization: parallelism above "+std::to_string(FlowGraphCodec::MAX_PARALLELISM)+" accepted");
+    thrown = false;
+    try { FlowGraphCodec::encode(*(new FlowInput())->partition(field, 2000).release()->output()); } catch(const std::invalid_argument&){ thrown = true; }
+    if(!thrown) throw std::runtime_error("Serialization: parallelism above "+std::to_string(FlowGraphCodec::MAX_PARALLELISM)+" encoded");
+    thrown = false;
+    try { FlowGraphCodec::encode(*(new FlowInput())->filter(isEven).release()->output()); } catch(const std::invalid_argument&){ thrown = true; }
+    if(!thrown) throw std::runtime_error("Serialization: lambda filter encoded");
+    for(std::vector<D::Instruction> code : std::vector<std::vector<D::Instruction>>{
+            {{D::Op::ADD, 0, 0}},                                                               // underflow
+            {{D::Op::CONSTANT, 0, 1}, {D::Op::CONSTANT, 0, 2}},                                 // two results
+            {{D::Op::FIELD, 0, 0}, {D::Op::JUMP_IF_FALSE, 5, 0}, {D::Op::FIELD, 0, 0}, {D::Op::AND, 0, 0}}, // jumps out
+            {{D::Op::FIELD, 0, 0}, {D::Op::JUMP_IF_FALSE, 1, 0}, {D::Op::FIELD, 0, 0}, {D::Op::AND, 0, 0}}, // jumps into other height
+            {{D::Op::FIELD, 2, 0}}}){                                                           // third tuple
+        thrown = false;
+        try { D::fromCode(code); } catch(const std::invalid_argument&){ thrown = true; }
+        if(!thrown) throw std::runtime_error("Serialization: invalid bytecode accepted");
+    }
+    const D roundTrip = D::fromCode((field > 10 && field < 20).getCode());
+    if(!roundTrip(Tuple(15)) || roundTrip(Tuple(25)) || roundTrip.getDepth() != (field > 10 && field < 20).getDepth()) throw std::runtime_error("Serialization: bytecode round trip failed");
+
+    uint64_t record[8] = {};
+    FlowTupleRecord::write(record, sizeof(record), tuples.data(), 4, 7);
+    thrown = false;
+    try { FlowTupleRecord::open(record, FlowTupleRecord::size(4) - 1); } catch(const std::invalid_argument&){ thrown = true; }
+    if(!thrown) throw std::runtime_error("Serialization: truncated record accepted");
+    thrown = false;
+    try { FlowTupleRecord::open(reinterpret_cast<uint8_t*>(record) + 1, sizeof(record) - 1); } catch(const std::invalid_argument&){ thrown = true; }
+    if(!thrown) throw std::runtime_error("Serialization: misaligned record accepted");
+    thrown = false;
+    try { FlowTupleRecord::write(record, sizeof(record), tuples.data(), 11); } catch(const std::length_error&){ thrown = true; }
+    if(!thrown) throw std::runtime_error("Serialization: record larger than buffer written");
+    uint8_t unaligned[FlowTupleRecord::size(4) + 1];
+    FlowTupleRecord::write(unaligned + 1, sizeof(unaligned) - 1, tuples.data() + 5, 4, 9);
+    std::memcpy(record, unaligned + 1, FlowTupleRecord::size(4));
+    FlowTupleRecord copied = FlowTupleRecord::open(record, sizeof(record));
+    if(copied.sequence() != 9 || copied.count() != 4 || copied[3].getValue() != 8) throw std::runtime_error("Serialization: unaligned write failed");
+    std::cout << "Completed SerializationTest with " << bytes.size() << " byte graph successfully" << std::endl;
+}
+
+
+struct ModuloKey {
+    uint32_t modulo;
+    uint64_t operator()(const Tuple &tuple) const { return tuple.getValue() % modulo; }
+};
+
+void runPartitionTest(ThreadPool &pool, const std::string &name, size_t parallelism, bool ordered, bool fuse, bool nested = false){
+    const uint32_t COUNT = 100000, KEYS = 97;
+    FlowInput* input = new FlowInput();
+    FlowOperatorChainable* sharded = input->partition(ModuloKey{KEYS}, parallelism, ordered).release()->filter(isEven).release();
+    if(nested) sharded = sharded->partition(ModuloKey{13}, 3, ordered).release()->filter(DivisibleBy{1}).release();
+    Flow flow(sharded->output(), pool, 64, fuse);
+
+    // input stage + shards + recombining stage (+ shards and recombining stage of the nested partition)
+    // without fusion the filters and the output get stages of their own
+    const size_t expectedStages = 1 + parallelism + 1 + (nested ? 3 + 1 : 0) + (fuse ? 0 : 1 + (nested ? 2 : 1));
+    if(flow.getStageCount() != expectedStages)
+        throw std::runtime_error(name+": expected "+std::to_string(expectedStages)+" stages but got "+std::to_string(flow.getStageCount()));
+
+    std::vector<uint32_t> received;
+    flow.subscribe([&](const Tuple &tuple){ received.push_back(tuple.getValue()); }); // subscribers never run concurrently
+    for(uint32_t i=0; i < COUNT; i += 1000){
+        std::vector<Tuple> chunk;
+        for(uint32_t j=i; j < i + 1000; j++) chunk.push_back(Tuple(j));
+        flow.pushBulk(chunk.data(), chunk.size());
+    }
+    flow.drain();
+
+    if(received.size() != COUNT / 2)
+        throw std::runtime_error(name+": expected "+std::to_string(COUNT / 2)+" tuples but got "+std::to_string(received.size()));
+    std::vector<int64_t> lastOfKey(KEYS, -1);
+    for(size_t i=0; i < received.size(); i++){
+        if(received[i] % 2 != 0) throw std::runtime_error(name+": tuple passed although it should have been filtered");
+        if(ordered && i > 0 && received[i] <= received[i - 1]) throw std::runtime_error(name+": order got lost");
+        int64_t &last = lastOfKey[received[i] % KEYS];
+        if(!nested && (int64_t)received[i] <= last) throw std::runtime_error(name+": order of a key got lost");
+        last = received[i];
+    }
+    std::cout << "Completed " << name << " successfully" << std::endl;
+}
+
+
+void runBackpressureTest(ThreadPool &pool, const std::string &name, FlowBackpressure policy, bool partitioned, bool ordered = false){
+    const uint32_t COUNT = 20000;
+    const size_t BATCH = 64, CAPACITY = 256;
+    FlowInput* input = new FlowInput();
+    FlowOperatorChainable* last = input;
+    if(partitioned) last = last->partition(ModuloKey{31}, 3, ordered).release();
+    FlowFilterBase* filter = last->filter(DivisibleBy{1}).release();
+    Flow flow(filter->output(), pool, BATCH, false);
+    flow.setBackpressure(CAPACITY, policy);
+    if(policy == FlowBackpressure::DROP) flow.setBackpressure(filter, CAPACITY, FlowBackpressure::BLOCK); // only drop at the input
+
+    uint64_t received = 0;
+    flow.subscribe([&](const Tuple&){
+        if(++received % 64 == 0) Thread::sleepUs(20); // slow consumer
+    });
+    size_t maxQueued = 0;
+    for(uint32_t i=0; i < COUNT; i += 16){
+        std::vector<Tuple> chunk;
+        for(uint32_t j=i; j < i + 16; j++) chunk.push_back(Tuple(j));
+        flow.pushBulk(chunk.data(), chunk.size());
+        for(const FlowStageMetrics &metrics : flow.getStageMetrics())
+            if(metrics.name != "reorder") maxQueued = std::max(maxQueued, metrics.queued);
+    }
+    flow.drain();
+
+    if(maxQueued > CAPACITY + BATCH)
+        throw std::runtime_error(name+": stage queued "+std::to_string(maxQueued)+" tuples although capacity is "+std::to_string(CAPACITY));
+    if(received + flow.getTuplesDropped() != COUNT)
+        throw std::runtime_error(name+": "+std::to_string(received)+" received and "+std::to_string(flow.getTuplesDropped())+" dropped of "+std::to_string(COUNT));
+    uint64_t stalls = 0, dropped = 0;
+    for(const FlowStageMetrics &metrics : flow.getStageMetrics()){
+        stalls += metrics.stalls;
+        dropped += metrics.dropped;
+        if(metrics.name != "reorder" && metrics.capacity != CAPACITY) throw std::runtime_error(name+": stage "+metrics.name+" is not bounded");
+    }
+    if(policy == FlowBackpressure::DROP ? flow.getTuplesDropped() == 0 || dropped != flow.getTuplesDropped() : stalls == 0)
+        throw std::runtime_error(name+": producers never had to wait or drop");
+    std::cout << "Completed " << name << " (" << stalls << " stalls, " << flow.getTuplesDropped() << " dropped) successfully" << std::endl;
+}
+
+
+void runWindowAggregationTest(FlowWindowType type, uint64_t size, uint64_t stride){
+    const uint64_t COUNT = 1000;
+    const std::string name = "WindowAggregation(" + type.toString() + ", " + std::to_string(size) + ", " + std::to_string(stride) + ")";
+    FlowWindowAggregation<FlowSum> sums(FlowWindow(type, size, stride));
+    FlowWindowAggregation<FlowMax> maxima(FlowWindow(type, size, stride));
+    std::vector<std::pair<uint64_t, uint64_t>> gotSums, gotMaxima;
+
+    // TIME_BASED: several tuples per millisecond and some empty milliseconds, value = time
+    std::vector<uint64_t> times;
+    for(uint64_t i=0; i < COUNT; i++) if(type == FlowWindowType::SIZE_BASED || i % 7 != 3) times.push_back(type == FlowWindowType::SIZE_BASED ? i : i / 3);
+    for(uint64_t time : times){
+        const Tuple tuple((uint32_t)time);
+        if(type == FlowWindowType::SIZE_BASED){
+            sums.add(tuple, [&](uint64_t start, uint64_t, const uint64_t &sum){ gotSums.push_back({start, sum}); });
+            maxima.add(tuple, [&](uint64_t start, uint64_t, const uint32_t &max){ gotMaxima.push_back({start, max}); });
+        } else {
+            sums.advance(time, [&](uint64_t start, uint64_t, const uint64_t &sum){ gotSums.push_back({start, sum}); });
+            maxima.advance(time, [&](uint64_t start, uint64_t, const uint32_t &max){ gotMaxima.push_back({start, max}); });
+            if(!sums.add(tuple, time) || !maxima.add(tuple, time)){
+                if(size >= stride) throw std::runtime_error(name + ": in order tuple got rejected");
+            }
+        }
+    }
+    if(type == FlowWindowType::TIME_BASED){
+        if(sums.add(Tuple(0), 0) || sums.getLateTuples() != 1) throw std::runtime_error(name + ": late tuple got accepted");
+    }
+
+    // brute force over all windows that ended before the last tuple
+    const uint64_t end = type == FlowWindowType::SIZE_BASED ? times.size() : times.back();
+    std::vector<std::pair<uint64_t, uint64_t>> expectedSums, expectedMaxima;
+    for(uint64_t start=0; start + size <= end; start += stride){
+        uint64_t sum = 0, max = 0, count = 0;
+        for(size_t i=0; i < times.size(); i++){
+            const uint64_t time = type == FlowWindowType::SIZE_BASED ? i : times[i];
+            if(time < start || time >= start + size) continue;
+            sum += times[i];
+            max = std::max(max, times[i]);
+            count++;
+        }
+        if(count == 0) continue;
+        expectedSums.push_back({start, sum});
+        expectedMaxima.push_back({start, max});
+    }
+    if(gotSums != expectedSums || gotMaxima != expectedMaxima)
+        throw std::runtime_error(name + ": expected " + std::to_string(expectedSums.size()) + " windows but got " + std::to_string(gotSums.size()) + " or different results");
+    std::cout << "Completed " << name << " successfully" << std::endl;
+}
+
+
+struct JoinKey {
+    uint64_t operator()(const Tuple &tuple) const { return tuple.getValue() % 16; }
+};
+
+void runJoinTest(FlowWindowType type){
+    const uint64_t COUNT = 4000, SIZE = 20;
+    const std::string name = "JoinTest(" + type.toString() + ")";
+    FlowJoinState<JoinKey> join(FlowWindow(type, SIZE), JoinKey(), 8);
+
+    struct Arrival { FlowJoinSide side; uint32_t value; uint64_t time; };
+    std::vector<Arrival> arrivals;
+    uint64_t counted[2] = {0, 0};
+    for(uint64_t i=0; i < COUNT; i++){
+        const FlowJoinSide side = (i * 7) % 5 < 2 ? FlowJoinSide::LEFT : FlowJoinSide::RIGHT;
+        const uint64_t time = type == FlowWindowType::TIME_BASED ? i / 4 : counted[(size_t)side]++;
+        arrivals.push_back({side, (uint32_t)((i * 2654435761u) % 1000), time});
+    }
+
+    uint64_t pairs = 0, checksum = 0;
+    auto emit = [&](const Tuple &left, const Tuple &right){
+        if(left.getValue() % 16 != right.getValue() % 16) throw std::runtime_error(name + ": joined tuples with different keys");
+        pairs++;
+        checksum += (uint64_t)left.getValue() * 1000 + right.getValue();
+    };
+    for(const Arrival &arrival : arrivals){
+        if(type == FlowWindowType::TIME_BASED){
+            join.advance(arrival.time);
+            join.add(arrival.side, Tuple(arrival.value), arrival.time, emit);
+        } else {
+            join.add(arrival.side, Tuple(arrival.value), emit);
+        }
+    }
+
+    // brute force: every pair of opposite sides with equal keys that is within the window when the later one arrives
+    uint64_t expectedPairs = 0, expectedChecksum = 0;
+    for(size_t later=0; later < arrivals.size(); later++){
+        for(size_t earlier=0; earlier < later; earlier++){
+            const Arrival &a = arrivals[earlier], &b = arrivals[later];
+            if(a.side == b.side || a.value % 16 != b.value % 16) continue;
+            if(type == FlowWindowType::TIME_BASED){
+                if(b.time - a.time > SIZE) continue;
+            } else {
+                uint64_t seen = 0; // tuples of a's side that arrived before b
+                for(size_t i=0; i < later; i++) if(arrivals[i].side == a.side) seen++;
+                if(a.time + SIZE < seen) continue;
+            }
+            const Arrival &left = a.side == FlowJoinSide::LEFT ? a : b, &right = a.side == FlowJoinSide::LEFT ? b : a;
+            expectedPairs++;
+            expectedChecksum += (uint64_t)left.value * 1000 + right.value;
+        }
+    }
+    if(pairs != expectedPairs || checksum != expectedChecksum)
+        throw std::runtime_error(name + ": expected " + std::to_string(expectedPairs) + " pairs but got " + std::to_string(pairs));
+    join.advance(arrivals.back().time);
+    if(type == FlowWindowType::SIZE_BASED && join.getBufferedTuples() > 2 * SIZE)
+        throw std::runtime_error(name + ": tuples outside the window did not get evicted");
+
+    // bounded memory
+    FlowJoinState<JoinKey> bounded(FlowWindow(FlowWindowType::TIME_BASED, 1000000), JoinKey(), 4, 64);
+    for(const Arrival &arrival : arrivals) bounded.add(arrival.side, Tuple(arrival.value), arrival.time, [](const Tuple&, const Tuple&){});
+    if(bounded.getBufferedTuples() > 64 || bounded.getEvictedEarly() == 0)
+        throw std::runtime_error(name + ": join state exceeded its memory bound");
+    std::cout << "Completed " << name << " with " << pairs << " pairs successfully" << std::endl;
+}
+
+
+void runMergeTest(ThreadPool &pool){
+    const uint32_t COUNT = 50000;
+    FlowInput* first = new FlowInput();
+    FlowInput* second = new FlowInput();
+    std::unique_ptr<FlowOutput> output = first->merge(std::unique_ptr<FlowOperator>(second)).release()->output();
+
+    Flow flow(std::move(output), pool);
+    if(flow.getStageCount() != 3) // one per input and one for merge -> output
+        throw std::runtime_error("Merge: expected 3 stages but got "+std::to_string(flow.getStageCount()));
+    std::atomic<uint64_t> received{0};
+    flow.subscribe([&](const Tuple&){ received.fetch_add(1, std::memory_order_relaxed); });
+
+    Thread producer([&]{ for(uint32_t i=0; i < COUNT; i++) flow.push(second, Tuple(i)); });
+    producer.start();
+    for(uint32_t i=0; i < COUNT; i++) flow.push(first, Tuple(i));
+    producer.join();
+    flow.drain();
+
+    if(received.load() != 2 * COUNT)
+        throw std::runtime_error("Merge: expected "+std::to_string(2 * COUNT)+" tuples but got "+std::to_string(received.load()));
+    bool threw = false;
+    try { flow.push(Tuple(0)); } catch(const std::logic_error&) { threw = true; }
+    if(!threw) throw std::runtime_error("Merge: pushing without input should fail for multiple inputs");
+    std::cout << "Completed MergeTest successfully" << std::endl;
+}
+
+
+int main(){
+    ThreadPool pool;
+    runFilterChainTest(pool, "FilterChainTest", true);
+    runFilterChainTest(pool, "FilterChainUnfusedTest", false);
+    runFilterChainTest(pool, "FilterComposedTest", true, true);
+    runFilterChainTest(pool, "FilterComposedUnfusedTest", false, true);
+    ThreadPool stealingPool(0, 4, 5000, -1, true);
+    runFilterChainTest(stealingPool, "FilterChainWorkStealingTest", true);
+    runFilterChainTest(stealingPool, "FilterChainUnfusedWorkStealingTest", false);
+    runTupleBatchTest();
+    runColumnFilterTest(pool, 1);
+    runColumnFilterTest(pool, 100);
+    runColumnFilterTest(pool, 4096);
+    runExpressionTest(pool);
+    runSerializationTest(pool);
+    runMergeTest(pool);
+    runPartitionTest(pool, "PartitionTest", 4, false, true);
+    runPartitionTest(pool, "PartitionUnfusedTest", 4, false, false);
+    runPartitionTest(pool, "PartitionOrderedTest", 4, true, true);
+    runPartitionTest(pool, "PartitionOrderedUnfusedTest", 3, true, false);
+    runPartitionTest(pool, "PartitionNestedTest", 2, false, true, true);
+    runPartitionTest(pool, "PartitionNestedOrderedTest", 2, true, true, true);
+    runPartitionTest(stealingPool, "PartitionOrderedWorkStealingTest", 8, true, true);
+    runBackpressureTest(pool, "BackpressureBlockTest", FlowBackpressure::BLOCK, false);
+    runBackpressureTest(pool, "BackpressureSpinTest", FlowBackpressure::SPIN, false);
+    runBackpressureTest(pool, "BackpressureDropTest", FlowBackpressure::DROP, false);
+    runBackpressureTest(pool, "BackpressurePartitionTest", FlowBackpressure::BLOCK, true);
+    runBackpressureTest(pool, "BackpressureOrderedPartitionTest", FlowBackpressure::BLOCK, true, true);
+    runBackpressureTest(stealingPool, "BackpressureWorkStealingTest", FlowBackpressure::BLOCK, true);
+    for(FlowWindowType type : {FlowWindowType::TIME_BASED, FlowWindowType::SIZE_BASED}){
+        runWindowAggregationTest(type, 10, 10);
+        runWindowAggregationTest(type, 12, 4);
+        runWindowAggregationTest(type, 10, 6);
+        runWindowAggregationTest(type, 3, 5);
+        runJoinTest(type);
+    }
+    try {
+        FlowWindow(FlowWindowType::TIME_BASED, 0);
+        throw std::runtime_error("FlowWindow: size of zero got accepted");
+    } catch(const std::invalid_argument&) {}
+    return 0;
+}
@@ -1,60 +1,255 @@
+#include "./utils/Benchmark.hpp"
 #include "./utils/Future.hpp"
+#include "./utils/Thread.hpp"
+#include "./utils/TimeUtils.hpp"
 
 #include <chrono>
 #include <cstdint>
 #include <iostream>
+#include <vector>
 
 using namespace spi;
 
 
-int main(){
+// executor that runs tasks when drained by the benchmark loop
+struct QueuedExecutor {
+    std::vector<Task> tasks;
+
+    void enqueue(Task task){
+        tasks.push_back(std::move(task));
+    }
+
+    void drain(){
+        for(Task &task : tasks) task();
+        tasks.clear();
+    }
+};
+
+
+inline uint64_t nowNs(){
+    return FastClock::nowNanos();
+}
+
+
+Future<int> sumCoroutine(Future<int> a, Future<int> b, Future<int> c){
+    int sum = co_await a;
+    sum += co_await b;
+    sum += co_await c;
+    co_return sum;
+}
+
+
+int main(int argc, char** argv){
+    Benchmark bench("future_benchmark", argc, argv);
+    FastClock::calibrate();
     const uint64_t ITERATIONS = 10000000;
 
 
     // plain future ( old: ~1.17 Mio/sec ) ( new: ~5.30 Mio/sec )
-    auto startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        Future<int> fut = Future<int>(42);
-    }
-    auto endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "plain future: \t\t" << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("plain future", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            Future<int> fut = Future<int>(42);
+        }
+    });
 
 
     // with then value ( old: ~0.23 Mio/sec ) ( new: ~2.06 Mio/sec )
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        Future<void> fut = Future<int>(42).then<void>([](int val){ (void)val; });
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "with then value: \t" << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("with then value", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            Future<void> fut = Future<int>(42).then<void>([](int val){ (void)val; });
+        }
+    });
 
 
     // with then future ( old: ~0.19 Mio/sec ) ( new: ~1.57 Mio/sec )
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        Future<void> fut = Future<int>(42).then<void>([](int val){ (void)val; return Future<void>(); });
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "with then future: \t" << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("with then future", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            Future<void> fut = Future<int>(42).then<void>([](int val){ (void)val; return Future<void>(); });
+        }
+    });
 
 
     // with then void ( old: ~0.23 Mio/sec ) ( new: ~2.10 Mio/sec )
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        Future<void> fut = Future<int>(42).then<void>([](int val){ (void)val; return; });
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "with then void: \t" << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("with then void", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            Future<void> fut = Future<int>(42).then<void>([](int val){ (void)val; return; });
+        }
+    });
 
 
     // with then future void ( old: 0.19 Mio/sec ) ( new: ~1.56 Mio/sec )
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        Future<void> fut = Future<int>(42).then<void>([](int val){ (void)val; return Future<void>(); });
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "with then future void: \t" << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
-
-
-    return 0;
+    bench.run("with then future void", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            Future<void> fut = Future<int>(42).then<void>([](int val){ (void)val; return Future<void>(); });
+        }
+    });
+
+
+    // promise -> future -> then ( old: ~4.27 Mio/sec ) ( new: ~5.27 Mio/sec )
+    bench.run("promise then", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            Promise<int> promise;
+            Future<void> fut = promise.get_future().then<void>([](int val){ (void)val; });
+            promise.set_value(42);
+        }
+    });
+
+
+    // promise -> future -> then -> then -> then ( old: ~1.76 Mio/sec ) ( new: ~2.40 Mio/sec )
+    bench.run("promise then chain", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            Promise<int> promise;
+            Future<int> fut = promise.get_future()
+                                .then<int>([](int val){ return val + 1; })
+                                .then<int>([](int val){ return val + 1; })
+                                .then<int>([](int val){ return val + 1; });
+            promise.set_value(42);
+            if(fut.get_value() != 45) std::cout << "wrong result" << std::endl;
+        }
+    });
+
+
+    // promise -> future with two onValue consumers ( old: ~4.51 Mio/sec ) ( new: ~7.86 Mio/sec )
+    bench.run("promise two consumers", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            Promise<int> promise;
+            Future<int> fut = promise.get_future();
+            fut.onValue([](int val){ (void)val; });
+            fut.onValue([](int val){ (void)val; });
+            promise.set_value(42);
+        }
+    });
+
+
+    // promise -> future -> then on executor ( ~5.29 Mio/sec )
+    QueuedExecutor executor;
+    bench.run("then on executor", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            Promise<int> promise;
+            Future<void> fut = promise.get_future().then<void>(executor, [](int val){ (void)val; });
+            promise.set_value(42);
+            executor.drain();
+        }
+    });
+
+
+    // promise -> future -> then -> then -> then on same executor (only first hop enqueued) ( ~2.34 Mio/sec )
+    bench.run("executor chain", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            Promise<int> promise;
+            Future<int> fut = promise.get_future()
+                                .then<int>(executor, [](int val){ return val + 1; })
+                                .then<int>(executor, [](int val){ return val + 1; })
+                                .then<int>(executor, [](int val){ return val + 1; });
+            promise.set_value(42);
+            executor.drain();
+            if(fut.get_value() != 45) std::cout << "wrong result" << std::endl;
+        }
+    });
+
+
+    // 8 promises -> get_value() one at a time ( ~1.25 Mio/sec )
+    const uint64_t FAN_OUT = 8;
+    bench.run("fan-out get_value", (ITERATIONS / FAN_OUT), [&](){
+        for(uint64_t i=0; i < ITERATIONS / FAN_OUT; i++){
+            std::vector<Promise<int>> promises(FAN_OUT);
+            std::vector<Future<int>> futures;
+            for(Promise<int> &promise : promises) futures.push_back(promise.get_future());
+            for(Promise<int> &promise : promises) promise.set_value(1);
+            int sum = 0;
+            for(Future<int> &future : futures) sum += future.get_value();
+            if(sum != (int)FAN_OUT) std::cout << "wrong result" << std::endl;
+        }
+    });
+
+
+    // 8 promises -> whenAll ( ~0.78 Mio/sec )
+    bench.run("fan-out whenAll", (ITERATIONS / FAN_OUT), [&](){
+        for(uint64_t i=0; i < ITERATIONS / FAN_OUT; i++){
+            std::vector<Promise<int>> promises(FAN_OUT);
+            std::vector<Future<int>> futures;
+            for(Promise<int> &promise : promises) futures.push_back(promise.get_future());
+            Future<std::vector<int>> all = whenAll(futures);
+            for(Promise<int> &promise : promises) promise.set_value(1);
+            if(all.get_value().size() != FAN_OUT) std::cout << "wrong result" << std::endl;
+        }
+    });
+
+
+    // 8 promises -> whenAny ( ~0.79 Mio/sec )
+    bench.run("fan-out whenAny", (ITERATIONS / FAN_OUT), [&](){
+        for(uint64_t i=0; i < ITERATIONS / FAN_OUT; i++){
+            std::vector<Promise<int>> promises(FAN_OUT);
+            std::vector<Future<int>> futures;
+            for(Promise<int> &promise : promises) futures.push_back(promise.get_future());
+            Future<std::pair<size_t, int>> any = whenAny(futures);
+            for(Promise<int> &promise : promises) promise.set_value(1);
+            if(any.get_value().first != 0) std::cout << "wrong result" << std::endl;
+        }
+    });
+
+
+    // 8 promises -> collectN 4 ( ~0.72 Mio/sec )
+    bench.run("fan-out collectN", (ITERATIONS / FAN_OUT), [&](){
+        for(uint64_t i=0; i < ITERATIONS / FAN_OUT; i++){
+            std::vector<Promise<int>> promises(FAN_OUT);
+            std::vector<Future<int>> futures;
+            for(Promise<int> &promise : promises) futures.push_back(promise.get_future());
+            Future<std::vector<std::pair<size_t, int>>> first = collectN(futures, FAN_OUT / 2);
+            for(Promise<int> &promise : promises) promise.set_value(1);
+            if(first.get_value().size() != FAN_OUT / 2) std::cout << "wrong result" << std::endl;
+        }
+    });
+
+
+    // three promises -> nested thenFuture callbacks ( ~1.03 Mio/sec )
+    bench.run("nested callbacks", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            Promise<int> p1, p2, p3;
+            Future<int> f2 = p2.get_future(), f3 = p3.get_future();
+            Future<int> fut = p1.get_future().thenFuture<int>([f2, f3](int a) mutable {
+                return f2.thenFuture<int>([f3, a](int b) mutable {
+                    return f3.then<int>([a, b](int c){ return a + b + c; });
+                });
+            });
+            p1.set_value(1); p2.set_value(2); p3.set_value(3);
+            if(fut.get_value() != 6) std::cout << "wrong result" << std::endl;
+        }
+    });
+
+
+    // three promises -> coroutine awaiting them ( ~1.48 Mio/sec )
+    bench.run("coroutine", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            Promise<int> p1, p2, p3;
+            Future<int> fut = sumCoroutine(p1.get_future(), p2.get_future(), p3.get_future());
+            p1.set_value(1); p2.set_value(2); p3.set_value(3);
+            if(fut.get_value() != 6) std::cout << "wrong result" << std::endl;
+        }
+    });
+
+
+
+    // promise fulfilled by another thread -> get_value() wakes up, reports set_value to wake up latency
+    const uint64_t CROSS_THREAD_ITERATIONS = 200000;
+    bench.run("cross-thread get_value", CROSS_THREAD_ITERATIONS, [&](BenchmarkTimer &timer){
+        std::vector<Promise<uint64_t>> promises(CROSS_THREAD_ITERATIONS);
+        std::vector<Future<uint64_t>> futures;
+        futures.reserve(CROSS_THREAD_ITERATIONS);
+        for(Promise<uint64_t> &promise : promises) futures.push_back(promise.get_future());
+
+        Thread producer([&promises](){
+            for(Promise<uint64_t> &promise : promises) promise.set_value(nowNs());
+        });
+        bench.pin(producer, 0);
+        LatencyHistogram wake;
+        timer.start();
+        producer.start();
+        for(Future<uint64_t> &future : futures) wake.record(nowNs() - future.get_value());
+        producer.join();
+        timer.stop();
+        timer.latency("wake", wake);
+    });
+
+    return bench.finish();
 }
\ No newline at end of file
@@ -1,10 +1,40 @@
+#include "./utils/CallbackQueueThreadSafe.hpp"
 #include "./utils/Future.hpp"
+#include "./utils/Thread.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
 using namespace spi;
 
 
+Future<int> addCoroutine(Future<int> a, Future<int> b) {
+    int x = co_await a;
+    int y = co_await b;
+    co_return x + y;
+}
+
+Future<std::shared_ptr<int>> sharedCoroutine(Future<std::string> str) {
+    std::string value = co_await str;
+    co_return std::make_shared<int>((int)value.size());
+}
+
+Future<void> voidCoroutine(Future<void> done) {
+    co_await done;
+}
+
+Future<int> throwingCoroutine(Future<int> a) {
+    int x = co_await a;
+    if(x > 0) throw std::runtime_error("coroutine failed");
+    co_return x;
+}
+
+
 int main() {
 
     // future returning value
@@ -49,5 +79,203 @@ int main() {
         return future;
     });
 
+    // states created by one thread and destroyed by another go back to pool of creator
+    {
+        const int COUNT = 10000;
+        std::vector<Promise<int>*> promises;
+        std::vector<Future<int>> futures;
+        for(int i=0; i < COUNT; i++){
+            promises.push_back(new Promise<int>());
+            futures.push_back(promises.back()->get_future());
+        }
+        std::thread producer([&promises]{
+            for(size_t i=0; i < promises.size(); i++){
+                promises[i]->set_value((int)i);
+                delete promises[i];
+            }
+        });
+        long sum = 0;
+        for(int i=0; i < COUNT; i++) sum += futures[i].get_value();
+        producer.join();
+        if(sum != (long)COUNT * (COUNT - 1) / 2) throw std::runtime_error("wrong sum of future values");
+        futures.clear(); // last references released by this thread
+
+        std::thread consumer([]{
+            std::vector<Future<int>> local;
+            for(int i=0; i < 1000; i++) local.push_back(Future<int>(i));
+        }); // pool of exited thread must not be used anymore
+        consumer.join();
+        Future<int> after = Future<int>(1);
+        if(after.get_value() != 1) throw std::runtime_error("wrong value after pool reuse");
+    }
+
+    // continuations executed on executors
+    {
+        ThreadPool pool(0, 2);
+        Promise<int> promise;
+        std::atomic<bool> onWorker{false};
+        std::atomic<bool> sameWorker{false};
+        Future<int> chained = promise.get_future().then<int>(pool, [&pool, &onWorker](int value){
+            onWorker = pool.runsOnCurrentThread();
+            return value + 1;
+        }).then<int>(pool, [&pool, &sameWorker](int value){
+            sameWorker = pool.runsOnCurrentThread(); // inline on same executor
+            return value * 2;
+        });
+        promise.set_value(20);
+        if(chained.get_value() != 42 || !onWorker || !sameWorker) throw std::runtime_error("continuation not executed on thread pool");
+
+        CallbackQueueThreadSafe<std::function<bool()>> queue;
+        int received = 0;
+        Future<std::string>("queued").onValue(queue, [&received](std::string str){ received = (int)str.size(); });
+        if(received != 0) throw std::runtime_error("continuation executed before queue got executed");
+        queue.execute();
+        if(received != 6) throw std::runtime_error("continuation not executed by callback queue");
+
+        std::shared_ptr<int> tracked = std::make_shared<int>(0);
+        {
+            CallbackQueueThreadSafe<std::function<bool()>> dropped;
+            Future<int>(1).onValue(dropped, [tracked](int){});
+        }
+        if(tracked.use_count() != 1) throw std::runtime_error("continuation leaked by destroyed callback queue");
+
+        struct ManualExecutor {
+            std::vector<Task> tasks;
+            void enqueue(Task task){ tasks.push_back(std::move(task)); }
+        } manual;
+        Future<void> done = Future<void>().then<void>(manual, []{});
+        Future<int> failed = Future<int>(std::runtime_error("failed")).then<int>(manual, [](int value){ return value; });
+        if(manual.tasks.size() != 1 || done.is_ready() || !failed.has_exception()) throw std::runtime_error("wrong tasks handed to user executor");
+        manual.tasks[0]();
+        if(!done.has_value()) throw std::runtime_error("user executor did not fulfill future");
+    }
+
+    // combinators
+    {
+        std::vector<Promise<int>*> promises;
+        std::vector<Future<int>> futures;
+        for(int i=0; i < 4; i++){
+            promises.push_back(new Promise<int>());
+            futures.push_back(promises.back()->get_future());
+        }
+        Future<std::vector<int>> all = whenAll(futures);
+        Future<std::pair<size_t, int>> any = whenAny(futures);
+        Future<std::vector<std::pair<size_t, int>>> two = collectN(futures, 2);
+        promises[2]->set_value(2);
+        if(!any.has_value() || any.get_value().first != 2 || two.is_ready() || all.is_ready()) throw std::runtime_error("whenAny() not set by first future");
+        promises[0]->set_value(0);
+        if(!two.has_value() || two.get_value()[0].first != 2 || two.get_value()[1].first != 0) throw std::runtime_error("collectN() did not collect first values");
+        promises[3]->set_value(3);
+        promises[1]->set_value(1);
+        std::vector<int> values = all.get_value();
+        for(int i=0; i < 4; i++){
+            if(values[i] != i) throw std::runtime_error("whenAll() values in wrong order");
+            delete promises[i];
+        }
+
+        Promise<void> failing;
+        Future<void> allVoid = whenAll(std::vector<Future<void>>{Future<void>(), failing.get_future()});
+        failing.set_exception(std::runtime_error("failed"));
+        if(!allVoid.has_exception()) throw std::runtime_error("whenAll() did not forward exception");
+
+        Future<std::tuple<int, std::string>> mixed = whenAll(Future<int>(1), Future<std::string>("two"));
+        if(std::get<0>(mixed.get_value()) != 1 || std::get<1>(mixed.get_value()) != "two") throw std::runtime_error("variadic whenAll() returned wrong values");
+
+        if(!whenAll(std::vector<Future<int>>()).has_value() || !whenAny(std::vector<Future<int>>()).has_exception())
+            throw std::runtime_error("combinators with no futures returned wrong result");
+    }
+
+    // coroutines returning and awaiting futures
+    {
+        Promise<int> promise;
+        Future<int> sum = addCoroutine(promise.get_future(), Future<int>(2));
+        if(sum.is_ready()) throw std::runtime_error("coroutine did not suspend");
+        std::thread producer([&promise]{ promise.set_value(40); }); // resumes coroutine on producer
+        producer.join();
+        if(sum.get_value() != 42) throw std::runtime_error("coroutine returned wrong value");
+
+        if(*sharedCoroutine(Future<std::string>("four")).get_value() != 4) throw std::runtime_error("coroutine returned wrong shared_ptr");
+
+        Promise<void> done;
+        Future<void> finished = voidCoroutine(done.get_future());
+        done.set_value();
+        if(!finished.has_value()) throw std::runtime_error("void coroutine not finished");
+
+        if(!throwingCoroutine(Future<int>(1)).has_exception()) throw std::runtime_error("coroutine did not forward exception");
+        if(!throwingCoroutine(Future<int>(std::runtime_error("failed"))).has_exception()) throw std::runtime_error("co_await did not rethrow exception");
+
+        // result set while the coroutine suspends (coroutine continues inline instead of being resumed by the registration)
+        for(int i=0; i < 2000; i++){
+            Promise<int> racing;
+            Future<int> raced = racing.get_future();
+            std::thread setter([&racing]{ racing.set_value(1); });
+            Future<int> result = addCoroutine(std::move(raced), Future<int>(1));
+            setter.join();
+            if(result.get_value() != 2) throw std::runtime_error("coroutine racing with producer returned wrong value");
+        }
+    }
+
+    // timeouts and cancellation
+    {
+        Promise<int> promise;
+        Future<int> future = promise.get_future();
+        if(future.wait_for(std::chrono::milliseconds(5)) || future.is_ready()) throw std::runtime_error("wait_for() returned before result was set");
+        std::thread producer([&promise]{ promise.set_value(7); });
+        if(!future.wait_until(std::chrono::steady_clock::now() + std::chrono::seconds(10)) || future.get_value() != 7)
+            throw std::runtime_error("wait_until() did not return result");
+        producer.join();
+
+        // cancelling a continuation reaches the producer, which may stop early
+        Promise<int> source;
+        std::atomic<bool> stopped{false};
+        std::atomic<bool> executed{false};
+        source.onCancel([&stopped]{ stopped = true; });
+        CancellationToken token = source.get_cancellation_token();
+        Future<int> chained = source.get_future().then<int>([&executed](int value){
+            executed = true;
+            return value + 1;
+        }).thenFuture<int>([](int value){ return Future<int>(value * 2); });
+        if(!chained.cancel() || !chained.is_cancelled() || !chained.has_exception()) throw std::runtime_error("cancel() did not fail future");
+        if(!stopped || !token.isCancelled() || !source.isCancelled()) throw std::runtime_error("cancellation did not propagate to producer");
+        source.set_value(1); // ignored
+        if(executed || chained.cancel()) throw std::runtime_error("continuation of cancelled future executed");
+
+        // future returned by thenFuture() is cancelled as well
+        Promise<int> inner;
+        Promise<int> outer;
+        Future<int> nested = outer.get_future().thenFuture<int>([&inner](int){ return inner.get_future(); });
+        outer.set_value(1);
+        nested.cancel();
+        if(!inner.isCancelled()) throw std::runtime_error("cancellation did not reach future returned by thenFuture()");
+
+        // ready futures cannot be cancelled
+        Future<int> ready = Future<int>(3);
+        if(ready.cancel() || ready.is_cancelled() || ready.get_value() != 3) throw std::runtime_error("ready future got cancelled");
+
+        // polling with timed waits keeps working once the result arrives
+        Promise<int> polled;
+        Future<int> polling = polled.get_future();
+        for(int i=0; i < 1000; i++)
+            if(polling.wait_for(std::chrono::microseconds(1))) throw std::runtime_error("wait_for() returned before result was set");
+        std::thread setter([&polled]{ polled.set_value(9); });
+        while(!polling.wait_for(std::chrono::milliseconds(1)));
+        setter.join();
+        if(polling.get_value() != 9) throw std::runtime_error("polled future has wrong result");
+
+        // timeouts run on the shared timer wheel
+        Promise<std::shared_ptr<int>> slow;
+        std::atomic<bool> timedOut{false};
+        slow.onCancel([&timedOut]{ timedOut = true; });
+        Future<std::shared_ptr<int>> limited = withTimeout(slow.get_future(), std::chrono::milliseconds(5));
+        if(!limited.wait_for(std::chrono::seconds(10)) || !limited.has_exception() || !timedOut) throw std::runtime_error("withTimeout() did not cancel future");
+        slow.set_value(std::make_shared<int>(1)); // ignored
+
+        Promise<int> fast;
+        Future<int> inTime = withTimeout(fast.get_future(), std::chrono::milliseconds(20));
+        fast.set_value(5);
+        std::this_thread::sleep_for(std::chrono::milliseconds(40));
+        if(inTime.get_value() != 5 || inTime.is_cancelled()) throw std::runtime_error("withTimeout() cancelled future that was ready in time");
+    }
+
     return 0;
 }
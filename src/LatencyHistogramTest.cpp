@@ -0,0 +1,99 @@
+#include "./utils/LatencyHistogram.hpp"
+#include "./utils/Thread.hpp"
+
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace spi;
+
+
+
+void runBucketTest(){
+    // every value lies within the bounds of its bucket and the relative error is bounded
+    const uint64_t values[] = {0, 1, 31, 32, 33, 63, 64, 1000, 123456789, ((uint64_t)1 << 40) + 12345, UINT64_MAX};
+    for(uint64_t value : values){
+        const size_t index = LatencyHistogramBuckets::index(value);
+        if(index >= LatencyHistogramBuckets::COUNT)
+            throw std::runtime_error("Bucket of "+std::to_string(value)+" out of range: "+std::to_string(index));
+        const uint64_t lowest = LatencyHistogramBuckets::lowest(index);
+        const uint64_t highest = LatencyHistogramBuckets::highest(index);
+        if(value < lowest || value > highest)
+            throw std::runtime_error("Value "+std::to_string(value)+" not within bucket ["+std::to_string(lowest)+", "+std::to_string(highest)+"]");
+        if((double)(highest - lowest) > (double)lowest / (double)LatencyHistogramBuckets::SUB_BUCKETS)
+            throw std::runtime_error("Bucket of "+std::to_string(value)+" too wide");
+    }
+
+    // buckets are contiguous
+    for(size_t i=1; i < LatencyHistogramBuckets::COUNT; i++){
+        if(LatencyHistogramBuckets::lowest(i) != LatencyHistogramBuckets::highest(i - 1) + 1)
+            throw std::runtime_error("Gap between bucket "+std::to_string(i - 1)+" and "+std::to_string(i));
+    }
+    std::cout << "Completed BucketTest successfully" << std::endl;
+}
+
+
+void runPercentileTest(){
+    LatencyHistogram histogram;
+    for(uint64_t i=1; i <= 100000; i++) histogram.record(i);
+
+    const auto expectNear = [](const std::string &name, uint64_t actual, uint64_t expected){
+        const double error = (double)(actual > expected ? actual - expected : expected - actual) / (double)expected;
+        if(error > 1.0 / (double)LatencyHistogramBuckets::SUB_BUCKETS)
+            throw std::runtime_error(name+" should be ~"+std::to_string(expected)+" but it is "+std::to_string(actual));
+    };
+    expectNear("p50", histogram.percentile(50), 50000);
+    expectNear("p99", histogram.percentile(99), 99000);
+    expectNear("p999", histogram.percentile(99.9), 99900);
+    if(histogram.min() != 1 || histogram.max() != 100000 || histogram.percentile(100) != 100000)
+        throw std::runtime_error("min/max should be exact: "+histogram.toString());
+    if(histogram.count() != 100000 || histogram.mean() != 50000.5)
+        throw std::runtime_error("count/mean should be exact: "+histogram.toString());
+
+    LatencyHistogram other;
+    other.record(1000000);
+    histogram.merge(other);
+    if(histogram.count() != 100001 || histogram.max() != 1000000)
+        throw std::runtime_error("merge lost values: "+histogram.toString());
+
+    histogram.reset();
+    if(histogram.count() != 0 || histogram.percentile(99) != 0)
+        throw std::runtime_error("reset should remove all values");
+    std::cout << "Completed PercentileTest successfully" << std::endl;
+}
+
+
+void runConcurrentTest(){
+    const uint64_t THREADS = 4;
+    const uint64_t ITERATIONS = 1000000;
+    ConcurrentLatencyHistogram histogram;
+
+    std::vector<Thread*> threads;
+    for(uint64_t t=0; t < THREADS; t++){
+        threads.push_back(new Thread([&histogram, t, ITERATIONS]{
+            ConcurrentLatencyHistogram::Recorder &recorder = histogram.recorder();
+            for(uint64_t i=0; i < ITERATIONS; i++) recorder.record(t * ITERATIONS + i);
+        }));
+    }
+    for(Thread* thr : threads) thr->start();
+    histogram.snapshot(); // merging while recording must be safe
+    for(Thread* thr : threads) thr->join();
+    for(Thread* thr : threads) delete thr;
+
+    LatencyHistogram snapshot = histogram.snapshot();
+    if(snapshot.count() != THREADS * ITERATIONS)
+        throw std::runtime_error("Snapshot should contain "+std::to_string(THREADS * ITERATIONS)+" values but it contains "+std::to_string(snapshot.count()));
+    if(snapshot.min() != 0 || snapshot.max() != THREADS * ITERATIONS - 1)
+        throw std::runtime_error("Snapshot has wrong min/max: "+snapshot.toString());
+    std::cout << "Completed ConcurrentTest successfully" << std::endl;
+}
+
+
+int main(){
+    runBucketTest();
+    runPercentileTest();
+    runConcurrentTest();
+    return 0;
+}
@@ -1,8 +1,12 @@
+#include "./utils/Benchmark.hpp"
 #include "./utils/Thread.hpp"
 #include "./utils/Lock.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <mutex>
+#include <string>
 #include <vector>
 
 using namespace spi;
@@ -11,7 +15,11 @@ using namespace spi;
 const uint64_t ITERATIONS = 500000000; // before 500000000
 std::mutex mutex;
 Lock spinLock(false);
+Lock adaptiveLock(LockMode::ADAPTIVE);
+TicketLock ticketLock;
+MCSLock mcsLock;
 BusyConditionWait busyConditionWait;
+EventCount eventCount;
 ReadOrWriteAccess rwCond(false, false, true);
 std::vector<Thread*> threads;
 
@@ -21,62 +29,232 @@ std::vector<Thread*> threads;
 
 
 const uint64_t THREAD_ITERATIONS = ITERATIONS / 2;
-int main(){
+const uint64_t FAIR_ITERATIONS = ITERATIONS / 100; // fair locks hand the lock to the next waiting thread at every unlock
+
+
+const uint64_t LATENCY_THREADS = 4;
+const uint64_t LATENCY_ITERATIONS = 2000000;
+
+/**
+ * Measures how long threads wait in lock() while LATENCY_THREADS threads compete for the lock
+ * and reports percentiles of the wait times (tail latency reveals starvation that throughput hides).
+ */
+template<typename LockType>
+void measureLatency(Benchmark &bench, const std::string &name, LockType &lock){
+    bench.run(name + " wait", LATENCY_ITERATIONS, [&](BenchmarkTimer &timer){
+        ConcurrentLatencyHistogram waits;
+        uint64_t counter = 0;
+        for(size_t t=0; t < LATENCY_THREADS; t++){
+            threads.push_back(new Thread([&lock, &counter, &wait = waits.recorder()](){
+                for(uint64_t i=0; i < LATENCY_ITERATIONS / LATENCY_THREADS; i++){
+                    const auto start = std::chrono::steady_clock::now();
+                    lock.lock();
+                    const auto end = std::chrono::steady_clock::now();
+                    counter++;
+                    lock.unlock();
+                    wait.record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+                }
+            }));
+            bench.pin(*threads.back(), t);
+        }
+        timer.start();
+        for(size_t i=0; i < threads.size(); i++) threads[i]->start();
+        for(size_t i=0; i < threads.size(); i++) threads[i]->join();
+        timer.stop();
+        for(size_t i=0; i < threads.size(); i++) delete threads[i];
+        threads.clear();
+
+        const LatencyHistogram all = waits.snapshot();
+        timer.latency("wait", all);
+        timer.metric("wait_max_ns", (double)all.max());
+    });
+}
+
+
+const uint64_t READ_WRITE_THREADS = 4;
+const uint64_t READ_WRITE_ITERATIONS = 20000000;
+
+/**
+ * Measures throughput of READ_WRITE_THREADS threads that read a shared value and
+ * write it every writeEvery operations.
+ */
+void measureReadWrite(Benchmark &bench, const std::string &name, ReadOrWriteAccess &access, uint64_t writeEvery){
+    bench.run(name, READ_WRITE_ITERATIONS, [&](BenchmarkTimer &timer){
+        uint64_t value = 0;
+        for(size_t t=0; t < READ_WRITE_THREADS; t++){
+            threads.push_back(new Thread([&access, &value, writeEvery, t](){
+                uint64_t sum = 0;
+                for(uint64_t i=0; i < READ_WRITE_ITERATIONS / READ_WRITE_THREADS; i++){
+                    if((i + t) % writeEvery == 0){
+                        access.accessWrite();
+                        value++;
+                        access.releaseWrite();
+                    } else {
+                        access.accessRead();
+                        sum += value;
+                        access.releaseRead();
+                    }
+                }
+                volatile uint64_t sink = sum;
+                (void)sink;
+            }));
+            bench.pin(*threads.back(), t);
+        }
+        timer.start();
+        for(size_t i=0; i < threads.size(); i++) threads[i]->start();
+        for(size_t i=0; i < threads.size(); i++) threads[i]->join();
+        timer.stop();
+        for(size_t i=0; i < threads.size(); i++) delete threads[i];
+        threads.clear();
+    });
+}
+
+/**
+ * Measures read-mostly mixes of ReadOrWriteAccess(multithreaded=true) with all shared lock modes.
+ */
+void measureReadWrites(Benchmark &bench){
+    // ReadOrWriteAccess with 4 threads (single core):  95/5 read/write     99/1 read/write
+    // SHARED_MUTEX:                                    ~ 40.8 Mio/s        ~ 45.8 Mio/s
+    // STRIPED:                                         ~ 66.0 Mio/s        ~ 66.9 Mio/s
+    // STRIPED_WRITER_PREFERENCE:                       ~ 65.6 Mio/s        ~ 67.7 Mio/s
+    const std::pair<const char*, SharedLockMode> modes[] = {
+        {"SHARED_MUTEX", SharedLockMode::SHARED_MUTEX},
+        {"STRIPED", SharedLockMode::STRIPED},
+        {"STRIPED_WRITER_PREFERENCE", SharedLockMode::STRIPED_WRITER_PREFERENCE}
+    };
+    for(const auto &mode : modes){
+        ReadOrWriteAccess access(false, true, true, mode.second);
+        measureReadWrite(bench, std::string("ReadOrWriteAccess ") + mode.first + " 95/5", access, 20);
+        measureReadWrite(bench, std::string("ReadOrWriteAccess ") + mode.first + " 99/1", access, 100);
+    }
+    std::cout << std::endl;
+}
+
+
+/**
+ * Measures tail latency of all locks.
+ */
+void measureLatencies(Benchmark &bench){
+    // wait time of lock() with 4 threads on a single core (fair locks show lower max but pay a context switch per handover)
+    //                                      p50         p99         p999        max
+    // std::mutex:                          ~ 36 ns     ~ 37 ns     ~ 39 ns     ~ 12.0 ms
+    // Lock spin:                           ~ 33 ns     ~ 35 ns     ~ 36 ns     ~ 29.1 ms
+    // Lock adaptive:                       ~ 34 ns     ~ 36 ns     ~ 135 ns    ~ 24.0 ms
+    // TicketLock:                          ~ 182 us    ~ 229 us    ~ 533 us    ~ 14.5 ms
+    // MCSLock:                             ~ 11 us     ~ 14 us     ~ 22 us     ~ 4.4 ms
+    measureLatency(bench, "std::mutex", mutex);
+    measureLatency(bench, "Lock spin", spinLock);
+    measureLatency(bench, "Lock adaptive", adaptiveLock);
+    measureLatency(bench, "TicketLock", ticketLock);
+    measureLatency(bench, "MCSLock", mcsLock);
+    std::cout << std::endl;
+}
+
+
+/**
+ * Usage: lock_benchmark [throughput|latency|readwrite] [benchmark options] (default runs all)
+ */
+int main(int argc, char* argv[]){
+    const bool hasMode = argc > 1 && std::string(argv[1]).rfind("--", 0) != 0;
+    const std::string mode = hasMode ? argv[1] : "";
+    Benchmark bench("lock_benchmark", hasMode ? argc - 1 : argc, hasMode ? argv + 1 : argv);
+    if(mode == "latency"){
+        measureLatencies(bench);
+        return bench.finish();
+    }
+    if(mode == "readwrite"){
+        measureReadWrites(bench);
+        return bench.finish();
+    }
 
 
     //                                              RELEASE         |   DEBUG
 
     // single std::lock_guard<std::mutex>:          ~ 104 Mio/s     |   ~  41 Mio/s
-    auto startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        std::lock_guard<std::mutex> lock(mutex);
-        (void)i;
-    }
-    auto endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "single std::lock_guard<std::mutex>: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("single std::lock_guard<std::mutex>", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            std::lock_guard<std::mutex> lock(mutex);
+            (void)i;
+        }
+    });
 
 
     // single Lock::lock():                         ~ 112 Mio/s     |   ~  43 Mio/s
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        spinLock.lock();
-        (void)i;
-        spinLock.unlock();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "single Lock::lock(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("single Lock::lock()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            spinLock.lock();
+            (void)i;
+            spinLock.unlock();
+        }
+    });
+
+
+    // single Lock::lock() adaptive:                ~ 66 Mio/s      |   -
+    bench.run("single Lock::lock() adaptive", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            adaptiveLock.lock();
+            (void)i;
+            adaptiveLock.unlock();
+        }
+    });
+
+
+    // single TicketLock::lock():                   ~ 102 Mio/s     |   -
+    bench.run("single TicketLock::lock()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            ticketLock.lock();
+            (void)i;
+            ticketLock.unlock();
+        }
+    });
+
+
+    // single MCSLock::lock():                      ~ 55 Mio/s      |   -
+    bench.run("single MCSLock::lock()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            mcsLock.lock();
+            (void)i;
+            mcsLock.unlock();
+        }
+    });
 
 
     // single BusyConditionWait::check():           ~ 1051 Mio/s    |   ~ 85 Mio/s
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        busyConditionWait.check();
-        (void)i;
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "single BusyConditionWait::check(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("single BusyConditionWait::check()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            busyConditionWait.check();
+            (void)i;
+        }
+    });
+
+
+    // single EventCount::notifyOne() (no waiters): ~ ??? Mio/s
+    bench.run("single EventCount::notifyOne() (no waiters)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            eventCount.notifyOne();
+            (void)i;
+        }
+    });
 
 
     // single ReadOrWriteAccess::accessRead():      ~ 642 Mio/s     |   ~ 230 Mio/s
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        rwCond.accessRead();
-        (void)i;
-        rwCond.releaseRead();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "single ReadOrWriteAccess.accessRead(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("single ReadOrWriteAccess.accessRead()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            rwCond.accessRead();
+            (void)i;
+            rwCond.releaseRead();
+        }
+    });
 
 
     // single ReadOrWriteAccess::accessWrite():     ~ 661 Mio/s     |   ~ 233 Mio/s
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        rwCond.accessWrite();
-        (void)i;
-        rwCond.releaseWrite();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "single ReadOrWriteAccess.accessWrite(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("single ReadOrWriteAccess.accessWrite()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            rwCond.accessWrite();
+            (void)i;
+            rwCond.releaseWrite();
+        }
+    });
     std::cout << std::endl;
 
 
@@ -85,90 +263,165 @@ int main(){
 
 
     // multi std::lock_guard<std::mutex>:           ~ 21.2 Mio/s    |   ~  13.4 Mio/s
-    for(size_t i=0; i < 2; i++){
+    bench.run("multi std::lock_guard<std::mutex>", ITERATIONS, [&](BenchmarkTimer &timer){
+        for(size_t i=0; i < 2; i++){
+            threads.push_back(new Thread([](){
+                for(uint64_t i=0; i < THREAD_ITERATIONS; i++){
+                    std::lock_guard<std::mutex> lock(mutex);
+                    (void)i;
+                }
+            }));
+        }
+        for(size_t i=0; i < threads.size(); i++) bench.pin(*threads[i], i);
+        timer.start();
+        for(size_t i=0; i < threads.size(); i++) threads[i]->start();
+        for(size_t i=0; i < threads.size(); i++) threads[i]->join();
+        timer.stop();
+        for(size_t i=0; i < threads.size(); i++) delete threads[i];
+        threads.clear();
+    });
+
+
+    // multi Lock:                                  ~ 100.0 Mio/s   |   ~  32.7 Mio/s
+    bench.run("multi Lock", ITERATIONS, [&](BenchmarkTimer &timer){
+        for(size_t i=0; i < 2; i++){
+            threads.push_back(new Thread([](){
+                for(uint64_t i=0; i < THREAD_ITERATIONS; i++){
+                    spinLock.lock();
+                    (void)i;
+                    spinLock.unlock();
+                }
+            }));
+        }
+        for(size_t i=0; i < threads.size(); i++) bench.pin(*threads[i], i);
+        timer.start();
+        for(size_t i=0; i < threads.size(); i++) threads[i]->start();
+        for(size_t i=0; i < threads.size(); i++) threads[i]->join();
+        timer.stop();
+        for(size_t i=0; i < threads.size(); i++) delete threads[i];
+        threads.clear();
+    });
+
+
+    // multi Lock adaptive:                         ~ 66.0 Mio/s    |   -
+    bench.run("multi Lock adaptive", ITERATIONS, [&](BenchmarkTimer &timer){
+        for(size_t i=0; i < 2; i++){
+            threads.push_back(new Thread([](){
+                for(uint64_t i=0; i < THREAD_ITERATIONS; i++){
+                    adaptiveLock.lock();
+                    (void)i;
+                    adaptiveLock.unlock();
+                }
+            }));
+        }
+        for(size_t i=0; i < threads.size(); i++) bench.pin(*threads[i], i);
+        timer.start();
+        for(size_t i=0; i < threads.size(); i++) threads[i]->start();
+        for(size_t i=0; i < threads.size(); i++) threads[i]->join();
+        timer.stop();
+        for(size_t i=0; i < threads.size(); i++) delete threads[i];
+        threads.clear();
+    });
+
+
+    // multi TicketLock:                          ~ 0.07 Mio/s    |   - (single core: every handover needs a context switch)
+    bench.run("multi TicketLock", FAIR_ITERATIONS, [&](BenchmarkTimer &timer){
+        for(size_t i=0; i < 2; i++){
+            threads.push_back(new Thread([](){
+                for(uint64_t i=0; i < FAIR_ITERATIONS / 2; i++){
+                    ticketLock.lock();
+                    (void)i;
+                    ticketLock.unlock();
+                }
+            }));
+        }
+        for(size_t i=0; i < threads.size(); i++) bench.pin(*threads[i], i);
+        timer.start();
+        for(size_t i=0; i < threads.size(); i++) threads[i]->start();
+        for(size_t i=0; i < threads.size(); i++) threads[i]->join();
+        timer.stop();
+        for(size_t i=0; i < threads.size(); i++) delete threads[i];
+        threads.clear();
+    });
+
+
+    // multi MCSLock:                             ~ 0.41 Mio/s    |   - (single core: every handover needs a context switch)
+    bench.run("multi MCSLock", FAIR_ITERATIONS, [&](BenchmarkTimer &timer){
+        for(size_t i=0; i < 2; i++){
+            threads.push_back(new Thread([](){
+                for(uint64_t i=0; i < FAIR_ITERATIONS / 2; i++){
+                    mcsLock.lock();
+                    (void)i;
+                    mcsLock.unlock();
+                }
+            }));
+        }
+        for(size_t i=0; i < threads.size(); i++) bench.pin(*threads[i], i);
+        timer.start();
+        for(size_t i=0; i < threads.size(); i++) threads[i]->start();
+        for(size_t i=0; i < threads.size(); i++) threads[i]->join();
+        timer.stop();
+        for(size_t i=0; i < threads.size(); i++) delete threads[i];
+        threads.clear();
+    });
+
+
+    // multi BusyConditionWait:                     ~ 2.2 Mio/s     |   ~  2.1 Mio/s
+    bench.run("multi BusyConditionWait", ITERATIONS, [&](BenchmarkTimer &timer){
+        busyConditionWait.setProceed(true);
         threads.push_back(new Thread([](){
             for(uint64_t i=0; i < THREAD_ITERATIONS; i++){
-                std::lock_guard<std::mutex> lock(mutex);
+                busyConditionWait.check();
                 (void)i;
             }
         }));
-    }
-    startTime = std::chrono::high_resolution_clock::now();
-    for(size_t i=0; i < threads.size(); i++) threads[i]->start();
-    for(size_t i=0; i < threads.size(); i++) threads[i]->join();
-    endTime = std::chrono::high_resolution_clock::now();
-    for(size_t i=0; i < threads.size(); i++) delete threads[i];
-    threads.clear();
-    std::cout << "multi std::lock_guard<std::mutex>: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
-    
-
-    // multi Lock:                                  ~ 100.0 Mio/s   |   ~  32.7 Mio/s
-    for(size_t i=0; i < 2; i++){
         threads.push_back(new Thread([](){
             for(uint64_t i=0; i < THREAD_ITERATIONS; i++){
-                spinLock.lock();
-                (void)i;
-                spinLock.unlock();
+                busyConditionWait.setProceed(false);
+                std::this_thread::yield();
+                busyConditionWait.setProceed(true);
             }
         }));
-    }
-    startTime = std::chrono::high_resolution_clock::now();
-    for(size_t i=0; i < threads.size(); i++) threads[i]->start();
-    for(size_t i=0; i < threads.size(); i++) threads[i]->join();
-    endTime = std::chrono::high_resolution_clock::now();
-    for(size_t i=0; i < threads.size(); i++) delete threads[i];
-    threads.clear();
-    std::cout << "multi Lock: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
-
-
-    // multi BusyConditionWait:                     ~ 2.2 Mio/s     |   ~  2.1 Mio/s
-    busyConditionWait.setProceed(true);
-    threads.push_back(new Thread([](){
-        for(uint64_t i=0; i < THREAD_ITERATIONS; i++){
-            busyConditionWait.check();
-            (void)i;
-        }
-    }));
-    threads.push_back(new Thread([](){
-        for(uint64_t i=0; i < THREAD_ITERATIONS; i++){
-            busyConditionWait.setProceed(false);
-            std::this_thread::yield();
-            busyConditionWait.setProceed(true);
-        }
-    }));
-    startTime = std::chrono::high_resolution_clock::now();
-    for(size_t i=0; i < threads.size(); i++) threads[i]->start();
-    for(size_t i=0; i < threads.size(); i++) threads[i]->join();
-    endTime = std::chrono::high_resolution_clock::now();
-    for(size_t i=0; i < threads.size(); i++) delete threads[i];
-    threads.clear();
-    std::cout << "multi BusyConditionWait: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+        for(size_t i=0; i < threads.size(); i++) bench.pin(*threads[i], i);
+        timer.start();
+        for(size_t i=0; i < threads.size(); i++) threads[i]->start();
+        for(size_t i=0; i < threads.size(); i++) threads[i]->join();
+        timer.stop();
+        for(size_t i=0; i < threads.size(); i++) delete threads[i];
+        threads.clear();
+    });
 
 
     // multi ReadOrWriteAccess:                     ~ 9.7 Mio/s     |   ~  9.0 Mio/s
-    threads.push_back(new Thread([](){
-        for(uint64_t i=0; i < THREAD_ITERATIONS; i++){
-            rwCond.accessRead();
-            (void)i;
-            rwCond.releaseRead();
-        }
-    }));
-    threads.push_back(new Thread([](){
-        for(uint64_t i=0; i < THREAD_ITERATIONS; i++){
-            rwCond.accessWrite();
-            (void)i;
-            rwCond.releaseWrite();
-        }
-    }));
-    startTime = std::chrono::high_resolution_clock::now();
-    for(size_t i=0; i < threads.size(); i++) threads[i]->start();
-    for(size_t i=0; i < threads.size(); i++) threads[i]->join();
-    endTime = std::chrono::high_resolution_clock::now();
-    for(size_t i=0; i < threads.size(); i++) delete threads[i];
-    threads.clear();
-    std::cout << "multi ReadOrWriteAccess: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("multi ReadOrWriteAccess", ITERATIONS, [&](BenchmarkTimer &timer){
+        threads.push_back(new Thread([](){
+            for(uint64_t i=0; i < THREAD_ITERATIONS; i++){
+                rwCond.accessRead();
+                (void)i;
+                rwCond.releaseRead();
+            }
+        }));
+        threads.push_back(new Thread([](){
+            for(uint64_t i=0; i < THREAD_ITERATIONS; i++){
+                rwCond.accessWrite();
+                (void)i;
+                rwCond.releaseWrite();
+            }
+        }));
+        for(size_t i=0; i < threads.size(); i++) bench.pin(*threads[i], i);
+        timer.start();
+        for(size_t i=0; i < threads.size(); i++) threads[i]->start();
+        for(size_t i=0; i < threads.size(); i++) threads[i]->join();
+        timer.stop();
+        for(size_t i=0; i < threads.size(); i++) delete threads[i];
+        threads.clear();
+    });
     std::cout << std::endl;
 
+    if(mode != "throughput"){
+        measureLatencies(bench);
+        measureReadWrites(bench);
+    }
 
-    return 0;
+    return bench.finish();
 }
\ No newline at end of file
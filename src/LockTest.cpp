@@ -1,9 +1,18 @@
+#include "./utils/Barrier.hpp"
+#include "./utils/CallbackQueueThreadSafe.hpp"
 #include "./utils/Lock.hpp"
+#include "./utils/QueueBlocking.hpp"
+#include "./utils/QueueLock.hpp"
 #include "./utils/Thread.hpp"
 
 #include <cmath>
 #include <iostream>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <shared_mutex>
 #include <stdexcept>
+#include <vector>
 
 using namespace spi;
 
@@ -33,6 +42,122 @@ void runSpinLock(size_t myId){
 
 
 
+// Lock (LockMode::ADAPTIVE)
+const bool ADAPTIVE_LOCK_TEST = true;
+const size_t ADAPTIVE_LOCK_ITERATIONS = 400000;
+const size_t ADAPTIVE_LOCK_THREADS = 8;
+Lock adaptiveLock(LockMode::ADAPTIVE);
+bool adaptiveLockAccessTracker[ADAPTIVE_LOCK_THREADS];
+size_t adaptiveLockCounter = 0;
+
+void runAdaptiveLock(size_t myId){
+    const size_t iterations = ADAPTIVE_LOCK_ITERATIONS / ADAPTIVE_LOCK_THREADS;
+    for(size_t i=0; i < iterations; i++){
+        adaptiveLock.lock();
+        adaptiveLockAccessTracker[myId] = true;
+        for(size_t j=0; j < ADAPTIVE_LOCK_THREADS; j++){
+            if(j != myId && adaptiveLockAccessTracker[j])
+                throw std::runtime_error("Multiple threads accessing the same adaptive lock at the same time myId="+std::to_string(myId)+" otherId="+std::to_string(j)+
+                                            " at iteration="+std::to_string(i));
+        }
+        adaptiveLockCounter++;
+        if(i % 1000 == 0) Thread::sleepUs(50); // long hold so waiting threads park
+        adaptiveLockAccessTracker[myId] = false;
+        adaptiveLock.unlock();
+    }
+}
+
+
+
+
+// TicketLock, MCSLock
+const bool FAIR_LOCK_TEST = true;
+const size_t FAIR_LOCK_ITERATIONS = 200000;
+const size_t FAIR_LOCK_THREADS = 8;
+
+template<typename LockType>
+void testFairLock(const std::string &name){
+    LockType lock;
+    size_t counter = 0;
+    size_t holders = 0;
+    bool failed = false;
+    std::vector<Thread*> threads;
+    for(size_t t=0; t < FAIR_LOCK_THREADS; t++){
+        threads.push_back(new Thread([&]{
+            for(size_t i=0; i < FAIR_LOCK_ITERATIONS / FAIR_LOCK_THREADS; i++){
+                lock.lock();
+                if(++holders != 1) failed = true;
+                counter++;
+                holders--;
+                lock.unlock();
+            }
+        }));
+    }
+    for(Thread* thread : threads) thread->start();
+    for(Thread* thread : threads){
+        thread->join();
+        delete thread;
+    }
+    if(failed) throw std::runtime_error("Multiple threads holding "+name+" at the same time");
+    if(counter != FAIR_LOCK_ITERATIONS) throw std::runtime_error(name+" lost updates counter="+std::to_string(counter));
+
+    // usable by the lock based queues
+    QueueLock<size_t, LockType> queue;
+    QueueLockCustom<size_t, LockType> queueCustom;
+    BasicCallbackQueueThreadSafe<LockType, bool(*)()> callbacks;
+    size_t value = 0;
+    queue.push(1);
+    queueCustom.push(2);
+    callbacks.push([]{ return true; });
+    if(!queue.pop(value) || value != 1 || !queueCustom.pop(value) || value != 2 || !callbacks.execute())
+        throw std::runtime_error("Queues not working with "+name);
+}
+
+
+
+
+// StripedSharedMutex
+const bool STRIPED_SHARED_MUTEX_TEST = true;
+const size_t STRIPED_SHARED_MUTEX_ITERATIONS = 100000;
+const size_t STRIPED_SHARED_MUTEX_THREADS = 8;
+
+void testStripedSharedMutex(bool writerPreference){
+    StripedSharedMutex lock(writerPreference, 4);
+    std::atomic<int> readers{0};
+    std::atomic<int> writers{0};
+    size_t value = 0; // always even outside of a write
+    bool failed = false;
+    std::vector<Thread*> threads;
+    for(size_t t=0; t < STRIPED_SHARED_MUTEX_THREADS; t++){
+        threads.push_back(new Thread([&, t]{
+            for(size_t i=0; i < STRIPED_SHARED_MUTEX_ITERATIONS / STRIPED_SHARED_MUTEX_THREADS; i++){
+                if((i + t) % 10 == 0){
+                    std::unique_lock<StripedSharedMutex> write(lock);
+                    if(writers.fetch_add(1) != 0 || readers.load() != 0) failed = true;
+                    value++;
+                    value++;
+                    writers.fetch_sub(1);
+                } else {
+                    std::shared_lock<StripedSharedMutex> read(lock);
+                    readers.fetch_add(1);
+                    if(writers.load() != 0 || value % 2 != 0) failed = true;
+                    readers.fetch_sub(1);
+                }
+            }
+        }));
+    }
+    for(Thread* thread : threads) thread->start();
+    for(Thread* thread : threads){
+        thread->join();
+        delete thread;
+    }
+    if(failed) throw std::runtime_error("StripedSharedMutex let writer and other thread in at the same time (writerPreference="+std::to_string(writerPreference)+")");
+    if(value != STRIPED_SHARED_MUTEX_ITERATIONS / 10 * 2) throw std::runtime_error("StripedSharedMutex lost writes value="+std::to_string(value));
+}
+
+
+
+
 // ReadOrWriteAccess
 const bool READ_OR_WRITE_ACCESS_TEST = true;
 const size_t READ_OR_WRITE_ACCESS_ITERATIONS = 100000;
@@ -87,6 +212,180 @@ void runReadOrWriteAccessWRITE(size_t &progress){
 }
 
 
+
+
+
+// EventCount, QueueBlocking
+const bool EVENT_COUNT_TEST = true;
+const uint64_t EVENT_COUNT_ROUNDS = 2000;
+const size_t EVENT_COUNT_CONSUMERS = 4;
+
+template<typename Q>
+void testQueueBlocking(const std::string &name){
+    Q queue;
+    QueueBlocking<Q> blocking(queue);
+    std::atomic<uint64_t> popped{0}, sum{0};
+    std::vector<Thread*> consumers;
+    for(size_t i=0; i < EVENT_COUNT_CONSUMERS; i++){
+        consumers.push_back(new Thread([&]{
+            uint64_t value, localSum = 0;
+            while(blocking.popWait(value)){
+                localSum += value;
+                popped.fetch_add(1);
+            }
+            sum.fetch_add(localSum);
+        }));
+        consumers.back()->start();
+    }
+
+    // short bursts with pauses so consumers park between them, every round must be drained
+    uint64_t expected = 0;
+    for(uint64_t round=0; round < EVENT_COUNT_ROUNDS; round++){
+        const uint64_t burst = round % 4;
+        for(uint64_t i=0; i < burst; i++){
+            blocking.push(expected + i);
+        }
+        expected += burst;
+        const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while(popped.load() < expected){
+            if(std::chrono::steady_clock::now() > timeout)
+                throw std::runtime_error(name+" lost a wakeup in round "+std::to_string(round)+" ("+std::to_string(popped.load())+" of "+std::to_string(expected)+" popped)");
+            std::this_thread::yield();
+        }
+    }
+    blocking.close();
+    for(Thread* consumer : consumers){
+        consumer->join();
+        delete consumer;
+    }
+    if(sum.load() != expected * (expected - 1) / 2) throw std::runtime_error(name+" popped wrong elements");
+    std::cout << "  " << name << " passed" << std::endl;
+}
+
+void testBusyConditionWait(){
+    BusyConditionWait condition;
+    std::atomic<uint64_t> passed{0}, paused{0};
+    condition.setWait();
+    std::vector<Thread*> threads;
+    for(size_t i=0; i < EVENT_COUNT_CONSUMERS; i++){
+        threads.push_back(new Thread([&]{
+            condition.check([&]{ paused++; });
+            passed++;
+        }));
+        threads.back()->start();
+    }
+    while(paused.load() < EVENT_COUNT_CONSUMERS) std::this_thread::yield();
+    Thread::sleepMs(10);
+    if(passed.load() != 0) throw std::runtime_error("BusyConditionWait let threads pass before setProceed()");
+    condition.setProceed();
+    for(Thread* thread : threads){
+        thread->join();
+        delete thread;
+    }
+    if(passed.load() != EVENT_COUNT_CONSUMERS) throw std::runtime_error("BusyConditionWait did not wake all threads");
+    std::cout << "  BusyConditionWait passed" << std::endl;
+}
+
+
+
+
+
+// SpinLatch, SpinBarrier, Phaser
+const bool BARRIER_TEST = true;
+const size_t BARRIER_THREADS = 8;
+const uint32_t BARRIER_PHASES = 2000;
+
+void testSpinLatch(){
+    SpinLatch latch((int32_t)BARRIER_THREADS);
+    std::atomic<size_t> before{0}, after{0};
+    std::vector<Thread*> threads;
+    for(size_t i=0; i < BARRIER_THREADS; i++){
+        threads.push_back(new Thread([&]{
+            before++;
+            latch.arriveAndWait();
+            if(before.load() != BARRIER_THREADS) throw std::runtime_error("SpinLatch released a thread before all arrived");
+            after++;
+        }));
+        threads.back()->start();
+    }
+    for(Thread* thread : threads){
+        thread->join();
+        delete thread;
+    }
+    if(after.load() != BARRIER_THREADS || !latch.tryWait()) throw std::runtime_error("SpinLatch did not release all threads");
+
+    SpinLatch exceeded(2);
+    bool thrown = false;
+    try { exceeded.countDown(3); } catch(const std::runtime_error&){ thrown = true; }
+    if(!thrown) throw std::runtime_error("SpinLatch accepted a count down below zero");
+    exceeded.countDown(2); // counter must be untouched by the rejected count down
+    if(!exceeded.tryWait()) throw std::runtime_error("SpinLatch changed the counter on a rejected count down");
+    std::cout << "  SpinLatch passed" << std::endl;
+}
+
+void testSpinBarrier(size_t fanIn){
+    std::atomic<uint64_t> arrivals{0};
+    uint64_t completions = 0;
+    SpinBarrier barrier(BARRIER_THREADS, [&]{
+        completions++;
+        if(arrivals.load() != completions * BARRIER_THREADS)
+            throw std::runtime_error("SpinBarrier completed phase "+std::to_string(completions)+" before all participants arrived");
+    }, fanIn);
+    std::atomic<size_t> serial{0};
+    std::vector<Thread*> threads;
+    for(size_t i=0; i < BARRIER_THREADS; i++){
+        threads.push_back(new Thread([&, i]{
+            for(uint32_t phase=0; phase < BARRIER_PHASES; phase++){
+                if(barrier.getPhase() != phase) throw std::runtime_error("SpinBarrier participant "+std::to_string(i)+" ran ahead");
+                arrivals++;
+                if(barrier.arriveAndWait(i)) serial++;
+            }
+        }));
+        threads.back()->start();
+    }
+    for(Thread* thread : threads){
+        thread->join();
+        delete thread;
+    }
+    if(completions != BARRIER_PHASES || serial.load() != BARRIER_PHASES || barrier.getPhase() != BARRIER_PHASES)
+        throw std::runtime_error("SpinBarrier completed "+std::to_string(completions)+" of "+std::to_string(BARRIER_PHASES)+" phases");
+    bool thrown = false;
+    try { barrier.arriveAndWait(BARRIER_THREADS); } catch(const std::runtime_error&){ thrown = true; }
+    if(!thrown) throw std::runtime_error("SpinBarrier accepted participant index "+std::to_string(BARRIER_THREADS));
+    std::cout << "  SpinBarrier (fanIn=" << fanIn << ") passed" << std::endl;
+}
+
+void testPhaser(){
+    Phaser phaser(1); // main thread controls the phases
+    std::atomic<uint64_t> work{0};
+    std::vector<Thread*> threads;
+    for(size_t i=0; i < BARRIER_THREADS; i++){
+        phaser.registerParty();
+        threads.push_back(new Thread([&, i]{
+            const uint32_t phases = (uint32_t)(BARRIER_PHASES / 4 + i); // parties leave at different phases
+            for(uint32_t phase=0; phase < phases; phase++){
+                work++;
+                if(phase + 1 < phases) phaser.arriveAndAwaitAdvance();
+                else phaser.arriveAndDeregister();
+            }
+        }));
+        threads.back()->start();
+    }
+    uint32_t phase = 0;
+    while(phaser.getRegisteredParties() > 1) phase = phaser.awaitAdvance(phaser.arrive());
+    for(Thread* thread : threads){
+        thread->join();
+        delete thread;
+    }
+    uint64_t expected = 0;
+    for(size_t i=0; i < BARRIER_THREADS; i++) expected += BARRIER_PHASES / 4 + i;
+    if(work.load() != expected || phase != BARRIER_PHASES / 4 + BARRIER_THREADS - 1 || phaser.getUnarrivedParties() != 1)
+        throw std::runtime_error("Phaser ended in phase "+std::to_string(phase)+" with work="+std::to_string(work.load()));
+    std::cout << "  Phaser passed" << std::endl;
+}
+
+
+
 int main(){
 
 
@@ -109,6 +408,81 @@ int main(){
     }
 
 
+    // Lock (LockMode::ADAPTIVE)
+    if(ADAPTIVE_LOCK_TEST){
+        std::cout << "Adaptive lock test" << std::endl;
+        Thread* threads[ADAPTIVE_LOCK_THREADS];
+        for(size_t i=0; i < ADAPTIVE_LOCK_THREADS; i++){
+            const size_t myId = i;
+            adaptiveLockAccessTracker[i] = false;
+            threads[i] = new Thread(runAdaptiveLock, myId);
+        }
+        for(size_t i=0; i < ADAPTIVE_LOCK_THREADS; i++)
+            threads[i]->start();
+        for(size_t i=0; i < ADAPTIVE_LOCK_THREADS; i++){
+            threads[i]->join();
+            delete threads[i];
+        }
+        if(adaptiveLockCounter != ADAPTIVE_LOCK_ITERATIONS)
+            throw std::runtime_error("Adaptive lock lost updates counter="+std::to_string(adaptiveLockCounter));
+
+        adaptiveLock.setMode(LockMode::SPIN);
+        adaptiveLock.lock();
+        adaptiveLock.unlock();
+        adaptiveLock.setMode(LockMode::ADAPTIVE);
+        std::cout << "Adaptive lock test passed (spin budget: " << adaptiveLock.getSpinBudget() << ")" << std::endl;
+    }
+
+
+    // TicketLock, MCSLock
+    if(FAIR_LOCK_TEST){
+        std::cout << "Fair lock test" << std::endl;
+        testFairLock<TicketLock>("TicketLock");
+        testFairLock<MCSLock>("MCSLock");
+        std::cout << "Fair lock test passed" << std::endl;
+    }
+
+
+    // StripedSharedMutex
+    if(STRIPED_SHARED_MUTEX_TEST){
+        std::cout << "StripedSharedMutex test" << std::endl;
+        testStripedSharedMutex(true);
+        testStripedSharedMutex(false);
+
+        ReadOrWriteAccess access(false, true, true, SharedLockMode::STRIPED_WRITER_PREFERENCE);
+        access.accessRead();
+        access.accessRead();
+        access.releaseRead();
+        access.releaseRead();
+        access.accessWrite();
+        access.releaseWrite();
+        access.setMultithreaded(false);
+        access.setMultithreaded(true);
+        std::cout << "StripedSharedMutex test passed" << std::endl;
+    }
+
+
+    // EventCount, QueueBlocking
+    if(EVENT_COUNT_TEST){
+        std::cout << "EventCount test" << std::endl;
+        testQueueBlocking<QueueLock<uint64_t>>("QueueBlocking<QueueLock>");
+        testQueueBlocking<QueueAtomic<uint64_t>>("QueueBlocking<QueueAtomic>");
+        testBusyConditionWait();
+        std::cout << "EventCount test passed" << std::endl;
+    }
+
+
+    // SpinLatch, SpinBarrier, Phaser
+    if(BARRIER_TEST){
+        std::cout << "Barrier test" << std::endl;
+        testSpinLatch();
+        testSpinBarrier(SPI_BARRIER_FAN_IN);
+        testSpinBarrier(2); // three levels of combining nodes
+        testPhaser();
+        std::cout << "Barrier test passed" << std::endl;
+    }
+
+
     // ReadOrWriteAccess
     if(READ_OR_WRITE_ACCESS_TEST){
         std::cout << "ReadOrWriteAccess test" << std::endl;
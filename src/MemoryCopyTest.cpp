@@ -0,0 +1,72 @@
+#include "./utils/MemoryCopy.hpp"
+#include "./utils/Thread.hpp"
+
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace spi;
+
+
+std::string strategyName(CopyStrategy strategy){
+    switch(strategy){
+        case CopyStrategy::AUTO: return "AUTO";
+        case CopyStrategy::MEMCPY: return "MEMCPY";
+        case CopyStrategy::VECTOR: return "VECTOR";
+        case CopyStrategy::STREAM: return "STREAM";
+    }
+    return "?";
+}
+
+/**
+ * Copies with every strategy from and to unaligned offsets, bytes around the destination must stay untouched.
+ */
+void runStrategyTest(){
+    const size_t sizes[] = {0, 1, 31, 64, 127, 255, 256, 257, 1000, 4096, 65537, 1 << 20};
+    const CopyStrategy strategies[] = {CopyStrategy::AUTO, CopyStrategy::MEMCPY, CopyStrategy::VECTOR, CopyStrategy::STREAM};
+    for(size_t size : sizes){
+        std::vector<uint8_t> src(size + 128), dst(size + 128);
+        for(size_t i=0; i < src.size(); i++) src[i] = (uint8_t)(i * 7 + 3);
+        for(CopyStrategy strategy : strategies){
+            for(size_t offset : {0, 1, 13, 64}){
+                std::fill(dst.begin(), dst.end(), (uint8_t)0xAB);
+                MemoryCopy::copy(dst.data() + offset, src.data() + (offset ^ 5), size, strategy);
+                for(size_t i=0; i < dst.size(); i++){
+                    const uint8_t expected = i >= offset && i < offset + size ? src[i - offset + (offset ^ 5)] : (uint8_t)0xAB;
+                    if(dst[i] != expected)
+                        throw std::runtime_error("StrategyTest: "+strategyName(strategy)+" copy of "+std::to_string(size)+" bytes to offset "+std::to_string(offset)+" wrong at byte "+std::to_string(i));
+                }
+            }
+        }
+    }
+    std::cout << "Completed StrategyTest (" << MemoryCopy::simdName() << ", streaming from " << MemoryCopy::getStreamThreshold() << " bytes) successfully" << std::endl;
+}
+
+void runParallelTest(){
+    ThreadPool pool(2, 2);
+    const size_t SIZE = (size_t)10 * 1024 * 1024 + 123;
+    std::vector<uint8_t> src(SIZE), dst(SIZE, 0);
+    for(size_t i=0; i < SIZE; i++) src[i] = (uint8_t)(i * 31);
+    MemoryCopy::copyParallel(pool, dst.data(), src.data(), SIZE, 1024 * 1024 + 1);
+    if(dst != src) throw std::runtime_error("ParallelTest: parallel copy differs from source");
+
+    // copies inline if already running on the pool
+    std::vector<uint8_t> nested(SIZE, 0);
+    std::atomic<bool> done{false};
+    pool.submitTask([&]{
+        MemoryCopy::copyParallel(pool, nested.data(), src.data(), SIZE, 1024 * 1024, CopyStrategy::STREAM);
+        done = true;
+    });
+    while(!done.load()) std::this_thread::yield();
+    if(nested != src) throw std::runtime_error("ParallelTest: parallel copy on pool worker differs from source");
+    std::cout << "Completed ParallelTest successfully" << std::endl;
+}
+
+
+int main(){
+    runStrategyTest();
+    runParallelTest();
+    return 0;
+}
@@ -1,3 +1,5 @@
+#include "./utils/Benchmark.hpp"
+
 #include <chrono>
 #include <cstdint>
 #include <iostream>
@@ -41,7 +43,8 @@ public:
 const uint64_t ITERATIONS = 1000000000;
 
 
-int main(){
+int main(int argc, char** argv){
+    spi::Benchmark bench("methods_benchmark", argc, argv);
     Derived obj;
 
 
@@ -49,40 +52,36 @@ int main(){
     //                                          RELEASE         |   DEBUG
 
     // doBase():            ~ 408 Mio/s     |   ~ 191 Mio/s
-    auto startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        obj.doBase();
-    }
-    auto endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "doBase(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("doBase()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            obj.doBase();
+        }
+    });
 
 
     // doDerived():         ~ 417 Mio/s     |   ~ 190 Mio/s
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        obj.doDerived();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "doDerived(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("doDerived()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            obj.doDerived();
+        }
+    });
 
 
     // doVirtual():         ~ 416 Mio/s     |   ~ 191 Mio/s
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        obj.doVirtual();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "doVirtual(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("doVirtual()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            obj.doVirtual();
+        }
+    });
 
 
     // doPureVirtual():     ~ 415 Mio/s     |   ~ 191 Mio/s
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        obj.doPureVirtual();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "doPureVirtual(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("doPureVirtual()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            obj.doPureVirtual();
+        }
+    });
 
 
-    return 0;
+    return bench.finish();
 }
\ No newline at end of file
@@ -1,7 +1,9 @@
 #include <chrono>
+#include <ctime>
 #include <cstdint>
 #include <iostream>
 
+#include "utils/Benchmark.hpp"
 #include "utils/Thread.hpp"
 #include "utils/Lock.hpp"
 
@@ -17,11 +19,14 @@ const uint64_t THREADS = 8;
 std::mutex mutex;
 std::shared_mutex sharedMutex;
 Lock spinLock(true);
+Lock adaptiveLock(LockMode::ADAPTIVE);
+Lock pureSpinLock(LockMode::SPIN);
 std::condition_variable conditionVariable;
 std::vector<Thread*> threads;
 
 
-int main(){
+int main(int argc, char** argv){
+    Benchmark bench("mutex_benchmark", argc, argv);
     const uint64_t MULTITHREADED_ITERATIONS = ITERATIONS / THREADS;
 
 
@@ -29,57 +34,62 @@ int main(){
     //                                          RELEASE         |   DEBUG
 
     // single mutex::lock_guard():              ~ 106 Mio/s     |   ~ 41 Mio/s
-    auto startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        std::lock_guard<std::mutex> lock(mutex);
-        (void)i;
-    }
-    auto endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "single mutex::lock_guard(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("single mutex::lock_guard()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            std::lock_guard<std::mutex> lock(mutex);
+            (void)i;
+        }
+    });
 
 
     // single mutex::unique_lock():             ~ 124 Mio/s     |   ~ 33 Mio/s
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        std::unique_lock<std::mutex> lock(mutex);
-        (void)i;
-        lock.unlock();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "single mutex::unique_lock(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("single mutex::unique_lock()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            std::unique_lock<std::mutex> lock(mutex);
+            (void)i;
+            lock.unlock();
+        }
+    });
 
 
     // single shared_mutex::unique_lock():      ~ 34 Mio/s      |   ~ 22 Mio/s
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        std::unique_lock<std::shared_mutex> lock(sharedMutex);
-        (void)i;
-        lock.unlock();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "single shared_mutex::unique_lock(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("single shared_mutex::unique_lock()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            std::unique_lock<std::shared_mutex> lock(sharedMutex);
+            (void)i;
+            lock.unlock();
+        }
+    });
 
 
     // single shared_mutex::shared_lock():      ~ 52 Mio/s      |   ~ 25 Mio/s
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        std::shared_lock<std::shared_mutex> lock(sharedMutex);
-        (void)i;
-        lock.unlock();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "single shared_mutex::shared_lock(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("single shared_mutex::shared_lock()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            std::shared_lock<std::shared_mutex> lock(sharedMutex);
+            (void)i;
+            lock.unlock();
+        }
+    });
 
 
     // single Lock:                         ~ 114 Mio/s     |   ~ 43 Mio/s
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        spinLock.lock();
-        (void)i;
-        spinLock.unlock();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "single Lock: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("single Lock", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            spinLock.lock();
+            (void)i;
+            spinLock.unlock();
+        }
+    });
+
+
+    // single Lock adaptive:                ~ 66 Mio/s      |   -
+    bench.run("single Lock adaptive", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            adaptiveLock.lock();
+            (void)i;
+            adaptiveLock.unlock();
+        }
+    });
     std::cout << std::endl;
 
 
@@ -87,106 +97,186 @@ int main(){
 
 
     // multi mutex::lock_guard():               ~ 12.8 Mio/s    |   ~ 8.4 Mio/s
-    for(uint64_t i=0; i < THREADS; i++)
-        threads.push_back(new Thread([](){
-            for(uint64_t i=0; i < MULTITHREADED_ITERATIONS; i++){
-                std::lock_guard<std::mutex> lock(mutex);
-                (void)i;
-            }
-        }));
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < THREADS; i++)
-        threads[i]->start();
-    for(uint64_t i=0; i < THREADS; i++)
-        threads[i]->join();
-    endTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < THREADS; i++)
-        delete threads[i];
-    threads.clear();
-    std::cout << "multi mutex::lock_guard(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("multi mutex::lock_guard()", ITERATIONS, [&](BenchmarkTimer &timer){
+        for(uint64_t i=0; i < THREADS; i++)
+            threads.push_back(new Thread([](){
+                for(uint64_t i=0; i < MULTITHREADED_ITERATIONS; i++){
+                    std::lock_guard<std::mutex> lock(mutex);
+                    (void)i;
+                }
+            }));
+        for(uint64_t i=0; i < THREADS; i++)
+            bench.pin(*threads[i], i);
+        timer.start();
+        for(uint64_t i=0; i < THREADS; i++)
+            threads[i]->start();
+        for(uint64_t i=0; i < THREADS; i++)
+            threads[i]->join();
+        timer.stop();
+        for(uint64_t i=0; i < THREADS; i++)
+            delete threads[i];
+        threads.clear();
+    });
 
 
     // multi mutex::unique_lock():              ~ 13.3 Mio/s    |   ~ 7.1 Mio/s
-    for(uint64_t i=0; i < THREADS; i++)
-        threads.push_back(new Thread([](){
-            for(uint64_t i=0; i < MULTITHREADED_ITERATIONS; i++){
-                std::unique_lock<std::mutex> lock(mutex);
-                (void)i;
-            }
-        }));
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < THREADS; i++)
-        threads[i]->start();
-    for(uint64_t i=0; i < THREADS; i++)
-        threads[i]->join();
-    endTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < THREADS; i++)
-        delete threads[i];
-    threads.clear();
-    std::cout << "multi mutex::unique_lock(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("multi mutex::unique_lock()", ITERATIONS, [&](BenchmarkTimer &timer){
+        for(uint64_t i=0; i < THREADS; i++)
+            threads.push_back(new Thread([](){
+                for(uint64_t i=0; i < MULTITHREADED_ITERATIONS; i++){
+                    std::unique_lock<std::mutex> lock(mutex);
+                    (void)i;
+                }
+            }));
+        for(uint64_t i=0; i < THREADS; i++)
+            bench.pin(*threads[i], i);
+        timer.start();
+        for(uint64_t i=0; i < THREADS; i++)
+            threads[i]->start();
+        for(uint64_t i=0; i < THREADS; i++)
+            threads[i]->join();
+        timer.stop();
+        for(uint64_t i=0; i < THREADS; i++)
+            delete threads[i];
+        threads.clear();
+    });
 
 
     // multi shared_mutex::unique_lock():       ~ 3.8 Mio/s     |   ~ 2.4 Mio/s
-    for(uint64_t i=0; i < THREADS; i++)
-        threads.push_back(new Thread([](){
-            for(uint64_t i=0; i < MULTITHREADED_ITERATIONS; i++){
-                std::unique_lock<std::shared_mutex> lock(sharedMutex);
-                (void)i;
-                lock.unlock();
-            }
-        }));
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < THREADS; i++)
-        threads[i]->start();
-    for(uint64_t i=0; i < THREADS; i++)
-        threads[i]->join();
-    endTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < THREADS; i++)
-        delete threads[i];
-    threads.clear();
-    std::cout << "multi shared_mutex::unique_lock(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("multi shared_mutex::unique_lock()", ITERATIONS, [&](BenchmarkTimer &timer){
+        for(uint64_t i=0; i < THREADS; i++)
+            threads.push_back(new Thread([](){
+                for(uint64_t i=0; i < MULTITHREADED_ITERATIONS; i++){
+                    std::unique_lock<std::shared_mutex> lock(sharedMutex);
+                    (void)i;
+                    lock.unlock();
+                }
+            }));
+        for(uint64_t i=0; i < THREADS; i++)
+            bench.pin(*threads[i], i);
+        timer.start();
+        for(uint64_t i=0; i < THREADS; i++)
+            threads[i]->start();
+        for(uint64_t i=0; i < THREADS; i++)
+            threads[i]->join();
+        timer.stop();
+        for(uint64_t i=0; i < THREADS; i++)
+            delete threads[i];
+        threads.clear();
+    });
 
 
     // multi shared_mutex::shared_lock():       ~ 6.9 Mio/s     |   ~ 6.3 Mio/s
-    for(uint64_t i=0; i < THREADS; i++)
-        threads.push_back(new Thread([](){
-            for(uint64_t i=0; i < MULTITHREADED_ITERATIONS; i++){
-                std::shared_lock<std::shared_mutex> lock(sharedMutex);
-                (void)i;
-                lock.unlock();
-            }
-        }));
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < THREADS; i++)
-        threads[i]->start();
-    for(uint64_t i=0; i < THREADS; i++)
-        threads[i]->join();
-    endTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < THREADS; i++)
-        delete threads[i];
-    threads.clear();
-    std::cout << "multi shared_mutex::shared_lock(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("multi shared_mutex::shared_lock()", ITERATIONS, [&](BenchmarkTimer &timer){
+        for(uint64_t i=0; i < THREADS; i++)
+            threads.push_back(new Thread([](){
+                for(uint64_t i=0; i < MULTITHREADED_ITERATIONS; i++){
+                    std::shared_lock<std::shared_mutex> lock(sharedMutex);
+                    (void)i;
+                    lock.unlock();
+                }
+            }));
+        for(uint64_t i=0; i < THREADS; i++)
+            bench.pin(*threads[i], i);
+        timer.start();
+        for(uint64_t i=0; i < THREADS; i++)
+            threads[i]->start();
+        for(uint64_t i=0; i < THREADS; i++)
+            threads[i]->join();
+        timer.stop();
+        for(uint64_t i=0; i < THREADS; i++)
+            delete threads[i];
+        threads.clear();
+    });
 
 
     // multi Lock:                          ~ 42.5 Mio/s    |   ~ 13.7 Mio/s
-    for(uint64_t i=0; i < THREADS; i++)
-        threads.push_back(new Thread([](){
-            for(uint64_t i=0; i < MULTITHREADED_ITERATIONS; i++){
-                spinLock.lock();
-                (void)i;
-                spinLock.unlock();
+    bench.run("multi Lock", ITERATIONS, [&](BenchmarkTimer &timer){
+        for(uint64_t i=0; i < THREADS; i++)
+            threads.push_back(new Thread([](){
+                for(uint64_t i=0; i < MULTITHREADED_ITERATIONS; i++){
+                    spinLock.lock();
+                    (void)i;
+                    spinLock.unlock();
+                }
+            }));
+        for(uint64_t i=0; i < THREADS; i++)
+            bench.pin(*threads[i], i);
+        timer.start();
+        for(uint64_t i=0; i < THREADS; i++)
+            threads[i]->start();
+        for(uint64_t i=0; i < THREADS; i++)
+            threads[i]->join();
+        timer.stop();
+        for(uint64_t i=0; i < THREADS; i++)
+            delete threads[i];
+        threads.clear();
+    });
+
+
+    // multi Lock adaptive:                 ~ 63.0 Mio/s    |   -
+    bench.run("multi Lock adaptive", ITERATIONS, [&](BenchmarkTimer &timer){
+        for(uint64_t i=0; i < THREADS; i++)
+            threads.push_back(new Thread([](){
+                for(uint64_t i=0; i < MULTITHREADED_ITERATIONS; i++){
+                    adaptiveLock.lock();
+                    (void)i;
+                    adaptiveLock.unlock();
+                }
+            }));
+        for(uint64_t i=0; i < THREADS; i++)
+            bench.pin(*threads[i], i);
+        timer.start();
+        for(uint64_t i=0; i < THREADS; i++)
+            threads[i]->start();
+        for(uint64_t i=0; i < THREADS; i++)
+            threads[i]->join();
+        timer.stop();
+        for(uint64_t i=0; i < THREADS; i++)
+            delete threads[i];
+        threads.clear();
+    });
+    std::cout << std::endl;
+
+
+
+
+
+    // long hold (lock holder sleeps for 100us): throughput and cpu time burned by waiting threads per lock operation
+    //                                      RELEASE
+    // long hold mutex::lock_guard():       ~ 6.4 Kilo/s    ~ 7.4 us cpu/op
+    // long hold Lock spin:                 ~ 6.4 Kilo/s    ~ 135.6 us cpu/op
+    // long hold Lock adaptive:             ~ 6.5 Kilo/s    ~ 8.3 us cpu/op
+    const uint64_t LONG_HOLD_ITERATIONS = 2000;
+    const auto longHold = [&](const std::string &name, auto &&lockFn, auto &&unlockFn){
+        bench.run("long hold " + name, LONG_HOLD_ITERATIONS, [&](BenchmarkTimer &timer){
+            for(uint64_t i=0; i < THREADS; i++){
+                threads.push_back(new Thread([&lockFn, &unlockFn, LONG_HOLD_ITERATIONS](){
+                    for(uint64_t i=0; i < LONG_HOLD_ITERATIONS / THREADS; i++){
+                        lockFn();
+                        std::this_thread::sleep_for(std::chrono::microseconds(100));
+                        unlockFn();
+                    }
+                }));
+                bench.pin(*threads[i], i);
             }
-        }));
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < THREADS; i++)
-        threads[i]->start();
-    for(uint64_t i=0; i < THREADS; i++)
-        threads[i]->join();
-    endTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < THREADS; i++)
-        delete threads[i];
-    threads.clear();
-    std::cout << "multi Lock: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+            const std::clock_t cpuStart = std::clock();
+            timer.start();
+            for(uint64_t i=0; i < THREADS; i++)
+                threads[i]->start();
+            for(uint64_t i=0; i < THREADS; i++)
+                threads[i]->join();
+            timer.stop();
+            const std::clock_t cpuEnd = std::clock();
+            for(uint64_t i=0; i < THREADS; i++)
+                delete threads[i];
+            threads.clear();
+            timer.metric("cpu_us_per_op", ((double)(cpuEnd - cpuStart) * 1000000 / CLOCKS_PER_SEC) / LONG_HOLD_ITERATIONS);
+        });
+    };
+    longHold("mutex::lock_guard()", []{ mutex.lock(); }, []{ mutex.unlock(); });
+    longHold("Lock spin", []{ pureSpinLock.lock(); }, []{ pureSpinLock.unlock(); });
+    longHold("Lock adaptive", []{ adaptiveLock.lock(); }, []{ adaptiveLock.unlock(); });
     std::cout << std::endl;
 
 
@@ -194,20 +284,18 @@ int main(){
 
 
     // condition_variable::notify_one():        ~ 186 Mio/s     |   ~ 149 Mio/s
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        conditionVariable.notify_one();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "condition_variable::notify_one(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("condition_variable::notify_one()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            conditionVariable.notify_one();
+        }
+    });
 
     // condition_variable::notify_all():        ~ 285 Mio/s     |   ~ 192 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        conditionVariable.notify_all();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "condition_variable::notify_all(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
-
-    return 0;
+    bench.run("condition_variable::notify_all()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            conditionVariable.notify_all();
+        }
+    });
+
+    return bench.finish();
 }
\ No newline at end of file
@@ -1,303 +1,256 @@
-#include "./utils/QueueAtomic.hpp"
-#include "./utils/QueueLock.hpp"
-#include "./utils/QueueMoodyCamel.hpp"
-#include "./utils/QueueRing.hpp"
-#include "./utils/QueueTwoPartyAtomic.hpp"
-#include "./utils/QueueTwoPartyHighContention.hpp"
-#include "./utils/QueueTwoPartyNoCritical.hpp"
-
+#include "./utils/Benchmark.hpp"
+#include "./utils/QueueAdapter.hpp"
 #include "./utils/Thread.hpp"
+#include "./utils/TimeUtils.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <string>
+#include <vector>
 
 using namespace spi;
 
-int main(){
-    const uint64_t ITERATIONS = 50000000; // before 50000000
-    const size_t THREADS = 2;
 
-    QueueAtomic<uint64_t> queueAtomic;
-    QueueLock<uint64_t> queueLock(false);
-    QueueLockCustom<uint64_t> queueLockCustom(false);
-    moodycamel::ConcurrentQueue<uint64_t> queueMoodyCamel;
-    QueueRing<uint64_t> queueRing(20);
-    QueueTwoPartyAtomic<uint64_t> queueTwoPartyAtomic;
-    QueueTwoPartyHighContention<uint64_t> queueTwoPartyHC;
-    QueueTwoPartyNoCritical<uint64_t> queueTwoPartyNoCritical;
+// Sweep of the benchmark matrix
+const uint64_t SEQUENTIAL_ITERATIONS = 50000000;
+const uint64_t MATRIX_ITERATIONS = 2000000;
+const size_t THREAD_COUNTS[] = {1, 2, 4, 8};   // used for producers and consumers
+const size_t BATCH_SIZES[] = {1, 16, 64};
+const uint64_t LATENCY_SAMPLE_RATE = 64;        // every n-th element carries a timestamp
+
+
+/**
+ * Element of a given size that is pushed through the queues.
+ * First value holds the push timestamp (in ns) of sampled elements, otherwise 0.
+ */
+template<size_t Size>
+struct Payload {
+    static_assert(Size >= sizeof(uint64_t) && Size % sizeof(uint64_t) == 0, "Size must be a multiple of 8 bytes");
+    uint64_t values[Size / sizeof(uint64_t)] = {};
+};
+
+inline uint64_t nowNs(){
+    return FastClock::nowNanos();
+}
+
+
+/**
+ * Single thread pushes and pops each element right away.
+ */
+template<Queue<uint64_t> Q>
+void runSequential(Benchmark &bench, const std::string &name, Q& queue, uint64_t iterations){
+    bench.run(name, iterations, [&](){
+        uint64_t result = 0;
+        for(uint64_t i=0; i < iterations; i++){
+            queue.push(i);
+            while(!queue.pop(result));
+        }
+        Benchmark::doNotOptimize(result);
+    });
+}
+
+
+/**
+ * Single thread pushes a batch of elements and pops it again, either element by element
+ * or with one pushBulk() and popBulk() call per batch.
+ */
+template<Queue<uint64_t> Q>
+void runSequentialBatch(Benchmark &bench, const std::string &name, Q& queue, size_t batch, bool bulk, uint64_t iterations){
+    const uint64_t rounds = iterations / batch;
+    bench.run(name, rounds * batch, [&](){
+        std::vector<uint64_t> values(batch), results(batch);
+        uint64_t sum = 0;
+        for(uint64_t r=0; r < rounds; r++){
+            for(size_t i=0; i < batch; i++) values[i] = r + i;
+            if(bulk){
+                queue.pushBulk(values.data(), batch);
+                for(size_t popped = 0; popped < batch;) popped += queue.popBulk(results.data() + popped, batch - popped);
+            } else {
+                for(size_t i=0; i < batch; i++) queue.push(values[i]);
+                for(size_t i=0; i < batch; i++) while(!queue.pop(results[i]));
+            }
+            sum += results[batch - 1];
+        }
+        Benchmark::doNotOptimize(sum);
+    });
+}
+
+
+/**
+ * Lets the given amount of producer and consumer threads push and pop a total of
+ * given iterations through the queue in batches. Reports throughput and enqueue-to-dequeue latency percentiles.
+ */
+template<typename T, Queue<T> Q>
+void runParallel(Benchmark &bench, const std::string &name, Q& queue, size_t producers, size_t consumers, size_t batch, uint64_t iterations){
+    const uint64_t perProducer = iterations / producers;
+    const uint64_t total = perProducer * producers;
+
+    bench.run(name, total, [&](BenchmarkTimer &timer){
+        ConcurrentLatencyHistogram latencies;
+        std::vector<Thread*> threads;
+
+        for(size_t p=0; p < producers; p++){
+            threads.push_back(new Thread([&queue, perProducer, batch](){
+                std::vector<T> values(batch);
+                uint64_t pushed = 0;
+                while(pushed < perProducer){
+                    const size_t count = (size_t)std::min((uint64_t)batch, perProducer - pushed);
+                    for(size_t i=0; i < count; i++)
+                        values[i].values[0] = ((pushed + i) % LATENCY_SAMPLE_RATE == 0) ? nowNs() : 0;
+                    size_t done = 0;
+                    while(done < count){
+                        size_t n = queue.pushBulk(values.data() + done, count - done);
+                        if(n == 0) std::this_thread::yield();
+                        done += n;
+                    }
+                    pushed += count;
+                }
+            }));
+            bench.pin(*threads.back(), threads.size() - 1);
+        }
+        for(size_t c=0; c < consumers; c++){
+            const uint64_t count = total / consumers + (c == 0 ? total % consumers : 0);
+            ConcurrentLatencyHistogram::Recorder &recorder = latencies.recorder();
+            threads.push_back(new Thread([&queue, &recorder, count, batch](){
+                std::vector<T> results(batch);
+                uint64_t popped = 0;
+                while(popped < count){
+                    size_t n = queue.popBulk(results.data(), (size_t)std::min((uint64_t)batch, count - popped));
+                    if(n == 0){
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    for(size_t i=0; i < n; i++){
+                        if(results[i].values[0] != 0) recorder.record(nowNs() - results[i].values[0]);
+                    }
+                    popped += n;
+                }
+            }));
+            bench.pin(*threads.back(), threads.size() - 1);
+        }
+
+        timer.start();
+        for(Thread* thr : threads) thr->start();
+        for(Thread* thr : threads) thr->join();
+        timer.stop();
+        for(Thread* thr : threads) delete thr;
+
+        timer.latency("latency", latencies.snapshot());
+    });
+}
+
+
+/**
+ * Benchmarks one queue for all producer/consumer counts
+ * and batch sizes the queue supports with elements of the given size.
+ */
+template<template<typename> class QueueType, size_t Size, typename... Args>
+void benchmarkElementSize(Benchmark &bench, const std::string &name, Args... args){
+    typedef Payload<Size> T;
+    typedef QueueAdapter<QueueType<T>> Adapter;
+
+    for(size_t producers : THREAD_COUNTS){
+        if(producers > 1 && !Adapter::multiProducer) continue;
+        for(size_t consumers : THREAD_COUNTS){
+            if(consumers > 1 && !Adapter::multiConsumer) continue;
+            for(size_t batch : BATCH_SIZES){
+                const std::string label = name + " " + std::to_string(Size) + "B " + std::to_string(producers) + "/" +
+                                            std::to_string(consumers) + " batch " + std::to_string(batch);
+                QueueType<T> queue(args...);
+                Adapter adapter(queue);
+                runParallel<T>(bench, label, adapter, producers, consumers, batch, MATRIX_ITERATIONS);
+            }
+        }
+    }
+    std::cout << std::endl;
+}
+
+/**
+ * Runs the full matrix (element sizes 8 to 256 bytes) for one queue.
+ * Constructor arguments are passed to every queue instance.
+ */
+template<template<typename> class QueueType, typename... Args>
+void benchmarkQueue(Benchmark &bench, const std::string &name, Args... args){
+    if(!QueueAdapter<QueueType<Payload<8>>>::concurrent){
+        std::cout << name << ":   not thread-safe" << std::endl << std::endl;
+        return;
+    }
+    benchmarkElementSize<QueueType, 8>(bench, name, args...);
+    benchmarkElementSize<QueueType, 32>(bench, name, args...);
+    benchmarkElementSize<QueueType, 64>(bench, name, args...);
+    benchmarkElementSize<QueueType, 256>(bench, name, args...);
+}
+
+template<template<typename> class QueueType, typename... Args>
+void benchmarkSequential(Benchmark &bench, const std::string &name, Args... args){
+    QueueType<uint64_t> queue(args...);
+    QueueAdapter<QueueType<uint64_t>> adapter(queue);
+    runSequential(bench, "Sequential " + name + " push & pop", adapter, SEQUENTIAL_ITERATIONS);
+}
+
+template<template<typename> class QueueType, typename... Args>
+void benchmarkBatching(Benchmark &bench, const std::string &name, Args... args){
+    QueueType<uint64_t> queue(args...);
+    QueueAdapter<QueueType<uint64_t>> adapter(queue);
+    for(size_t batch : BATCH_SIZES){
+        const std::string prefix = "Sequential " + name + " batch " + std::to_string(batch);
+        runSequentialBatch(bench, prefix + " push & pop", adapter, batch, false, SEQUENTIAL_ITERATIONS);
+        runSequentialBatch(bench, prefix + " push_bulk & pop_bulk", adapter, batch, true, SEQUENTIAL_ITERATIONS);
+    }
+}
 
-    uint64_t result;
-    std::vector<Thread*> threads;
 
-    //                                                      RELEASE         |   DEBUG
+template<typename T> using QueueLockDefault = QueueLock<T>;
+template<typename T> using QueueLockCustomDefault = QueueLockCustom<T>;
+template<typename T> using QueueMoodyCamel = moodycamel::ConcurrentQueue<T>;
 
-    // Sequential QueueAtomic push & pop:                   ~ 32.9 Mio/sec  |   ~ 12.7 Mio/sec
-    auto startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        queueAtomic.push(i);
-        while(!queueAtomic.pop(result));
-    }
-    auto endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "Sequential QueueAtomic push & pop: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
 
+int main(int argc, char** argv){
+    Benchmark bench("queue_benchmark", argc, argv);
+    FastClock::calibrate();
 
+    //                                                      RELEASE         |   DEBUG
+    // Sequential QueueAtomic push & pop:                   ~ 32.9 Mio/sec  |   ~ 12.7 Mio/sec
     // Sequential QueueLock push & pop:                     ~ 70.1 Mio/sec  |   ~ 10.3 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        queueLock.push(i);
-        while(!queueLock.pop(result));
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "Sequential QueueLock push & pop: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
-
-
     // Sequential QueueLockCustom push & pop:               ~ 35.4 Mio/sec  |   ~ 14.6 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        queueLockCustom.push(i);
-        while(!queueLockCustom.pop(result));
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "Sequential QueueLockCustom push & pop: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
-
-
     // Sequential QueueMoodyCamel push & pop:               ~ 27.6 Mio/sec  |   ~ 6.3 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        queueMoodyCamel.enqueue(i);
-        while(!queueMoodyCamel.try_dequeue(result));
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "Sequential QueueMoodyCamel push & pop: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
-
-
     // Sequential QueueRing push & pop:                     ~ 31.7 Mio/sec  |   ~ 10.6 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        queueRing.push(i);
-        while(!queueRing.pop(result));
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "Sequential QueueRing push & pop: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
-
-
     // Sequential QueueTwoPartyAtomic push & pop:           ~ 36.1 Mio/sec  |   ~ 28.7 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        queueTwoPartyAtomic.push(i);
-        while(!queueTwoPartyAtomic.pop(result));
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "Sequential QueueTwoPartyAtomic push & pop: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
-
-
     // Sequential QueueTwoPartyHighContention push & pop:   ~ 18.4 Mio/sec
-    /*startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        queueTwoPartyHC.push(i);
-        while(!queueTwoPartyHC.pop(result));
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "Sequential QueueTwoPartyHighContention push & pop: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
-    */
-    
-
-    // Sequential QueueTwoPartyNoCritical push & pop:       ~ 287.9 Mio/sec  |   ~ 84.7 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        queueTwoPartyNoCritical.push(i);
-        while(!queueTwoPartyNoCritical.pop(result));
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "Sequential QueueTwoPartyNoCritical push & pop: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    // Sequential QueueTwoPartyNoCritical push & pop:       ~ 287.9 Mio/sec |   ~ 84.7 Mio/sec
+    // Sequential QueueTwoPartyRing push & pop:             ~ 338.8 Mio/sec
+    benchmarkSequential<QueueAtomic>(bench, "QueueAtomic");
+    benchmarkSequential<QueueLockDefault>(bench, "QueueLock", false);
+    benchmarkSequential<QueueLockCustomDefault>(bench, "QueueLockCustom", false);
+    benchmarkSequential<QueueMoodyCamel>(bench, "QueueMoodyCamel");
+    benchmarkSequential<QueueRing>(bench, "QueueRing", (size_t)1024);
+    benchmarkSequential<QueueTwoPartyAtomic>(bench, "QueueTwoPartyAtomic");
+    benchmarkSequential<QueueTwoPartyHighContention>(bench, "QueueTwoPartyHighContention");
+    benchmarkSequential<QueueTwoPartyNoCritical>(bench, "QueueTwoPartyNoCritical");
+    benchmarkSequential<QueueTwoPartyRing>(bench, "QueueTwoPartyRing", (size_t)4096);
     std::cout << std::endl;
-    
-
-
-
-
-
 
 
-
-    // Parallel QueueAtomic push & pop:                     ~ ???? Mio/sec
-    /*
-    for(size_t i=0; i < THREADS; i++){
-        threads.push_back(new Thread([&ITERATIONS, &queueAtomic](){
-            uint64_t result;
-            for(uint64_t i=0; i < ITERATIONS/THREADS; i++){
-                queueAtomic.push(i);
-                while(!queueAtomic.pop(result));
-            }
-        }));
-    }
-    startTime = std::chrono::high_resolution_clock::now();
-    for(size_t i=0; i < THREADS; i++) threads[i]->start();
-    for(size_t i=0; i < THREADS; i++) threads[i]->join();
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "Parallel QueueAtomic push & pop: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
-    for(size_t i=0; i < THREADS; i++) delete threads[i];
-    threads.clear();*/
-    std::cout << "Parallel QueueAtomic push & pop:   not thread-safe" << std::endl;
-
-
-    // Parallel QueueLock push & pop:                       ~ 49.1 Mio/sec  |   ~ 8.9 Mio/sec
-    for(size_t i=0; i < THREADS; i++){
-        threads.push_back(new Thread([&ITERATIONS, &queueLock](){
-            uint64_t result;
-            for(uint64_t i=0; i < ITERATIONS/THREADS; i++){
-                queueLock.push(i);
-                while(!queueLock.pop(result));
-            }
-        }));
-    }
-    startTime = std::chrono::high_resolution_clock::now();
-    for(size_t i=0; i < THREADS; i++) threads[i]->start();
-    for(size_t i=0; i < THREADS; i++) threads[i]->join();
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "Parallel QueueLock push & pop: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
-    for(size_t i=0; i < THREADS; i++) delete threads[i];
-    threads.clear();
-
-
-    // Parallel QueueLockCustom push & pop:                 ~ 30.2 Mio/sec  |   ~ 9.0 Mio/sec
-    for(size_t i=0; i < THREADS; i++){
-        threads.push_back(new Thread([&ITERATIONS, &queueLockCustom](){
-            uint64_t result;
-            for(uint64_t i=0; i < ITERATIONS/THREADS; i++){
-                queueLockCustom.push(i);
-                while(!queueLockCustom.pop(result));
-            }
-        }));
-    }
-    startTime = std::chrono::high_resolution_clock::now();
-    for(size_t i=0; i < THREADS; i++) threads[i]->start();
-    for(size_t i=0; i < THREADS; i++) threads[i]->join();
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "Parallel QueueLockCustom push & pop: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
-    for(size_t i=0; i < THREADS; i++) delete threads[i];
-    threads.clear();
-
-
-    // Parallel QueueMoodyCamel push & pop:                 ~ 9.1 Mio/sec  |   ~ 5.0 Mio/sec
-    for(size_t i=0; i < THREADS; i++){
-        threads.push_back(new Thread([&ITERATIONS, &queueMoodyCamel](){
-            uint64_t result;
-            for(uint64_t i=0; i < ITERATIONS/THREADS; i++){
-                queueMoodyCamel.enqueue(i);
-                while(!queueMoodyCamel.try_dequeue(result));
-            }
-        }));
-    }
-    startTime = std::chrono::high_resolution_clock::now();
-    for(size_t i=0; i < THREADS; i++) threads[i]->start();
-    for(size_t i=0; i < THREADS; i++) threads[i]->join();
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "Parallel QueueMoodyCamel push & pop: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
-    for(size_t i=0; i < THREADS; i++) delete threads[i];
-    threads.clear();
-
-
-    // Parallel QueueRing push & pop:                       ~ 3.6 Mio/sec  |   ~ 2.8 Mio/sec
-    for(size_t i=0; i < THREADS; i++){
-        threads.push_back(new Thread([&ITERATIONS, &queueRing](){
-            uint64_t result;
-            for(uint64_t i=0; i < ITERATIONS/THREADS; i++){
-                queueRing.push(i);
-                while(!queueRing.pop(result));
-            }
-        }));
-    }
-    startTime = std::chrono::high_resolution_clock::now();
-    for(size_t i=0; i < THREADS; i++) threads[i]->start();
-    for(size_t i=0; i < THREADS; i++) threads[i]->join();
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "Parallel QueueRing push & pop: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
-    for(size_t i=0; i < THREADS; i++) delete threads[i];
-    threads.clear();
-
-
-    // Parallel QueueTwoPartyAtomic push & pop:             ~ 7.6 Mio/sec  |   ~ 9.1 Mio/sec
-    if(THREADS == 2){
-        threads.push_back(new Thread([&ITERATIONS, &queueTwoPartyAtomic](){
-            for(uint64_t i=0; i < ITERATIONS/THREADS; i++){
-                queueTwoPartyAtomic.push(i);
-            }
-        }));
-        threads.push_back(new Thread([&ITERATIONS, &queueTwoPartyAtomic](){
-            uint64_t result;
-            for(uint64_t i=0; i < ITERATIONS/THREADS; i++){
-                while(!queueTwoPartyAtomic.pop(result));
-            }
-        }));
-        startTime = std::chrono::high_resolution_clock::now();
-        for(size_t i=0; i < THREADS; i++) threads[i]->start();
-        for(size_t i=0; i < THREADS; i++) threads[i]->join();
-        endTime = std::chrono::high_resolution_clock::now();
-        std::cout << "Parallel QueueTwoPartyAtomic push & pop: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
-        for(size_t i=0; i < THREADS; i++) delete threads[i];
-        threads.clear();
-    } else {
-        std::cout << "Parallel QueueTwoPartyAtomic push & pop:   not thread-safe for more than two threads" << std::endl;
-    }
+    // Per element against one lock/CAS per batch
+    benchmarkBatching<QueueAtomic>(bench, "QueueAtomic");
+    benchmarkBatching<QueueLockDefault>(bench, "QueueLock", false);
+    benchmarkBatching<QueueLockCustomDefault>(bench, "QueueLockCustom", false);
+    std::cout << std::endl;
 
 
-    // Parallel QueueTwoPartyHighContention push & pop:     ~
-    /*if(THREADS == 2){
-        threads.push_back(new Thread([&ITERATIONS, &queueTwoPartyHC](){
-            for(uint64_t i=0; i < ITERATIONS/THREADS; i++){
-                queueTwoPartyHC.push(i);
-            }
-        }));
-        threads.push_back(new Thread([&ITERATIONS, &queueTwoPartyHC](){
-            uint64_t result;
-            for(uint64_t i=0; i < ITERATIONS/THREADS; i++){
-                while(!queueTwoPartyHC.pop(result));
-            }
-        }));
-        startTime = std::chrono::high_resolution_clock::now();
-        for(size_t i=0; i < THREADS; i++) threads[i]->start();
-        for(size_t i=0; i < THREADS; i++) threads[i]->join();
-        endTime = std::chrono::high_resolution_clock::now();
-        std::cout << "Parallel QueueTwoPartyHighContention push & pop: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
-        for(size_t i=0; i < THREADS; i++) delete threads[i];
-        threads.clear();
-    } else {
-        std::cout << "Parallel QueueTwoPartyHighContention push & pop:   not thread-safe for more than two threads" << std::endl;
-    }*/
-
-
-    // Parallel QueueTwoPartyNoCritical push & pop:         ~ 75.6 Mio/sec  |   ~ 37.2 Mio/sec  
-    if(THREADS == 2){
-        threads.push_back(new Thread([&ITERATIONS, &queueTwoPartyNoCritical](){
-            uint64_t i=0;
-            for(i=0; i < ITERATIONS/THREADS; i++){
-                queueTwoPartyNoCritical.push(i);
-            }
-        }));
-        threads.push_back(new Thread([&ITERATIONS, &queueTwoPartyNoCritical](){
-            uint64_t result; uint64_t retries;
-            for(uint64_t i=0; i < ITERATIONS/THREADS; i++){
-                retries = 1000000000;
-                while(!queueTwoPartyNoCritical.pop(result)){
-                    if(retries-- == 0){
-                        std::cout << "Pop failed at: " << i << " empty=" << queueTwoPartyNoCritical.empty() << " queue=" << queueTwoPartyNoCritical.toString() << std::endl;
-                        break;
-                    }
-                }
-            }
-        }));
-        startTime = std::chrono::high_resolution_clock::now();
-        for(size_t i=0; i < THREADS; i++) threads[i]->start();
-        for(size_t i=0; i < THREADS; i++) threads[i]->join();
-        endTime = std::chrono::high_resolution_clock::now();
-        std::cout << "Parallel QueueTwoPartyNoCritical push & pop: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
-        for(size_t i=0; i < THREADS; i++) delete threads[i];
-        threads.clear();
-    } else {
-        std::cout << "Parallel QueueTwoPartyNoCritical push & pop:   not thread-safe for more than two threads" << std::endl;
-    }
-    std::cout << std::endl;
+    // Throughput and latency matrix: producers/consumers x batch size per element size
+    benchmarkQueue<QueueAtomic>(bench, "QueueAtomic");
+    benchmarkQueue<QueueLockDefault>(bench, "QueueLock", false);
+    benchmarkQueue<QueueLockCustomDefault>(bench, "QueueLockCustom", false);
+    benchmarkQueue<QueueMoodyCamel>(bench, "QueueMoodyCamel");
+    benchmarkQueue<QueueRing>(bench, "QueueRing", (size_t)1024);
+    benchmarkQueue<QueueTwoPartyAtomic>(bench, "QueueTwoPartyAtomic");
+    benchmarkQueue<QueueTwoPartyHighContention>(bench, "QueueTwoPartyHighContention");
+    benchmarkQueue<QueueTwoPartyNoCritical>(bench, "QueueTwoPartyNoCritical");
+    benchmarkQueue<QueueTwoPartyRing>(bench, "QueueTwoPartyRing", (size_t)4096);
 
-    return 0;
-}
\ No newline at end of file
+    return bench.finish();
+}
@@ -1,9 +1,16 @@
+#include "./utils/Benchmark.hpp"
 #include "./utils/RecycleObjectStoreBitmap.hpp"
+#include "./utils/RecycleObjectStoreBitmapAtomic.hpp"
+#include "./utils/RecycleObjectStoreMagazine.hpp"
 #include "./utils/RecycleObjectStoreQueue.hpp"
 #include "./utils/RecycleObjectStoreVector.hpp"
+#include "./utils/Thread.hpp"
 
 #include <chrono>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
 
 using namespace spi;
 
@@ -13,13 +20,33 @@ struct TestStruct {
     int c = 1;
 };
 
-int main(){
+/** Runs fn(opsPerThread) on the given amount of threads, only the time between starting and joining the threads is measured. */
+template<typename Fn>
+void runThreads(Benchmark &bench, const std::string &name, size_t threadCount, uint64_t ops, Fn fn){
+    bench.run(name, ops, [&](BenchmarkTimer &timer){
+        std::vector<Thread*> threads;
+        for(size_t t=0; t < threadCount; t++){
+            threads.push_back(new Thread([&fn, ops, threadCount](){ fn(ops / threadCount); }));
+            bench.pin(*threads.back(), t);
+        }
+        timer.start();
+        for(Thread* thr : threads) thr->start();
+        for(Thread* thr : threads) thr->join();
+        timer.stop();
+        for(Thread* thr : threads) delete thr;
+    });
+}
+
+int main(int argc, char** argv){
+    Benchmark bench("recycle_object_store_benchmark", argc, argv);
     const uint64_t ITERATIONS = 5000000;
     const uint64_t OPS_PER_ITERATION = 9000;
+    const uint64_t LARGE_OPS_PER_ITERATION = 1000000;
     
     RecycleObjectStoreBitmap<TestStruct> storeBitmap;
     RecycleObjectStoreQueue<TestStruct> storeQueue;
     RecycleObjectStoreVector<TestStruct> storeVector;
+    RecycleObjectStoreBitmapAtomic<TestStruct> storeBitmapAtomic(LARGE_OPS_PER_ITERATION);
 
 
     // CONCLUSION:  CHOSE RecycleObjectStoreQueue FOR BEST PERFORMANCE
@@ -28,39 +55,47 @@ int main(){
 
     //                                  RELEASE         vs. DEBUG
 
-    // RecycleObjectStoreBitmap(1):     ~ 73.9 Mio/sec  |   ~ 24.7 Mio/sec
-    auto startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        size_t index;
-        TestStruct *obj = storeBitmap.acquire(index);
-        obj->a = obj->b + obj->c;
-        storeBitmap.release(index);
-    }
-    auto endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "RecycleObjectStoreBitmap(1): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    // RecycleObjectStoreBitmap(1):     ~ 171.6 Mio/sec |   ~ 24.7 Mio/sec (old linear scan: ~ 73.9 Mio/sec)
+    bench.run("RecycleObjectStoreBitmap(1)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            size_t index;
+            TestStruct *obj = storeBitmap.acquire(index);
+            obj->a = obj->b + obj->c;
+            storeBitmap.release(index);
+        }
+    });
 
 
     // RecycleObjectStoreQueue(1):      ~ 326.1 Mio/sec |   ~ 16.0 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        TestStruct *obj = storeQueue.acquire();
-        obj->a = obj->b + obj->c;
-        storeQueue.release(obj);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "RecycleObjectStoreQueue(1): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("RecycleObjectStoreQueue(1)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            TestStruct *obj = storeQueue.acquire();
+            obj->a = obj->b + obj->c;
+            storeQueue.release(obj);
+        }
+    });
 
 
     // RecycleObjectStoreVector(1):     ~ 279.5 Mio/sec |   ~ 5.4 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        size_t index;
-        TestStruct *obj = storeVector.acquire(index);
-        obj->a = obj->b + obj->c;
-        storeVector.release(index);
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "RecycleObjectStoreVector(1): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("RecycleObjectStoreVector(1)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            size_t index;
+            TestStruct *obj = storeVector.acquire(index);
+            obj->a = obj->b + obj->c;
+            storeVector.release(index);
+        }
+    });
+
+
+    // RecycleObjectStoreBitmapAtomic(1): ~ 36.6 Mio/sec
+    bench.run("RecycleObjectStoreBitmapAtomic(1)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            size_t index;
+            TestStruct *obj = storeBitmapAtomic.acquire(index);
+            obj->a = obj->b + obj->c;
+            storeBitmapAtomic.release(index);
+        }
+    });
     std::cout << std::endl;
 
 
@@ -69,53 +104,212 @@ int main(){
     std::vector<size_t> indices(OPS_PER_ITERATION);
     std::vector<TestStruct*> objects(OPS_PER_ITERATION);
 
-    // RecycleObjectStoreBitmap(∞):     ~ 19.7 Mio/sec  |   ~ 5.9 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS/OPS_PER_ITERATION; i++){
-        TestStruct *obj;
-        for(size_t j=0; j < OPS_PER_ITERATION; j++){
-            obj = storeBitmap.acquire(indices[j]);
-            obj->a = obj->b + obj->c;
+    // RecycleObjectStoreBitmap(∞):     ~ 173.4 Mio/sec |   ~ 5.9 Mio/sec (old linear scan: ~ 19.7 Mio/sec)
+    bench.run("RecycleObjectStoreBitmap(" + std::to_string(OPS_PER_ITERATION) + ")", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS/OPS_PER_ITERATION; i++){
+            TestStruct *obj;
+            for(size_t j=0; j < OPS_PER_ITERATION; j++){
+                obj = storeBitmap.acquire(indices[j]);
+                obj->a = obj->b + obj->c;
+            }
+            for(size_t j=0; j < OPS_PER_ITERATION; j++){
+                storeBitmap.release(indices[j]);
+            }
         }
-        for(size_t j=0; j < OPS_PER_ITERATION; j++){
-            storeBitmap.release(indices[j]);
-        }
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "RecycleObjectStoreBitmap(" << OPS_PER_ITERATION << "): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    });
 
 
     // RecycleObjectStoreQueue(∞):      ~ 225.2 Mio/sec |   ~ 13.6 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS/OPS_PER_ITERATION; i++){
-        for(size_t j=0; j < OPS_PER_ITERATION; j++){
-            objects[j] = storeQueue.acquire();
-            objects[j]->a = objects[j]->b + objects[j]->c;
+    bench.run("RecycleObjectStoreQueue(" + std::to_string(OPS_PER_ITERATION) + ")", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS/OPS_PER_ITERATION; i++){
+            for(size_t j=0; j < OPS_PER_ITERATION; j++){
+                objects[j] = storeQueue.acquire();
+                objects[j]->a = objects[j]->b + objects[j]->c;
+            }
+            for(size_t j=0; j < OPS_PER_ITERATION; j++){
+                storeQueue.release(objects[j]);
+            }
         }
-        for(size_t j=0; j < OPS_PER_ITERATION; j++){
-            storeQueue.release(objects[j]);
-        }
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "RecycleObjectStoreQueue(" << OPS_PER_ITERATION << "): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    });
 
 
     // RecycleObjectStoreVector(∞):     ~ 0.1 Mio/sec   |   unuseable
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS/OPS_PER_ITERATION; i++){
-        TestStruct *obj;
-        for(size_t j=0; j < OPS_PER_ITERATION; j++){
-            obj = storeVector.acquire(indices[j]);
-            obj->a = obj->b + obj->c;
+    bench.run("RecycleObjectStoreVector(" + std::to_string(OPS_PER_ITERATION) + ")", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS/OPS_PER_ITERATION; i++){
+            TestStruct *obj;
+            for(size_t j=0; j < OPS_PER_ITERATION; j++){
+                obj = storeVector.acquire(indices[j]);
+                obj->a = obj->b + obj->c;
+            }
+            for(size_t j=0; j < OPS_PER_ITERATION; j++){
+                storeVector.release(indices[j]);
+            }
         }
-        for(size_t j=0; j < OPS_PER_ITERATION; j++){
-            storeVector.release(indices[j]);
+    });
+
+
+    // RecycleObjectStoreBitmapAtomic(∞): ~ 35.1 Mio/sec
+    bench.run("RecycleObjectStoreBitmapAtomic(" + std::to_string(OPS_PER_ITERATION) + ")", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS/OPS_PER_ITERATION; i++){
+            TestStruct *obj;
+            for(size_t j=0; j < OPS_PER_ITERATION; j++){
+                obj = storeBitmapAtomic.acquire(indices[j]);
+                obj->a = obj->b + obj->c;
+            }
+            for(size_t j=0; j < OPS_PER_ITERATION; j++){
+                storeBitmapAtomic.release(indices[j]);
+            }
         }
+    });
+    std::cout << std::endl;
+
+
+
+
+    // stores holding 1M objects (RecycleObjectStoreVector unuseable)
+    indices.resize(LARGE_OPS_PER_ITERATION);
+    objects.resize(LARGE_OPS_PER_ITERATION);
+
+    // RecycleObjectStoreBitmap(1M):    ~ 106.2 Mio/sec (per object new: ~ 62.9 Mio/sec)
+    bench.run("RecycleObjectStoreBitmap(" + std::to_string(LARGE_OPS_PER_ITERATION) + ")", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS/LARGE_OPS_PER_ITERATION; i++){
+            TestStruct *obj;
+            for(size_t j=0; j < LARGE_OPS_PER_ITERATION; j++){
+                obj = storeBitmap.acquire(indices[j]);
+                obj->a = obj->b + obj->c;
+            }
+            for(size_t j=0; j < LARGE_OPS_PER_ITERATION; j++){
+                storeBitmap.release(indices[j]);
+            }
+        }
+    });
+
+
+    // RecycleObjectStoreQueue(1M):     ~ 106.2 Mio/sec (per object new: ~ 72.6 Mio/sec)
+    bench.run("RecycleObjectStoreQueue(" + std::to_string(LARGE_OPS_PER_ITERATION) + ")", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS/LARGE_OPS_PER_ITERATION; i++){
+            for(size_t j=0; j < LARGE_OPS_PER_ITERATION; j++){
+                objects[j] = storeQueue.acquire();
+                objects[j]->a = objects[j]->b + objects[j]->c;
+            }
+            for(size_t j=0; j < LARGE_OPS_PER_ITERATION; j++){
+                storeQueue.release(objects[j]);
+            }
+        }
+    });
+
+
+    // RecycleObjectStoreBitmapAtomic(1M): ~ 31.1 Mio/sec
+    bench.run("RecycleObjectStoreBitmapAtomic(" + std::to_string(LARGE_OPS_PER_ITERATION) + ")", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS/LARGE_OPS_PER_ITERATION; i++){
+            TestStruct *obj;
+            for(size_t j=0; j < LARGE_OPS_PER_ITERATION; j++){
+                obj = storeBitmapAtomic.acquire(indices[j]);
+                obj->a = obj->b + obj->c;
+            }
+            for(size_t j=0; j < LARGE_OPS_PER_ITERATION; j++){
+                storeBitmapAtomic.release(indices[j]);
+            }
+        }
+    });
+    std::cout << std::endl;
+
+
+
+
+    // first use of a new store (objects need to be constructed) vs. store prewarmed with reserve()
+
+    // RecycleObjectStoreQueue cold(1M):      ~ 54.1 Mio/sec
+    bench.run("RecycleObjectStoreQueue cold(" + std::to_string(LARGE_OPS_PER_ITERATION) + ")", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS/LARGE_OPS_PER_ITERATION; i++){
+            RecycleObjectStoreQueue<TestStruct> store;
+            for(size_t j=0; j < LARGE_OPS_PER_ITERATION; j++){
+                objects[j] = store.acquire();
+                objects[j]->a = objects[j]->b + objects[j]->c;
+            }
+            for(size_t j=0; j < LARGE_OPS_PER_ITERATION; j++){
+                store.release(objects[j]);
+            }
+        }
+    });
+
+
+    // RecycleObjectStoreQueue reserved(1M):  ~ 69.3 Mio/sec (excluding reserve())
+    bench.run("RecycleObjectStoreQueue reserved(" + std::to_string(LARGE_OPS_PER_ITERATION) + ")", ITERATIONS, [&](BenchmarkTimer &timer){
+        for(uint64_t i=0; i < ITERATIONS/LARGE_OPS_PER_ITERATION; i++){
+            const auto reserveStart = std::chrono::steady_clock::now();
+            RecycleObjectStoreQueue<TestStruct> store;
+            store.reserve(LARGE_OPS_PER_ITERATION);
+            timer.exclude(std::chrono::steady_clock::now() - reserveStart);
+            for(size_t j=0; j < LARGE_OPS_PER_ITERATION; j++){
+                objects[j] = store.acquire();
+                objects[j]->a = objects[j]->b + objects[j]->c;
+            }
+            for(size_t j=0; j < LARGE_OPS_PER_ITERATION; j++){
+                store.release(objects[j]);
+            }
+        }
+    });
+
+
+    // RecycleObjectStoreBitmap cold(1M):     ~ 88.5 Mio/sec
+    bench.run("RecycleObjectStoreBitmap cold(" + std::to_string(LARGE_OPS_PER_ITERATION) + ")", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS/LARGE_OPS_PER_ITERATION; i++){
+            RecycleObjectStoreBitmap<TestStruct> store;
+            TestStruct *obj;
+            for(size_t j=0; j < LARGE_OPS_PER_ITERATION; j++){
+                obj = store.acquire(indices[j]);
+                obj->a = obj->b + obj->c;
+            }
+            for(size_t j=0; j < LARGE_OPS_PER_ITERATION; j++){
+                store.release(indices[j]);
+            }
+        }
+    });
+    std::cout << std::endl;
+
+
+
+
+    // multiple threads acquire and release 8 objects at a time (RecycleObjectStoreQueue guarded by a mutex)
+    // total throughput measured on a single core, contention grows with more cores
+    //                                  1 thread        4 threads       16 threads      64 threads
+    // RecycleObjectStoreQueue+mutex:   ~ 24.0 Mio/sec  ~ 21.9 Mio/sec  ~ 21.7 Mio/sec  ~ 22.9 Mio/sec
+    // RecycleObjectStoreMagazine:      ~ 128.5 Mio/sec ~ 121.1 Mio/sec ~ 126.5 Mio/sec ~ 107.9 Mio/sec
+    const size_t THREAD_BATCH = 8;
+    for(size_t threadCount : {1, 4, 16, 64}){
+        std::mutex mQueue;
+        runThreads(bench, "RecycleObjectStoreQueue+mutex(" + std::to_string(threadCount) + " threads)", threadCount, ITERATIONS, [&storeQueue, &mQueue](uint64_t ops){
+            TestStruct *batch[THREAD_BATCH];
+            for(uint64_t i=0; i < ops; i += THREAD_BATCH){
+                for(size_t j=0; j < THREAD_BATCH; j++){
+                    std::unique_lock<std::mutex> lQueue(mQueue);
+                    batch[j] = storeQueue.acquire();
+                }
+                for(size_t j=0; j < THREAD_BATCH; j++){
+                    batch[j]->a = batch[j]->b + batch[j]->c;
+                    std::unique_lock<std::mutex> lQueue(mQueue);
+                    storeQueue.release(batch[j]);
+                }
+            }
+        });
+
+        RecycleObjectStoreMagazine<TestStruct> storeMagazine;
+        runThreads(bench, "RecycleObjectStoreMagazine(" + std::to_string(threadCount) + " threads)", threadCount, ITERATIONS, [&storeMagazine](uint64_t ops){
+            TestStruct *batch[THREAD_BATCH];
+            for(uint64_t i=0; i < ops; i += THREAD_BATCH){
+                for(size_t j=0; j < THREAD_BATCH; j++){
+                    batch[j] = storeMagazine.acquire();
+                }
+                for(size_t j=0; j < THREAD_BATCH; j++){
+                    batch[j]->a = batch[j]->b + batch[j]->c;
+                    storeMagazine.release(batch[j]);
+                }
+            }
+        });
     }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "RecycleObjectStoreVector(" << OPS_PER_ITERATION << "): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
     std::cout << std::endl;
 
 
-    return 0;
+    return bench.finish();
 }
\ No newline at end of file
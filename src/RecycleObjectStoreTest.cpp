@@ -1,11 +1,17 @@
+#include "./utils/NumaAllocator.hpp"
 #include "./utils/RecycleObjectStoreBitmap.hpp"
+#include "./utils/RecycleObjectStoreBitmapAtomic.hpp"
+#include "./utils/RecycleObjectStoreMagazine.hpp"
 #include "./utils/RecycleObjectStoreQueue.hpp"
 #include "./utils/RecycleObjectStoreVector.hpp"
 
+#include <cstdint>
 #include <iostream>
 #include <queue>
 #include <stdexcept>
+#include <thread>
 #include <unordered_set>
+#include <vector>
 
 using namespace spi;
 
@@ -278,9 +284,224 @@ void testVector(){
 
 
 
+void testBitmap(){
+    const size_t COUNT = 200000; // multiple summary words
+    RecycleObjectStoreBitmap<TestStruct> store;
+    std::vector<size_t> indices(COUNT);
+    std::unordered_set<TestStruct*> seen;
+
+    for(size_t i=0; i < COUNT; i++){
+        TestStruct *obj = store.acquire(indices[i]);
+        if(indices[i] != i) throw std::runtime_error("Bitmap: unexpected index (got: "+std::to_string(indices[i])+"; expected: "+std::to_string(i)+")");
+        obj->a = i;
+        seen.insert(obj);
+    }
+
+    // release every third object (includes bits 32-63 of each word)
+    for(size_t i=0; i < COUNT; i += 3) store.release(indices[i]);
+    for(size_t i=0; i < COUNT; i += 3){
+        size_t index;
+        TestStruct *obj = store.acquire(index);
+        if(index != i) throw std::runtime_error("Bitmap: lowest available object not returned (got: "+std::to_string(index)+"; expected: "+std::to_string(i)+")");
+        if(obj->a != i) throw std::runtime_error("Bitmap: object not as expected (got: "+std::to_string(obj->a)+"; expected: "+std::to_string(i)+")");
+    }
+
+    // nothing available, new object
+    size_t index;
+    TestStruct *obj = store.acquire(index);
+    if(index != COUNT || seen.find(obj) != seen.end()) throw std::runtime_error("Bitmap: no new object created");
+
+    for(size_t i=0; i < COUNT; i++) store.release(indices[i]);
+    store.release(index);
+    for(size_t i=0; i <= COUNT; i++){
+        store.acquire(index);
+        if(index != i) throw std::runtime_error("Bitmap: released objects not reused in order");
+    }
+}
+
+
+void testBitmapAtomic(){
+    const size_t CAPACITY = 10000;
+    const size_t THREADS = 4;
+    const size_t ROUNDS = 200;
+    RecycleObjectStoreBitmapAtomic<TestStruct> store(CAPACITY);
+
+    std::vector<std::thread> threads;
+    std::vector<int> failed(THREADS, 0);
+    for(size_t t=0; t < THREADS; t++){
+        threads.emplace_back([&store, &failed, t]{
+            std::vector<size_t> indices;
+            std::vector<TestStruct*> objects;
+            for(size_t round=0; round < ROUNDS; round++){
+                for(size_t i=0; i < CAPACITY / THREADS; i++){
+                    size_t index;
+                    TestStruct *obj = store.acquire(index);
+                    if(obj == nullptr){ failed[t] = 1; return; }
+                    obj->a = t; // detects objects handed to two threads
+                    indices.push_back(index);
+                    objects.push_back(obj);
+                }
+                std::this_thread::yield();
+                for(size_t i=0; i < indices.size(); i++){
+                    if(objects[i]->a != t) failed[t] = 2;
+                    store.release(indices[i]);
+                }
+                indices.clear();
+                objects.clear();
+            }
+        });
+    }
+    for(std::thread &thread : threads) thread.join();
+    for(size_t t=0; t < THREADS; t++)
+        if(failed[t] != 0) throw std::runtime_error(failed[t] == 1 ? "BitmapAtomic: store ran empty" : "BitmapAtomic: object acquired twice");
+
+    std::vector<size_t> indices(CAPACITY);
+    for(size_t i=0; i < CAPACITY; i++){
+        if(store.acquire(indices[i]) == nullptr) throw std::runtime_error("BitmapAtomic: object not released");
+    }
+    size_t index;
+    if(store.acquire(index) != nullptr) throw std::runtime_error("BitmapAtomic: more objects than capacity");
+    store.release(indices[4321]);
+    if(store.acquire(index) == nullptr || index != indices[4321]) throw std::runtime_error("BitmapAtomic: released object not found");
+}
+
+
+
+void testSlab(){
+    const size_t CHUNK = 16;
+
+    // reserve constructs objects with given arguments, acquire reuses them before creating new ones
+    RecycleObjectStoreQueue<TestStruct> queue(CHUNK);
+    queue.reserve(CHUNK * 2, (size_t)7, 1, 2);
+    std::unordered_set<TestStruct*> reserved;
+    for(size_t i=0; i < CHUNK * 2; i++){
+        TestStruct *obj = queue.acquire((size_t)0, 0, 0);
+        if(obj->a != 7 || obj->b != 1 || obj->c != 2) throw std::runtime_error("Slab: reserved object not constructed with arguments");
+        reserved.insert(obj);
+    }
+    TestStruct *created = queue.acquire((size_t)3, 4, 5);
+    if(reserved.find(created) != reserved.end() || created->a != 3 || created->b != 4 || created->c != 5)
+        throw std::runtime_error("Slab: new object not constructed with arguments");
+
+    // indices map to contiguous cache-line-aligned chunks
+    RecycleObjectStoreBitmap<TestStruct> bitmap(CHUNK);
+    bitmap.reserve(CHUNK * 3);
+    std::vector<TestStruct*> objects;
+    for(size_t i=0; i < CHUNK * 3; i++){
+        size_t index;
+        objects.push_back(bitmap.acquire(index));
+        if(index != i) throw std::runtime_error("Slab: reserved objects not acquired in order");
+    }
+    for(size_t i=0; i < objects.size(); i++){
+        if(i % CHUNK == 0){
+            if(reinterpret_cast<uintptr_t>(objects[i]) % CACHE_LINE_SIZE != 0) throw std::runtime_error("Slab: chunk not cache line aligned");
+        } else if(objects[i] != objects[i-1] + 1) throw std::runtime_error("Slab: objects of chunk not contiguous");
+    }
+
+    RecycleObjectStoreVector<TestStruct> vector(CHUNK);
+    vector.reserve(CHUNK + 1, (size_t)9, 8, 7);
+    size_t index;
+    TestStruct *obj = vector.acquire(index);
+    if(index != 0 || obj->a != 9 || obj->c != 7) throw std::runtime_error("Slab: vector store not reserved");
+    for(size_t i=1; i <= CHUNK + 1; i++) vector.acquire(index, (size_t)1, 1, 1);
+    if(index != CHUNK + 1 || vector.acquire(index)->a != 0) throw std::runtime_error("Slab: vector store did not grow");
+}
+
+
+
+void testMagazine(){
+    const size_t THREADS = 8;
+    const size_t ROUNDS = 200;
+    const size_t BATCH = 100;
+    const size_t MAGAZINE = 8;
+
+    // objects are never handed to two threads at once, also if released by another thread
+    {
+        RecycleObjectStoreMagazine<TestStruct> store(MAGAZINE);
+        std::vector<std::thread> threads;
+        std::vector<int> failed(THREADS, 0);
+        for(size_t t=0; t < THREADS; t++){
+            threads.emplace_back([&store, &failed, t]{
+                std::vector<TestStruct*> objects;
+                for(size_t round=0; round < ROUNDS; round++){
+                    for(size_t i=0; i < BATCH; i++){
+                        TestStruct *obj = store.acquire();
+                        obj->a = t;
+                        objects.push_back(obj);
+                    }
+                    std::this_thread::yield();
+                    for(TestStruct *obj : objects){
+                        if(obj->a != t) failed[t] = 1;
+                        store.release(obj);
+                    }
+                    objects.clear();
+                }
+            });
+        }
+        for(std::thread &thread : threads) thread.join();
+        for(size_t t=0; t < THREADS; t++)
+            if(failed[t] != 0) throw std::runtime_error("Magazine: object acquired twice");
+
+        // caches of exited threads are adopted, objects get reused instead of constructed again
+        std::unordered_set<TestStruct*> seen;
+        std::thread producer([&store, &seen]{
+            for(size_t i=0; i < BATCH; i++) seen.insert(store.acquire((size_t)1, 2, 3));
+            for(TestStruct *obj : seen) store.release(obj);
+        });
+        producer.join();
+        bool reused = true;
+        std::thread consumer([&store, &reused]{
+            for(size_t i=0; i < BATCH; i++){
+                TestStruct *obj = store.acquire((size_t)4, 5, 6);
+                if(obj->a == 4 && obj->b == 5) reused = false;
+            }
+        });
+        consumer.join();
+        if(!reused) throw std::runtime_error("Magazine: released objects not reused");
+    }
+
+    // threads may outlive the store and use newer stores afterwards
+    for(size_t i=0; i < 3; i++){
+        RecycleObjectStoreMagazine<TestStruct> store(MAGAZINE);
+        store.reserve(MAGAZINE * 4, (size_t)7, 8, 9);
+        TestStruct *obj = store.acquire();
+        if(obj->a != 7 || obj->c != 9) throw std::runtime_error("Magazine: reserved object not constructed with arguments");
+        store.release(obj);
+    }
+}
+
+
+void testNumaAllocator(){
+    const size_t CHUNK = 16;
+    const int node = HardwareUtils::currentNumaNode() >= 0 ? HardwareUtils::currentNumaNode() : 0;
+
+    // chunks come from page aligned memory of the given NUMA node
+    RecycleObjectStoreQueue<TestStruct, NumaAllocator<TestStruct>> store(CHUNK, NumaAllocator<TestStruct>(node));
+    store.reserve(CHUNK * 2, (size_t)5, 6, 7);
+    TestStruct *obj = store.acquire();
+    if(obj->a != 5 || obj->c != 7) throw std::runtime_error("NumaAllocator: reserved object not constructed with arguments");
+    if(reinterpret_cast<uintptr_t>(obj) % HardwareUtils::getPageSize() != 0) throw std::runtime_error("NumaAllocator: chunk not page aligned");
+    const int actual = HardwareUtils::getNumaNodeOfMemory(obj);
+    if(actual >= 0 && actual != node)
+        throw std::runtime_error("NumaAllocator: memory on NUMA node "+std::to_string(actual)+" instead of "+std::to_string(node));
+    store.release(obj);
+
+    // huge pages fall back to regular pages if none are reserved
+    std::vector<uint64_t, NumaAllocator<uint64_t>> values(NumaAllocator<uint64_t>(node, PageSize::HUGE_2MB));
+    for(uint64_t i=0; i < 100000; i++) values.push_back(i);
+    for(uint64_t i=0; i < 100000; i++) if(values[i] != i) throw std::runtime_error("NumaAllocator: vector lost values");
+}
+
+
+
 int main(){
     
     testQueue();
+    testBitmap();
+    testBitmapAtomic();
+    testSlab();
+    testMagazine();
+    testNumaAllocator();
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,267 @@
+#include "./utils/Atomic.hpp"
+#include "./utils/Benchmark.hpp"
+#include "./utils/CountingLock.hpp"
+#include "./utils/HardwareUtils.hpp"
+#include "./utils/Lock.hpp"
+#include "./utils/Thread.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace spi;
+
+
+// Sweeps thread count, thread placement and critical section length for the synchronization primitives.
+// Throughput is the reported ops/sec, fairness gets reported as metrics over the operations every thread completed:
+//  jain       Jain's fairness index (1 = every thread got the same share, 1/threads = one thread got everything)
+//  min_share  operations of the slowest thread relative to the average (0 = a thread starved)
+
+const std::vector<size_t> THREAD_COUNTS = {1, 2, 4, 8, 16, 32, 64, 128};
+const std::vector<uint32_t> CRITICAL_SECTIONS = {0, 64, 1024}; // iterations of dependent work inside the critical section
+const uint64_t OPERATIONS = 400000;                             // per configuration with an empty critical section
+const uint64_t READ_WRITE_WRITE_EVERY = 16;                     // every n-th operation of a ReadOrWriteAccess thread writes
+
+
+/**
+ * Set of CPUs threads get pinned to (thread i runs on cpus[i]).
+ */
+struct Placement {
+    std::string name;
+    std::vector<size_t> cpus; // empty = threads are not pinned
+};
+
+/**
+ * Builds the placements relative to the given CPU:
+ *  unpinned  scheduler decides
+ *  smt       SMT siblings of the same physical core
+ *  l3        physical cores sharing the L3 cache
+ *  numa      physical cores of the same NUMA node
+ *  cross     physical cores taken round-robin from all NUMA nodes (every neighbour lives on another node)
+ * Placements with less than two CPUs are skipped as they cannot show anything the single thread runs do not.
+ */
+std::vector<Placement> buildPlacements(size_t anchor){
+    const CpuTopology &topology = HardwareUtils::getTopology();
+    const std::vector<size_t> cores = topology.getPhysicalCores();
+    auto physical = [&cores](const std::vector<size_t> &cpus){
+        std::vector<size_t> result;
+        for(size_t cpu : cpus)
+            if(std::find(cores.begin(), cores.end(), cpu) != cores.end()) result.push_back(cpu);
+        return result;
+    };
+
+    std::vector<Placement> placements;
+    placements.push_back(Placement{"unpinned", {}});
+    placements.push_back(Placement{"smt", topology.getSmtSiblings(anchor)});
+    placements.push_back(Placement{"l3", physical(topology.getCpusSharingL3(anchor))});
+    const int node = std::max(0, HardwareUtils::getNumaNode((int)anchor));
+    placements.push_back(Placement{"numa", physical(HardwareUtils::getCpusOfNumaNode(node))});
+
+    std::vector<std::vector<size_t>> perNode;
+    for(size_t n=0; n < HardwareUtils::getNumaNodeCount(); n++){
+        std::vector<size_t> cpus = physical(HardwareUtils::getCpusOfNumaNode((int)n));
+        if(!cpus.empty()) perNode.push_back(cpus);
+    }
+    Placement cross{"cross", {}};
+    if(perNode.size() >= 2){
+        for(size_t i=0; ; i++){
+            bool added = false;
+            for(const std::vector<size_t> &cpus : perNode){
+                if(i >= cpus.size()) continue;
+                cross.cpus.push_back(cpus[i]);
+                added = true;
+            }
+            if(!added) break;
+        }
+    }
+    placements.push_back(cross);
+
+    std::vector<Placement> usable;
+    for(const Placement &placement : placements){
+        if(placement.name != "unpinned" && placement.cpus.size() < 2){
+            std::cerr << "Skipping placement " << placement.name << " (" << placement.cpus.size() << " CPUs)" << std::endl;
+            continue;
+        }
+        usable.push_back(placement);
+    }
+    return usable;
+}
+
+/**
+ * Returns the thread counts to sweep for a placement
+ * (pinned placements never put two threads on one CPU, unpinned ones run at least two threads).
+ */
+std::vector<size_t> threadCountsOf(const Placement &placement){
+    const size_t limit = placement.cpus.empty() ? std::max<size_t>(2, (size_t)HardwareUtils::getCpuCoreCount()) : placement.cpus.size();
+    std::vector<size_t> counts;
+    for(size_t count : THREAD_COUNTS)
+        if(count <= limit) counts.push_back(count);
+    if(counts.back() != limit && limit < THREAD_COUNTS.back()) counts.push_back(limit);
+    return counts;
+}
+
+
+/** Dependent work that cannot be optimized away (length of the critical section). */
+inline uint64_t work(uint64_t value, uint32_t iterations){
+    for(uint32_t i=0; i < iterations; i++){
+        value = value * 6364136223846793005ull + 1442695040888963407ull;
+        Benchmark::doNotOptimize(value);
+    }
+    return value;
+}
+
+/**
+ * Starts threadCount threads placed according to placement that all call body(threadIndex, completedOps) until it returns false,
+ * measures the time until all of them finished and reports the fairness of completed operations.
+ * reset() gets called before every repetition so the shared state starts over.
+ */
+template<typename Reset, typename Body>
+void measure(Benchmark &bench, const std::string &name, const Placement &placement, size_t threadCount, uint64_t operations,
+                Reset &&reset, Body &&body){
+    const std::string fullName = name + " " + placement.name + " " + std::to_string(threadCount) + " threads";
+    bench.run(fullName, operations, [&](BenchmarkTimer &timer){
+        reset();
+        std::atomic<size_t> ready{0};
+        std::vector<uint64_t> completed(threadCount * 8, 0); // every counter on its own cache line
+        std::vector<Thread*> threads;
+        for(size_t t=0; t < threadCount; t++){
+            threads.push_back(new Thread([&, t](){
+                ready.fetch_add(1);
+                while(ready.load() < threadCount) std::this_thread::yield();
+                uint64_t ops = 0;
+                while(body(t, ops)) ops++;
+                completed[t * 8] = ops;
+            }));
+            if(!placement.cpus.empty()) threads.back()->setCPU((int)placement.cpus[t]);
+        }
+        timer.start();
+        for(Thread* thread : threads) thread->start();
+        for(Thread* thread : threads) thread->join();
+        timer.stop();
+        for(Thread* thread : threads) delete thread;
+
+        double sum = 0, squares = 0, min = (double)UINT64_MAX;
+        for(size_t t=0; t < threadCount; t++){
+            const double ops = (double)completed[t * 8];
+            sum += ops;
+            squares += ops * ops;
+            min = std::min(min, ops);
+        }
+        timer.metric("jain", squares > 0 ? sum * sum / ((double)threadCount * squares) : 1.0);
+        timer.metric("min_share", sum > 0 ? min * (double)threadCount / sum : 1.0);
+    });
+}
+
+
+/**
+ * Threads repeatedly take an exclusive lock and run the critical section on shared data until operations got completed.
+ */
+template<typename LockType>
+void measureExclusive(Benchmark &bench, const std::string &name, LockType &lock, const Placement &placement, size_t threadCount,
+                        uint32_t criticalSection, uint64_t operations){
+    uint64_t shared = 0;
+    uint64_t done = 0;
+    measure(bench, name, placement, threadCount, operations, [&]{ done = 0; }, [&](size_t, uint64_t){
+        lock.lock();
+        const bool more = done < operations;
+        if(more){
+            done++;
+            shared = work(shared, criticalSection);
+        }
+        lock.unlock();
+        return more;
+    });
+}
+
+/**
+ * Adapter so CountingLockFetch with a maximum of one can be used like a lock.
+ */
+struct CountingLockFetchExclusive {
+    CountingLockFetch counting{1, false, true};
+    inline void lock() { counting.acquire(); }
+    inline void unlock() { counting.release(); }
+};
+
+/**
+ * Threads read the shared data under read access and every READ_WRITE_WRITE_EVERY-th operation update it under write access.
+ * Operations get claimed through an atomic counter because readers cannot update shared data.
+ */
+void measureReadOrWrite(Benchmark &bench, const std::string &name, SharedLockMode mode, const Placement &placement, size_t threadCount,
+                        uint32_t criticalSection, uint64_t operations){
+    ReadOrWriteAccess access(false, true, true, mode);
+    uint64_t shared = 0;
+    std::atomic<uint64_t> claimed{0};
+    measure(bench, name, placement, threadCount, operations, [&]{ claimed.store(0); }, [&](size_t, uint64_t ops){
+        if(claimed.fetch_add(1, std::memory_order_relaxed) >= operations) return false;
+        if(ops % READ_WRITE_WRITE_EVERY == READ_WRITE_WRITE_EVERY - 1){
+            access.accessWrite();
+            shared = work(shared, criticalSection);
+            access.releaseWrite();
+        } else {
+            access.accessRead();
+            Benchmark::doNotOptimize(work(shared, criticalSection));
+            access.releaseRead();
+        }
+        return true;
+    });
+}
+
+/**
+ * Threads increment a shared Atomic<T> and then run the critical section length as local work
+ * (measures the atomic itself, the work only controls how often it gets hit).
+ */
+void measureAtomic(Benchmark &bench, const std::string &name, AtomicBackend backend, const Placement &placement, size_t threadCount,
+                    uint32_t criticalSection, uint64_t operations){
+    Atomic<uint64_t> counter(backend, false, 0);
+    measure(bench, name, placement, threadCount, operations, [&]{ counter.storeA(0); }, [&](size_t thread, uint64_t){
+        if(counter.fetchAddA(1, std::memory_order_acq_rel) >= operations) return false;
+        Benchmark::doNotOptimize(work(thread, criticalSection));
+        return true;
+    });
+}
+
+
+
+int main(int argc, char** argv){
+    Benchmark bench("scaling_benchmark", argc, argv);
+    const size_t anchor = (size_t)std::max(0, bench.getConfig().cpu);
+    std::cout << HardwareUtils::getTopology().toString() << std::endl;
+
+    for(const Placement &placement : buildPlacements(anchor)){
+        for(size_t threadCount : threadCountsOf(placement)){
+            for(uint32_t criticalSection : CRITICAL_SECTIONS){
+                const uint64_t operations = OPERATIONS / (1 + criticalSection / 64);
+                const std::string cs = " cs=" + std::to_string(criticalSection);
+
+                std::mutex mutex;
+                measureExclusive(bench, "std::mutex" + cs, mutex, placement, threadCount, criticalSection, operations);
+                Lock spinLock(LockMode::SPIN);
+                measureExclusive(bench, "Lock SPIN" + cs, spinLock, placement, threadCount, criticalSection, operations);
+                Lock adaptiveLock(LockMode::ADAPTIVE);
+                measureExclusive(bench, "Lock ADAPTIVE" + cs, adaptiveLock, placement, threadCount, criticalSection, operations);
+                TicketLock ticketLock;
+                measureExclusive(bench, "TicketLock" + cs, ticketLock, placement, threadCount, criticalSection, operations);
+                MCSLock mcsLock;
+                measureExclusive(bench, "MCSLock" + cs, mcsLock, placement, threadCount, criticalSection, operations);
+                CountingLockFetchExclusive countingLock;
+                measureExclusive(bench, "CountingLockFetch" + cs, countingLock, placement, threadCount, criticalSection, operations);
+
+                measureReadOrWrite(bench, "ReadOrWriteAccess SHARED_MUTEX" + cs, SharedLockMode::SHARED_MUTEX,
+                                    placement, threadCount, criticalSection, operations);
+                measureReadOrWrite(bench, "ReadOrWriteAccess STRIPED" + cs, SharedLockMode::STRIPED_WRITER_PREFERENCE,
+                                    placement, threadCount, criticalSection, operations);
+
+                measureAtomic(bench, "Atomic THREAD_SAFE" + cs, AtomicBackend::THREAD_SAFE, placement, threadCount, criticalSection, operations);
+                measureAtomic(bench, "Atomic SEQLOCK" + cs, AtomicBackend::SEQLOCK, placement, threadCount, criticalSection, operations);
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    return bench.finish();
+}
@@ -0,0 +1,83 @@
+#include "./utils/Benchmark.hpp"
+#include "./utils/HardwareUtils.hpp"
+#include "./utils/ShardedCounter.hpp"
+#include "./utils/Thread.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace spi;
+
+
+const uint64_t ITERATIONS = 20000000; // per thread
+
+
+/**
+ * Lets the given amount of threads increment the same counter at once, then checks the sum.
+ */
+template<typename Increment, typename Load>
+void measureScaling(Benchmark &bench, const std::string &name, size_t threadCount, Increment increment, Load load){
+    bench.run(name + " " + std::to_string(threadCount) + " threads", (uint64_t)threadCount * ITERATIONS, [&](BenchmarkTimer &timer){
+        const uint64_t before = (uint64_t)load();
+        std::atomic<size_t> ready{0};
+        std::vector<Thread*> threads;
+        for(size_t t=0; t < threadCount; t++){
+            threads.push_back(new Thread([&]{
+                ready.fetch_add(1);
+                while(ready.load() < threadCount) std::this_thread::yield();
+                for(uint64_t i=0; i < ITERATIONS; i++) increment();
+            }));
+            bench.pin(*threads.back(), t);
+        }
+        timer.start();
+        for(Thread* thr : threads) thr->start();
+        for(Thread* thr : threads) thr->join();
+        timer.stop();
+        for(Thread* thr : threads) delete thr;
+        if((uint64_t)load() - before != threadCount * ITERATIONS)
+            throw std::runtime_error(name+" lost increments");
+    });
+}
+
+
+int main(int argc, char** argv){
+    Benchmark bench("sharded_counter_benchmark", argc, argv);
+    const size_t cores = (size_t)std::max(1, HardwareUtils::getCpuCoreCount());
+    std::vector<size_t> threadCounts;
+    for(size_t t=1; t < cores; t *= 2) threadCounts.push_back(t);
+    threadCounts.push_back(cores);
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> shared{0};
+    ShardedCounter<uint64_t> perThread(ShardSelection::THREAD);
+    ShardedCounter<uint64_t> perCpu(ShardSelection::CPU);
+
+    // single std::atomic::fetch_add() shared by all threads (cache line bounces between cores)
+    for(size_t threads : threadCounts)
+        measureScaling(bench, "std::atomic::fetch_add()", threads, [&]{ shared.fetch_add(1, std::memory_order_relaxed); }, [&]{ return shared.load(); });
+    std::cout << std::endl;
+
+    for(size_t threads : threadCounts)
+        measureScaling(bench, "ShardedCounter::increment() per thread", threads, [&]{ perThread.increment(); }, [&]{ return perThread.load(); });
+    std::cout << std::endl;
+
+    for(size_t threads : threadCounts)
+        measureScaling(bench, "ShardedCounter::increment() per CPU", threads, [&]{ perCpu.increment(); }, [&]{ return perCpu.load(); });
+    std::cout << std::endl;
+
+    // reads sum up every shard
+    uint64_t sum = 0;
+    bench.run("ShardedCounter::load() (" + std::to_string(perThread.getShardCount()) + " shards)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++) sum += perThread.load();
+    });
+    bench.run("ShardedCounter::loadExact() (" + std::to_string(perThread.getShardCount()) + " shards)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++) sum += perThread.loadExact();
+    });
+    Benchmark::doNotOptimize(sum);
+
+    return bench.finish();
+}
@@ -1,3 +1,4 @@
+#include "./utils/Benchmark.hpp"
 #include "./utils/Tuple.hpp"
 
 #include <chrono>
@@ -8,7 +9,7 @@
 
 class MyClass {
 protected:
-    int32_t a;
+    int32_t a = 0;
 
 public:
 
@@ -22,47 +23,48 @@ public:
 };
 
 
-int main(){
+int main(int argc, char** argv){
+    spi::Benchmark bench("smartptr_benchmark", argc, argv);
     const uint64_t ITERATIONS = 50000000;
 
 
     // MyClass():               ~ 200.9 Mio/sec
-    auto startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        MyClass myClass;
-        myClass.doSomething();
-    }
-    auto endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "MyClass(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("MyClass()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            MyClass myClass;
+            myClass.doSomething();
+            spi::Benchmark::doNotOptimize(myClass);
+        }
+    });
 
     // new MyClass():           ~ 54.9 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        MyClass *myClass = new MyClass();
-        myClass->doSomething();
-        delete myClass;
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "new MyClass(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("new MyClass()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            MyClass *myClass = new MyClass();
+            myClass->doSomething();
+            spi::Benchmark::doNotOptimize(myClass);
+            delete myClass;
+        }
+    });
 
     // unique_ptr<MyClass>:     ~ 9.2 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        std::unique_ptr<MyClass> myClass = std::make_unique<MyClass>();
-        myClass->doSomething();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "unique_ptr<MyClass>: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("unique_ptr<MyClass>", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            std::unique_ptr<MyClass> myClass = std::make_unique<MyClass>();
+            myClass->doSomething();
+            spi::Benchmark::doNotOptimize(myClass.get());
+        }
+    });
 
 
     // shared_ptr<MyClass>:     ~ 4.3 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        std::shared_ptr<MyClass> myClass = std::make_shared<MyClass>();
-        myClass->doSomething();
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "shared_ptr<MyClass>: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
-
-    return 0;
+    bench.run("shared_ptr<MyClass>", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            std::shared_ptr<MyClass> myClass = std::make_shared<MyClass>();
+            myClass->doSomething();
+            spi::Benchmark::doNotOptimize(myClass.get());
+        }
+    });
+
+    return bench.finish();
 }
\ No newline at end of file
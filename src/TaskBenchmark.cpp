@@ -0,0 +1,119 @@
+#include "./utils/Benchmark.hpp"
+#include "./utils/Task.hpp"
+#include "./utils/Thread.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+
+using namespace spi;
+
+
+std::atomic<uint64_t> sink{0};
+
+template<size_t N>
+struct Payload {
+    std::array<uint64_t, N> values{};
+};
+
+void consume(uint64_t a, uint64_t b){
+    sink.fetch_add(a + b, std::memory_order_relaxed);
+}
+
+
+int main(int argc, char** argv){
+    Benchmark bench("task_benchmark", argc, argv);
+    const uint64_t ITERATIONS = 20000000;
+    const uint64_t POOL_ITERATIONS = 2000000;
+    Payload<2> smallPayload;  // 16 bytes
+    Payload<12> largePayload; // 96 bytes
+
+
+    // Create & call std::function + std::bind (16 bytes):      ~ 60 Mio/sec
+    bench.run("Create & call std::function + std::bind (16 bytes)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            std::function<void()> fn = std::bind([smallPayload](uint64_t a){ consume(a, smallPayload.values[0]); }, i);
+            fn();
+        }
+    });
+
+
+    // Create & call Task (16 bytes):                           ~ 116 Mio/sec
+    bench.run("Create & call Task (16 bytes)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            Task task([smallPayload](uint64_t a){ consume(a, smallPayload.values[0]); }, i);
+            task();
+        }
+    });
+
+
+    // Create & call std::function + std::bind (96 bytes):      ~ 57 Mio/sec
+    bench.run("Create & call std::function + std::bind (96 bytes)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            std::function<void()> fn = std::bind([largePayload](uint64_t a){ consume(a, largePayload.values[0]); }, i);
+            fn();
+        }
+    });
+
+
+    // Create & call Task (96 bytes, heap):                     ~ 59 Mio/sec
+    bench.run("Create & call Task (96 bytes, heap)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            Task task([largePayload](uint64_t a){ consume(a, largePayload.values[0]); }, i);
+            task();
+        }
+    });
+
+
+    // Create & call InlineTask<128> (96 bytes, inline):        ~ 100 Mio/sec
+    bench.run("Create & call InlineTask<128> (96 bytes, inline)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            InlineTask<128> task([largePayload](uint64_t a){ consume(a, largePayload.values[0]); }, i);
+            task();
+        }
+    });
+
+
+
+    // ThreadPool submissions of std::function + std::bind:     ~ 4.7 Mio/sec
+    {
+        ThreadPool pool(0, -1, 5000, -1, true);
+        bench.run("ThreadPool submissions of std::function + std::bind", POOL_ITERATIONS, [&](){
+            for(uint64_t i=0; i < POOL_ITERATIONS; i++){
+                std::function<void()> fn = std::bind(consume, i, smallPayload.values[0]); // previous Task representation
+                pool.submitTask(std::move(fn));
+            }
+            pool.join();
+        });
+    }
+
+
+    // ThreadPool submissions of Task:                          ~ 6.3 Mio/sec
+    {
+        ThreadPool pool(0, -1, 5000, -1, true);
+        bench.run("ThreadPool submissions of Task", POOL_ITERATIONS, [&](){
+            for(uint64_t i=0; i < POOL_ITERATIONS; i++){
+                pool.submitTask(consume, i, smallPayload.values[0]);
+            }
+            pool.join();
+        });
+    }
+
+
+    // ThreadPool submissions of Task from worker:              ~ 8.4 Mio/sec
+    {
+        ThreadPool pool(0, -1, 5000, -1, true);
+        bench.run("ThreadPool submissions of Task from worker", POOL_ITERATIONS, [&](){
+            pool.submitTask([&pool, POOL_ITERATIONS, smallPayload]{
+                for(uint64_t i=0; i < POOL_ITERATIONS; i++)
+                    pool.submitTask(consume, i, smallPayload.values[0]); // local deque, recycled tasks
+            });
+            pool.join();
+        });
+    }
+
+    return bench.finish();
+}
@@ -0,0 +1,217 @@
+#include "./utils/Thread.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace spi;
+
+
+
+void runSubmitTest(ThreadPool &pool, const std::string &name){
+    const size_t TASKS = 100000;
+    std::atomic<size_t> counter{0};
+
+    for(size_t i=0; i < TASKS; i++)
+        pool.submitTask([&counter]{ counter.fetch_add(1); });
+    pool.join();
+
+    if(counter.load() != TASKS)
+        throw std::runtime_error(name+": counter should be "+std::to_string(TASKS)+" but it is "+std::to_string(counter.load()));
+    std::cout << "Completed SubmitTest for " << name << " successfully" << std::endl;
+}
+
+void runIdleTest(ThreadPool &pool, size_t maxThreads, const std::string &name){
+    std::atomic<size_t> counter{0};
+    for(size_t i=0; i < 10000; i++)
+        pool.submitTask([&counter]{ counter.fetch_add(1); });
+    pool.join();
+
+    // join() returns once the queue is empty, the last tasks may still be running
+    const std::chrono::steady_clock::time_point timeout = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while(counter.load() != 10000 || pool.getIdleThreadCount() != pool.getCurrentThreadCount()){
+        if(std::chrono::steady_clock::now() > timeout)
+            throw std::runtime_error(name+": "+std::to_string(pool.getIdleThreadCount())+" of "+std::to_string(pool.getCurrentThreadCount())+" workers idle after join");
+        std::this_thread::yield();
+    }
+    if(pool.getCurrentThreadCount() == 0 || pool.getCurrentThreadCount() > maxThreads)
+        throw std::runtime_error(name+": "+std::to_string(pool.getCurrentThreadCount())+" workers instead of 1 to "+std::to_string(maxThreads));
+    std::cout << "Completed IdleTest for " << name << " successfully" << std::endl;
+}
+
+void runNestedSubmitTest(ThreadPool &pool, const std::string &name){
+    const size_t OUTER = 1000;
+    const size_t INNER = 100;
+    std::atomic<size_t> counter{0};
+
+    for(size_t i=0; i < OUTER; i++){
+        pool.submitTask([&pool, &counter, INNER]{
+            for(size_t j=0; j < INNER; j++)
+                pool.submitTask([&counter]{ counter.fetch_add(1); }); // lands in the local deque of the worker
+        });
+    }
+    pool.join();
+
+    if(counter.load() != OUTER * INNER)
+        throw std::runtime_error(name+": counter should be "+std::to_string(OUTER * INNER)+" but it is "+std::to_string(counter.load()));
+    std::cout << "Completed NestedSubmitTest for " << name << " successfully" << std::endl;
+}
+
+void runNumaSubmitTest(ThreadPool &pool, const std::string &name){
+    const size_t TASKS = 100000;
+    std::atomic<size_t> counter{0};
+    std::vector<int> nodes = pool.getNumaNodes();
+    if(nodes.empty()) nodes.push_back(0); // no NUMA information, tasks fall back to any worker
+
+    for(size_t i=0; i < TASKS; i++)
+        pool.submitTask(nodes[i % nodes.size()], [&counter]{ counter.fetch_add(1); });
+    pool.join();
+
+    if(counter.load() != TASKS)
+        throw std::runtime_error(name+": counter should be "+std::to_string(TASKS)+" but it is "+std::to_string(counter.load()));
+    std::cout << "Completed NumaSubmitTest for " << name << " on " << pool.getNumaNodes().size() << " NUMA nodes successfully" << std::endl;
+}
+
+void runCancelTest(ThreadPool &pool, const std::string &name){
+    std::atomic<size_t> counter{0};
+    pool.submitTask([]{ Thread::sleepMs(50); });
+    for(size_t i=0; i < 1000; i++)
+        pool.submitTask([&counter]{ counter.fetch_add(1); Thread::sleepUs(100); });
+    pool.cancelAllTasks();
+    pool.join();
+
+    if(counter.load() >= 1000)
+        throw std::runtime_error(name+": tasks should have been cancelled but all "+std::to_string(counter.load())+" got executed");
+
+    // immediate cancel does not wait for the running task, later submissions get executed again
+    std::shared_ptr<std::atomic<bool>> release = std::make_shared<std::atomic<bool>>(false);
+    std::shared_ptr<std::atomic<bool>> running = std::make_shared<std::atomic<bool>>(false);
+    pool.submitTask([release, running]{ running->store(true); while(!release->load()) Thread::sleepUs(100); });
+    while(!running->load()) Thread::sleepUs(100);
+    pool.cancelAllTasks(true);
+    release->store(true);
+    std::atomic<size_t> after{0};
+    pool.submitTask([&after]{ after.fetch_add(1); });
+    pool.join();
+    if(after.load() != 1) throw std::runtime_error(name+": task submitted after immediate cancel did not run");
+    std::cout << "Completed CancelTest for " << name << " successfully" << std::endl;
+}
+
+/**
+ * Lets a single worker run queued HIGH, plain and LOW tasks and checks the order,
+ * that aging lets LOW tasks through and that expired tasks get dropped.
+ */
+void runPriorityTest(ThreadPool &pool, const std::string &name){
+    const size_t COUNT = 160;
+    std::atomic<bool> release{false}, started{false};
+    std::mutex mOrder;
+    std::vector<int> order; // 0 = HIGH, 1 = plain, 2 = LOW
+
+    pool.submitTask([&]{ started = true; while(!release.load()) Thread::sleepUs(100); });
+    while(!started.load()) Thread::sleepUs(100);
+    for(size_t i=0; i < COUNT; i++){
+        pool.submitTask(TaskPriority::LOW, [&]{ std::lock_guard<std::mutex> l(mOrder); order.push_back(2); });
+        pool.submitTask([&]{ std::lock_guard<std::mutex> l(mOrder); order.push_back(1); });
+        pool.submitTask(TaskPriority::HIGH, [&]{ std::lock_guard<std::mutex> l(mOrder); order.push_back(0); });
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if(pool.submitTask(TaskPriority::HIGH, now - std::chrono::milliseconds(1), []{ throw std::runtime_error("rejected task ran"); }))
+        throw std::runtime_error(name+": task with passed deadline got accepted");
+    pool.submitTask(TaskPriority::HIGH, now + std::chrono::milliseconds(5), []{ throw std::runtime_error("expired task ran"); });
+    Thread::sleepMs(10);
+    release = true;
+    pool.join();
+
+    size_t lastHigh = 0, lowBeforeLastHigh = 0, plainBeforeLastHigh = 0;
+    for(size_t i=0; i < order.size(); i++) if(order[i] == 0) lastHigh = i;
+    for(size_t i=0; i < lastHigh; i++){
+        if(order[i] == 1) plainBeforeLastHigh++;
+        if(order[i] == 2) lowBeforeLastHigh++;
+    }
+    const size_t aged = COUNT / SPI_THREAD_POOL_AGING_INTERVAL + 1; // picks that start at a lower lane
+    if(order.size() != 3 * COUNT || lowBeforeLastHigh + plainBeforeLastHigh > aged || lowBeforeLastHigh == 0 || plainBeforeLastHigh == 0)
+        throw std::runtime_error(name+": wrong order, "+std::to_string(plainBeforeLastHigh)+" plain and "+std::to_string(lowBeforeLastHigh)+
+                                 " low tasks ran before the last high priority task");
+
+    const ThreadPoolLaneStats high = pool.getLaneStats(TaskPriority::HIGH);
+    const ThreadPoolLaneStats low = pool.getLaneStats(TaskPriority::LOW);
+    if(high.submitted != COUNT + 1 || high.executed != COUNT || high.expired != 1 || high.rejected != 1 || high.queued != 0 ||
+       high.queueLatency.count() != COUNT || high.queueLatency.min() < 10000000 || low.executed != COUNT)
+        throw std::runtime_error(name+": wrong lane statistics");
+    std::cout << "Completed PriorityTest for " << name << " successfully (HIGH queue latency " << high.queueLatency.toString() << ")" << std::endl;
+}
+
+void runParallelForTest(ThreadPool &pool, size_t workers, const std::string &name){
+    const size_t COUNT = 1000000;
+    std::vector<uint8_t> visited(COUNT, 0);
+    pool.parallelFor(0, COUNT, 1000, [&visited](size_t i){ visited[i]++; });
+    for(size_t i=0; i < COUNT; i++)
+        if(visited[i] != 1) throw std::runtime_error(name+": parallelFor visited index "+std::to_string(i)+" "+std::to_string(visited[i])+" times");
+
+    std::atomic<size_t> sum{0};
+    pool.parallelFor(10, 10 + COUNT, 0, [&sum](size_t begin, size_t end){ // chunked overload with automatic grain
+        size_t local = 0;
+        for(size_t i=begin; i < end; i++) local += i;
+        sum.fetch_add(local);
+    });
+    if(sum.load() != (10 + COUNT) * (9 + COUNT) / 2 - 45)
+        throw std::runtime_error(name+": parallelFor chunk sum is "+std::to_string(sum.load()));
+
+    std::atomic<size_t> nested{0};
+    pool.submitTask([&pool, &nested]{ // runs inline on the worker
+        pool.parallelFor(0, 1000, 10, [&nested](size_t){ nested.fetch_add(1); });
+    });
+    pool.join();
+    if(nested.load() != 1000) throw std::runtime_error(name+": nested parallelFor counted "+std::to_string(nested.load()));
+
+    bool thrown = false;
+    try {
+        pool.parallelFor(0, COUNT, 100, [](size_t i){ if(i == COUNT / 2) throw std::runtime_error("expected"); });
+    } catch(const std::runtime_error &e){
+        thrown = std::string(e.what()) == "expected";
+    }
+    if(!thrown) throw std::runtime_error(name+": parallelFor did not rethrow the exception of fn");
+
+    // caller does not wait for helpers that cannot run and get cancelled
+    std::shared_ptr<std::atomic<bool>> release = std::make_shared<std::atomic<bool>>(false); // blockers may still run after join()
+    for(size_t i=0; i < workers; i++)
+        pool.submitTask([release]{ while(!release->load()) std::this_thread::yield(); });
+    std::atomic<size_t> alone{0};
+    pool.parallelFor(0, 1000, 10, [&alone](size_t){ alone.fetch_add(1); });
+    pool.cancelAllTasks();
+    release->store(true);
+    pool.join();
+    if(alone.load() != 1000) throw std::runtime_error(name+": parallelFor with busy workers counted "+std::to_string(alone.load()));
+    std::cout << "Completed ParallelForTest for " << name << " successfully" << std::endl;
+}
+
+
+int main(){
+    ThreadPool stealingPool(0, 4, 5000, -1, true);
+    runSubmitTest(stealingPool, "work-stealing ThreadPool");
+    runNestedSubmitTest(stealingPool, "work-stealing ThreadPool");
+    runCancelTest(stealingPool, "work-stealing ThreadPool");
+    runParallelForTest(stealingPool, 4, "work-stealing ThreadPool");
+
+    ThreadPool sharedPool(0, 4);
+    runIdleTest(sharedPool, 4, "ThreadPool");
+
+    ThreadPool singlePool(0, 1);
+    runPriorityTest(singlePool, "ThreadPool");
+    runParallelForTest(singlePool, 1, "ThreadPool");
+    ThreadPool singleStealingPool(0, 1, 5000, -1, true);
+    runPriorityTest(singleStealingPool, "work-stealing ThreadPool");
+
+    ThreadPool numaPool(0, 4, 5000, ThreadPool::ALL_NUMA_NODES);
+    runSubmitTest(numaPool, "multi-node ThreadPool");
+    runNestedSubmitTest(numaPool, "multi-node ThreadPool");
+    runNumaSubmitTest(numaPool, "multi-node ThreadPool");
+
+    return 0;
+}
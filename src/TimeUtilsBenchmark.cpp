@@ -1,20 +1,61 @@
+#include "./utils/Benchmark.hpp"
 #include "./utils/TimeUtils.hpp"
 
+#include <chrono>
+#include <ctime>
 #include <iostream>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
 using namespace spi;
 
-int main(){
-    const uint64_t ITERATIONS = 500000000;
+
+/**
+ * Reads the given clock ITERATIONS times and accumulates the results so the reads cannot be optimized away.
+ */
+template<typename F>
+void measureClock(Benchmark &bench, const std::string &name, uint64_t iterations, F read){
+    bench.run(name, iterations, [&](){
+        uint64_t sum = 0;
+        for(uint64_t i=0; i < iterations; i++){
+            sum += (uint64_t)read();
+        }
+        Benchmark::doNotOptimize(sum);
+    });
+}
+
+inline uint64_t clockGetTime(clockid_t clock){
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+
+int main(int argc, char** argv){
+    Benchmark bench("time_utils_benchmark", argc, argv);
+    const uint64_t ITERATIONS = 50000000;
+
+    FastClock::calibrate();
+    std::cout << "FastClock source: " << (FastClock::source() == FastClockSource::TSC ? "TSC" : "CLOCK_MONOTONIC")
+              << " (" << FastClock::ticksPerNanosecond() << " ticks/ns)" << std::endl << std::endl;
 
 
     // TimeUtils::now():    ~ 46 Mio/sec
-    auto startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        TimeUtils::now();
-    }
-    auto endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "TimeUtils::now(): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
-
-    return 0;
-}
\ No newline at end of file
+    measureClock(bench, "TimeUtils::now()", ITERATIONS, [](){ return TimeUtils::now().time_since_epoch().count(); });
+    measureClock(bench, "steady_clock::now()", ITERATIONS, [](){ return std::chrono::steady_clock::now().time_since_epoch().count(); });
+    measureClock(bench, "high_resolution_clock::now()", ITERATIONS, [](){ return std::chrono::high_resolution_clock::now().time_since_epoch().count(); });
+    measureClock(bench, "clock_gettime(CLOCK_MONOTONIC)", ITERATIONS, [](){ return clockGetTime(CLOCK_MONOTONIC); });
+    measureClock(bench, "clock_gettime(CLOCK_MONOTONIC_COARSE)", ITERATIONS, [](){ return clockGetTime(CLOCK_MONOTONIC_COARSE); });
+    #if defined(__x86_64__) || defined(__i386__)
+    measureClock(bench, "rdtsc", ITERATIONS, [](){ return __rdtsc(); });
+    measureClock(bench, "rdtscp", ITERATIONS, [](){ unsigned int aux; return __rdtscp(&aux); });
+    #endif
+    measureClock(bench, "FastClock::ticks()", ITERATIONS, [](){ return FastClock::ticks(); });
+    measureClock(bench, "FastClock::ticksOrdered()", ITERATIONS, [](){ return FastClock::ticksOrdered(); });
+    measureClock(bench, "FastClock::nowNanos()", ITERATIONS, [](){ return FastClock::nowNanos(); });
+    measureClock(bench, "FastClock::coarseNanos()", ITERATIONS, [](){ return FastClock::coarseNanos(); });
+
+    return bench.finish();
+}
@@ -0,0 +1,63 @@
+#include "./utils/Benchmark.hpp"
+#include "./utils/Thread.hpp"
+#include "./utils/TimerWheel.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+using namespace spi;
+
+
+const uint64_t TIMERS = 1000000;
+const uint64_t THREAD_TIMERS = 2000; // one sleeping thread each
+
+
+int main(int argc, char** argv){
+    Benchmark bench("timer_wheel_benchmark", argc, argv);
+    std::vector<std::shared_ptr<Cancellable>> handles;
+    handles.reserve(TIMERS);
+
+    // typical request timeouts: armed for every request and cancelled once the response arrived
+    TimerWheel wheel;
+    bench.run("TimerWheel schedule+cancel", TIMERS, [&](){
+        for(uint64_t i=0; i < TIMERS; i++) handles.push_back(wheel.schedule(std::chrono::milliseconds(1000 + i % 5000), []{}));
+        for(std::shared_ptr<Cancellable> &handle : handles) handle->cancel();
+        handles.clear();
+    });
+
+    // what Thread::runAfter() used to do per call
+    bench.run("Thread per timer start+cancel", THREAD_TIMERS, [&](){
+        for(uint64_t i=0; i < THREAD_TIMERS; i++){
+            std::shared_ptr<Cancellable> cancellable = std::make_shared<Cancellable>();
+            Thread thr([cancellable]{
+                Thread::sleepMs(10);
+                if(cancellable->isCancelled()) return;
+            });
+            thr.start();
+            thr.detach();
+            handles.push_back(cancellable);
+        }
+        for(std::shared_ptr<Cancellable> &handle : handles) handle->cancel();
+        handles.clear();
+    });
+    Thread::sleepMs(50); // let the detached threads finish
+
+    // expiry in batches: many timers per tick run by one advance()
+    TimerWheel manual(std::chrono::milliseconds(1), false);
+    const TimerWheel::time_point start = std::chrono::steady_clock::now();
+    std::atomic<uint64_t> fired{0};
+    uint64_t round = 0;
+    bench.run("TimerWheel schedule+expire (1000 ticks)", TIMERS, [&](){
+        const TimerWheel::time_point base = start + std::chrono::seconds(2) * (round++); // after anything advanced before
+        for(uint64_t i=0; i < TIMERS; i++)
+            manual.scheduleAt(base + std::chrono::milliseconds(i % 1000), [&fired]{ fired.fetch_add(1, std::memory_order_relaxed); });
+        manual.advance(base + std::chrono::seconds(1));
+    });
+    if(manual.size() != 0) std::cout << "  " << manual.size() << " timers did not expire" << std::endl;
+
+    return bench.finish();
+}
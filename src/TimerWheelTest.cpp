@@ -0,0 +1,111 @@
+#include "./utils/Thread.hpp"
+#include "./utils/TimerWheel.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace spi;
+
+
+/**
+ * Advances a wheel without own thread tick by tick and checks that every timer fires exactly at its tick,
+ * including delays that cascade through all levels and delays beyond the span of the wheel.
+ */
+void runExpiryTest(){
+    const std::chrono::milliseconds TICK(1);
+    const TimerWheel::time_point start = std::chrono::steady_clock::now();
+    TimerWheel wheel(TICK, false); // starts slightly later, so a deadline of n ticks after start expires at tick n
+    const std::vector<uint64_t> delays = {0, 1, 2, 255, 256, 257, 1000, 65535, 65536, 65537, 300000, 16777216 + 5,
+                                          TimerWheel::SPAN + 1000};
+    std::vector<uint64_t> fired(delays.size(), 0);
+    uint64_t now = 0; // ticks since start
+    for(size_t i=0; i < delays.size(); i++)
+        wheel.scheduleAt(start + TICK * delays[i], [&, i]{ fired[i] = now; });
+    if(wheel.size() != delays.size()) throw std::runtime_error("ExpiryTest: wheel holds "+std::to_string(wheel.size())+" timers");
+
+    // jump close to every deadline, then step single ticks around it
+    size_t ran = 0;
+    for(uint64_t delay : delays){
+        for(now = delay < 3 ? now : std::max(now, delay - 3); now <= delay + 3; now++)
+            ran += wheel.advance(start + TICK * now + std::chrono::microseconds(500));
+        now--;
+    }
+    if(ran != delays.size() || wheel.size() != 0)
+        throw std::runtime_error("ExpiryTest: "+std::to_string(ran)+" of "+std::to_string(delays.size())+" timers ran");
+    for(size_t i=0; i < delays.size(); i++){
+        if(fired[i] != delays[i])
+            throw std::runtime_error("ExpiryTest: timer of "+std::to_string(delays[i])+" ticks fired at tick "+std::to_string(fired[i]));
+    }
+    std::cout << "Completed ExpiryTest successfully" << std::endl;
+}
+
+
+void runCancelTest(){
+    TimerWheel wheel(std::chrono::milliseconds(1), false);
+    const TimerWheel::time_point start = std::chrono::steady_clock::now();
+    std::atomic<uint64_t> ran{0};
+    std::vector<std::shared_ptr<Cancellable>> handles;
+    for(uint64_t i=0; i < 10000; i++)
+        handles.push_back(wheel.scheduleAt(start + std::chrono::milliseconds(i % 5000), [&]{ ran++; }));
+    for(size_t i=0; i < handles.size(); i += 2) handles[i]->cancel();
+    if(wheel.size() != 5000) throw std::runtime_error("CancelTest: cancelled timers still occupy the wheel");
+    handles[0]->cancel(); // twice does nothing
+
+    // cancelling from within an expiring batch wins against the remaining timers of the batch
+    std::shared_ptr<Cancellable> victim;
+    std::shared_ptr<Cancellable> killer = wheel.scheduleAt(start + std::chrono::milliseconds(6000), [&]{ victim->cancel(); });
+    victim = wheel.scheduleAt(start + std::chrono::milliseconds(6000), [&]{ ran += 1000000; });
+
+    wheel.advance(start + std::chrono::seconds(10));
+    if(ran.load() != 5000 || wheel.size() != 0) throw std::runtime_error("CancelTest: "+std::to_string(ran.load())+" timers ran instead of 5000");
+    if(!victim->isCancelled() || killer->isCancelled()) throw std::runtime_error("CancelTest: wrong timer cancelled");
+    handles[1]->cancel(); // after it ran
+    std::cout << "Completed CancelTest successfully" << std::endl;
+}
+
+
+/**
+ * Timers of a wheel with own thread run roughly on time and never early.
+ */
+void runThreadTest(){
+    TimerWheel wheel(std::chrono::milliseconds(1));
+    const int COUNT = 200;
+    std::atomic<int> ran{0}, early{0};
+    for(int i=0; i < COUNT; i++){
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(i % 50);
+        wheel.scheduleAt(deadline, [&, deadline]{
+            if(std::chrono::steady_clock::now() < deadline) early++;
+            ran++;
+        });
+    }
+    std::shared_ptr<Cancellable> cancelled = wheel.schedule(std::chrono::milliseconds(20), [&]{ early += 1000; });
+    cancelled->cancel();
+    const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while(ran.load() < COUNT && std::chrono::steady_clock::now() < timeout) Thread::sleepMs(1);
+    Thread::sleepMs(30);
+    if(ran.load() != COUNT || early.load() != 0)
+        throw std::runtime_error("ThreadTest: "+std::to_string(ran.load())+" ran, "+std::to_string(early.load())+" early");
+
+    // Thread::runAfter() uses the shared wheel
+    std::atomic<bool> done{false}, skipped{true};
+    Thread::runAfter(5, [&]{ done = true; });
+    Thread::runAfter(5, [&]{ skipped = false; })->cancel();
+    while(!done.load() && std::chrono::steady_clock::now() < timeout) Thread::sleepMs(1);
+    Thread::sleepMs(10);
+    if(!done.load() || !skipped.load()) throw std::runtime_error("ThreadTest: runAfter did not use the wheel correctly");
+    std::cout << "Completed ThreadTest successfully" << std::endl;
+}
+
+
+int main(){
+    runExpiryTest();
+    runCancelTest();
+    runThreadTest();
+    return 0;
+}
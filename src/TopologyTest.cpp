@@ -0,0 +1,82 @@
+#include "./utils/HardwareUtils.hpp"
+#include "./utils/Thread.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace spi;
+
+
+bool contains(const std::vector<size_t> &cpus, size_t cpu){
+    return std::find(cpus.begin(), cpus.end(), cpu) != cpus.end();
+}
+
+
+void runParseTest(){
+    const std::vector<size_t> expected = {0, 1, 2, 3, 8, 10, 11};
+    if(CpuTopology::parseCpuList("0-3,8,10-11") != expected)
+        throw std::runtime_error("CPU list \"0-3,8,10-11\" parsed incorrectly");
+    if(!CpuTopology::parseCpuList("").empty())
+        throw std::runtime_error("Empty CPU list should contain no CPUs");
+    std::cout << "Completed ParseTest successfully" << std::endl;
+}
+
+
+void runTopologyTest(){
+    const CpuTopology &topology = HardwareUtils::getTopology();
+    std::cout << topology.toString();
+    if(topology.getCpus().empty())
+        throw std::runtime_error("Topology should contain at least one CPU");
+    if(&topology != &CpuTopology::get())
+        throw std::runtime_error("Topology should be cached");
+
+    for(const CpuPlacement &p : topology.getCpus()){
+        if(topology.placement(p.cpu) != &p)
+            throw std::runtime_error("Placement lookup of CPU "+std::to_string(p.cpu)+" failed");
+        if(!contains(p.smtSiblings, p.cpu) || (size_t)p.core != p.smtSiblings.front())
+            throw std::runtime_error("CPU "+std::to_string(p.cpu)+" should be part of its own core");
+        const std::vector<size_t> l3 = topology.getCpusSharingL3(p.cpu);
+        if(!contains(l3, p.cpu))
+            throw std::runtime_error("CPU "+std::to_string(p.cpu)+" should share L3 with itself");
+        for(size_t sibling : p.smtSiblings)
+            if(topology.placement(sibling) != nullptr && !contains(l3, sibling))
+                throw std::runtime_error("SMT siblings should share the L3 cache");
+
+        const int picked = topology.pickCpuSharingL3(p.cpu);
+        if(picked >= 0 && (picked == (int)p.cpu || !contains(l3, (size_t)picked)))
+            throw std::runtime_error("Picked CPU "+std::to_string(picked)+" does not share L3 with "+std::to_string(p.cpu));
+        if(picked < 0 && l3.size() > 1)
+            throw std::runtime_error("A CPU sharing L3 with "+std::to_string(p.cpu)+" should have been picked");
+    }
+    if(topology.getPhysicalCores().empty())
+        throw std::runtime_error("Topology should contain at least one physical core");
+    if(HardwareUtils::getCacheLineSize() == 0)
+        throw std::runtime_error("Cache line size should not be zero");
+    std::cout << "Completed TopologyTest successfully" << std::endl;
+}
+
+
+void runPinTest(){
+    Thread producer([]{});
+    producer.setCPU(0);
+    Thread consumer([]{});
+    const int picked = consumer.setCPUSharingL3(0);
+    if(picked != HardwareUtils::getTopology().pickCpuSharingL3(0))
+        throw std::runtime_error("Thread should be bound to the picked CPU");
+    producer.start();
+    consumer.start();
+    producer.join();
+    consumer.join();
+    std::cout << "Completed PinTest successfully" << std::endl;
+}
+
+
+int main(){
+    runParseTest();
+    runTopologyTest();
+    runPinTest();
+    return 0;
+}
@@ -0,0 +1,38 @@
+#include "./utils/Benchmark.hpp"
+#include "./utils/Trace.hpp"
+
+#include <cstdint>
+
+using namespace spi;
+
+
+int main(int argc, char** argv){
+    Benchmark bench("trace_benchmark", argc, argv);
+    const uint64_t ITERATIONS = 50000000;
+    FastClock::calibrate();
+    Tracer::instant("warmup"); // allocates buffer of this thread
+
+    bench.run("Empty loop", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++) Benchmark::doNotOptimize(i);
+    });
+
+    bench.run("TraceScope", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            TraceScope scope("scope");
+            Benchmark::doNotOptimize(i);
+        }
+    });
+
+    bench.run("Tracer::instant()", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++) Tracer::instant("instant");
+    });
+
+    bench.run("SPI_TRACE_SCOPE (SPI_TRACE=" + std::to_string(SPI_TRACE) + ")", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            SPI_TRACE_SCOPE("macro");
+            Benchmark::doNotOptimize(i);
+        }
+    });
+
+    return bench.finish();
+}
@@ -0,0 +1,81 @@
+#include "./utils/Thread.hpp"
+#include "./utils/Trace.hpp"
+
+#include <cstdint>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace spi;
+
+
+size_t countOccurrences(const std::string &text, const std::string &pattern){
+    size_t count = 0;
+    for(size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + pattern.size())) count++;
+    return count;
+}
+
+
+void runSpanTest(){
+    const uint64_t THREADS = 4;
+    const uint64_t ITERATIONS = 100;
+    Tracer::clear();
+
+    std::vector<Thread*> threads;
+    for(uint64_t t=0; t < THREADS; t++){
+        threads.push_back(new Thread([ITERATIONS]{
+            for(uint64_t i=0; i < ITERATIONS; i++){
+                TraceScope outer("outer");
+                TraceScope inner("inner \"quoted\"");
+                Tracer::instant("instant");
+            }
+        }));
+    }
+    for(Thread* thr : threads) thr->start();
+    for(Thread* thr : threads) thr->join();
+    for(Thread* thr : threads) delete thr;
+
+    const std::string json = Tracer::toChromeTraceJson();
+    if(countOccurrences(json, "\"name\":\"outer\",\"ph\":\"B\"") != THREADS * ITERATIONS ||
+       countOccurrences(json, "\"name\":\"outer\",\"ph\":\"E\"") != THREADS * ITERATIONS)
+        throw std::runtime_error("Expected "+std::to_string(THREADS * ITERATIONS)+" outer spans");
+    if(countOccurrences(json, "\"name\":\"inner \\\"quoted\\\"\",\"ph\":\"B\"") != THREADS * ITERATIONS)
+        throw std::runtime_error("Names should be escaped");
+    if(countOccurrences(json, "\"ph\":\"i\"") != THREADS * ITERATIONS)
+        throw std::runtime_error("Expected "+std::to_string(THREADS * ITERATIONS)+" instant events");
+
+    std::set<std::string> tids;
+    for(size_t pos = json.find("\"tid\":"); pos != std::string::npos; pos = json.find("\"tid\":", pos + 1))
+        tids.insert(json.substr(pos + 6, json.find_first_of(",}", pos + 6) - pos - 6));
+    if(tids.size() < 1 || tids.size() > THREADS)
+        throw std::runtime_error("Events should be keyed by thread but found "+std::to_string(tids.size())+" threads");
+    std::cout << "Completed SpanTest successfully" << std::endl;
+}
+
+
+void runOverflowTest(){
+    Tracer::clear();
+    Thread thr([]{
+        Tracer::begin("lost");
+        for(size_t i=0; i < TraceBuffer::SIZE; i++) Tracer::instant("filler");
+        Tracer::end("lost");
+    });
+    thr.start();
+    thr.join();
+
+    const std::string json = Tracer::toChromeTraceJson();
+    if(countOccurrences(json, "\"name\":\"lost\"") != 0)
+        throw std::runtime_error("End event of an overwritten span should be skipped");
+    if(countOccurrences(json, "\"name\":\"filler\"") != TraceBuffer::SIZE - 1) // + end event of "lost"
+        throw std::runtime_error("Ring buffer should keep the latest "+std::to_string(TraceBuffer::SIZE)+" events");
+    std::cout << "Completed OverflowTest successfully" << std::endl;
+}
+
+
+int main(){
+    runSpanTest();
+    runOverflowTest();
+    return 0;
+}
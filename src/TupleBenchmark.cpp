@@ -1,10 +1,21 @@
+#include "./utils/Benchmark.hpp"
+#include "./utils/Flow.hpp"
+#include "./utils/FlowExpression.hpp"
 #include "./utils/FlowRepresentation.hpp"
+#include "./utils/FlowWindowState.hpp"
+#include "./utils/MetricsUtils.hpp"
+#include "./utils/Thread.hpp"
 #include "./utils/Tuple.hpp"
+#include "./utils/TupleBatch.hpp"
+#include "./utils/TupleBuffer.hpp"
 
 #include <chrono>
+#include <cstring>
 #include <cstdint>
 #include <iostream>
 #include <memory>
+#include <string>
+#include <vector>
 
 using namespace spi;
 
@@ -54,64 +65,285 @@ void processTupleShared(std::shared_ptr<Tuple> obj){
 }
 
 
+TupleBuffer createTupleBuffer(TupleBufferPool &pool, uint64_t value){
+    TupleBuffer buffer = pool.acquire(sizeof(Tuple));
+    ::new(static_cast<void*>(buffer.data())) Tuple((uint32_t)value);
+    buffer.resize(sizeof(Tuple));
+    return buffer;
+}
 
-int main(){
-    const uint64_t ITERATIONS = 100000000;
+void processTupleBuffer(TupleBuffer buffer){
+    reinterpret_cast<Tuple*>(buffer.data())->doSomething();
+}
 
 
-    auto input = std::make_unique<FlowInput>();
-    auto output = input->output();
+bool isEven(const Tuple &tuple){
+    return tuple.getValue() % 2 == 0;
+}
 
 
-    // Tuple(&):    ~ 62 Mio/sec
-    auto startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        Tuple tup = createTuple(i);
-        processTuple(tup); // full copy tuple
+/**
+ * Pushes tuples in chunks into a compiled flow and waits until all of them got processed (tuples per second end-to-end).
+ */
+void measureFlow(Benchmark &bench, const std::string &name, uint64_t iterations, ThreadPool &pool, std::unique_ptr<FlowOutput> output,
+                    bool fuse = true, size_t batchSize = Flow::DEFAULT_BATCH_SIZE, size_t capacity = 0){
+    const size_t CHUNK = 4096;
+    Flow flow(std::move(output), pool, batchSize, fuse);
+    flow.setBackpressure(capacity);
+    uint64_t received = 0; // subscribers are called by one worker at a time
+    flow.subscribe([&received](const Tuple&){ received++; });
+    std::vector<Tuple> chunk(CHUNK);
+
+    bench.run(name, iterations, [&](){
+        for(uint64_t i=0; i < iterations; i += CHUNK){
+            const size_t count = (size_t)std::min<uint64_t>(CHUNK, iterations - i);
+            for(size_t j=0; j < count; j++) chunk[j] = Tuple((uint32_t)(i + j));
+            flow.pushBulk(chunk.data(), count);
+        }
+        flow.drain();
+    });
+    std::cout << "  " << flow.getStageCount() << " stages, " << flow.getTuplesOut() << " of " << flow.getTuplesIn() << " tuples reached the output" << std::endl;
+    if(capacity == 0 || flow.getTuplesIn() == 0) return;
+    for(const FlowStageMetrics &metrics : flow.getStageMetrics()){
+        std::cout << "  " << metrics.name << ": " << metrics.stalls << " stalls, "
+                  << (double)metrics.stallNanos / 1e6 << " ms stalled" << std::endl;
     }
-    auto endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "Tuple(&): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+}
+
+
+
+int main(int argc, char** argv){
+    Benchmark bench("tuple_benchmark", argc, argv);
+    const uint64_t ITERATIONS = 100000000;
+
+
+    // Tuple(&):    ~ 62 Mio/sec
+    bench.run("Tuple(&)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            Tuple tup = createTuple(i);
+            processTuple(tup); // full copy tuple
+        }
+    });
 
 
     // Tuple(&&):   ~ 36 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        Tuple tup = createTupleMove(i);
-        processTuple(std::move(tup)); // full copy tuple
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "Tuple(&&): " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("Tuple(&&)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            Tuple tup = createTupleMove(i);
+            processTuple(std::move(tup)); // full copy tuple
+        }
+    });
 
 
     // Tuple*:      ~ 43 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        Tuple *tup = createTuplePtr(i);
-        processTuplePtr(tup); // full copy tuple
-        delete tup;
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "Tuple*: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("Tuple*", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            Tuple *tup = createTuplePtr(i);
+            processTuplePtr(tup); // full copy tuple
+            delete tup;
+        }
+    });
 
 
     // std::unique_ptr<Tuple>: ~ 5.9 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        std::unique_ptr<Tuple> tup = createTupleUnique(i);
-        processTupleUnique(std::move(tup)); // full copy tuple
-    }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "std::unique_ptr<Tuple>: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
+    bench.run("std::unique_ptr<Tuple>", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            std::unique_ptr<Tuple> tup = createTupleUnique(i);
+            processTupleUnique(std::move(tup)); // full copy tuple
+        }
+    });
 
 
     // std::shared_ptr<Tuple>: ~ 3.6 Mio/sec
-    startTime = std::chrono::high_resolution_clock::now();
-    for(uint64_t i=0; i < ITERATIONS; i++){
-        std::shared_ptr<Tuple> tup = createTupleShared(i);
-        processTupleShared(tup); // full copy tuple
+    bench.run("std::shared_ptr<Tuple>", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            std::shared_ptr<Tuple> tup = createTupleShared(i);
+            processTupleShared(tup); // full copy tuple
+        }
+    });
+
+
+    // TupleBuffer: pooled block with intrusive reference count
+    TupleBufferPool bufferPool;
+    bench.run("TupleBuffer (single owner)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            TupleBuffer tup = createTupleBuffer(bufferPool, i);
+            processTupleBuffer(tup); // copy of the handle
+        }
+    });
+    bench.run("TupleBuffer (shared)", ITERATIONS, [&](){
+        for(uint64_t i=0; i < ITERATIONS; i++){
+            TupleBuffer tup = createTupleBuffer(bufferPool, i);
+            tup.share();
+            processTupleBuffer(tup); // copy of the handle
+        }
+    });
+
+    // Variable-size payload handed through input -> filter -> output (copy vs. shared_ptr vs. pooled buffer)
+    std::cout << std::endl;
+    for(size_t payload : {64, 2048, 65536}){
+        const uint64_t iterations = ITERATIONS / (payload >= 65536 ? 1000 : 10);
+        std::vector<unsigned char> source(payload, 42);
+        uint64_t passed = 0;
+        bench.run("Payload " + MetricsUtils::byteSizeToString(payload) + " copy", iterations, [&](){
+            for(uint64_t i=0; i < iterations; i++){
+                std::vector<unsigned char> input(source);
+                input[0] = (unsigned char)i;
+                std::vector<unsigned char> filtered(input); // every hand-off copies
+                if(filtered[0] % 2 != 0) continue;
+                std::vector<unsigned char> output(filtered);
+                passed += output.size();
+            }
+        });
+        bench.run("Payload " + MetricsUtils::byteSizeToString(payload) + " std::shared_ptr", iterations, [&](){
+            for(uint64_t i=0; i < iterations; i++){
+                std::shared_ptr<std::vector<unsigned char>> input = std::make_shared<std::vector<unsigned char>>(source);
+                (*input)[0] = (unsigned char)i;
+                std::shared_ptr<std::vector<unsigned char>> filtered = input;
+                if((*filtered)[0] % 2 != 0) continue;
+                std::shared_ptr<std::vector<unsigned char>> output = filtered;
+                passed += output->size();
+            }
+        });
+        bench.run("Payload " + MetricsUtils::byteSizeToString(payload) + " TupleBuffer", iterations, [&](){
+            for(uint64_t i=0; i < iterations; i++){
+                TupleBuffer input = bufferPool.copyOf(source.data(), payload);
+                input.data()[0] = (unsigned char)i;
+                TupleBuffer filtered = std::move(input);
+                if(filtered.data()[0] % 2 != 0) continue;
+                TupleBuffer output = std::move(filtered);
+                passed += output.size();
+            }
+        });
+        Benchmark::doNotOptimize(passed);
+    }
+
+
+    // Flow (input -> output)
+    ThreadPool pool;
+    measureFlow(bench, "Flow input->output", ITERATIONS / 10, pool, (new FlowInput())->output());
+
+    // Flow (input -> filter -> filter -> output) with a queue between every operator and fused into one stage
+    auto divisibleBy3 = [](const Tuple &t){ return t.getValue() % 3 == 0; };
+    measureFlow(bench, "Flow input->filter->filter->output (unfused)", ITERATIONS / 10, pool,
+                (new FlowInput())->filter(isEven).release()->filter(divisibleBy3).release()->output(), false);
+    measureFlow(bench, "Flow input->filter->filter->output (fused)", ITERATIONS / 10, pool,
+                (new FlowInput())->filter(isEven).release()->filter(divisibleBy3).release()->output());
+    measureFlow(bench, "Flow input->filter(a, b)->output (composed)", ITERATIONS / 10, pool,
+                (new FlowInput())->filter(isEven, divisibleBy3).release()->output());
+
+    // Credit based backpressure (bounded queues between stages)
+    for(size_t capacity : {256, 4096, 65536}){
+        measureFlow(bench, "Flow input->filter->filter->output (unfused, capacity " + std::to_string(capacity) + ")", ITERATIONS / 10, pool,
+                    (new FlowInput())->filter(isEven).release()->filter(divisibleBy3).release()->output(), false, Flow::DEFAULT_BATCH_SIZE, capacity);
+    }
+
+    // Batch size sweep: SIMD column predicate vs. per-tuple predicate
+    std::cout << std::endl << "Column filters use " << TupleBatchKernels::simdName() << std::endl;
+    for(size_t batchSize : {1, 4, 16, 64, 256, 1024, 4096}){
+        const uint64_t iterations = batchSize < 16 ? ITERATIONS / 100 : ITERATIONS / 10;
+        measureFlow(bench, "Flow batch " + std::to_string(batchSize) + " FlowValueRange", iterations, pool,
+                    (new FlowInput())->filter(FlowValueRange{1000, 50000000}).release()->output(), true, batchSize);
+        measureFlow(bench, "Flow batch " + std::to_string(batchSize) + " lambda", iterations, pool,
+                    (new FlowInput())->filter([](const Tuple &t){ return t.getValue() - 1000 <= 50000000 - 1000; }).release()->output(), true, batchSize);
+    }
+
+    // Predicates: hand-written lambda vs. compile time expression vs. runtime bytecode
+    std::cout << std::endl;
+    {
+        using namespace spi::flow;
+        const FlowDynamicExpression field = FlowDynamicExpression::field();
+        auto mixedLambda = [](const Tuple &t){ return t.getValue() % 3 == 0 && t.getValue() < 50000000; };
+        auto mixedTemplate = value % literal<3> == 0 && value < literal<50000000>;
+        const FlowDynamicExpression mixedDynamic = field % 3 == 0 && field < 50000000;
+        auto rangeLambda = [](const Tuple &t){ return t.getValue() >= 1000 && t.getValue() <= 50000000; };
+        auto rangeTemplate = value >= literal<1000> && value <= literal<50000000>;
+        const FlowDynamicExpression rangeDynamic = field >= 1000 && field <= 50000000;
+
+        const size_t COLUMN = 4096;
+        std::vector<uint32_t> column(COLUMN);
+        for(size_t i=0; i < COLUMN; i++) column[i] = (uint32_t)(i * 2654435761u) >> 5;
+        std::vector<uint64_t> selection(COLUMN / 64);
+        auto perTuple = [&](const std::string &name, const auto &expression){
+            bench.run("Expression " + name + " per tuple", ITERATIONS, [&](){
+                uint64_t passed = 0;
+                for(uint64_t i=0; i < ITERATIONS; i += COLUMN){
+                    for(size_t j=0; j < COLUMN; j++) passed += (bool)expression(Tuple(column[j]));
+                }
+                Benchmark::doNotOptimize(passed);
+            });
+        };
+        auto perColumn = [&](const std::string &name, const auto &expression){
+            bench.run("Expression " + name + " column", ITERATIONS, [&](){
+                for(uint64_t i=0; i < ITERATIONS; i += COLUMN){
+                    flowEvaluate(expression, column.data(), COLUMN, selection.data());
+                    Benchmark::doNotOptimize(selection[0]);
+                }
+            });
+        };
+        perTuple("mixed lambda", mixedLambda);
+        perTuple("mixed template", mixedTemplate);
+        perTuple("mixed bytecode", mixedDynamic);
+        perColumn("mixed lambda", mixedLambda);
+        perColumn("mixed template", mixedTemplate);
+        perColumn("mixed bytecode", mixedDynamic);
+        perTuple("range lambda", rangeLambda);
+        perTuple("range template", rangeTemplate);
+        perTuple("range bytecode", rangeDynamic);
+        perColumn("range lambda", rangeLambda);
+        perColumn("range template", rangeTemplate);
+        perColumn("range bytecode", rangeDynamic);
+
+        measureFlow(bench, "Flow expression lambda", ITERATIONS / 10, pool, (new FlowInput())->filter(mixedLambda).release()->output());
+        measureFlow(bench, "Flow expression template", ITERATIONS / 10, pool, (new FlowInput())->filter(mixedTemplate).release()->output());
+        measureFlow(bench, "Flow expression bytecode", ITERATIONS / 10, pool, (new FlowInput())->filter(mixedDynamic).release()->output());
+    }
+
+    // Key partitioned shards (scales with the amount of cores the pool can use)
+    std::cout << std::endl;
+    auto expensive = [](const Tuple &t){
+        uint32_t h = t.getValue();
+        for(int i=0; i < 16; i++) h = h * 2654435761u + 0x9E3779B9u;
+        return (h & 1) == 0;
+    };
+    auto byValue = [](const Tuple &t) -> uint64_t { return t.getValue(); };
+    measureFlow(bench, "Flow expensive filter (1 stage)", ITERATIONS / 10, pool,
+                (new FlowInput())->filter(expensive).release()->output());
+    for(size_t shards : {1, 2, 4, 8}){
+        measureFlow(bench, "Flow partition(" + std::to_string(shards) + ")->expensive filter", ITERATIONS / 10, pool,
+                    (new FlowInput())->partition(byValue, shards).release()->filter(expensive).release()->output());
+        measureFlow(bench, "Flow partition(" + std::to_string(shards) + ", ordered)->expensive filter", ITERATIONS / 10, pool,
+                    (new FlowInput())->partition(byValue, shards, true).release()->filter(expensive).release()->output());
     }
-    endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "std::shared_ptr<Tuple>: " << (ITERATIONS * 1000000) / std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << "/s" << std::endl;
 
-    return 0;
+    // Windowed state: 10 tuples per millisecond, sliding windows of 1000ms that advance every 10ms
+    std::cout << std::endl;
+    const uint64_t WINDOW_TUPLES = ITERATIONS / 10;
+    FlowWindowAggregation<FlowSum> aggregation(FlowWindow(FlowWindowType::TIME_BASED, 1000, 10));
+    uint64_t windows = 0, tick = 0; // time keeps advancing over repetitions
+    bench.run("FlowWindowAggregation sliding sum (1000ms / 10ms)", WINDOW_TUPLES, [&](){
+        for(uint64_t i=0; i < WINDOW_TUPLES; i++, tick++){
+            const uint64_t time = tick / 10;
+            if(i % 10 == 0) aggregation.advance(time, [&](uint64_t, uint64_t, const uint64_t &sum){ windows++; Benchmark::doNotOptimize(sum); });
+            aggregation.add(Tuple((uint32_t)i), time);
+        }
+    });
+    std::cout << "  " << windows << " windows emitted, " << MetricsUtils::byteSizeToString(aggregation.getMemoryUsage()) << " of panes" << std::endl;
+
+    auto joinKey = [](const Tuple &t) -> uint64_t { return t.getValue() % 4096; };
+    FlowJoinState<decltype(joinKey)> join(FlowWindow(FlowWindowType::TIME_BASED, 100, 10), joinKey);
+    uint64_t matches = 0;
+    tick = 0;
+    bench.run("FlowJoinState sliding time join (100ms, 4096 keys)", WINDOW_TUPLES, [&](){
+        for(uint64_t i=0; i < WINDOW_TUPLES; i++, tick++){
+            const uint64_t time = tick / 10;
+            if(tick % 1000 == 0) join.advance(time);
+            join.add(tick % 2 == 0 ? FlowJoinSide::LEFT : FlowJoinSide::RIGHT, Tuple((uint32_t)((tick / 2) * 2654435761u)), time,
+                     [&](const Tuple&, const Tuple&){ matches++; });
+        }
+    });
+    std::cout << "  " << matches << " matches, " << join.getBufferedTuples() << " tuples buffered in "
+              << MetricsUtils::byteSizeToString(join.getMemoryUsage()) << std::endl;
+
+    return bench.finish();
 }
\ No newline at end of file
@@ -0,0 +1,181 @@
+#include "./utils/QueueMoodyCamel.hpp"
+#include "./utils/TupleBuffer.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+using namespace spi;
+
+
+
+void runSizeClassTest(){
+    TupleBufferPool pool;
+    const size_t sizes[] = {0, 1, 63, 64, 65, 2048, 2049, 1 << 20, TupleBufferPool::getMaxPooledSize()};
+    for(size_t size : sizes){
+        TupleBuffer buffer = pool.acquire(size);
+        if(buffer.getCapacity() < size || buffer.size() != 0 || !buffer.isPooled() || buffer.useCount() != 1)
+            throw std::runtime_error("Buffer of "+std::to_string(size)+" bytes has capacity "+std::to_string(buffer.getCapacity()));
+        if(size > SPI_TUPLE_BUFFER_MIN_SIZE && buffer.getCapacity() >= 2 * size)
+            throw std::runtime_error("Buffer of "+std::to_string(size)+" bytes got a too large size class");
+        if(((uintptr_t)buffer.data() % CACHE_LINE_SIZE) != 0)
+            throw std::runtime_error("Payload of "+std::to_string(size)+" bytes not aligned to cache line");
+    }
+
+    // larger buffers are not pooled
+    TupleBuffer large = pool.acquire(TupleBufferPool::getMaxPooledSize() + 1);
+    if(large.isPooled() || large.getCapacity() != TupleBufferPool::getMaxPooledSize() + 1)
+        throw std::runtime_error("Oversized buffer should not be pooled");
+
+    bool thrown = false;
+    try { large.resize(large.getCapacity() + 1); } catch(const std::length_error&){ thrown = true; }
+    if(!thrown) throw std::runtime_error("Resizing beyond capacity should throw");
+
+    thrown = false;
+    try { pool.reserve(TupleBufferPool::getMaxPooledSize() + 1, 1); } catch(const std::invalid_argument&){ thrown = true; }
+    if(!thrown) throw std::runtime_error("Reserving unpooled size should throw");
+    std::cout << "Completed SizeClassTest successfully" << std::endl;
+}
+
+
+void runRecycleTest(){
+    TupleBufferPool pool;
+    pool.reserve(2048, 8);
+    std::unordered_set<const unsigned char*> payloads;
+    std::vector<TupleBuffer> buffers;
+    for(int i=0; i < 8; i++){
+        buffers.push_back(pool.acquire(2048));
+        payloads.insert(buffers.back().data());
+    }
+    buffers.clear();
+
+    // warm pool hands out the same payloads again
+    for(int round=0; round < 100; round++){
+        TupleBuffer buffer = pool.acquire(2000);
+        if(payloads.find(buffer.data()) == payloads.end())
+            throw std::runtime_error("Warm pool allocated a new payload");
+        if(buffer.size() != 0 || buffer.isShared())
+            throw std::runtime_error("Recycled buffer was not reset");
+        buffer.resize(2000);
+        buffer.share();
+    }
+
+    // handles
+    TupleBuffer a = pool.copyOf("hello", 5);
+    TupleBuffer b = a;
+    if(a.useCount() != 2 || !(a == b)) throw std::runtime_error("Copy should reference the same buffer");
+    TupleBuffer c = std::move(b);
+    if(b || a.useCount() != 2) throw std::runtime_error("Move should transfer the reference");
+    c.detach();
+    if(a == c || a.useCount() != 1 || c.useCount() != 1 || std::memcmp(c.data(), "hello", 5) != 0 || c.size() != 5)
+        throw std::runtime_error("Detach should copy the payload");
+    c.data()[0] = 'j';
+    if(a.data()[0] != 'h') throw std::runtime_error("Detached buffer modified the original");
+    const unsigned char* before = c.data();
+    c.detach();
+    if(c.data() != before) throw std::runtime_error("Detaching a unique buffer should not copy");
+    a = c;
+    a.reset();
+    if(a || c.useCount() != 1) throw std::runtime_error("Reset should drop the reference");
+    std::cout << "Completed RecycleTest successfully" << std::endl;
+}
+
+
+/**
+ * Producer -> filter -> consumer with a single owner per buffer (plain reference counts).
+ */
+void runHandOffTest(){
+    const uint64_t COUNT = 200000;
+    TupleBufferPool pool;
+    moodycamel::ConcurrentQueue<TupleBuffer> filtered, output;
+    uint64_t received = 0, sum = 0;
+
+    std::thread producer([&](){
+        for(uint64_t i=0; i < COUNT; i++){
+            TupleBuffer buffer = pool.acquire(256 + (i % 1024));
+            buffer.resize(sizeof(uint64_t));
+            std::memcpy(buffer.data(), &i, sizeof(uint64_t));
+            filtered.enqueue(std::move(buffer));
+        }
+    });
+    std::thread filter([&](){
+        TupleBuffer buffer;
+        for(uint64_t i=0; i < COUNT;){
+            if(!filtered.try_dequeue(buffer)) continue;
+            i++;
+            uint64_t value;
+            std::memcpy(&value, buffer.data(), sizeof(uint64_t));
+            if(value % 2 == 0) output.enqueue(std::move(buffer));
+            else buffer.reset(); // dropped by the filter, returns to the pool of this thread
+        }
+    });
+    TupleBuffer buffer;
+    while(received < COUNT / 2){
+        if(!output.try_dequeue(buffer)) continue;
+        if(buffer.useCount() != 1 || buffer.isShared()) throw std::runtime_error("Hand-off should keep a single owner");
+        uint64_t value;
+        std::memcpy(&value, buffer.data(), sizeof(uint64_t));
+        sum += value;
+        received++;
+        buffer.reset();
+    }
+    producer.join();
+    filter.join();
+    if(sum != (COUNT / 2) * (COUNT / 2 - 1))
+        throw std::runtime_error("HandOffTest expected sum "+std::to_string((COUNT / 2) * (COUNT / 2 - 1))+" but got "+std::to_string(sum));
+    std::cout << "Completed HandOffTest successfully" << std::endl;
+}
+
+
+/**
+ * One buffer fans out to several consumers that drop their handles concurrently (atomic reference counts).
+ */
+void runFanOutTest(){
+    const int CONSUMERS = 4;
+    const uint64_t COUNT = 50000;
+    TupleBufferPool pool;
+    std::vector<moodycamel::ConcurrentQueue<TupleBuffer>> queues(CONSUMERS);
+    std::vector<uint64_t> sums(CONSUMERS, 0);
+    std::vector<std::thread> consumers;
+    for(int c=0; c < CONSUMERS; c++){
+        consumers.emplace_back([&, c](){
+            TupleBuffer buffer;
+            for(uint64_t i=0; i < COUNT;){
+                if(!queues[(size_t)c].try_dequeue(buffer)) continue;
+                if(!buffer.isShared()) throw std::runtime_error("Fanned out buffer should be shared");
+                uint64_t value;
+                std::memcpy(&value, buffer.data(), sizeof(uint64_t));
+                sums[(size_t)c] += value;
+                buffer.reset();
+                i++;
+            }
+        });
+    }
+    for(uint64_t i=0; i < COUNT; i++){
+        TupleBuffer buffer = pool.acquire(4096);
+        buffer.resize(sizeof(uint64_t));
+        std::memcpy(buffer.data(), &i, sizeof(uint64_t));
+        buffer.share();
+        for(int c=0; c < CONSUMERS; c++) queues[(size_t)c].enqueue(TupleBuffer(buffer));
+    }
+    for(std::thread &consumer : consumers) consumer.join();
+    for(uint64_t sum : sums){
+        if(sum != COUNT * (COUNT - 1) / 2)
+            throw std::runtime_error("FanOutTest expected sum "+std::to_string(COUNT * (COUNT - 1) / 2)+" but got "+std::to_string(sum));
+    }
+    std::cout << "Completed FanOutTest successfully" << std::endl;
+}
+
+
+int main(){
+    runSizeClassTest();
+    runRecycleTest();
+    runHandOffTest();
+    runFanOutTest();
+    return 0;
+}
@@ -11,17 +11,66 @@
 #include "Lock.hpp"
 
 #include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
 
 namespace spi {
 
 
+/**
+ * Non-virtual helpers shared by all atomic implementations.
+ * Implementations derive from it directly if they are used without the AbstractAtomic interface (no vtable).
+ * 
+ * @tparam T Type of value the atomic variable should store.
+ */
+template<typename T>
+class AtomicOperations {
+protected:
+
+    static constexpr bool addable = requires(const T &a, const T &b){ { a + b } -> std::convertible_to<T>; };
+    static constexpr bool subtractable = requires(const T &a, const T &b){ { a - b } -> std::convertible_to<T>; };
+
+    /** Throws std::logic_error if T has no operator+ (e.g. snapshot structs). Call before locking. */
+    static inline void requireAddition(){
+        if constexpr (!addable) throw std::logic_error("Atomic: type does not support addition");
+    }
+
+    /** Throws std::logic_error if T has no operator-. Call before locking. */
+    static inline void requireSubtraction(){
+        if constexpr (!subtractable) throw std::logic_error("Atomic: type does not support subtraction");
+    }
+
+    /** Returns a + b (requireAddition() needs to be called before). */
+    static inline T add(const T &a, const T &b) noexcept {
+        if constexpr (addable) return a + b;
+        else return a;
+    }
+
+    /** Returns a - b (requireSubtraction() needs to be called before). */
+    static inline T sub(const T &a, const T &b) noexcept {
+        if constexpr (subtractable) return a - b;
+        else return a;
+    }
+
+    /** Compares with operator== or bytewise if T has none (same as std::atomic). */
+    static inline bool equal(const T &a, const T &b) noexcept {
+        if constexpr (requires { { a == b } -> std::convertible_to<bool>; }) return a == b;
+        else return std::memcmp(&a, &b, sizeof(T)) == 0;
+    }
+};
+
+
+
 /**
  * Abstract class for an atomic variable.
  * 
  * @tparam T Type of value the atomic variable should store.
  */
 template<typename T>
-class AbstractAtomic {
+class AbstractAtomic : public AtomicOperations<T> {
 public:
 
     virtual ~AbstractAtomic() = default;
@@ -203,12 +252,35 @@ public:
  * Fully thread-safe high performance version of a std::atomic.
  * 
  * @tparam T Type of value the atomic variable should store.
+ * @tparam Base AbstractAtomic<T> for virtual dispatch or AtomicOperations<T> for a class without vtable.
  */
-template<typename T>
-class AtomicThreadSafe : public AbstractAtomic<T> {
+template<typename T, typename Base = AbstractAtomic<T>>
+class AtomicThreadSafe : public Base {
 protected:
     std::atomic<T> atomic;
 
+    inline T fetchAdd(T value, std::memory_order order){
+        if constexpr (requires { atomic.fetch_add(value, order); }){
+            return atomic.fetch_add(value, order);
+        } else {
+            AtomicOperations<T>::requireAddition();
+            T current = atomic.load(std::memory_order_relaxed);
+            while(!atomic.compare_exchange_weak(current, AtomicOperations<T>::add(current, value), order));
+            return current;
+        }
+    }
+
+    inline T fetchSub(T value, std::memory_order order){
+        if constexpr (requires { atomic.fetch_sub(value, order); }){
+            return atomic.fetch_sub(value, order);
+        } else {
+            AtomicOperations<T>::requireSubtraction();
+            T current = atomic.load(std::memory_order_relaxed);
+            while(!atomic.compare_exchange_weak(current, AtomicOperations<T>::sub(current, value), order));
+            return current;
+        }
+    }
+
 public:
 
     /**
@@ -223,59 +295,59 @@ public:
      */
     AtomicThreadSafe(T value) : atomic(value) {}
 
-    inline void storeA(T value, std::memory_order order = std::memory_order_seq_cst) override {
+    inline void storeA(T value, std::memory_order order = std::memory_order_seq_cst) {
         atomic.store(value, order);
     }
 
-    inline void storeB(T value, std::memory_order order = std::memory_order_seq_cst) override {
+    inline void storeB(T value, std::memory_order order = std::memory_order_seq_cst) {
         atomic.store(value, order);
     }
 
-    inline T loadA(std::memory_order order = std::memory_order_seq_cst) override {
+    inline T loadA(std::memory_order order = std::memory_order_seq_cst) {
         return atomic.load(order);
     }
 
-    inline T loadB(std::memory_order order = std::memory_order_seq_cst) override {
+    inline T loadB(std::memory_order order = std::memory_order_seq_cst) {
         return atomic.load(order);
     }
 
-    inline T fetchAddA(T value, std::memory_order order = std::memory_order_seq_cst) override {
-        return atomic.fetch_add(value, order);
+    inline T fetchAddA(T value, std::memory_order order = std::memory_order_seq_cst) {
+        return fetchAdd(value, order);
     }
 
-    inline T fetchAddB(T value, std::memory_order order = std::memory_order_seq_cst) override {
-        return atomic.fetch_add(value, order);
+    inline T fetchAddB(T value, std::memory_order order = std::memory_order_seq_cst) {
+        return fetchAdd(value, order);
     }
 
-    inline T fetchSubA(T value, std::memory_order order = std::memory_order_seq_cst) override {
-        return atomic.fetch_sub(value, order);
+    inline T fetchSubA(T value, std::memory_order order = std::memory_order_seq_cst) {
+        return fetchSub(value, order);
     }
 
-    inline T fetchSubB(T value, std::memory_order order = std::memory_order_seq_cst) override {
-        return atomic.fetch_sub(value, order);
+    inline T fetchSubB(T value, std::memory_order order = std::memory_order_seq_cst) {
+        return fetchSub(value, order);
     }
 
-    inline T exchangeA(T value, std::memory_order order = std::memory_order_seq_cst) override {
+    inline T exchangeA(T value, std::memory_order order = std::memory_order_seq_cst) {
         return atomic.exchange(value, order);
     }
 
-    inline T exchangeB(T value, std::memory_order order = std::memory_order_seq_cst) override {
+    inline T exchangeB(T value, std::memory_order order = std::memory_order_seq_cst) {
         return atomic.exchange(value, order);
     }
 
-    inline bool compareExchangeStrongA(T expected, T desired, std::memory_order order = std::memory_order_seq_cst) override {
+    inline bool compareExchangeStrongA(T expected, T desired, std::memory_order order = std::memory_order_seq_cst) {
         return atomic.compare_exchange_strong(expected, desired, order);
     }
 
-    inline bool compareExchangeStrongB(T expected, T desired, std::memory_order order = std::memory_order_seq_cst) override {
+    inline bool compareExchangeStrongB(T expected, T desired, std::memory_order order = std::memory_order_seq_cst) {
         return atomic.compare_exchange_strong(expected, desired, order);
     }
 
-    inline bool compareExchangeWeakA(T expected, T desired, std::memory_order order = std::memory_order_seq_cst) override {
+    inline bool compareExchangeWeakA(T expected, T desired, std::memory_order order = std::memory_order_seq_cst) {
         return atomic.compare_exchange_weak(expected, desired, order);
     }
 
-    inline bool compareExchangeWeakB(T expected, T desired, std::memory_order order = std::memory_order_seq_cst) override {
+    inline bool compareExchangeWeakB(T expected, T desired, std::memory_order order = std::memory_order_seq_cst) {
         return atomic.compare_exchange_weak(expected, desired, order);
     }
 
@@ -290,9 +362,10 @@ public:
  * and at most one thread accesses the atomic variable as group B.
  * 
  * @tparam T Type of value the atomic variable should store.
+ * @tparam Base AbstractAtomic<T> for virtual dispatch or AtomicOperations<T> for a class without vtable.
  */
-template<typename T>
-class AtomicTwoParty : public AbstractAtomic<T> {
+template<typename T, typename Base = AbstractAtomic<T>>
+class AtomicTwoParty : public Base {
 protected:
     T value;
     ReadOrWriteAccess lock;
@@ -324,21 +397,21 @@ public:
 
     }
 
-    inline void storeA(T value, std::memory_order order = std::memory_order_seq_cst) override {
+    inline void storeA(T value, std::memory_order order = std::memory_order_seq_cst) {
         (void)order;
         lock.accessRead();
         this->value = value;
         lock.releaseRead();
     }
 
-    inline void storeB(T value, std::memory_order order = std::memory_order_seq_cst) override {
+    inline void storeB(T value, std::memory_order order = std::memory_order_seq_cst) {
         (void)order;
         lock.accessWrite();
         this->value = value;
         lock.releaseWrite();
     }
 
-    inline T loadA(std::memory_order order = std::memory_order_seq_cst) override {
+    inline T loadA(std::memory_order order = std::memory_order_seq_cst) {
         (void)order;
         lock.accessRead();
         T tmp = value;
@@ -346,7 +419,7 @@ public:
         return tmp;
     }
 
-    inline T loadB(std::memory_order order = std::memory_order_seq_cst) override {
+    inline T loadB(std::memory_order order = std::memory_order_seq_cst) {
         (void)order;
         lock.accessWrite();
         T tmp = value;
@@ -354,43 +427,47 @@ public:
         return tmp;
     }
 
-    inline T fetchAddA(T value, std::memory_order order = std::memory_order_seq_cst) override {
+    inline T fetchAddA(T value, std::memory_order order = std::memory_order_seq_cst) {
         (void)order;
+        AtomicOperations<T>::requireAddition();
         lock.accessRead();
         T tmp = this->value;
-        this->value = this->value + value;
+        this->value = AtomicOperations<T>::add(this->value, value);
         lock.releaseRead();
         return tmp;
     }
 
-    inline T fetchAddB(T value, std::memory_order order = std::memory_order_seq_cst) override {
+    inline T fetchAddB(T value, std::memory_order order = std::memory_order_seq_cst) {
         (void)order;
+        AtomicOperations<T>::requireAddition();
         lock.accessWrite();
         T tmp = this->value;
-        this->value = this->value + value;
+        this->value = AtomicOperations<T>::add(this->value, value);
         lock.releaseWrite();
         return tmp;
     }
 
-    inline T fetchSubA(T value, std::memory_order order = std::memory_order_seq_cst) override {
+    inline T fetchSubA(T value, std::memory_order order = std::memory_order_seq_cst) {
         (void)order;
+        AtomicOperations<T>::requireSubtraction();
         lock.accessRead();
         T tmp = this->value;
-        this->value = this->value - value;
+        this->value = AtomicOperations<T>::sub(this->value, value);
         lock.releaseRead();
         return tmp;
     }
 
-    inline T fetchSubB(T value, std::memory_order order = std::memory_order_seq_cst) override {
+    inline T fetchSubB(T value, std::memory_order order = std::memory_order_seq_cst) {
         (void)order;
+        AtomicOperations<T>::requireSubtraction();
         lock.accessWrite();
         T tmp = this->value;
-        this->value = this->value - value;
+        this->value = AtomicOperations<T>::sub(this->value, value);
         lock.releaseWrite();
         return tmp;
     }
 
-    inline T exchangeA(T value, std::memory_order order = std::memory_order_seq_cst) override {
+    inline T exchangeA(T value, std::memory_order order = std::memory_order_seq_cst) {
         (void)order;
         lock.accessRead();
         T tmp = this->value;
@@ -399,7 +476,7 @@ public:
         return tmp;
     }
 
-    inline T exchangeB(T value, std::memory_order order = std::memory_order_seq_cst) override {
+    inline T exchangeB(T value, std::memory_order order = std::memory_order_seq_cst) {
         (void)order;
         lock.accessWrite();
         T tmp = this->value;
@@ -408,10 +485,10 @@ public:
         return tmp;
     }
 
-    inline bool compareExchangeStrongA(T expected, T desired, std::memory_order order = std::memory_order_seq_cst) override {
+    inline bool compareExchangeStrongA(T expected, T desired, std::memory_order order = std::memory_order_seq_cst) {
         (void)order;
         lock.accessRead();
-        if(this->value == expected){
+        if(AtomicOperations<T>::equal(this->value, expected)){
             this->value = desired;
             lock.releaseRead();
             return true;
@@ -420,10 +497,10 @@ public:
         return false;
     }
 
-    inline bool compareExchangeStrongB(T expected, T desired, std::memory_order order = std::memory_order_seq_cst) override {
+    inline bool compareExchangeStrongB(T expected, T desired, std::memory_order order = std::memory_order_seq_cst) {
         (void)order;
         lock.accessWrite();
-        if(this->value == expected){
+        if(AtomicOperations<T>::equal(this->value, expected)){
             this->value = desired;
             lock.releaseWrite();
             return true;
@@ -432,10 +509,10 @@ public:
         return false;
     }
 
-    inline bool compareExchangeWeakA(T expected, T desired, std::memory_order order = std::memory_order_seq_cst) override {
+    inline bool compareExchangeWeakA(T expected, T desired, std::memory_order order = std::memory_order_seq_cst) {
         (void)order;
         lock.accessRead();
-        if(this->value == expected){
+        if(AtomicOperations<T>::equal(this->value, expected)){
             this->value = desired;
             lock.releaseRead();
             return true;
@@ -444,10 +521,10 @@ public:
         return false;
     }
 
-    inline bool compareExchangeWeakB(T expected, T desired, std::memory_order order = std::memory_order_seq_cst) override {
+    inline bool compareExchangeWeakB(T expected, T desired, std::memory_order order = std::memory_order_seq_cst) {
         (void)order;
         lock.accessWrite();
-        if(this->value == expected){
+        if(AtomicOperations<T>::equal(this->value, expected)){
             this->value = desired;
             lock.releaseWrite();
             return true;
@@ -462,17 +539,288 @@ public:
 
 
 /**
- * High performance version of a std::atomic that combines the AtomicThreadSafe and AtomicTwoParty into one class.
+ * Atomic variable protected by a sequence lock, intended for trivially copyable
+ * snapshot types that are too big for lock-free std::atomic (e.g. 32-256 bytes of statistics).
+ *
+ * A writer makes the sequence counter odd, copies the value and makes the counter even again.
+ * Readers copy the value and retry if the counter was odd or changed in the meantime,
+ * therefore readers never write shared memory and never block writers.
+ * Writers are serialized through the sequence counter (any amount of threads in both groups).
+ * The value is stored as relaxed atomic words so concurrent copies are well defined.
+ *
+ * @tparam T Type of value the atomic variable should store (must be trivially copyable).
+ * @tparam Base AbstractAtomic<T> for virtual dispatch or AtomicOperations<T> for a class without vtable.
+ */
+template<typename T, typename Base = AbstractAtomic<T>>
+class AtomicSeqLock : public Base {
+    static_assert(std::is_trivially_copyable_v<T>, "AtomicSeqLock requires a trivially copyable type");
+
+protected:
+    static constexpr size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    static constexpr uint32_t SPINS = 128; // spin iterations before yielding
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> sequence{0};
+    std::atomic<uint64_t> words[WORDS];
+
+    static inline void backoff(uint32_t &spins) noexcept {
+        if(spins < SPINS){
+            cpuRelax();
+            spins++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    /** Copies the words without synchronization (caller validates sequence or holds write lock). */
+    inline T read() const noexcept {
+        uint64_t buffer[WORDS];
+        for(size_t i=0; i < WORDS; i++) buffer[i] = words[i].load(std::memory_order_relaxed);
+        T value;
+        std::memcpy(&value, buffer, sizeof(T));
+        return value;
+    }
+
+    /** Copies value into the words (caller holds write lock). */
+    inline void write(const T &value) noexcept {
+        uint64_t buffer[WORDS] = {};
+        std::memcpy(buffer, &value, sizeof(T));
+        for(size_t i=0; i < WORDS; i++) words[i].store(buffer[i], std::memory_order_relaxed);
+    }
+
+    /** Makes the sequence odd (excludes other writers and makes readers retry). */
+    inline uint64_t lockWrite() noexcept {
+        uint32_t spins = 0;
+        uint64_t current = sequence.load(std::memory_order_relaxed);
+        while(true){
+            if((current & 1) == 0 && sequence.compare_exchange_weak(current, current + 1, std::memory_order_acquire, std::memory_order_relaxed)){
+                std::atomic_thread_fence(std::memory_order_release); // odd sequence visible before data changes
+                return current;
+            }
+            backoff(spins);
+            current = sequence.load(std::memory_order_relaxed);
+        }
+    }
+
+    inline void unlockWrite(uint64_t previous) noexcept {
+        sequence.store(previous + 2, std::memory_order_release);
+    }
+
+    inline T load() const noexcept {
+        uint32_t spins = 0;
+        while(true){
+            const uint64_t before = sequence.load(std::memory_order_acquire);
+            if((before & 1) == 0){
+                const T value = read();
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if(sequence.load(std::memory_order_relaxed) == before) return value;
+            }
+            backoff(spins);
+        }
+    }
+
+    inline void store(const T &value) noexcept {
+        const uint64_t previous = lockWrite();
+        write(value);
+        unlockWrite(previous);
+    }
+
+    inline T exchange(const T &value) noexcept {
+        const uint64_t previous = lockWrite();
+        const T old = read();
+        write(value);
+        unlockWrite(previous);
+        return old;
+    }
+
+    inline T fetchAdd(const T &value){
+        AtomicOperations<T>::requireAddition();
+        const uint64_t previous = lockWrite();
+        const T old = read();
+        write(AtomicOperations<T>::add(old, value));
+        unlockWrite(previous);
+        return old;
+    }
+
+    inline T fetchSub(const T &value){
+        AtomicOperations<T>::requireSubtraction();
+        const uint64_t previous = lockWrite();
+        const T old = read();
+        write(AtomicOperations<T>::sub(old, value));
+        unlockWrite(previous);
+        return old;
+    }
+
+    inline bool compareExchange(const T &expected, const T &desired) noexcept {
+        if(!AtomicOperations<T>::equal(load(), expected)) return false; // fail without writing shared memory
+        const uint64_t previous = lockWrite();
+        const bool matches = AtomicOperations<T>::equal(read(), expected);
+        if(matches) write(desired);
+        unlockWrite(previous);
+        return matches;
+    }
+
+public:
+
+    /**
+     * Create a new AtomicSeqLock with a value initialized value.
+     */
+    AtomicSeqLock() : AtomicSeqLock(T{}) {}
+
+    /**
+     * Create a new AtomicSeqLock with an initial value.
+     * 
+     * @param value Initial value.
+     */
+    AtomicSeqLock(T value){
+        write(value);
+    }
+
+    inline void storeA(T value, std::memory_order order = std::memory_order_seq_cst) {
+        (void)order;
+        store(value);
+    }
+
+    inline void storeB(T value, std::memory_order order = std::memory_order_seq_cst) {
+        (void)order;
+        store(value);
+    }
+
+    inline T loadA(std::memory_order order = std::memory_order_seq_cst) {
+        (void)order;
+        return load();
+    }
+
+    inline T loadB(std::memory_order order = std::memory_order_seq_cst) {
+        (void)order;
+        return load();
+    }
+
+    inline T fetchAddA(T value, std::memory_order order = std::memory_order_seq_cst) {
+        (void)order;
+        return fetchAdd(value);
+    }
+
+    inline T fetchAddB(T value, std::memory_order order = std::memory_order_seq_cst) {
+        (void)order;
+        return fetchAdd(value);
+    }
+
+    inline T fetchSubA(T value, std::memory_order order = std::memory_order_seq_cst) {
+        (void)order;
+        return fetchSub(value);
+    }
+
+    inline T fetchSubB(T value, std::memory_order order = std::memory_order_seq_cst) {
+        (void)order;
+        return fetchSub(value);
+    }
+
+    inline T exchangeA(T value, std::memory_order order = std::memory_order_seq_cst) {
+        (void)order;
+        return exchange(value);
+    }
+
+    inline T exchangeB(T value, std::memory_order order = std::memory_order_seq_cst) {
+        (void)order;
+        return exchange(value);
+    }
+
+    inline bool compareExchangeStrongA(T expected, T desired, std::memory_order order = std::memory_order_seq_cst) {
+        (void)order;
+        return compareExchange(expected, desired);
+    }
+
+    inline bool compareExchangeStrongB(T expected, T desired, std::memory_order order = std::memory_order_seq_cst) {
+        (void)order;
+        return compareExchange(expected, desired);
+    }
+
+    inline bool compareExchangeWeakA(T expected, T desired, std::memory_order order = std::memory_order_seq_cst) {
+        (void)order;
+        return compareExchange(expected, desired);
+    }
+
+    inline bool compareExchangeWeakB(T expected, T desired, std::memory_order order = std::memory_order_seq_cst) {
+        (void)order;
+        return compareExchange(expected, desired);
+    }
+};
+
+
+
+
+
+/**
+ * Implementations the Atomic facade can use.
+ */
+enum class AtomicBackend {
+    /** AtomicThreadSafe (std::atomic). */
+    THREAD_SAFE,
+
+    /** AtomicTwoParty (at most one thread per group). */
+    TWO_PARTY,
+
+    /** AtomicSeqLock (wide trivially copyable types, readers never write shared memory). */
+    SEQLOCK
+};
+
+
+
+/** Atomic selects the implementation at runtime (AtomicBackend passed to the constructor). */
+struct AtomicPolicyRuntime {};
+
+/** Atomic uses AtomicThreadSafe (selected at compile time). */
+struct AtomicPolicyThreadSafe {
+    template<typename T> using Backend = AtomicThreadSafe<T, AtomicOperations<T>>;
+};
+
+/** Atomic uses AtomicTwoParty (selected at compile time). */
+struct AtomicPolicyTwoParty {
+    template<typename T> using Backend = AtomicTwoParty<T, AtomicOperations<T>>;
+};
+
+/** Atomic uses AtomicSeqLock (selected at compile time). */
+struct AtomicPolicySeqLock {
+    template<typename T> using Backend = AtomicSeqLock<T, AtomicOperations<T>>;
+};
+
+
+
+/**
+ * High performance version of a std::atomic whose implementation is selected at compile time.
+ * Has no vtable and the size of the selected implementation, all calls get inlined.
+ * Takes the same constructor arguments as the selected implementation.
+ * 
+ * Use AtomicPolicyRuntime (default) if the implementation is only known at runtime.
+ * 
+ * @tparam T Type of value the atomic variable should store.
+ * @tparam Policy AtomicPolicyThreadSafe, AtomicPolicyTwoParty, AtomicPolicySeqLock or AtomicPolicyRuntime.
+ */
+template<typename T, typename Policy = AtomicPolicyRuntime>
+class Atomic : public Policy::template Backend<T> {
+    typedef typename Policy::template Backend<T> Backend;
+
+public:
+    using Backend::Backend;
+};
+
+
+
+/**
+ * High performance version of a std::atomic that combines the AtomicThreadSafe, AtomicTwoParty and AtomicSeqLock into one class
+ * and selects the implementation at runtime.
+ * The AtomicSeqLock is only allocated if AtomicBackend::SEQLOCK gets selected (its cache line alignment would bloat every other Atomic).
  * 
  * @tparam T Type of value the atomic variable should store.
  */
 template<typename T>
-class Atomic : public AbstractAtomic<T> {
+class Atomic<T, AtomicPolicyRuntime> : public AbstractAtomic<T> {
 protected:
     // AbstractAtomic<T> *atomic; // massive performance drop!
-    AtomicThreadSafe<T> atomicThreadSafe;
-    AtomicTwoParty<T> atomicTwoParty;
-    const bool multithreaded;
+    AtomicThreadSafe<T, AtomicOperations<T>> atomicThreadSafe;
+    AtomicTwoParty<T, AtomicOperations<T>> atomicTwoParty;
+    std::unique_ptr<AtomicSeqLock<T, AtomicOperations<T>>> atomicSeqLock; // nullptr unless backend is SEQLOCK
+    const AtomicBackend backend;
 
 public:
 
@@ -482,7 +830,8 @@ public:
      * @param reduceCpuUsage If true the object will use less cpu resources but will be slower.
      * @param multithreaded Set to true if there are multiple threads in group A or multiple threads in group B (if only one per group set to false).
      */
-    Atomic(bool reduceCpuUsage, bool multithreaded) : atomicThreadSafe(), atomicTwoParty(reduceCpuUsage), multithreaded(multithreaded) {
+    Atomic(bool reduceCpuUsage, bool multithreaded) : atomicThreadSafe(), atomicTwoParty(reduceCpuUsage),
+            backend(multithreaded ? AtomicBackend::THREAD_SAFE : AtomicBackend::TWO_PARTY) {
         
     }
 
@@ -493,119 +842,143 @@ public:
      * @param multithreaded Set to true if there are multiple threads in group A or multiple threads in group B (if only one per group set to false).
      * @param value Initial value.
      */
-    Atomic(bool reduceCpuUsage, bool multithreaded, T value) : atomicThreadSafe(value), atomicTwoParty(reduceCpuUsage, value), multithreaded(multithreaded) {
+    Atomic(bool reduceCpuUsage, bool multithreaded, T value) : atomicThreadSafe(value), atomicTwoParty(reduceCpuUsage, value),
+            backend(multithreaded ? AtomicBackend::THREAD_SAFE : AtomicBackend::TWO_PARTY) {
         
     }
 
+    /**
+     * Create a new Atomic using the given implementation.
+     * 
+     * @param backend Implementation to use.
+     * @param reduceCpuUsage If true the object will use less cpu resources but will be slower (only AtomicBackend::TWO_PARTY).
+     */
+    Atomic(AtomicBackend backend, bool reduceCpuUsage = false) : atomicThreadSafe(), atomicTwoParty(reduceCpuUsage),
+            atomicSeqLock(backend == AtomicBackend::SEQLOCK ? std::make_unique<AtomicSeqLock<T, AtomicOperations<T>>>() : nullptr), backend(backend) {
+
+    }
+
+    /**
+     * Create a new Atomic using the given implementation with an initial value.
+     * 
+     * @param backend Implementation to use.
+     * @param reduceCpuUsage If true the object will use less cpu resources but will be slower (only AtomicBackend::TWO_PARTY).
+     * @param value Initial value.
+     */
+    Atomic(AtomicBackend backend, bool reduceCpuUsage, T value) : atomicThreadSafe(value), atomicTwoParty(reduceCpuUsage, value),
+            atomicSeqLock(backend == AtomicBackend::SEQLOCK ? std::make_unique<AtomicSeqLock<T, AtomicOperations<T>>>(value) : nullptr), backend(backend) {
+
+    }
+
     inline void storeA(T value, std::memory_order order = std::memory_order_seq_cst) override {
-        if(multithreaded){
-            atomicThreadSafe.storeA(value, order);
-        } else {
-            atomicTwoParty.storeA(value, order);
+        switch(backend){
+            case AtomicBackend::THREAD_SAFE: atomicThreadSafe.storeA(value, order); return;
+            case AtomicBackend::TWO_PARTY: atomicTwoParty.storeA(value, order); return;
+            default: atomicSeqLock->storeA(value, order); return;
         }
     }
 
     inline void storeB(T value, std::memory_order order = std::memory_order_seq_cst) override {
-        if(multithreaded){
-            atomicThreadSafe.storeB(value, order);
-        } else {
-            atomicTwoParty.storeB(value, order);
+        switch(backend){
+            case AtomicBackend::THREAD_SAFE: atomicThreadSafe.storeB(value, order); return;
+            case AtomicBackend::TWO_PARTY: atomicTwoParty.storeB(value, order); return;
+            default: atomicSeqLock->storeB(value, order); return;
         }
     }
 
     inline T loadA(std::memory_order order = std::memory_order_seq_cst) override {
-        if(multithreaded){
-            return atomicThreadSafe.loadA(order);
-        } else {
-            return atomicTwoParty.loadA(order);
+        switch(backend){
+            case AtomicBackend::THREAD_SAFE: return atomicThreadSafe.loadA(order);
+            case AtomicBackend::TWO_PARTY: return atomicTwoParty.loadA(order);
+            default: return atomicSeqLock->loadA(order);
         }
     }
 
     inline T loadB(std::memory_order order = std::memory_order_seq_cst) override {
-        if(multithreaded){
-            return atomicThreadSafe.loadB(order);
-        } else {
-            return atomicTwoParty.loadB(order);
+        switch(backend){
+            case AtomicBackend::THREAD_SAFE: return atomicThreadSafe.loadB(order);
+            case AtomicBackend::TWO_PARTY: return atomicTwoParty.loadB(order);
+            default: return atomicSeqLock->loadB(order);
         }
     }
 
     inline T fetchAddA(T value, std::memory_order order = std::memory_order_seq_cst) override {
-        if(multithreaded){
-            return atomicThreadSafe.fetchAddA(value, order);
-        } else {
-            return atomicTwoParty.fetchAddA(value, order);
+        switch(backend){
+            case AtomicBackend::THREAD_SAFE: return atomicThreadSafe.fetchAddA(value, order);
+            case AtomicBackend::TWO_PARTY: return atomicTwoParty.fetchAddA(value, order);
+            default: return atomicSeqLock->fetchAddA(value, order);
         }
     }
 
     inline T fetchAddB(T value, std::memory_order order = std::memory_order_seq_cst) override {
-        if(multithreaded){
-            return atomicThreadSafe.fetchAddB(value, order);
-        } else {
-            return atomicTwoParty.fetchAddB(value, order);
+        switch(backend){
+            case AtomicBackend::THREAD_SAFE: return atomicThreadSafe.fetchAddB(value, order);
+            case AtomicBackend::TWO_PARTY: return atomicTwoParty.fetchAddB(value, order);
+            default: return atomicSeqLock->fetchAddB(value, order);
         }
     }
 
     inline T fetchSubA(T value, std::memory_order order = std::memory_order_seq_cst) override {
-        if(multithreaded){
-            return atomicThreadSafe.fetchSubA(value, order);
-        } else {
-            return atomicTwoParty.fetchSubA(value, order);
+        switch(backend){
+            case AtomicBackend::THREAD_SAFE: return atomicThreadSafe.fetchSubA(value, order);
+            case AtomicBackend::TWO_PARTY: return atomicTwoParty.fetchSubA(value, order);
+            default: return atomicSeqLock->fetchSubA(value, order);
         }
     }
 
     inline T fetchSubB(T value, std::memory_order order = std::memory_order_seq_cst) override {
-        if(multithreaded){
-            return atomicThreadSafe.fetchSubB(value, order);
-        } else {
-            return atomicTwoParty.fetchSubB(value, order);
+        switch(backend){
+            case AtomicBackend::THREAD_SAFE: return atomicThreadSafe.fetchSubB(value, order);
+            case AtomicBackend::TWO_PARTY: return atomicTwoParty.fetchSubB(value, order);
+            default: return atomicSeqLock->fetchSubB(value, order);
         }
     }
 
     inline T exchangeA(T value, std::memory_order order = std::memory_order_seq_cst) override {
-        if(multithreaded){
-            return atomicThreadSafe.exchangeA(value, order);
-        } else {
-            return atomicTwoParty.exchangeA(value, order);
+        switch(backend){
+            case AtomicBackend::THREAD_SAFE: return atomicThreadSafe.exchangeA(value, order);
+            case AtomicBackend::TWO_PARTY: return atomicTwoParty.exchangeA(value, order);
+            default: return atomicSeqLock->exchangeA(value, order);
         }
     }
 
     inline T exchangeB(T value, std::memory_order order = std::memory_order_seq_cst) override {
-        if(multithreaded){
-            return atomicThreadSafe.exchangeB(value, order);
-        } else {
-            return atomicTwoParty.exchangeB(value, order);
+        switch(backend){
+            case AtomicBackend::THREAD_SAFE: return atomicThreadSafe.exchangeB(value, order);
+            case AtomicBackend::TWO_PARTY: return atomicTwoParty.exchangeB(value, order);
+            default: return atomicSeqLock->exchangeB(value, order);
         }
     }
 
     inline bool compareExchangeStrongA(T expected, T desired, std::memory_order order = std::memory_order_seq_cst) override {
-        if(multithreaded){
-            return atomicThreadSafe.compareExchangeStrongA(expected, desired, order);
-        } else {
-            return atomicTwoParty.compareExchangeStrongA(expected, desired, order);
+        switch(backend){
+            case AtomicBackend::THREAD_SAFE: return atomicThreadSafe.compareExchangeStrongA(expected, desired, order);
+            case AtomicBackend::TWO_PARTY: return atomicTwoParty.compareExchangeStrongA(expected, desired, order);
+            default: return atomicSeqLock->compareExchangeStrongA(expected, desired, order);
         }
     }
 
     inline bool compareExchangeStrongB(T expected, T desired, std::memory_order order = std::memory_order_seq_cst) override {
-        if(multithreaded){
-            return atomicThreadSafe.compareExchangeStrongB(expected, desired, order);
-        } else {
-            return atomicTwoParty.compareExchangeStrongB(expected, desired, order);
+        switch(backend){
+            case AtomicBackend::THREAD_SAFE: return atomicThreadSafe.compareExchangeStrongB(expected, desired, order);
+            case AtomicBackend::TWO_PARTY: return atomicTwoParty.compareExchangeStrongB(expected, desired, order);
+            default: return atomicSeqLock->compareExchangeStrongB(expected, desired, order);
         }
     }
 
     inline bool compareExchangeWeakA(T expected, T desired, std::memory_order order = std::memory_order_seq_cst) override {
-        if(multithreaded){
-            return atomicThreadSafe.compareExchangeWeakA(expected, desired, order);
-        } else {
-            return atomicTwoParty.compareExchangeWeakA(expected, desired, order);
+        switch(backend){
+            case AtomicBackend::THREAD_SAFE: return atomicThreadSafe.compareExchangeWeakA(expected, desired, order);
+            case AtomicBackend::TWO_PARTY: return atomicTwoParty.compareExchangeWeakA(expected, desired, order);
+            default: return atomicSeqLock->compareExchangeWeakA(expected, desired, order);
         }
     }
 
     inline bool compareExchangeWeakB(T expected, T desired, std::memory_order order = std::memory_order_seq_cst) override {
-        if(multithreaded){
-            return atomicThreadSafe.compareExchangeWeakB(expected, desired, order);
-        } else {
-            return atomicTwoParty.compareExchangeWeakB(expected, desired, order);
+        switch(backend){
+            case AtomicBackend::THREAD_SAFE: return atomicThreadSafe.compareExchangeWeakB(expected, desired, order);
+            case AtomicBackend::TWO_PARTY: return atomicTwoParty.compareExchangeWeakB(expected, desired, order);
+            default: return atomicSeqLock->compareExchangeWeakB(expected, desired, order);
         }
     }
 };
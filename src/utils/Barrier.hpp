@@ -0,0 +1,363 @@
+/**
+ * Latch, barrier and phaser for fork-join phases (e.g. window close -> parallel aggregate -> emit).
+ * All of them spin for a short while and then park the waiting thread on the synchronization word.
+ *
+ * @file Barrier.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+
+#ifndef SPI_BARRIER_HPP
+#define SPI_BARRIER_HPP
+
+#include "./HardwareUtils.hpp"
+#include "./Lock.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+/** Amount of cpuRelax() iterations a waiter spins before it parks (skipped on single core machines). */
+#ifndef SPI_BARRIER_SPINS
+#define SPI_BARRIER_SPINS 4096
+#endif
+
+/** Default amount of participants that arrive at the same node of the combining tree of a SpinBarrier. */
+#ifndef SPI_BARRIER_FAN_IN
+#define SPI_BARRIER_FAN_IN 8
+#endif
+
+namespace spi {
+
+
+/**
+ * Blocks until done(word) returns true.
+ * Spins with cpuRelax() for SPI_BARRIER_SPINS iterations first, then parks on the word (std::atomic::wait)
+ * so the thread that changes the word has to call notify_all() on it.
+ *
+ * @param word Atomic that gets changed by the releasing thread
+ * @param done Predicate that gets the current value of word and returns true if the wait is over
+ */
+template<typename T, typename Pred>
+inline void spinThenPark(const std::atomic<T> &word, Pred done){
+    static const uint32_t spins = HardwareUtils::getCpuCoreCount() > 1 ? SPI_BARRIER_SPINS : 0; // spinning on one core only delays the releaser
+    for(uint32_t i=0; i < spins; i++){
+        if(done(word.load(std::memory_order_acquire))) return;
+        cpuRelax();
+    }
+    T value = word.load(std::memory_order_acquire);
+    while(!done(value)){
+        word.wait(value, std::memory_order_acquire);
+        value = word.load(std::memory_order_acquire);
+    }
+}
+
+
+/**
+ * Single-use counter that releases all waiting threads once it got counted down to zero (like std::latch).
+ * Like with std::latch the latch may be destroyed as soon as wait() returned,
+ * the last countDown() only touches the address of the counter for waking up parked threads.
+ */
+class SpinLatch {
+protected:
+    alignas(CACHE_LINE_SIZE) std::atomic<int32_t> count;
+
+public:
+
+    /**
+     * Creates a latch that opens after expected count downs.
+     *
+     * @param expected Amount of count downs required to open the latch (zero means already open)
+     */
+    explicit SpinLatch(int32_t expected) : count(expected) {
+        if(expected < 0) throw std::runtime_error("SpinLatch expected count must not be negative");
+    }
+
+    SpinLatch(const SpinLatch&) = delete;
+    SpinLatch& operator=(const SpinLatch&) = delete;
+
+    /**
+     * Decrements the counter and wakes up all waiting threads if it reached zero.
+     * Does not block. Throws (and leaves the counter untouched) if n is negative or exceeds the counter.
+     *
+     * @param n Amount to count down
+     */
+    inline void countDown(int32_t n = 1){
+        if(n < 0) throw std::runtime_error("SpinLatch cannot count down a negative amount");
+        int32_t previous = count.load(std::memory_order_relaxed);
+        do {
+            if(previous < n) throw std::runtime_error("SpinLatch counted down below zero");
+        } while(!count.compare_exchange_weak(previous, previous - n, std::memory_order_acq_rel, std::memory_order_relaxed));
+        if(previous == n) count.notify_all();
+    }
+
+    /**
+     * Returns if the latch is already open.
+     *
+     * @return true if the counter reached zero, false otherwise.
+     */
+    inline bool tryWait() const noexcept {
+        return count.load(std::memory_order_acquire) == 0;
+    }
+
+    /**
+     * Blocks until the counter reached zero.
+     */
+    inline void wait() const {
+        spinThenPark(count, [](int32_t value){ return value == 0; });
+    }
+
+    /**
+     * Counts down and blocks until the counter reached zero.
+     *
+     * @param n Amount to count down
+     */
+    inline void arriveAndWait(int32_t n = 1){
+        countDown(n);
+        wait();
+    }
+};
+
+
+/**
+ * Reusable barrier for a fixed amount of participants (like std::barrier).
+ *
+ * Participants arrive at the leaves of a combining tree in which every node is shared by at most fanIn participants
+ * (or child nodes) and lives on its own cache line. Only the last arriver of a node continues to the parent node,
+ * so with many cores no single counter gets hammered by all participants.
+ * The last arriver at the root runs the completion function and then starts the next phase by incrementing
+ * the generation all other participants spin and park on.
+ * With participants <= fanIn the tree consists of a single node (plain central counter).
+ */
+class SpinBarrier {
+protected:
+    struct alignas(CACHE_LINE_SIZE) Node {
+        std::atomic<uint32_t> remaining{0};
+        uint32_t expected = 0;
+        Node* parent = nullptr;
+    };
+
+    std::unique_ptr<Node[]> nodes; // leaves first, root last
+    size_t participants;
+    size_t fanIn;
+    std::function<void()> completion;
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> generation{0};
+
+public:
+
+    /**
+     * Creates a barrier.
+     *
+     * @param participants Amount of threads that need to arrive to complete a phase
+     * @param completion Function that gets called by the last arriving thread before the others get released (may be empty)
+     * @param fanIn Amount of participants (or child nodes) that share a node of the combining tree
+     */
+    explicit SpinBarrier(size_t participants, std::function<void()> completion = {}, size_t fanIn = SPI_BARRIER_FAN_IN)
+            : participants(participants), fanIn(fanIn), completion(std::move(completion)) {
+        if(participants == 0) throw std::runtime_error("SpinBarrier requires at least one participant");
+        if(participants > UINT32_MAX) throw std::runtime_error("SpinBarrier supports at most "+std::to_string(UINT32_MAX)+" participants");
+        if(fanIn < 2) throw std::runtime_error("SpinBarrier fanIn must be at least 2");
+
+        size_t total = 0;
+        for(size_t level = participants; ; level = (level + fanIn - 1) / fanIn){
+            const size_t count = (level + fanIn - 1) / fanIn;
+            total += count;
+            if(count == 1) break;
+        }
+        this->nodes = std::unique_ptr<Node[]>(new Node[total]);
+
+        size_t levelStart = 0;
+        for(size_t level = participants; ; level = (level + fanIn - 1) / fanIn){
+            const size_t count = (level + fanIn - 1) / fanIn;
+            for(size_t i=0; i < count; i++){
+                Node &node = this->nodes[levelStart + i];
+                node.expected = (uint32_t)std::min(fanIn, level - i * fanIn);
+                node.remaining.store(node.expected, std::memory_order_relaxed);
+                if(count > 1) node.parent = &this->nodes[levelStart + count + i / fanIn];
+            }
+            if(count == 1) break;
+            levelStart += count;
+        }
+    }
+
+    SpinBarrier(const SpinBarrier&) = delete;
+    SpinBarrier& operator=(const SpinBarrier&) = delete;
+
+    /**
+     * Returns the amount of participants required to complete a phase.
+     */
+    size_t getParticipants() const noexcept {
+        return this->participants;
+    }
+
+    /**
+     * Returns the amount of phases that have been completed so far (wraps around).
+     */
+    uint32_t getPhase() const noexcept {
+        return this->generation.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Arrives at the barrier and blocks until all participants arrived in the current phase.
+     * Every participant has to pass its own index so arrivals spread over the leaves of the combining tree.
+     *
+     * @param participant Index of the calling participant in [0, participants) (throws otherwise)
+     * @return true for exactly one participant per phase (the one that completed it and ran the completion function).
+     */
+    bool arriveAndWait(size_t participant){
+        if(participant >= this->participants)
+            throw std::runtime_error("SpinBarrier participant "+std::to_string(participant)+" is not in [0, "+std::to_string(this->participants)+")");
+        const uint32_t gen = this->generation.load(std::memory_order_acquire);
+        Node* node = &this->nodes[participant / this->fanIn];
+        while(true){
+            if(node->remaining.fetch_sub(1, std::memory_order_acq_rel) != 1){
+                spinThenPark(this->generation, [gen](uint32_t value){ return value != gen; });
+                return false;
+            }
+            node->remaining.store(node->expected, std::memory_order_relaxed); // published by the generation increment
+            if(node->parent == nullptr) break;
+            node = node->parent;
+        }
+        if(this->completion) this->completion();
+        this->generation.store(gen + 1, std::memory_order_release);
+        this->generation.notify_all();
+        return true;
+    }
+};
+
+
+/**
+ * Reusable barrier with a dynamic amount of parties (like java.util.concurrent.Phaser).
+ *
+ * Parties can register and deregister at any time, arrive without waiting (e.g. producers that only
+ * signal that their part of a phase is done) or arrive and wait for the phase to advance.
+ * The phase number, the amount of parties and the amount of parties that did not arrive yet
+ * share one 64-bit word so every operation is a single CAS.
+ */
+class Phaser {
+protected:
+    static constexpr uint64_t UNARRIVED_MASK = 0xFFFF;
+    static constexpr uint64_t PARTIES_SHIFT = 16;
+    static constexpr uint64_t PHASE_SHIFT = 32;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> state; // phase:32 | parties:16 | unarrived:16
+
+    static inline uint32_t phaseOf(uint64_t s) noexcept { return (uint32_t)(s >> PHASE_SHIFT); }
+    static inline uint64_t partiesOf(uint64_t s) noexcept { return (s >> PARTIES_SHIFT) & UNARRIVED_MASK; }
+    static inline uint64_t unarrivedOf(uint64_t s) noexcept { return s & UNARRIVED_MASK; }
+
+    uint32_t doArrive(bool deregister){
+        uint64_t s = this->state.load(std::memory_order_relaxed);
+        while(true){
+            const uint64_t unarrived = unarrivedOf(s);
+            if(unarrived == 0) throw std::runtime_error("Phaser arrive called by unregistered party");
+            const uint64_t parties = partiesOf(s) - (deregister ? 1 : 0);
+            const bool advance = unarrived == 1;
+            const uint64_t next = advance ? ((uint64_t)(phaseOf(s) + 1) << PHASE_SHIFT) | (parties << PARTIES_SHIFT) | parties
+                                          : s - 1 - (deregister ? (1ull << PARTIES_SHIFT) : 0);
+            if(this->state.compare_exchange_weak(s, next, std::memory_order_acq_rel, std::memory_order_relaxed)){
+                if(advance) this->state.notify_all();
+                return phaseOf(s);
+            }
+        }
+    }
+
+public:
+
+    /** Maximum amount of parties a phaser can have registered. */
+    static constexpr size_t MAX_PARTIES = UNARRIVED_MASK;
+
+    /**
+     * Creates a phaser.
+     *
+     * @param parties Amount of initially registered parties
+     */
+    explicit Phaser(size_t parties = 0){
+        if(parties > MAX_PARTIES) throw std::runtime_error("Phaser supports at most "+std::to_string(MAX_PARTIES)+" parties");
+        this->state.store(((uint64_t)parties << PARTIES_SHIFT) | parties, std::memory_order_relaxed);
+    }
+
+    Phaser(const Phaser&) = delete;
+    Phaser& operator=(const Phaser&) = delete;
+
+    /**
+     * Adds a party that takes part starting with the current phase.
+     *
+     * @return uint32_t Current phase number.
+     */
+    uint32_t registerParty(){
+        uint64_t s = this->state.load(std::memory_order_relaxed);
+        while(true){
+            if(partiesOf(s) == MAX_PARTIES) throw std::runtime_error("Phaser supports at most "+std::to_string(MAX_PARTIES)+" parties");
+            if(this->state.compare_exchange_weak(s, s + (1ull << PARTIES_SHIFT) + 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+                return phaseOf(s);
+        }
+    }
+
+    /**
+     * Arrives at the current phase without waiting for the other parties.
+     *
+     * @return uint32_t Phase number that has been arrived at.
+     */
+    uint32_t arrive(){
+        return this->doArrive(false);
+    }
+
+    /**
+     * Arrives at the current phase and removes the calling party for all following phases.
+     *
+     * @return uint32_t Phase number that has been arrived at.
+     */
+    uint32_t arriveAndDeregister(){
+        return this->doArrive(true);
+    }
+
+    /**
+     * Blocks until the phaser advanced past the given phase.
+     *
+     * @param phase Phase number returned by arrive() or getPhase()
+     * @return uint32_t Phase number after the advance.
+     */
+    uint32_t awaitAdvance(uint32_t phase) const {
+        spinThenPark(this->state, [phase](uint64_t value){ return phaseOf(value) != phase; });
+        return this->getPhase();
+    }
+
+    /**
+     * Arrives at the current phase and blocks until all parties arrived.
+     *
+     * @return uint32_t Phase number after the advance.
+     */
+    uint32_t arriveAndAwaitAdvance(){
+        return this->awaitAdvance(this->doArrive(false));
+    }
+
+    /**
+     * Returns the current phase number (wraps around).
+     */
+    uint32_t getPhase() const noexcept {
+        return phaseOf(this->state.load(std::memory_order_acquire));
+    }
+
+    /**
+     * Returns the amount of registered parties.
+     */
+    size_t getRegisteredParties() const noexcept {
+        return (size_t)partiesOf(this->state.load(std::memory_order_acquire));
+    }
+
+    /**
+     * Returns the amount of parties that did not arrive at the current phase yet.
+     */
+    size_t getUnarrivedParties() const noexcept {
+        return (size_t)unarrivedOf(this->state.load(std::memory_order_acquire));
+    }
+};
+
+
+}
+#endif // SPI_BARRIER_HPP
@@ -0,0 +1,407 @@
+/**
+ * Shared harness for benchmarks with warm-up, repetitions, statistics and machine-readable output.
+ *
+ * @file Benchmark.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+
+#ifndef SPI_BENCHMARK_HPP
+#define SPI_BENCHMARK_HPP
+
+#include "./LatencyHistogram.hpp"
+#include "./MetricsUtils.hpp"
+#include "./Thread.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace spi {
+
+
+
+enum class BenchmarkFormat : uint8_t {
+    HUMAN = 0,  // one line per benchmark while running
+    JSON = 1,   // additionally writes all results as JSON at the end
+    CSV = 2,    // additionally writes all results as CSV at the end
+};
+
+
+/**
+ * Settings of a benchmark run, usually parsed from the command line:
+ *
+ *  --warmup=N          Runs that are executed but not recorded (default 1).
+ *  --repetitions=N     Recorded runs per benchmark (default 5).
+ *  --format=F          human, json or csv (default human). With json or csv the human-readable
+ *                      output goes to stderr so stdout only carries the structured results.
+ *  --output=PATH       File JSON/CSV is written to (default stdout).
+ *  --cpu=N             Pins the benchmarking thread to CPU N and worker threads to the following CPUs (default unpinned).
+ *  --filter=TEXT       Only runs benchmarks whose name contains TEXT.
+ */
+struct BenchmarkConfig {
+    uint32_t warmup = 1;
+    uint32_t repetitions = 5;
+    BenchmarkFormat format = BenchmarkFormat::HUMAN;
+    std::string output;
+    int cpu = -1;
+    std::string filter;
+
+    static BenchmarkConfig parse(int argc, char** argv){
+        BenchmarkConfig config;
+        for(int i=1; i < argc; i++){
+            std::string arg = argv[i];
+            size_t eq = arg.find('=');
+            std::string key = arg.substr(0, eq);
+            std::string value = eq != std::string::npos ? arg.substr(eq + 1) : "";
+            if(key == "--warmup") config.warmup = (uint32_t)std::stoul(value);
+            else if(key == "--repetitions") config.repetitions = std::max((uint32_t)1, (uint32_t)std::stoul(value));
+            else if(key == "--format"){
+                if(value == "human") config.format = BenchmarkFormat::HUMAN;
+                else if(value == "json") config.format = BenchmarkFormat::JSON;
+                else if(value == "csv") config.format = BenchmarkFormat::CSV;
+                else throw std::invalid_argument("Unknown format '"+value+"' (human, json or csv)");
+            }
+            else if(key == "--output") config.output = value;
+            else if(key == "--cpu") config.cpu = std::stoi(value);
+            else if(key == "--filter") config.filter = value;
+            else throw std::invalid_argument("Unknown argument '"+arg+"'");
+        }
+        return config;
+    }
+};
+
+
+/**
+ * Statistics of all recorded repetitions of one benchmark.
+ * Times are nanoseconds per operation.
+ */
+struct BenchmarkResult {
+    std::string name;
+    uint64_t operations = 0;    // operations per repetition
+    std::vector<double> nsPerOp; // one entry per repetition
+    double minNs = 0;
+    double medianNs = 0;
+    double p99Ns = 0;
+    double maxNs = 0;
+    double meanNs = 0;
+    std::map<std::string, double> metrics; // median of additional metrics reported by the benchmark
+
+    /** Operations per second based on the median repetition. */
+    uint64_t opsPerSec() const noexcept {
+        return medianNs > 0 ? (uint64_t)(1000000000.0 / medianNs) : 0;
+    }
+};
+
+
+/**
+ * Handed to benchmarks that only want to measure parts of their body (e.g. without thread creation).
+ * If start() is never called the whole body is measured.
+ */
+class BenchmarkTimer {
+protected:
+    std::chrono::steady_clock::time_point startTime;
+    std::chrono::steady_clock::time_point endTime;
+    std::chrono::nanoseconds excluded{0};
+    bool started = false;
+    bool stopped = false;
+    std::map<std::string, double> metrics;
+
+    friend class Benchmark;
+
+public:
+
+    /** Starts (or restarts) measuring. */
+    inline void start() noexcept {
+        this->started = true;
+        this->stopped = false;
+        this->startTime = std::chrono::steady_clock::now();
+    }
+
+    /** Stops measuring. */
+    inline void stop() noexcept {
+        this->endTime = std::chrono::steady_clock::now();
+        this->stopped = true;
+    }
+
+    /**
+     * Removes time from the measurement that is known to be spent outside of the measured operation
+     * (e.g. deliberate sleeps inside the loop).
+     */
+    inline void exclude(std::chrono::nanoseconds duration) noexcept {
+        this->excluded += duration;
+    }
+
+    /**
+     * Records an additional metric of this repetition (e.g. a latency percentile).
+     * The median over all repetitions gets reported.
+     */
+    inline void metric(const std::string &name, double value){
+        this->metrics[name] = value;
+    }
+
+    /**
+     * Records p50, p99 and p999 of a latency histogram (in ns) as metrics named prefix_p50_ns etc.
+     */
+    void latency(const std::string &prefix, const LatencyHistogram &histogram){
+        if(histogram.count() == 0) return;
+        this->metric(prefix + "_p50_ns", (double)histogram.percentile(50));
+        this->metric(prefix + "_p99_ns", (double)histogram.percentile(99));
+        this->metric(prefix + "_p999_ns", (double)histogram.percentile(99.9));
+    }
+};
+
+
+/**
+ * Runs benchmarks with warm-up and repetitions, prints a human readable line per benchmark
+ * and collects the statistics so they can be written as JSON or CSV at the end.
+ *
+ * Usage:
+ *      Benchmark bench("queue", argc, argv);
+ *      bench.run("QueueLock push & pop", ITERATIONS, [&](){ ... });
+ *      return bench.finish();
+ */
+class Benchmark {
+protected:
+    std::string suite;
+    BenchmarkConfig config;
+    std::vector<BenchmarkResult> results;
+    std::streambuf* structuredBuffer = nullptr; // stdout while std::cout is redirected to stderr
+
+    /** Redirects std::cout (human-readable lines of the harness and the benchmarks) to stderr if JSON/CSV is written. */
+    void redirectHumanOutput(){
+        if(config.format != BenchmarkFormat::HUMAN) structuredBuffer = std::cout.rdbuf(std::cerr.rdbuf());
+    }
+
+    static double percentile(std::vector<double> sorted, double p){
+        std::sort(sorted.begin(), sorted.end());
+        size_t index = (size_t)(p * (double)(sorted.size() - 1) + 0.5);
+        return sorted[std::min(index, sorted.size() - 1)];
+    }
+
+    template<typename Fn>
+    std::chrono::nanoseconds measure(Fn &fn, BenchmarkTimer &timer){
+        auto startTime = std::chrono::steady_clock::now();
+        if constexpr (std::is_invocable_v<Fn&, BenchmarkTimer&>) fn(timer);
+        else fn();
+        auto endTime = std::chrono::steady_clock::now();
+        if(timer.started){
+            startTime = timer.startTime;
+            if(timer.stopped) endTime = timer.endTime;
+        }
+        return std::max(std::chrono::nanoseconds(1), std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime) - timer.excluded);
+    }
+
+    template<typename Fn>
+    BenchmarkResult execute(const std::string &name, uint64_t operations, Fn &fn){
+        BenchmarkResult result;
+        result.name = name;
+        result.operations = std::max((uint64_t)1, operations);
+        std::map<std::string, std::vector<double>> metrics;
+
+        for(uint32_t i=0; i < config.warmup; i++){
+            BenchmarkTimer timer;
+            measure(fn, timer);
+        }
+        for(uint32_t i=0; i < config.repetitions; i++){
+            BenchmarkTimer timer;
+            std::chrono::nanoseconds duration = measure(fn, timer);
+            result.nsPerOp.push_back((double)duration.count() / (double)result.operations);
+            for(auto &entry : timer.metrics) metrics[entry.first].push_back(entry.second);
+        }
+
+        double sum = 0;
+        for(double ns : result.nsPerOp) sum += ns;
+        result.meanNs = sum / (double)result.nsPerOp.size();
+        result.minNs = *std::min_element(result.nsPerOp.begin(), result.nsPerOp.end());
+        result.maxNs = *std::max_element(result.nsPerOp.begin(), result.nsPerOp.end());
+        result.medianNs = percentile(result.nsPerOp, 0.5);
+        result.p99Ns = percentile(result.nsPerOp, 0.99);
+        for(auto &entry : metrics) result.metrics[entry.first] = percentile(entry.second, 0.5);
+        return result;
+    }
+
+    void printHuman(const BenchmarkResult &result) const {
+        std::cout << result.name << ": " << MetricsUtils::roundToString(result.opsPerSec()) << "/s" <<
+                    "  [min " << MetricsUtils::roundToString(result.minNs, 2) << " ns" <<
+                    " | median " << MetricsUtils::roundToString(result.medianNs, 2) << " ns" <<
+                    " | p99 " << MetricsUtils::roundToString(result.p99Ns, 2) << " ns" <<
+                    " | " << result.nsPerOp.size() << " reps]";
+        for(auto &entry : result.metrics) std::cout << "  " << entry.first << "=" << MetricsUtils::roundToString(entry.second, 1);
+        std::cout << std::endl;
+    }
+
+    static std::string jsonEscape(const std::string &value){
+        std::string escaped;
+        for(char c : value){
+            if(c == '"' || c == '\\') escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    static std::string csvEscape(const std::string &value){
+        std::string escaped;
+        for(char c : value){
+            if(c == '"') escaped += '"';
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    void writeJson(std::ostream &out) const {
+        out << "{\"suite\":\"" << jsonEscape(suite) << "\",\"warmup\":" << config.warmup <<
+                ",\"repetitions\":" << config.repetitions << ",\"cpu\":" << config.cpu << ",\"results\":[";
+        for(size_t i=0; i < results.size(); i++){
+            const BenchmarkResult &r = results[i];
+            out << (i > 0 ? "," : "") << "\n  {\"name\":\"" << jsonEscape(r.name) << "\",\"operations\":" << r.operations <<
+                    ",\"ops_per_sec\":" << r.opsPerSec() << ",\"min_ns\":" << r.minNs << ",\"median_ns\":" << r.medianNs <<
+                    ",\"p99_ns\":" << r.p99Ns << ",\"max_ns\":" << r.maxNs << ",\"mean_ns\":" << r.meanNs << ",\"ns_per_op\":[";
+            for(size_t j=0; j < r.nsPerOp.size(); j++) out << (j > 0 ? "," : "") << r.nsPerOp[j];
+            out << "],\"metrics\":{";
+            size_t j = 0;
+            for(auto &entry : r.metrics) out << (j++ > 0 ? "," : "") << "\"" << jsonEscape(entry.first) << "\":" << entry.second;
+            out << "}}";
+        }
+        out << "\n]}" << std::endl;
+    }
+
+    void writeCsv(std::ostream &out) const {
+        out << "suite,name,operations,repetitions,ops_per_sec,min_ns,median_ns,p99_ns,max_ns,mean_ns,metrics" << std::endl;
+        for(const BenchmarkResult &r : results){
+            std::string metrics;
+            for(auto &entry : r.metrics) metrics += (metrics.empty() ? "" : ";") + entry.first + "=" + std::to_string(entry.second);
+            out << "\"" << csvEscape(suite) << "\",\"" << csvEscape(r.name) << "\"," << r.operations << "," << r.nsPerOp.size() << "," <<
+                    r.opsPerSec() << "," << r.minNs << "," << r.medianNs << "," << r.p99Ns << "," << r.maxNs << "," << r.meanNs <<
+                    ",\"" << csvEscape(metrics) << "\"" << std::endl;
+        }
+    }
+
+public:
+
+    /**
+     * Creates a benchmark suite with settings parsed from the command line (see BenchmarkConfig).
+     *
+     * @param suite Name of the suite (e.g. name of the benchmark executable).
+     */
+    Benchmark(const std::string &suite, int argc, char** argv) : suite(suite), config(BenchmarkConfig::parse(argc, argv)) {
+        redirectHumanOutput();
+    }
+
+    Benchmark(const std::string &suite, const BenchmarkConfig &config) : suite(suite), config(config) {
+        redirectHumanOutput();
+    }
+
+    Benchmark(const Benchmark&) = delete;
+    Benchmark& operator=(const Benchmark&) = delete;
+
+    ~Benchmark(){
+        if(structuredBuffer != nullptr){
+            std::cout.flush();
+            std::cout.rdbuf(structuredBuffer);
+        }
+    }
+
+    const BenchmarkConfig& getConfig() const noexcept {
+        return config;
+    }
+
+    const std::vector<BenchmarkResult>& getResults() const noexcept {
+        return results;
+    }
+
+    /**
+     * Returns if a benchmark with the given name would be run with the configured filter.
+     */
+    bool enabled(const std::string &name) const {
+        return config.filter.empty() || name.find(config.filter) != std::string::npos;
+    }
+
+    /**
+     * Pins a worker thread of a benchmark to the CPU after the benchmarking thread (if pinning is enabled).
+     *
+     * @param thread Thread to pin (can be called before it is started).
+     * @param index Index of the worker (workers get consecutive CPUs, wrapping around the available cores).
+     */
+    void pin(Thread &thread, size_t index) const {
+        if(config.cpu < 0) return;
+        const int cores = std::max(1, HardwareUtils::getCpuCoreCount());
+        thread.setCPU((int)(((size_t)config.cpu + 1 + index) % (size_t)cores));
+    }
+
+    /**
+     * Runs a benchmark: warm-up runs, then the configured amount of recorded repetitions.
+     * fn is either fn() (whole call is measured) or fn(BenchmarkTimer&) to control what gets measured.
+     * If pinning is enabled fn runs on a thread pinned to the configured CPU.
+     *
+     * @param name Name of the benchmark.
+     * @param operations Amount of operations a single call of fn performs.
+     * @param fn Benchmark body.
+     * @return Statistics of the recorded repetitions (empty if filtered out).
+     */
+    template<typename Fn>
+    BenchmarkResult run(const std::string &name, uint64_t operations, Fn &&fn){
+        if(!enabled(name)) return BenchmarkResult{};
+        BenchmarkResult result;
+        if(config.cpu >= 0){
+            Thread thread([this, &name, operations, &fn, &result](){
+                result = this->execute(name, operations, fn);
+            });
+            thread.setCPU(config.cpu);
+            thread.start();
+            thread.join();
+        } else {
+            result = execute(name, operations, fn);
+        }
+        printHuman(result);
+        results.push_back(result);
+        return result;
+    }
+
+    /**
+     * Writes the collected results in the configured format (JSON/CSV) to the configured output
+     * (stdout if none is configured, even though std::cout carries the human-readable lines to stderr).
+     *
+     * @return Exit code for main().
+     */
+    int finish() const {
+        if(config.format == BenchmarkFormat::HUMAN) return 0;
+        std::ofstream file;
+        if(!config.output.empty()){
+            file.open(config.output);
+            if(!file.is_open()){
+                std::cerr << "Could not open " << config.output << std::endl;
+                return 1;
+            }
+        }
+        std::ostream standardOutput(structuredBuffer != nullptr ? structuredBuffer : std::cout.rdbuf());
+        std::ostream &out = config.output.empty() ? standardOutput : file;
+        if(config.format == BenchmarkFormat::JSON) writeJson(out);
+        else writeCsv(out);
+        out.flush();
+        return 0;
+    }
+
+    /**
+     * Prevents the compiler from optimizing away a value computed by a benchmark.
+     */
+    template<typename T>
+    static inline void doNotOptimize(T const &value){
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+};
+
+
+
+}
+
+#endif // SPI_BENCHMARK_HPP
@@ -8,6 +8,9 @@
 #ifndef CALLBACK_QUEUE_NAIVE_HPP
 #define CALLBACK_QUEUE_NAIVE_HPP
 
+#include "./HardwareUtils.hpp"
+#include "./Trace.hpp"
+
 #include <atomic>
 #include <string>
 
@@ -32,9 +35,9 @@ protected:
         }
     };
 
-    Entry* head = nullptr;
-    std::atomic<Entry*> tail{nullptr};
-    std::atomic<bool> executing{false};
+    alignas(CACHE_LINE_SIZE) Entry* head = nullptr;            // executing thread
+    alignas(CACHE_LINE_SIZE) std::atomic<Entry*> tail{nullptr}; // pushing threads
+    alignas(CACHE_LINE_SIZE) std::atomic<bool> executing{false};
 
 public:
 
@@ -80,6 +83,7 @@ public:
      * @return True if all callbacks got successfully executed and no more are left in the queue.
      */
     bool execute(){
+        SPI_TRACE_SCOPE("CallbackQueueNaive::execute");
         if(executing.exchange(true)) return true;
         bool hasMore = this->head != nullptr;
         while(hasMore){
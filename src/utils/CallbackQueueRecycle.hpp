@@ -1,6 +1,6 @@
 /**
  * Concurrent non-blocking queue specifically designed for use with callbacks.
- * 
+ *
  * @file CallbackQueueRecycle.hpp
  * @author Luca Vogels (github@luca-vogels.com)
  */
@@ -8,7 +8,14 @@
 #ifndef CALLBACK_QUEUE_RECYCLE_HPP
 #define CALLBACK_QUEUE_RECYCLE_HPP
 
+#include "EpochReclamation.hpp"
+#include "HardwareUtils.hpp"
+#include "Trace.hpp"
+
 #include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
 
 
 namespace spi {
@@ -17,121 +24,166 @@ namespace spi {
 using QueueableCallback = bool(*)();
 
 
+/**
+ * Multi-producer single-consumer callback queue.
+ *
+ * Producers push with a single atomic exchange onto an incoming list.
+ * The consumer detaches the whole incoming list in one step, restores FIFO order
+ * and executes from a private list that no producer touches.
+ * Executed entries are recycled through a free list whose head is an AtomicTaggedPointer,
+ * so a stale head can never be popped again (ABA).
+ */
 class CallbackQueueRecycle {
 protected:
 
     struct Entry {
-        QueueableCallback callback;
-        Entry* next = nullptr;
+        QueueableCallback callback = nullptr;
+        std::atomic<Entry*> next{nullptr};
     };
 
-    // queue
-    Entry* head = nullptr;
-    std::atomic<Entry*> tail{nullptr};
-    std::atomic<bool> executing{false};
+    // next of an entry that is pushed but whose link has not been written yet
+    inline static Entry* const PENDING = reinterpret_cast<Entry*>(static_cast<uintptr_t>(1));
 
-    // recycling of entries
-    std::atomic<Entry*> poolHead{nullptr};
-    std::atomic<Entry*> poolTail{nullptr};
+    // producers
+    alignas(CACHE_LINE_SIZE) std::atomic<Entry*> incoming{nullptr}; // newest first
+    alignas(CACHE_LINE_SIZE) AtomicTaggedPointer<Entry> pool;
 
-public:
+    // consumer (only accessed while executing is held)
+    alignas(CACHE_LINE_SIZE) std::atomic<bool> executing{false};
+    Entry* head = nullptr; // oldest first
+    Entry* tail = nullptr;
 
-    ~CallbackQueueRecycle(){
-        Entry* curr = this->head;
+
+    static void deleteList(Entry* curr){
         while(curr != nullptr){
-            Entry* next = curr->next;
+            Entry* next = curr->next.load(std::memory_order_relaxed);
             delete curr;
             curr = next;
         }
-        curr = this->poolHead.load();
+    }
+
+    Entry* acquireEntry(){
+        TaggedPointer<Entry> curr = pool.load(std::memory_order_acquire);
+        while(curr.ptr != nullptr){
+            // entries are never freed before destruction so reading next of a stale head is safe
+            Entry* next = curr.ptr->next.load(std::memory_order_relaxed);
+            if(pool.compareExchange(curr, next, std::memory_order_acquire, std::memory_order_acquire))
+                return curr.ptr;
+        }
+        return new Entry();
+    }
+
+    void recycleEntry(Entry* entry){
+        entry->callback = nullptr;
+        TaggedPointer<Entry> curr = pool.load(std::memory_order_relaxed);
+        do {
+            entry->next.store(curr.ptr, std::memory_order_relaxed);
+        } while(!pool.compareExchange(curr, entry, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    /**
+     * Moves all pushed entries to the end of the private list.
+     * Must only be called while executing is held.
+     */
+    void detachIncoming(){
+        Entry* curr = incoming.exchange(nullptr, std::memory_order_acquire);
+        if(curr == nullptr) return;
+        Entry* first = nullptr;
+        Entry* last = curr;
         while(curr != nullptr){
-            Entry* next = curr->next;
-            delete curr;
+            Entry* next;
+            while((next = curr->next.load(std::memory_order_acquire)) == PENDING); // producer is between exchange and link
+            curr->next.store(first, std::memory_order_relaxed);
+            first = curr;
             curr = next;
         }
+        if(tail != nullptr) tail->next.store(first, std::memory_order_relaxed);
+        else head = first;
+        tail = last;
+    }
+
+    template<typename StopCondition>
+    bool executeWhile(StopCondition stop){
+        SPI_TRACE_SCOPE("CallbackQueueRecycle::execute");
+        if(executing.exchange(true, std::memory_order_acquire)) return true;
+        detachIncoming();
+        while(head != nullptr && !stop()){
+            if(!head->callback()) break;
+            Entry* oldHead = head;
+            head = oldHead->next.load(std::memory_order_relaxed);
+            if(head == nullptr){
+                tail = nullptr;
+                detachIncoming();
+            }
+            recycleEntry(oldHead);
+        }
+        bool done = head == nullptr && incoming.load(std::memory_order_relaxed) == nullptr;
+        executing.store(false, std::memory_order_release);
+        return done;
+    }
+
+public:
+
+    ~CallbackQueueRecycle(){
+        detachIncoming();
+        deleteList(this->head);
+        deleteList(this->pool.load().ptr);
     }
 
-    
+
     /**
-     * Queues a callback function that will be executed 
+     * Queues a callback function that will be executed
      * when the execute() method gets invoked.
      * Callback will be popped from queue when it returns true.
-     * 
+     *
      * This method is thread safe.
-     * 
+     *
      * @param callback Callback that will be queued and executed later.
      */
     void push(QueueableCallback callback){
-        
-        // get entry from pool or create new one
-        Entry *entry = nullptr, *tmp = nullptr;
-        do {
-            entry = this->poolHead.load();
-            if(entry != nullptr){
-                // set poolHead to poolHead->next if still the same
-                tmp = entry; // needed because compare_exchange_strong() assigns current value to it
-                if(this->poolHead.compare_exchange_strong(tmp, entry->next)){
-                    // successfully got head from pool, update poolTail
-                    entry->callback = callback;
-                    entry->next = nullptr;
-                    break;
-                }
-            } else {
-                entry = new Entry();
-                entry->callback = callback;
-                break;
-            }
-        } while(true);
-        
-        // add entry to queue
-        Entry* oldTail = this->tail.exchange(entry);
-        if (oldTail == nullptr) {
-            this->head = entry;
-            return;
-        } else {
-            oldTail->next = entry;
-        }
+        Entry* entry = acquireEntry();
+        entry->callback = callback;
+        entry->next.store(PENDING, std::memory_order_relaxed);
+        Entry* prev = incoming.exchange(entry, std::memory_order_acq_rel);
+        entry->next.store(prev, std::memory_order_release);
     }
 
     /**
-     * Executes queued callbacks one after another as long as each 
-     * callback returns true. As soon as a callback returns false, 
-     * it won't be popped from the queue and the execution will stop 
+     * Executes queued callbacks one after another as long as each
+     * callback returns true. As soon as a callback returns false,
+     * it won't be popped from the queue and the execution will stop
      * until this method gets invoked again.
-     * 
+     *
      * Invoking this method while its already running will have no effect.
-     * 
+     *
      * This method is thread safe.
-     * 
+     *
      * @return True if all callbacks got successfully executed and no more are left in the queue.
      */
     bool execute(){
-        if(executing.exchange(true)) return true;
-        bool hasMore = this->head != nullptr;
-        while(hasMore){
-            if(this->head->callback()) {
-                Entry *oldHead = this->head;
-                Entry *tmp = oldHead; // tmp needed because compare_exchange_strong() assigns current value to it
-                this->head = oldHead->next;
-                this->tail.compare_exchange_strong(tmp, oldHead->next); // if tail is same as head set it to nullptr
-                
-                // recyle oldHead
-                oldHead->callback = nullptr;
-                oldHead->next = nullptr;
-                Entry* oldPoolTail = this->poolTail.exchange(oldHead);
-                if(oldPoolTail != nullptr){
-                    oldPoolTail->next = oldHead;
-                } else {
-                    this->poolHead.store(oldHead);
-                }
-
-                hasMore = this->head != nullptr;
-            } else {
-                break;
-            }
-        }
-        executing.store(false);
-        return !hasMore;
+        return executeWhile([]{ return false; });
+    }
+
+    /**
+     * Same as execute() but executes at most maxCallbacks callbacks per call.
+     *
+     * @param maxCallbacks Maximum amount of callbacks to execute.
+     * @return True if no more callbacks are left in the queue.
+     */
+    bool execute(uint64_t maxCallbacks){
+        uint64_t executed = 0;
+        return executeWhile([&executed, maxCallbacks]{ return executed++ >= maxCallbacks; });
+    }
+
+    /**
+     * Same as execute() but stops before the next callback once the deadline has passed.
+     * A callback that is already running is not interrupted.
+     *
+     * @param deadline Point in time after which no further callback is started.
+     * @return True if no more callbacks are left in the queue.
+     */
+    bool execute(std::chrono::steady_clock::time_point deadline){
+        return executeWhile([deadline]{ return std::chrono::steady_clock::now() >= deadline; });
     }
 
 };
@@ -139,4 +191,4 @@ public:
 
 }
 
-#endif // CALLBACK_QUEUE_RECYCLE_HPP
\ No newline at end of file
+#endif // CALLBACK_QUEUE_RECYCLE_HPP
@@ -8,6 +8,8 @@
 #ifndef CALLBACK_QUEUE_LOCK_HPP
 #define CALLBACK_QUEUE_LOCK_HPP
 
+#include "./Trace.hpp"
+
 #include <mutex>
 #include <string>
 
@@ -20,11 +22,12 @@ namespace spi {
  * 
  * Fully thread-safe.
  * 
+ * @tparam LockType Lock protecting the queue (std::mutex, Lock, TicketLock, MCSLock, ...).
  * @tparam Callback Type of the callback function that returns a bool to indicate if execution was successful.
  * @tparam CallbackArgs Arguments that will be passed to the callback functions.
  */
-template<typename Callback, typename... CallbackArgs>
-class CallbackQueueThreadSafe {
+template<typename LockType, typename Callback, typename... CallbackArgs>
+class BasicCallbackQueueThreadSafe {
 protected:
 
     class Entry {
@@ -41,7 +44,7 @@ protected:
         }
     };
 
-    std::mutex mutex;
+    LockType mutex;
     Entry* head = nullptr;
     Entry* tail = nullptr;
 
@@ -50,7 +53,7 @@ protected:
 
 public:
 
-    ~CallbackQueueThreadSafe(){
+    ~BasicCallbackQueueThreadSafe(){
         cancelAll();
 
         Entry* current = recycleHead;
@@ -63,7 +66,7 @@ public:
 
 
     void cancelAll() noexcept {
-        std::lock_guard<std::mutex> lock(mutex);
+        std::lock_guard<LockType> lock(mutex);
         while(this->head != nullptr){
             Entry* oldHead = this->head;
             this->head = oldHead->next;
@@ -91,7 +94,7 @@ public:
      */
     void push(Callback callback) noexcept {
         Entry* entry;
-        std::lock_guard<std::mutex> lock(mutex);
+        std::lock_guard<LockType> lock(mutex);
         if(this->recycleHead != nullptr){
             entry = this->recycleHead;
             this->recycleHead = entry->next;
@@ -126,7 +129,8 @@ public:
      * @return True if all callbacks got successfully executed and no more are left in the queue.
      */
     bool execute(CallbackArgs... args){
-        std::lock_guard<std::mutex> lock(mutex);
+        SPI_TRACE_SCOPE("CallbackQueueThreadSafe::execute");
+        std::lock_guard<LockType> lock(mutex);
         while(this->head != nullptr){
             if(this->head->callback(args...)) {
                 Entry *oldHead = this->head;
@@ -156,6 +160,13 @@ public:
 };
 
 
+/**
+ * Callback queue protected by a std::mutex (see BasicCallbackQueueThreadSafe).
+ */
+template<typename Callback, typename... CallbackArgs>
+using CallbackQueueThreadSafe = BasicCallbackQueueThreadSafe<std::mutex, Callback, CallbackArgs...>;
+
+
 }
 
 #endif // CALLBACK_QUEUE_LOCK_HPP
\ No newline at end of file
@@ -9,6 +9,7 @@
 #define CALLBACK_QUEUE_TWO_PARTY_HPP
 
 #include "./Lock.hpp"
+#include "./Trace.hpp"
 
 #include <string>
 
@@ -42,11 +43,11 @@ protected:
         }
     };
 
-    Node* head;
-    Node* tail;
+    alignas(CACHE_LINE_SIZE) Node* head;        // executing thread
+    Node* recycleTail;                          // executing thread
 
-    Node* recycleHead;
-    Node* recycleTail;
+    alignas(CACHE_LINE_SIZE) Node* tail;        // pushing thread
+    Node* recycleHead;                          // pushing thread
 
 public:
 
@@ -119,6 +120,7 @@ public:
      * @return True if all callbacks got successfully executed and no more are left in the queue.
      */
     bool execute(CallbackArgs... args){
+        SPI_TRACE_SCOPE("CallbackQueueTwoParty::execute");
         while(head->next != nullptr){
             Node* oldHead = head;
             head = head->next;
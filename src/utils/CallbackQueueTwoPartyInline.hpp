@@ -0,0 +1,176 @@
+/**
+ * Concurrent non-blocking queue for callbacks that stores the callables inside its nodes.
+ *
+ * @file CallbackQueueTwoPartyInline.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+
+#ifndef CALLBACK_QUEUE_TWO_PARTY_INLINE_HPP
+#define CALLBACK_QUEUE_TWO_PARTY_INLINE_HPP
+
+#include "./HardwareUtils.hpp"
+#include "./InlineCallback.hpp"
+#include "./Trace.hpp"
+
+#include <atomic>
+#include <new>
+#include <utility>
+
+namespace spi {
+
+
+
+/**
+ * Callback queue that stores callables directly inside its (recycled) nodes
+ * and executes them one after another.
+ *
+ * With Callable = InlineCallback<bool(CallbackArgs...)> any callable up to the inline size
+ * is stored without allocating (see CallbackQueueTwoPartyInline).
+ * With Callable being the concrete lambda type the queue calls it directly
+ * without any indirection (see CallbackQueueTwoPartyTyped).
+ *
+ * IMPORTANT:   only a single thread for pushing
+ *              and a single thread for executing is allowed!
+ *
+ * @tparam Callable Type stored per node that returns a bool to indicate if execution was successful.
+ * @tparam CallbackArgs Arguments that will be passed to the callables.
+ */
+template<typename Callable, typename... CallbackArgs>
+class BasicCallbackQueueTwoPartyInline {
+protected:
+
+    struct Node {
+        alignas(Callable) unsigned char storage[sizeof(Callable)];
+        std::atomic<Node*> next{nullptr};
+
+        inline Callable& callable() noexcept {
+            return *std::launder(reinterpret_cast<Callable*>(storage));
+        }
+    };
+
+    // consumer
+    alignas(CACHE_LINE_SIZE) Node* head;       // next node to execute (valid if head->next != nullptr)
+    Node* recycleTail;                          // consumer appends executed nodes here
+
+    // producer
+    alignas(CACHE_LINE_SIZE) Node* tail;       // empty node the next push constructs into
+    Node* recycleHead;                          // producer takes nodes from here
+
+
+    inline void recycle(Node* node) noexcept {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node* oldRecycleTail = recycleTail;
+        recycleTail = node;
+        oldRecycleTail->next.store(node, std::memory_order_release);
+    }
+
+public:
+
+    BasicCallbackQueueTwoPartyInline() {
+        Node* dummy = new Node();
+        head = dummy;
+        tail = dummy;
+        Node* dummy2 = new Node();
+        recycleHead = dummy2;
+        recycleTail = dummy2;
+    }
+
+    ~BasicCallbackQueueTwoPartyInline(){
+        cancelAll();
+        delete head; // delete dummy
+
+        Node* current = recycleHead;
+        while(current != nullptr) {
+            Node* next = current->next.load(std::memory_order_relaxed);
+            delete current;
+            current = next;
+        }
+    }
+
+    BasicCallbackQueueTwoPartyInline(const BasicCallbackQueueTwoPartyInline&) = delete;
+    BasicCallbackQueueTwoPartyInline& operator=(const BasicCallbackQueueTwoPartyInline&) = delete;
+
+
+    /**
+     * Removes all queued callbacks without executing them.
+     * Must be called by the executing thread.
+     */
+    void cancelAll() noexcept {
+        Node* next;
+        while((next = head->next.load(std::memory_order_acquire)) != nullptr){
+            head->callable().~Callable();
+            recycle(head);
+            head = next;
+        }
+    }
+
+
+    /**
+     * Queues a callback that will be executed
+     * when the execute() method gets invoked.
+     * Callback will be popped from queue when it returns true.
+     *
+     * Nodes are recycled, so pushing does not allocate once the queue has
+     * seen as many simultaneously queued callbacks before.
+     *
+     * @param callback Callback that will be queued and executed later.
+     */
+    template<typename Fn>
+    void push(Fn&& callback){
+        Node* newNode;
+        Node* next = recycleHead->next.load(std::memory_order_acquire);
+        if(next != nullptr){
+            newNode = recycleHead;
+            recycleHead = next;
+            newNode->next.store(nullptr, std::memory_order_relaxed);
+        } else {
+            newNode = new Node();
+        }
+        Node* oldTail = tail;
+        ::new(static_cast<void*>(oldTail->storage)) Callable(std::forward<Fn>(callback));
+        tail = newNode;
+        oldTail->next.store(newNode, std::memory_order_release);
+    }
+
+    /**
+     * Executes queued callbacks one after another as long as each
+     * callback returns true. As soon as a callback returns false,
+     * it won't be popped from the queue and the execution will stop
+     * until this method gets invoked again.
+     *
+     * @param args Arguments that will be passed to the callbacks.
+     * @return True if all callbacks got successfully executed and no more are left in the queue.
+     */
+    bool execute(CallbackArgs... args){
+        SPI_TRACE_SCOPE("CallbackQueueTwoPartyInline::execute");
+        Node* next;
+        while((next = head->next.load(std::memory_order_acquire)) != nullptr){
+            if(!head->callable()(args...)) return false;
+            head->callable().~Callable();
+            Node* oldHead = head;
+            head = next;
+            recycle(oldHead);
+        }
+        return true;
+    }
+};
+
+
+/**
+ * Two party callback queue for arbitrary callables.
+ * Callables up to SPI_CALLBACK_INLINE_SIZE bytes are stored inside the node without allocating.
+ */
+template<typename... CallbackArgs>
+using CallbackQueueTwoPartyInline = BasicCallbackQueueTwoPartyInline<InlineCallback<bool(CallbackArgs...)>, CallbackArgs...>;
+
+/**
+ * Two party callback queue that only holds callables of a single type (e.g. one lambda type)
+ * and calls them directly without type erasure.
+ */
+template<typename Callable, typename... CallbackArgs>
+using CallbackQueueTwoPartyTyped = BasicCallbackQueueTwoPartyInline<Callable, CallbackArgs...>;
+
+
+}
+
+#endif // CALLBACK_QUEUE_TWO_PARTY_INLINE_HPP
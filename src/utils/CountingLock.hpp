@@ -13,9 +13,12 @@
 
 #include "Atomic.hpp"
 
+#include <atomic>
 #include <condition_variable>
+#include <cstdint>
 #include <mutex>
 #include <semaphore>
+#include <stdexcept>
 
 namespace spi {
 
@@ -29,8 +32,24 @@ public:
 
     virtual bool acquire(bool block = true) = 0;
 
+    /**
+     * Increases the counter by count at once (all or nothing).
+     * 
+     * @param count Amount to increase the counter by (at least 1 and at most the maximum).
+     * @param block If true the calling thread will be blocked until count can be acquired.
+     * @return True if acquired successfully, false if count is not available and block is false.
+     */
+    virtual bool acquire(int32_t count, bool block = true) = 0;
+
     virtual void release() = 0;
 
+    /**
+     * Decreases the counter by count at once.
+     * 
+     * @param count Amount to decrease the counter by (at least 1).
+     */
+    virtual void release(int32_t count) = 0;
+
 };
 
 
@@ -42,6 +61,15 @@ protected:
     int32_t maxCounter;
     std::mutex mutex;
     std::condition_variable cv;
+    std::atomic<int32_t> waiters{0}; // threads blocked in acquire(), release() only locks and notifies if there are any
+
+    /** Wakes up threads blocked in acquire() (only takes the mutex if there are any). */
+    inline void notifyWaiters(){
+        std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with acquire(): this sees the waiter or it sees the release
+        if(waiters.load(std::memory_order_relaxed) == 0) return;
+        { std::lock_guard<std::mutex> lock(mutex); } // waiter either sees new value or is already waiting
+        cv.notify_all();
+    }
 
 public:
 
@@ -52,16 +80,25 @@ public:
     }
 
     inline bool acquire(bool block = true) override {
+        return acquire(1, block);
+    }
+
+    inline bool acquire(int32_t count, bool block = true) override {
+        if(count < 1 || count > maxCounter) throw std::invalid_argument("Count must be between 1 and max.");
         int32_t curr;
         while(true){
             curr = counter.loadA(std::memory_order_acquire);
-            if(curr < maxCounter){
-                if(counter.compareExchangeWeakA(curr, curr+1, std::memory_order_acquire)){
+            if(curr <= maxCounter - count){
+                if(counter.compareExchangeWeakA(curr, curr+count, std::memory_order_acquire)){
                     return true;
                 }
             } else if(block){
                 std::unique_lock<std::mutex> lock(mutex);
-                cv.wait(lock);
+                waiters.fetch_add(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with release(): it sees this waiter or this sees its release
+                if(counter.loadA(std::memory_order_acquire) > maxCounter - count)
+                    cv.wait(lock);
+                waiters.fetch_sub(1, std::memory_order_relaxed);
             } else {
                 return false;
             }
@@ -70,12 +107,17 @@ public:
     }
 
     inline void release() override {
+        release(1);
+    }
+
+    inline void release(int32_t count) override {
+        if(count < 1) throw std::invalid_argument("Count must be at least 1.");
         int32_t curr;
         while(true){
-            curr = counter.loadB(std::memory_order_release);
-            if(curr > 0){
-                if(counter.compareExchangeWeakB(curr, curr-1, std::memory_order_release)){
-                    cv.notify_all();
+            curr = counter.loadB(std::memory_order_relaxed); // validated by the CAS below
+            if(curr >= count){
+                if(counter.compareExchangeWeakB(curr, curr-count, std::memory_order_release)){
+                    notifyWaiters();
                     return;
                 }
             } else {
@@ -93,8 +135,17 @@ protected:
     int32_t maxCounter;
     std::mutex mutex;
     std::condition_variable cv;
+    std::atomic<int32_t> waiters{0}; // threads blocked in acquire(), release() only locks and notifies if there are any
     bool closing = false;
 
+    /** Wakes up threads blocked in acquire() (only takes the mutex if there are any). */
+    inline void notifyWaiters(){
+        std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with acquire(): this sees the waiter or it sees the release
+        if(waiters.load(std::memory_order_relaxed) == 0) return;
+        { std::lock_guard<std::mutex> lock(mutex); } // waiter either sees new value or is already waiting
+        cv.notify_all();
+    }
+
 public:
 
     /**
@@ -175,17 +226,35 @@ public:
      * @return True if acquired successfully, false if the counter was already at the maximum and block is false.
      */
     inline bool acquire(bool block = true) override {
-        int32_t prevValue;
+        return acquire(1, block);
+    }
+
+    /**
+     * Increases the counter by count at once (all or nothing).
+     * If the counter can not be increased by count without exceeding the maximum then the calling thread
+     * will be blocked until the counter is decreased again by calling release().
+     * 
+     * @param count Amount to increase the counter by (at least 1 and at most the maximum).
+     * @param block If true the calling thread will be blocked until count can be acquired.
+     * @return True if acquired successfully, false if count is not available and block is false.
+     */
+    inline bool acquire(int32_t count, bool block = true) override {
+        if(count < 1 || count > maxCounter) throw std::invalid_argument("Count must be between 1 and max.");
+        int32_t curr;
         while(!this->closing){
-            prevValue = counter.fetchAddA(1, std::memory_order_acquire);
-            if(prevValue < maxCounter){
-                return true;
-            } else {
-                counter.fetchSubA(1, std::memory_order_acquire);
-                if(!block) return false;
+            curr = counter.loadA(std::memory_order_acquire);
+            if(curr <= maxCounter - count){
+                // only commit if count fits, a speculative increase would make concurrent batches back off
+                if(counter.compareExchangeWeakA(curr, curr+count, std::memory_order_acquire)) return true;
+            } else if(block){
                 std::unique_lock<std::mutex> lock(mutex);
-                if(!this->closing)
-                    cv.wait(lock);
+                waiters.fetch_add(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with release(): it sees this waiter or this sees its release
+                if(!this->closing && counter.loadA(std::memory_order_acquire) > maxCounter - count)
+                    cv.wait(lock); // woken up by release()
+                waiters.fetch_sub(1, std::memory_order_relaxed);
+            } else {
+                return false;
             }
         }
         return false;
@@ -197,12 +266,22 @@ public:
      * release() is not required to be called by the same thread that called acquire().
      */
     inline void release() override {
-        int32_t prevValue = counter.fetchSubB(1, std::memory_order_release);
-        if(prevValue <= 0){
-            counter.fetchAddB(1, std::memory_order_release);
-            throw std::runtime_error("Counter is already at 0.");
+        release(1);
+    }
+
+    /**
+     * Decreases the counter by count at once and notifies all waiting threads.
+     * 
+     * @param count Amount to decrease the counter by (at least 1).
+     */
+    inline void release(int32_t count) override {
+        if(count < 1) throw std::invalid_argument("Count must be at least 1.");
+        int32_t prevValue = counter.fetchSubB(count, std::memory_order_release);
+        if(prevValue < count){
+            counter.fetchAddB(count, std::memory_order_release);
+            throw std::runtime_error("Counter is below count.");
         }
-        cv.notify_all();
+        notifyWaiters();
     }
 };
 
@@ -210,25 +289,178 @@ public:
 
 
 
+/**
+ * Counting lock backed by std::counting_semaphore.
+ * 
+ * std::counting_semaphore has no batch acquire, so batches take their units one after another.
+ * Batches are serialized by a mutex, therefore at most one batch holds only part of its units
+ * and concurrent batches cannot deadlock each other. A non-blocking batch either gets all units
+ * or returns the ones it already took.
+ */
 class CountingLockSemaphore : public AbstractCountingLock {
 protected:
     std::counting_semaphore<65535> counter;
+    int32_t maxCounter;
+    std::mutex batchMutex; // held while a batch collects its units
 
 public:
 
-    CountingLockSemaphore(int32_t max) : AbstractCountingLock(), counter(max) {
+    CountingLockSemaphore(int32_t max) : AbstractCountingLock(), counter(max), maxCounter(max) {
         if(max < 1) throw std::invalid_argument("Max must be at least 1.");
     }
 
     inline bool acquire(bool block = true) override {
-        (void)block;
+        if(!block) return counter.try_acquire();
         counter.acquire();
         return true;
     }
 
+    /**
+     * Increases the counter by count at once (all or nothing).
+     * 
+     * @param count Amount to increase the counter by (at least 1 and at most the maximum).
+     * @param block If true the calling thread will be blocked until count can be acquired.
+     * @return True if acquired successfully, false if count is not available and block is false.
+     */
+    inline bool acquire(int32_t count, bool block = true) override {
+        if(count < 1 || count > maxCounter) throw std::invalid_argument("Count must be between 1 and max.");
+        if(count == 1) return acquire(block);
+        if(block){
+            std::lock_guard<std::mutex> lock(batchMutex);
+            for(int32_t i=0; i < count; i++) counter.acquire();
+            return true;
+        }
+        std::unique_lock<std::mutex> lock(batchMutex, std::try_to_lock);
+        if(!lock.owns_lock()) return false; // another batch is still collecting its units
+        for(int32_t i=0; i < count; i++){
+            if(!counter.try_acquire()){
+                if(i > 0) counter.release(i);
+                return false;
+            }
+        }
+        return true;
+    }
+
     inline void release() override {
         counter.release();
     }
+
+    inline void release(int32_t count) override {
+        if(count < 1) throw std::invalid_argument("Count must be at least 1.");
+        counter.release(count);
+    }
+};
+
+
+
+
+
+/**
+ * Counting lock whose waiters park on the counter itself (std::atomic::wait, futex on Linux)
+ * instead of a mutex and condition variable.
+ * 
+ * acquire() and release() are a single atomic operation if there are no waiters,
+ * release() only notifies if a thread is actually waiting. If all waiters acquire one unit
+ * a release of one unit wakes a single thread, otherwise all waiters re-check the counter.
+ * Any amount of threads may acquire and release.
+ */
+class CountingLockFutex : public AbstractCountingLock {
+protected:
+    alignas(CACHE_LINE_SIZE) std::atomic<int32_t> counter{0};
+    std::atomic<int32_t> waiters{0}; // threads parked or about to park
+    std::atomic<int32_t> batchWaiters{0}; // waiters that acquire more than one unit
+    int32_t maxCounter;
+
+    bool acquireSlow(int32_t count){
+        waiters.fetch_add(1, std::memory_order_seq_cst);
+        if(count > 1) batchWaiters.fetch_add(1, std::memory_order_seq_cst);
+        int32_t curr = counter.load(std::memory_order_seq_cst);
+        while(true){
+            if(curr <= maxCounter - count){
+                if(counter.compare_exchange_weak(curr, curr+count, std::memory_order_acquire, std::memory_order_relaxed)) break;
+            } else {
+                counter.wait(curr, std::memory_order_relaxed);
+                curr = counter.load(std::memory_order_seq_cst);
+            }
+        }
+        if(count > 1) batchWaiters.fetch_sub(1, std::memory_order_relaxed);
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+public:
+
+    /**
+     * Creates a counting lock.
+     * 
+     * @param max Maximum amount of times the lock can be acquired simultaneously before blocking further acquires.
+     */
+    CountingLockFutex(int32_t max) : AbstractCountingLock(), maxCounter(max) {
+        if(max < 1) throw std::invalid_argument("Max must be at least 1.");
+    }
+
+    inline bool acquire(bool block = true) override {
+        return acquire(1, block);
+    }
+
+    /**
+     * Increases the counter by count at once (all or nothing).
+     * 
+     * release() is not required to be called by the same thread that called acquire().
+     * 
+     * @param count Amount to increase the counter by (at least 1 and at most the maximum).
+     * @param block If true the calling thread will be blocked until count can be acquired.
+     * @return True if acquired successfully, false if count is not available and block is false.
+     */
+    inline bool acquire(int32_t count, bool block = true) override {
+        if(count < 1 || count > maxCounter) throw std::invalid_argument("Count must be between 1 and max.");
+        int32_t curr = counter.load(std::memory_order_relaxed);
+        while(curr <= maxCounter - count){
+            if(counter.compare_exchange_weak(curr, curr+count, std::memory_order_acquire, std::memory_order_relaxed)) return true;
+        }
+        if(!block) return false;
+        return acquireSlow(count);
+    }
+
+    inline void release() override {
+        release(1);
+    }
+
+    /**
+     * Decreases the counter by count at once and wakes waiting threads if there are any.
+     * 
+     * @param count Amount to decrease the counter by (at least 1).
+     */
+    inline void release(int32_t count) override {
+        if(count < 1) throw std::invalid_argument("Count must be at least 1.");
+        int32_t prevValue = counter.fetch_sub(count, std::memory_order_seq_cst);
+        if(prevValue < count){
+            counter.fetch_add(count, std::memory_order_relaxed);
+            throw std::runtime_error("Counter is below count.");
+        }
+        if(waiters.load(std::memory_order_seq_cst) > 0){
+            if(count == 1 && batchWaiters.load(std::memory_order_seq_cst) == 0) counter.notify_one();
+            else counter.notify_all();
+        }
+    }
+
+    /**
+     * Returns the current value of the counter.
+     * 
+     * @return Current value of the counter.
+     */
+    inline int32_t getCounter() const noexcept {
+        return counter.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Returns the maximum value of the counter.
+     * 
+     * @return Maximum value of the counter.
+     */
+    inline int32_t getMaximum() const noexcept {
+        return maxCounter;
+    }
 };
 
 
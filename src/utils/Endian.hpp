@@ -0,0 +1,342 @@
+/**
+ * Endian provides byte order conversions of single values and whole buffers.
+ * Bulk conversions use pshufb (SSSE3, AVX2, AVX-512BW) or NEON depending on
+ * what the CPU supports at runtime and are no-ops if the byte orders match.
+ *
+ * @file Endian.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+
+#ifndef SPI_ENDIAN_HPP
+#define SPI_ENDIAN_HPP
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
+
+#if defined(SPI_ENDIAN_NO_SIMD)
+    // scalar only
+#elif defined(__x86_64__) || defined(__i386__)
+#define SPI_ENDIAN_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define SPI_ENDIAN_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace spi {
+
+
+
+/**
+ * Instruction set used by the bulk conversions of Endian.
+ */
+enum class EndianSimd {
+    SCALAR,
+    SSSE3,
+    AVX2,
+    AVX512,
+    NEON,
+};
+
+
+
+class Endian {
+public:
+    static constexpr bool HOST_IS_LITTLE = std::endian::native == std::endian::little;
+    static constexpr bool HOST_IS_BIG = std::endian::native == std::endian::big;
+    static_assert(HOST_IS_LITTLE || HOST_IS_BIG, "Mixed endian hosts are not supported");
+
+protected:
+    typedef void (*BulkSwap)(const void* src, void* dst, size_t count);
+
+    template<typename T>
+    static constexpr bool Swappable = (std::is_integral_v<T> || std::is_enum_v<T> || std::is_floating_point_v<T>) &&
+                                        (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8);
+
+
+    template<size_t W>
+    static void swapScalar(const void* src, void* dst, size_t count){
+        const uint8_t* in = static_cast<const uint8_t*>(src);
+        uint8_t* out = static_cast<uint8_t*>(dst);
+        for(size_t i=0; i < count; i++, in += W, out += W){
+            if constexpr (W == 2){
+                uint16_t v; std::memcpy(&v, in, W); v = __builtin_bswap16(v); std::memcpy(out, &v, W);
+            } else if constexpr (W == 4){
+                uint32_t v; std::memcpy(&v, in, W); v = __builtin_bswap32(v); std::memcpy(out, &v, W);
+            } else {
+                uint64_t v; std::memcpy(&v, in, W); v = __builtin_bswap64(v); std::memcpy(out, &v, W);
+            }
+        }
+    }
+
+
+    #ifdef SPI_ENDIAN_X86
+    /** pshufb mask that reverses every W byte word (same for every 16 byte lane). */
+    template<size_t W>
+    struct ShuffleMask {
+        alignas(64) char bytes[64] = {};
+        constexpr ShuffleMask(){
+            for(size_t i=0; i < 64; i++) bytes[i] = (char)((i % 16 / W) * W + (W - 1 - i % W));
+        }
+    };
+
+    template<size_t W>
+    static constexpr ShuffleMask<W> MASK{};
+
+    template<size_t W>
+    __attribute__((target("ssse3")))
+    static void swapSSSE3(const void* src, void* dst, size_t count){
+        const __m128i mask = _mm_load_si128((const __m128i*)MASK<W>.bytes);
+        const uint8_t* in = static_cast<const uint8_t*>(src);
+        uint8_t* out = static_cast<uint8_t*>(dst);
+        size_t bytes = count * W;
+        for(; bytes >= 16; bytes -= 16, in += 16, out += 16){
+            _mm_storeu_si128((__m128i*)out, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)in), mask));
+        }
+        swapScalar<W>(in, out, bytes / W);
+    }
+
+    template<size_t W>
+    __attribute__((target("avx2")))
+    static void swapAVX2(const void* src, void* dst, size_t count){
+        const __m256i mask = _mm256_load_si256((const __m256i*)MASK<W>.bytes);
+        const uint8_t* in = static_cast<const uint8_t*>(src);
+        uint8_t* out = static_cast<uint8_t*>(dst);
+        size_t bytes = count * W;
+        for(; bytes >= 64; bytes -= 64, in += 64, out += 64){
+            const __m256i a = _mm256_loadu_si256((const __m256i*)in);
+            const __m256i b = _mm256_loadu_si256((const __m256i*)(in + 32));
+            _mm256_storeu_si256((__m256i*)out, _mm256_shuffle_epi8(a, mask));
+            _mm256_storeu_si256((__m256i*)(out + 32), _mm256_shuffle_epi8(b, mask));
+        }
+        for(; bytes >= 32; bytes -= 32, in += 32, out += 32){
+            _mm256_storeu_si256((__m256i*)out, _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)in), mask));
+        }
+        swapScalar<W>(in, out, bytes / W);
+    }
+
+    template<size_t W>
+    __attribute__((target("avx512f,avx512bw")))
+    static void swapAVX512(const void* src, void* dst, size_t count){
+        const __m512i mask = _mm512_load_si512((const void*)MASK<W>.bytes);
+        const uint8_t* in = static_cast<const uint8_t*>(src);
+        uint8_t* out = static_cast<uint8_t*>(dst);
+        size_t bytes = count * W;
+        for(; bytes >= 64; bytes -= 64, in += 64, out += 64){
+            _mm512_storeu_si512((void*)out, _mm512_shuffle_epi8(_mm512_loadu_si512((const void*)in), mask));
+        }
+        if(bytes > 0){ // remaining whole words with a masked load/store
+            const __mmask64 tail = (__mmask64)((1ULL << (bytes / W * W)) - 1);
+            _mm512_mask_storeu_epi8((void*)out, tail, _mm512_shuffle_epi8(_mm512_maskz_loadu_epi8(tail, (const void*)in), mask));
+        }
+    }
+    #endif
+
+
+    #ifdef SPI_ENDIAN_NEON
+    template<size_t W>
+    static void swapNEON(const void* src, void* dst, size_t count){
+        const uint8_t* in = static_cast<const uint8_t*>(src);
+        uint8_t* out = static_cast<uint8_t*>(dst);
+        size_t bytes = count * W;
+        for(; bytes >= 16; bytes -= 16, in += 16, out += 16){
+            const uint8x16_t v = vld1q_u8(in);
+            if constexpr (W == 2) vst1q_u8(out, vrev16q_u8(v));
+            else if constexpr (W == 4) vst1q_u8(out, vrev32q_u8(v));
+            else vst1q_u8(out, vrev64q_u8(v));
+        }
+        swapScalar<W>(in, out, bytes / W);
+    }
+    #endif
+
+
+    /** Kernels for 2, 4 and 8 byte words selected once for the CPU. */
+    struct Dispatch {
+        EndianSimd simd = EndianSimd::SCALAR;
+        BulkSwap swap2 = &swapScalar<2>;
+        BulkSwap swap4 = &swapScalar<4>;
+        BulkSwap swap8 = &swapScalar<8>;
+
+        Dispatch(){
+            #if defined(SPI_ENDIAN_X86)
+            __builtin_cpu_init();
+            if(__builtin_cpu_supports("avx512bw")){
+                set<EndianSimd::AVX512>(&swapAVX512<2>, &swapAVX512<4>, &swapAVX512<8>);
+            } else if(__builtin_cpu_supports("avx2")){
+                set<EndianSimd::AVX2>(&swapAVX2<2>, &swapAVX2<4>, &swapAVX2<8>);
+            } else if(__builtin_cpu_supports("ssse3")){
+                set<EndianSimd::SSSE3>(&swapSSSE3<2>, &swapSSSE3<4>, &swapSSSE3<8>);
+            }
+            #elif defined(SPI_ENDIAN_NEON)
+            set<EndianSimd::NEON>(&swapNEON<2>, &swapNEON<4>, &swapNEON<8>);
+            #endif
+        }
+
+        template<EndianSimd S>
+        void set(BulkSwap s2, BulkSwap s4, BulkSwap s8){
+            simd = S;
+            swap2 = s2;
+            swap4 = s4;
+            swap8 = s8;
+        }
+    };
+
+    static const Dispatch& dispatch(){
+        static const Dispatch instance;
+        return instance;
+    }
+
+    template<typename T>
+    static inline void bulk(const T* src, T* dst, size_t count, bool needsSwap){
+        static_assert(Swappable<T>, "Endian only converts 1, 2, 4 and 8 byte scalars");
+        if(count == 0) return;
+        if(sizeof(T) == 1 || !needsSwap){
+            if(src != dst) std::memmove(dst, src, count * sizeof(T));
+            return;
+        }
+        if constexpr (sizeof(T) == 2) dispatch().swap2(src, dst, count);
+        else if constexpr (sizeof(T) == 4) dispatch().swap4(src, dst, count);
+        else if constexpr (sizeof(T) == 8) dispatch().swap8(src, dst, count);
+    }
+
+
+public:
+
+    /**
+     * Reverses the bytes of a value.
+     */
+    template<typename T>
+    static constexpr T swap(T value) noexcept {
+        static_assert(Swappable<T>, "Endian only converts 1, 2, 4 and 8 byte scalars");
+        if constexpr (sizeof(T) == 1){
+            return value;
+        } else if constexpr (sizeof(T) == 2){
+            return std::bit_cast<T>(__builtin_bswap16(std::bit_cast<uint16_t>(value)));
+        } else if constexpr (sizeof(T) == 4){
+            return std::bit_cast<T>(__builtin_bswap32(std::bit_cast<uint32_t>(value)));
+        } else {
+            return std::bit_cast<T>(__builtin_bswap64(std::bit_cast<uint64_t>(value)));
+        }
+    }
+
+    /** Converts a value from host to big endian (network) byte order. */
+    template<typename T>
+    static constexpr T toBig(T value) noexcept {
+        if constexpr (HOST_IS_BIG) return value; else return swap(value);
+    }
+
+    /** Converts a value from big endian (network) to host byte order. */
+    template<typename T>
+    static constexpr T fromBig(T value) noexcept {
+        return toBig(value);
+    }
+
+    /** Converts a value from host to little endian byte order. */
+    template<typename T>
+    static constexpr T toLittle(T value) noexcept {
+        if constexpr (HOST_IS_LITTLE) return value; else return swap(value);
+    }
+
+    /** Converts a value from little endian to host byte order. */
+    template<typename T>
+    static constexpr T fromLittle(T value) noexcept {
+        return toLittle(value);
+    }
+
+
+    /**
+     * Returns the instruction set used by the bulk conversions on this CPU.
+     */
+    static EndianSimd simd(){
+        return dispatch().simd;
+    }
+
+    /**
+     * Returns the name of the instruction set used by the bulk conversions on this CPU.
+     */
+    static const char* simdName(){
+        switch(simd()){
+            case EndianSimd::SSSE3: return "SSSE3";
+            case EndianSimd::AVX2: return "AVX2";
+            case EndianSimd::AVX512: return "AVX-512";
+            case EndianSimd::NEON: return "NEON";
+            default: return "scalar";
+        }
+    }
+
+
+    /**
+     * Reverses the bytes of every value (in place).
+     */
+    template<typename T>
+    static void swap(std::span<T> values){
+        bulk<T>(values.data(), values.data(), values.size(), true);
+    }
+
+    /**
+     * Writes the values with reversed bytes into dst.
+     * Buffers must either be identical or not overlap, dst must hold at least src.size() values.
+     */
+    template<typename T>
+    static void swap(std::type_identity_t<std::span<const T>> src, std::span<T> dst){
+        bulk<T>(src.data(), dst.data(), src.size(), true);
+    }
+
+    /** Converts all values from host to big endian (network) byte order (in place). */
+    template<typename T>
+    static void toBig(std::span<T> values){
+        bulk<T>(values.data(), values.data(), values.size(), HOST_IS_LITTLE);
+    }
+
+    /** Converts all values from host to big endian (network) byte order into dst (see swap()). */
+    template<typename T>
+    static void toBig(std::type_identity_t<std::span<const T>> src, std::span<T> dst){
+        bulk<T>(src.data(), dst.data(), src.size(), HOST_IS_LITTLE);
+    }
+
+    /** Converts all values from big endian (network) to host byte order (in place). */
+    template<typename T>
+    static void fromBig(std::span<T> values){
+        toBig(values);
+    }
+
+    /** Converts all values from big endian (network) to host byte order into dst (see swap()). */
+    template<typename T>
+    static void fromBig(std::type_identity_t<std::span<const T>> src, std::span<T> dst){
+        toBig(src, dst);
+    }
+
+    /** Converts all values from host to little endian byte order (in place). */
+    template<typename T>
+    static void toLittle(std::span<T> values){
+        bulk<T>(values.data(), values.data(), values.size(), HOST_IS_BIG);
+    }
+
+    /** Converts all values from host to little endian byte order into dst (see swap()). */
+    template<typename T>
+    static void toLittle(std::type_identity_t<std::span<const T>> src, std::span<T> dst){
+        bulk<T>(src.data(), dst.data(), src.size(), HOST_IS_BIG);
+    }
+
+    /** Converts all values from little endian to host byte order (in place). */
+    template<typename T>
+    static void fromLittle(std::span<T> values){
+        toLittle(values);
+    }
+
+    /** Converts all values from little endian to host byte order into dst (see swap()). */
+    template<typename T>
+    static void fromLittle(std::type_identity_t<std::span<const T>> src, std::span<T> dst){
+        toLittle(src, dst);
+    }
+};
+
+
+
+}
+
+#endif // SPI_ENDIAN_HPP
@@ -0,0 +1,256 @@
+/**
+ * Safe memory reclamation for lock-free data structures: epoch-based reclamation
+ * with per-thread retire lists and tagged pointers for ABA-safe exchanges.
+ *
+ * @file EpochReclamation.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+#ifndef SPI_EPOCH_RECLAMATION_HPP
+#define SPI_EPOCH_RECLAMATION_HPP
+
+#include "./HardwareUtils.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/** Amount of objects a thread retires before it tries to free the ones no thread can read anymore. */
+#ifndef SPI_EPOCH_RETIRE_THRESHOLD
+#define SPI_EPOCH_RETIRE_THRESHOLD 64
+#endif
+
+namespace spi {
+
+
+/**
+ * Pointer together with a tag that changes whenever the pointer gets exchanged.
+ */
+template<typename T>
+struct TaggedPointer {
+    T* ptr = nullptr;
+    uint64_t tag = 0;
+
+    bool operator==(const TaggedPointer &other) const noexcept {
+        return this->ptr == other.ptr && this->tag == other.tag;
+    }
+};
+
+
+/**
+ * Atomic TaggedPointer that gets compared and exchanged as a whole with a double-width CAS
+ * (libatomic uses cmpxchg16b where the CPU supports it, otherwise a lock).
+ * Every successful exchange increments the tag, so a thread holding a stale value
+ * cannot exchange it even if the same pointer got stored again in the meantime (ABA).
+ * Only protects the exchange itself, reading through a stale pointer still requires
+ * the object to stay allocated (e.g. recycled but never freed, or EpochReclamation).
+ */
+template<typename T>
+class AtomicTaggedPointer {
+protected:
+    alignas(2 * sizeof(void*)) std::atomic<TaggedPointer<T>> value;
+
+public:
+    AtomicTaggedPointer(T* ptr = nullptr) noexcept : value(TaggedPointer<T>{ptr, 0}) {}
+
+    inline TaggedPointer<T> load(std::memory_order order = std::memory_order_seq_cst) const noexcept {
+        return this->value.load(order);
+    }
+
+    /**
+     * Replaces expected with desired (and the incremented tag of expected) if it is still current.
+     * Otherwise expected gets updated to the current value.
+     */
+    inline bool compareExchange(TaggedPointer<T> &expected, T* desired,
+                                std::memory_order success = std::memory_order_seq_cst,
+                                std::memory_order failure = std::memory_order_seq_cst) noexcept {
+        return this->value.compare_exchange_weak(expected, TaggedPointer<T>{desired, expected.tag + 1}, success, failure);
+    }
+};
+
+
+/**
+ * Epoch-based reclamation shared by all lock-free structures of the process.
+ *
+ * Threads pin the current epoch with a Guard while they read shared nodes. Nodes unlinked from a
+ * structure get retired instead of deleted: they go to a list of the retiring thread together
+ * with the epoch they got retired in. The global epoch only advances once every pinned thread
+ * observed it, so a node retired in epoch e is freed once the epoch reached e + 2 because
+ * no guard that could have seen the node is left. Pinning is one store and a fence on a
+ * per-thread record, no allocation or shared read-modify-write.
+ *
+ * Threads that exit hand their remaining retired nodes to an orphan list that the other threads free.
+ */
+class EpochReclamation {
+protected:
+
+    /** Per-thread state visible to the other threads. Records are reused by new threads, never freed. */
+    struct Record {
+        alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> state{0}; // (epoch << 1) | 1 while pinned, 0 otherwise
+        std::atomic<bool> used{true};
+        Record* next = nullptr;
+    };
+
+    struct Retired {
+        void* object;
+        void (*deleter)(void*);
+        uint64_t epoch;
+    };
+
+    struct Global {
+        alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> epoch{0};
+        alignas(CACHE_LINE_SIZE) std::atomic<Record*> records{nullptr};
+        std::mutex orphansMutex;
+        std::vector<Retired> orphans; // retired by threads that exited
+    };
+
+    /** Never destroyed so threads may still retire while the process shuts down. */
+    static Global& global(){
+        static Global* global = new Global();
+        return *global;
+    }
+
+    struct Local {
+        Record* record;
+        uint32_t nesting = 0;
+        std::vector<Retired> retired; // in the order (and epochs) they got retired
+
+        Local(){
+            Global& g = global();
+            for(Record* r = g.records.load(std::memory_order_acquire); r != nullptr; r = r->next){
+                bool expected = false;
+                if(!r->used.load(std::memory_order_relaxed) && r->used.compare_exchange_strong(expected, true, std::memory_order_acquire)){
+                    this->record = r;
+                    return;
+                }
+            }
+            this->record = new Record();
+            Record* head = g.records.load(std::memory_order_relaxed);
+            do {
+                this->record->next = head;
+            } while(!g.records.compare_exchange_weak(head, this->record, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        ~Local(){
+            EpochReclamation::collect(this->retired, true);
+            if(!this->retired.empty()){
+                Global& g = global();
+                std::lock_guard<std::mutex> lock(g.orphansMutex);
+                g.orphans.insert(g.orphans.end(), this->retired.begin(), this->retired.end());
+            }
+            this->record->state.store(0, std::memory_order_release);
+            this->record->used.store(false, std::memory_order_release);
+        }
+    };
+
+    static Local& local(){
+        thread_local Local local;
+        return local;
+    }
+
+    /** Advances the global epoch if every pinned thread observed the current one. */
+    static bool tryAdvance(){
+        Global& g = global();
+        std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with enter()
+        uint64_t epoch = g.epoch.load(std::memory_order_relaxed);
+        for(Record* r = g.records.load(std::memory_order_acquire); r != nullptr; r = r->next){
+            const uint64_t state = r->state.load(std::memory_order_relaxed);
+            if((state & 1) != 0 && (state >> 1) != epoch) return false;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return g.epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_acq_rel, std::memory_order_relaxed);
+    }
+
+    /** Frees the prefix of a retire list no thread can read anymore, returns how many got freed. */
+    static size_t collect(std::vector<Retired> &retired, bool advance){
+        if(retired.empty()) return 0;
+        if(advance) tryAdvance();
+        const uint64_t epoch = global().epoch.load(std::memory_order_acquire);
+        size_t count = 0;
+        while(count < retired.size() && retired[count].epoch + 2 <= epoch) count++;
+        if(count == 0) return 0;
+        // taken out before deleting, a deleter may retire further objects
+        std::vector<Retired> expired(retired.begin(), retired.begin() + (std::ptrdiff_t)count);
+        retired.erase(retired.begin(), retired.begin() + (std::ptrdiff_t)count);
+        for(const Retired &entry : expired) entry.deleter(entry.object);
+        return count;
+    }
+
+public:
+
+    /**
+     * Pins the current epoch for the lifetime of the guard. Nodes read from a structure
+     * stay allocated until the guard is destroyed. Guards can be nested.
+     */
+    class Guard {
+    public:
+        Guard() noexcept {
+            EpochReclamation::enter();
+        }
+
+        ~Guard(){
+            EpochReclamation::leave();
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+    };
+
+    static inline void enter() noexcept {
+        Local& l = local();
+        if(l.nesting++ != 0) return;
+        l.record->state.store((global().epoch.load(std::memory_order_relaxed) << 1) | 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst); // pin is visible before any shared node gets read
+    }
+
+    static inline void leave() noexcept {
+        Local& l = local();
+        if(--l.nesting == 0) l.record->state.store(0, std::memory_order_release);
+    }
+
+    /**
+     * Hands an object that got unlinked from a shared structure over for deletion.
+     * It gets deleted once no thread can hold a reference to it anymore.
+     *
+     * @param object Object that no new reader can reach anymore.
+     * @param deleter Function that frees the object.
+     */
+    static void retire(void* object, void (*deleter)(void*)){
+        Local& l = local();
+        l.retired.push_back(Retired{object, deleter, global().epoch.load(std::memory_order_acquire)});
+        if(l.retired.size() >= SPI_EPOCH_RETIRE_THRESHOLD) reclaim();
+    }
+
+    template<typename T>
+    static void retire(T* object){
+        retire(static_cast<void*>(object), [](void* p){ delete static_cast<T*>(p); });
+    }
+
+    /**
+     * Tries to advance the epoch and frees the objects retired by the calling thread
+     * (and by exited threads) that no thread can read anymore.
+     *
+     * @return Amount of objects that got freed.
+     */
+    static size_t reclaim(){
+        size_t freed = collect(local().retired, true);
+        Global& g = global();
+        std::unique_lock<std::mutex> lock(g.orphansMutex, std::try_to_lock);
+        if(lock.owns_lock()) freed += collect(g.orphans, false);
+        return freed;
+    }
+
+    /** Returns the amount of objects retired by the calling thread that were not freed yet. */
+    static size_t getPending(){
+        return local().retired.size();
+    }
+
+    static uint64_t getEpoch() noexcept {
+        return global().epoch.load(std::memory_order_relaxed);
+    }
+};
+
+
+}
+#endif // SPI_EPOCH_RECLAMATION_HPP
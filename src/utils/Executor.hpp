@@ -0,0 +1,135 @@
+/**
+ * Executors that continuations of futures can be scheduled on
+ * (ThreadPool, CallbackQueueThreadSafe, CallbackQueueTwoParty, CallbackQueueTwoPartyInline or user defined).
+ *
+ * @file Executor.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+
+#ifndef SPI_EXECUTOR_HPP
+#define SPI_EXECUTOR_HPP
+
+#include "./Task.hpp"
+
+#include <concepts>
+#include <memory>
+#include <utility>
+
+namespace spi {
+
+
+
+/**
+ * User defined executor that runs tasks handed to enqueue().
+ * Can optionally provide `bool runsOnCurrentThread()` to allow inline execution.
+ */
+template<typename E>
+concept UserExecutor = requires(E& executor, Task task){
+    executor.enqueue(std::move(task));
+};
+
+/** Executor that accepts tasks through submitTask() (e.g. ThreadPool). */
+template<typename E>
+concept PoolExecutor = !UserExecutor<E> && requires(E& executor, Task task){
+    executor.submitTask(std::move(task));
+};
+
+/** Stands for a callback that captures state (used to check which callback queues can store continuations). */
+struct CapturingCallback {
+    void* capture;
+    bool operator()() const { return true; }
+};
+
+/**
+ * Callback queue whose callbacks take no arguments and return true once done
+ * (e.g. CallbackQueueThreadSafe<std::function<bool()>>). Queues that only
+ * accept plain function pointers cannot carry a continuation and do not qualify.
+ */
+template<typename E>
+concept CallbackQueueExecutor = !UserExecutor<E> && !PoolExecutor<E> && requires(E& executor, CapturingCallback callback){
+    executor.push(callback);
+    executor.execute();
+};
+
+/** Anything a future continuation can be scheduled on. */
+template<typename E>
+concept Executor = UserExecutor<E> || PoolExecutor<E> || CallbackQueueExecutor<E>;
+
+
+/**
+ * Remembers which executor is running the current continuation
+ * so continuations for the same executor can run inline instead of being queued again.
+ */
+class ExecutorContext {
+protected:
+    inline static thread_local const void* current = nullptr;
+
+public:
+
+    /** Marks the calling thread as running tasks of an executor until destructed. */
+    class Scope {
+        const void* previous;
+    public:
+        Scope(const void* executor) noexcept : previous(ExecutorContext::current) {
+            ExecutorContext::current = executor;
+        }
+        ~Scope() noexcept {
+            ExecutorContext::current = this->previous;
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    /**
+     * Returns if the calling thread is currently running a task of the given executor.
+     *
+     * @param executor Executor to check.
+     * @return true if task can run inline, false if it has to be handed to the executor.
+     */
+    template<typename E>
+    static bool isCurrent(E& executor) noexcept {
+        if constexpr (requires { { executor.runsOnCurrentThread() } -> std::convertible_to<bool>; }){
+            if(executor.runsOnCurrentThread()) return true;
+        }
+        return ExecutorContext::current == static_cast<const void*>(&executor);
+    }
+};
+
+
+/**
+ * Executes the task on the given executor with at most one enqueue.
+ * If the calling thread is already running on the executor the task is executed inline.
+ *
+ * @param executor Executor that should run the task.
+ * @param task Task to execute.
+ */
+template<typename E> requires Executor<E>
+void executeOn(E& executor, Task task){
+    if(ExecutorContext::isCurrent(executor)){
+        task();
+        return;
+    }
+    auto run = [&executor](Task& task){
+        ExecutorContext::Scope scope(&executor);
+        task();
+    };
+    if constexpr (UserExecutor<E>){
+        executor.enqueue(Task(std::move(run), std::move(task)));
+    } else if constexpr (PoolExecutor<E>){
+        executor.submitTask(std::move(run), std::move(task));
+    } else {
+        // callback queues may copy their callbacks (std::function) so the move-only task cannot be captured by value,
+        // the queued callback owns it and frees it even if the queue gets destroyed without executing it
+        std::shared_ptr<Task> pending = std::make_shared<Task>(std::move(task));
+        executor.push([run, pending = std::move(pending)]{
+            run(*pending);
+            return true;
+        });
+    }
+}
+
+
+
+}
+
+#endif // SPI_EXECUTOR_HPP
@@ -0,0 +1,983 @@
+/**
+ * Compiles a flow representation (see "FlowRepresentation.hpp") into
+ * stages that are connected by queues and executed on a ThreadPool.
+ *
+ * @file Flow.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+
+#ifndef SPI_FLOW_HPP
+#define SPI_FLOW_HPP
+
+#include "./CountingLock.hpp"
+#include "./FlowRepresentation.hpp"
+#include "./Lock.hpp"
+#include "./QueueAdapter.hpp"
+#include "./ShardedCounter.hpp"
+#include "./Thread.hpp"
+#include "./Trace.hpp"
+#include "./Tuple.hpp"
+#include "./TupleBatch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace spi {
+
+
+
+/**
+ * What producers do when the stage they push to has no credits left (see Flow::setBackpressure()).
+ * Pool workers never block: a stage whose downstream stage is full (BLOCK or SPIN) parks until credits get returned.
+ */
+enum class FlowBackpressure {
+    BLOCK, // threads pushing into the flow wait on the credit counter until the stage made room
+    SPIN,  // threads pushing into the flow busy wait until the stage made room (lowest latency, burns a core)
+    DROP,  // tuples that do not fit get dropped (counted in FlowStageMetrics::dropped)
+};
+
+
+
+/**
+ * Snapshot of the queue and backpressure metrics of a flow stage.
+ */
+struct FlowStageMetrics {
+    std::string name;     // kind of stage and operators it runs
+    size_t queued;        // current queue depth (tuples, parts for ordered shards and reorder stages)
+    size_t capacity;      // credits of the stage (0 if unbounded)
+    uint64_t stalls;      // how often producers had to wait for credits of this stage
+    uint64_t stallNanos;  // time producers waited for credits of this stage in total
+    uint64_t dropped;     // tuples dropped because the stage had no credits left
+};
+
+
+
+/**
+ * Executable version of a flow.
+ *
+ * Linear chains of operators (e.g. FlowInput -> FlowFilter -> FlowFilter -> FlowOutput) get fused into one stage
+ * that runs all filters back to back on the same batch, queues only remain in front of inputs and merges.
+ * Filters work on the batch in column layout (see TupleBatch) and shrink it to the tuples that passed.
+ * With fusion disabled every operator becomes a stage of its own (useful to measure the queue overhead).
+ * Stages with a single upstream stage use a two-party queue, inputs and merges use a MPMC queue.
+ * Whenever tuples get queued the stage is submitted as task to the ThreadPool, the task then
+ * processes the queued tuples in batches and hands the result to the queue of the next stage.
+ * At most one task per stage runs at any time so operators never run concurrently with themselves.
+ *
+ * A FlowPartition gets executed by the stage in front of it, which routes every batch by key to one stage per shard.
+ * Shards run in parallel (spread over the NUMA nodes of the pool) and feed a recombining stage
+ * that either merges them as they come or restores the input order (ordered partitions).
+ *
+ * Stages can be bounded with credits (see setBackpressure()): a stage owns a CountingLockFetch with one credit per
+ * tuple it may have queued, producers acquire credits before enqueueing and the stage returns them once it popped
+ * the tuples. A stage reserves credits of its downstream stage before it takes a batch and parks if there are
+ * none, the downstream stage resumes it when it returns credits. So memory and latency stay bounded and the
+ * backpressure propagates up to the threads pushing into the flow, which block, spin or drop per input policy.
+ *
+ * Tuples are pushed with push()/pushBulk() and delivered to the subscribers of the FlowOutput.
+ */
+class Flow {
+public:
+    typedef std::function<void(const Tuple&)> Subscriber;
+
+    /** Default amount of tuples a stage processes at once. */
+    static constexpr size_t DEFAULT_BATCH_SIZE = 256;
+
+    /** Batches a stage processes before it hands its worker to other stages. */
+    static constexpr size_t BATCHES_PER_TASK = 16;
+
+protected:
+    class TupleStage;
+    class Partitioner;
+
+    /**
+     * Where a stage hands the tuples that passed it: the queue of the next stage,
+     * the shards of a partition or (if neither is set) the subscribers of the output.
+     */
+    struct Target {
+        TupleStage* stage = nullptr;
+        Partitioner* partitioner = nullptr;
+    };
+
+    /**
+     * Part of a batch that an ordered partition routed to one shard.
+     */
+    struct ShardBatch {
+        uint64_t sequence;   // batch of the partition this part belongs to
+        uint32_t total;      // tuples in the whole batch of the partition
+        TupleBatch columns;  // tuples of this shard together with their row in the batch of the partition
+    };
+
+
+    /**
+     * Operator(s) of the flow together with an input queue. Takes care of scheduling:
+     * the stage gets submitted to the pool when items get queued and runs until its queue is empty.
+     */
+    class Stage {
+        friend class Flow;
+    protected:
+        /** Returned by process() if the stage has to wait for credits of a downstream stage. */
+        static constexpr size_t STALLED = ~(size_t)0;
+
+        Flow* flow;
+        int numaNode; // NUMA node whose workers should run the stage (-1 for any)
+        std::string name;
+        std::vector<const FlowOperator*> operators; // operators the stage runs (see setBackpressure())
+        alignas(CACHE_LINE_SIZE) std::atomic<int64_t> queued{0};
+        alignas(CACHE_LINE_SIZE) std::atomic<bool> scheduled{false};
+
+        // backpressure (credits are set up before tuples get pushed)
+        std::unique_ptr<CountingLockFetch> credits; // one credit per queued tuple, nullptr if unbounded
+        FlowBackpressure policy = FlowBackpressure::BLOCK;
+        std::vector<Stage*> upstream;               // stages that reserve credits of this stage
+        alignas(CACHE_LINE_SIZE) std::atomic<bool> parked{false};
+        Stage* stalledOn = nullptr;                 // downstream stage without credits (only touched by the running task)
+        size_t stalledCount = 0;
+        std::chrono::steady_clock::time_point stalledSince;
+        std::atomic<uint64_t> stalls{0};
+        std::atomic<uint64_t> stallNanos{0};
+        std::atomic<uint64_t> dropped{0};
+
+        /**
+         * Processes up to one batch of queued items.
+         *
+         * @param available Amount of items that are at least queued.
+         * @return size_t Amount of items taken from the queue (0 if the queue was empty)
+         *                or STALLED if a downstream stage has no credits (stalledOn and stalledCount are set).
+         */
+        virtual size_t process(size_t available) = 0;
+
+        /** Returns true if the stage has work besides its queue (e.g. results waiting for credits). */
+        virtual bool hasBacklog() const {
+            return false;
+        }
+
+        /** Returns false if the queue of the stage must stay unbounded (see setBackpressure()). */
+        virtual bool isBoundable() const {
+            return true;
+        }
+
+        /**
+         * Parks the stage until stalledOn returns credits. Returns true if the credits are already back
+         * and the stage should continue right away.
+         */
+        bool park(){
+            this->parked.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with releaseCredits()
+            if(this->stalledOn->hasCredits(this->stalledCount) && this->parked.exchange(false)) return true;
+            return false; // releaseCredits() of stalledOn resubmits the stage
+        }
+
+        /** Accounts the time the stage was parked to the stage it waited for. */
+        void unstall(){
+            if(this->stalledOn == nullptr) return;
+            this->stalledOn->recordStall(std::chrono::steady_clock::now() - this->stalledSince);
+            this->stalledOn = nullptr;
+        }
+
+        void submit(){
+            this->flow->tasks.fetch_add(1, std::memory_order_relaxed);
+            auto task = [this]{
+                Flow* flow = this->flow;
+                this->run();
+                flow->tasks.fetch_sub(1, std::memory_order_release); // last access, the flow may get destroyed afterwards
+            };
+            if(this->numaNode >= 0) this->flow->pool.submitTask(this->numaNode, std::move(task));
+            else this->flow->pool.submitTask(std::move(task));
+        }
+
+        /**
+         * Processes queued items. Resubmits itself after BATCHES_PER_TASK batches
+         * so a busy stage does not starve the other stages of the flow.
+         */
+        void run(){
+            SPI_TRACE_SCOPE("Flow::stage");
+            for(size_t round=0; round < BATCHES_PER_TASK; round++){
+                const int64_t available = this->queued.load();
+                const size_t taken = available > 0 || this->hasBacklog() ? this->process((size_t)std::max((int64_t)0, available)) : 0;
+                if(taken == STALLED){
+                    if(this->stalledOn != nullptr && this->stalledSince == std::chrono::steady_clock::time_point())
+                        this->stalledSince = std::chrono::steady_clock::now();
+                    if(!this->park()) return; // stays scheduled while parked
+                    continue;
+                }
+                this->unstall();
+                this->stalledSince = std::chrono::steady_clock::time_point();
+                if(taken == 0){
+                    this->scheduled.store(false); // pairs with notify(): either we see the items or the producer reschedules
+                    if(this->queued.load() <= 0 || this->scheduled.exchange(true)) return;
+                    continue;
+                }
+                this->queued.fetch_sub((int64_t)taken);
+            }
+            this->submit(); // still scheduled, continue later
+        }
+
+        /** Counts items that just got queued and makes sure a task processes them. */
+        void notify(size_t count){
+            this->queued.fetch_add((int64_t)count);
+            if(!this->scheduled.exchange(true)) this->submit();
+        }
+
+    public:
+        Stage(Flow* flow, int numaNode, std::string name) : flow(flow), numaNode(numaNode), name(std::move(name)) {}
+
+        virtual ~Stage() = default;
+
+        /** Returns true if producers are allowed to drop tuples instead of waiting for credits. */
+        inline bool dropping() const noexcept {
+            return this->credits != nullptr && this->policy == FlowBackpressure::DROP;
+        }
+
+        /** Returns true if the stage could take count more tuples right now. */
+        inline bool hasCredits(size_t count) const {
+            return this->credits == nullptr || count == 0 ||
+                   this->credits->getCounter() <= this->credits->getMaximum() - (int32_t)count;
+        }
+
+        /** Takes credits for count tuples without blocking (always succeeds if the stage is unbounded). */
+        inline bool tryAcquire(size_t count){
+            return this->credits == nullptr || count == 0 || this->credits->acquire((int32_t)count, false);
+        }
+
+        /** Returns credits (tuples left the queue or a reservation was not needed) and resumes parked upstream stages. */
+        void releaseCredits(size_t count){
+            if(this->credits == nullptr || count == 0) return;
+            this->credits->release((int32_t)count);
+            std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with park()
+            for(Stage* stage : this->upstream){
+                if(stage->parked.load(std::memory_order_relaxed) && stage->parked.exchange(false)) stage->submit();
+            }
+        }
+
+        /** Accounts time a producer waited for credits of this stage. */
+        void recordStall(std::chrono::steady_clock::duration waited){
+            this->stalls.fetch_add(1, std::memory_order_relaxed);
+            this->stallNanos.fetch_add((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count(), std::memory_order_relaxed);
+        }
+
+        /** Accounts tuples that got dropped because this stage had no credits. */
+        void recordDrop(size_t count){
+            this->dropped.fetch_add(count, std::memory_order_relaxed);
+            this->flow->droppedTuples.add(count);
+        }
+
+        /**
+         * Bounds the queue of the stage.
+         *
+         * @param capacity Tuples the stage may have queued (0 for unbounded).
+         * @param policy What producers do if the stage is full.
+         */
+        void setCredits(size_t capacity, FlowBackpressure policy){
+            this->credits = capacity == 0 ? nullptr : std::make_unique<CountingLockFetch>((int32_t)capacity, false, true);
+            this->policy = policy;
+        }
+
+        FlowStageMetrics getMetrics() const {
+            return FlowStageMetrics{this->name, (size_t)std::max((int64_t)0, this->queued.load(std::memory_order_relaxed)),
+                                    this->credits == nullptr ? 0 : (size_t)this->credits->getMaximum(),
+                                    this->stalls.load(std::memory_order_relaxed), this->stallNanos.load(std::memory_order_relaxed),
+                                    this->dropped.load(std::memory_order_relaxed)};
+        }
+    };
+
+
+    /**
+     * Stage that receives tuples and applies a chain of fused filters to them.
+     */
+    class TupleStage : public Stage {
+    protected:
+        std::vector<const FlowFilterBase*> filters; // applied in order (empty if tuples pass unchanged)
+        Target target;
+        std::vector<Tuple> batch;     // only touched by the running task
+        TupleBatch columns;           // batch in column layout for the filters (only touched by the running task)
+
+        /** Pushes tuples into the input queue. */
+        virtual void pushQueue(const Tuple* tuples, size_t count) = 0;
+
+        /** Pops up to max tuples from the input queue. */
+        virtual size_t popQueue(Tuple* tuples, size_t max) = 0;
+
+        size_t process(size_t available) override {
+            const size_t max = std::min(available, this->batch.size());
+            if(Stage* lacking = this->flow->reserve(this->target, max)){
+                this->stalledOn = lacking;
+                this->stalledCount = max;
+                return STALLED;
+            }
+            const size_t count = this->popQueue(this->batch.data(), max);
+            if(count == 0){
+                this->flow->forward(this->target, this->batch.data(), 0, max); // hands the reservation back
+                return 0;
+            }
+            this->releaseCredits(count);
+            size_t passed = count;
+            if(!this->filters.empty()){
+                this->columns.assign(this->batch.data(), count);
+                for(const FlowFilterBase* filter : this->filters){
+                    if((passed = filter->apply(this->columns)) == 0) break;
+                }
+                this->columns.materialize(this->batch.data());
+            }
+            this->flow->finished(count - passed);
+            this->flow->forward(this->target, this->batch.data(), passed, max);
+            return count;
+        }
+
+    public:
+        TupleStage(Flow* flow, int numaNode, std::string name, std::vector<const FlowFilterBase*> filters, Target target) :
+                Stage(flow, numaNode, std::move(name)), filters(std::move(filters)), target(target), batch(flow->batchSize), columns(flow->batchSize) {}
+
+        /**
+         * Queues tuples and makes sure a task processes them.
+         * Tuples must already be counted as in flight and their credits must be acquired.
+         */
+        void enqueue(const Tuple* tuples, size_t count){
+            this->pushQueue(tuples, count);
+            this->notify(count);
+        }
+    };
+
+    /**
+     * Stage whose input queue is of type Q.
+     */
+    template<typename Q>
+    class QueueStage : public TupleStage {
+    protected:
+        Q queue;
+        QueueAdapter<Q> adapter;
+
+        void pushQueue(const Tuple* tuples, size_t count) override {
+            this->adapter.pushBulk(tuples, count);
+        }
+
+        size_t popQueue(Tuple* tuples, size_t max) override {
+            return this->adapter.popBulk(tuples, max);
+        }
+
+    public:
+        QueueStage(Flow* flow, int numaNode, std::string name, std::vector<const FlowFilterBase*> filters, Target target) :
+                TupleStage(flow, numaNode, std::move(name), std::move(filters), target), adapter(queue) {}
+    };
+
+    typedef QueueStage<QueueTwoPartyAtomic<Tuple>> SingleSourceStage;  // one upstream stage at a time
+    typedef QueueStage<moodycamel::ConcurrentQueue<Tuple>> MultiSourceStage; // inputs, merges and recombined shards
+    typedef QueueStage<moodycamel::ConcurrentQueue<Tuple>> ShardStage; // receives whole sub-batches from a partition (bulk enqueue pays off)
+
+
+    /**
+     * Recombines the shards of an ordered partition: collects the parts of every batch of the partition
+     * and forwards the tuples that passed the shards in the order they had in the batch.
+     * Has no credits of its own, the parts it waits for are bounded by the credits of the shards.
+     */
+    class ReorderStage : public Stage {
+    protected:
+        size_t parts;          // one part per shard and batch
+        Target target;
+        Partitioner* partitioner;
+        moodycamel::ConcurrentQueue<ShardBatch*> queue;
+        QueueAdapter<moodycamel::ConcurrentQueue<ShardBatch*>> adapter;
+        std::unordered_map<uint64_t, std::vector<ShardBatch*>> pending; // only touched by the running task
+        uint64_t nextSequence = 0;
+        std::vector<ShardBatch*> popped;
+        std::vector<Tuple> merged;
+        std::vector<uint8_t> present;
+        bool stalled = false;
+
+        /** Restores the order of a complete batch and forwards it, returns false if the target has no credits. */
+        bool release(std::vector<ShardBatch*> &batch){
+            size_t tuples = 0;
+            for(const ShardBatch* part : batch) tuples += part->columns.size();
+            if(Stage* lacking = this->flow->reserve(this->target, tuples)){
+                this->stalledOn = lacking;
+                this->stalledCount = tuples;
+                return false;
+            }
+            const uint32_t total = batch.front()->total;
+            this->merged.resize(total);
+            this->present.assign(total, 0);
+            for(const ShardBatch* part : batch){
+                const uint32_t* values = part->columns.valueColumn();
+                const uint32_t* rows = part->columns.rowColumn();
+                for(size_t i=0; i < part->columns.size(); i++){
+                    this->merged[rows[i]] = Tuple(values[i]);
+                    this->present[rows[i]] = 1;
+                }
+            }
+            size_t count = 0;
+            for(uint32_t row=0; row < total; row++)
+                if(this->present[row]) this->merged[count++] = this->merged[row];
+            for(ShardBatch* part : batch) this->partitioner->recycle(part);
+            this->flow->forward(this->target, this->merged.data(), count, tuples);
+            return true;
+        }
+
+        size_t process(size_t available) override {
+            const size_t count = available == 0 ? 0 : this->adapter.popBulk(this->popped.data(), std::min(available, this->popped.size()));
+            for(size_t i=0; i < count; i++) this->pending[this->popped[i]->sequence].push_back(this->popped[i]);
+            this->stalled = false;
+            for(auto it = this->pending.find(this->nextSequence); it != this->pending.end() && it->second.size() == this->parts;
+                    it = this->pending.find(this->nextSequence)){
+                if(!this->release(it->second)){
+                    this->stalled = true;
+                    return count == 0 ? STALLED : count;
+                }
+                this->pending.erase(it);
+                this->nextSequence++;
+            }
+            return count;
+        }
+
+        bool hasBacklog() const override {
+            return this->stalled;
+        }
+
+        bool isBoundable() const override {
+            return false; // only holds what the shards already let through
+        }
+
+    public:
+        ReorderStage(Flow* flow, size_t parts, Target target, Partitioner* partitioner) :
+                Stage(flow, -1, "reorder"), parts(parts), target(target), partitioner(partitioner), adapter(queue), popped(std::max((size_t)64, parts)) {}
+
+        /** Queues a part that went through its shard (its tuples must already be counted as in flight). */
+        void enqueue(ShardBatch* part){
+            this->adapter.push(part);
+            this->notify(1);
+        }
+    };
+
+    /**
+     * Shard of an ordered partition, applies its filters to one part at a time and keeps the row of every tuple.
+     */
+    class OrderedShardStage : public Stage {
+    protected:
+        std::vector<const FlowFilterBase*> filters;
+        ReorderStage* reorder;
+        QueueTwoPartyAtomic<ShardBatch*> queue; // fed by the stage in front of the partition only
+        QueueAdapter<QueueTwoPartyAtomic<ShardBatch*>> adapter;
+
+        size_t process(size_t) override {
+            ShardBatch* part;
+            if(!this->adapter.pop(part)) return 0;
+            const size_t count = part->columns.size();
+            this->releaseCredits(count);
+            size_t passed = count;
+            for(const FlowFilterBase* filter : this->filters){
+                if((passed = filter->apply(part->columns)) == 0) break;
+            }
+            this->flow->finished(count - passed);
+            this->reorder->enqueue(part);
+            return 1;
+        }
+
+    public:
+        OrderedShardStage(Flow* flow, int numaNode, std::string name, std::vector<const FlowFilterBase*> filters, ReorderStage* reorder) :
+                Stage(flow, numaNode, std::move(name)), filters(std::move(filters)), reorder(reorder), adapter(queue) {}
+
+        /** Queues a part of a batch (its tuples must already be counted as in flight and their credits acquired). */
+        void enqueue(ShardBatch* part){
+            this->adapter.push(part);
+            this->notify(1);
+        }
+    };
+
+
+    /**
+     * Routes the tuples a stage hands to a FlowPartition to the stages of the shards.
+     * Only called by the one stage in front of the partition.
+     */
+    class Partitioner {
+        friend class Flow;
+    protected:
+        Flow* flow;
+        const FlowPartitionBase* partition;
+        std::vector<TupleStage*> shards;               // unordered partitions
+        std::vector<OrderedShardStage*> orderedShards; // ordered partitions
+        ReorderStage* reorder = nullptr;
+        std::vector<uint32_t> routes;
+        std::vector<std::vector<Tuple>> buffers;       // tuples per shard (unordered partitions)
+        uint64_t sequence = 0;
+        std::vector<ShardBatch*> parts;                // parts of the current batch (ordered partitions)
+        std::vector<std::unique_ptr<ShardBatch>> allocated;
+        moodycamel::ConcurrentQueue<ShardBatch*> recycled;
+
+        ShardBatch* acquire(){
+            ShardBatch* part;
+            if(this->recycled.try_dequeue(part)) return part;
+            this->allocated.push_back(std::make_unique<ShardBatch>());
+            return this->allocated.back().get();
+        }
+
+        Stage* shard(size_t index) const {
+            return this->reorder == nullptr ? (Stage*)this->shards[index] : (Stage*)this->orderedShards[index];
+        }
+
+        /** Takes credits for the tuples routed to a shard, returns false if they got dropped instead. */
+        bool admit(size_t index, size_t count, size_t reserved){
+            Stage* stage = this->shard(index);
+            if(!stage->dropping()){
+                stage->releaseCredits(reserved - count);
+                return true;
+            }
+            if(stage->tryAcquire(count)) return true;
+            stage->recordDrop(count);
+            return false;
+        }
+
+    public:
+        Partitioner(Flow* flow, const FlowPartitionBase* partition) : flow(flow), partition(partition), buffers(partition->getParallelism()) {}
+
+        /**
+         * Reserves credits for count tuples at every shard (it is not known yet where they go),
+         * returns the first shard without credits or nullptr. Shards that drop are not reserved.
+         */
+        Stage* reserve(size_t count){
+            const size_t shards = this->partition->getParallelism();
+            for(size_t i=0; i < shards; i++){
+                Stage* stage = this->shard(i);
+                if(stage->dropping() || stage->tryAcquire(count)) continue;
+                for(size_t j=0; j < i; j++) if(!this->shard(j)->dropping()) this->shard(j)->releaseCredits(count);
+                return stage;
+            }
+            return nullptr;
+        }
+
+        void setShards(std::vector<TupleStage*> shards){
+            this->shards = std::move(shards);
+        }
+
+        void setShards(std::vector<OrderedShardStage*> shards, ReorderStage* reorder){
+            this->orderedShards = std::move(shards);
+            this->reorder = reorder;
+        }
+
+        /**
+         * Splits tuples by key and queues them at their shards.
+         *
+         * @param reserved Credits reserved at every shard with reserve() (unused ones get returned).
+         */
+        void route(const Tuple* tuples, size_t count, size_t reserved){
+            if(count == 0){
+                for(size_t shard=0; shard < this->partition->getParallelism(); shard++) this->admit(shard, 0, reserved);
+                return;
+            }
+            this->routes.resize(count);
+            this->partition->route(tuples, count, this->routes.data());
+            if(this->reorder == nullptr){
+                for(size_t i=0; i < count; i++) this->buffers[this->routes[i]].push_back(tuples[i]);
+                for(size_t shard=0; shard < this->buffers.size(); shard++){
+                    std::vector<Tuple> &buffer = this->buffers[shard];
+                    if(this->admit(shard, buffer.size(), reserved)){
+                        if(!buffer.empty()) this->shards[shard]->enqueue(buffer.data(), buffer.size());
+                    } else {
+                        this->flow->finished(buffer.size());
+                    }
+                    buffer.clear();
+                }
+                return;
+            }
+
+            this->parts.resize(this->orderedShards.size());
+            for(ShardBatch* &part : this->parts){
+                part = this->acquire();
+                part->sequence = this->sequence;
+                part->total = (uint32_t)count;
+                part->columns.clear();
+            }
+            for(size_t i=0; i < count; i++) this->parts[this->routes[i]]->columns.append(tuples[i], (uint32_t)i);
+            for(size_t shard=0; shard < this->parts.size(); shard++){
+                ShardBatch* part = this->parts[shard];
+                if(!this->admit(shard, part->columns.size(), reserved)){
+                    this->flow->finished(part->columns.size());
+                    part->columns.clear(); // the reorder stage still needs the part to complete the batch
+                }
+                if(part->columns.empty()) this->reorder->enqueue(part); // nothing to do for the shard
+                else this->orderedShards[shard]->enqueue(part);
+            }
+            this->sequence++;
+        }
+
+        /** Hands a part back once the reorder stage is done with it. */
+        void recycle(ShardBatch* part){
+            this->recycled.enqueue(part);
+        }
+    };
+
+
+    std::unique_ptr<FlowOutput> output;
+    ThreadPool& pool;
+    size_t batchSize;
+    bool fuse;
+    std::vector<Stage*> stages;
+    std::vector<Partitioner*> partitioners;
+    std::unordered_map<const FlowOperator*, TupleStage*> inputs;
+    std::vector<Subscriber> subscribers;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<int64_t> inFlight{0}; // tuples that are queued or being processed
+    ShardedCounter<uint64_t> tuplesIn;
+    ShardedCounter<uint64_t> tuplesOut;
+    ShardedCounter<uint64_t> droppedTuples; // dropped due to backpressure (not by filters)
+    alignas(CACHE_LINE_SIZE) std::atomic<int64_t> tasks{0};          // submitted stage tasks that did not return yet
+
+    /** Describes the operators of a stage for FlowStageMetrics::name. */
+    static std::string describe(const std::string &kind, const std::vector<const FlowFilterBase*> &filters){
+        return filters.empty() ? kind : kind + " + " + std::to_string(filters.size()) + (filters.size() == 1 ? " filter" : " filters");
+    }
+
+    /** Remembers which stage feeds a target so the target can resume it once it returns credits. */
+    void connect(Stage* stage, const Target &target);
+
+    /**
+     * Creates the stage that ends with the given operator and recursively the stages of its sources.
+     * Walks upstream through filters until an operator is reached that needs a queue in front (input, merge or
+     * the shards behind a partition), that operator becomes the head of the stage.
+     * Without fusion every operator is the head of its own stage.
+     */
+    void compile(FlowOperator* op, Target target){
+        std::vector<const FlowFilterBase*> filters;
+        FlowOperator* head = op;
+        while(true){
+            if(head->getType() == FlowOperatorType::JOIN) throw std::invalid_argument("FlowJoin cannot be executed yet");
+            if(head->getType() == FlowOperatorType::FILTER) filters.push_back(static_cast<const FlowFilterBase*>(head));
+            if(head->getType() == FlowOperatorType::INPUT || head->getType() == FlowOperatorType::MERGE ||
+               head->getType() == FlowOperatorType::PARTITION || !this->fuse) break;
+            if(head->getSources().size() != 1) throw std::invalid_argument("Flow operator without source");
+            head = *head->getSources().begin();
+        }
+        std::reverse(filters.begin(), filters.end()); // upstream first
+
+        if(head->getType() == FlowOperatorType::PARTITION){
+            this->compilePartition(static_cast<const FlowPartitionBase*>(head), std::move(filters), target);
+            return;
+        }
+
+        const std::string kind = head->getType() == FlowOperatorType::INPUT ? "input" :
+                                 head->getType() == FlowOperatorType::MERGE ? "merge" :
+                                 head->getType() == FlowOperatorType::OUTPUT ? "output" : "stage";
+        const std::string name = describe(kind, filters);
+        std::vector<const FlowOperator*> operators(filters.begin(), filters.end());
+        operators.push_back(head);
+        TupleStage* stage;
+        if(head->getType() == FlowOperatorType::INPUT || head->getSources().size() > 1){
+            stage = new MultiSourceStage(this, -1, name, std::move(filters), target);
+        } else {
+            stage = new SingleSourceStage(this, -1, name, std::move(filters), target);
+        }
+        stage->operators = std::move(operators);
+        this->stages.push_back(stage);
+        this->connect(stage, target);
+        if(head->getType() == FlowOperatorType::INPUT) this->inputs[head] = stage;
+        for(FlowOperator* source : head->getSources()) this->compile(source, Target{stage, nullptr});
+    }
+
+    /**
+     * Creates one stage per shard running the given filters, the stage recombining the shards
+     * and the stages in front of the partition (which route their output to the shards).
+     */
+    void compilePartition(const FlowPartitionBase* partition, std::vector<const FlowFilterBase*> filters, Target target){
+        Partitioner* partitioner = new Partitioner(this, partition);
+        this->partitioners.push_back(partitioner);
+        const std::vector<int> numaNodes = this->pool.getNumaNodes();
+        auto shardNode = [&numaNodes](size_t shard){ return numaNodes.empty() ? -1 : numaNodes[shard % numaNodes.size()]; };
+
+        std::vector<const FlowOperator*> operators(filters.begin(), filters.end());
+        operators.push_back(partition);
+        auto shardName = [&](size_t shard){
+            return describe("shard " + std::to_string(shard + 1) + "/" + std::to_string(partition->getParallelism()), filters);
+        };
+
+        if(partition->isOrdered()){
+            ReorderStage* reorder = new ReorderStage(this, partition->getParallelism(), target, partitioner);
+            this->stages.push_back(reorder);
+            this->connect(reorder, target);
+            std::vector<OrderedShardStage*> shards;
+            for(size_t shard=0; shard < partition->getParallelism(); shard++){
+                shards.push_back(new OrderedShardStage(this, shardNode(shard), shardName(shard), filters, reorder));
+                shards.back()->operators = operators;
+                this->stages.push_back(shards.back());
+            }
+            partitioner->setShards(std::move(shards), reorder);
+        } else {
+            TupleStage* recombine = new MultiSourceStage(this, -1, "recombine", {}, target);
+            this->stages.push_back(recombine);
+            this->connect(recombine, target);
+            std::vector<TupleStage*> shards;
+            for(size_t shard=0; shard < partition->getParallelism(); shard++){
+                shards.push_back(new ShardStage(this, shardNode(shard), shardName(shard), filters, Target{recombine, nullptr}));
+                shards.back()->operators = operators;
+                this->stages.push_back(shards.back());
+                this->connect(shards.back(), Target{recombine, nullptr});
+            }
+            partitioner->setShards(std::move(shards));
+        }
+        this->compile(*partition->getSources().begin(), Target{nullptr, partitioner});
+    }
+
+    /**
+     * Reserves credits for up to count tuples at the target before a stage takes a batch.
+     *
+     * @return Stage* Stage without enough credits or nullptr if reserved (or no credits needed).
+     */
+    Stage* reserve(const Target &target, size_t count){
+        if(target.stage != nullptr) return target.stage->dropping() || target.stage->tryAcquire(count) ? nullptr : target.stage;
+        if(target.partitioner != nullptr) return target.partitioner->reserve(count);
+        return nullptr;
+    }
+
+    /**
+     * Hands tuples that passed a stage to its target.
+     *
+     * @param reserved Credits reserved with reserve() (the ones not needed get returned).
+     */
+    void forward(const Target &target, const Tuple* tuples, size_t count, size_t reserved){
+        if(target.stage != nullptr){
+            if(!target.stage->dropping()){
+                target.stage->releaseCredits(reserved - count);
+            } else if(!target.stage->tryAcquire(count)){
+                target.stage->recordDrop(count);
+                this->finished(count);
+                return;
+            }
+            if(count > 0) target.stage->enqueue(tuples, count);
+        } else if(target.partitioner != nullptr){
+            target.partitioner->route(tuples, count, reserved);
+        } else if(count > 0){
+            this->deliver(tuples, count);
+            this->finished(count);
+        }
+    }
+
+    /** Hands tuples that reached the output to all subscribers. */
+    void deliver(const Tuple* tuples, size_t count){
+        for(const Subscriber &subscriber : this->subscribers)
+            for(size_t i=0; i < count; i++) subscriber(tuples[i]);
+        this->tuplesOut.add(count);
+    }
+
+    /** Marks tuples as no longer in flight (dropped by a filter or delivered). */
+    inline void finished(size_t count){
+        if(count > 0) this->inFlight.fetch_sub((int64_t)count, std::memory_order_release);
+    }
+
+    TupleStage* inputStage(const FlowInput* input){
+        auto it = this->inputs.find(input);
+        if(it == this->inputs.end()) throw std::invalid_argument("FlowInput is not part of this flow");
+        return it->second;
+    }
+
+    TupleStage* singleInputStage(){
+        if(this->inputs.size() != 1) throw std::logic_error("Flow has multiple inputs, specify the FlowInput to push to");
+        return this->inputs.begin()->second;
+    }
+
+    /**
+     * Takes credits of an input stage for up to count tuples according to its policy.
+     *
+     * @return size_t Amount of tuples that may be queued (the rest got dropped).
+     */
+    size_t admit(TupleStage* stage, size_t count){
+        if(stage->tryAcquire(count)) return count;
+        const auto start = std::chrono::steady_clock::now();
+        switch(stage->policy){
+            case FlowBackpressure::BLOCK:
+                stage->credits->acquire((int32_t)count, true);
+                break;
+            case FlowBackpressure::SPIN:
+                do { cpuRelax(); } while(!stage->hasCredits(count) || !stage->tryAcquire(count));
+                break;
+            case FlowBackpressure::DROP: {
+                const int32_t free = stage->credits->getMaximum() - stage->credits->getCounter();
+                const size_t admitted = free > 0 && stage->tryAcquire(std::min(count, (size_t)free)) ? std::min(count, (size_t)free) : 0;
+                stage->recordDrop(count - admitted);
+                return admitted;
+            }
+        }
+        stage->recordStall(std::chrono::steady_clock::now() - start);
+        return count;
+    }
+
+    /** Counts tuples as in flight and queues them at an input stage (waits for or drops tuples if the stage is full). */
+    void pushInto(TupleStage* stage, const Tuple* tuples, size_t count){
+        const size_t chunk = stage->credits == nullptr ? count : (size_t)stage->credits->getMaximum();
+        for(size_t offset=0; offset < count; offset += chunk){
+            const size_t admitted = this->admit(stage, std::min(chunk, count - offset));
+            if(admitted == 0) continue;
+            this->tuplesIn.add(admitted);
+            this->inFlight.fetch_add((int64_t)admitted, std::memory_order_relaxed);
+            stage->enqueue(tuples + offset, admitted);
+        }
+    }
+
+    void bound(Stage* stage, size_t capacity, FlowBackpressure policy){
+        if(capacity != 0 && capacity < this->batchSize) throw std::invalid_argument("Stage capacity must be at least the batch size");
+        if(capacity > (size_t)INT32_MAX) throw std::invalid_argument("Stage capacity is too large");
+        stage->setCredits(capacity, policy);
+    }
+
+public:
+
+    /**
+     * Compiles a flow so tuples can be pushed into it.
+     * The flow takes ownership of the whole operator chain (see FlowOperator::~FlowOperator()).
+     *
+     * @param output Output of the flow representation.
+     * @param pool Pool whose workers execute the stages (must outlive the flow).
+     * @param batchSize Maximum amount of tuples a stage processes at once.
+     * @param fuse If true linear chains of operators get fused into a single stage (no queues in between).
+     */
+    Flow(std::unique_ptr<FlowOutput> output, ThreadPool& pool, size_t batchSize = DEFAULT_BATCH_SIZE, bool fuse = true) :
+            output(std::move(output)), pool(pool), batchSize(std::max((size_t)1, batchSize)), fuse(fuse) {
+        if(this->output == nullptr) throw std::invalid_argument("Flow requires an output");
+        try {
+            this->compile(this->output.get(), Target{});
+        } catch(...) {
+            for(Stage* stage : this->stages) delete stage;
+            for(Partitioner* partitioner : this->partitioners) delete partitioner;
+            throw;
+        }
+    }
+
+    /**
+     * Waits until all pushed tuples got processed.
+     */
+    ~Flow(){
+        this->drain();
+        while(this->tasks.load(std::memory_order_acquire) != 0) // stages may still be finishing their last batch
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        for(Stage* stage : this->stages) delete stage;
+        for(Partitioner* partitioner : this->partitioners) delete partitioner;
+    }
+
+    Flow(const Flow&) = delete;
+    Flow& operator=(const Flow&) = delete;
+
+    /**
+     * Registers a function that gets called for every tuple reaching the output.
+     * Subscribers are called by one worker at a time. Must not be called while tuples are in flight.
+     */
+    void subscribe(Subscriber subscriber){
+        this->subscribers.push_back(std::move(subscriber));
+    }
+
+    /**
+     * Pushes a tuple into the only input of the flow.
+     */
+    void push(const Tuple &tuple){
+        this->pushBulk(&tuple, 1);
+    }
+
+    /**
+     * Pushes a tuple into the given input of the flow.
+     */
+    void push(const FlowInput* input, const Tuple &tuple){
+        this->pushBulk(input, &tuple, 1);
+    }
+
+    /**
+     * Pushes multiple tuples into the only input of the flow (cheaper than pushing them one by one).
+     */
+    void pushBulk(const Tuple* tuples, size_t count){
+        this->pushInto(this->singleInputStage(), tuples, count);
+    }
+
+    /**
+     * Pushes multiple tuples into the given input of the flow (cheaper than pushing them one by one).
+     */
+    void pushBulk(const FlowInput* input, const Tuple* tuples, size_t count){
+        this->pushInto(this->inputStage(input), tuples, count);
+    }
+
+    /**
+     * Blocks until all tuples pushed so far reached the output or got filtered out.
+     * Must not be called from a task of the pool that executes the flow.
+     */
+    void drain() const {
+        while(this->inFlight.load(std::memory_order_acquire) != 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+
+    /** Returns the amount of tuples pushed into the flow. */
+    uint64_t getTuplesIn() const noexcept {
+        return this->tuplesIn.load();
+    }
+
+    /** Returns the amount of tuples that reached the output. */
+    uint64_t getTuplesOut() const noexcept {
+        return this->tuplesOut.load();
+    }
+
+    /** Returns the amount of tuples dropped because a stage had no credits left (see FlowBackpressure::DROP). */
+    uint64_t getTuplesDropped() const noexcept {
+        return this->droppedTuples.load();
+    }
+
+    /** Returns the amount of stages the flow got compiled into. */
+    size_t getStageCount() const noexcept {
+        return this->stages.size();
+    }
+
+    /**
+     * Bounds the queues of all stages (reorder stages of ordered partitions stay unbounded,
+     * they only hold what the shards already let through). Must be called before tuples get pushed.
+     *
+     * @param capacity Tuples a stage may have queued (0 for unbounded, at least the batch size otherwise).
+     * @param policy What producers do if a stage is full.
+     */
+    void setBackpressure(size_t capacity, FlowBackpressure policy = FlowBackpressure::BLOCK){
+        for(Stage* stage : this->stages) if(stage->isBoundable()) this->bound(stage, capacity, policy);
+    }
+
+    /**
+     * Bounds the queue of the stage(s) running the given operator (all shards for operators behind a partition).
+     * Must be called before tuples get pushed.
+     *
+     * @param op Operator of the flow (e.g. a FlowInput to define how threads pushing into the flow behave).
+     * @param capacity Tuples the stage may have queued (0 for unbounded, at least the batch size otherwise).
+     * @param policy What producers do if the stage is full.
+     */
+    void setBackpressure(const FlowOperator* op, size_t capacity, FlowBackpressure policy = FlowBackpressure::BLOCK){
+        bool found = false;
+        for(Stage* stage : this->stages){
+            if(std::find(stage->operators.begin(), stage->operators.end(), op) == stage->operators.end()) continue;
+            this->bound(stage, capacity, policy);
+            found = true;
+        }
+        if(!found) throw std::invalid_argument("Operator is not part of this flow");
+    }
+
+    /**
+     * Returns queue depth and backpressure metrics of every stage.
+     */
+    std::vector<FlowStageMetrics> getStageMetrics() const {
+        std::vector<FlowStageMetrics> metrics;
+        for(const Stage* stage : this->stages) metrics.push_back(stage->getMetrics());
+        return metrics;
+    }
+};
+
+
+
+
+inline void Flow::connect(Stage* stage, const Target &target){
+    if(target.stage != nullptr) target.stage->upstream.push_back(stage);
+    if(target.partitioner != nullptr){
+        for(size_t i=0; i < target.partitioner->partition->getParallelism(); i++) target.partitioner->shard(i)->upstream.push_back(stage);
+    }
+}
+
+
+
+}
+
+#endif // SPI_FLOW_HPP
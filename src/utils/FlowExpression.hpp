@@ -0,0 +1,655 @@
+/**
+ * Expressions used by FlowFilter and FlowJoin predicates.
+ *
+ * Compile time expressions are built from field references, constants, arithmetic, comparisons
+ * and boolean operators (e.g. flow::value % flow::literal<3> == 0 && flow::value < 1000) and get
+ * inlined into the operator like a hand-written lambda. Comparisons of a field with a constant and their
+ * boolean combinations additionally evaluate whole batches with the SIMD kernels of TupleBatch.
+ *
+ * FlowDynamicExpression is the runtime counterpart for flows that are only known at runtime.
+ * It gets compiled into bytecode that is interpreted per tuple or 64 rows at a time on batches.
+ *
+ * All values are evaluated as uint64_t, division and modulo by zero yield zero.
+ *
+ * @file FlowExpression.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+#ifndef SPI_FLOW_EXPRESSION_HPP
+#define SPI_FLOW_EXPRESSION_HPP
+
+#include "./Tuple.hpp"
+#include "./TupleBatch.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace spi {
+
+
+
+/**
+ * Base of all compile time expression nodes (enables the operators below).
+ */
+struct FlowExpressionNode {};
+
+template<typename E>
+concept FlowExpressionType = std::is_base_of_v<FlowExpressionNode, E>;
+
+template<typename T>
+concept FlowExpressionOperand = FlowExpressionType<T> || std::is_arithmetic_v<T>;
+
+
+/**
+ * Compares two values as described by a FlowCompare.
+ */
+template<FlowCompare OP>
+inline constexpr bool flowCompare(uint64_t left, uint64_t right) noexcept {
+    if constexpr (OP == FlowCompare::LESS) return left < right;
+    else if constexpr (OP == FlowCompare::LESS_EQUAL) return left <= right;
+    else if constexpr (OP == FlowCompare::GREATER) return left > right;
+    else if constexpr (OP == FlowCompare::GREATER_EQUAL) return left >= right;
+    else if constexpr (OP == FlowCompare::EQUAL) return left == right;
+    else return left != right;
+}
+
+/**
+ * Returns the comparison that yields the same result if both sides get swapped (e.g. LESS becomes GREATER).
+ */
+inline constexpr FlowCompare flowMirror(FlowCompare op) noexcept {
+    switch(op){
+        case FlowCompare::LESS: return FlowCompare::GREATER;
+        case FlowCompare::LESS_EQUAL: return FlowCompare::GREATER_EQUAL;
+        case FlowCompare::GREATER: return FlowCompare::LESS;
+        case FlowCompare::GREATER_EQUAL: return FlowCompare::LESS_EQUAL;
+        default: return op;
+    }
+}
+
+/**
+ * Keeps only the bits of the selection that belong to one of the count rows.
+ */
+inline void flowMaskSelection(uint64_t* selection, size_t count) noexcept {
+    if(count % 64 != 0) selection[count / 64] &= ((uint64_t)1 << (count % 64)) - 1;
+}
+
+
+
+/**
+ * Field of a tuple.
+ *
+ * @tparam SIDE Tuple the field is read from (0 for filters and the left side of joins, 1 for the right side of joins).
+ * @tparam GETTER Member function of Tuple that returns the field.
+ */
+template<size_t SIDE, auto GETTER = &Tuple::getValue>
+struct FlowField : FlowExpressionNode {
+    template<typename... T>
+    inline uint64_t operator()(const T&... tuples) const {
+        static_assert(SIDE < sizeof...(T), "FlowField refers to a tuple that is not available (right side only exists in joins)");
+        return (uint64_t)(std::get<SIDE>(std::forward_as_tuple(tuples...)).*GETTER)();
+    }
+};
+
+/**
+ * Constant value.
+ */
+struct FlowConstant : FlowExpressionNode {
+    uint64_t value;
+
+    constexpr FlowConstant(uint64_t value) : value(value) {}
+
+    template<typename... T>
+    inline uint64_t operator()(const T&...) const {
+        return this->value;
+    }
+};
+
+/**
+ * Constant value that is part of the type, so it stays known at compile time even if the expression
+ * is stored in an operator (e.g. divisions by a literal become multiplications).
+ */
+template<uint64_t VALUE>
+struct FlowLiteral : FlowExpressionNode {
+    static constexpr uint64_t value = VALUE;
+
+    template<typename... T>
+    inline uint64_t operator()(const T&...) const {
+        return VALUE;
+    }
+};
+
+template<typename E>
+struct FlowIsConstant : std::is_same<E, FlowConstant> {};
+
+template<uint64_t VALUE>
+struct FlowIsConstant<FlowLiteral<VALUE>> : std::true_type {};
+
+/** Turns constants into FlowConstant so they can be used as operands of expressions. */
+template<FlowExpressionOperand T>
+constexpr auto flowOperand(const T &operand){
+    if constexpr (FlowExpressionType<T>) return operand;
+    else return FlowConstant((uint64_t)operand);
+}
+
+template<typename T>
+using FlowOperandType = decltype(flowOperand(std::declval<T>()));
+
+
+struct FlowAdd { static inline uint64_t apply(uint64_t a, uint64_t b) noexcept { return a + b; } };
+struct FlowSubtract { static inline uint64_t apply(uint64_t a, uint64_t b) noexcept { return a - b; } };
+struct FlowMultiply { static inline uint64_t apply(uint64_t a, uint64_t b) noexcept { return a * b; } };
+struct FlowDivide { static inline uint64_t apply(uint64_t a, uint64_t b) noexcept { return b == 0 ? 0 : a / b; } };
+struct FlowModulo { static inline uint64_t apply(uint64_t a, uint64_t b) noexcept { return b == 0 ? 0 : a % b; } };
+
+/**
+ * Arithmetic operation on two expressions.
+ *
+ * @tparam OP One of FlowAdd, FlowSubtract, FlowMultiply, FlowDivide or FlowModulo.
+ */
+template<typename OP, typename L, typename R>
+struct FlowArithmetic : FlowExpressionNode {
+    L left;
+    R right;
+
+    template<typename... T>
+    inline uint64_t operator()(const T&... tuples) const {
+        return OP::apply(this->left(tuples...), this->right(tuples...));
+    }
+};
+
+
+/**
+ * Comparison of two expressions. Comparing the value of the tuple with a constant
+ * evaluates whole batches with the SIMD kernels (see FlowColumnExpression).
+ */
+template<FlowCompare OP, typename L, typename R>
+struct FlowComparison : FlowExpressionNode {
+    L left;
+    R right;
+
+    static constexpr bool FIELD_LEFT = std::is_same_v<L, FlowField<0>> && FlowIsConstant<R>::value;
+    static constexpr bool FIELD_RIGHT = FlowIsConstant<L>::value && std::is_same_v<R, FlowField<0>>;
+
+    template<typename... T>
+    inline bool operator()(const T&... tuples) const {
+        return flowCompare<OP>(this->left(tuples...), this->right(tuples...));
+    }
+
+    void evaluate(const uint32_t* values, size_t count, uint64_t* selection) const requires (FIELD_LEFT || FIELD_RIGHT) {
+        constexpr FlowCompare op = FIELD_LEFT ? OP : flowMirror(OP);
+        uint64_t constant;
+        if constexpr (FIELD_LEFT) constant = this->right.value;
+        else constant = this->left.value;
+        if(constant <= std::numeric_limits<uint32_t>::max()){
+            TupleBatchKernels::compare(values, count, op, 0, (uint32_t)constant, selection);
+        } else { // no value of 32 bits reaches the constant, so all rows compare like zero
+            const uint64_t bits = flowCompare<op>(0, constant) ? ~(uint64_t)0 : 0;
+            for(size_t word=0; word * 64 < count; word++) selection[word] = bits;
+            flowMaskSelection(selection, count);
+        }
+    }
+};
+
+
+/**
+ * Evaluates two expressions on a column and combines their selection bitmaps.
+ */
+template<typename L, typename R, typename COMBINE>
+inline void flowEvaluateBoth(const L &left, const R &right, const uint32_t* values, size_t count, uint64_t* selection, COMBINE combine){
+    constexpr size_t CHUNK = 4096; // rows per scratch bitmap
+    uint64_t scratch[CHUNK / 64];
+    for(size_t start=0; start < count; start += CHUNK){
+        const size_t rows = std::min(CHUNK, count - start);
+        uint64_t* target = selection + start / 64;
+        flowEvaluate(left, values + start, rows, target);
+        flowEvaluate(right, values + start, rows, scratch);
+        for(size_t w=0; w < (rows + 63) / 64; w++) target[w] = combine(target[w], scratch[w]);
+    }
+}
+
+/**
+ * Fulfilled if both expressions are fulfilled (right one only gets evaluated if the left one is fulfilled).
+ */
+template<typename L, typename R>
+struct FlowAnd : FlowExpressionNode {
+    L left;
+    R right;
+
+    template<typename... T>
+    inline bool operator()(const T&... tuples) const {
+        return (bool)this->left(tuples...) && (bool)this->right(tuples...);
+    }
+
+    void evaluate(const uint32_t* values, size_t count, uint64_t* selection) const requires (FlowColumnExpression<L> || FlowColumnExpression<R>) {
+        flowEvaluateBoth(this->left, this->right, values, count, selection, [](uint64_t a, uint64_t b){ return a & b; });
+    }
+};
+
+/**
+ * Fulfilled if at least one expression is fulfilled (right one only gets evaluated if the left one is not fulfilled).
+ */
+template<typename L, typename R>
+struct FlowOr : FlowExpressionNode {
+    L left;
+    R right;
+
+    template<typename... T>
+    inline bool operator()(const T&... tuples) const {
+        return (bool)this->left(tuples...) || (bool)this->right(tuples...);
+    }
+
+    void evaluate(const uint32_t* values, size_t count, uint64_t* selection) const requires (FlowColumnExpression<L> || FlowColumnExpression<R>) {
+        flowEvaluateBoth(this->left, this->right, values, count, selection, [](uint64_t a, uint64_t b){ return a | b; });
+    }
+};
+
+/**
+ * Fulfilled if the expression is not fulfilled (zero).
+ */
+template<typename E>
+struct FlowNot : FlowExpressionNode {
+    E expression;
+
+    template<typename... T>
+    inline bool operator()(const T&... tuples) const {
+        return !(bool)this->expression(tuples...);
+    }
+
+    void evaluate(const uint32_t* values, size_t count, uint64_t* selection) const requires FlowColumnExpression<E> {
+        this->expression.evaluate(values, count, selection);
+        for(size_t word=0; word * 64 < count; word++) selection[word] = ~selection[word];
+        flowMaskSelection(selection, count);
+    }
+};
+
+
+template<typename L, typename R>
+concept FlowExpressionOperands = (FlowExpressionType<L> || FlowExpressionType<R>) && FlowExpressionOperand<L> && FlowExpressionOperand<R>;
+
+template<typename L, typename R> requires FlowExpressionOperands<L, R>
+constexpr FlowArithmetic<FlowAdd, FlowOperandType<L>, FlowOperandType<R>> operator+(const L &left, const R &right){
+    return {{}, flowOperand(left), flowOperand(right)};
+}
+
+template<typename L, typename R> requires FlowExpressionOperands<L, R>
+constexpr FlowArithmetic<FlowSubtract, FlowOperandType<L>, FlowOperandType<R>> operator-(const L &left, const R &right){
+    return {{}, flowOperand(left), flowOperand(right)};
+}
+
+template<typename L, typename R> requires FlowExpressionOperands<L, R>
+constexpr FlowArithmetic<FlowMultiply, FlowOperandType<L>, FlowOperandType<R>> operator*(const L &left, const R &right){
+    return {{}, flowOperand(left), flowOperand(right)};
+}
+
+template<typename L, typename R> requires FlowExpressionOperands<L, R>
+constexpr FlowArithmetic<FlowDivide, FlowOperandType<L>, FlowOperandType<R>> operator/(const L &left, const R &right){
+    return {{}, flowOperand(left), flowOperand(right)};
+}
+
+template<typename L, typename R> requires FlowExpressionOperands<L, R>
+constexpr FlowArithmetic<FlowModulo, FlowOperandType<L>, FlowOperandType<R>> operator%(const L &left, const R &right){
+    return {{}, flowOperand(left), flowOperand(right)};
+}
+
+template<typename L, typename R> requires FlowExpressionOperands<L, R>
+constexpr FlowComparison<FlowCompare::LESS, FlowOperandType<L>, FlowOperandType<R>> operator<(const L &left, const R &right){
+    return {{}, flowOperand(left), flowOperand(right)};
+}
+
+template<typename L, typename R> requires FlowExpressionOperands<L, R>
+constexpr FlowComparison<FlowCompare::LESS_EQUAL, FlowOperandType<L>, FlowOperandType<R>> operator<=(const L &left, const R &right){
+    return {{}, flowOperand(left), flowOperand(right)};
+}
+
+template<typename L, typename R> requires FlowExpressionOperands<L, R>
+constexpr FlowComparison<FlowCompare::GREATER, FlowOperandType<L>, FlowOperandType<R>> operator>(const L &left, const R &right){
+    return {{}, flowOperand(left), flowOperand(right)};
+}
+
+template<typename L, typename R> requires FlowExpressionOperands<L, R>
+constexpr FlowComparison<FlowCompare::GREATER_EQUAL, FlowOperandType<L>, FlowOperandType<R>> operator>=(const L &left, const R &right){
+    return {{}, flowOperand(left), flowOperand(right)};
+}
+
+template<typename L, typename R> requires FlowExpressionOperands<L, R>
+constexpr FlowComparison<FlowCompare::EQUAL, FlowOperandType<L>, FlowOperandType<R>> operator==(const L &left, const R &right){
+    return {{}, flowOperand(left), flowOperand(right)};
+}
+
+template<typename L, typename R> requires FlowExpressionOperands<L, R>
+constexpr FlowComparison<FlowCompare::NOT_EQUAL, FlowOperandType<L>, FlowOperandType<R>> operator!=(const L &left, const R &right){
+    return {{}, flowOperand(left), flowOperand(right)};
+}
+
+template<typename L, typename R> requires FlowExpressionOperands<L, R>
+constexpr FlowAnd<FlowOperandType<L>, FlowOperandType<R>> operator&&(const L &left, const R &right){
+    return {{}, flowOperand(left), flowOperand(right)};
+}
+
+template<typename L, typename R> requires FlowExpressionOperands<L, R>
+constexpr FlowOr<FlowOperandType<L>, FlowOperandType<R>> operator||(const L &left, const R &right){
+    return {{}, flowOperand(left), flowOperand(right)};
+}
+
+template<FlowExpressionType E>
+constexpr FlowNot<E> operator!(const E &expression){
+    return {{}, expression};
+}
+
+
+
+/**
+ * Terms compile time expressions are built from.
+ */
+namespace flow {
+
+/** Value of the filtered tuple. */
+inline constexpr FlowField<0> value{};
+
+/** Value of the left tuple of a join. */
+inline constexpr FlowField<0> left{};
+
+/** Value of the right tuple of a join. */
+inline constexpr FlowField<1> right{};
+
+/** Field returned by the given member function of the filtered (0), left (0) or right (1) tuple. */
+template<size_t SIDE, auto GETTER>
+inline constexpr FlowField<SIDE, GETTER> field{};
+
+/** Constant value (plain numbers can also be used directly as operands). */
+constexpr FlowConstant constant(uint64_t value){
+    return FlowConstant(value);
+}
+
+/** Constant value known at compile time (e.g. value % literal<3> == 0 compiles like a hand-written lambda). */
+template<uint64_t VALUE>
+inline constexpr FlowLiteral<VALUE> literal{};
+
+}
+
+
+
+/**
+ * Expression that is built at runtime and compiled into bytecode for a stack machine.
+ *
+ * Single tuples are evaluated by interpreting the bytecode per tuple (AND/OR short-circuit).
+ * Batches are evaluated 64 rows at a time so every instruction gets dispatched once per
+ * 64 rows and runs as a tight loop over a column of the stack (short-circuit jumps are ignored).
+ * Expressions get combined with the same operators as compile time expressions,
+ * e.g. FlowDynamicExpression::field() % 3 == 0.
+ */
+class FlowDynamicExpression {
+public:
+    /** Amount of values the stack of an expression can hold. */
+    static constexpr size_t MAX_DEPTH = 32;
+
+    enum class Op : uint8_t {
+        FIELD,          // pushes field of tuple (argument = side)
+        CONSTANT,       // pushes constant
+        ADD, SUBTRACT, MULTIPLY, DIVIDE, MODULO,
+        LESS, LESS_EQUAL, GREATER, GREATER_EQUAL, EQUAL, NOT_EQUAL,
+        AND, OR, NOT,
+        JUMP_IF_FALSE,  // skips the next argument instructions if the top is zero
+        JUMP_IF_TRUE,   // skips the next argument instructions if the top is not zero (and sets it to one)
+    };
+
+    struct Instruction {
+        Op op;
+        uint32_t argument;
+        uint64_t constant;
+    };
+
+protected:
+    std::vector<Instruction> code;
+    size_t depth = 1; // maximum amount of values on the stack
+
+    FlowDynamicExpression(Op op, uint32_t argument, uint64_t constant) : code{Instruction{op, argument, constant}} {}
+
+    static FlowDynamicExpression combine(const FlowDynamicExpression &left, const FlowDynamicExpression &right, Op op){
+        FlowDynamicExpression result = left;
+        const bool shortCircuit = op == Op::AND || op == Op::OR;
+        if(shortCircuit) result.code.push_back(Instruction{op == Op::AND ? Op::JUMP_IF_FALSE : Op::JUMP_IF_TRUE, (uint32_t)right.code.size() + 1, 0});
+        result.code.insert(result.code.end(), right.code.begin(), right.code.end());
+        result.code.push_back(Instruction{op, 0, 0});
+        result.depth = std::max(left.depth, right.depth + 1);
+        if(result.depth > MAX_DEPTH)
+            throw std::invalid_argument("FlowDynamicExpression needs more than "+std::to_string(MAX_DEPTH)+" stack entries");
+        return result;
+    }
+
+    static inline uint64_t apply(Op op, uint64_t a, uint64_t b) noexcept {
+        switch(op){
+            case Op::ADD: return FlowAdd::apply(a, b);
+            case Op::SUBTRACT: return FlowSubtract::apply(a, b);
+            case Op::MULTIPLY: return FlowMultiply::apply(a, b);
+            case Op::DIVIDE: return FlowDivide::apply(a, b);
+            case Op::MODULO: return FlowModulo::apply(a, b);
+            case Op::LESS: return a < b;
+            case Op::LESS_EQUAL: return a <= b;
+            case Op::GREATER: return a > b;
+            case Op::GREATER_EQUAL: return a >= b;
+            case Op::EQUAL: return a == b;
+            case Op::NOT_EQUAL: return a != b;
+            case Op::AND: return a != 0 && b != 0;
+            case Op::OR: return a != 0 || b != 0;
+            default: return 0;
+        }
+    }
+
+    /** Applies a binary instruction to 64 rows (the switch is hoisted out of the loops). */
+    static inline void apply(Op op, uint64_t* a, const uint64_t* b) noexcept {
+        switch(op){
+            case Op::ADD: for(size_t i=0; i < 64; i++) a[i] = a[i] + b[i]; break;
+            case Op::SUBTRACT: for(size_t i=0; i < 64; i++) a[i] = a[i] - b[i]; break;
+            case Op::MULTIPLY: for(size_t i=0; i < 64; i++) a[i] = a[i] * b[i]; break;
+            case Op::DIVIDE: for(size_t i=0; i < 64; i++) a[i] = FlowDivide::apply(a[i], b[i]); break;
+            case Op::MODULO: for(size_t i=0; i < 64; i++) a[i] = FlowModulo::apply(a[i], b[i]); break;
+            case Op::LESS: for(size_t i=0; i < 64; i++) a[i] = a[i] < b[i]; break;
+            case Op::LESS_EQUAL: for(size_t i=0; i < 64; i++) a[i] = a[i] <= b[i]; break;
+            case Op::GREATER: for(size_t i=0; i < 64; i++) a[i] = a[i] > b[i]; break;
+            case Op::GREATER_EQUAL: for(size_t i=0; i < 64; i++) a[i] = a[i] >= b[i]; break;
+            case Op::EQUAL: for(size_t i=0; i < 64; i++) a[i] = a[i] == b[i]; break;
+            case Op::NOT_EQUAL: for(size_t i=0; i < 64; i++) a[i] = a[i] != b[i]; break;
+            case Op::AND: for(size_t i=0; i < 64; i++) a[i] = (a[i] != 0) & (b[i] != 0); break;
+            case Op::OR: for(size_t i=0; i < 64; i++) a[i] = (a[i] != 0) | (b[i] != 0); break;
+            default: break;
+        }
+    }
+
+    /** Interprets the bytecode for one tuple (left) or a pair of tuples (left and right). */
+    uint64_t execute(uint64_t left, uint64_t right) const noexcept {
+        uint64_t stack[MAX_DEPTH];
+        size_t top = 0; // amount of values on the stack
+        const Instruction* instructions = this->code.data();
+        const size_t length = this->code.size();
+        for(size_t pc=0; pc < length; pc++){
+            const Instruction &instruction = instructions[pc];
+            switch(instruction.op){
+                case Op::FIELD: stack[top++] = instruction.argument == 0 ? left : right; break;
+                case Op::CONSTANT: stack[top++] = instruction.constant; break;
+                case Op::NOT: stack[top - 1] = stack[top - 1] == 0; break;
+                case Op::JUMP_IF_FALSE:
+                    if(stack[top - 1] == 0) pc += instruction.argument;
+                    break;
+                case Op::JUMP_IF_TRUE:
+                    if(stack[top - 1] != 0){
+                        stack[top - 1] = 1;
+                        pc += instruction.argument;
+                    }
+                    break;
+                default:
+                    top--;
+                    stack[top - 1] = apply(instruction.op, stack[top - 1], stack[top]);
+                    break;
+            }
+        }
+        return stack[0];
+    }
+
+public:
+
+    /**
+     * Constant value, allows plain numbers as operands (e.g. FlowDynamicExpression::field() < 10).
+     */
+    FlowDynamicExpression(uint64_t constant) : FlowDynamicExpression(Op::CONSTANT, 0, constant) {}
+
+    /**
+     * Field of a tuple (Tuple::getValue()).
+     *
+     * @param side Tuple the field is read from (0 for filters and the left side of joins, 1 for the right side of joins).
+     *             The right side reads as zero if only one tuple gets evaluated.
+     */
+    static FlowDynamicExpression field(uint32_t side = 0){
+        if(side > 1) throw std::invalid_argument("FlowDynamicExpression field side needs to be 0 or 1 but was "+std::to_string(side));
+        return FlowDynamicExpression(Op::FIELD, side, 0);
+    }
+
+    /** Constant value. */
+    static FlowDynamicExpression constant(uint64_t value){
+        return FlowDynamicExpression(Op::CONSTANT, 0, value);
+    }
+
+    /**
+     * Combines two expressions with a binary operation.
+     *
+     * @param op ADD to OR (operations that consume two values).
+     */
+    static FlowDynamicExpression binary(Op op, const FlowDynamicExpression &left, const FlowDynamicExpression &right){
+        if(op < Op::ADD || op > Op::OR) throw std::invalid_argument("FlowDynamicExpression operation is not binary");
+        return combine(left, right, op);
+    }
+
+    /** Negates an expression (one if it is zero, zero otherwise). */
+    static FlowDynamicExpression negate(const FlowDynamicExpression &expression){
+        FlowDynamicExpression result = expression;
+        result.code.push_back(Instruction{Op::NOT, 0, 0});
+        return result;
+    }
+
+    /**
+     * Creates an expression from bytecode (e.g. received from another node, see getCode()).
+     * Throws std::invalid_argument if the bytecode could underflow or overflow the stack,
+     * jumps out of it or does not leave exactly one value.
+     */
+    static FlowDynamicExpression fromCode(std::vector<Instruction> code){
+        // stack height before every instruction when no jump is taken (jumps keep the height)
+        std::vector<size_t> heights(code.size() + 1, 0);
+        size_t height = 0, depth = 0;
+        for(size_t pc=0; pc < code.size(); pc++){
+            heights[pc] = height;
+            const Instruction &instruction = code[pc];
+            if(instruction.op == Op::FIELD || instruction.op == Op::CONSTANT){
+                if(instruction.op == Op::FIELD && instruction.argument > 1)
+                    throw std::invalid_argument("FlowDynamicExpression field side needs to be 0 or 1 but was "+std::to_string(instruction.argument));
+                height++;
+            } else if(instruction.op >= Op::ADD && instruction.op <= Op::OR){
+                if(height < 2) throw std::invalid_argument("FlowDynamicExpression bytecode underflows the stack at "+std::to_string(pc));
+                height--;
+            } else if(instruction.op == Op::NOT || instruction.op == Op::JUMP_IF_FALSE || instruction.op == Op::JUMP_IF_TRUE){
+                if(height < 1) throw std::invalid_argument("FlowDynamicExpression bytecode underflows the stack at "+std::to_string(pc));
+                if(instruction.op != Op::NOT && (size_t)instruction.argument > code.size() - pc - 1)
+                    throw std::invalid_argument("FlowDynamicExpression bytecode jumps out of the code at "+std::to_string(pc));
+            } else {
+                throw std::invalid_argument("FlowDynamicExpression bytecode contains unknown operation at "+std::to_string(pc));
+            }
+            depth = std::max(depth, height);
+        }
+        heights[code.size()] = height;
+        if(height != 1) throw std::invalid_argument("FlowDynamicExpression bytecode leaves "+std::to_string(height)+" values instead of one");
+        if(depth > MAX_DEPTH) throw std::invalid_argument("FlowDynamicExpression needs more than "+std::to_string(MAX_DEPTH)+" stack entries");
+        for(size_t pc=0; pc < code.size(); pc++){
+            const Instruction &instruction = code[pc];
+            if((instruction.op == Op::JUMP_IF_FALSE || instruction.op == Op::JUMP_IF_TRUE) && heights[pc + 1 + instruction.argument] != heights[pc])
+                throw std::invalid_argument("FlowDynamicExpression bytecode jumps to a different stack height at "+std::to_string(pc));
+        }
+        FlowDynamicExpression result(0);
+        result.code = std::move(code);
+        result.depth = depth;
+        return result;
+    }
+
+    /** Returns the compiled bytecode. */
+    const std::vector<Instruction>& getCode() const noexcept {
+        return this->code;
+    }
+
+    /** Returns the maximum amount of values on the stack while evaluating. */
+    size_t getDepth() const noexcept {
+        return this->depth;
+    }
+
+    inline uint64_t operator()(const Tuple &tuple) const noexcept {
+        return this->execute(tuple.getValue(), 0);
+    }
+
+    inline uint64_t operator()(const Tuple &left, const Tuple &right) const noexcept {
+        return this->execute(left.getValue(), right.getValue());
+    }
+
+    /**
+     * Evaluates the expression on a column (see FlowColumnExpression), 64 rows per dispatched instruction.
+     */
+    void evaluate(const uint32_t* values, size_t count, uint64_t* selection) const {
+        alignas(64) uint64_t stack[MAX_DEPTH][64];
+        for(size_t start=0; start < count; start += 64){
+            const size_t rows = std::min((size_t)64, count - start);
+            size_t top = 0;
+            for(const Instruction &instruction : this->code){
+                uint64_t* target = stack[top];
+                switch(instruction.op){
+                    case Op::FIELD:
+                        if(instruction.argument == 0){
+                            for(size_t i=0; i < rows; i++) target[i] = values[start + i];
+                            for(size_t i=rows; i < 64; i++) target[i] = 0;
+                        } else {
+                            for(size_t i=0; i < 64; i++) target[i] = 0;
+                        }
+                        top++;
+                        break;
+                    case Op::CONSTANT:
+                        for(size_t i=0; i < 64; i++) target[i] = instruction.constant;
+                        top++;
+                        break;
+                    case Op::NOT:
+                        for(size_t i=0; i < 64; i++) stack[top - 1][i] = stack[top - 1][i] == 0;
+                        break;
+                    case Op::JUMP_IF_FALSE:
+                    case Op::JUMP_IF_TRUE:
+                        break; // both sides get evaluated, AND/OR combine them
+                    default:
+                        top--;
+                        apply(instruction.op, stack[top - 1], stack[top]);
+                        break;
+                }
+            }
+            uint64_t bits = 0;
+            for(size_t i=0; i < rows; i++) bits |= (uint64_t)(stack[0][i] != 0) << i;
+            selection[start / 64] = bits;
+        }
+    }
+};
+
+inline FlowDynamicExpression operator+(const FlowDynamicExpression &a, const FlowDynamicExpression &b){ return FlowDynamicExpression::binary(FlowDynamicExpression::Op::ADD, a, b); }
+inline FlowDynamicExpression operator-(const FlowDynamicExpression &a, const FlowDynamicExpression &b){ return FlowDynamicExpression::binary(FlowDynamicExpression::Op::SUBTRACT, a, b); }
+inline FlowDynamicExpression operator*(const FlowDynamicExpression &a, const FlowDynamicExpression &b){ return FlowDynamicExpression::binary(FlowDynamicExpression::Op::MULTIPLY, a, b); }
+inline FlowDynamicExpression operator/(const FlowDynamicExpression &a, const FlowDynamicExpression &b){ return FlowDynamicExpression::binary(FlowDynamicExpression::Op::DIVIDE, a, b); }
+inline FlowDynamicExpression operator%(const FlowDynamicExpression &a, const FlowDynamicExpression &b){ return FlowDynamicExpression::binary(FlowDynamicExpression::Op::MODULO, a, b); }
+inline FlowDynamicExpression operator<(const FlowDynamicExpression &a, const FlowDynamicExpression &b){ return FlowDynamicExpression::binary(FlowDynamicExpression::Op::LESS, a, b); }
+inline FlowDynamicExpression operator<=(const FlowDynamicExpression &a, const FlowDynamicExpression &b){ return FlowDynamicExpression::binary(FlowDynamicExpression::Op::LESS_EQUAL, a, b); }
+inline FlowDynamicExpression operator>(const FlowDynamicExpression &a, const FlowDynamicExpression &b){ return FlowDynamicExpression::binary(FlowDynamicExpression::Op::GREATER, a, b); }
+inline FlowDynamicExpression operator>=(const FlowDynamicExpression &a, const FlowDynamicExpression &b){ return FlowDynamicExpression::binary(FlowDynamicExpression::Op::GREATER_EQUAL, a, b); }
+inline FlowDynamicExpression operator==(const FlowDynamicExpression &a, const FlowDynamicExpression &b){ return FlowDynamicExpression::binary(FlowDynamicExpression::Op::EQUAL, a, b); }
+inline FlowDynamicExpression operator!=(const FlowDynamicExpression &a, const FlowDynamicExpression &b){ return FlowDynamicExpression::binary(FlowDynamicExpression::Op::NOT_EQUAL, a, b); }
+inline FlowDynamicExpression operator&&(const FlowDynamicExpression &a, const FlowDynamicExpression &b){ return FlowDynamicExpression::binary(FlowDynamicExpression::Op::AND, a, b); }
+inline FlowDynamicExpression operator||(const FlowDynamicExpression &a, const FlowDynamicExpression &b){ return FlowDynamicExpression::binary(FlowDynamicExpression::Op::OR, a, b); }
+inline FlowDynamicExpression operator!(const FlowDynamicExpression &a){ return FlowDynamicExpression::negate(a); }
+
+}
+#endif // SPI_FLOW_EXPRESSION_HPP
@@ -1,7 +1,16 @@
 #include "FlowRepresentation.hpp"
 
+#include <stdexcept>
+
 using namespace spi;
 
+FlowWindow::FlowWindow(FlowWindowType type, uint64_t size) : FlowWindow(type, size, size) {}
+
+FlowWindow::FlowWindow(FlowWindowType type, uint64_t size, uint64_t stride) : type(type), size(size), stride(stride) {
+    if(size == 0) throw std::invalid_argument("FlowWindow size must be greater than zero");
+    if(stride == 0) throw std::invalid_argument("FlowWindow stride must be greater than zero");
+}
+
 std::unique_ptr<FlowOutput> FlowOperatorChainable::output() {
     return std::unique_ptr<FlowOutput>(new FlowOutput(this)); // protected constructor
 }
@@ -16,8 +25,3 @@ std::unique_ptr<FlowMerge> FlowOperatorChainable::merge(std::vector<std::unique_
     for(auto& source : sources) sourcesPtr.push_back(source.release());
     return std::unique_ptr<FlowMerge>(new FlowMerge(sourcesPtr)); // protected constructor
 }
-
-template<typename EXPRESSION>
-std::unique_ptr<FlowFilter<EXPRESSION>> FlowOperatorChainable::filter(EXPRESSION expression) {
-    return std::unique_ptr<FlowFilter<EXPRESSION>>(new FlowFilter<EXPRESSION>(this, expression));
-}
@@ -9,8 +9,17 @@
 #ifndef SPI_FLOW_REPRESENTATION_HPP
 #define SPI_FLOW_REPRESENTATION_HPP
 
+#include "./FlowExpression.hpp"
+#include "./Tuple.hpp"
+#include "./TupleBatch.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <numeric>
 #include <string>
+#include <tuple>
 #include <unordered_set>
 #include <vector>
 
@@ -18,8 +27,10 @@ namespace spi {
 
 
 class FlowOutput; // defer declaration (see below)
+template<typename... E> struct FlowAll; // defer declaration (see below)
 class FlowMerge; // defer declaration (see below)
 template<typename E> class FlowFilter; // defer declaration (see below)
+template<typename K> class FlowPartition; // defer declaration (see below)
 
 
 
@@ -45,6 +56,8 @@ public:
     explicit operator bool() const = delete; // prevent if(type)
     bool operator==(FlowWindowType t) const { return t.type == this->type; }
     bool operator!=(FlowWindowType t) const { return t.type != this->type; }
+    constexpr bool operator==(Type t) const { return t == this->type; } // exact match for type == FlowWindowType::...
+    constexpr bool operator!=(Type t) const { return t != this->type; }
     size_t operator()(const FlowWindowType &t) const { return t.type; }
 
     std::string toString() const {
@@ -69,7 +82,16 @@ public:
 
 
 
+/**
+ * Describes the window of a windowed operator (see FlowJoin and "FlowWindowState.hpp").
+ * Window k covers [k * stride, k * stride + size) in milliseconds (TIME_BASED) or tuples (SIZE_BASED).
+ */
 class FlowWindow {
+protected:
+    FlowWindowType type;
+    uint64_t size;
+    uint64_t stride;
+
 public:
 
     /**
@@ -93,6 +115,36 @@ public:
      *                  SESSION_BASED: ignored (extends when tuples arrive within 'size' timeout, otherwise new window)
      */
     FlowWindow(FlowWindowType type, uint64_t size, uint64_t stride);
+
+    FlowWindowType getType() const noexcept {
+        return this->type;
+    }
+
+    uint64_t getSize() const noexcept {
+        return this->size;
+    }
+
+    uint64_t getStride() const noexcept {
+        return this->stride;
+    }
+
+    /** Returns true if windows do not overlap and leave no gaps (stride equals size). */
+    bool isTumbling() const noexcept {
+        return this->stride == this->size;
+    }
+
+    /** Returns true if consecutive windows overlap (stride smaller than size). */
+    bool isSliding() const noexcept {
+        return this->stride < this->size;
+    }
+
+    /**
+     * Returns the length of the panes windows get split into so overlapping windows can share
+     * partial results (greatest common divisor of size and stride).
+     */
+    uint64_t getPaneSize() const noexcept {
+        return std::gcd(this->size, this->stride);
+    }
 };
 
 
@@ -100,6 +152,20 @@ public:
 
 
 
+/**
+ * Kind of a flow operator (used to compile the representation into an executable flow, see "Flow.hpp").
+ */
+enum class FlowOperatorType {
+    INPUT,
+    OUTPUT,
+    MERGE,
+    FILTER,
+    JOIN,
+    PARTITION,
+};
+
+
+
 /**
  * Base class for all flow operators.
  */
@@ -126,7 +192,7 @@ protected:
 public:
 
     /** Deleting one operator will cause the whole chain to be deleted */
-    ~FlowOperator(){
+    virtual ~FlowOperator(){
         if(this->target != nullptr){
             this->target->sources.erase(this);
             delete this->target;
@@ -137,6 +203,25 @@ public:
             delete source;
         }
     }
+
+    /**
+     * Returns the kind of this operator.
+     */
+    virtual FlowOperatorType getType() const = 0;
+
+    /**
+     * Returns the operators that feed their tuples into this operator.
+     */
+    const std::unordered_set<FlowOperator*>& getSources() const {
+        return this->sources;
+    }
+
+    /**
+     * Returns the operator this operator feeds its tuples into (nullptr if none).
+     */
+    FlowOperator* getTarget() const {
+        return this->target;
+    }
 };
 
 
@@ -187,6 +272,32 @@ public:
      */
     template<typename EXPRESSION>
     std::unique_ptr<FlowFilter<EXPRESSION>> filter(EXPRESSION expression);
+
+    /**
+     * Forwards the output of this operator to a single filter operator that only lets tuples pass
+     * that fulfill all given expressions. The expressions get composed at compile time (see FlowAll)
+     * so the compiler can inline all of them into one loop.
+     * 
+     * @return std::unique_ptr<FlowFilter<FlowAll<...>>> Filter operator this operator is chained to.
+     */
+    template<typename FIRST, typename SECOND, typename... MORE>
+    std::unique_ptr<FlowFilter<FlowAll<FIRST, SECOND, MORE...>>> filter(FIRST first, SECOND second, MORE... more);
+
+    /**
+     * Shards the output of this operator by key over parallel instances of the operators that follow.
+     * All operators up to the next merge or output get instantiated once per shard, tuples with the same key
+     * always go to the same shard (so per key order and shard local state are preserved).
+     * The shards get recombined before the next merge or output.
+     * 
+     * @tparam KEY Type of key extractor, needs to be callable as uint64_t(const Tuple&).
+     * @param key Key extractor.
+     * @param parallelism Amount of shards.
+     * @param ordered If true the shards get recombined in the order the tuples entered the partition
+     *                (costs a reorder buffer), otherwise only the order per key is preserved.
+     * @return std::unique_ptr<FlowPartition<KEY>> Partition operator this operator is chained to.
+     */
+    template<typename KEY>
+    std::unique_ptr<FlowPartition<KEY>> partition(KEY key, size_t parallelism, bool ordered = false);
 };
 
 
@@ -229,6 +340,22 @@ public:
      */
     FlowInput(std::vector<std::string> flowNames) : FlowOperatorChainable(), flowNames(flowNames) {}
 
+    FlowOperatorType getType() const override {
+        return FlowOperatorType::INPUT;
+    }
+
+    const std::vector<std::string>& getWorkerNames() const {
+        return this->workerNames;
+    }
+
+    const std::vector<std::string>& getPublisherGroups() const {
+        return this->publisherGroups;
+    }
+
+    const std::vector<std::string>& getFlowNames() const {
+        return this->flowNames;
+    }
+
 };
 
 
@@ -246,6 +373,10 @@ public:
 
     FlowOutput() = delete;
 
+    FlowOperatorType getType() const override {
+        return FlowOperatorType::OUTPUT;
+    }
+
 };
 
 
@@ -262,6 +393,44 @@ public:
     
     FlowMerge() = delete;
 
+    FlowOperatorType getType() const override {
+        return FlowOperatorType::MERGE;
+    }
+
+};
+
+
+
+/**
+ * Type independent part of FlowFilter so filters can be executed without knowing their expression type.
+ */
+class FlowFilterBase : public FlowOperatorChainable {
+protected:
+    FlowFilterBase(FlowOperator* source) : FlowOperatorChainable(source) {}
+
+public:
+
+    FlowOperatorType getType() const override {
+        return FlowOperatorType::FILTER;
+    }
+
+    /**
+     * Applies the expression to the given tuples and moves the ones that pass to the front.
+     * 
+     * @param tuples Tuples to filter (gets reordered).
+     * @param count Amount of tuples.
+     * @return size_t Amount of tuples that passed (now located at the front).
+     */
+    virtual size_t apply(Tuple* tuples, size_t count) const = 0;
+
+    /**
+     * Evaluates the expression on the whole batch into its selection bitmap (SIMD for column expressions)
+     * and compacts the batch so only the tuples that passed remain.
+     * 
+     * @param batch Tuples to filter in column layout.
+     * @return size_t Amount of tuples that passed (new size of the batch).
+     */
+    virtual size_t apply(TupleBatch &batch) const = 0;
 };
 
 
@@ -269,15 +438,15 @@ public:
 /**
  * Flow filter applies a given expression to each tuple and only lets tuples pass that fulfill the expression.
  * 
- * @tparam E Type of expression (see "Expression.hpp")
+ * @tparam E Type of expression (see "FlowExpression.hpp"), needs to be callable as bool(const Tuple&)
  */
 template<typename E>
-class FlowFilter : public FlowOperatorChainable {
+class FlowFilter : public FlowFilterBase {
     friend class FlowOperatorChainable; // to access protected constructor
 protected:
     E expression;
 
-    FlowFilter(FlowOperator* source, E expression) : FlowOperatorChainable(source), expression(expression) {}
+    FlowFilter(FlowOperator* source, E expression) : FlowFilterBase(source), expression(expression) {}
 
 public:
 
@@ -291,15 +460,170 @@ public:
     E getExpression() const {
         return this->expression;
     }
+
+    size_t apply(Tuple* tuples, size_t count) const override {
+        size_t passed = 0;
+        for(size_t i=0; i < count; i++){
+            if(this->expression(tuples[i])){
+                if(passed != i) tuples[passed] = tuples[i];
+                passed++;
+            }
+        }
+        return passed;
+    }
+
+    size_t apply(TupleBatch &batch) const override {
+        if(batch.empty()) return 0;
+        flowEvaluate(this->expression, batch.valueColumn(), batch.size(), batch.selectionBitmap());
+        return batch.compact(batch.selectionBitmap());
+    }
+};
+
+
+
+/**
+ * Expression that is fulfilled if all given expressions are fulfilled (evaluated in order, stops at the first failing one).
+ * 
+ * @tparam E Types of the composed expressions.
+ */
+template<typename... E>
+struct FlowAll {
+    std::tuple<E...> expressions;
+
+    FlowAll(E... expressions) : expressions(expressions...) {}
+
+    inline bool operator()(const Tuple &tuple) const {
+        return std::apply([&tuple](const E&... expression){ return (expression(tuple) && ...); }, this->expressions);
+    }
+
+    /**
+     * Evaluates all expressions on a column (see FlowColumnExpression) and combines their selection bitmaps.
+     */
+    void evaluate(const uint32_t* values, size_t count, uint64_t* selection) const {
+        constexpr size_t CHUNK = 4096; // rows per scratch bitmap
+        uint64_t scratch[CHUNK / 64];
+        for(size_t start=0; start < count; start += CHUNK){
+            const size_t rows = std::min(CHUNK, count - start);
+            const size_t words = (rows + 63) / 64;
+            uint64_t* target = selection + start / 64;
+            bool first = true;
+            std::apply([&](const E&... expression){
+                ([&]{
+                    if(first){
+                        flowEvaluate(expression, values + start, rows, target);
+                        first = false;
+                    } else {
+                        flowEvaluate(expression, values + start, rows, scratch);
+                        for(size_t w=0; w < words; w++) target[w] &= scratch[w];
+                    }
+                }(), ...);
+            }, this->expressions);
+        }
+    }
+};
+
+
+
+/**
+ * Type independent part of FlowPartition so partitions can be executed without knowing their key type.
+ */
+class FlowPartitionBase : public FlowOperatorChainable {
+protected:
+    size_t parallelism;
+    bool ordered;
+
+    FlowPartitionBase(FlowOperator* source, size_t parallelism, bool ordered) :
+            FlowOperatorChainable(source), parallelism(std::max((size_t)1, parallelism)), ordered(ordered) {}
+
+    /** Spreads hashes of sequential keys evenly and maps them onto [0, parallelism). */
+    inline uint32_t shardOfKey(uint64_t key) const noexcept {
+        key ^= key >> 33; // murmur3 finalizer
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        return (uint32_t)(((key & 0xFFFFFFFFULL) * this->parallelism) >> 32);
+    }
+
+public:
+
+    FlowOperatorType getType() const override {
+        return FlowOperatorType::PARTITION;
+    }
+
+    /** Returns the amount of shards. */
+    size_t getParallelism() const noexcept {
+        return this->parallelism;
+    }
+
+    /** Returns true if the shards get recombined in input order. */
+    bool isOrdered() const noexcept {
+        return this->ordered;
+    }
+
+    /**
+     * Computes the shard of every tuple.
+     * 
+     * @param tuples Tuples to route.
+     * @param count Amount of tuples.
+     * @param shards Receives the shard index in [0, getParallelism()) of every tuple.
+     */
+    virtual void route(const Tuple* tuples, size_t count, uint32_t* shards) const = 0;
 };
 
 
 
+/**
+ * Flow partition shards tuples by key over parallel instances of the following operators (see FlowOperatorChainable::partition()).
+ * 
+ * @tparam K Type of key extractor, needs to be callable as uint64_t(const Tuple&)
+ */
+template<typename K>
+class FlowPartition : public FlowPartitionBase {
+    friend class FlowOperatorChainable; // to access protected constructor
+protected:
+    K key;
+
+    FlowPartition(FlowOperator* source, K key, size_t parallelism, bool ordered) : FlowPartitionBase(source, parallelism, ordered), key(key) {}
+
+public:
+
+    FlowPartition() = delete;
+
+    void route(const Tuple* tuples, size_t count, uint32_t* shards) const override {
+        for(size_t i=0; i < count; i++) shards[i] = this->shardOfKey((uint64_t)this->key(tuples[i]));
+    }
+
+    /**
+     * Returns the key extractor.
+     */
+    K getKey() const {
+        return this->key;
+    }
+};
+
+
+
+template<typename EXPRESSION>
+std::unique_ptr<FlowFilter<EXPRESSION>> FlowOperatorChainable::filter(EXPRESSION expression) {
+    return std::unique_ptr<FlowFilter<EXPRESSION>>(new FlowFilter<EXPRESSION>(this, expression)); // protected constructor
+}
+
+template<typename FIRST, typename SECOND, typename... MORE>
+std::unique_ptr<FlowFilter<FlowAll<FIRST, SECOND, MORE...>>> FlowOperatorChainable::filter(FIRST first, SECOND second, MORE... more) {
+    return this->filter(FlowAll<FIRST, SECOND, MORE...>(first, second, more...));
+}
+
+template<typename KEY>
+std::unique_ptr<FlowPartition<KEY>> FlowOperatorChainable::partition(KEY key, size_t parallelism, bool ordered) {
+    return std::unique_ptr<FlowPartition<KEY>>(new FlowPartition<KEY>(this, key, parallelism, ordered)); // protected constructor
+}
+
+
+
 
 /**
  * Flow join joins tuples from two sources based on the given expression and window.
  * 
- * @tparam E Type of expression (see "Expression.hpp")
+ * @tparam E Type of expression (see "FlowExpression.hpp"), needs to be callable as bool(const Tuple &left, const Tuple &right)
  * @tparam W Type of window (see "Flow.hpp")
  */
 template<typename E, typename W>
@@ -315,6 +639,10 @@ public:
 
     FlowJoin() = delete;
 
+    FlowOperatorType getType() const override {
+        return FlowOperatorType::JOIN;
+    }
+
     /**
      * Returns the expression that is applied to each tuple.
      * 
@@ -324,6 +652,13 @@ public:
         return this->expression;
     }
 
+    /**
+     * Returns if the given pair of tuples gets joined.
+     */
+    inline bool matches(const Tuple &left, const Tuple &right) const {
+        return (bool)this->expression(left, right);
+    }
+
     /**
      * Returns the window that defines how long tuples are considered for joining.
      * 
@@ -0,0 +1,551 @@
+/**
+ * Binary wire formats to deploy flows on other nodes and exchange tuples between them.
+ *
+ * Flow graphs are encoded compactly (LEB128 varints) and versioned so nodes can reject
+ * graphs of a newer format. Tuples are exchanged as records with a fixed layout:
+ * a 24 byte header followed by the values as little-endian uint32_t. Receivers read
+ * the values in place without parsing (big-endian hosts convert them once with the
+ * bulk conversions of Endian).
+ *
+ * @file FlowSerialization.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+#ifndef SPI_FLOW_SERIALIZATION_HPP
+#define SPI_FLOW_SERIALIZATION_HPP
+
+#include "./Endian.hpp"
+#include "./FlowExpression.hpp"
+#include "./FlowRepresentation.hpp"
+#include "./Tuple.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace spi {
+
+
+
+/**
+ * Appends primitive values to a byte buffer (integers as LEB128 varints).
+ */
+class FlowWireWriter {
+protected:
+    std::vector<uint8_t> &out;
+
+public:
+    FlowWireWriter(std::vector<uint8_t> &out) : out(out) {}
+
+    inline void writeByte(uint8_t value){
+        this->out.push_back(value);
+    }
+
+    inline void writeVarint(uint64_t value){
+        while(value >= 0x80){
+            this->out.push_back((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        this->out.push_back((uint8_t)value);
+    }
+
+    inline void writeString(const std::string &value){
+        this->writeVarint(value.size());
+        this->out.insert(this->out.end(), value.begin(), value.end());
+    }
+
+    inline void writeStrings(const std::vector<std::string> &values){
+        this->writeVarint(values.size());
+        for(const std::string &value : values) this->writeString(value);
+    }
+};
+
+
+/**
+ * Reads primitive values written by FlowWireWriter and throws std::invalid_argument if the input is malformed.
+ */
+class FlowWireReader {
+protected:
+    const uint8_t* data;
+    size_t size;
+    size_t position = 0;
+
+    inline void require(size_t bytes) const {
+        if(bytes > this->size - this->position)
+            throw std::invalid_argument("Flow encoding truncated at byte "+std::to_string(this->position));
+    }
+
+public:
+    FlowWireReader(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+    inline uint8_t readByte(){
+        this->require(1);
+        return this->data[this->position++];
+    }
+
+    inline uint64_t readVarint(){
+        uint64_t value = 0;
+        for(unsigned shift=0; shift < 64; shift += 7){
+            const uint8_t byte = this->readByte();
+            value |= (uint64_t)(byte & 0x7F) << shift;
+            if((byte & 0x80) == 0) return value;
+        }
+        throw std::invalid_argument("Flow encoding contains a varint longer than 64 bits");
+    }
+
+    /** Reads a varint that needs to be at most max. */
+    inline uint64_t readVarint(uint64_t max, const char* what){
+        const uint64_t value = this->readVarint();
+        if(value > max) throw std::invalid_argument(std::string("Flow encoding contains invalid ")+what+" "+std::to_string(value));
+        return value;
+    }
+
+    inline std::string readString(){
+        const size_t length = (size_t)this->readVarint();
+        this->require(length);
+        std::string value(reinterpret_cast<const char*>(this->data + this->position), length);
+        this->position += length;
+        return value;
+    }
+
+    inline std::vector<std::string> readStrings(){
+        const size_t count = (size_t)this->readVarint(this->size - this->position, "amount of strings");
+        std::vector<std::string> values;
+        values.reserve(count);
+        for(size_t i=0; i < count; i++) values.push_back(this->readString());
+        return values;
+    }
+
+    inline size_t remaining() const noexcept {
+        return this->size - this->position;
+    }
+};
+
+
+
+/**
+ * Encodes and decodes graphs of flow operators (see "FlowRepresentation.hpp").
+ *
+ * Layout: magic "SPIF", version (varint), amount of operators (varint), followed by the operators
+ * with sources before the operators they feed into. Every operator is its type (byte), the indices
+ * of its sources (varints) and its parameters. Only operators whose parameters are data can be encoded:
+ * inputs, outputs, merges, filters with FlowDynamicExpression, FlowValueCompare or FlowValueRange
+ * and partitions keyed by a FlowDynamicExpression. Others (e.g. lambdas) throw std::invalid_argument.
+ * Inputs either subscribe to flows or to workers/publishers, never both, and partitions have
+ * at most MAX_PARALLELISM shards so a received graph cannot make a node allocate unbounded state.
+ */
+class FlowGraphCodec {
+public:
+    static constexpr uint8_t MAGIC[4] = {'S', 'P', 'I', 'F'};
+    static constexpr uint64_t VERSION = 1;
+    static constexpr uint64_t MAX_PARALLELISM = 1024;
+
+protected:
+
+    enum class Tag : uint8_t {
+        INPUT = 0,
+        OUTPUT = 1,
+        MERGE = 2,
+        FILTER_DYNAMIC = 3,
+        FILTER_COMPARE = 4,
+        FILTER_RANGE = 5,
+        PARTITION_DYNAMIC = 6,
+    };
+
+    static void encodeExpression(FlowWireWriter &writer, const FlowDynamicExpression &expression){
+        typedef FlowDynamicExpression::Op Op;
+        const std::vector<FlowDynamicExpression::Instruction> &code = expression.getCode();
+        writer.writeVarint(code.size());
+        for(const FlowDynamicExpression::Instruction &instruction : code){
+            writer.writeByte((uint8_t)instruction.op);
+            if(instruction.op == Op::CONSTANT) writer.writeVarint(instruction.constant);
+            else if(instruction.op == Op::FIELD || instruction.op == Op::JUMP_IF_FALSE || instruction.op == Op::JUMP_IF_TRUE)
+                writer.writeVarint(instruction.argument);
+        }
+    }
+
+    static FlowDynamicExpression decodeExpression(FlowWireReader &reader){
+        typedef FlowDynamicExpression::Op Op;
+        const size_t length = (size_t)reader.readVarint(reader.remaining(), "expression length");
+        std::vector<FlowDynamicExpression::Instruction> code;
+        code.reserve(length);
+        for(size_t i=0; i < length; i++){
+            const uint8_t raw = reader.readByte();
+            if(raw > (uint8_t)Op::JUMP_IF_TRUE) throw std::invalid_argument("Flow encoding contains invalid expression operation "+std::to_string(raw));
+            const Op op = (Op)raw;
+            FlowDynamicExpression::Instruction instruction{op, 0, 0};
+            if(op == Op::CONSTANT) instruction.constant = reader.readVarint();
+            else if(op == Op::FIELD || op == Op::JUMP_IF_FALSE || op == Op::JUMP_IF_TRUE)
+                instruction.argument = (uint32_t)reader.readVarint(UINT32_MAX, "expression argument");
+            code.push_back(instruction);
+        }
+        return FlowDynamicExpression::fromCode(std::move(code)); // validates the bytecode
+    }
+
+    /** Appends the operator after its sources. */
+    static void order(const FlowOperator* op, std::vector<const FlowOperator*> &ordered, std::unordered_map<const FlowOperator*, size_t> &indices){
+        for(const FlowOperator* source : op->getSources()){
+            if(indices.find(source) == indices.end()) order(source, ordered, indices);
+        }
+        indices.emplace(op, ordered.size());
+        ordered.push_back(op);
+    }
+
+    static void encodeOperator(FlowWireWriter &writer, const FlowOperator* op){
+        switch(op->getType()){
+            case FlowOperatorType::INPUT: {
+                const FlowInput* input = static_cast<const FlowInput*>(op);
+                if(!input->getFlowNames().empty() && (!input->getWorkerNames().empty() || !input->getPublisherGroups().empty()))
+                    throw std::invalid_argument("FlowInput cannot be encoded with flow names and worker names or publisher groups at once");
+                writer.writeByte((uint8_t)Tag::INPUT);
+                writer.writeStrings(input->getWorkerNames());
+                writer.writeStrings(input->getPublisherGroups());
+                writer.writeStrings(input->getFlowNames());
+                return;
+            }
+            case FlowOperatorType::OUTPUT:
+                writer.writeByte((uint8_t)Tag::OUTPUT);
+                return;
+            case FlowOperatorType::MERGE:
+                writer.writeByte((uint8_t)Tag::MERGE);
+                return;
+            case FlowOperatorType::FILTER: {
+                if(const FlowFilter<FlowDynamicExpression>* filter = dynamic_cast<const FlowFilter<FlowDynamicExpression>*>(op)){
+                    writer.writeByte((uint8_t)Tag::FILTER_DYNAMIC);
+                    encodeExpression(writer, filter->getExpression());
+                } else if(const FlowFilter<FlowValueCompare>* compare = dynamic_cast<const FlowFilter<FlowValueCompare>*>(op)){
+                    writer.writeByte((uint8_t)Tag::FILTER_COMPARE);
+                    writer.writeByte((uint8_t)compare->getExpression().op);
+                    writer.writeVarint(compare->getExpression().constant);
+                } else if(const FlowFilter<FlowValueRange>* range = dynamic_cast<const FlowFilter<FlowValueRange>*>(op)){
+                    writer.writeByte((uint8_t)Tag::FILTER_RANGE);
+                    writer.writeVarint(range->getExpression().min);
+                    writer.writeVarint(range->getExpression().max);
+                } else {
+                    throw std::invalid_argument("FlowFilter can only be encoded with FlowDynamicExpression, FlowValueCompare or FlowValueRange");
+                }
+                return;
+            }
+            case FlowOperatorType::PARTITION: {
+                const FlowPartition<FlowDynamicExpression>* partition = dynamic_cast<const FlowPartition<FlowDynamicExpression>*>(op);
+                if(partition == nullptr) throw std::invalid_argument("FlowPartition can only be encoded with a FlowDynamicExpression as key");
+                if(partition->getParallelism() > MAX_PARALLELISM)
+                    throw std::invalid_argument("FlowPartition can be encoded with a parallelism of at most "+std::to_string(MAX_PARALLELISM));
+                writer.writeByte((uint8_t)Tag::PARTITION_DYNAMIC);
+                writer.writeVarint(partition->getParallelism());
+                writer.writeByte(partition->isOrdered() ? 1 : 0);
+                encodeExpression(writer, partition->getKey());
+                return;
+            }
+            case FlowOperatorType::JOIN:
+                break;
+        }
+        throw std::invalid_argument("FlowJoin cannot be encoded yet");
+    }
+
+    /**
+     * Returns the single source of a chained operator and hands its ownership over to the chain.
+     *
+     * @param roots Decoded operators that do not feed into another operator yet (own their chains).
+     */
+    static FlowOperatorChainable* chained(const std::vector<FlowOperatorChainable*> &sources, std::vector<std::unique_ptr<FlowOperator>> &roots){
+        if(sources.size() != 1) throw std::invalid_argument("Flow encoding contains an operator with "+std::to_string(sources.size())+" sources instead of one");
+        for(size_t i=0; i < roots.size(); i++){
+            if(roots[i].get() == sources[0]){
+                roots[i].release(); // owned by the chain from now on
+                roots.erase(roots.begin() + (std::ptrdiff_t)i);
+                return sources[0];
+            }
+        }
+        throw std::invalid_argument("Flow encoding uses the output of an operator twice");
+    }
+
+public:
+
+    /**
+     * Encodes the flow that ends in the given output.
+     *
+     * @param output Output of the flow.
+     * @return std::vector<uint8_t> Encoded flow.
+     */
+    static std::vector<uint8_t> encode(const FlowOutput &output){
+        std::vector<const FlowOperator*> ordered;
+        std::unordered_map<const FlowOperator*, size_t> indices;
+        order(&output, ordered, indices);
+
+        std::vector<uint8_t> bytes(MAGIC, MAGIC + sizeof(MAGIC));
+        FlowWireWriter writer(bytes);
+        writer.writeVarint(VERSION);
+        writer.writeVarint(ordered.size());
+        for(const FlowOperator* op : ordered){
+            encodeOperator(writer, op);
+            if(op->getType() == FlowOperatorType::INPUT) continue;
+            std::vector<size_t> sources;
+            for(const FlowOperator* source : op->getSources()) sources.push_back(indices.at(source));
+            std::sort(sources.begin(), sources.end());
+            writer.writeVarint(sources.size());
+            for(size_t source : sources) writer.writeVarint(source);
+        }
+        return bytes;
+    }
+
+    /**
+     * Decodes a flow encoded with encode() (possibly by another node).
+     * Throws std::invalid_argument if the encoding is malformed or of a newer version.
+     *
+     * @param data Encoded flow.
+     * @param size Amount of bytes.
+     * @return std::unique_ptr<FlowOutput> Output of the decoded flow (owns the whole flow).
+     */
+    static std::unique_ptr<FlowOutput> decode(const uint8_t* data, size_t size){
+        if(size < sizeof(MAGIC) || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0)
+            throw std::invalid_argument("Flow encoding does not start with the expected magic");
+        FlowWireReader reader(data + sizeof(MAGIC), size - sizeof(MAGIC));
+        const uint64_t version = reader.readVarint();
+        if(version == 0 || version > VERSION)
+            throw std::invalid_argument("Flow encoding has version "+std::to_string(version)+" but only up to "+std::to_string(VERSION)+" is supported");
+        const size_t count = (size_t)reader.readVarint(reader.remaining(), "amount of operators");
+
+        std::vector<FlowOperator*> operators;                // by index
+        std::vector<std::unique_ptr<FlowOperator>> roots;    // operators that are not fed into another operator yet
+        std::unique_ptr<FlowOutput> output;
+        for(size_t i=0; i < count; i++){
+            const Tag tag = (Tag)reader.readByte();
+            std::unique_ptr<FlowOperator> op;
+            if(tag == Tag::INPUT){
+                std::vector<std::string> workerNames = reader.readStrings();
+                std::vector<std::string> publisherGroups = reader.readStrings();
+                std::vector<std::string> flowNames = reader.readStrings();
+                if(!flowNames.empty() && (!workerNames.empty() || !publisherGroups.empty()))
+                    throw std::invalid_argument("Flow encoding contains an input with flow names and worker names or publisher groups");
+                op.reset(flowNames.empty() ? new FlowInput(workerNames, publisherGroups) : new FlowInput(flowNames));
+            } else {
+                std::vector<FlowOperatorChainable*> sources;
+                FlowDynamicExpression expression = FlowDynamicExpression::constant(0);
+                FlowCompare compare = FlowCompare::EQUAL;
+                uint64_t first = 0, second = 0;
+                bool ordered = false;
+                switch(tag){
+                    case Tag::OUTPUT: case Tag::MERGE: break;
+                    case Tag::FILTER_DYNAMIC: expression = decodeExpression(reader); break;
+                    case Tag::FILTER_COMPARE:
+                        compare = (FlowCompare)reader.readByte();
+                        if(compare > FlowCompare::NOT_EQUAL) throw std::invalid_argument("Flow encoding contains invalid comparison "+std::to_string((unsigned)compare));
+                        first = reader.readVarint(UINT32_MAX, "constant");
+                        break;
+                    case Tag::FILTER_RANGE:
+                        first = reader.readVarint(UINT32_MAX, "range minimum");
+                        second = reader.readVarint(UINT32_MAX, "range maximum");
+                        break;
+                    case Tag::PARTITION_DYNAMIC:
+                        first = reader.readVarint(MAX_PARALLELISM, "parallelism");
+                        if(first == 0) throw std::invalid_argument("Flow encoding contains invalid parallelism 0");
+                        ordered = reader.readByte() != 0;
+                        expression = decodeExpression(reader);
+                        break;
+                    default:
+                        throw std::invalid_argument("Flow encoding contains unknown operator "+std::to_string((unsigned)tag));
+                }
+                const size_t sourceCount = (size_t)reader.readVarint(i, "amount of sources");
+                for(size_t s=0; s < sourceCount; s++){
+                    FlowOperator* source = operators[(size_t)reader.readVarint(i - 1, "source index")]; // sourceCount > 0 implies i > 0
+                    if(source->getType() == FlowOperatorType::OUTPUT) throw std::invalid_argument("Flow encoding feeds an output into another operator");
+                    sources.push_back(static_cast<FlowOperatorChainable*>(source));
+                }
+                switch(tag){
+                    case Tag::OUTPUT: output = chained(sources, roots)->output(); break;
+                    case Tag::MERGE: {
+                        if(sources.size() < 2) throw std::invalid_argument("Flow encoding contains a merge with less than two sources");
+                        std::vector<std::unique_ptr<FlowOperator>> others;
+                        for(size_t s=1; s < sources.size(); s++){
+                            std::vector<FlowOperatorChainable*> single = {sources[s]};
+                            others.emplace_back(chained(single, roots));
+                        }
+                        std::vector<FlowOperatorChainable*> head = {sources[0]};
+                        op = chained(head, roots)->merge(std::move(others));
+                        break;
+                    }
+                    case Tag::FILTER_DYNAMIC: op = chained(sources, roots)->filter(expression); break;
+                    case Tag::FILTER_COMPARE: op = chained(sources, roots)->filter(FlowValueCompare{compare, (uint32_t)first}); break;
+                    case Tag::FILTER_RANGE: op = chained(sources, roots)->filter(FlowValueRange{(uint32_t)first, (uint32_t)second}); break;
+                    case Tag::PARTITION_DYNAMIC: op = chained(sources, roots)->partition(expression, (size_t)first, ordered); break;
+                    default: break;
+                }
+            }
+            if(output){
+                operators.push_back(output.get());
+                if(i + 1 != count) throw std::invalid_argument("Flow encoding continues after its output");
+            } else {
+                operators.push_back(op.get());
+                roots.push_back(std::move(op));
+            }
+        }
+        if(!output) throw std::invalid_argument("Flow encoding does not end with an output");
+        if(!roots.empty()) throw std::invalid_argument("Flow encoding contains operators that do not reach the output");
+        return output;
+    }
+
+    static std::unique_ptr<FlowOutput> decode(const std::vector<uint8_t> &bytes){
+        return decode(bytes.data(), bytes.size());
+    }
+};
+
+
+
+/**
+ * Fixed 24 byte header of a tuple record (all fields little-endian).
+ */
+struct FlowTupleRecordHeader {
+    uint32_t magic;     // "SPIT"
+    uint16_t version;
+    uint16_t tupleSize; // bytes per tuple
+    uint32_t count;     // amount of tuples
+    uint32_t flags;     // FlowTupleRecord::BIG_ENDIAN_VALUES if the values have been converted for a big-endian host
+    uint64_t sequence;  // assigned by the sender (e.g. to detect gaps)
+};
+static_assert(sizeof(FlowTupleRecordHeader) == 24 && std::is_standard_layout_v<FlowTupleRecordHeader>);
+
+
+/**
+ * Record of tuples that gets written into (network) buffers and read in place on the receiving node.
+ *
+ * Layout: FlowTupleRecordHeader followed by count values as little-endian uint32_t (4 bytes each).
+ * The values start 24 bytes after the record, so records at 8 byte aligned addresses can be read
+ * directly as uint32_t (or Tuple) arrays.
+ */
+class FlowTupleRecord {
+public:
+    static constexpr uint32_t MAGIC = 0x54495053; // "SPIT" in little-endian
+    static constexpr uint16_t VERSION = 1;
+    static constexpr uint32_t BIG_ENDIAN_VALUES = 1;
+    static constexpr size_t HEADER_SIZE = sizeof(FlowTupleRecordHeader);
+
+    static_assert(sizeof(Tuple) == sizeof(uint32_t) && std::is_standard_layout_v<Tuple>, "Tuples need to have the layout of their value");
+
+protected:
+    const FlowTupleRecordHeader* header = nullptr;
+    const uint32_t* values = nullptr;
+
+    FlowTupleRecord(const FlowTupleRecordHeader* header, const uint32_t* values) : header(header), values(values) {}
+
+    static inline void writeHeader(void* buffer, size_t count, uint64_t sequence){
+        const FlowTupleRecordHeader header{Endian::toLittle(MAGIC), Endian::toLittle(VERSION), Endian::toLittle((uint16_t)sizeof(uint32_t)),
+                                           Endian::toLittle((uint32_t)count), 0, Endian::toLittle(sequence)};
+        std::memcpy(buffer, &header, HEADER_SIZE);
+    }
+
+public:
+
+    /** Returns the amount of bytes a record of the given amount of tuples needs. */
+    static constexpr size_t size(size_t count) noexcept {
+        return HEADER_SIZE + count * sizeof(uint32_t);
+    }
+
+    /**
+     * Writes a record of the given values (e.g. TupleBatch::valueColumn()) into the buffer.
+     *
+     * @param buffer Buffer with room for at least size(count) bytes.
+     * @param capacity Size of the buffer in bytes.
+     * @param values Values of the tuples.
+     * @param count Amount of tuples.
+     * @param sequence Sequence number of the record.
+     * @return size_t Amount of bytes written.
+     */
+    static size_t write(void* buffer, size_t capacity, const uint32_t* values, size_t count, uint64_t sequence = 0){
+        if(count > UINT32_MAX) throw std::invalid_argument("FlowTupleRecord holds at most "+std::to_string(UINT32_MAX)+" tuples");
+        if(capacity < size(count))
+            throw std::length_error("FlowTupleRecord of "+std::to_string(count)+" tuples needs "+std::to_string(size(count))+" bytes but buffer has "+std::to_string(capacity));
+        writeHeader(buffer, count, sequence);
+        uint8_t* payload = static_cast<uint8_t*>(buffer) + HEADER_SIZE;
+        if(((uintptr_t)payload % alignof(uint32_t)) == 0){
+            Endian::toLittle<uint32_t>(std::span<const uint32_t>(values, count), std::span<uint32_t>(reinterpret_cast<uint32_t*>(payload), count));
+        } else {
+            for(size_t i=0; i < count; i++){
+                const uint32_t value = Endian::toLittle(values[i]);
+                std::memcpy(payload + i * sizeof(uint32_t), &value, sizeof(uint32_t));
+            }
+        }
+        return size(count);
+    }
+
+    /**
+     * Writes a record of the given tuples into the buffer (see above).
+     */
+    static size_t write(void* buffer, size_t capacity, const Tuple* tuples, size_t count, uint64_t sequence = 0){
+        return write(buffer, capacity, reinterpret_cast<const uint32_t*>(tuples), count, sequence); // same layout (see static_assert)
+    }
+
+    /**
+     * Opens a record in place (e.g. in a receive buffer). Validates the header and, on big-endian
+     * hosts, converts the values in place once (reopening the record does not convert them again).
+     * Throws std::invalid_argument if the record is malformed, truncated or not 4 byte aligned.
+     *
+     * @param buffer Record written by write().
+     * @param size Amount of bytes available in the buffer (may contain further records).
+     */
+    static FlowTupleRecord open(void* buffer, size_t size){
+        if(size < HEADER_SIZE) throw std::invalid_argument("FlowTupleRecord truncated: "+std::to_string(size)+" bytes");
+        if(((uintptr_t)buffer % alignof(uint32_t)) != 0) throw std::invalid_argument("FlowTupleRecord needs to be 4 byte aligned to be read in place");
+        FlowTupleRecordHeader* header = static_cast<FlowTupleRecordHeader*>(buffer);
+        if(Endian::fromLittle(header->magic) != MAGIC) throw std::invalid_argument("FlowTupleRecord does not start with the expected magic");
+        if(Endian::fromLittle(header->version) == 0 || Endian::fromLittle(header->version) > VERSION)
+            throw std::invalid_argument("FlowTupleRecord has version "+std::to_string(Endian::fromLittle(header->version))+" but only up to "+std::to_string(VERSION)+" is supported");
+        if(Endian::fromLittle(header->tupleSize) != sizeof(uint32_t))
+            throw std::invalid_argument("FlowTupleRecord has tuples of "+std::to_string(Endian::fromLittle(header->tupleSize))+" bytes");
+        const size_t count = Endian::fromLittle(header->count);
+        if(size < FlowTupleRecord::size(count))
+            throw std::invalid_argument("FlowTupleRecord of "+std::to_string(count)+" tuples truncated: "+std::to_string(size)+" bytes");
+
+        uint32_t* values = reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(buffer) + HEADER_SIZE);
+        const uint32_t flags = Endian::fromLittle(header->flags);
+        if(Endian::HOST_IS_BIG && (flags & BIG_ENDIAN_VALUES) == 0){
+            Endian::fromLittle(std::span<uint32_t>(values, count));
+            header->flags = Endian::toLittle(flags | BIG_ENDIAN_VALUES);
+        } else if(Endian::HOST_IS_LITTLE && (flags & BIG_ENDIAN_VALUES) != 0){
+            throw std::invalid_argument("FlowTupleRecord has been converted for a big-endian host");
+        }
+        return FlowTupleRecord(header, values);
+    }
+
+    /** Returns the amount of tuples. */
+    inline size_t count() const noexcept {
+        return Endian::fromLittle(this->header->count);
+    }
+
+    /** Returns the sequence number assigned by the sender. */
+    inline uint64_t sequence() const noexcept {
+        return Endian::fromLittle(this->header->sequence);
+    }
+
+    /** Returns the amount of bytes of the record (offset of the next record in the same buffer). */
+    inline size_t bytes() const noexcept {
+        return size(this->count());
+    }
+
+    /** Returns the values in host byte order (points into the buffer). */
+    inline const uint32_t* valueColumn() const noexcept {
+        return this->values;
+    }
+
+    /** Returns the tuples (points into the buffer, e.g. for Flow::pushBulk()). */
+    inline const Tuple* tuples() const noexcept {
+        return reinterpret_cast<const Tuple*>(this->values); // same layout (see static_assert)
+    }
+
+    inline Tuple operator[](size_t index) const noexcept {
+        return Tuple(this->values[index]);
+    }
+};
+
+
+
+}
+#endif // SPI_FLOW_SERIALIZATION_HPP
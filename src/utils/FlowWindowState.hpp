@@ -0,0 +1,567 @@
+/**
+ * State of windowed flow operators: pane based window aggregations
+ * and the hash partitioned join buffers of FlowJoin.
+ *
+ * @file FlowWindowState.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+
+#ifndef SPI_FLOW_WINDOW_STATE_HPP
+#define SPI_FLOW_WINDOW_STATE_HPP
+
+#include "./FlowRepresentation.hpp"
+#include "./Tuple.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace spi {
+
+
+
+/**
+ * Aggregation that can be computed per pane and then combined into the result of a whole window.
+ * State is the partial result, identity() the partial result of an empty pane.
+ */
+template<typename A>
+concept FlowAggregate = requires(const A aggregate, typename A::State &state, const typename A::State &other, const Tuple &tuple){
+    { aggregate.identity() } -> std::convertible_to<typename A::State>;
+    aggregate.add(state, tuple);
+    aggregate.combine(state, other);
+};
+
+/** Counts the tuples of a window. */
+struct FlowCount {
+    typedef uint64_t State;
+    State identity() const noexcept { return 0; }
+    void add(State &state, const Tuple&) const noexcept { state++; }
+    void combine(State &state, const State &other) const noexcept { state += other; }
+};
+
+/** Sums up the values of a window. */
+struct FlowSum {
+    typedef uint64_t State;
+    State identity() const noexcept { return 0; }
+    void add(State &state, const Tuple &tuple) const noexcept { state += tuple.getValue(); }
+    void combine(State &state, const State &other) const noexcept { state += other; }
+};
+
+/** Smallest value of a window. */
+struct FlowMin {
+    typedef uint32_t State;
+    State identity() const noexcept { return std::numeric_limits<uint32_t>::max(); }
+    void add(State &state, const Tuple &tuple) const noexcept { state = std::min(state, tuple.getValue()); }
+    void combine(State &state, const State &other) const noexcept { state = std::min(state, other); }
+};
+
+/** Largest value of a window. */
+struct FlowMax {
+    typedef uint32_t State;
+    State identity() const noexcept { return 0; }
+    void add(State &state, const Tuple &tuple) const noexcept { state = std::max(state, tuple.getValue()); }
+    void combine(State &state, const State &other) const noexcept { state = std::max(state, other); }
+};
+
+
+
+/**
+ * Growable ring buffer addressed by absolute sequence numbers (sequence of the front only ever increases).
+ * Capacity is always a power of two so a sequence maps to its slot with a mask.
+ */
+template<typename T>
+class FlowRing {
+protected:
+    std::vector<T> slots;
+    uint64_t mask;
+    uint64_t head = 0; // sequence of the front
+    uint64_t tail = 0; // sequence the next element gets
+
+    void grow(){
+        std::vector<T> larger(this->slots.size() * 2);
+        const uint64_t largerMask = larger.size() - 1;
+        for(uint64_t seq=this->head; seq < this->tail; seq++) larger[seq & largerMask] = std::move(this->slots[seq & this->mask]);
+        this->slots = std::move(larger);
+        this->mask = largerMask;
+    }
+
+public:
+    explicit FlowRing(size_t capacity = 16) : slots(std::bit_ceil(std::max((size_t)2, capacity))), mask(slots.size() - 1) {}
+
+    /** Appends an element and returns its sequence. */
+    uint64_t push(T value){
+        if(this->tail - this->head == this->slots.size()) this->grow();
+        this->slots[this->tail & this->mask] = std::move(value);
+        return this->tail++;
+    }
+
+    void pop() noexcept {
+        this->head++;
+    }
+
+    T& front() noexcept {
+        return this->slots[this->head & this->mask];
+    }
+
+    /** Element with the given sequence (must be in [headSequence(), tailSequence())). */
+    T& at(uint64_t seq) noexcept {
+        return this->slots[seq & this->mask];
+    }
+
+    const T& at(uint64_t seq) const noexcept {
+        return this->slots[seq & this->mask];
+    }
+
+    uint64_t headSequence() const noexcept {
+        return this->head;
+    }
+
+    uint64_t tailSequence() const noexcept {
+        return this->tail;
+    }
+
+    size_t size() const noexcept {
+        return (size_t)(this->tail - this->head);
+    }
+
+    bool empty() const noexcept {
+        return this->tail == this->head;
+    }
+
+    size_t capacity() const noexcept {
+        return this->slots.size();
+    }
+};
+
+
+
+/**
+ * Incrementally evaluated window aggregation.
+ *
+ * Time is split into panes of FlowWindow::getPaneSize() so every tuple only updates the partial result of one pane
+ * and a window combines size / paneSize partial results instead of recomputing over all its tuples
+ * (overlapping sliding windows share their panes). Panes live in a ring buffer that starts at the first
+ * window that has not been emitted yet. Windows get emitted once the watermark passed their end,
+ * windows without tuples are skipped.
+ *
+ * TIME_BASED windows are driven by the event time passed to add() and by advance(watermark),
+ * SIZE_BASED windows use the position of the tuple as time and emit as soon as a window is full.
+ *
+ * Not thread safe (one instance per operator instance / key partition).
+ *
+ * @tparam A Aggregation (see FlowAggregate).
+ */
+template<FlowAggregate A>
+class FlowWindowAggregation {
+public:
+    typedef typename A::State State;
+
+    /** Default upper bound of panes kept at once (bounds the memory of the aggregation). */
+    static constexpr size_t DEFAULT_MAX_PANES = 1 << 16;
+
+protected:
+    struct Pane {
+        State state;
+        uint64_t tuples;
+    };
+
+    A aggregate;
+    FlowWindow window;
+    uint64_t paneSize;
+    uint64_t panesPerWindow;
+    uint64_t panesPerStride;
+    size_t maxPanes;
+    std::vector<Pane> panes;     // ring, pane i lives at panes[i & mask]
+    uint64_t mask;
+    uint64_t nextWindow = 0;     // first window that has not been emitted
+    uint64_t watermark = 0;
+    uint64_t liveTuples = 0;     // tuples in panes that are still part of a window
+    uint64_t counted = 0;        // SIZE_BASED: amount of tuples added so far
+    uint64_t late = 0;
+    uint64_t dropped = 0;
+
+    inline uint64_t firstPane() const noexcept {
+        return this->nextWindow * this->panesPerStride;
+    }
+
+    inline Pane& pane(uint64_t index) noexcept {
+        return this->panes[index & this->mask];
+    }
+
+    /** Grows the ring so pane 'index' fits, returns false if that would exceed maxPanes. */
+    bool reach(uint64_t index){
+        const uint64_t first = this->firstPane();
+        if(index - first < this->panes.size()) return true;
+        const uint64_t required = std::bit_ceil(index - first + 1);
+        if(required > this->maxPanes) return false;
+        std::vector<Pane> larger(required, Pane{this->aggregate.identity(), 0});
+        const uint64_t largerMask = required - 1;
+        for(uint64_t i=first; i < first + this->panes.size(); i++) larger[i & largerMask] = this->panes[i & this->mask];
+        this->panes = std::move(larger);
+        this->mask = largerMask;
+        return true;
+    }
+
+    /** Counts a tuple into its pane, returns false if it got dropped. */
+    bool insert(const Tuple &tuple, uint64_t time){
+        const uint64_t index = time / this->paneSize;
+        if(index % this->panesPerStride >= this->panesPerWindow){
+            this->dropped++; // falls into a gap between windows (stride > size)
+            return false;
+        }
+        if(index < this->firstPane() || time < this->watermark){
+            this->late++;
+            return false;
+        }
+        if(!this->reach(index)){
+            this->dropped++; // too far ahead of the oldest open window
+            return false;
+        }
+        Pane &p = this->pane(index);
+        this->aggregate.add(p.state, tuple);
+        p.tuples++;
+        this->liveTuples++;
+        return true;
+    }
+
+public:
+
+    /**
+     * @param window Window to aggregate over.
+     * @param aggregate Aggregation that gets applied.
+     * @param maxPanes Upper bound of panes kept at once, tuples that are further ahead of the
+     *                 oldest open window get dropped (see getDroppedTuples()).
+     */
+    FlowWindowAggregation(FlowWindow window, A aggregate = A(), size_t maxPanes = DEFAULT_MAX_PANES) :
+            aggregate(aggregate), window(window), paneSize(window.getPaneSize()),
+            panesPerWindow(window.getSize() / paneSize), panesPerStride(window.getStride() / paneSize), maxPanes(maxPanes) {
+        const uint64_t initial = std::bit_ceil(std::max(this->panesPerWindow, this->panesPerStride) + 1);
+        if(initial > maxPanes) throw std::invalid_argument("FlowWindowAggregation: window needs more than maxPanes panes");
+        this->panes.assign(initial, Pane{this->aggregate.identity(), 0});
+        this->mask = initial - 1;
+    }
+
+    /**
+     * Adds a tuple to a TIME_BASED window aggregation.
+     *
+     * @param tuple Tuple to aggregate.
+     * @param time Event time of the tuple in milliseconds.
+     * @return False if the tuple is late (before the watermark or in an emitted window) or got dropped.
+     */
+    bool add(const Tuple &tuple, uint64_t time){
+        return this->insert(tuple, time);
+    }
+
+    /**
+     * Adds a tuple to a SIZE_BASED window aggregation and emits the windows it completes.
+     *
+     * @param emit Called as emit(windowStart, windowEnd, const State&) for every completed window.
+     */
+    template<typename F> requires std::invocable<F&, uint64_t, uint64_t, const State&>
+    void add(const Tuple &tuple, F &&emit){
+        this->insert(tuple, this->counted++);
+        this->advance(this->counted, emit);
+    }
+
+    /**
+     * Moves the watermark forward and emits all windows that end at or before it.
+     * Tuples with an event time before the watermark are considered late afterwards.
+     *
+     * @param watermark No more tuples with an event time before this will be added.
+     * @param emit Called as emit(windowStart, windowEnd, const State&) for every completed window that has tuples.
+     */
+    template<typename F>
+    void advance(uint64_t watermark, F &&emit){
+        if(watermark <= this->watermark) return;
+        this->watermark = watermark;
+        const uint64_t size = this->window.getSize(), stride = this->window.getStride();
+        while(this->nextWindow * stride + size <= watermark){
+            if(this->liveTuples == 0){
+                // nothing buffered: jump to the first window that is still open
+                const uint64_t open = watermark < size ? 0 : (watermark - size) / stride + 1;
+                this->nextWindow = std::max(this->nextWindow, open);
+                break;
+            }
+            const uint64_t first = this->firstPane();
+            State result = this->aggregate.identity();
+            uint64_t tuples = 0;
+            for(uint64_t i=first; i < first + this->panesPerWindow; i++){
+                const Pane &p = this->pane(i);
+                if(p.tuples == 0) continue;
+                this->aggregate.combine(result, p.state);
+                tuples += p.tuples;
+            }
+            if(tuples > 0) emit(this->nextWindow * stride, this->nextWindow * stride + size, result);
+
+            // panes before the next window are no longer needed
+            for(uint64_t i=first; i < first + this->panesPerStride; i++){
+                Pane &p = this->pane(i);
+                this->liveTuples -= p.tuples;
+                p = Pane{this->aggregate.identity(), 0};
+            }
+            this->nextWindow++;
+        }
+    }
+
+    const FlowWindow& getWindow() const noexcept {
+        return this->window;
+    }
+
+    uint64_t getWatermark() const noexcept {
+        return this->watermark;
+    }
+
+    /** Returns the amount of tuples that arrived after their windows got emitted. */
+    uint64_t getLateTuples() const noexcept {
+        return this->late;
+    }
+
+    /** Returns the amount of tuples that did not belong to any window or exceeded maxPanes. */
+    uint64_t getDroppedTuples() const noexcept {
+        return this->dropped;
+    }
+
+    /** Returns the bytes held by the pane ring. */
+    size_t getMemoryUsage() const noexcept {
+        return this->panes.capacity() * sizeof(Pane);
+    }
+};
+
+
+
+/**
+ * Side of a two way join.
+ */
+enum class FlowJoinSide : uint8_t {
+    LEFT  = 0,
+    RIGHT = 1,
+};
+
+
+
+/**
+ * Buffers of a windowed equi-join (symmetric hash join).
+ *
+ * Every tuple probes the buffer of the other side for tuples with the same key that are within the window
+ * and is then buffered itself, so each pair gets joined exactly once and sliding windows never recompute.
+ * The window slides continuously (the stride only matters for aggregations):
+ *  - TIME_BASED: tuples join if their event times are at most 'size' milliseconds apart.
+ *  - SIZE_BASED: a tuple joins with the last 'size' tuples of the other side.
+ *
+ * Buffers are split into hash partitions by key. Each partition keeps its tuples in an arrival ordered ring,
+ * tuples with the same key are chained through the ring and the newest one is indexed by key, so probing only
+ * touches matching tuples and evicting is popping the front of the ring. Eviction is driven by the watermark
+ * (TIME_BASED) or by the amount of tuples of a side (SIZE_BASED). Memory is bounded by maxEntries,
+ * if a partition exceeds its share the oldest tuple of that partition gets evicted early.
+ *
+ * Not thread safe (one instance per operator instance / key partition).
+ *
+ * @tparam K Key extractor callable as uint64_t(const Tuple&).
+ */
+template<typename K>
+class FlowJoinState {
+public:
+
+    /** Default amount of hash partitions. */
+    static constexpr size_t DEFAULT_PARTITIONS = 64;
+
+    /** Default upper bound of buffered tuples over both sides. */
+    static constexpr size_t DEFAULT_MAX_ENTRIES = 1 << 22;
+
+protected:
+    static constexpr uint64_t NONE = std::numeric_limits<uint64_t>::max();
+
+    struct Entry {
+        uint64_t time;
+        uint64_t key;
+        uint64_t previous; // sequence of the previous tuple with the same key (or NONE)
+        Tuple tuple;
+    };
+
+    struct Buffer {
+        FlowRing<Entry> entries;
+        std::unordered_map<uint64_t, uint64_t> newest; // key -> sequence of its newest entry
+    };
+
+    struct Partition {
+        Buffer sides[2];
+    };
+
+    K key;
+    FlowWindow window;
+    std::vector<Partition> partitions;
+    uint64_t partitionMask;
+    size_t maxEntriesPerPartition;
+    uint64_t watermark = 0;
+    uint64_t counted[2] = {0, 0}; // SIZE_BASED: tuples added per side
+    uint64_t buffered = 0;
+    uint64_t late = 0;
+    uint64_t evictedEarly = 0;
+
+    static inline uint64_t mix(uint64_t key) noexcept {
+        key ^= key >> 33; // murmur3 finalizer, spreads sequential keys over partitions
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        return key;
+    }
+
+    /** Oldest time a tuple of the given side may have to still join. */
+    inline uint64_t horizon(FlowJoinSide side) const noexcept {
+        const uint64_t size = this->window.getSize();
+        const uint64_t now = this->window.getType() == FlowWindowType::TIME_BASED ? this->watermark : this->counted[(size_t)side];
+        return now > size ? now - size : 0;
+    }
+
+    void popFront(Buffer &buffer){
+        Entry &entry = buffer.entries.front();
+        auto it = buffer.newest.find(entry.key);
+        if(it != buffer.newest.end() && it->second == buffer.entries.headSequence()) buffer.newest.erase(it);
+        buffer.entries.pop();
+        this->buffered--;
+    }
+
+    void evict(Buffer &buffer, uint64_t horizon){
+        while(!buffer.entries.empty() && buffer.entries.front().time < horizon) this->popFront(buffer);
+    }
+
+    template<typename F>
+    bool insert(FlowJoinSide side, const Tuple &tuple, uint64_t time, F &emit){
+        const uint64_t k = this->key(tuple);
+        Partition &partition = this->partitions[mix(k) & this->partitionMask];
+        const FlowJoinSide otherSide = side == FlowJoinSide::LEFT ? FlowJoinSide::RIGHT : FlowJoinSide::LEFT;
+        Buffer &own = partition.sides[(size_t)side];
+        Buffer &other = partition.sides[(size_t)otherSide];
+        this->evict(own, this->horizon(side));
+        this->evict(other, this->horizon(otherSide));
+
+        // probe: walk the chain of tuples with the same key from newest to oldest
+        auto it = other.newest.find(k);
+        if(it != other.newest.end()){
+            const uint64_t size = this->window.getSize();
+            const uint64_t otherHorizon = this->horizon(otherSide);
+            for(uint64_t seq = it->second; seq != NONE && seq >= other.entries.headSequence(); seq = other.entries.at(seq).previous){
+                const Entry &match = other.entries.at(seq);
+                const bool inWindow = this->window.getType() == FlowWindowType::TIME_BASED ?
+                                        (match.time > time ? match.time - time : time - match.time) <= size : match.time >= otherHorizon;
+                if(!inWindow) continue;
+                if(side == FlowJoinSide::LEFT) emit(tuple, match.tuple);
+                else emit(match.tuple, tuple);
+            }
+        }
+
+        // buffer
+        while(own.entries.size() + other.entries.size() >= this->maxEntriesPerPartition){
+            Buffer &oldest = own.entries.empty() ? other : other.entries.empty() ? own :
+                                (own.entries.front().time <= other.entries.front().time ? own : other);
+            this->popFront(oldest);
+            this->evictedEarly++;
+        }
+        auto newest = own.newest.try_emplace(k, NONE).first;
+        const uint64_t previous = newest->second;
+        newest->second = own.entries.push(Entry{time, k, previous, tuple});
+        this->buffered++;
+        return true;
+    }
+
+public:
+
+    /**
+     * @param window Window that defines how long tuples are considered for joining.
+     * @param key Extracts the join key of a tuple.
+     * @param partitions Amount of hash partitions (rounded up to a power of two).
+     * @param maxEntries Upper bound of buffered tuples over both sides.
+     */
+    FlowJoinState(FlowWindow window, K key = K(), size_t partitions = DEFAULT_PARTITIONS, size_t maxEntries = DEFAULT_MAX_ENTRIES) :
+            key(key), window(window), partitions(std::bit_ceil(std::max((size_t)1, partitions))) {
+        this->partitionMask = this->partitions.size() - 1;
+        this->maxEntriesPerPartition = std::max((size_t)1, maxEntries / this->partitions.size());
+    }
+
+    /**
+     * Joins a tuple of a TIME_BASED window with the buffered tuples of the other side and buffers it.
+     *
+     * @param side Side the tuple belongs to.
+     * @param tuple Tuple to join.
+     * @param time Event time of the tuple in milliseconds.
+     * @param emit Called as emit(const Tuple &left, const Tuple &right) for every match.
+     * @return False if the tuple is late (event time before the watermark) and got dropped.
+     */
+    template<typename F>
+    bool add(FlowJoinSide side, const Tuple &tuple, uint64_t time, F &&emit){
+        if(time < this->watermark){
+            this->late++;
+            return false;
+        }
+        return this->insert(side, tuple, time, emit);
+    }
+
+    /**
+     * Joins a tuple of a SIZE_BASED window with the last 'size' tuples of the other side and buffers it.
+     *
+     * @param emit Called as emit(const Tuple &left, const Tuple &right) for every match.
+     */
+    template<typename F> requires std::invocable<F&, const Tuple&, const Tuple&>
+    void add(FlowJoinSide side, const Tuple &tuple, F &&emit){
+        const uint64_t time = this->counted[(size_t)side]++;
+        this->insert(side, tuple, time, emit);
+    }
+
+    /**
+     * Moves the watermark forward and evicts all tuples that can no longer join (TIME_BASED),
+     * or evicts everything outside the windows of both sides (SIZE_BASED, watermark is ignored).
+     */
+    void advance(uint64_t watermark){
+        this->watermark = std::max(this->watermark, watermark);
+        const uint64_t horizons[2] = {this->horizon(FlowJoinSide::LEFT), this->horizon(FlowJoinSide::RIGHT)};
+        for(Partition &partition : this->partitions)
+            for(size_t side=0; side < 2; side++) this->evict(partition.sides[side], horizons[side]);
+    }
+
+    const FlowWindow& getWindow() const noexcept {
+        return this->window;
+    }
+
+    uint64_t getWatermark() const noexcept {
+        return this->watermark;
+    }
+
+    /** Returns the amount of tuples currently buffered over both sides. */
+    uint64_t getBufferedTuples() const noexcept {
+        return this->buffered;
+    }
+
+    /** Returns the amount of tuples dropped because their event time was before the watermark. */
+    uint64_t getLateTuples() const noexcept {
+        return this->late;
+    }
+
+    /** Returns the amount of tuples evicted before leaving the window because maxEntries was reached. */
+    uint64_t getEvictedEarly() const noexcept {
+        return this->evictedEarly;
+    }
+
+    /** Returns an estimate of the bytes held by the join buffers. */
+    size_t getMemoryUsage() const noexcept {
+        size_t bytes = this->partitions.capacity() * sizeof(Partition);
+        for(const Partition &partition : this->partitions){
+            for(const Buffer &buffer : partition.sides){
+                bytes += buffer.entries.capacity() * sizeof(Entry);
+                bytes += buffer.newest.bucket_count() * sizeof(void*) + buffer.newest.size() * (sizeof(std::pair<uint64_t, uint64_t>) + sizeof(void*));
+            }
+        }
+        return bytes;
+    }
+};
+
+
+
+}
+
+#endif // SPI_FLOW_WINDOW_STATE_HPP
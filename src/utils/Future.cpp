@@ -30,53 +30,42 @@ Promise<void>& Promise<void>::operator=(Promise<void> &&other) {
 }
 
 Promise<void>::~Promise() noexcept(false) {
-    std::unique_lock<std::mutex> lockState(state->mState);
+    const bool lastPromise = state->promiseRefs.fetch_sub(1) == 1;
+    const bool ready = state->isReady() || state->isCancelled(); // read before giving up reference
     if(state->refs.fetch_sub(1) == 1){
         // this is last reference
-        lockState.unlock();
         delete state;
         return;
     }
-    if(state->promiseRefs.fetch_sub(1) == 1){
-        if(!state->ready) // if this is last promise, state not ready, but still futures waiting
-            throw std::runtime_error("Promise with waiting futures deleted before being fulfilled");
-    }
+    if(lastPromise && !ready) // if this is last promise, state not ready, but still futures waiting
+        throw std::runtime_error("Promise with waiting futures deleted before being fulfilled");
 }
 
 bool Promise<void>::isFulfilled() const {
-    std::lock_guard<std::mutex> lock(state->mState);
-    return state->ready;
+    return state->isReady();
 }
 
-void Promise<void>::set_value() noexcept(false) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready)
-        throw std::runtime_error("Promise already fulfilled");
-    state->ready = true;
-    lockState.unlock();
+bool Promise<void>::isCancelled() const {
+    return state->isCancelled();
+}
+
+void Promise<void>::onCancel(std::function<void()> callback) {
+    state->addCancelCallback(std::move(callback));
+}
 
-    state->cvReady.notify_all();
+CancellationToken Promise<void>::get_cancellation_token() const {
+    return CancellationToken(state);
+}
 
-    std::lock_guard<std::mutex> lockCallbacks(state->mCallbacks);
-    for(auto &callback : state->callbacks)
-        callback(state);
-    state->callbacks.clear();
+void Promise<void>::set_value() noexcept(false) {
+    if(!state->beginFulfill()) return; // cancelled, result no longer wanted (throws if already fulfilled)
+    state->finishFulfill(); // wakes up waiting threads and executes callbacks
 }
 
 void Promise<void>::set_exception(const std::exception &exception) noexcept(false) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready)
-        throw std::runtime_error("Promise already fulfilled");
-    state->ready = true;
+    if(!state->beginFulfill()) return; // cancelled, result no longer wanted (throws if already fulfilled)
     state->exception = exception;
-    lockState.unlock();
-
-    state->cvReady.notify_all();
-
-    std::lock_guard<std::mutex> lockCallbacks(state->mCallbacks);
-    for(auto &callback : state->callbacks)
-        callback(state);
-    state->callbacks.clear();
+    state->finishFulfill(); // wakes up waiting threads and executes callbacks
 }
 
 Future<void> Promise<void>::get_future() {
@@ -89,13 +78,13 @@ Future<void> Promise<void>::get_future() {
 
 Future<void>::Future(){
     this->state = new PromiseFutureState<void>();
-    state->ready = true;
+    state->markReady(); // no other thread can access state yet
 }
 
 Future<void>::Future(const std::exception &exception){
     this->state = new PromiseFutureState<void>();
-    state->ready = true;
     state->exception = exception;
+    state->markReady(); // no other thread can access state yet
 }
 
 Future<void>::Future(PromiseFutureState<void> *state) {
@@ -136,83 +125,55 @@ Future<void>::~Future(){
 }
 
 bool Future<void>::is_ready() const {
-    std::lock_guard<std::mutex> lock(state->mState);
-    return state->ready;
+    return state->isReady();
 }
 
 bool Future<void>::has_value() const {
-    std::lock_guard<std::mutex> lock(state->mState);
-    return state->ready && !state->exception.has_value();
+    return state->isReady() && !state->exception.has_value();
 }
 
 bool Future<void>::has_exception() const {
-    std::lock_guard<std::mutex> lock(state->mState);
-    return state->exception.has_value();
+    return state->isReady() && state->exception.has_value();
 }
 
 void Future<void>::get_value() noexcept(false) {
-    std::unique_lock<std::mutex> lock(state->mState);
-    if(state->ready && !state->exception.has_value()){
+    state->waitReady(); // returns immediately if ready
+    if(!state->exception.has_value())
         return;
-    } else if(state->exception.has_value()){
-        throw state->exception.value();
-    } else {
-        // wait for ready
-        state->cvReady.wait(lock, [this]{ return state->ready; });
-
-        if(state->ready && !state->exception.has_value())
-            return;
-        throw state->exception.value();
-    }
+    throw state->exception.value();
 }
 
 std::exception Future<void>::get_exception() noexcept(false) {
-    std::unique_lock<std::mutex> lock(state->mState);
-    if(state->exception.has_value()) {
+    state->waitReady(); // returns immediately if ready
+    if(state->exception.has_value())
         return state->exception.value();
-    } else if(state->ready) {
-        throw std::runtime_error("Future has value instead of exception");
-    } else {
-        // wait for ready
-        state->cvReady.wait(lock, [this]{ return state->ready; });
-        
-        if(state->exception.has_value())
-            return state->exception.value();
-        throw std::runtime_error("Future has value instead of exception");
-    }
+    throw std::runtime_error("Future has value instead of exception");
+}
+
+bool Future<void>::cancel() {
+    return state->cancel();
+}
+
+bool Future<void>::is_cancelled() const {
+    return state->isCancelled();
+}
+
+CancellationToken Future<void>::get_cancellation_token() const {
+    return CancellationToken(state);
 }
 
 
 void Future<void>::onValue(std::function<void()> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(!state->exception.has_value()){
-            lockState.unlock(); // unlock before callback
             callback();
             return;
         }
     } else {
         // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(!state->exception.has_value()){
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                callback();
-                return;
-            }
-        }
-
-        // wait for this ready
-        state->callbacks.push_back([callback](PromiseFutureState<void> *state){ // this future may be already deleted when invoked
+        state->addCallback([state = this->state, callback]{ // this future may be already deleted when invoked
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(!state->exception.has_value()){
-                lockState.unlock(); // unlock before callback
                 callback();
             }
         });
@@ -220,35 +181,16 @@ void Future<void>::onValue(std::function<void()> callback) noexcept(true) {
 }
 
 void Future<void>::onException(std::function<void(std::exception)> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(state->exception.has_value()){
-            lockState.unlock(); // unlock before callback
             callback(state->exception.value());
             return;
         }
     } else {
         // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(state->exception.has_value()){
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                callback(state->exception.value());
-                return;
-            }
-        }
-
-        // wait for this ready
-        state->callbacks.push_back([callback](PromiseFutureState<void> *state){ // this future may be already deleted when invoked
+        state->addCallback([state = this->state, callback]{ // this future may be already deleted when invoked
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(state->exception.has_value()){
-                lockState.unlock(); // unlock before callback
                 callback(state->exception.value());
             }
         });
@@ -259,10 +201,8 @@ void Future<void>::onException(std::function<void(std::exception)> callback) noe
 // callback taking void and returning R/void
 template<typename R>
 Future<R> Future<void>::then(std::function<R()> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(!state->exception.has_value()){
-            lockState.unlock(); // unlock before callback
             try {
                 if constexpr (std::is_same<R, void>::value) {
                     callback();
@@ -277,39 +217,13 @@ Future<R> Future<void>::then(std::function<R()> callback) noexcept(true) {
             return Future<R>(state->exception.value());
         }
     } else {
-        // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(!state->exception.has_value()){
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                try {
-                    if constexpr (std::is_same<R, void>::value) {
-                        callback();
-                        return Future<R>();
-                    } else {
-                        return Future<R>(callback());
-                    }
-                } catch (std::exception &exception) {
-                    return Future<R>(exception);
-                }
-            } else {
-                return Future<R>(state->exception.value());
-            }
-        }
-
         // wait for this ready
         Promise<R> *promise = new Promise<R>();
         Future<R> future = promise->get_future();
-        state->callbacks.push_back([promise, callback](PromiseFutureState<void> *state){ // this future may be already deleted when invoked
+        promise->state->initUpstream(state); // cancelling the continuation cancels this future
+        state->addCallback([state = this->state, promise, callback]{ // this future may be already deleted when invoked
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(!state->exception.has_value()){
-                lockState.unlock(); // unlock before callback
                 try {
                     if constexpr (std::is_same<R, void>::value) {
                         callback();
@@ -322,7 +236,6 @@ Future<R> Future<void>::then(std::function<R()> callback) noexcept(true) {
                 }
             } else {
                 std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before setting exception
                 promise->set_exception(exception);
             }
             delete promise;
@@ -334,10 +247,8 @@ Future<R> Future<void>::then(std::function<R()> callback) noexcept(true) {
 // callback taking void and returning shared_ptr<R>
 template<typename R>
 Future<std::shared_ptr<R>> Future<void>::then(std::function<std::shared_ptr<R>()> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(!state->exception.has_value()){
-            lockState.unlock(); // unlock before callback
             try {
                 return Future<std::shared_ptr<R>>(callback());
             } catch (std::exception &exception) {
@@ -347,34 +258,13 @@ Future<std::shared_ptr<R>> Future<void>::then(std::function<std::shared_ptr<R>()
             return Future<std::shared_ptr<R>>(state->exception.value());
         }
     } else {
-        // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(!state->exception.has_value()){
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                try {
-                    return Future<std::shared_ptr<R>>(callback());
-                } catch (std::exception &exception) {
-                    return Future<std::shared_ptr<R>>(exception);
-                }
-            } else {
-                return Future<std::shared_ptr<R>>(state->exception.value());
-            }
-        }
-
         // wait for this ready
         Promise<std::shared_ptr<R>> *promise = new Promise<std::shared_ptr<R>>();
         Future<std::shared_ptr<R>> future = promise->get_future();
-        state->callbacks.push_back([promise, callback](PromiseFutureState<void> *state){ // this future may be already deleted when invoked
+        promise->state->initUpstream(state); // cancelling the continuation cancels this future
+        state->addCallback([state = this->state, promise, callback]{ // this future may be already deleted when invoked
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(!state->exception.has_value()){
-                lockState.unlock(); // unlock before callback
                 try {
                     promise->set_value(callback());
                 } catch (std::exception &exception) {
@@ -382,7 +272,6 @@ Future<std::shared_ptr<R>> Future<void>::then(std::function<std::shared_ptr<R>()
                 }
             } else {
                 std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before setting exception
                 promise->set_exception(exception);
             }
             delete promise;
@@ -394,10 +283,8 @@ Future<std::shared_ptr<R>> Future<void>::then(std::function<std::shared_ptr<R>()
 // callback taking void and returning Future<R>/Future<void>
 template<typename R>
 Future<R> Future<void>::thenFuture(std::function<Future<R>()> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(!state->exception.has_value()){
-            lockState.unlock(); // unlock before callback
             try {
                 return callback();
             } catch (std::exception &exception) {
@@ -407,36 +294,16 @@ Future<R> Future<void>::thenFuture(std::function<Future<R>()> callback) noexcept
             return Future<R>(state->exception.value());
         }
     } else {
-        // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(!state->exception.has_value()){
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                try {
-                    return callback();
-                } catch (std::exception &exception) {
-                    return Future<R>(exception);
-                }
-            } else {
-                return Future<R>(state->exception.value());
-            }
-        }
-
         // wait for this ready
         Promise<R> *promise = new Promise<R>();
         Future<R> future = promise->get_future();
-        state->callbacks.push_back([promise, callback](PromiseFutureState<void> *state){ // this future may be already deleted when invoked
+        promise->state->initUpstream(state); // cancelling the continuation cancels this future
+        state->addCallback([state = this->state, promise, callback]{ // this future may be already deleted when invoked
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(!state->exception.has_value()){
-                lockState.unlock(); // unlock before callback
                 try {
                     Future<R> future = callback();
+                    promise->state->setUpstream(future.state); // and the future returned by the callback
                     if constexpr (std::is_same<R, void>::value) {
                         future.onValue([promise](){
                             promise->set_value();
@@ -458,7 +325,6 @@ Future<R> Future<void>::thenFuture(std::function<Future<R>()> callback) noexcept
                 }
             } else {
                 std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before setting exception
                 promise->set_exception(exception);
                 delete promise;
             }
@@ -470,10 +336,8 @@ Future<R> Future<void>::thenFuture(std::function<Future<R>()> callback) noexcept
 // callback taking void and returning Future<shared_ptr<R>>
 template<typename R>
 Future<std::shared_ptr<R>> Future<void>::thenFuture(std::function<Future<std::shared_ptr<R>>()> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(!state->exception.has_value()){
-            lockState.unlock(); // unlock before callback
             try {
                 return callback();
             } catch (std::exception &exception) {
@@ -483,36 +347,16 @@ Future<std::shared_ptr<R>> Future<void>::thenFuture(std::function<Future<std::sh
             return Future<std::shared_ptr<R>>(state->exception.value());
         }
     } else {
-        // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(!state->exception.has_value()){
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                try {
-                    return callback();
-                } catch (std::exception &exception) {
-                    return Future<std::shared_ptr<R>>(exception);
-                }
-            } else {
-                return Future<std::shared_ptr<R>>(state->exception.value());
-            }
-        }
-
         // wait for this ready
         Promise<std::shared_ptr<R>> *promise = new Promise<std::shared_ptr<R>>();
         Future<std::shared_ptr<R>> future = promise->get_future();
-        state->callbacks.push_back([promise, callback](PromiseFutureState<void> *state){ // this future may be already deleted when invoked
+        promise->state->initUpstream(state); // cancelling the continuation cancels this future
+        state->addCallback([state = this->state, promise, callback]{ // this future may be already deleted when invoked
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(!state->exception.has_value()){
-                lockState.unlock(); // unlock before callback
                 try {
                     Future<std::shared_ptr<R>> future = callback();
+                    promise->state->setUpstream(future.state); // and the future returned by the callback
                     future.onValue([promise](std::shared_ptr<R> value){
                         promise->set_value(value);
                         delete promise;
@@ -527,7 +371,6 @@ Future<std::shared_ptr<R>> Future<void>::thenFuture(std::function<Future<std::sh
                 }
             } else {
                 std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before setting exception
                 promise->set_exception(exception);
                 delete promise;
             }
@@ -539,13 +382,11 @@ Future<std::shared_ptr<R>> Future<void>::thenFuture(std::function<Future<std::sh
 
 // callback taking exception and returning shared_ptr<T>
 Future<void> Future<void>::catchAll(std::function<void(std::exception)> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(!state->exception.has_value()){
             return Future<void>();
         } else {
             std::exception exception = state->exception.value();
-            lockState.unlock(); // unlock before callback
             try {
                 callback(exception);
                 return Future<void>();
@@ -554,40 +395,16 @@ Future<void> Future<void>::catchAll(std::function<void(std::exception)> callback
             }
         }
     } else {
-        // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(!state->exception.has_value()){
-                return Future<void>();
-            } else {
-                std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                try {
-                    callback(exception);
-                    return Future<void>();
-                } catch (std::exception &exception) {
-                    return Future<void>(exception);
-                }
-            }
-        }
-
         // wait for this ready
         Promise<void> *promise = new Promise<void>();
         Future<void> future = promise->get_future();
-        state->callbacks.push_back([promise, callback](PromiseFutureState<void> *state){ // this future may be already deleted when invoked
+        promise->state->initUpstream(state); // cancelling the continuation cancels this future
+        state->addCallback([state = this->state, promise, callback]{ // this future may be already deleted when invoked
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(!state->exception.has_value()){
-                lockState.unlock(); // unlock before setting value
                 promise->set_value();
             } else {
                 std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before callback
                 try {
                     callback(exception);
                     promise->set_value();
@@ -603,13 +420,11 @@ Future<void> Future<void>::catchAll(std::function<void(std::exception)> callback
 
 // callback taking exception and returning Future<shared_ptr<T>>
 Future<void> Future<void>::catchAllFuture(std::function<Future<void>(std::exception)> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(!state->exception.has_value()){
             return Future<void>();
         } else {
             std::exception exception = state->exception.value();
-            lockState.unlock(); // unlock before callback
             try {
                 return callback(exception);
             } catch (std::exception &exception) {
@@ -617,42 +432,20 @@ Future<void> Future<void>::catchAllFuture(std::function<Future<void>(std::except
             }
         }
     } else {
-        // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(!state->exception.has_value()){
-                return Future<void>();
-            } else {
-                std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                try {
-                    return callback(exception);
-                } catch (std::exception &exception) {
-                    return Future<void>(exception);
-                }
-            }
-        }
-
         // wait for this ready
         Promise<void> *promise = new Promise<void>();
         Future<void> future = promise->get_future();
-        state->callbacks.push_back([promise, callback](PromiseFutureState<void> *state){ // this future may be already deleted when invoked
+        promise->state->initUpstream(state); // cancelling the continuation cancels this future
+        state->addCallback([state = this->state, promise, callback]{ // this future may be already deleted when invoked
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(!state->exception.has_value()){
-                lockState.unlock(); // unlock before setting value
                 promise->set_value();
                 delete promise;
             } else {
                 std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before callback
                 try {
                     Future<void> future = callback(exception);
+                    promise->state->setUpstream(future.state); // and the future returned by the callback
                     future.onValue([promise](){
                         promise->set_value();
                         delete promise;
@@ -680,10 +473,8 @@ Future<void> Future<void>::catchAllFuture(std::function<Future<void>(std::except
 // callback taking void and returning void
 template<>
 Future<void> Future<void>::then(std::function<void()> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(!state->exception.has_value()){
-            lockState.unlock(); // unlock before callback
             try {
                 callback();
                 return Future<void>();
@@ -694,35 +485,13 @@ Future<void> Future<void>::then(std::function<void()> callback) noexcept(true) {
             return Future<void>(state->exception.value());
         }
     } else {
-        // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(!state->exception.has_value()){
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                try {
-                    callback();
-                    return Future<void>();
-                } catch (std::exception &exception) {
-                    return Future<void>(exception);
-                }
-            } else {
-                return Future<void>(state->exception.value());
-            }
-        }
-
         // wait for this ready
         Promise<void> *promise = new Promise<void>();
         Future<void> future = promise->get_future();
-        state->callbacks.push_back([promise, callback](PromiseFutureState<void> *state){ // this future may be already deleted when invoked
+        promise->state->initUpstream(state); // cancelling the continuation cancels this future
+        state->addCallback([state = this->state, promise, callback]{ // this future may be already deleted when invoked
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(!state->exception.has_value()){
-                lockState.unlock(); // unlock before callback
                 try {
                     callback();
                     promise->set_value();
@@ -731,7 +500,6 @@ Future<void> Future<void>::then(std::function<void()> callback) noexcept(true) {
                 }
             } else {
                 std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before setting exception
                 promise->set_exception(exception);
             }
             delete promise;
@@ -743,10 +511,8 @@ Future<void> Future<void>::then(std::function<void()> callback) noexcept(true) {
 // callback taking void and returning Future<void>
 template<>
 Future<void> Future<void>::thenFuture(std::function<Future<void>()> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(!state->exception.has_value()){
-            lockState.unlock(); // unlock before callback
             try {
                 return callback();
             } catch (std::exception &exception) {
@@ -756,36 +522,16 @@ Future<void> Future<void>::thenFuture(std::function<Future<void>()> callback) no
             return Future<void>(state->exception.value());
         }
     } else {
-        // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(!state->exception.has_value()){
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                try {
-                    return callback();
-                } catch (std::exception &exception) {
-                    return Future<void>(exception);
-                }
-            } else {
-                return Future<void>(state->exception.value());
-            }
-        }
-
         // wait for this ready
         Promise<void> *promise = new Promise<void>();
         Future<void> future = promise->get_future();
-        state->callbacks.push_back([promise, callback](PromiseFutureState<void> *state){ // this future may be already deleted when invoked
+        promise->state->initUpstream(state); // cancelling the continuation cancels this future
+        state->addCallback([state = this->state, promise, callback]{ // this future may be already deleted when invoked
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(!state->exception.has_value()){
-                lockState.unlock(); // unlock before callback
                 try {
                     Future<void> future = callback();
+                    promise->state->setUpstream(future.state); // and the future returned by the callback
                     future.onValue([promise](){
                         promise->set_value();
                         delete promise;
@@ -800,7 +546,6 @@ Future<void> Future<void>::thenFuture(std::function<Future<void>()> callback) no
                 }
             } else {
                 std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before setting exception
                 promise->set_exception(exception);
                 delete promise;
             }
@@ -9,14 +9,26 @@
 #ifndef SPI_FUTURE_HPP
 #define SPI_FUTURE_HPP
 
+#include "./Executor.hpp"
+#include "./FutureStatePool.hpp"
+#include "./Task.hpp"
+#include "./TimerWheel.hpp"
+#include "./Trace.hpp"
+
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <coroutine>
+#include <cstdint>
 #include <exception>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <optional>
+#include <stdexcept>
+#include <tuple>
 #include <type_traits> // if constexpr (std::is_same_v<R, void>)
+#include <utility>
 #include <vector>
 
 namespace spi {
@@ -40,6 +52,14 @@ class Future<std::shared_ptr<T>>; // deferred declaration (see below)
 template <>
 class Future<void>; // deferred declaration (see below)
 
+template <typename T>
+class FutureCoroutinePromise; // deferred declaration (see below)
+
+template <typename T>
+class FutureAwaiter; // deferred declaration (see below)
+
+class CancellationToken; // deferred declaration (see below)
+
 
 
 
@@ -57,6 +77,7 @@ class Future<void>; // deferred declaration (see below)
  */
 template <typename T>
 class Promise {
+    template<typename> friend class Future; // so continuations can link their promise to the future they depend on
 protected:
 
     PromiseFutureState<T> *state; // deleted by last future or promise pointing to it
@@ -90,6 +111,27 @@ public:
      */
     bool isFulfilled() const;
 
+    /**
+     * Returns if the result is no longer wanted because a future got cancelled (or timed out).
+     * Setting a value or exception after cancellation is ignored.
+     * @return true if the future got cancelled, false otherwise.
+     */
+    bool isCancelled() const;
+
+    /**
+     * Invokes the callback as soon as a future of this promise gets cancelled,
+     * so the work producing the result can stop early (immediately if already cancelled).
+     * The callback is dropped without being invoked once this promise is fulfilled.
+     * 
+     * @param callback Callback function that will be executed on the thread cancelling the future.
+     */
+    void onCancel(std::function<void()> callback);
+
+    /**
+     * Returns a token that can be used to observe or request cancellation without access to this promise.
+     */
+    CancellationToken get_cancellation_token() const;
+
     /**
      * Sets the value and updates all futures belonging by this promise.
      * 
@@ -127,6 +169,7 @@ public:
  */
 template <typename T>
 class Promise<std::shared_ptr<T>> {
+    template<typename> friend class Future; // so continuations can link their promise to the future they depend on
 protected:
 
     PromiseFutureState<std::shared_ptr<T>> *state; // deleted by last future or promise pointing to it
@@ -160,6 +203,27 @@ public:
      */
     bool isFulfilled() const;
 
+    /**
+     * Returns if the result is no longer wanted because a future got cancelled (or timed out).
+     * Setting a value or exception after cancellation is ignored.
+     * @return true if the future got cancelled, false otherwise.
+     */
+    bool isCancelled() const;
+
+    /**
+     * Invokes the callback as soon as a future of this promise gets cancelled,
+     * so the work producing the result can stop early (immediately if already cancelled).
+     * The callback is dropped without being invoked once this promise is fulfilled.
+     * 
+     * @param callback Callback function that will be executed on the thread cancelling the future.
+     */
+    void onCancel(std::function<void()> callback);
+
+    /**
+     * Returns a token that can be used to observe or request cancellation without access to this promise.
+     */
+    CancellationToken get_cancellation_token() const;
+
     /**
      * Sets the value and updates all futures belonging by this promise.
      * 
@@ -197,6 +261,7 @@ public:
  */
 template <>
 class Promise<void> {
+    template<typename> friend class Future; // so continuations can link their promise to the future they depend on
 protected:
 
     PromiseFutureState<void> *state; // deleted by last future or promise pointing to it
@@ -230,6 +295,27 @@ public:
      */
     bool isFulfilled() const;
 
+    /**
+     * Returns if the result is no longer wanted because a future got cancelled (or timed out).
+     * Setting a value or exception after cancellation is ignored.
+     * @return true if the future got cancelled, false otherwise.
+     */
+    bool isCancelled() const;
+
+    /**
+     * Invokes the callback as soon as a future of this promise gets cancelled,
+     * so the work producing the result can stop early (immediately if already cancelled).
+     * The callback is dropped without being invoked once this promise is fulfilled.
+     * 
+     * @param callback Callback function that will be executed on the thread cancelling the future.
+     */
+    void onCancel(std::function<void()> callback);
+
+    /**
+     * Returns a token that can be used to observe or request cancellation without access to this promise.
+     */
+    CancellationToken get_cancellation_token() const;
+
     /**
      * Sets the value and updates all futures belonging by this promise.
      * 
@@ -273,6 +359,8 @@ public:
 template<typename T>
 class Future {
     friend class Promise<T>; // so promise can access protected constructor of this future
+    template<typename> friend class Future; // so continuations can link to futures of other types
+    template<typename> friend class FutureAwaiter; // so co_await can register on the state directly
 protected:
 
     PromiseFutureState<T> *state; // deleted by last future or promise pointing to it
@@ -281,6 +369,9 @@ protected:
 
 public:
 
+    /** Allows coroutines to return this future (see FutureCoroutinePromise). */
+    typedef FutureCoroutinePromise<T> promise_type;
+
     /** Creates a new Future that will be set to the given value.
      * IMPORTANT: this will only get automatically deleted when returned from within a then<> or catchAll<> callback!
      * 
@@ -345,6 +436,47 @@ public:
      */
     std::exception get_exception() noexcept(false);
 
+    /**
+     * Blocks until the result is available or the timeout elapsed.
+     * 
+     * @param timeout Maximum time to wait.
+     * @return true if the result is available, false if the timeout elapsed before.
+     */
+    template<typename Rep, typename Period>
+    bool wait_for(const std::chrono::duration<Rep, Period> &timeout);
+
+    /**
+     * Blocks until the result is available or the deadline passed.
+     * 
+     * @param deadline Point in time until which to wait at most.
+     * @return true if the result is available, false if the deadline passed before.
+     */
+    template<typename Clock, typename Duration>
+    bool wait_until(const std::chrono::time_point<Clock, Duration> &deadline);
+
+    /**
+     * Tells the producer that the result is no longer wanted.
+     * If the result is not available yet, this future fails with an exception, 
+     * the callbacks registered with Promise::onCancel() are executed and the future
+     * this one was derived from (then, thenFuture, catchAll) is cancelled as well.
+     * A value or exception set by the producer afterwards is ignored.
+     * 
+     * @return true if the future got cancelled, false if the result was already available.
+     */
+    bool cancel();
+
+    /**
+     * Returns if this future got cancelled (by cancel(), a timeout or a cancelled continuation) before it had a result.
+     * 
+     * @return true if the future got cancelled, false otherwise.
+     */
+    bool is_cancelled() const;
+
+    /**
+     * Returns a token that can be used to observe or request cancellation of this future.
+     */
+    CancellationToken get_cancellation_token() const;
+
 
     /**
      * Invokes the callback function as soon as the value of this Future is available.
@@ -364,6 +496,52 @@ public:
      */
     void onException(std::function<void(std::exception)> callback) noexcept(true);
 
+    /**
+     * Invokes the callback function on the given executor as soon as the value of this Future is available.
+     * Costs at most one enqueue. If the calling thread already runs on the executor the callback is executed inline.
+     * If an exception is available instead of a value, the callback function will not be executed.
+     * 
+     * @param executor Executor the callback gets executed on (ThreadPool, callback queue or UserExecutor).
+     * @param callback Callback function that will be executed as soon as the value of this Future is available.
+     */
+    template<typename E> requires Executor<E>
+    void onValue(E &executor, std::function<void(T)> callback) noexcept(true);
+
+    /**
+     * Invokes the callback function on the given executor as soon as the exception of this Future is available.
+     * Costs at most one enqueue. If the calling thread already runs on the executor the callback is executed inline.
+     * If a value is available instead of an exception, the callback function will not be executed.
+     * 
+     * @param executor Executor the callback gets executed on (ThreadPool, callback queue or UserExecutor).
+     * @param callback Callback function that will be executed as soon as the exception of this Future is available.
+     */
+    template<typename E> requires Executor<E>
+    void onException(E &executor, std::function<void(std::exception)> callback) noexcept(true);
+
+    /**
+     * Returns a new Future that will be set to the result of the callback function.
+     * The callback function will be executed on the given executor as soon as the value of this Future is available
+     * (inline if the calling thread already runs on the executor). Exceptions are forwarded without involving the executor.
+     * 
+     * @tparam R Type of the new Future.
+     * @param executor Executor the callback gets executed on (ThreadPool, callback queue or UserExecutor).
+     * @param callback Callback function that will be executed as soon as the value of this Future is available.
+     * @return Future<R> Future that will be set to the result of the callback function.
+     */
+    template<typename R, typename E> requires Executor<E>
+    Future<R> then(E &executor, std::function<R(T)> callback) noexcept(true);
+
+    /**
+     * Invokes the callback as soon as a value or an exception is available for this Future
+     * (immediately if already available). The callback receives a Future<T> that is ready,
+     * so has_value(), get_value() and get_exception() do not block.
+     * Used by whenAll(), whenAny() and collectN() to register a single callback per future.
+     * 
+     * @param callback Callback function taking a Future<T>& that is ready.
+     */
+    template<typename Fn>
+    void onResult(Fn&& callback) const noexcept(true);
+
 
     /**
      * Returns a new Future that will be set to the result of the callback function.
@@ -439,6 +617,8 @@ public:
 template<typename T>
 class Future<std::shared_ptr<T>> {
     friend class Promise<std::shared_ptr<T>>; // so promise can access protected constructor of this future
+    template<typename> friend class Future; // so continuations can link to futures of other types
+    template<typename> friend class FutureAwaiter; // so co_await can register on the state directly
 protected:
 
     PromiseFutureState<std::shared_ptr<T>> *state; // deleted by last future or promise pointing to it
@@ -447,6 +627,9 @@ protected:
 
 public:
 
+    /** Allows coroutines to return this future (see FutureCoroutinePromise). */
+    typedef FutureCoroutinePromise<std::shared_ptr<T>> promise_type;
+
     /** Creates a new Future that will be set to the given value.
      * IMPORTANT: this will only get automatically deleted when returned from within a then<> or catchAll<> callback!
      * 
@@ -511,6 +694,47 @@ public:
      */
     std::exception get_exception() noexcept(false);
 
+    /**
+     * Blocks until the result is available or the timeout elapsed.
+     * 
+     * @param timeout Maximum time to wait.
+     * @return true if the result is available, false if the timeout elapsed before.
+     */
+    template<typename Rep, typename Period>
+    bool wait_for(const std::chrono::duration<Rep, Period> &timeout);
+
+    /**
+     * Blocks until the result is available or the deadline passed.
+     * 
+     * @param deadline Point in time until which to wait at most.
+     * @return true if the result is available, false if the deadline passed before.
+     */
+    template<typename Clock, typename Duration>
+    bool wait_until(const std::chrono::time_point<Clock, Duration> &deadline);
+
+    /**
+     * Tells the producer that the result is no longer wanted.
+     * If the result is not available yet, this future fails with an exception, 
+     * the callbacks registered with Promise::onCancel() are executed and the future
+     * this one was derived from (then, thenFuture, catchAll) is cancelled as well.
+     * A value or exception set by the producer afterwards is ignored.
+     * 
+     * @return true if the future got cancelled, false if the result was already available.
+     */
+    bool cancel();
+
+    /**
+     * Returns if this future got cancelled (by cancel(), a timeout or a cancelled continuation) before it had a result.
+     * 
+     * @return true if the future got cancelled, false otherwise.
+     */
+    bool is_cancelled() const;
+
+    /**
+     * Returns a token that can be used to observe or request cancellation of this future.
+     */
+    CancellationToken get_cancellation_token() const;
+
 
     /**
      * Invokes the callback function as soon as the value of this Future is available.
@@ -530,6 +754,52 @@ public:
      */
     void onException(std::function<void(std::exception)> callback) noexcept(true);
 
+    /**
+     * Invokes the callback function on the given executor as soon as the value of this Future is available.
+     * Costs at most one enqueue. If the calling thread already runs on the executor the callback is executed inline.
+     * If an exception is available instead of a value, the callback function will not be executed.
+     * 
+     * @param executor Executor the callback gets executed on (ThreadPool, callback queue or UserExecutor).
+     * @param callback Callback function that will be executed as soon as the value of this Future is available.
+     */
+    template<typename E> requires Executor<E>
+    void onValue(E &executor, std::function<void(std::shared_ptr<T>)> callback) noexcept(true);
+
+    /**
+     * Invokes the callback function on the given executor as soon as the exception of this Future is available.
+     * Costs at most one enqueue. If the calling thread already runs on the executor the callback is executed inline.
+     * If a value is available instead of an exception, the callback function will not be executed.
+     * 
+     * @param executor Executor the callback gets executed on (ThreadPool, callback queue or UserExecutor).
+     * @param callback Callback function that will be executed as soon as the exception of this Future is available.
+     */
+    template<typename E> requires Executor<E>
+    void onException(E &executor, std::function<void(std::exception)> callback) noexcept(true);
+
+    /**
+     * Returns a new Future that will be set to the result of the callback function.
+     * The callback function will be executed on the given executor as soon as the value of this Future is available
+     * (inline if the calling thread already runs on the executor). Exceptions are forwarded without involving the executor.
+     * 
+     * @tparam R Type of the new Future.
+     * @param executor Executor the callback gets executed on (ThreadPool, callback queue or UserExecutor).
+     * @param callback Callback function that will be executed as soon as the value of this Future is available.
+     * @return Future<R> Future that will be set to the result of the callback function.
+     */
+    template<typename R, typename E> requires Executor<E>
+    Future<R> then(E &executor, std::function<R(std::shared_ptr<T>)> callback) noexcept(true);
+
+    /**
+     * Invokes the callback as soon as a value or an exception is available for this Future
+     * (immediately if already available). The callback receives a Future<std::shared_ptr<T>> that is ready,
+     * so has_value(), get_value() and get_exception() do not block.
+     * Used by whenAll(), whenAny() and collectN() to register a single callback per future.
+     * 
+     * @param callback Callback function taking a Future<std::shared_ptr<T>>& that is ready.
+     */
+    template<typename Fn>
+    void onResult(Fn&& callback) const noexcept(true);
+
     
     /**
      * Returns a new Future that will be set to the result of the callback function.
@@ -606,6 +876,8 @@ public:
 template <>
 class Future<void> {
     friend class Promise<void>; // so promise can access protected constructor of this future
+    template<typename> friend class Future; // so continuations can link to futures of other types
+    template<typename> friend class FutureAwaiter; // so co_await can register on the state directly
 protected:
 
     PromiseFutureState<void> *state; // deleted by last future or promise pointing to it
@@ -614,6 +886,9 @@ protected:
 
 public:
 
+    /** Allows coroutines to return this future (see FutureCoroutinePromise). */
+    typedef FutureCoroutinePromise<void> promise_type;
+
     /** Creates a new Future that will be set to the given value.
      * IMPORTANT: this will only get automatically deleted when returned from within a then<> or catchAll<> callback!
      */
@@ -675,6 +950,47 @@ public:
      */
     std::exception get_exception() noexcept(false);
 
+    /**
+     * Blocks until the result is available or the timeout elapsed.
+     * 
+     * @param timeout Maximum time to wait.
+     * @return true if the result is available, false if the timeout elapsed before.
+     */
+    template<typename Rep, typename Period>
+    bool wait_for(const std::chrono::duration<Rep, Period> &timeout);
+
+    /**
+     * Blocks until the result is available or the deadline passed.
+     * 
+     * @param deadline Point in time until which to wait at most.
+     * @return true if the result is available, false if the deadline passed before.
+     */
+    template<typename Clock, typename Duration>
+    bool wait_until(const std::chrono::time_point<Clock, Duration> &deadline);
+
+    /**
+     * Tells the producer that the result is no longer wanted.
+     * If the result is not available yet, this future fails with an exception, 
+     * the callbacks registered with Promise::onCancel() are executed and the future
+     * this one was derived from (then, thenFuture, catchAll) is cancelled as well.
+     * A value or exception set by the producer afterwards is ignored.
+     * 
+     * @return true if the future got cancelled, false if the result was already available.
+     */
+    bool cancel();
+
+    /**
+     * Returns if this future got cancelled (by cancel(), a timeout or a cancelled continuation) before it had a result.
+     * 
+     * @return true if the future got cancelled, false otherwise.
+     */
+    bool is_cancelled() const;
+
+    /**
+     * Returns a token that can be used to observe or request cancellation of this future.
+     */
+    CancellationToken get_cancellation_token() const;
+
 
     /**
      * Invokes the callback function as soon as the value of this Future is available.
@@ -694,6 +1010,52 @@ public:
      */
     void onException(std::function<void(std::exception)> callback) noexcept(true);
 
+    /**
+     * Invokes the callback function on the given executor as soon as the value of this Future is available.
+     * Costs at most one enqueue. If the calling thread already runs on the executor the callback is executed inline.
+     * If an exception is available instead of a value, the callback function will not be executed.
+     * 
+     * @param executor Executor the callback gets executed on (ThreadPool, callback queue or UserExecutor).
+     * @param callback Callback function that will be executed as soon as the value of this Future is available.
+     */
+    template<typename E> requires Executor<E>
+    void onValue(E &executor, std::function<void()> callback) noexcept(true);
+
+    /**
+     * Invokes the callback function on the given executor as soon as the exception of this Future is available.
+     * Costs at most one enqueue. If the calling thread already runs on the executor the callback is executed inline.
+     * If a value is available instead of an exception, the callback function will not be executed.
+     * 
+     * @param executor Executor the callback gets executed on (ThreadPool, callback queue or UserExecutor).
+     * @param callback Callback function that will be executed as soon as the exception of this Future is available.
+     */
+    template<typename E> requires Executor<E>
+    void onException(E &executor, std::function<void(std::exception)> callback) noexcept(true);
+
+    /**
+     * Returns a new Future that will be set to the result of the callback function.
+     * The callback function will be executed on the given executor as soon as the value of this Future is available
+     * (inline if the calling thread already runs on the executor). Exceptions are forwarded without involving the executor.
+     * 
+     * @tparam R Type of the new Future.
+     * @param executor Executor the callback gets executed on (ThreadPool, callback queue or UserExecutor).
+     * @param callback Callback function that will be executed as soon as the value of this Future is available.
+     * @return Future<R> Future that will be set to the result of the callback function.
+     */
+    template<typename R, typename E> requires Executor<E>
+    Future<R> then(E &executor, std::function<R()> callback) noexcept(true);
+
+    /**
+     * Invokes the callback as soon as a value or an exception is available for this Future
+     * (immediately if already available). The callback receives a Future<void> that is ready,
+     * so has_value(), get_value() and get_exception() do not block.
+     * Used by whenAll(), whenAny() and collectN() to register a single callback per future.
+     * 
+     * @param callback Callback function taking a Future<void>& that is ready.
+     */
+    template<typename Fn>
+    void onResult(Fn&& callback) const noexcept(true);
+
 
     /**
      * Returns a new Future that will be set to the result of the callback function.
@@ -768,78 +1130,457 @@ public:
 // ---------------------------------------------------------------------
 
 
-template<typename T>
-class PromiseFutureState {
+/**
+ * Lock-free part of the state shared by promises and futures.
+ * 
+ * The status word tells if the result is PENDING, currently being written (SETTING), being cancelled (CANCELLING) or READY.
+ * Callbacks that wait for the result are kept in a lock-free stack. The first callback
+ * is stored inline so a single continuation does not allocate, further callbacks
+ * (multiple consumers) are allocated as separate nodes. Once the result is ready
+ * the stack gets closed and callbacks added afterwards are executed immediately.
+ * Threads that block for the result wait on the status word (futex) instead of a condition variable,
+ * only timed waits fall back to a condition variable that is created once per state.
+ * Memory of states is recycled per thread by FutureStatePool (disable with SPI_FUTURE_STATE_POOL=0).
+ *
+ * Cancellation fails a pending state with an exception, runs the callbacks the producer registered
+ * to stop its work and cancels the state the result depends on (upstream of a continuation).
+ * A producer that sets the result of a cancelled state afterwards is ignored.
+ */
+class PromiseFutureStateBase {
 public:
+    enum Status : uint32_t { PENDING = 0, SETTING = 1, READY = 2, CANCELLING = 3 };
+
+    struct CallbackNode {
+        Task task;
+        CallbackNode* next = nullptr;
+    };
+
+    struct TimedWaiter {
+        std::mutex mutex;
+        std::condition_variable cv;
+    };
 
     // referencens
     std::atomic<size_t> refs = 1; // number of promises & futures pointing to this state
     std::atomic<size_t> promiseRefs = 0; // number of promises pointing to this state
 
     // state
-    std::mutex mState;
-    std::condition_variable cvReady; // used when thread wants to wait for value
-    bool ready = false;
-    std::optional<T> value;
+    std::atomic<uint32_t> status{PENDING};
     std::optional<std::exception> exception;
 
     // callbacks
-    std::mutex mCallbacks; // need own mutex because callbacks want to access state
-    std::vector<std::function<void(PromiseFutureState<T>*)>> callbacks; // used when callback wants to wait for value
-};
+    std::atomic<CallbackNode*> callbacks{nullptr}; // stack of callbacks waiting for result (closed() once executed)
+    std::atomic<bool> inlineCallbackUsed{false};
+    CallbackNode inlineCallback; // storage for first callback
+    std::atomic<TimedWaiter*> timedWaiter{nullptr}; // created by the first timed wait, notified by finishFulfill()
+
+    // cancellation
+    std::atomic<bool> cancelled{false};
+    std::atomic<CallbackNode*> cancelCallbacks{nullptr}; // stack of callbacks of the producer (closed() once executed or dropped)
+    std::atomic<PromiseFutureStateBase*> upstream{nullptr}; // state this result depends on (holds a reference until ready)
+
+    PromiseFutureStateBase() = default;
+    PromiseFutureStateBase(const PromiseFutureStateBase&) = delete;
+    PromiseFutureStateBase& operator=(const PromiseFutureStateBase&) = delete;
+
+    virtual ~PromiseFutureStateBase(){
+        CallbackNode* node = this->callbacks.load(std::memory_order_acquire);
+        while(node != nullptr && node != closed()){ // callbacks that never got executed
+            CallbackNode* next = node->next;
+            if(node != &this->inlineCallback) delete node;
+            node = next;
+        }
+        deleteNodes(this->cancelCallbacks.load(std::memory_order_acquire));
+        PromiseFutureStateBase* up = this->upstream.load(std::memory_order_acquire);
+        if(up != nullptr) up->release();
+        delete this->timedWaiter.load(std::memory_order_acquire);
+    }
 
-template<typename T>
-class PromiseFutureState<std::shared_ptr<T>> {
-public:
+    /**
+     * Gives up a reference and deletes the state if it was the last one.
+     */
+    inline void release() noexcept {
+        if(this->refs.fetch_sub(1) == 1) delete this;
+    }
 
-    // referencens
-    std::atomic<size_t> refs = 1; // number of promises & futures pointing to this state
-    std::atomic<size_t> promiseRefs = 0; // number of promises pointing to this state
+    /** Marker for a callback stack that no longer accepts callbacks. */
+    static CallbackNode* closed() noexcept {
+        static CallbackNode marker;
+        return &marker;
+    }
 
-    // state
-    std::mutex mState;
-    std::condition_variable cvReady; // used when thread wants to wait for value
-    bool ready = false;
-    std::shared_ptr<T> value;
-    std::optional<std::exception> exception;
+    /**
+     * Returns if result (value or exception) is available.
+     */
+    inline bool isReady() const noexcept {
+        return this->status.load(std::memory_order_acquire) == READY;
+    }
 
-    // callbacks
-    std::mutex mCallbacks; // need own mutex because callbacks want to access state
-    std::vector<std::function<void(PromiseFutureState<std::shared_ptr<T>>*)>> callbacks; // used when callback wants to wait for value
-};
+    /**
+     * Marks state as ready without synchronization.
+     * Only allowed if no other thread can access this state yet.
+     */
+    inline void markReady() noexcept {
+        this->status.store(READY, std::memory_order_relaxed);
+        this->callbacks.store(closed(), std::memory_order_relaxed);
+    }
 
-template<>
-class PromiseFutureState<void> {
-public:
+    /**
+     * Blocks calling thread until result is available.
+     */
+    void waitReady() const noexcept {
+        uint32_t current;
+        while((current = this->status.load(std::memory_order_acquire)) != READY)
+            this->status.wait(current, std::memory_order_acquire);
+    }
 
-    // referencens
-    std::atomic<size_t> refs = 1; // number of promises & futures pointing to this state
-    std::atomic<size_t> promiseRefs = 0; // number of promises pointing to this state
+    /**
+     * Blocks calling thread until result is available or the deadline passed.
+     * Waiting on the status word cannot time out, so timed waits sleep on a condition variable
+     * that gets created by the first timed wait and is shared by all later ones (polling does not allocate).
+     * 
+     * @return true if result is available, false if the deadline passed before.
+     */
+    template<typename Clock, typename Duration>
+    bool waitReadyUntil(const std::chrono::time_point<Clock, Duration> &deadline){
+        if(this->isReady()) return true;
+        TimedWaiter* waiter = this->timedWaiter.load(std::memory_order_acquire);
+        if(waiter == nullptr){
+            TimedWaiter* created = new TimedWaiter();
+            if(this->timedWaiter.compare_exchange_strong(waiter, created, std::memory_order_seq_cst, std::memory_order_acquire)){
+                waiter = created;
+            } else {
+                delete created; // other thread was faster
+            }
+        }
+        // seq_cst pairs with finishFulfill(): either it sees the waiter or this sees the result
+        std::unique_lock<std::mutex> lock(waiter->mutex);
+        return waiter->cv.wait_until(lock, deadline, [this]{ return this->status.load(std::memory_order_seq_cst) == READY; });
+    }
 
-    // state
-    std::mutex mState;
-    std::condition_variable cvReady; // used when thread wants to wait for value
-    bool ready = false;
-    std::optional<std::exception> exception;
+    /**
+     * Claims the right to write the result.
+     * 
+     * @return true if the result can be written, false if the state got cancelled (result is dropped).
+     * @throws Throws a runtime_exception if result has already been set.
+     */
+    inline bool beginFulfill() noexcept(false) {
+        uint32_t expected = PENDING;
+        if(this->status.compare_exchange_strong(expected, SETTING, std::memory_order_acquire, std::memory_order_acquire))
+            return true;
+        if(expected == CANCELLING || this->isCancelled()) return false;
+        throw std::runtime_error("Promise already fulfilled");
+    }
 
-    // callbacks
-    std::mutex mCallbacks; // need own mutex because callbacks want to access state
-    std::vector<std::function<void(PromiseFutureState<void>*)>> callbacks; // used when callback wants to wait for value
-};
+    /**
+     * Returns if the state got cancelled (its result is the exception of cancel()).
+     */
+    inline bool isCancelled() const noexcept {
+        return this->cancelled.load(std::memory_order_acquire);
+    }
 
+    /**
+     * Fails the state with an exception if it has no result yet, then executes the cancel callbacks
+     * and cancels the upstream state. Callbacks and continuations run on the calling thread.
+     * 
+     * @param reason Message of the exception the state fails with.
+     * @return true if the state got cancelled, false if a result was already set.
+     */
+    bool cancel(const char* reason = "Future cancelled"){
+        uint32_t expected = PENDING;
+        if(!this->status.compare_exchange_strong(expected, CANCELLING, std::memory_order_acq_rel, std::memory_order_acquire))
+            return false; // a producer losing against CANCELLING drops its result
+        this->cancelled.store(true, std::memory_order_release);
+        CallbackNode* node = this->cancelCallbacks.exchange(closed(), std::memory_order_acq_rel);
+        PromiseFutureStateBase* up = this->upstream.exchange(nullptr, std::memory_order_acq_rel); // may race with setUpstream()
+        this->exception = std::runtime_error(reason);
+        this->finishFulfill(); // ready before upstream fails, its continuations cannot fulfill this state anymore
+        for(node = reverse(node); node != nullptr;){
+            CallbackNode* next = node->next;
+            node->task();
+            delete node;
+            node = next;
+        }
+        if(up != nullptr){
+            up->cancel(reason);
+            up->release();
+        }
+        return true;
+    }
 
+    /**
+     * Executes fn once the state gets cancelled (immediately if it already got cancelled).
+     * Dropped without being executed once the state has a result.
+     * 
+     * @param fn Callable without arguments.
+     */
+    template<typename Fn>
+    void addCancelCallback(Fn&& fn){
+        if(this->isReady() && !this->isCancelled()) return;
+        CallbackNode* node = new CallbackNode();
+        node->task.emplace(std::forward<Fn>(fn));
+        CallbackNode* head = this->cancelCallbacks.load(std::memory_order_acquire);
+        do {
+            if(head == closed()){ // cancelled or result set in the meantime
+                if(this->isCancelled()) node->task();
+                delete node;
+                return;
+            }
+            node->next = head;
+        } while(!this->cancelCallbacks.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_acquire));
+    }
 
+    /**
+     * Makes cancel() of this state also cancel the given state (the one this result depends on).
+     * Keeps a reference to it until this state is ready.
+     * Only allowed if no other thread can access this state yet (continuation just created).
+     */
+    inline void initUpstream(PromiseFutureStateBase* up) noexcept {
+        up->refs.fetch_add(1, std::memory_order_relaxed);
+        this->upstream.store(up, std::memory_order_relaxed);
+    }
 
+    /**
+     * Like initUpstream() but replaces a previously set upstream and may race with cancel().
+     */
+    void setUpstream(PromiseFutureStateBase* up){
+        up->refs++;
+        PromiseFutureStateBase* previous = this->upstream.exchange(up, std::memory_order_acq_rel);
+        if(previous != nullptr) previous->release();
+        if(this->isCancelled()){ // cancelled while linking
+            up = this->upstream.exchange(nullptr, std::memory_order_acq_rel);
+            if(up != nullptr){
+                up->cancel();
+                up->release();
+            }
+        }
+    }
 
-// ---------------------------------------------------------------------
-// ----- [ PROMISE IMPLEMENTATION ] ------------------------------------
-// ---------------------------------------------------------------------
+    /**
+     * Publishes the result written after beginFulfill(), 
+     * wakes up waiting threads and executes callbacks in the order they were added.
+     */
+    void finishFulfill(){
+        this->status.store(READY, std::memory_order_seq_cst);
+        this->status.notify_all();
+        TimedWaiter* waiter = this->timedWaiter.load(std::memory_order_seq_cst);
+        if(waiter != nullptr){
+            { std::lock_guard<std::mutex> lock(waiter->mutex); }
+            waiter->cv.notify_all();
+        }
 
+        // cancellation is no longer possible
+        if(this->cancelCallbacks.load(std::memory_order_relaxed) != nullptr)
+            deleteNodes(this->cancelCallbacks.exchange(closed(), std::memory_order_acq_rel));
+        PromiseFutureStateBase* up = this->upstream.load(std::memory_order_acquire);
+        if(up != nullptr){ // links happen before the result gets set, cancel() cannot claim anymore
+            this->upstream.store(nullptr, std::memory_order_relaxed);
+            up->release();
+        }
 
-template<typename T>
-Promise<T>::Promise(){
-    this->state = new PromiseFutureState<T>();
-    state->promiseRefs++;
+        CallbackNode* ordered = reverse(this->callbacks.exchange(closed(), std::memory_order_acq_rel));
+        while(ordered != nullptr){
+            CallbackNode* next = ordered->next;
+            {
+                SPI_TRACE_SCOPE("Future::callback");
+                ordered->task();
+            }
+            this->releaseCallbackNode(ordered);
+            ordered = next;
+        }
+    }
+
+    /**
+     * Executes fn as soon as result is available (immediately if already available).
+     * 
+     * @param fn Callable without arguments.
+     */
+    template<typename Fn>
+    void addCallback(Fn&& fn){
+        if(this->isReady()){
+            fn();
+            return;
+        }
+        CallbackNode* node = this->newCallbackNode(std::forward<Fn>(fn));
+        if(this->pushCallback(node)) return;
+        Task task = std::move(node->task); // got ready in the meantime
+        this->releaseCallbackNode(node);
+        task(); // last access, callback may release the last reference to this state
+    }
+
+    /**
+     * Registers fn to be executed as soon as result is available.
+     * Unlike addCallback() fn is never executed by the calling thread.
+     * 
+     * @param fn Callable without arguments.
+     * @return true if fn got registered, false if result is already available (fn got dropped).
+     */
+    template<typename Fn>
+    bool tryAddCallback(Fn&& fn){
+        if(this->isReady()) return false;
+        CallbackNode* node = this->newCallbackNode(std::forward<Fn>(fn));
+        if(this->pushCallback(node)) return true;
+        this->releaseCallbackNode(node); // got ready in the meantime
+        return false;
+    }
+
+#if SPI_FUTURE_STATE_POOL
+    // states are recycled by the pool of the thread that created them
+    static void* operator new(size_t size){
+        return FutureStatePool::allocate(size);
+    }
+
+    static void operator delete(void* ptr) noexcept {
+        FutureStatePool::release(ptr);
+    }
+#endif
+
+protected:
+
+    /** Takes the inline node for the first callback, allocates nodes for further ones. */
+    template<typename Fn>
+    inline CallbackNode* newCallbackNode(Fn&& fn){
+        CallbackNode* node = (!this->inlineCallbackUsed.load(std::memory_order_relaxed) && !this->inlineCallbackUsed.exchange(true, std::memory_order_relaxed))
+                                ? &this->inlineCallback : new CallbackNode();
+        node->task.emplace(std::forward<Fn>(fn));
+        return node;
+    }
+
+    /** Pushes node onto the callback stack, returns false if the stack got closed (result ready). */
+    inline bool pushCallback(CallbackNode* node) noexcept {
+        CallbackNode* head = this->callbacks.load(std::memory_order_acquire);
+        do {
+            if(head == closed()) return false;
+            node->next = head;
+        } while(!this->callbacks.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_acquire));
+        return true;
+    }
+
+    inline void releaseCallbackNode(CallbackNode* node) noexcept {
+        if(node == &this->inlineCallback){
+            node->task.reset();
+        } else {
+            delete node;
+        }
+    }
+
+    /** Reverses a callback stack (newest first) into the order the callbacks were added. */
+    static CallbackNode* reverse(CallbackNode* node) noexcept {
+        CallbackNode* ordered = nullptr;
+        while(node != nullptr && node != closed()){
+            CallbackNode* next = node->next;
+            node->next = ordered;
+            ordered = node;
+            node = next;
+        }
+        return ordered;
+    }
+
+    /** Deletes the separately allocated nodes of a stack without executing them. */
+    static void deleteNodes(CallbackNode* node) noexcept {
+        while(node != nullptr && node != closed()){
+            CallbackNode* next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+};
+
+
+template<typename T>
+class PromiseFutureState : public PromiseFutureStateBase {
+public:
+    std::optional<T> value;
+};
+
+template<typename T>
+class PromiseFutureState<std::shared_ptr<T>> : public PromiseFutureStateBase {
+public:
+    std::shared_ptr<T> value;
+};
+
+template<>
+class PromiseFutureState<void> : public PromiseFutureStateBase {
+};
+
+
+
+/**
+ * Handle to the cancellation of a promise/future pair that can be handed to the code producing
+ * the result (e.g. a task running on a thread pool) without handing out the promise itself.
+ * Keeps the shared state alive like a future does.
+ */
+class CancellationToken {
+    template<typename> friend class Promise;
+    template<typename> friend class Future;
+protected:
+
+    PromiseFutureStateBase *state;
+
+    explicit CancellationToken(PromiseFutureStateBase *state) noexcept : state(state) {
+        state->refs++;
+    }
+
+public:
+
+    CancellationToken(const CancellationToken &other) noexcept : state(other.state) {
+        state->refs++;
+    }
+
+    CancellationToken& operator=(const CancellationToken &other) noexcept {
+        if(this != &other){
+            other.state->refs++;
+            this->state->release();
+            this->state = other.state;
+        }
+        return *this;
+    }
+
+    ~CancellationToken(){
+        state->release();
+    }
+
+    /**
+     * Returns if cancellation of the result got requested (by the future, a timeout or a cancelled continuation).
+     */
+    bool isCancelled() const noexcept {
+        return state->isCancelled();
+    }
+
+    /**
+     * Cancels the future if it has no result yet (see Future::cancel()).
+     * 
+     * @param reason Message of the exception the future fails with.
+     * @return true if the future got cancelled, false if it already had a result.
+     */
+    bool cancel(const char* reason = "Future cancelled"){
+        return state->cancel(reason);
+    }
+
+    /**
+     * Invokes the callback as soon as the future gets cancelled (immediately if it already got cancelled).
+     * The callback is dropped without being invoked once the result is set.
+     * 
+     * @param callback Callback function that should stop the work producing the result.
+     */
+    void onCancel(std::function<void()> callback){
+        state->addCancelCallback(std::move(callback));
+    }
+};
+
+
+
+
+
+// ---------------------------------------------------------------------
+// ----- [ PROMISE IMPLEMENTATION ] ------------------------------------
+// ---------------------------------------------------------------------
+
+
+template<typename T>
+Promise<T>::Promise(){
+    this->state = new PromiseFutureState<T>();
+    state->promiseRefs++;
 }
 
 template<typename T>
@@ -859,57 +1600,49 @@ Promise<T>& Promise<T>::operator=(Promise<T> &&other) {
 
 template<typename T>
 Promise<T>::~Promise() noexcept(false) {
-    std::unique_lock<std::mutex> lockState(state->mState);
+    const bool lastPromise = state->promiseRefs.fetch_sub(1) == 1;
+    const bool ready = state->isReady() || state->isCancelled(); // read before giving up reference
     if(state->refs.fetch_sub(1) == 1){
         // this is last reference
-        lockState.unlock();
         delete state;
         return;
     }
-    if(state->promiseRefs.fetch_sub(1) == 1){
-        if(!state->ready) // if this is last promise, state not ready, but still futures waiting
-            throw std::runtime_error("Promise with waiting futures deleted before being fulfilled");
-    }
+    if(lastPromise && !ready) // if this is last promise, state not ready, but still futures waiting
+        throw std::runtime_error("Promise with waiting futures deleted before being fulfilled");
 }
 
 template<typename T>
 bool Promise<T>::isFulfilled() const {
-    std::lock_guard<std::mutex> lock(state->mState);
-    return state->ready;
+    return state->isReady();
 }
 
 template<typename T>
-void Promise<T>::set_value(T value) noexcept(false) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready)
-        throw std::runtime_error("Promise already fulfilled");
-    state->ready = true;
-    state->value = value;
-    lockState.unlock();
+bool Promise<T>::isCancelled() const {
+    return state->isCancelled();
+}
 
-    state->cvReady.notify_all();
+template<typename T>
+void Promise<T>::onCancel(std::function<void()> callback) {
+    state->addCancelCallback(std::move(callback));
+}
+
+template<typename T>
+CancellationToken Promise<T>::get_cancellation_token() const {
+    return CancellationToken(state);
+}
 
-    std::lock_guard<std::mutex> lockCallbacks(state->mCallbacks);
-    for(auto &callback : state->callbacks)
-        callback(state);
-    state->callbacks.clear();
+template<typename T>
+void Promise<T>::set_value(T value) noexcept(false) {
+    if(!state->beginFulfill()) return; // cancelled, result no longer wanted (throws if already fulfilled)
+    state->value = value;
+    state->finishFulfill(); // wakes up waiting threads and executes callbacks
 }
 
 template<typename T>
 void Promise<T>::set_exception(const std::exception &exception) noexcept(false) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready)
-        throw std::runtime_error("Promise already fulfilled");
-    state->ready = true;
+    if(!state->beginFulfill()) return; // cancelled, result no longer wanted (throws if already fulfilled)
     state->exception = exception;
-    lockState.unlock();
-
-    state->cvReady.notify_all();
-
-    std::lock_guard<std::mutex> lockCallbacks(state->mCallbacks);
-    for(auto &callback : state->callbacks)
-        callback(state);
-    state->callbacks.clear();
+    state->finishFulfill(); // wakes up waiting threads and executes callbacks
 }
 
 template<typename T>
@@ -942,57 +1675,49 @@ Promise<std::shared_ptr<T>>& Promise<std::shared_ptr<T>>::operator=(Promise<std:
 
 template<typename T>
 Promise<std::shared_ptr<T>>::~Promise() noexcept(false) {
-    std::unique_lock<std::mutex> lockState(state->mState);
+    const bool lastPromise = state->promiseRefs.fetch_sub(1) == 1;
+    const bool ready = state->isReady() || state->isCancelled(); // read before giving up reference
     if(state->refs.fetch_sub(1) == 1){
         // this is last reference
-        lockState.unlock();
         delete state;
         return;
     }
-    if(state->promiseRefs.fetch_sub(1) == 1){
-        if(!state->ready) // if this is last promise, state not ready, but still futures waiting
-            throw std::runtime_error("Promise with waiting futures deleted before being fulfilled");
-    }
+    if(lastPromise && !ready) // if this is last promise, state not ready, but still futures waiting
+        throw std::runtime_error("Promise with waiting futures deleted before being fulfilled");
 }
 
 template<typename T>
 bool Promise<std::shared_ptr<T>>::isFulfilled() const {
-    std::lock_guard<std::mutex> lock(state->mState);
-    return state->ready;
+    return state->isReady();
 }
 
 template<typename T>
-void Promise<std::shared_ptr<T>>::set_value(std::shared_ptr<T> value) noexcept(false) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready)
-        throw std::runtime_error("Promise already fulfilled");
-    state->ready = true;
-    state->value = value;
-    lockState.unlock();
+bool Promise<std::shared_ptr<T>>::isCancelled() const {
+    return state->isCancelled();
+}
 
-    state->cvReady.notify_all();
+template<typename T>
+void Promise<std::shared_ptr<T>>::onCancel(std::function<void()> callback) {
+    state->addCancelCallback(std::move(callback));
+}
+
+template<typename T>
+CancellationToken Promise<std::shared_ptr<T>>::get_cancellation_token() const {
+    return CancellationToken(state);
+}
 
-    std::lock_guard<std::mutex> lockCallbacks(state->mCallbacks);
-    for(auto &callback : state->callbacks)
-        callback(state);
-    state->callbacks.clear();
+template<typename T>
+void Promise<std::shared_ptr<T>>::set_value(std::shared_ptr<T> value) noexcept(false) {
+    if(!state->beginFulfill()) return; // cancelled, result no longer wanted (throws if already fulfilled)
+    state->value = value;
+    state->finishFulfill(); // wakes up waiting threads and executes callbacks
 }
 
 template<typename T>
 void Promise<std::shared_ptr<T>>::set_exception(const std::exception &exception) noexcept(false) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready)
-        throw std::runtime_error("Promise already fulfilled");
-    state->ready = true;
+    if(!state->beginFulfill()) return; // cancelled, result no longer wanted (throws if already fulfilled)
     state->exception = exception;
-    lockState.unlock();
-
-    state->cvReady.notify_all();
-
-    std::lock_guard<std::mutex> lockCallbacks(state->mCallbacks);
-    for(auto &callback : state->callbacks)
-        callback(state);
-    state->callbacks.clear();
+    state->finishFulfill(); // wakes up waiting threads and executes callbacks
 }
 
 template<typename T>
@@ -1011,15 +1736,15 @@ Future<std::shared_ptr<T>> Promise<std::shared_ptr<T>>::get_future() {
 template<typename T>
 Future<T>::Future(T value){
     this->state = new PromiseFutureState<T>();
-    state->ready = true;
     state->value = value;
+    state->markReady(); // no other thread can access state yet
 }
 
 template<typename T>
 Future<T>::Future(const std::exception &exception){
     this->state = new PromiseFutureState<T>();
-    state->ready = true;
     state->exception = exception;
+    state->markReady(); // no other thread can access state yet
 }
 
 template<typename T>
@@ -1067,91 +1792,77 @@ Future<T>::~Future(){
 
 template<typename T>
 bool Future<T>::is_ready() const {
-    std::lock_guard<std::mutex> lock(state->mState);
-    return state->ready;
+    return state->isReady();
 }
 
 template<typename T>
 bool Future<T>::has_value() const {
-    std::lock_guard<std::mutex> lock(state->mState);
-    return state->value.has_value();
+    return state->isReady() && state->value.has_value();
 }
 
 template<typename T>
 bool Future<T>::has_exception() const {
-    std::lock_guard<std::mutex> lock(state->mState);
-    return state->exception.has_value();
+    return state->isReady() && state->exception.has_value();
 }
 
 template<typename T>
 T Future<T>::get_value() noexcept(false) {
-    std::unique_lock<std::mutex> lock(state->mState);
-    if(state->value.has_value()){
+    state->waitReady(); // returns immediately if ready
+    if(state->value.has_value())
         return state->value.value();
-    } else if(state->exception.has_value()){
-        throw state->exception.value();
-    } else {
-        // wait for ready
-        state->cvReady.wait(lock, [this]{ return state->ready; });
-
-        if(state->value.has_value())
-            return state->value.value();
-        throw state->exception.value();
-    }
+    throw state->exception.value();
 }
 
 template<typename T>
 std::exception Future<T>::get_exception() noexcept(false) {
-    std::unique_lock<std::mutex> lock(state->mState);
-    if(state->exception.has_value()) {
+    state->waitReady(); // returns immediately if ready
+    if(state->exception.has_value())
         return state->exception.value();
-    } else if(state->value.has_value()) {
-        throw std::runtime_error("Future has value instead of exception");
-    } else {
-        // wait for ready
-        state->cvReady.wait(lock, [this]{ return state->ready; });
+    throw std::runtime_error("Future has value instead of exception");
+}
 
-        if(state->exception.has_value())
-            return state->exception.value();
-        throw std::runtime_error("Future has value instead of exception");
-    }
+template<typename T>
+template<typename Rep, typename Period>
+bool Future<T>::wait_for(const std::chrono::duration<Rep, Period> &timeout) {
+    return state->waitReadyUntil(std::chrono::steady_clock::now() + timeout);
+}
+
+template<typename T>
+template<typename Clock, typename Duration>
+bool Future<T>::wait_until(const std::chrono::time_point<Clock, Duration> &deadline) {
+    return state->waitReadyUntil(deadline);
+}
+
+template<typename T>
+bool Future<T>::cancel() {
+    return state->cancel();
+}
+
+template<typename T>
+bool Future<T>::is_cancelled() const {
+    return state->isCancelled();
+}
+
+template<typename T>
+CancellationToken Future<T>::get_cancellation_token() const {
+    return CancellationToken(state);
 }
 
 
 template<typename T>
 void Future<T>::onValue(std::function<void(T)> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(state->value.has_value()){
             T value = state->value.value();
-            lockState.unlock(); // unlock before callback
             callback(value);
             return;
         }
     } else {
         // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(state->value.has_value()){
-                T value = state->value.value();
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                callback(value);
-                return;
-            }
-        }
-
-        // wait for this ready
-        state->callbacks.push_back([callback](PromiseFutureState<T> *state){
+        state->addCallback([state = this->state, callback]{
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(state->value.has_value()){
                 T value = state->value.value();
-                lockState.unlock(); // unlock before callback
                 callback(value);
             }
         });
@@ -1160,38 +1871,18 @@ void Future<T>::onValue(std::function<void(T)> callback) noexcept(true) {
 
 template<typename T>
 void Future<T>::onException(std::function<void(std::exception)> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(state->exception.has_value()){
             std::exception exception = state->exception.value();
-            lockState.unlock(); // unlock before callback
             callback(exception);
             return;
         }
     } else {
         // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(state->exception.has_value()){
-                std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                callback(exception);
-                return;
-            }
-        }
-
-        // wait for this ready
-        state->callbacks.push_back([callback](PromiseFutureState<T> *state){
+        state->addCallback([state = this->state, callback]{
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(state->exception.has_value()){
                 std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before callback
                 callback(exception);
             }
         });
@@ -1203,11 +1894,9 @@ void Future<T>::onException(std::function<void(std::exception)> callback) noexce
 template<typename T>
 template<typename R>
 Future<R> Future<T>::then(std::function<R(T)> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(state->value.has_value()){
             T value = state->value.value();
-            lockState.unlock(); // unlock before callback
             try {
                 if constexpr (std::is_same<R, void>::value) {
                     callback(value);
@@ -1222,41 +1911,14 @@ Future<R> Future<T>::then(std::function<R(T)> callback) noexcept(true) {
             return Future<R>(state->exception.value());
         }
     } else {
-        // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(state->value.has_value()){
-                T value = state->value.value();
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                try {
-                    if constexpr (std::is_same<R, void>::value) {
-                        callback(value);
-                        return Future<R>();
-                    } else {
-                        return Future<R>(callback(value));
-                    }
-                } catch(const std::exception &exception) {
-                    return Future<R>(exception);
-                }
-            } else {
-                return Future<R>(state->exception.value());
-            }
-        }
-
         // wait for this ready
         Promise<R> *promise = new Promise<R>();
         Future<R> future = promise->get_future();
-        state->callbacks.push_back([promise, callback](PromiseFutureState<T> *state){ // this future may be already deleted when invoked
+        promise->state->initUpstream(state); // cancelling the continuation cancels this future
+        state->addCallback([state = this->state, promise, callback]{ // this future may be already deleted when invoked
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(state->value.has_value()){
                 T value = state->value.value();
-                lockState.unlock(); // unlock before callback
                 try {
                     if constexpr (std::is_same<R, void>::value) {
                         callback(value);
@@ -1269,7 +1931,6 @@ Future<R> Future<T>::then(std::function<R(T)> callback) noexcept(true) {
                 }
             } else {
                 std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before setting exception
                 promise->set_exception(exception);
             }
             delete promise;
@@ -1282,11 +1943,9 @@ Future<R> Future<T>::then(std::function<R(T)> callback) noexcept(true) {
 template<typename T>
 template<typename R>
 Future<std::shared_ptr<R>> Future<T>::then(std::function<std::shared_ptr<R>(T)> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(state->value.has_value()){
             T value = state->value.value();
-            lockState.unlock(); // unlock before callback
             try {
                 return Future<std::shared_ptr<R>>(callback(value));
             } catch(const std::exception &exception) {
@@ -1296,36 +1955,14 @@ Future<std::shared_ptr<R>> Future<T>::then(std::function<std::shared_ptr<R>(T)>
             return Future<std::shared_ptr<R>>(state->exception.value());
         }
     } else {
-        // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(state->value.has_value()){
-                T value = state->value.value();
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                try {
-                    return Future<std::shared_ptr<R>>(callback(value));
-                } catch(const std::exception &exception) {
-                    return Future<std::shared_ptr<R>>(exception);
-                }
-            } else {
-                return Future<std::shared_ptr<R>>(state->exception.value());
-            }
-        }
-
         // wait for this ready
         Promise<std::shared_ptr<R>> *promise = new Promise<std::shared_ptr<R>>();
         Future<std::shared_ptr<R>> future = promise->get_future();
-        state->callbacks.push_back([promise, callback](PromiseFutureState<T> *state){ // this future may be already deleted when invoked
+        promise->state->initUpstream(state); // cancelling the continuation cancels this future
+        state->addCallback([state = this->state, promise, callback]{ // this future may be already deleted when invoked
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(state->value.has_value()){
                 T value = state->value.value();
-                lockState.unlock(); // unlock before callback
                 try {
                     promise->set_value(callback(value));
                 } catch(const std::exception &exception) {
@@ -1333,7 +1970,6 @@ Future<std::shared_ptr<R>> Future<T>::then(std::function<std::shared_ptr<R>(T)>
                 }
             } else {
                 std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before setting exception
                 promise->set_exception(exception);
             }
             delete promise;
@@ -1346,11 +1982,9 @@ Future<std::shared_ptr<R>> Future<T>::then(std::function<std::shared_ptr<R>(T)>
 template<typename T>
 template<typename R>
 Future<R> Future<T>::thenFuture(std::function<Future<R>(T)> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(state->value.has_value()){
             T value = state->value.value();
-            lockState.unlock(); // unlock before callback
             try {
                 return callback(value);
             } catch(const std::exception &exception) {
@@ -1360,38 +1994,17 @@ Future<R> Future<T>::thenFuture(std::function<Future<R>(T)> callback) noexcept(t
             return Future<R>(state->exception.value());
         }
     } else {
-        // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(state->value.has_value()){
-                T value = state->value.value();
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                try {
-                    return callback(value);
-                } catch(const std::exception &exception) {
-                    return Future<R>(exception);
-                }
-            } else {
-                return Future<R>(state->exception.value());
-            }
-        }
-
         // wait for this ready
         Promise<R> *promise = new Promise<R>();
         Future<R> future = promise->get_future();
-        state->callbacks.push_back([promise, callback](PromiseFutureState<T> *state){ // this future may be already deleted when invoked
+        promise->state->initUpstream(state); // cancelling the continuation cancels this future
+        state->addCallback([state = this->state, promise, callback]{ // this future may be already deleted when invoked
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(state->value.has_value()){
                 T value = state->value.value();
-                lockState.unlock(); // unlock before callback
                 try {
                     Future<R> future = callback(value);
+                    promise->state->setUpstream(future.state); // and the future returned by the callback
                     if constexpr (std::is_same<R, void>::value) {
                         future.onValue([promise](){
                             promise->set_value();
@@ -1413,7 +2026,6 @@ Future<R> Future<T>::thenFuture(std::function<Future<R>(T)> callback) noexcept(t
                 }
             } else {
                 std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before setting exception
                 promise->set_exception(exception);
                 delete promise;
             }
@@ -1426,11 +2038,9 @@ Future<R> Future<T>::thenFuture(std::function<Future<R>(T)> callback) noexcept(t
 template<typename T>
 template<typename R>
 Future<std::shared_ptr<R>> Future<T>::thenFuture(std::function<Future<std::shared_ptr<R>>(T)> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(state->value.has_value()){
             T value = state->value.value();
-            lockState.unlock(); // unlock before callback
             try {
                 return callback(value);
             } catch(const std::exception &exception) {
@@ -1440,38 +2050,17 @@ Future<std::shared_ptr<R>> Future<T>::thenFuture(std::function<Future<std::share
             return Future<std::shared_ptr<R>>(state->exception.value());
         }
     } else {
-        // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(state->value.has_value()){
-                T value = state->value.value();
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                try {
-                    return callback(value);
-                } catch(const std::exception &exception) {
-                    return Future<std::shared_ptr<R>>(exception);
-                }
-            } else {
-                return Future<std::shared_ptr<R>>(state->exception.value());
-            }
-        }
-
         // wait for this ready
         Promise<std::shared_ptr<R>> *promise = new Promise<std::shared_ptr<R>>();
         Future<std::shared_ptr<R>> future = promise->get_future();
-        state->callbacks.push_back([promise, callback](PromiseFutureState<T> *state){ // this future may be already deleted when invoked
+        promise->state->initUpstream(state); // cancelling the continuation cancels this future
+        state->addCallback([state = this->state, promise, callback]{ // this future may be already deleted when invoked
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(state->value.has_value()){
                 T value = state->value.value();
-                lockState.unlock(); // unlock before callback
                 try {
                     Future<std::shared_ptr<R>> future = callback(value);
+                    promise->state->setUpstream(future.state); // and the future returned by the callback
                     future.onValue([promise](std::shared_ptr<R> value){
                         promise->set_value(value);
                         delete promise;
@@ -1486,7 +2075,6 @@ Future<std::shared_ptr<R>> Future<T>::thenFuture(std::function<Future<std::share
                 }
             } else {
                 std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before setting exception
                 promise->set_exception(exception);
                 delete promise;
             }
@@ -1499,13 +2087,11 @@ Future<std::shared_ptr<R>> Future<T>::thenFuture(std::function<Future<std::share
 // callback taking exception and returning T
 template<typename T>
 Future<T> Future<T>::catchAll(std::function<T(std::exception)> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(state->value.has_value()){
             return Future<T>(state->value.value());
         } else {
             std::exception exception = state->exception.value();
-            lockState.unlock(); // unlock before callback
             try {
                 return Future<T>(callback(exception));
             } catch(const std::exception &exception) {
@@ -1513,40 +2099,17 @@ Future<T> Future<T>::catchAll(std::function<T(std::exception)> callback) noexcep
             }
         }
     } else {
-        // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(state->value.has_value()){
-                return Future<T>(state->value.value());
-            } else {
-                std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                try {
-                    return Future<T>(callback(exception));
-                } catch(const std::exception &exception) {
-                    return Future<T>(exception);
-                }
-            }
-        }
-
         // wait for this ready
         Promise<T> *promise = new Promise<T>();
         Future<T> future = promise->get_future();
-        state->callbacks.push_back([promise, callback](PromiseFutureState<T> *state){ // this future may be already deleted when invoked
+        promise->state->initUpstream(state); // cancelling the continuation cancels this future
+        state->addCallback([state = this->state, promise, callback]{ // this future may be already deleted when invoked
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(state->value.has_value()){
                 T value = state->value.value();
-                lockState.unlock(); // unlock before setting value
                 promise->set_value(value);
             } else {
                 std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before callback
                 try {
                     promise->set_value(callback(exception));
                 } catch(const std::exception &exception) {
@@ -1562,13 +2125,11 @@ Future<T> Future<T>::catchAll(std::function<T(std::exception)> callback) noexcep
 // callback taking exception and returning Future<T>
 template<typename T>
 Future<T> Future<T>::catchAllFuture(std::function<Future<T>(std::exception)> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(state->value.has_value()){
             return Future<T>(state->value.value());
         } else {
             std::exception exception = state->exception.value();
-            lockState.unlock(); // unlock before callback
             try {
                 return callback(exception);
             } catch(const std::exception &exception) {
@@ -1576,43 +2137,21 @@ Future<T> Future<T>::catchAllFuture(std::function<Future<T>(std::exception)> cal
             }
         }
     } else {
-        // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(state->value.has_value()){
-                return Future<T>(state->value.value());
-            } else {
-                std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                try {
-                    return callback(exception);
-                } catch(const std::exception &exception) {
-                    return Future<T>(exception);
-                }
-            }
-        }
-
         // wait for this ready
         Promise<T> *promise = new Promise<T>();
         Future<T> future = promise->get_future();
-        state->callbacks.push_back([promise, callback](PromiseFutureState<T> *state){ // this future may be already deleted when invoked
+        promise->state->initUpstream(state); // cancelling the continuation cancels this future
+        state->addCallback([state = this->state, promise, callback]{ // this future may be already deleted when invoked
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(state->value.has_value()){
                 T value = state->value.value();
-                lockState.unlock(); // unlock before setting value
                 promise->set_value(value);
                 delete promise;
             } else {
                 std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before callback
                 try {
                     Future<T> future = callback(exception);
+                    promise->state->setUpstream(future.state); // and the future returned by the callback
                     future.onValue([promise](T value){
                         promise->set_value(value);
                         delete promise;
@@ -1632,29 +2171,89 @@ Future<T> Future<T>::catchAllFuture(std::function<Future<T>(std::exception)> cal
 }
 
 
-
-
-
+// callbacks executed on executor
 template<typename T>
-Future<std::shared_ptr<T>>::Future(std::shared_ptr<T> value){
-    this->state = new PromiseFutureState<std::shared_ptr<T>>();
-    state->ready = true;
-    state->value = value;
+template<typename E> requires Executor<E>
+void Future<T>::onValue(E &executor, std::function<void(T)> callback) noexcept(true) {
+    state->addCallback([state = this->state, &executor, callback]{ // executed immediately if already ready
+        if(state->value.has_value()){
+            executeOn(executor, Task([callback](T &value){ callback(value); }, state->value.value()));
+        }
+    });
 }
 
 template<typename T>
-Future<std::shared_ptr<T>>::Future(const std::exception &exception){
-    this->state = new PromiseFutureState<std::shared_ptr<T>>();
-    state->ready = true;
-    state->exception = exception;
+template<typename E> requires Executor<E>
+void Future<T>::onException(E &executor, std::function<void(std::exception)> callback) noexcept(true) {
+    state->addCallback([state = this->state, &executor, callback]{ // executed immediately if already ready
+        if(state->exception.has_value()){
+            executeOn(executor, Task([callback](std::exception &exception){ callback(exception); }, state->exception.value()));
+        }
+    });
 }
 
 template<typename T>
-Future<std::shared_ptr<T>>::Future(PromiseFutureState<std::shared_ptr<T>> *state) {
-    this->state = state;
-    state->refs++;
-}
-
+template<typename R, typename E> requires Executor<E>
+Future<R> Future<T>::then(E &executor, std::function<R(T)> callback) noexcept(true) {
+    Promise<R> *promise = new Promise<R>();
+    Future<R> future = promise->get_future();
+    promise->state->initUpstream(state); // cancelling the continuation cancels this future
+    state->addCallback([state = this->state, &executor, promise, callback]{ // executed immediately if already ready
+        if(state->value.has_value()){
+            executeOn(executor, Task([promise, callback](T &value){
+                if(promise->isCancelled()){ // continuation no longer wanted
+                    delete promise;
+                    return;
+                }
+                try {
+                    if constexpr (std::is_same<R, void>::value) {
+                        callback(value);
+                        promise->set_value();
+                    } else {
+                        promise->set_value(callback(value));
+                    }
+                } catch(const std::exception &exception) {
+                    promise->set_exception(exception);
+                }
+                delete promise;
+            }, state->value.value()));
+        } else {
+            promise->set_exception(state->exception.value());
+            delete promise;
+        }
+    });
+    return future;
+}
+
+template<typename T>
+template<typename Fn>
+void Future<T>::onResult(Fn&& callback) const noexcept(true) {
+    state->addCallback([state = this->state, callback = std::forward<Fn>(callback)]() mutable { // executed immediately if already ready
+        Future<T> future(state);
+        callback(future);
+    });
+}
+
+template<typename T>
+Future<std::shared_ptr<T>>::Future(std::shared_ptr<T> value){
+    this->state = new PromiseFutureState<std::shared_ptr<T>>();
+    state->value = value;
+    state->markReady(); // no other thread can access state yet
+}
+
+template<typename T>
+Future<std::shared_ptr<T>>::Future(const std::exception &exception){
+    this->state = new PromiseFutureState<std::shared_ptr<T>>();
+    state->exception = exception;
+    state->markReady(); // no other thread can access state yet
+}
+
+template<typename T>
+Future<std::shared_ptr<T>>::Future(PromiseFutureState<std::shared_ptr<T>> *state) {
+    this->state = state;
+    state->refs++;
+}
+
 template<typename T>
 Future<std::shared_ptr<T>>::Future(const Future<std::shared_ptr<T>> &other){
     this->state = other.state;
@@ -1694,91 +2293,77 @@ Future<std::shared_ptr<T>>::~Future(){
 
 template<typename T>
 bool Future<std::shared_ptr<T>>::is_ready() const {
-    std::lock_guard<std::mutex> lock(state->mState);
-    return state->ready;
+    return state->isReady();
 }
 
 template<typename T>
 bool Future<std::shared_ptr<T>>::has_value() const {
-    std::lock_guard<std::mutex> lock(state->mState);
-    return state->ready && !state->exception.has_value();
+    return state->isReady() && !state->exception.has_value();
 }
 
 template<typename T>
 bool Future<std::shared_ptr<T>>::has_exception() const {
-    std::lock_guard<std::mutex> lock(state->mState);
-    return state->exception.has_value();
+    return state->isReady() && state->exception.has_value();
 }
 
 template<typename T>
 std::shared_ptr<T> Future<std::shared_ptr<T>>::get_value() noexcept(false) {
-    std::unique_lock<std::mutex> lock(state->mState);
-    if(state->ready && !state->exception.has_value()){
+    state->waitReady(); // returns immediately if ready
+    if(!state->exception.has_value())
         return state->value;
-    } else if(state->exception.has_value()){
-        throw state->exception.value();
-    } else {
-        // wait for ready
-        state->cvReady.wait(lock, [this]{ return state->ready; });
-        
-        if(state->ready && !state->exception.has_value())
-            return state->value;
-        throw state->exception.value();
-    }
+    throw state->exception.value();
 }
 
 template<typename T>
 std::exception Future<std::shared_ptr<T>>::get_exception() noexcept(false) {
-    std::unique_lock<std::mutex> lock(state->mState);
-    if(state->exception.has_value()) {
+    state->waitReady(); // returns immediately if ready
+    if(state->exception.has_value())
         return state->exception.value();
-    } else if(state->ready) {
-        throw std::runtime_error("Future has value instead of exception");
-    } else {
-        // wait for ready
-        state->cvReady.wait(lock, [this]{ return state->ready; });
-        
-        if(state->exception.has_value())
-            return state->exception.value();
-        throw std::runtime_error("Future has value instead of exception");
-    }
+    throw std::runtime_error("Future has value instead of exception");
+}
+
+template<typename T>
+template<typename Rep, typename Period>
+bool Future<std::shared_ptr<T>>::wait_for(const std::chrono::duration<Rep, Period> &timeout) {
+    return state->waitReadyUntil(std::chrono::steady_clock::now() + timeout);
+}
+
+template<typename T>
+template<typename Clock, typename Duration>
+bool Future<std::shared_ptr<T>>::wait_until(const std::chrono::time_point<Clock, Duration> &deadline) {
+    return state->waitReadyUntil(deadline);
+}
+
+template<typename T>
+bool Future<std::shared_ptr<T>>::cancel() {
+    return state->cancel();
+}
+
+template<typename T>
+bool Future<std::shared_ptr<T>>::is_cancelled() const {
+    return state->isCancelled();
+}
+
+template<typename T>
+CancellationToken Future<std::shared_ptr<T>>::get_cancellation_token() const {
+    return CancellationToken(state);
 }
 
 
 template<typename T>
 void Future<std::shared_ptr<T>>::onValue(std::function<void(std::shared_ptr<T>)> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(!state->exception.has_value()){
             std::shared_ptr<T> value = state->value;
-            lockState.unlock(); // unlock before callback
             callback(value);
             return;
         }
     } else {
         // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(!state->exception.has_value()){
-                std::shared_ptr<T> value = state->value;
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                callback(value);
-                return;
-            }
-        }
-
-        // wait for this ready
-        state->callbacks.push_back([callback](PromiseFutureState<std::shared_ptr<T>> *state){
+        state->addCallback([state = this->state, callback]{
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(!state->exception.has_value()){
                 std::shared_ptr<T> value = state->value;
-                lockState.unlock(); // unlock before callback
                 callback(value);
             }
         });
@@ -1787,38 +2372,18 @@ void Future<std::shared_ptr<T>>::onValue(std::function<void(std::shared_ptr<T>)>
 
 template<typename T>
 void Future<std::shared_ptr<T>>::onException(std::function<void(std::exception)> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(state->exception.has_value()){
             std::exception exception = state->exception.value();
-            lockState.unlock(); // unlock before callback
             callback(exception);
             return;
         }
     } else {
         // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(state->exception.has_value()){
-                std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                callback(exception);
-                return;
-            }
-        }
-
-        // wait for this ready
-        state->callbacks.push_back([callback](PromiseFutureState<std::shared_ptr<T>> *state){
+        state->addCallback([state = this->state, callback]{
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(state->exception.has_value()){
                 std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before callback
                 callback(exception);
             }
         });
@@ -1830,11 +2395,9 @@ void Future<std::shared_ptr<T>>::onException(std::function<void(std::exception)>
 template<typename T>
 template<typename R>
 Future<R> Future<std::shared_ptr<T>>::then(std::function<R(std::shared_ptr<T>)> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(!state->exception.has_value()){
             std::shared_ptr<T> value = state->value;
-            lockState.unlock(); // unlock before callback
             try {
                 if constexpr (std::is_same<R, void>::value) {
                     callback(value);
@@ -1849,41 +2412,14 @@ Future<R> Future<std::shared_ptr<T>>::then(std::function<R(std::shared_ptr<T>)>
             return Future<R>(state->exception.value());
         }
     } else {
-        // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(!state->exception.has_value()){
-                std::shared_ptr<T> value = state->value;
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                try {
-                    if constexpr (std::is_same<R, void>::value) {
-                        callback(value);
-                        return Future<R>();
-                    } else {
-                        return Future<R>(callback(value));
-                    }
-                } catch(const std::exception &exception) {
-                    return Future<R>(exception);
-                }
-            } else {
-                return Future<R>(state->exception.value());
-            }
-        }
-
         // wait for this ready
         Promise<R> *promise = new Promise<R>();
         Future<R> future = promise->get_future();
-        state->callbacks.push_back([promise, callback](PromiseFutureState<std::shared_ptr<T>> *state){ // this future may be already deleted when invoked
+        promise->state->initUpstream(state); // cancelling the continuation cancels this future
+        state->addCallback([state = this->state, promise, callback]{ // this future may be already deleted when invoked
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(!state->exception.has_value()){
                 std::shared_ptr<T> value = state->value;
-                lockState.unlock(); // unlock before callback
                 try {
                     if constexpr (std::is_same<R, void>::value) {
                         callback(value);
@@ -1896,7 +2432,6 @@ Future<R> Future<std::shared_ptr<T>>::then(std::function<R(std::shared_ptr<T>)>
                 }
             } else {
                 std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before setting exception
                 promise->set_exception(exception);
             }
             delete promise;
@@ -1909,11 +2444,9 @@ Future<R> Future<std::shared_ptr<T>>::then(std::function<R(std::shared_ptr<T>)>
 template<typename T>
 template<typename R>
 Future<std::shared_ptr<R>> Future<std::shared_ptr<T>>::then(std::function<std::shared_ptr<R>(std::shared_ptr<T>)> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(!state->exception.has_value()){
             std::shared_ptr<T> value = state->value;
-            lockState.unlock(); // unlock before callback
             try {
                 return Future<std::shared_ptr<R>>(callback(value));
             } catch(const std::exception &exception) {
@@ -1923,36 +2456,14 @@ Future<std::shared_ptr<R>> Future<std::shared_ptr<T>>::then(std::function<std::s
             return Future<std::shared_ptr<R>>(state->exception.value());
         }
     } else {
-        // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(!state->exception.has_value()){
-                std::shared_ptr<T> value = state->value;
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                try {
-                    return Future<std::shared_ptr<R>>(callback(value));
-                } catch(const std::exception &exception) {
-                    return Future<std::shared_ptr<R>>(exception);
-                }
-            } else {
-                return Future<std::shared_ptr<R>>(state->exception.value());
-            }
-        }
-
         // wait for this ready
         Promise<std::shared_ptr<R>> *promise = new Promise<std::shared_ptr<R>>();
         Future<std::shared_ptr<R>> future = promise->get_future();
-        state->callbacks.push_back([promise, callback](PromiseFutureState<std::shared_ptr<T>> *state){ // this future may be already deleted when invoked
+        promise->state->initUpstream(state); // cancelling the continuation cancels this future
+        state->addCallback([state = this->state, promise, callback]{ // this future may be already deleted when invoked
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(!state->exception.has_value()){
                 std::shared_ptr<T> value = state->value;
-                lockState.unlock(); // unlock before callback
                 try {
                     promise->set_value(callback(value));
                 } catch(const std::exception &exception) {
@@ -1960,7 +2471,6 @@ Future<std::shared_ptr<R>> Future<std::shared_ptr<T>>::then(std::function<std::s
                 }
             } else {
                 std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before setting exception
                 promise->set_exception(exception);
             }
             delete promise;
@@ -1973,11 +2483,9 @@ Future<std::shared_ptr<R>> Future<std::shared_ptr<T>>::then(std::function<std::s
 template<typename T>
 template<typename R>
 Future<R> Future<std::shared_ptr<T>>::thenFuture(std::function<Future<R>(std::shared_ptr<T>)> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(!state->exception.has_value()){
             std::shared_ptr<T> value = state->value;
-            lockState.unlock(); // unlock before callback
             try {
                 return callback(value);
             } catch(const std::exception &exception) {
@@ -1987,38 +2495,17 @@ Future<R> Future<std::shared_ptr<T>>::thenFuture(std::function<Future<R>(std::sh
             return Future<R>(state->exception.value());
         }
     } else {
-        // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(!state->exception.has_value()){
-                std::shared_ptr<T> value = state->value;
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                try {
-                    return callback(value);
-                } catch (const std::exception &exception) {
-                    return Future<R>(exception);
-                }
-            } else {
-                return Future<R>(state->exception.value());
-            }
-        }
-
         // wait for this ready
         Promise<R> *promise = new Promise<R>();
         Future<R> future = promise->get_future();
-        state->callbacks.push_back([promise, callback](PromiseFutureState<std::shared_ptr<T>> *state){ // this future may be already deleted when invoked
+        promise->state->initUpstream(state); // cancelling the continuation cancels this future
+        state->addCallback([state = this->state, promise, callback]{ // this future may be already deleted when invoked
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(!state->exception.has_value()){
                 std::shared_ptr<T> value = state->value;
-                lockState.unlock(); // unlock before callback
                 try {
                     Future<R> future = callback(value);
+                    promise->state->setUpstream(future.state); // and the future returned by the callback
                     if constexpr (std::is_same<R, void>::value) {
                         future.onValue([promise]() -> void {
                             promise->set_value();
@@ -2040,7 +2527,6 @@ Future<R> Future<std::shared_ptr<T>>::thenFuture(std::function<Future<R>(std::sh
                 }
             } else {
                 std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before setting exception
                 promise->set_exception(exception);
                 delete promise;
             }
@@ -2053,11 +2539,9 @@ Future<R> Future<std::shared_ptr<T>>::thenFuture(std::function<Future<R>(std::sh
 template<typename T>
 template<typename R>
 Future<std::shared_ptr<R>> Future<std::shared_ptr<T>>::thenFuture(std::function<Future<std::shared_ptr<R>>(std::shared_ptr<T>)> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(!state->exception.has_value()){
             std::shared_ptr<T> value = state->value;
-            lockState.unlock(); // unlock before callback
             try {
                 return callback(value);
             } catch(const std::exception &exception) {
@@ -2067,38 +2551,17 @@ Future<std::shared_ptr<R>> Future<std::shared_ptr<T>>::thenFuture(std::function<
             return Future<std::shared_ptr<R>>(state->exception.value());
         }
     } else {
-        // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(!state->exception.has_value()){
-                std::shared_ptr<T> value = state->value;
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                try {
-                    return callback(value);
-                } catch(const std::exception &exception) {
-                    return Future<std::shared_ptr<R>>(exception);
-                }
-            } else {
-                return Future<std::shared_ptr<R>>(state->exception.value());
-            }
-        }
-
         // wait for this ready
         Promise<std::shared_ptr<R>> *promise = new Promise<std::shared_ptr<R>>();
         Future<std::shared_ptr<R>> future = promise->get_future();
-        state->callbacks.push_back([promise, callback](PromiseFutureState<std::shared_ptr<T>> *state){ // this future may be already deleted when invoked
+        promise->state->initUpstream(state); // cancelling the continuation cancels this future
+        state->addCallback([state = this->state, promise, callback]{ // this future may be already deleted when invoked
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(!state->exception.has_value()){
                 std::shared_ptr<T> value = state->value;
-                lockState.unlock(); // unlock before callback
                 try {
                     Future<std::shared_ptr<R>> future = callback(value);
+                    promise->state->setUpstream(future.state); // and the future returned by the callback
                     future.onValue([promise](std::shared_ptr<R> value){
                         promise->set_value(value);
                         delete promise;
@@ -2113,7 +2576,6 @@ Future<std::shared_ptr<R>> Future<std::shared_ptr<T>>::thenFuture(std::function<
                 }
             } else {
                 std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before setting exception
                 promise->set_exception(exception);
                 delete promise;
             }
@@ -2126,13 +2588,11 @@ Future<std::shared_ptr<R>> Future<std::shared_ptr<T>>::thenFuture(std::function<
 // callback taking exception and returning shared_ptr<T>
 template<typename T>
 Future<std::shared_ptr<T>> Future<std::shared_ptr<T>>::catchAll(std::function<std::shared_ptr<T>(std::exception)> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(!state->exception.has_value()){
             return Future<std::shared_ptr<T>>(state->value);
         } else {
             std::exception exception = state->exception.value();
-            lockState.unlock(); // unlock before callback
             try {
                 return Future<std::shared_ptr<T>>(callback(exception));
             } catch(const std::exception &exception) {
@@ -2140,40 +2600,17 @@ Future<std::shared_ptr<T>> Future<std::shared_ptr<T>>::catchAll(std::function<st
             }
         }
     } else {
-        // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(!state->exception.has_value()){
-                return Future<std::shared_ptr<T>>(state->value);
-            } else {
-                std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                try {
-                    return Future<std::shared_ptr<T>>(callback(exception));
-                } catch(const std::exception &exception) {
-                    return Future<std::shared_ptr<T>>(exception);
-                }
-            }
-        }
-
         // wait for this ready
         Promise<std::shared_ptr<T>> *promise = new Promise<std::shared_ptr<T>>();
         Future<std::shared_ptr<T>> future = promise->get_future();
-        state->callbacks.push_back([promise, callback](PromiseFutureState<std::shared_ptr<T>> *state){ // this future may be already deleted when invoked
+        promise->state->initUpstream(state); // cancelling the continuation cancels this future
+        state->addCallback([state = this->state, promise, callback]{ // this future may be already deleted when invoked
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(!state->exception.has_value()){
                 std::shared_ptr<T> value = state->value;
-                lockState.unlock(); // unlock before setting value
                 promise->set_value(value);
             } else {
                 std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before callback
                 try {
                     promise->set_value(callback(exception));
                 } catch(const std::exception &exception) {
@@ -2189,13 +2626,11 @@ Future<std::shared_ptr<T>> Future<std::shared_ptr<T>>::catchAll(std::function<st
 // callback taking exception and returning Future<shared_ptr<T>>
 template<typename T>
 Future<std::shared_ptr<T>> Future<std::shared_ptr<T>>::catchAllFuture(std::function<Future<std::shared_ptr<T>>(std::exception)> callback) noexcept(true) {
-    std::unique_lock<std::mutex> lockState(state->mState);
-    if(state->ready){
+    if(state->isReady()){
         if(!state->exception.has_value()){
             return Future<std::shared_ptr<T>>(state->value);
         } else {
             std::exception exception = state->exception.value();
-            lockState.unlock(); // unlock before callback
             try {
                 return callback(exception);
             } catch(const std::exception &exception) {
@@ -2203,43 +2638,21 @@ Future<std::shared_ptr<T>> Future<std::shared_ptr<T>>::catchAllFuture(std::funct
             }
         }
     } else {
-        // wait for this ready
-        lockState.unlock();
-        std::unique_lock<std::mutex> lockCallbacks(state->mCallbacks, std::defer_lock);
-        std::lock(lockState, lockCallbacks); // lock mState and mCallbacks simultaneously
-
-        // edge case where state became ready while waiting for locks
-        if(state->ready){
-            if(!state->exception.has_value()){
-                return Future<std::shared_ptr<T>>(state->value);
-            } else {
-                std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before callback
-                lockCallbacks.unlock(); // unlock before callback
-                try {
-                    return callback(exception);
-                } catch(const std::exception &exception) {
-                    return Future<std::shared_ptr<T>>(exception);
-                }
-            }
-        }
-
         // wait for this ready
         Promise<std::shared_ptr<T>> *promise = new Promise<std::shared_ptr<T>>();
         Future<std::shared_ptr<T>> future = promise->get_future();
-        state->callbacks.push_back([promise, callback](PromiseFutureState<std::shared_ptr<T>> *state){ // this future may be already deleted when invoked
+        promise->state->initUpstream(state); // cancelling the continuation cancels this future
+        state->addCallback([state = this->state, promise, callback]{ // this future may be already deleted when invoked
             // this state ready
-            std::unique_lock<std::mutex> lockState(state->mState);
             if(!state->exception.has_value()){
                 std::shared_ptr<T> value = state->value;
-                lockState.unlock(); // unlock before setting value
                 promise->set_value(value);
                 delete promise;
             } else {
                 std::exception exception = state->exception.value();
-                lockState.unlock(); // unlock before callback
                 try {
                     Future<std::shared_ptr<T>> future = callback(exception);
+                    promise->state->setUpstream(future.state); // and the future returned by the callback
                     future.onValue([promise](std::shared_ptr<T> value){
                         promise->set_value(value);
                         delete promise;
@@ -2258,5 +2671,479 @@ Future<std::shared_ptr<T>> Future<std::shared_ptr<T>>::catchAllFuture(std::funct
     }
 }
 
+
+// callbacks executed on executor
+template<typename T>
+template<typename E> requires Executor<E>
+void Future<std::shared_ptr<T>>::onValue(E &executor, std::function<void(std::shared_ptr<T>)> callback) noexcept(true) {
+    state->addCallback([state = this->state, &executor, callback]{ // executed immediately if already ready
+        if(!state->exception.has_value()){
+            executeOn(executor, Task([callback](std::shared_ptr<T> &value){ callback(value); }, state->value));
+        }
+    });
+}
+
+template<typename T>
+template<typename E> requires Executor<E>
+void Future<std::shared_ptr<T>>::onException(E &executor, std::function<void(std::exception)> callback) noexcept(true) {
+    state->addCallback([state = this->state, &executor, callback]{ // executed immediately if already ready
+        if(state->exception.has_value()){
+            executeOn(executor, Task([callback](std::exception &exception){ callback(exception); }, state->exception.value()));
+        }
+    });
+}
+
+template<typename T>
+template<typename R, typename E> requires Executor<E>
+Future<R> Future<std::shared_ptr<T>>::then(E &executor, std::function<R(std::shared_ptr<T>)> callback) noexcept(true) {
+    Promise<R> *promise = new Promise<R>();
+    Future<R> future = promise->get_future();
+    promise->state->initUpstream(state); // cancelling the continuation cancels this future
+    state->addCallback([state = this->state, &executor, promise, callback]{ // executed immediately if already ready
+        if(!state->exception.has_value()){
+            executeOn(executor, Task([promise, callback](std::shared_ptr<T> &value){
+                if(promise->isCancelled()){ // continuation no longer wanted
+                    delete promise;
+                    return;
+                }
+                try {
+                    if constexpr (std::is_same<R, void>::value) {
+                        callback(value);
+                        promise->set_value();
+                    } else {
+                        promise->set_value(callback(value));
+                    }
+                } catch(const std::exception &exception) {
+                    promise->set_exception(exception);
+                }
+                delete promise;
+            }, state->value));
+        } else {
+            promise->set_exception(state->exception.value());
+            delete promise;
+        }
+    });
+    return future;
+}
+
+template<typename T>
+template<typename Fn>
+void Future<std::shared_ptr<T>>::onResult(Fn&& callback) const noexcept(true) {
+    state->addCallback([state = this->state, callback = std::forward<Fn>(callback)]() mutable { // executed immediately if already ready
+        Future<std::shared_ptr<T>> future(state);
+        callback(future);
+    });
+}
+
+
+template<typename Rep, typename Period>
+bool Future<void>::wait_for(const std::chrono::duration<Rep, Period> &timeout) {
+    return state->waitReadyUntil(std::chrono::steady_clock::now() + timeout);
+}
+
+template<typename Clock, typename Duration>
+bool Future<void>::wait_until(const std::chrono::time_point<Clock, Duration> &deadline) {
+    return state->waitReadyUntil(deadline);
+}
+
+// callbacks executed on executor
+template<typename E> requires Executor<E>
+void Future<void>::onValue(E &executor, std::function<void()> callback) noexcept(true) {
+    state->addCallback([state = this->state, &executor, callback]{ // executed immediately if already ready
+        if(!state->exception.has_value()){
+            executeOn(executor, Task(callback));
+        }
+    });
+}
+
+template<typename E> requires Executor<E>
+void Future<void>::onException(E &executor, std::function<void(std::exception)> callback) noexcept(true) {
+    state->addCallback([state = this->state, &executor, callback]{ // executed immediately if already ready
+        if(state->exception.has_value()){
+            executeOn(executor, Task([callback](std::exception &exception){ callback(exception); }, state->exception.value()));
+        }
+    });
+}
+
+template<typename R, typename E> requires Executor<E>
+Future<R> Future<void>::then(E &executor, std::function<R()> callback) noexcept(true) {
+    Promise<R> *promise = new Promise<R>();
+    Future<R> future = promise->get_future();
+    promise->state->initUpstream(state); // cancelling the continuation cancels this future
+    state->addCallback([state = this->state, &executor, promise, callback]{ // executed immediately if already ready
+        if(!state->exception.has_value()){
+            executeOn(executor, Task([promise, callback]{
+                if(promise->isCancelled()){ // continuation no longer wanted
+                    delete promise;
+                    return;
+                }
+                try {
+                    if constexpr (std::is_same<R, void>::value) {
+                        callback();
+                        promise->set_value();
+                    } else {
+                        promise->set_value(callback());
+                    }
+                } catch(const std::exception &exception) {
+                    promise->set_exception(exception);
+                }
+                delete promise;
+            }));
+        } else {
+            promise->set_exception(state->exception.value());
+            delete promise;
+        }
+    });
+    return future;
+}
+
+template<typename Fn>
+void Future<void>::onResult(Fn&& callback) const noexcept(true) {
+    state->addCallback([state = this->state, callback = std::forward<Fn>(callback)]() mutable { // executed immediately if already ready
+        Future<void> future(state);
+        callback(future);
+    });
+}
+
+
+
+// ---------------------------------------------------------------------
+// ----- [ COMBINATORS ] -----------------------------------------------
+// ---------------------------------------------------------------------
+
+
+/** Result of whenAll() for futures of type T. */
+template<typename T>
+using WhenAllResult = std::conditional_t<std::is_void_v<T>, void, std::vector<T>>;
+
+/** Result of whenAny() for futures of type T (index of the first future and its value). */
+template<typename T>
+using WhenAnyResult = std::conditional_t<std::is_void_v<T>, size_t, std::pair<size_t, T>>;
+
+/** Result of collectN() for futures of type T (indices of the futures and their values in completion order). */
+template<typename T>
+using CollectNResult = std::conditional_t<std::is_void_v<T>, std::vector<size_t>, std::vector<std::pair<size_t, T>>>;
+
+
+/**
+ * Single state shared by all futures passed to a combinator.
+ * Every future decrements remaining exactly once, the last one deletes the state.
+ * Whoever sets settled first fulfills the promise.
+ * 
+ * @tparam R Type of the combined future.
+ * @tparam Slot Type of the stored results.
+ */
+template<typename R, typename Slot>
+struct FutureAggregateState {
+    Promise<R> promise;
+    std::atomic<size_t> remaining; // futures whose callback has not run yet
+    std::atomic<size_t> collected{0}; // results claimed (collectN)
+    std::atomic<size_t> written{0}; // results written (collectN)
+    std::atomic<bool> settled{false};
+    std::vector<Slot> slots;
+
+    FutureAggregateState(size_t count, size_t slotCount) : remaining(count), slots(slotCount) {}
+
+    /** Returns true for exactly one caller that is then allowed to fulfill the promise. */
+    inline bool settle() noexcept {
+        return !this->settled.load(std::memory_order_relaxed) && !this->settled.exchange(true, std::memory_order_acq_rel);
+    }
+
+    /** Returns true if the calling future was the last one (state must then be deleted). */
+    inline bool arrive() noexcept {
+        return this->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+};
+
+
+/**
+ * Returns a future that will be set to the values of all given futures (in the same order)
+ * as soon as all of them have a value. Fails with the first exception of any future.
+ * Only allocates a single shared state no matter how many futures are passed.
+ * 
+ * @tparam T Type of the futures.
+ * @param futures Futures to wait for.
+ * @return Future<WhenAllResult<T>> Future set to all values (Future<void> if T is void).
+ */
+template<typename T>
+Future<WhenAllResult<T>> whenAll(const std::vector<Future<T>> &futures){
+    typedef WhenAllResult<T> R;
+    if(futures.empty()){
+        if constexpr (std::is_void_v<T>) return Future<void>();
+        else return Future<R>(R());
+    }
+    typedef std::conditional_t<std::is_void_v<T>, bool, std::optional<T>> Slot;
+    typedef FutureAggregateState<R, Slot> Aggregate;
+    Aggregate *aggregate = new Aggregate(futures.size(), std::is_void_v<T> ? 0 : futures.size());
+    Future<R> result = aggregate->promise.get_future();
+    for(size_t i=0; i < futures.size(); i++){
+        futures[i].onResult([aggregate, i](Future<T> &future){
+            if(future.has_value()){
+                if constexpr (!std::is_void_v<T>) aggregate->slots[i] = future.get_value();
+            } else if(aggregate->settle()){
+                aggregate->promise.set_exception(future.get_exception());
+            }
+            if(aggregate->arrive()){
+                if(aggregate->settle()){ // all futures have a value
+                    if constexpr (std::is_void_v<T>){
+                        aggregate->promise.set_value();
+                    } else {
+                        R values;
+                        values.reserve(aggregate->slots.size());
+                        for(Slot &slot : aggregate->slots) values.push_back(std::move(slot.value()));
+                        aggregate->promise.set_value(std::move(values));
+                    }
+                }
+                delete aggregate;
+            }
+        });
+    }
+    return result;
+}
+
+/**
+ * Returns a future that will be set to the values of all given futures as soon as all
+ * of them have a value. Fails with the first exception of any future.
+ * Only allocates a single shared state no matter how many futures are passed.
+ * 
+ * @tparam Ts Types of the futures (void not allowed).
+ * @param futures Futures to wait for.
+ * @return Future<std::tuple<Ts...>> Future set to all values.
+ */
+template<typename... Ts> requires (sizeof...(Ts) > 0 && (!std::is_void_v<Ts> && ...))
+Future<std::tuple<Ts...>> whenAll(Future<Ts>... futures){
+    typedef std::tuple<Ts...> R;
+    struct Aggregate : FutureAggregateState<R, bool> {
+        std::tuple<std::optional<Ts>...> values;
+        Aggregate() : FutureAggregateState<R, bool>(sizeof...(Ts), 0) {}
+    };
+    Aggregate *aggregate = new Aggregate();
+    Future<R> result = aggregate->promise.get_future();
+    auto registerFuture = [aggregate]<size_t I, typename T>(Future<T> &future){
+        future.onResult([aggregate](Future<T> &future){
+            if(future.has_value()){
+                std::get<I>(aggregate->values) = future.get_value();
+            } else if(aggregate->settle()){
+                aggregate->promise.set_exception(future.get_exception());
+            }
+            if(aggregate->arrive()){
+                if(aggregate->settle()){ // all futures have a value
+                    aggregate->promise.set_value(std::apply([](std::optional<Ts>&... values){
+                        return R(std::move(values.value())...);
+                    }, aggregate->values));
+                }
+                delete aggregate;
+            }
+        });
+    };
+    [&]<size_t... I>(std::index_sequence<I...>){
+        (registerFuture.template operator()<I, Ts>(futures), ...);
+    }(std::index_sequence_for<Ts...>{});
+    return result;
+}
+
+/**
+ * Returns a future that will be set to the result of the first given future that is ready.
+ * If that future has an exception the returned future fails with it.
+ * Only allocates a single shared state no matter how many futures are passed.
+ * 
+ * @tparam T Type of the futures.
+ * @param futures Futures to wait for (must not be empty).
+ * @return Future<WhenAnyResult<T>> Future set to index and value of first ready future (only index if T is void).
+ */
+template<typename T>
+Future<WhenAnyResult<T>> whenAny(const std::vector<Future<T>> &futures){
+    typedef WhenAnyResult<T> R;
+    if(futures.empty()) return Future<R>(std::runtime_error("whenAny() requires at least one future"));
+    typedef FutureAggregateState<R, bool> Aggregate;
+    Aggregate *aggregate = new Aggregate(futures.size(), 0);
+    Future<R> result = aggregate->promise.get_future();
+    for(size_t i=0; i < futures.size(); i++){
+        futures[i].onResult([aggregate, i](Future<T> &future){
+            if(aggregate->settle()){
+                if(!future.has_value()){
+                    aggregate->promise.set_exception(future.get_exception());
+                } else if constexpr (std::is_void_v<T>){
+                    aggregate->promise.set_value(i);
+                } else {
+                    aggregate->promise.set_value(R(i, future.get_value()));
+                }
+            }
+            if(aggregate->arrive()) delete aggregate;
+        });
+    }
+    return result;
+}
+
+/**
+ * Returns a future that will be set to the first n values of the given futures (in completion order).
+ * Fails with the first exception that occurs before n values are available.
+ * Only allocates a single shared state no matter how many futures are passed.
+ * 
+ * @tparam T Type of the futures.
+ * @param futures Futures to wait for.
+ * @param n Amount of values to collect (must not be greater than amount of futures).
+ * @return Future<CollectNResult<T>> Future set to indices and values of the first n futures with a value.
+ */
+template<typename T>
+Future<CollectNResult<T>> collectN(const std::vector<Future<T>> &futures, size_t n){
+    typedef CollectNResult<T> R;
+    typedef typename R::value_type Slot;
+    if(n > futures.size()) return Future<R>(std::runtime_error("collectN() cannot collect more values than futures given"));
+    if(n == 0) return Future<R>(R());
+    typedef FutureAggregateState<R, Slot> Aggregate;
+    Aggregate *aggregate = new Aggregate(futures.size(), n);
+    Future<R> result = aggregate->promise.get_future();
+    for(size_t i=0; i < futures.size(); i++){
+        futures[i].onResult([aggregate, i, n](Future<T> &future){
+            if(future.has_value()){
+                const size_t index = aggregate->collected.fetch_add(1, std::memory_order_relaxed);
+                if(index < n){
+                    if constexpr (std::is_void_v<T>) aggregate->slots[index] = i;
+                    else aggregate->slots[index] = Slot(i, future.get_value());
+                    if(aggregate->written.fetch_add(1, std::memory_order_acq_rel) + 1 == n && aggregate->settle())
+                        aggregate->promise.set_value(std::move(aggregate->slots));
+                }
+            } else if(aggregate->settle()){
+                aggregate->promise.set_exception(future.get_exception());
+            }
+            if(aggregate->arrive()) delete aggregate;
+        });
+    }
+    return result;
+}
+
+/**
+ * Cancels the given future if it has no result once the timeout elapsed: it then fails with an exception,
+ * its producer is told through Promise::onCancel() and futures it was derived from get cancelled too.
+ * The timeout is scheduled on TimerWheel::getShared() (no thread per call) and cancelled as soon as
+ * the future has a result, cancellation callbacks and continuations then run on the thread of the wheel.
+ * 
+ * @tparam T Type of the future.
+ * @param future Future that should be ready within the timeout.
+ * @param timeout Time after which the future gets cancelled.
+ * @return Future<T> The given future.
+ */
+template<typename T>
+Future<T> withTimeout(const Future<T> &future, std::chrono::nanoseconds timeout){
+    if(future.is_ready()) return future;
+    std::shared_ptr<Cancellable> timer = TimerWheel::getShared().schedule(timeout, [token = future.get_cancellation_token()]() mutable {
+        token.cancel("Future timed out");
+    });
+    future.onResult([timer](const Future<T>&){ timer->cancel(); });
+    return future;
+}
+
+
+
+// ---------------------------------------------------------------------
+// ----- [ COROUTINES ] ------------------------------------------------
+// ---------------------------------------------------------------------
+
+
+/**
+ * Awaiter returned by co_await on a Future.
+ * If the future is not ready yet the coroutine gets suspended and is resumed
+ * directly by the thread that fulfills the future (no std::function, no additional state).
+ * 
+ * @tparam T Type of the awaited future.
+ */
+template<typename T>
+class FutureAwaiter {
+protected:
+    Future<T> future;
+
+public:
+    FutureAwaiter(Future<T> future) : future(std::move(future)) {}
+
+    bool await_ready() const {
+        return this->future.is_ready();
+    }
+
+    /**
+     * Suspends the coroutine until the future is ready.
+     * @return false if the future got ready in the meantime (coroutine continues on the calling thread
+     *          instead of being resumed from within the callback registration, which still accesses the state).
+     */
+    bool await_suspend(std::coroutine_handle<> handle) const {
+        return this->future.state->tryAddCallback([handle]{ handle.resume(); });
+    }
+
+    /**
+     * Returns the value of the future.
+     * @throws Throws the exception of the future if it has no value.
+     */
+    decltype(auto) await_resume(){
+        return this->future.get_value();
+    }
+};
+
+template<typename T>
+FutureAwaiter<T> operator co_await(Future<T> future){
+    return FutureAwaiter<T>(std::move(future));
+}
+
+
+/**
+ * Parts of the coroutine promise shared by all future types.
+ * Coroutines start eagerly and their frame gets destroyed as soon as they return.
+ * 
+ * @tparam T Type of the future returned by the coroutine.
+ */
+template<typename T>
+class FutureCoroutinePromiseBase {
+protected:
+    Promise<T> promise;
+
+public:
+
+    Future<T> get_return_object(){
+        return this->promise.get_future();
+    }
+
+    std::suspend_never initial_suspend() const noexcept {
+        return {};
+    }
+
+    std::suspend_never final_suspend() const noexcept {
+        return {};
+    }
+
+    void unhandled_exception(){
+        try {
+            throw;
+        } catch(const std::exception &exception){
+            this->promise.set_exception(exception);
+        } catch(...){
+            this->promise.set_exception(std::runtime_error("Unknown exception thrown in coroutine"));
+        }
+    }
+};
+
+/**
+ * Coroutine promise that allows a coroutine to return Future<T>:
+ * co_return sets the value, an escaping exception sets the exception of the future.
+ * 
+ * @tparam T Type of the future returned by the coroutine.
+ */
+template<typename T>
+class FutureCoroutinePromise : public FutureCoroutinePromiseBase<T> {
+public:
+    void return_value(T value){
+        this->promise.set_value(std::move(value));
+    }
+};
+
+/**
+ * Coroutine promise that allows a coroutine to return Future<void>.
+ */
+template<>
+class FutureCoroutinePromise<void> : public FutureCoroutinePromiseBase<void> {
+public:
+    void return_void(){
+        this->promise.set_value();
+    }
+};
+
 }
 #endif // SPI_FUTURE_HPP
@@ -0,0 +1,247 @@
+/**
+ * Per-thread pool that recycles the memory of promise/future states.
+ *
+ * @file FutureStatePool.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+
+#ifndef SPI_FUTURE_STATE_POOL_HPP
+#define SPI_FUTURE_STATE_POOL_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+
+/** Set to 0 to allocate promise/future states with plain new/delete. */
+#ifndef SPI_FUTURE_STATE_POOL
+#define SPI_FUTURE_STATE_POOL 1
+#endif
+
+/** Maximum amount of free blocks a thread keeps per size class before returning memory to the system. */
+#ifndef SPI_FUTURE_STATE_POOL_SIZE
+#define SPI_FUTURE_STATE_POOL_SIZE 1024
+#endif
+
+namespace spi {
+
+
+
+/**
+ * Pool of memory blocks grouped by size classes of SIZE_CLASS bytes.
+ *
+ * Every thread owns its own pool (see local()). Allocations and releases done by the
+ * owning thread only touch thread-local free lists. A block released by another thread
+ * gets pushed onto a lock-free stack of the owning pool and is moved into the owner's
+ * free lists the next time the owner runs out of blocks. Therefore a state allocated by
+ * a producer and destroyed by a consumer still gets reused by the producer.
+ *
+ * If the owning thread exits, its cached blocks are freed and blocks that are
+ * still in use get freed by whichever thread releases them last.
+ * Blocks bigger than MAX_SIZE bypass the pool.
+ */
+class FutureStatePool {
+public:
+    static constexpr size_t SIZE_CLASS = 64;
+    static constexpr size_t SIZE_CLASSES = 8;
+    static constexpr size_t MAX_SIZE = SIZE_CLASS * SIZE_CLASSES;
+
+protected:
+
+    struct alignas(std::max_align_t) Block {
+        FutureStatePool* owner; // nullptr if not pooled
+        Block* next;
+        uint32_t sizeClass;
+    };
+
+    Block* available[SIZE_CLASSES] = {}; // only touched by owner
+    size_t availableCount[SIZE_CLASSES] = {};
+    std::atomic<Block*> remote{nullptr}; // blocks released by other threads (closed() once owner exited)
+    std::atomic<size_t> refs{1}; // blocks allocated from system + 1 for owning thread
+
+    FutureStatePool() = default;
+    FutureStatePool(const FutureStatePool&) = delete;
+    FutureStatePool& operator=(const FutureStatePool&) = delete;
+
+    /** Marker for a remote stack whose owner has exited. */
+    static Block* closed() noexcept {
+        static Block marker{};
+        return &marker;
+    }
+
+    /** Owning thread exits: free cached blocks and stop accepting remote blocks. */
+    struct Holder {
+        FutureStatePool* pool = nullptr;
+        ~Holder(){
+            current() = nullptr;
+            exited() = true;
+            if(pool != nullptr) pool->close();
+        }
+    };
+
+    static FutureStatePool*& current() noexcept {
+        static thread_local FutureStatePool* pool = nullptr; // trivially destructible, stays valid during thread exit
+        return pool;
+    }
+
+    static bool& exited() noexcept {
+        static thread_local bool flag = false;
+        return flag;
+    }
+
+    static inline Block* blockOf(void* ptr) noexcept {
+        return reinterpret_cast<Block*>(static_cast<unsigned char*>(ptr) - sizeof(Block));
+    }
+
+    static inline void* dataOf(Block* block) noexcept {
+        return reinterpret_cast<unsigned char*>(block) + sizeof(Block);
+    }
+
+    static inline Block* allocateBlock(FutureStatePool* owner, uint32_t sizeClass){
+        Block* block = static_cast<Block*>(::operator new(sizeof(Block) + (size_t)(sizeClass + 1) * SIZE_CLASS));
+        block->owner = owner;
+        block->next = nullptr;
+        block->sizeClass = sizeClass;
+        return block;
+    }
+
+    inline void freeBlock(Block* block) noexcept {
+        ::operator delete(block);
+        if(this->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+    }
+
+    /** Moves blocks released by other threads into the local free lists. */
+    void drainRemote() noexcept {
+        Block* block = this->remote.exchange(nullptr, std::memory_order_acquire);
+        while(block != nullptr){
+            Block* next = block->next;
+            this->releaseLocal(block);
+            block = next;
+        }
+    }
+
+    inline void releaseLocal(Block* block) noexcept {
+        const uint32_t c = block->sizeClass;
+        if(this->availableCount[c] >= SPI_FUTURE_STATE_POOL_SIZE){
+            this->freeBlock(block);
+            return;
+        }
+        block->next = this->available[c];
+        this->available[c] = block;
+        this->availableCount[c]++;
+    }
+
+    void releaseRemote(Block* block) noexcept {
+        Block* head = this->remote.load(std::memory_order_relaxed);
+        do {
+            if(head == closed()){ // owner has exited
+                this->freeBlock(block);
+                return;
+            }
+            block->next = head;
+        } while(!this->remote.compare_exchange_weak(head, block, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    void close() noexcept {
+        size_t freed = 1; // reference of owning thread
+        for(size_t c=0; c < SIZE_CLASSES; c++){
+            Block* block = this->available[c];
+            while(block != nullptr){
+                Block* next = block->next;
+                ::operator delete(block);
+                freed++;
+                block = next;
+            }
+            this->available[c] = nullptr;
+            this->availableCount[c] = 0;
+        }
+        Block* block = this->remote.exchange(closed(), std::memory_order_acquire);
+        while(block != nullptr){
+            Block* next = block->next;
+            ::operator delete(block);
+            freed++;
+            block = next;
+        }
+        if(this->refs.fetch_sub(freed, std::memory_order_acq_rel) == freed) delete this;
+    }
+
+public:
+
+    /**
+     * Returns the pool of the calling thread or nullptr if the thread is exiting.
+     */
+    static FutureStatePool* local() noexcept {
+        FutureStatePool* pool = current();
+        if(pool != nullptr || exited()) return pool;
+        static thread_local Holder holder;
+        holder.pool = pool = new FutureStatePool();
+        current() = pool;
+        return pool;
+    }
+
+    /**
+     * Allocates memory for an object of the given size.
+     * Reuses a block of the calling thread's pool if available.
+     *
+     * @param size Amount of bytes needed.
+     * @return void* Pointer to the allocated memory.
+     */
+    static void* allocate(size_t size){
+        if(size == 0) size = 1;
+        const uint32_t c = (uint32_t)((size - 1) / SIZE_CLASS);
+        FutureStatePool* pool = size <= MAX_SIZE ? local() : nullptr;
+        if(pool == nullptr) return dataOf(allocateBlock(nullptr, c)); // too big or thread exiting
+
+        if(pool->available[c] == nullptr) pool->drainRemote();
+        Block* block = pool->available[c];
+        if(block != nullptr){
+            pool->available[c] = block->next;
+            pool->availableCount[c]--;
+            return dataOf(block);
+        }
+        block = allocateBlock(pool, c);
+        pool->refs.fetch_add(1, std::memory_order_relaxed);
+        return dataOf(block);
+    }
+
+    /**
+     * Releases memory returned by allocate().
+     * Memory goes back to the pool of the thread that allocated it.
+     *
+     * @param ptr Pointer returned by allocate().
+     */
+    static void release(void* ptr) noexcept {
+        if(ptr == nullptr) return;
+        Block* block = blockOf(ptr);
+        FutureStatePool* owner = block->owner;
+        if(owner == nullptr){
+            ::operator delete(block);
+        } else if(owner == current()){
+            owner->releaseLocal(block);
+        } else {
+            owner->releaseRemote(block);
+        }
+    }
+
+    /**
+     * Returns amount of blocks currently cached by the calling thread.
+     */
+    static size_t cached() noexcept {
+        FutureStatePool* pool = current();
+        if(pool == nullptr) return 0;
+        size_t count = 0;
+        for(size_t c=0; c < SIZE_CLASSES; c++) count += pool->availableCount[c];
+        return count;
+    }
+
+    static std::string toString(){
+        return "FutureStatePool(cached="+std::to_string(cached())+")";
+    }
+};
+
+
+
+}
+
+#endif // SPI_FUTURE_STATE_POOL_HPP
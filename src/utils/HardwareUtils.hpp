@@ -1,24 +1,29 @@
 /**
  * HardwareUtils allows fetching hardware capabilities.
  * 
- * @file HardwareUtils.cpp
+ * @file HardwareUtils.hpp
  * @author Luca Vogels (github@luca-vogels.com)
  */
 
 #ifndef SPI_HARDWARE_UTILS_HPP
 #define SPI_HARDWARE_UTILS_HPP
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdio>
 #include <fstream>
 #include <ifaddrs.h>
 #include <mutex>
+#include <new>
 #include <sched.h>
 #include <sstream>
+#include <string>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/syscall.h>
 #include <sys/sysinfo.h>
 #include <thread>
+#include <utility>
 #include <unistd.h>
 #include <unordered_map>
 #include <vector>
@@ -33,10 +38,320 @@ namespace spi {
 
 typedef pid_t ThreadID;
 
+/**
+ * Size of a cache line in bytes.
+ * Used to align data that is written by different threads so it does not share a cache line (false sharing).
+ * Defaults to std::hardware_destructive_interference_size, can be overridden by defining SPI_CACHE_LINE_SIZE
+ * (e.g. 128 for CPUs that prefetch pairs of cache lines, 8 to compare against an unpadded layout).
+ */
+#if defined(SPI_CACHE_LINE_SIZE)
+constexpr size_t CACHE_LINE_SIZE = SPI_CACHE_LINE_SIZE;
+#elif defined(__cpp_lib_hardware_interference_size)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winterference-size" // value may differ between compilers but is consistent within this build
+constexpr size_t CACHE_LINE_SIZE = std::hardware_destructive_interference_size;
+#pragma GCC diagnostic pop
+#else
+constexpr size_t CACHE_LINE_SIZE = 64;
+#endif
+
+
+/**
+ * Wraps a value so it occupies its own cache line(s) and
+ * cannot suffer from false sharing with neighbouring data (e.g. elements of an array written by different threads).
+ */
+template<typename T>
+struct alignas(CACHE_LINE_SIZE) CacheAligned {
+    T value;
+
+    template<typename... Args>
+    CacheAligned(Args&&... args) : value(std::forward<Args>(args)...) {}
+
+    inline T& get() noexcept { return value; }
+    inline const T& get() const noexcept { return value; }
+    inline T* operator->() noexcept { return &value; }
+    inline const T* operator->() const noexcept { return &value; }
+    inline T& operator*() noexcept { return value; }
+    inline const T& operator*() const noexcept { return value; }
+};
+
+
+/**
+ * Cache of a CPU as reported by /sys/devices/system/cpu/cpuX/cache.
+ */
+struct CpuCache {
+    uint8_t level = 0;          // 1 = L1, 2 = L2, ...
+    char type = 'U';            // 'D' data, 'I' instruction, 'U' unified
+    size_t size = 0;            // in bytes
+    size_t lineSize = 0;        // in bytes
+    size_t domain = 0;          // lowest CPU sharing this cache (identifies the cache)
+    std::vector<size_t> sharedCpus;
+};
+
+
+/**
+ * Placement of a single CPU within the machine.
+ * Domains are identified by the lowest CPU they contain (-1 if unknown).
+ */
+struct CpuPlacement {
+    size_t cpu = 0;
+    int package = -1;       // physical socket
+    int numaNode = -1;
+    int l3Domain = -1;      // lowest CPU sharing the last level cache
+    int l2Domain = -1;      // lowest CPU sharing the L2 cache
+    int core = -1;          // lowest CPU of the physical core (SMT siblings share it)
+    std::vector<size_t> smtSiblings; // CPUs of the same physical core (including this CPU)
+    std::vector<CpuCache> caches;
+};
+
+
+/**
+ * Topology of the online CPUs (packages, NUMA nodes, cache domains, cores and SMT siblings)
+ * read once from /sys. Get the cached instance via CpuTopology::get() or HardwareUtils::getTopology().
+ * If /sys is not available every CPU is treated as its own core within a single package and L3 domain.
+ */
+class CpuTopology {
+protected:
+    std::vector<CpuPlacement> placements; // sorted by CPU
+    std::vector<int> indexOfCpu;          // CPU -> index into placements or -1 if offline
+
+    static std::string readLine(const std::string &path){
+        std::ifstream file(path);
+        std::string line;
+        if(file.is_open()) std::getline(file, line);
+        return line;
+    }
+
+    static int readInt(const std::string &path, int fallback = -1){
+        const std::string line = readLine(path);
+        if(line.empty()) return fallback;
+        try { return std::stoi(line); } catch(...) { return fallback; }
+    }
+
+    /** Parses sizes like "48K", "2048K" or "1M" into bytes. */
+    static size_t parseSize(const std::string &text){
+        if(text.empty()) return 0;
+        size_t value = 0;
+        size_t i = 0;
+        for(; i < text.size() && text[i] >= '0' && text[i] <= '9'; i++) value = value * 10 + (size_t)(text[i] - '0');
+        if(i < text.size()){
+            if(text[i] == 'K') value <<= 10;
+            else if(text[i] == 'M') value <<= 20;
+            else if(text[i] == 'G') value <<= 30;
+        }
+        return value;
+    }
+
+    CpuTopology(){
+        std::vector<size_t> online = parseCpuList(readLine("/sys/devices/system/cpu/online"));
+        if(online.empty()){
+            for(int cpu=0; cpu < std::max(1, (int)std::thread::hardware_concurrency()); cpu++) online.push_back((size_t)cpu);
+        }
+
+        std::vector<int> numaOfCpu;
+        for(int node=0; node < 1024; node++){
+            const std::string list = readLine("/sys/devices/system/node/node"+std::to_string(node)+"/cpulist");
+            for(size_t cpu : parseCpuList(list)){
+                if(cpu >= numaOfCpu.size()) numaOfCpu.resize(cpu + 1, -1);
+                numaOfCpu[cpu] = node;
+            }
+        }
+
+        for(size_t cpu : online){
+            const std::string base = "/sys/devices/system/cpu/cpu"+std::to_string(cpu);
+            CpuPlacement placement;
+            placement.cpu = cpu;
+            placement.package = readInt(base+"/topology/physical_package_id", 0);
+            placement.numaNode = cpu < numaOfCpu.size() ? numaOfCpu[cpu] : -1;
+            placement.smtSiblings = parseCpuList(readLine(base+"/topology/thread_siblings_list"));
+            if(placement.smtSiblings.empty()) placement.smtSiblings.push_back(cpu);
+            placement.core = (int)placement.smtSiblings.front();
+
+            for(int index=0; index < 16; index++){
+                const std::string cacheBase = base+"/cache/index"+std::to_string(index);
+                const int level = readInt(cacheBase+"/level");
+                if(level < 0) break;
+                CpuCache cache;
+                cache.level = (uint8_t)level;
+                const std::string type = readLine(cacheBase+"/type");
+                cache.type = type == "Data" ? 'D' : (type == "Instruction" ? 'I' : 'U');
+                cache.size = parseSize(readLine(cacheBase+"/size"));
+                cache.lineSize = (size_t)std::max(0, readInt(cacheBase+"/coherency_line_size", 0));
+                cache.sharedCpus = parseCpuList(readLine(cacheBase+"/shared_cpu_list"));
+                if(cache.sharedCpus.empty()) cache.sharedCpus.push_back(cpu);
+                cache.domain = cache.sharedCpus.front();
+                if(cache.level == 2 && cache.type != 'I') placement.l2Domain = (int)cache.domain;
+                if(cache.level == 3 && cache.type != 'I') placement.l3Domain = (int)cache.domain;
+                placement.caches.push_back(std::move(cache));
+            }
+            if(placement.l2Domain < 0) placement.l2Domain = placement.core;
+            if(placement.l3Domain < 0) placement.l3Domain = placement.caches.empty() ? 0 : placement.l2Domain;
+
+            if(cpu >= indexOfCpu.size()) indexOfCpu.resize(cpu + 1, -1);
+            indexOfCpu[cpu] = (int)placements.size();
+            placements.push_back(std::move(placement));
+        }
+    }
+
+    /** Returns the CPUs whose placement has the same value as the given CPU for the given member. */
+    std::vector<size_t> cpusWithSame(size_t cpu, int CpuPlacement::*member) const {
+        std::vector<size_t> result;
+        const CpuPlacement* self = this->placement(cpu);
+        if(self == nullptr) return result;
+        for(const CpuPlacement &other : placements)
+            if(other.*member == self->*member) result.push_back(other.cpu);
+        return result;
+    }
+
+public:
+
+    /**
+     * Returns the cached topology of this machine.
+     */
+    static const CpuTopology& get(){
+        static const CpuTopology instance;
+        return instance;
+    }
+
+    /**
+     * Parses a CPU list as used by /sys (e.g. "0-3,8,10-11").
+     */
+    static std::vector<size_t> parseCpuList(const std::string &list){
+        std::vector<size_t> cpus;
+        std::stringstream stream(list);
+        std::string range;
+        while(std::getline(stream, range, ',')){
+            if(range.empty()) continue;
+            try {
+                const size_t dash = range.find('-');
+                const size_t first = (size_t)std::stoul(range.substr(0, dash));
+                const size_t last = dash == std::string::npos ? first : (size_t)std::stoul(range.substr(dash + 1));
+                for(size_t cpu=first; cpu <= last; cpu++) cpus.push_back(cpu);
+            } catch(...) {
+                return std::vector<size_t>();
+            }
+        }
+        return cpus;
+    }
+
+    /** Returns the placements of all online CPUs (sorted by CPU). */
+    inline const std::vector<CpuPlacement>& getCpus() const noexcept {
+        return placements;
+    }
+
+    /** Returns the placement of a CPU or nullptr if the CPU is not online. */
+    inline const CpuPlacement* placement(size_t cpu) const noexcept {
+        return cpu < indexOfCpu.size() && indexOfCpu[cpu] >= 0 ? &placements[(size_t)indexOfCpu[cpu]] : nullptr;
+    }
+
+    /**
+     * Returns the data (or unified) cache of the given level of a CPU.
+     *
+     * @return const CpuCache* Cache or nullptr if unknown.
+     */
+    const CpuCache* getCache(size_t cpu, uint8_t level) const noexcept {
+        const CpuPlacement* p = this->placement(cpu);
+        if(p == nullptr) return nullptr;
+        for(const CpuCache &cache : p->caches)
+            if(cache.level == level && cache.type != 'I') return &cache;
+        return nullptr;
+    }
+
+    /** Returns the CPUs of the same physical core (including the given CPU). */
+    std::vector<size_t> getSmtSiblings(size_t cpu) const {
+        const CpuPlacement* p = this->placement(cpu);
+        return p != nullptr ? p->smtSiblings : std::vector<size_t>();
+    }
+
+    /** Returns the CPUs sharing the L2 cache with the given CPU (including the given CPU). */
+    std::vector<size_t> getCpusSharingL2(size_t cpu) const {
+        return cpusWithSame(cpu, &CpuPlacement::l2Domain);
+    }
+
+    /** Returns the CPUs sharing the L3 cache with the given CPU (including the given CPU). */
+    std::vector<size_t> getCpusSharingL3(size_t cpu) const {
+        return cpusWithSame(cpu, &CpuPlacement::l3Domain);
+    }
+
+    /** Returns the CPUs of the same physical package (including the given CPU). */
+    std::vector<size_t> getCpusOfPackage(size_t cpu) const {
+        return cpusWithSame(cpu, &CpuPlacement::package);
+    }
+
+    /**
+     * Picks another CPU that shares the L3 cache with the given CPU
+     * e.g. to place the consumer of a two-party queue next to its producer.
+     * Prefers CPUs of another physical core that share the L2 cache, then any other physical core, then SMT siblings.
+     *
+     * @param cpu CPU the picked CPU should share the L3 cache with.
+     * @param exclude CPUs that should not be picked (e.g. already used ones).
+     * @return int Picked CPU or -1 if no other CPU shares the L3 cache.
+     */
+    int pickCpuSharingL3(size_t cpu, const std::vector<size_t> &exclude = {}) const {
+        const CpuPlacement* self = this->placement(cpu);
+        if(self == nullptr) return -1;
+        int best = -1;
+        int bestRank = 3;
+        for(const CpuPlacement &other : placements){
+            if(other.cpu == cpu || other.l3Domain != self->l3Domain) continue;
+            if(std::find(exclude.begin(), exclude.end(), other.cpu) != exclude.end()) continue;
+            const int rank = other.core == self->core ? 2 : (other.l2Domain == self->l2Domain ? 0 : 1);
+            if(rank < bestRank){
+                best = (int)other.cpu;
+                bestRank = rank;
+            }
+        }
+        return best;
+    }
+
+    /**
+     * Returns one CPU per physical core (the lowest of each core), useful to place threads without SMT contention.
+     */
+    std::vector<size_t> getPhysicalCores() const {
+        std::vector<size_t> result;
+        for(const CpuPlacement &p : placements)
+            if(p.core == (int)p.cpu) result.push_back(p.cpu);
+        return result;
+    }
+
+    /**
+     * Returns a human readable summary of the topology (one line per CPU).
+     */
+    std::string toString() const {
+        std::string result;
+        for(const CpuPlacement &p : placements){
+            result += "CPU " + std::to_string(p.cpu) + ": package=" + std::to_string(p.package) +
+                        " numa=" + std::to_string(p.numaNode) + " l3=" + std::to_string(p.l3Domain) +
+                        " l2=" + std::to_string(p.l2Domain) + " core=" + std::to_string(p.core) + " caches=";
+            for(const CpuCache &cache : p.caches)
+                result += "L" + std::to_string(cache.level) + cache.type + ":" + std::to_string(cache.size >> 10) + "K ";
+            result += "\n";
+        }
+        return result;
+    }
+};
+
+
+
+/**
+ * Size of pages memory can be allocated with (see HardwareUtils::allocateMemory()).
+ */
+enum class PageSize : uint8_t {
+    DEFAULT = 0,    // regular pages of the OS (usually 4 KB)
+    HUGE_2MB = 1,   // 2 MB huge pages
+    HUGE_1GB = 2,   // 1 GB huge pages
+};
+
 
 class HardwareUtils {
 protected:
 
+    // constants of the mbind/get_mempolicy syscalls (numaif.h only exists if libnuma is installed)
+    static constexpr int POLICY_BIND = 2;           // MPOL_BIND
+    static constexpr unsigned POLICY_MOVE = 1 << 1; // MPOL_MF_MOVE
+    static constexpr unsigned long POLICY_NODE_OF_ADDRESS = 1 | 2; // MPOL_F_NODE | MPOL_F_ADDR
+    static constexpr size_t MAX_NUMA_NODES = 1024;
+
     #ifdef CUDA
     static void handleCUDAError(cudaError_t err){
         if(err != cudaSuccess){
@@ -142,6 +457,123 @@ public:
         return (ThreadID) syscall(SYS_gettid); // same logic in Thread.hpp execute() !
     }
 
+
+    /**
+     * Returns the cached CPU topology (packages, NUMA nodes, cache domains, cores and SMT siblings).
+     */
+    static const CpuTopology& getTopology(){
+        return CpuTopology::get();
+    }
+
+    /**
+     * Returns the size of a cache line in bytes as reported by the OS (CACHE_LINE_SIZE if unknown).
+     */
+    static size_t getCacheLineSize(){
+        const CpuCache* cache = CpuTopology::get().getCache((size_t)std::max(0, currentCPU()), 1);
+        return cache != nullptr && cache->lineSize > 0 ? cache->lineSize : CACHE_LINE_SIZE;
+    }
+
+    /**
+     * Picks another CPU that shares the L3 cache with the given CPU (see CpuTopology::pickCpuSharingL3()).
+     * 
+     * @param cpu CPU the picked CPU should share the L3 cache with or -1 for the CPU of the calling thread.
+     * @return int Picked CPU or -1 if no other CPU shares the L3 cache.
+     */
+    static int pickCpuSharingL3(int cpu = -1){
+        if(cpu < 0) cpu = currentCPU();
+        return cpu >= 0 ? CpuTopology::get().pickCpuSharingL3((size_t)cpu) : -1;
+    }
+
+
+    /**
+     * Returns the size of a page in bytes.
+     */
+    static size_t getPageSize(PageSize pageSize = PageSize::DEFAULT){
+        switch(pageSize){
+            case PageSize::HUGE_2MB: return (size_t)1 << 21;
+            case PageSize::HUGE_1GB: return (size_t)1 << 30;
+            default: {
+                static const size_t size = (size_t)sysconf(_SC_PAGESIZE);
+                return size;
+            }
+        }
+    }
+
+    /**
+     * Allocates zero-initialized memory directly from the OS (mmap) on the given NUMA node.
+     * The size gets rounded up to whole pages, therefore only use it for large buffers (or chunks of objects).
+     * 
+     * Huge pages are taken from the reserved pool of the OS (/proc/sys/vm/nr_hugepages).
+     * If none are reserved regular pages are used and marked for transparent huge pages instead.
+     * Binding to a NUMA node is best effort: if the kernel has no NUMA support the memory
+     * is placed by the default policy (node of the thread that first touches it).
+     * 
+     * @param bytes Amount of bytes to allocate.
+     * @param numaNode NUMA node the memory should be located on or -1 for the default policy.
+     * @param pageSize Size of the pages backing the memory.
+     * @param populate If true all pages get faulted in right away (otherwise on first access).
+     * @return void* Page aligned memory that must be freed with freeMemory().
+     * @throws std::bad_alloc if the OS cannot provide the memory.
+     */
+    static void* allocateMemory(size_t bytes, int numaNode = -1, PageSize pageSize = PageSize::DEFAULT, bool populate = false){
+        const size_t length = roundToPages(bytes, pageSize);
+        void* memory = MAP_FAILED;
+        if(pageSize != PageSize::DEFAULT){
+            const int hugeFlags = MAP_HUGETLB | ((pageSize == PageSize::HUGE_1GB ? 30 : 21) << 26); // MAP_HUGE_1GB / MAP_HUGE_2MB
+            memory = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | hugeFlags, -1, 0);
+        }
+        if(memory == MAP_FAILED){
+            memory = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(memory == MAP_FAILED) throw std::bad_alloc();
+            #ifdef MADV_HUGEPAGE
+            if(pageSize != PageSize::DEFAULT) madvise(memory, length, MADV_HUGEPAGE);
+            #endif
+        }
+
+        if(numaNode >= 0 && (size_t)numaNode < MAX_NUMA_NODES){
+            unsigned long nodeMask[MAX_NUMA_NODES / (8 * sizeof(unsigned long))] = {};
+            nodeMask[(size_t)numaNode / (8 * sizeof(unsigned long))] = 1ul << ((size_t)numaNode % (8 * sizeof(unsigned long)));
+            syscall(SYS_mbind, memory, length, POLICY_BIND, nodeMask, MAX_NUMA_NODES + 1, POLICY_MOVE); // best effort
+        }
+
+        if(populate){
+            const size_t step = getPageSize(PageSize::DEFAULT);
+            volatile uint8_t* bytesPtr = static_cast<volatile uint8_t*>(memory);
+            for(size_t offset=0; offset < length; offset += step) bytesPtr[offset] = 0;
+        }
+        return memory;
+    }
+
+    /**
+     * Frees memory allocated by allocateMemory().
+     * 
+     * @param memory Memory returned by allocateMemory() (nullptr is ignored).
+     * @param bytes Same amount of bytes as passed to allocateMemory().
+     * @param pageSize Same page size as passed to allocateMemory().
+     */
+    static void freeMemory(void* memory, size_t bytes, PageSize pageSize = PageSize::DEFAULT) noexcept {
+        if(memory != nullptr) munmap(memory, roundToPages(bytes, pageSize));
+    }
+
+    /**
+     * Returns the NUMA node the page containing the given address is located on.
+     * 
+     * @param address Address of memory that has already been touched.
+     * @return int NUMA node or -1 if could not be determined.
+     */
+    static int getNumaNodeOfMemory(const void* address){
+        int node = -1;
+        if(syscall(SYS_get_mempolicy, &node, nullptr, 0, address, POLICY_NODE_OF_ADDRESS) != 0) return -1;
+        return node;
+    }
+
+protected:
+
+    static inline size_t roundToPages(size_t bytes, PageSize pageSize){
+        const size_t page = getPageSize(pageSize);
+        return ((bytes == 0 ? 1 : bytes) + page - 1) / page * page;
+    }
+
 };
 
 }
@@ -0,0 +1,120 @@
+/**
+ * Move-only callable wrapper with inline storage used for callbacks of callback queues.
+ *
+ * @file InlineCallback.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+
+#ifndef SPI_INLINE_CALLBACK_HPP
+#define SPI_INLINE_CALLBACK_HPP
+
+#include "./InlineStorage.hpp"
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+/** Default amount of bytes an InlineCallback can store without allocating memory on the heap. */
+#ifndef SPI_CALLBACK_INLINE_SIZE
+#define SPI_CALLBACK_INLINE_SIZE 48
+#endif
+
+namespace spi {
+
+
+
+template<typename Signature, size_t InlineSize = SPI_CALLBACK_INLINE_SIZE>
+class InlineCallback;
+
+
+/**
+ * Replacement for std::function<R(Args...)> that:
+ *  - is move-only, therefore callables can be move-only too,
+ *  - stores callables of up to InlineSize bytes inside the object itself
+ *    and only allocates on the heap if the callable is bigger (see InlineStorage).
+ *
+ * @tparam R Return type of the callable.
+ * @tparam Args Arguments the callable gets called with.
+ * @tparam InlineSize Bytes available for storing the callable inline.
+ */
+template<typename R, typename... Args, size_t InlineSize>
+class InlineCallback<R(Args...), InlineSize> {
+protected:
+    InlineStorage<R(Args...), InlineSize> callable;
+
+public:
+
+    /**
+     * Creates an empty callback.
+     */
+    InlineCallback() noexcept = default;
+
+    InlineCallback(std::nullptr_t) noexcept {}
+
+    /**
+     * Creates a callback that calls fn.
+     *
+     * @param fn Callable that gets moved or copied into the callback.
+     */
+    template<class Fn> requires (!std::is_same_v<std::remove_cvref_t<Fn>, InlineCallback> &&
+                                 !std::is_same_v<std::remove_cvref_t<Fn>, std::nullptr_t> &&
+                                 std::is_invocable_r_v<R, std::decay_t<Fn>&, Args...>)
+    InlineCallback(Fn&& fn){
+        this->emplace(std::forward<Fn>(fn));
+    }
+
+    InlineCallback(InlineCallback&& other) noexcept = default;
+    InlineCallback& operator=(InlineCallback&& other) noexcept = default;
+
+    InlineCallback(const InlineCallback&) = delete;
+    InlineCallback& operator=(const InlineCallback&) = delete;
+
+    /**
+     * Replaces the stored callable by fn.
+     *
+     * @param fn Callable that gets moved or copied into the callback.
+     */
+    template<class Fn>
+    void emplace(Fn&& fn){
+        this->callable.template construct<std::decay_t<Fn>>(std::forward<Fn>(fn));
+    }
+
+    /**
+     * Destroys the stored callable (callback is empty afterwards).
+     */
+    void reset() noexcept {
+        this->callable.reset();
+    }
+
+    /**
+     * Calls the stored callable.
+     *
+     * @throws std::bad_function_call if the callback is empty.
+     */
+    inline R operator()(Args... args){
+        return this->callable.invoke(std::forward<Args>(args)...);
+    }
+
+    /**
+     * Returns if a callable is stored.
+     */
+    explicit operator bool() const noexcept {
+        return this->callable.hasCallable();
+    }
+
+    /**
+     * Returns if a callable of the given type would be stored without allocating memory on the heap.
+     *
+     * @tparam Fn Type of the callable.
+     */
+    template<class Fn>
+    static constexpr bool isStoredInline(){
+        return InlineStorage<R(Args...), InlineSize>::template fitsInline<std::decay_t<Fn>>;
+    }
+};
+
+
+
+}
+
+#endif // SPI_INLINE_CALLBACK_HPP
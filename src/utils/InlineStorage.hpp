@@ -0,0 +1,169 @@
+/**
+ * Small-buffer type erasure shared by the move-only callable wrappers InlineTask and InlineCallback.
+ *
+ * @file InlineStorage.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+
+#ifndef SPI_INLINE_STORAGE_HPP
+#define SPI_INLINE_STORAGE_HPP
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace spi {
+
+
+
+template<typename Signature, size_t InlineSize>
+class InlineStorage;
+
+
+/**
+ * Move-only storage for a single callable that:
+ *  - stores callables of up to InlineSize bytes inside the object itself
+ *    and only allocates on the heap if the callable is bigger
+ *    (or cannot be moved without throwing),
+ *  - dispatches through a static table of function pointers per callable type.
+ *
+ * Wrappers decide how callables get constructed (e.g. InlineTask binds arguments first).
+ *
+ * @tparam R Return type of the callable.
+ * @tparam Args Arguments the callable gets called with.
+ * @tparam InlineSize Bytes available for storing the callable inline.
+ */
+template<typename R, typename... Args, size_t InlineSize>
+class InlineStorage<R(Args...), InlineSize> {
+protected:
+
+    struct Operations {
+        R (*invoke)(void* storage, Args... args);
+        void (*move)(void* dst, void* src) noexcept; // move constructs dst from src and destroys src
+        void (*destroy)(void* storage) noexcept;
+    };
+
+    template<typename Callable>
+    struct InlineOperations {
+        static R invoke(void* storage, Args... args){
+            return std::invoke(*std::launder(reinterpret_cast<Callable*>(storage)), std::forward<Args>(args)...);
+        }
+        static void move(void* dst, void* src) noexcept {
+            Callable* from = std::launder(reinterpret_cast<Callable*>(src));
+            ::new(dst) Callable(std::move(*from));
+            from->~Callable();
+        }
+        static void destroy(void* storage) noexcept {
+            std::launder(reinterpret_cast<Callable*>(storage))->~Callable();
+        }
+        static constexpr Operations operations{&invoke, &move, &destroy};
+    };
+
+    template<typename Callable>
+    struct HeapOperations {
+        static R invoke(void* storage, Args... args){
+            return std::invoke(**reinterpret_cast<Callable**>(storage), std::forward<Args>(args)...);
+        }
+        static void move(void* dst, void* src) noexcept {
+            *reinterpret_cast<Callable**>(dst) = *reinterpret_cast<Callable**>(src);
+        }
+        static void destroy(void* storage) noexcept {
+            delete *reinterpret_cast<Callable**>(storage);
+        }
+        static constexpr Operations operations{&invoke, &move, &destroy};
+    };
+
+    static_assert(InlineSize >= sizeof(void*), "InlineSize must at least be able to hold a pointer");
+
+    alignas(std::max_align_t) unsigned char storage[InlineSize];
+    const Operations* operations = nullptr;
+
+public:
+
+    /** If a callable of the given type is stored without allocating memory on the heap. */
+    template<typename Callable>
+    static constexpr bool fitsInline = sizeof(Callable) <= InlineSize &&
+                                        alignof(Callable) <= alignof(std::max_align_t) &&
+                                        std::is_nothrow_move_constructible_v<Callable>;
+
+    InlineStorage() noexcept = default;
+
+    InlineStorage(InlineStorage&& other) noexcept : operations(other.operations) {
+        if(this->operations != nullptr){
+            this->operations->move(this->storage, other.storage);
+            other.operations = nullptr;
+        }
+    }
+
+    InlineStorage& operator=(InlineStorage&& other) noexcept {
+        if(this != &other){
+            this->reset();
+            if(other.operations != nullptr){
+                other.operations->move(this->storage, other.storage);
+                this->operations = other.operations;
+                other.operations = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    InlineStorage(const InlineStorage&) = delete;
+    InlineStorage& operator=(const InlineStorage&) = delete;
+
+    ~InlineStorage(){
+        this->reset();
+    }
+
+    /**
+     * Replaces the stored callable by a Callable constructed in place from the given arguments.
+     *
+     * @tparam Callable Type of the callable that gets stored.
+     * @param args Arguments for the constructor of Callable.
+     */
+    template<typename Callable, typename... A>
+    void construct(A&&... args){
+        this->reset();
+        if constexpr (fitsInline<Callable>){
+            ::new(static_cast<void*>(this->storage)) Callable(std::forward<A>(args)...);
+            this->operations = &InlineOperations<Callable>::operations;
+        } else {
+            *reinterpret_cast<Callable**>(this->storage) = new Callable(std::forward<A>(args)...);
+            this->operations = &HeapOperations<Callable>::operations;
+        }
+    }
+
+    /**
+     * Destroys the stored callable (storage is empty afterwards).
+     */
+    void reset() noexcept {
+        if(this->operations != nullptr){
+            this->operations->destroy(this->storage);
+            this->operations = nullptr;
+        }
+    }
+
+    /**
+     * Calls the stored callable.
+     *
+     * @throws std::bad_function_call if the storage is empty.
+     */
+    inline R invoke(Args... args){
+        if(this->operations == nullptr) throw std::bad_function_call();
+        return this->operations->invoke(this->storage, std::forward<Args>(args)...);
+    }
+
+    /**
+     * Returns if a callable is stored.
+     */
+    inline bool hasCallable() const noexcept {
+        return this->operations != nullptr;
+    }
+};
+
+
+
+}
+
+#endif // SPI_INLINE_STORAGE_HPP
@@ -0,0 +1,287 @@
+/**
+ * Log-linear histograms for recording latencies with low overhead and querying percentiles.
+ *
+ * @file LatencyHistogram.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+
+#ifndef SPI_LATENCY_HISTOGRAM_HPP
+#define SPI_LATENCY_HISTOGRAM_HPP
+
+#include "./MetricsUtils.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/** Amount of bits used for the linear sub-buckets of every power of two (relative error of at most 1/2^bits). */
+#ifndef SPI_LATENCY_HISTOGRAM_SUB_BUCKET_BITS
+#define SPI_LATENCY_HISTOGRAM_SUB_BUCKET_BITS 5
+#endif
+
+namespace spi {
+
+
+
+/**
+ * Mapping of values to buckets shared by all latency histograms (HDR style):
+ * values below 2^SUB_BUCKET_BITS get a bucket each, every following power of two
+ * is split into 2^SUB_BUCKET_BITS equally sized buckets.
+ * With the default of 5 bits a value is off by at most ~3% over the whole 64 bit range.
+ */
+struct LatencyHistogramBuckets {
+    static constexpr uint32_t SUB_BUCKET_BITS = SPI_LATENCY_HISTOGRAM_SUB_BUCKET_BITS;
+    static constexpr uint64_t SUB_BUCKETS = (uint64_t)1 << SUB_BUCKET_BITS;
+    static constexpr size_t COUNT = (size_t)SUB_BUCKETS * (64 - SUB_BUCKET_BITS + 1);
+
+    static_assert(SUB_BUCKET_BITS > 0 && SUB_BUCKET_BITS < 16, "SPI_LATENCY_HISTOGRAM_SUB_BUCKET_BITS must be between 1 and 15");
+
+    /** Returns the bucket a value gets counted in. */
+    static inline size_t index(uint64_t value) noexcept {
+        if(value < SUB_BUCKETS) return (size_t)value;
+        const uint32_t shift = (uint32_t)(63 - std::countl_zero(value)) - SUB_BUCKET_BITS;
+        return (size_t)(((uint64_t)shift + 1) * SUB_BUCKETS + ((value >> shift) - SUB_BUCKETS));
+    }
+
+    /** Returns the smallest value counted in the given bucket. */
+    static inline uint64_t lowest(size_t index) noexcept {
+        if(index < SUB_BUCKETS) return (uint64_t)index;
+        const uint64_t shift = index / SUB_BUCKETS - 1;
+        return (SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+    }
+
+    /** Returns the largest value counted in the given bucket. */
+    static inline uint64_t highest(size_t index) noexcept {
+        if(index < SUB_BUCKETS) return (uint64_t)index;
+        const uint64_t shift = index / SUB_BUCKETS - 1;
+        return lowest(index) + (((uint64_t)1 << shift) - 1);
+    }
+};
+
+
+
+/**
+ * Histogram of latencies (or any other unsigned values, usually nanoseconds).
+ * Recording is a single increment, histograms can be merged and queried for percentiles.
+ *
+ * IMPORTANT:   not thread-safe, use ConcurrentLatencyHistogram to record from multiple threads!
+ */
+class LatencyHistogram {
+protected:
+    uint64_t counts[LatencyHistogramBuckets::COUNT] = {};
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t minValue = UINT64_MAX;
+    uint64_t maxValue = 0;
+
+    friend class ConcurrentLatencyHistogram;
+
+public:
+
+    /**
+     * Records a value.
+     */
+    inline void record(uint64_t value) noexcept {
+        this->counts[LatencyHistogramBuckets::index(value)]++;
+        this->total++;
+        this->sum += value;
+        this->minValue = std::min(this->minValue, value);
+        this->maxValue = std::max(this->maxValue, value);
+    }
+
+    /**
+     * Adds all values recorded by another histogram.
+     */
+    void merge(const LatencyHistogram &other) noexcept {
+        for(size_t i=0; i < LatencyHistogramBuckets::COUNT; i++) this->counts[i] += other.counts[i];
+        this->total += other.total;
+        this->sum += other.sum;
+        this->minValue = std::min(this->minValue, other.minValue);
+        this->maxValue = std::max(this->maxValue, other.maxValue);
+    }
+
+    /**
+     * Removes all recorded values.
+     */
+    void reset() noexcept {
+        *this = LatencyHistogram();
+    }
+
+    /** Amount of recorded values. */
+    inline uint64_t count() const noexcept {
+        return this->total;
+    }
+
+    /** Smallest recorded value (exact) or 0 if empty. */
+    inline uint64_t min() const noexcept {
+        return this->total > 0 ? this->minValue : 0;
+    }
+
+    /** Largest recorded value (exact). */
+    inline uint64_t max() const noexcept {
+        return this->maxValue;
+    }
+
+    /** Average of all recorded values (exact) or 0 if empty. */
+    inline double mean() const noexcept {
+        return this->total > 0 ? (double)this->sum / (double)this->total : 0;
+    }
+
+    /**
+     * Returns the value below or equal to which the given share of recorded values lies
+     * (highest value of the bucket, never above the recorded maximum).
+     *
+     * @param percentile Between 0 and 100 e.g. 99.9
+     * @return Value at the given percentile or 0 if empty.
+     */
+    uint64_t percentile(double percentile) const noexcept {
+        if(this->total == 0) return 0;
+        const double clamped = std::clamp(percentile, 0.0, 100.0);
+        const uint64_t rank = std::max((uint64_t)1, (uint64_t)((clamped / 100.0) * (double)this->total + 0.5));
+        uint64_t seen = 0;
+        for(size_t i=0; i < LatencyHistogramBuckets::COUNT; i++){
+            seen += this->counts[i];
+            if(seen >= rank) return std::clamp(LatencyHistogramBuckets::highest(i), this->min(), this->maxValue);
+        }
+        return this->maxValue;
+    }
+
+    /**
+     * Returns a human readable summary assuming values are nanoseconds
+     * e.g. "count=1,000 min=12ns p50=40ns p99=1.2us p999=5.3us max=12.1ms"
+     */
+    std::string toString(size_t digitsAfterComma = 1) const {
+        return "count=" + MetricsUtils::roundToString(this->total) +
+                " min=" + MetricsUtils::nanosecondsToString((int64_t)this->min(), digitsAfterComma) +
+                " p50=" + MetricsUtils::nanosecondsToString((int64_t)this->percentile(50), digitsAfterComma) +
+                " p99=" + MetricsUtils::nanosecondsToString((int64_t)this->percentile(99), digitsAfterComma) +
+                " p999=" + MetricsUtils::nanosecondsToString((int64_t)this->percentile(99.9), digitsAfterComma) +
+                " max=" + MetricsUtils::nanosecondsToString((int64_t)this->max(), digitsAfterComma);
+    }
+};
+
+
+
+/**
+ * Latency histogram multiple threads can record into without any synchronization:
+ * every thread records into its own Recorder (obtained once via recorder())
+ * and snapshot() merges all recorders into a LatencyHistogram at any time (e.g. periodically).
+ *
+ * Recording only touches memory of the calling thread (relaxed loads and stores, no read-modify-write).
+ * Registering a recorder is lock-free, recorders stay valid until the histogram gets destroyed.
+ */
+class ConcurrentLatencyHistogram {
+public:
+
+    /**
+     * Part of the histogram a single thread records into.
+     */
+    class Recorder {
+    protected:
+        std::atomic<uint64_t> counts[LatencyHistogramBuckets::COUNT]{};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> minValue{UINT64_MAX};
+        std::atomic<uint64_t> maxValue{0};
+        Recorder* next = nullptr;
+
+        friend class ConcurrentLatencyHistogram;
+
+        static inline void increment(std::atomic<uint64_t> &value, uint64_t add) noexcept {
+            value.store(value.load(std::memory_order_relaxed) + add, std::memory_order_relaxed); // single writer
+        }
+
+    public:
+
+        /**
+         * Records a value. Must only be called by the thread owning this recorder.
+         */
+        inline void record(uint64_t value) noexcept {
+            increment(this->counts[LatencyHistogramBuckets::index(value)], 1);
+            increment(this->sum, value);
+            if(value < this->minValue.load(std::memory_order_relaxed)) this->minValue.store(value, std::memory_order_relaxed);
+            if(value > this->maxValue.load(std::memory_order_relaxed)) this->maxValue.store(value, std::memory_order_relaxed);
+        }
+    };
+
+protected:
+    std::atomic<Recorder*> recorders{nullptr};
+
+public:
+
+    ConcurrentLatencyHistogram() = default;
+
+    ~ConcurrentLatencyHistogram(){
+        Recorder* current = this->recorders.load(std::memory_order_acquire);
+        while(current != nullptr){
+            Recorder* next = current->next;
+            delete current;
+            current = next;
+        }
+    }
+
+    ConcurrentLatencyHistogram(const ConcurrentLatencyHistogram&) = delete;
+    ConcurrentLatencyHistogram& operator=(const ConcurrentLatencyHistogram&) = delete;
+
+    /**
+     * Creates a new recorder for the calling thread.
+     * Should be called once per thread and the recorder be reused for all values of that thread.
+     */
+    Recorder& recorder(){
+        Recorder* recorder = new Recorder();
+        Recorder* head = this->recorders.load(std::memory_order_relaxed);
+        do {
+            recorder->next = head;
+        } while(!this->recorders.compare_exchange_weak(head, recorder, std::memory_order_release, std::memory_order_relaxed));
+        return *recorder;
+    }
+
+    /**
+     * Merges the values of all recorders into a histogram.
+     * Can be called concurrently to recording (values recorded meanwhile may or may not be included).
+     */
+    LatencyHistogram snapshot() const {
+        LatencyHistogram result;
+        this->snapshot(result);
+        return result;
+    }
+
+    /**
+     * Merges the values of all recorders into the given histogram (adds to already contained values).
+     */
+    void snapshot(LatencyHistogram &result) const {
+        for(Recorder* current = this->recorders.load(std::memory_order_acquire); current != nullptr; current = current->next){
+            uint64_t total = 0;
+            for(size_t i=0; i < LatencyHistogramBuckets::COUNT; i++){
+                const uint64_t count = current->counts[i].load(std::memory_order_relaxed);
+                result.counts[i] += count;
+                total += count;
+            }
+            if(total == 0) continue;
+            result.total += total;
+            result.sum += current->sum.load(std::memory_order_relaxed);
+            result.minValue = std::min(result.minValue, current->minValue.load(std::memory_order_relaxed));
+            result.maxValue = std::max(result.maxValue, current->maxValue.load(std::memory_order_relaxed));
+        }
+    }
+
+    /**
+     * Resets all recorders. Must not be called while threads are recording.
+     */
+    void reset() noexcept {
+        for(Recorder* current = this->recorders.load(std::memory_order_acquire); current != nullptr; current = current->next){
+            for(size_t i=0; i < LatencyHistogramBuckets::COUNT; i++) current->counts[i].store(0, std::memory_order_relaxed);
+            current->sum.store(0, std::memory_order_relaxed);
+            current->minValue.store(UINT64_MAX, std::memory_order_relaxed);
+            current->maxValue.store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+
+
+}
+
+#endif // SPI_LATENCY_HISTOGRAM_HPP
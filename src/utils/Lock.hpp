@@ -8,26 +8,78 @@
 #ifndef SPI_LOCK_HPP
 #define SPI_LOCK_HPP
 
+#include "./HardwareUtils.hpp"
+
+#include <algorithm>
 #include <atomic>
+#include <bit>
+#include <cstdint>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <shared_mutex>
 #include <thread>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 namespace spi {
 
 
+/**
+ * Hints the CPU that the calling thread is busy waiting
+ * (pause on x86, yield on ARM) so the sibling hyper-thread can run and power is saved.
+ */
+inline void cpuRelax() noexcept {
+    #if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+    #elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield" ::: "memory");
+    #else
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    #endif
+}
+
+
+/**
+ * Modes a Lock can operate in.
+ */
+enum class LockMode {
+    /** Test-and-test-and-set loop that yields while waiting (lowest latency, burns cpu while waiting). */
+    SPIN,
+
+    /** Plain std::mutex (lowest cpu usage, higher latency). */
+    MUTEX,
+
+    /** Spins with exponential backoff up to a self-tuning budget and then parks the thread (std::atomic::wait). */
+    ADAPTIVE
+};
+
+
 /**
  * An exclusive access lock providing a lock and unlock method that can be accessed by multiple threads simultaneously.
  * Achieves comparable and better performance than traditional mutexes especially in high contention scenarios, 
- * however it is computational more expensive (if reduceCpuUsage is false).
+ * however it is computational more expensive (if mode is LockMode::SPIN).
  * Is not automatically locked on creation and also does not unlock on destruction.
  * 
+ * In LockMode::ADAPTIVE waiting threads first spin (cpuRelax() with exponential backoff and later yield)
+ * and park on the lock word once the spin budget is used up. The budget follows the amount of spins
+ * recently needed to get the lock (proxy for how long the lock is held): it grows if spinning
+ * succeeds after many iterations and shrinks if threads had to park anyway.
  */
 class Lock {
 private:
 
-    bool reduceCpuUsage;
+    static constexpr uint32_t UNLOCKED = 0;
+    static constexpr uint32_t LOCKED = 1;
+    static constexpr uint32_t CONTENDED = 2; // locked and threads may be parked
+
+    static constexpr uint32_t MIN_SPINS = 16;
+    static constexpr uint32_t MAX_SPINS = 1024;
+    static constexpr uint32_t MAX_PAUSES = 64; // pauses per spin iteration before yielding instead
+
+    LockMode mode;
 
     // for high performance
     std::atomic<bool> aquired{false};
@@ -35,46 +87,379 @@ private:
     // for reduce cpu usage
     std::mutex mtx;
 
+    // for adaptive
+    std::atomic<uint32_t> state{UNLOCKED};
+    std::atomic<uint32_t> spinEstimate{MIN_SPINS}; // spins recently needed to get the lock
+
+    void lockAdaptive() noexcept {
+        const uint32_t estimate = spinEstimate.load(std::memory_order_relaxed);
+        const uint32_t budget = std::min(MAX_SPINS, estimate * 2 + MIN_SPINS);
+        uint32_t pauses = 1;
+        for(uint32_t spins=1; spins <= budget; spins++){
+            if(pauses <= MAX_PAUSES){
+                for(uint32_t i=0; i < pauses; i++) cpuRelax();
+                pauses *= 2;
+            } else {
+                std::this_thread::yield();
+            }
+            uint32_t expected = UNLOCKED;
+            if(state.load(std::memory_order_relaxed) == UNLOCKED &&
+                    state.compare_exchange_weak(expected, LOCKED, std::memory_order_acquire, std::memory_order_relaxed)){
+                spinEstimate.store((uint32_t)((int64_t)estimate + ((int64_t)spins - (int64_t)estimate) / 8), std::memory_order_relaxed);
+                return;
+            }
+        }
+
+        // spinning did not pay off, park until unlocked
+        spinEstimate.store(estimate - estimate / 8, std::memory_order_relaxed);
+        while(state.exchange(CONTENDED, std::memory_order_acquire) != UNLOCKED){
+            state.wait(CONTENDED, std::memory_order_relaxed);
+        }
+    }
+
+    inline void lock(LockMode mode) noexcept {
+        switch(mode){
+            case LockMode::MUTEX:
+                mtx.lock();
+                return;
+            case LockMode::ADAPTIVE: {
+                uint32_t expected = UNLOCKED;
+                if(!state.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire, std::memory_order_relaxed))
+                    lockAdaptive();
+                return;
+            }
+            case LockMode::SPIN:
+                break;
+        }
+        while(true){
+
+            if(!aquired.exchange(true, std::memory_order_acquire)){
+                return; // successfully aquired lock
+            }
+
+            while(aquired.load(std::memory_order_relaxed)){ // optimization because load is way faster and uses cache
+                std::this_thread::yield(); // way better performance when always including this!
+            }
+        }
+    }
+
+    inline void unlock(LockMode mode) noexcept {
+        switch(mode){
+            case LockMode::MUTEX:
+                mtx.unlock();
+                return;
+            case LockMode::ADAPTIVE:
+                if(state.exchange(UNLOCKED, std::memory_order_release) == CONTENDED)
+                    state.notify_one();
+                return;
+            case LockMode::SPIN:
+                break;
+        }
+        aquired.store(false, std::memory_order_release);
+    }
+
 public:
 
-    Lock(bool reduceCpuUsage) : reduceCpuUsage(reduceCpuUsage) {}
+    /**
+     * Creates a new lock.
+     *
+     * @param mode Mode the lock operates in (default LockMode::ADAPTIVE).
+     */
+    Lock(LockMode mode = LockMode::ADAPTIVE) : mode(mode) {}
+
+    /**
+     * Creates a new lock.
+     *
+     * @param reduceCpuUsage If true LockMode::MUTEX is used, otherwise LockMode::SPIN.
+     */
+    Lock(bool reduceCpuUsage) : mode(reduceCpuUsage ? LockMode::MUTEX : LockMode::SPIN) {}
+
+    /**
+     * Changes the mode of the Lock.
+     * IMPORTANT: calling thread is not allowed to hold this lock!
+     */
+    void setMode(LockMode mode){
+        if(mode == this->mode) return;
+        const LockMode previous = this->mode;
+        lock(previous);
+        this->mode = mode;
+        unlock(previous);
+    }
 
     /**
-     * Changes the mode of the Lock to reduce cpu usage.
+     * Changes the mode of the Lock to reduce cpu usage (LockMode::MUTEX) or not (LockMode::SPIN).
      * IMPORTANT: calling thread is not allowed to hold this lock!
      */
     void setReduceCpuUsage(bool reduceCpuUsage){
-        if(reduceCpuUsage == this->reduceCpuUsage) return;
-        lock();
-        this->reduceCpuUsage = reduceCpuUsage;
-        unlock();
+        setMode(reduceCpuUsage ? LockMode::MUTEX : LockMode::SPIN);
+    }
+
+    /**
+     * Returns the mode the lock operates in.
+     */
+    LockMode getMode() const noexcept {
+        return mode;
+    }
+
+    /**
+     * Returns the amount of spin iterations a thread currently waits before parking (only LockMode::ADAPTIVE).
+     */
+    uint32_t getSpinBudget() const noexcept {
+        return std::min(MAX_SPINS, spinEstimate.load(std::memory_order_relaxed) * 2 + MIN_SPINS);
+    }
+
+    inline void lock() noexcept {
+        lock(mode);
+    }
+
+    inline void unlock() noexcept {
+        unlock(mode);
     }
 
+};
+
+
+
+/**
+ * Fair spinlock that grants the lock in the order threads called lock() (FIFO).
+ * Every thread draws a ticket and waits until its ticket is served.
+ * Waiting threads back off proportional to their distance to the front of the queue.
+ * Is not automatically locked on creation and also does not unlock on destruction.
+ */
+class TicketLock {
+private:
+
+    static constexpr uint32_t MAX_PAUSES = 64; // pauses per spin iteration before yielding instead
+    static constexpr uint32_t SPINS = 128; // spin iterations before yielding (holder may not be running)
+
+    std::atomic<uint32_t> next{0};
+    std::atomic<uint32_t> serving{0};
+
+public:
+
+    TicketLock() = default;
+    TicketLock(const TicketLock&) = delete;
+    TicketLock& operator=(const TicketLock&) = delete;
+
     inline void lock() noexcept {
-        if(reduceCpuUsage){
-            mtx.lock();
-            return;
+        const uint32_t ticket = next.fetch_add(1, std::memory_order_relaxed);
+        uint32_t current = serving.load(std::memory_order_acquire);
+        uint32_t spins = 0;
+        while(current != ticket){
+            const uint32_t pauses = (ticket - current) * 8;
+            if(pauses <= MAX_PAUSES && spins < SPINS){
+                for(uint32_t i=0; i < pauses; i++) cpuRelax();
+                spins++;
+            } else {
+                std::this_thread::yield();
+            }
+            current = serving.load(std::memory_order_acquire);
         }
-        while(true){
+    }
 
-            if(!aquired.exchange(true, std::memory_order_acquire)){
-                return; // successfully aquired lock
+    inline bool try_lock() noexcept {
+        uint32_t ticket = serving.load(std::memory_order_relaxed);
+        return next.compare_exchange_strong(ticket, ticket + 1, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    inline void unlock() noexcept {
+        serving.store(serving.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+};
+
+
+
+/**
+ * Fair queue-based spinlock (Mellor-Crummey & Scott) that grants the lock in FIFO order.
+ * Waiting threads form a linked list and every thread spins on a flag of its own node,
+ * therefore a release only touches the cache line of the next waiting thread instead of all waiting threads.
+ * Nodes are taken from a per-thread free list, so the usual lock()/unlock() interface is kept.
+ * Is not automatically locked on creation and also does not unlock on destruction.
+ */
+class MCSLock {
+private:
+
+    static constexpr uint32_t SPINS = 128; // spin iterations before yielding
+
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        std::atomic<bool> locked{false};
+        Node* free = nullptr; // next node in free list
+    };
+
+    /** Nodes of the calling thread that are not in use. */
+    struct FreeList {
+        Node* head = nullptr;
+        ~FreeList(){
+            while(head != nullptr){
+                Node* node = head;
+                head = node->free;
+                delete node;
             }
+        }
+    };
 
-            while(aquired.load(std::memory_order_relaxed)){ // optimization because load is way faster and uses cache
-                std::this_thread::yield(); // way better performance when always including this!
+    static inline FreeList& freeList() noexcept {
+        static thread_local FreeList list;
+        return list;
+    }
+
+    std::atomic<Node*> tail{nullptr};
+    Node* holder = nullptr; // node of thread holding the lock (only accessed by holder)
+
+public:
+
+    MCSLock() = default;
+    MCSLock(const MCSLock&) = delete;
+    MCSLock& operator=(const MCSLock&) = delete;
+
+    inline void lock(){
+        FreeList& list = freeList();
+        Node* node = list.head;
+        if(node != nullptr){
+            list.head = node->free;
+            node->next.store(nullptr, std::memory_order_relaxed);
+        } else {
+            node = new Node();
+        }
+        node->locked.store(true, std::memory_order_relaxed);
+
+        Node* predecessor = tail.exchange(node, std::memory_order_acq_rel);
+        if(predecessor != nullptr){
+            predecessor->next.store(node, std::memory_order_release);
+            uint32_t spins = 0;
+            while(node->locked.load(std::memory_order_acquire)){
+                if(spins < SPINS){
+                    cpuRelax();
+                    spins++;
+                } else {
+                    std::this_thread::yield();
+                }
             }
         }
+        holder = node;
     }
 
     inline void unlock() noexcept {
-        if(reduceCpuUsage){
-            mtx.unlock();
-            return;
+        Node* node = holder;
+        Node* successor = node->next.load(std::memory_order_acquire);
+        if(successor == nullptr){
+            Node* expected = node;
+            if(tail.compare_exchange_strong(expected, nullptr, std::memory_order_release, std::memory_order_relaxed)){
+                node->free = freeList().head;
+                freeList().head = node;
+                return;
+            }
+            uint32_t spins = 0;
+            while((successor = node->next.load(std::memory_order_acquire)) == nullptr){ // successor is about to link itself
+                if(spins < SPINS){
+                    cpuRelax();
+                    spins++;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
         }
-        aquired.store(false, std::memory_order_release);
+        successor->locked.store(false, std::memory_order_release);
+        node->free = freeList().head;
+        freeList().head = node;
     }
+};
+
 
+
+/**
+ * Lets threads sleep until a condition (kept outside, e.g. a non-empty queue) might have changed
+ * without lost wakeups. Waiting is split in three steps so the condition can be rechecked
+ * after announcing the wait:
+ *
+ *   EventCount::Key key = events.prepareWait();
+ *   if(condition()) events.cancelWait(); else events.commitWait(key);
+ *
+ * The notifying side first makes the condition true and then calls notifyOne() or notifyAll().
+ * A notify that happens after prepareWait() makes commitWait() return, so no wakeup gets lost.
+ * Sleeping uses std::atomic::wait (futex on Linux). Notifying costs a fence and a load
+ * and only touches the futex if a thread announced that it waits.
+ */
+class EventCount {
+public:
+    typedef uint32_t Key;
+
+protected:
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> epoch{0};
+    std::atomic<uint32_t> waiters{0};
+
+    inline bool advance() noexcept {
+        std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with prepareWait()
+        if(waiters.load(std::memory_order_relaxed) == 0) return false;
+        epoch.fetch_add(1, std::memory_order_release);
+        return true;
+    }
+
+public:
+
+    /**
+     * Announces that the calling thread is about to wait.
+     * The condition needs to be checked again afterwards, followed by either cancelWait() or commitWait().
+     * @return Key that needs to be passed to commitWait().
+     */
+    inline Key prepareWait() noexcept {
+        waiters.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst); // condition gets checked after waiters is visible
+        return epoch.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Withdraws a prepareWait() because the condition turned true in the meantime.
+     */
+    inline void cancelWait() noexcept {
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Sleeps until a notify happened after the prepareWait() that returned the given key.
+     * May return spuriously, so the condition needs to be checked again.
+     */
+    inline void commitWait(Key key) noexcept {
+        epoch.wait(key, std::memory_order_acquire);
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Sleeps until the given condition returns true (returns immediately if it already is true).
+     */
+    template<typename Condition>
+    inline void await(Condition condition){
+        while(!condition()){
+            const Key key = prepareWait();
+            if(condition()){
+                cancelWait();
+                return;
+            }
+            commitWait(key);
+        }
+    }
+
+    /**
+     * Wakes up one waiting thread (if any).
+     */
+    inline void notifyOne() noexcept {
+        if(advance()) epoch.notify_one();
+    }
+
+    /**
+     * Wakes up all waiting threads (if any).
+     */
+    inline void notifyAll() noexcept {
+        if(advance()) epoch.notify_all();
+    }
+
+    /**
+     * Returns the amount of threads currently between prepareWait() and the end of commitWait()/cancelWait().
+     */
+    inline uint32_t getWaiting() const noexcept {
+        return waiters.load(std::memory_order_relaxed);
+    }
 };
 
 
@@ -82,40 +467,45 @@ public:
 /**
  * Simple condition wait that can be used to pause a thread until a condition is met.
  * Optimized for minimal overhead if condition is met (no waiting needed).
+ * Waiting threads yield for a while and then sleep on an EventCount,
+ * setProceed() only wakes them if some are sleeping.
  */
 class BusyConditionWait {
 private:
-    volatile bool proceed = true;
+    static constexpr uint32_t YIELDS_BEFORE_SLEEP = 64;
+
+    std::atomic<bool> proceed{true};
+    EventCount events;
 
 public:
 
     /**
      * Calling thread will pause until the condition is met.
      * Otherwise immediately returns with minimal overhead.
-     * @param needToPause 
+     * @param needToPause Called once before the calling thread starts waiting.
      */
     inline void check(std::function<void()> needToPause = nullptr) noexcept {
-        while(!proceed) {
-            if(needToPause != nullptr){
-                needToPause();
-                needToPause = nullptr;
-            }
+        if(proceed.load(std::memory_order_acquire)) return;
+        if(needToPause != nullptr) needToPause();
+        for(uint32_t i=0; i < YIELDS_BEFORE_SLEEP; i++){
             std::this_thread::yield();
+            if(proceed.load(std::memory_order_acquire)) return;
         }
+        events.await([this]{ return proceed.load(std::memory_order_acquire); });
     }
 
     /**
      * Will pause threads hitting the check() method until setProceed() is called.
      */
     void setWait() noexcept {
-        proceed = false;
+        proceed.store(false, std::memory_order_relaxed);
     }
 
     /**
      * Will allow threads hitting or waiting at the check() method to proceed.
      */
     void setProceed() noexcept {
-        proceed = true;
+        setProceed(true);
     }
 
     /**
@@ -123,12 +513,144 @@ public:
      * @param proceed If true threads will proceed, otherwise they will wait.
      */
     void setProceed(bool proceed) noexcept {
-        this->proceed = proceed;
+        this->proceed.store(proceed, std::memory_order_release);
+        if(proceed) events.notifyAll();
     }
 };
 
 
 
+/**
+ * Scalable reader-writer lock (big-reader lock) with the interface of std::shared_mutex.
+ *
+ * Every thread is assigned to one of several reader slots that each live on their own cache line.
+ * A reader only increments and decrements the counter of its slot, therefore readers on different
+ * cores do not contend with each other. A writer announces itself with a flag and waits until
+ * the counters of all slots are zero (writing is more expensive than with std::shared_mutex).
+ *
+ * With writer preference (default) new readers wait as soon as a writer is waiting,
+ * otherwise writers only get the lock once no reader holds it (writers may starve).
+ */
+class StripedSharedMutex {
+private:
+
+    static constexpr uint32_t NO_WRITER = 0;
+    static constexpr uint32_t WRITER_WAITING = 1; // readers may still enter (only without writer preference)
+    static constexpr uint32_t WRITER_ACTIVE = 2; // new readers have to wait
+
+    static constexpr uint32_t SPINS = 128; // spin iterations before yielding
+
+    struct alignas(CACHE_LINE_SIZE) Slot {
+        std::atomic<uint32_t> readers{0};
+    };
+
+    const bool writerPreference;
+    const size_t slotMask;
+    std::unique_ptr<Slot[]> slots;
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> writer{NO_WRITER};
+    std::mutex mWriters; // only one writer announces itself at a time
+
+    static inline void backoff(uint32_t &spins) noexcept {
+        if(spins < SPINS){
+            cpuRelax();
+            spins++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    /** Returns the reader slot of the calling thread. */
+    inline Slot& slot() const noexcept {
+        static std::atomic<size_t> nextThread{0};
+        static thread_local const size_t thread = nextThread.fetch_add(1, std::memory_order_relaxed);
+        return slots[thread & slotMask];
+    }
+
+    inline bool noReaders() const noexcept {
+        for(size_t i=0; i <= slotMask; i++){
+            if(slots[i].readers.load(std::memory_order_seq_cst) != 0) return false;
+        }
+        return true;
+    }
+
+public:
+
+    /**
+     * Creates a new lock.
+     *
+     * @param writerPreference If true new readers wait while a writer is waiting, otherwise readers are preferred.
+     * @param slotCount Amount of reader slots (rounded up to next power of two, default is amount of cores).
+     */
+    StripedSharedMutex(bool writerPreference = true, size_t slotCount = std::thread::hardware_concurrency()) :
+            writerPreference(writerPreference),
+            slotMask(std::bit_ceil(slotCount < 1 ? (size_t)1 : slotCount) - 1),
+            slots(new Slot[slotMask + 1]) {}
+
+    StripedSharedMutex(const StripedSharedMutex&) = delete;
+    StripedSharedMutex& operator=(const StripedSharedMutex&) = delete;
+
+    inline void lock_shared() noexcept {
+        Slot& own = slot();
+        uint32_t spins = 0;
+        while(true){
+            own.readers.fetch_add(1, std::memory_order_seq_cst);
+            const uint32_t state = writer.load(std::memory_order_seq_cst);
+            if(state == NO_WRITER || (state == WRITER_WAITING && !writerPreference)) return;
+            own.readers.fetch_sub(1, std::memory_order_release); // writer active, step back
+            while(writer.load(std::memory_order_acquire) == WRITER_ACTIVE) backoff(spins);
+        }
+    }
+
+    inline void unlock_shared() noexcept {
+        slot().readers.fetch_sub(1, std::memory_order_release);
+    }
+
+    inline void lock() noexcept {
+        mWriters.lock();
+        uint32_t spins = 0;
+        while(true){
+            writer.store(WRITER_ACTIVE, std::memory_order_seq_cst);
+            if(noReaders()) return;
+            if(writerPreference){
+                while(!noReaders()) backoff(spins);
+                return;
+            }
+            writer.store(WRITER_WAITING, std::memory_order_release); // let readers proceed
+            while(!noReaders()) backoff(spins);
+        }
+    }
+
+    inline void unlock() noexcept {
+        writer.store(NO_WRITER, std::memory_order_release);
+        mWriters.unlock();
+    }
+
+    /**
+     * Returns the amount of reader slots.
+     */
+    size_t getSlotCount() const noexcept {
+        return slotMask + 1;
+    }
+};
+
+
+
+/**
+ * Lock ReadOrWriteAccess uses if multithreaded=true.
+ */
+enum class SharedLockMode {
+    /** std::shared_mutex (every reader modifies one shared counter). */
+    SHARED_MUTEX,
+
+    /** StripedSharedMutex preferring readers (readers scale with cores, writers may starve). */
+    STRIPED,
+
+    /** StripedSharedMutex preferring writers (new readers wait while a writer is waiting). */
+    STRIPED_WRITER_PREFERENCE
+};
+
+
+
 /**
  * Synchronizes two groups of threads (one for reading, one for writing) that want to 
  * access a shared resource.
@@ -153,6 +675,15 @@ private:
     volatile bool writersTurn = false;  // whose turn it is (false = reader, true = writer)
 
     std::shared_mutex mtx; // only used if multithreaded=true
+    std::unique_ptr<StripedSharedMutex> striped; // used instead of mtx if created with SharedLockMode::STRIPED*
+
+    inline void lockExclusive() noexcept {
+        if(striped) striped->lock(); else mtx.lock();
+    }
+
+    inline void unlockExclusive() noexcept {
+        if(striped) striped->unlock(); else mtx.unlock();
+    }
 
 public:
 
@@ -162,10 +693,13 @@ public:
      * @param reduceCpuUsage If true the object will use less cpu resources but will be slower.
      * @param multithreaded Set to true if there are multiple readers or multiple writer threads (if only one per group set to false).
      * @param simultaneousReads If true multiple readers can access the resource simultaneously (only relevant if multithreaded=true).
+     * @param sharedLockMode Lock used if multithreaded=true (SharedLockMode::STRIPED* scales better for read-mostly workloads).
      */
     ReadOrWriteAccess(
-        bool reduceCpuUsage, bool multithreaded, bool simultaneousReads
-    ) : reduceCpuUsage(reduceCpuUsage), multithreaded(multithreaded), simultaneousReads(simultaneousReads) {}
+        bool reduceCpuUsage, bool multithreaded, bool simultaneousReads, SharedLockMode sharedLockMode = SharedLockMode::SHARED_MUTEX
+    ) : reduceCpuUsage(reduceCpuUsage), multithreaded(multithreaded), simultaneousReads(simultaneousReads),
+        striped(sharedLockMode == SharedLockMode::SHARED_MUTEX ? nullptr :
+                new StripedSharedMutex(sharedLockMode == SharedLockMode::STRIPED_WRITER_PREFERENCE)) {}
 
 
     /**
@@ -189,7 +723,7 @@ public:
 
         // now first aquire new lock method as well
         if(multithreaded){
-            mtx.lock();
+            lockExclusive();
         } else {
             write = true;
         }
@@ -200,7 +734,7 @@ public:
             // previously not multi threaded
             write = false;
         } else {
-            mtx.unlock();
+            unlockExclusive();
         }
         releaseWrite(); // unlock new method
     }
@@ -212,10 +746,12 @@ public:
      */
     inline void accessRead() noexcept {
         if(multithreaded){
-            if(simultaneousReads){
-                mtx.lock_shared();
+            if(!simultaneousReads){
+                lockExclusive();
+            } else if(striped){
+                striped->lock_shared();
             } else {
-                mtx.lock();
+                mtx.lock_shared();
             }
         } else {
             read = true;
@@ -232,7 +768,7 @@ public:
      */
     inline void accessWrite() noexcept {
         if(multithreaded){
-            mtx.lock();
+            lockExclusive();
         } else {
             write = true;
             writersTurn = false;
@@ -247,10 +783,12 @@ public:
      */
     inline void releaseRead() noexcept {
         if(multithreaded){
-            if(simultaneousReads){
-                mtx.unlock_shared();
+            if(!simultaneousReads){
+                unlockExclusive();
+            } else if(striped){
+                striped->unlock_shared();
             } else {
-                mtx.unlock();
+                mtx.unlock_shared();
             }
         } else {
             read = false;
@@ -262,7 +800,7 @@ public:
      */
     inline void releaseWrite() noexcept {
         if(multithreaded){
-            mtx.unlock();
+            unlockExclusive();
         } else {
             write = false;
         }
@@ -0,0 +1,301 @@
+/**
+ * Copy primitive that picks its strategy by size: inline copies for small buffers,
+ * vector copies for mid sizes and non-temporal (streaming) stores for large buffers.
+ *
+ * @file MemoryCopy.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+
+#ifndef SPI_MEMORY_COPY_HPP
+#define SPI_MEMORY_COPY_HPP
+
+#include "./Executor.hpp"
+#include "./HardwareUtils.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SPI_MEMORY_COPY_X86 1
+#include <immintrin.h>
+#endif
+
+/** Copies up to this many bytes are always a plain (inlined) memcpy. */
+#ifndef SPI_MEMORY_COPY_INLINE_MAX
+#define SPI_MEMORY_COPY_INLINE_MAX 256
+#endif
+
+/** Copies of at least this many bytes use streaming stores. If 0 half of the L3 cache of the first CPU is used. */
+#ifndef SPI_MEMORY_COPY_STREAM_MIN
+#define SPI_MEMORY_COPY_STREAM_MIN 0
+#endif
+
+/** Bytes copied per task by MemoryCopy::copyParallel(). */
+#ifndef SPI_MEMORY_COPY_PARALLEL_CHUNK
+#define SPI_MEMORY_COPY_PARALLEL_CHUNK (4 * 1024 * 1024)
+#endif
+
+namespace spi {
+
+
+/**
+ * How MemoryCopy copies a buffer.
+ */
+enum class CopyStrategy : uint8_t {
+    AUTO,   // picked by size (see MemoryCopy::copy())
+    MEMCPY, // std::memcpy of the C library
+    VECTOR, // unrolled AVX-512/AVX2 loads and stores, destination ends up in the cache
+    STREAM, // non-temporal stores that bypass the cache plus prefetching of the source
+};
+
+
+/**
+ * Copies memory with a strategy that fits the size of the buffer and whether the destination
+ * is read again soon. Streaming stores write whole cache lines to memory without reading them
+ * first and without evicting the working set of other stages from the L3 cache, so buffers
+ * larger than the cache that are only handed on should be copied that way.
+ * The kernels get selected once depending on what the CPU supports (AVX-512, AVX2, SSE2 or memcpy).
+ */
+class MemoryCopy {
+protected:
+    typedef void (*Kernel)(void* dst, const void* src, size_t bytes);
+
+    static constexpr size_t PREFETCH_DISTANCE = 512; // bytes the source gets prefetched ahead of the stores
+
+    static void memcpyKernel(void* dst, const void* src, size_t bytes){
+        std::memcpy(dst, src, bytes);
+    }
+
+    /** Copies bytes until dst is aligned to alignment, returns how many got copied. */
+    static inline size_t alignHead(void* dst, const void* src, size_t bytes, size_t alignment){
+        const size_t head = std::min(bytes, (alignment - ((uintptr_t)dst & (alignment - 1))) & (alignment - 1));
+        if(head > 0) std::memcpy(dst, src, head);
+        return head;
+    }
+
+
+    #ifdef SPI_MEMORY_COPY_X86
+    static void streamSSE2Kernel(void* dst, const void* src, size_t bytes){
+        size_t i = alignHead(dst, src, bytes, 16);
+        uint8_t* d = static_cast<uint8_t*>(dst);
+        const uint8_t* s = static_cast<const uint8_t*>(src);
+        for(; i + 64 <= bytes; i += 64){
+            _mm_prefetch((const char*)(s + i + PREFETCH_DISTANCE), _MM_HINT_NTA);
+            const __m128i a = _mm_loadu_si128((const __m128i*)(s + i));
+            const __m128i b = _mm_loadu_si128((const __m128i*)(s + i + 16));
+            const __m128i c = _mm_loadu_si128((const __m128i*)(s + i + 32));
+            const __m128i e = _mm_loadu_si128((const __m128i*)(s + i + 48));
+            _mm_stream_si128((__m128i*)(d + i), a);
+            _mm_stream_si128((__m128i*)(d + i + 16), b);
+            _mm_stream_si128((__m128i*)(d + i + 32), c);
+            _mm_stream_si128((__m128i*)(d + i + 48), e);
+        }
+        _mm_sfence(); // streaming stores are weakly ordered
+        if(i < bytes) std::memcpy(d + i, s + i, bytes - i);
+    }
+
+    __attribute__((target("avx2")))
+    static void vectorAVX2Kernel(void* dst, const void* src, size_t bytes){
+        uint8_t* d = static_cast<uint8_t*>(dst);
+        const uint8_t* s = static_cast<const uint8_t*>(src);
+        size_t i = 0;
+        for(; i + 128 <= bytes; i += 128){
+            const __m256i a = _mm256_loadu_si256((const __m256i*)(s + i));
+            const __m256i b = _mm256_loadu_si256((const __m256i*)(s + i + 32));
+            const __m256i c = _mm256_loadu_si256((const __m256i*)(s + i + 64));
+            const __m256i e = _mm256_loadu_si256((const __m256i*)(s + i + 96));
+            _mm256_storeu_si256((__m256i*)(d + i), a);
+            _mm256_storeu_si256((__m256i*)(d + i + 32), b);
+            _mm256_storeu_si256((__m256i*)(d + i + 64), c);
+            _mm256_storeu_si256((__m256i*)(d + i + 96), e);
+        }
+        if(i < bytes) std::memcpy(d + i, s + i, bytes - i);
+    }
+
+    __attribute__((target("avx2")))
+    static void streamAVX2Kernel(void* dst, const void* src, size_t bytes){
+        size_t i = alignHead(dst, src, bytes, 32);
+        uint8_t* d = static_cast<uint8_t*>(dst);
+        const uint8_t* s = static_cast<const uint8_t*>(src);
+        for(; i + 128 <= bytes; i += 128){
+            _mm_prefetch((const char*)(s + i + PREFETCH_DISTANCE), _MM_HINT_NTA);
+            _mm_prefetch((const char*)(s + i + PREFETCH_DISTANCE + 64), _MM_HINT_NTA);
+            const __m256i a = _mm256_loadu_si256((const __m256i*)(s + i));
+            const __m256i b = _mm256_loadu_si256((const __m256i*)(s + i + 32));
+            const __m256i c = _mm256_loadu_si256((const __m256i*)(s + i + 64));
+            const __m256i e = _mm256_loadu_si256((const __m256i*)(s + i + 96));
+            _mm256_stream_si256((__m256i*)(d + i), a);
+            _mm256_stream_si256((__m256i*)(d + i + 32), b);
+            _mm256_stream_si256((__m256i*)(d + i + 64), c);
+            _mm256_stream_si256((__m256i*)(d + i + 96), e);
+        }
+        _mm_sfence(); // streaming stores are weakly ordered
+        if(i < bytes) std::memcpy(d + i, s + i, bytes - i);
+    }
+
+    __attribute__((target("avx512f")))
+    static void vectorAVX512Kernel(void* dst, const void* src, size_t bytes){
+        uint8_t* d = static_cast<uint8_t*>(dst);
+        const uint8_t* s = static_cast<const uint8_t*>(src);
+        size_t i = 0;
+        for(; i + 256 <= bytes; i += 256){
+            const __m512i a = _mm512_loadu_si512((const void*)(s + i));
+            const __m512i b = _mm512_loadu_si512((const void*)(s + i + 64));
+            const __m512i c = _mm512_loadu_si512((const void*)(s + i + 128));
+            const __m512i e = _mm512_loadu_si512((const void*)(s + i + 192));
+            _mm512_storeu_si512((void*)(d + i), a);
+            _mm512_storeu_si512((void*)(d + i + 64), b);
+            _mm512_storeu_si512((void*)(d + i + 128), c);
+            _mm512_storeu_si512((void*)(d + i + 192), e);
+        }
+        if(i < bytes) std::memcpy(d + i, s + i, bytes - i);
+    }
+
+    __attribute__((target("avx512f")))
+    static void streamAVX512Kernel(void* dst, const void* src, size_t bytes){
+        size_t i = alignHead(dst, src, bytes, 64);
+        uint8_t* d = static_cast<uint8_t*>(dst);
+        const uint8_t* s = static_cast<const uint8_t*>(src);
+        for(; i + 256 <= bytes; i += 256){
+            for(size_t line=0; line < 256; line += 64)
+                _mm_prefetch((const char*)(s + i + PREFETCH_DISTANCE + line), _MM_HINT_NTA);
+            const __m512i a = _mm512_loadu_si512((const void*)(s + i));
+            const __m512i b = _mm512_loadu_si512((const void*)(s + i + 64));
+            const __m512i c = _mm512_loadu_si512((const void*)(s + i + 128));
+            const __m512i e = _mm512_loadu_si512((const void*)(s + i + 192));
+            _mm512_stream_si512((__m512i*)(d + i), a);
+            _mm512_stream_si512((__m512i*)(d + i + 64), b);
+            _mm512_stream_si512((__m512i*)(d + i + 128), c);
+            _mm512_stream_si512((__m512i*)(d + i + 192), e);
+        }
+        _mm_sfence(); // streaming stores are weakly ordered
+        if(i < bytes) std::memcpy(d + i, s + i, bytes - i);
+    }
+    #endif
+
+
+    struct Dispatch {
+        Kernel vector = &memcpyKernel;
+        Kernel stream = &memcpyKernel;
+        size_t streamMin = SPI_MEMORY_COPY_STREAM_MIN;
+        const char* name = "memcpy";
+
+        Dispatch(){
+            #ifdef SPI_MEMORY_COPY_X86
+            __builtin_cpu_init();
+            if(__builtin_cpu_supports("avx512f")){
+                vector = &vectorAVX512Kernel;
+                stream = &streamAVX512Kernel;
+                name = "AVX-512";
+            } else if(__builtin_cpu_supports("avx2")){
+                vector = &vectorAVX2Kernel;
+                stream = &streamAVX2Kernel;
+                name = "AVX2";
+            } else {
+                stream = &streamSSE2Kernel;
+                name = "SSE2";
+            }
+            #endif
+            if(streamMin == 0){
+                const CpuCache* l3 = HardwareUtils::getTopology().getCache(0, 3);
+                streamMin = l3 != nullptr && l3->size > 0 ? l3->size / 2 : (size_t)4 * 1024 * 1024;
+            }
+        }
+    };
+
+    static const Dispatch& dispatch(){
+        static const Dispatch instance;
+        return instance;
+    }
+
+public:
+
+    /**
+     * Copies bytes from src to dst (must not overlap).
+     * AUTO inlines copies up to SPI_MEMORY_COPY_INLINE_MAX bytes, uses streaming stores
+     * from getStreamThreshold() bytes on and memcpy in between. Pass STREAM explicitly for
+     * smaller destinations that are not read again soon, VECTOR or MEMCPY to keep a large destination cached.
+     *
+     * @param dst Destination of the copy.
+     * @param src Source of the copy.
+     * @param bytes Amount of bytes to copy.
+     * @param strategy How to copy.
+     */
+    static inline void copy(void* dst, const void* src, size_t bytes, CopyStrategy strategy = CopyStrategy::AUTO){
+        switch(strategy){
+            case CopyStrategy::AUTO:
+                if(bytes <= SPI_MEMORY_COPY_INLINE_MAX || bytes < dispatch().streamMin){
+                    std::memcpy(dst, src, bytes);
+                } else {
+                    dispatch().stream(dst, src, bytes);
+                }
+                return;
+            case CopyStrategy::MEMCPY: std::memcpy(dst, src, bytes); return;
+            case CopyStrategy::VECTOR: dispatch().vector(dst, src, bytes); return;
+            case CopyStrategy::STREAM: dispatch().stream(dst, src, bytes); return;
+        }
+    }
+
+    /**
+     * Splits a large copy into chunks that get copied by the given executor (e.g. a ThreadPool),
+     * the calling thread copies the first chunk itself and returns once all chunks are copied.
+     * Worth it if a single core cannot saturate the memory bandwidth (multi-MB buffers).
+     * If the calling thread runs on the executor the chunks are copied inline.
+     *
+     * @param executor Executor that copies the chunks.
+     * @param dst Destination of the copy.
+     * @param src Source of the copy.
+     * @param bytes Amount of bytes to copy.
+     * @param chunkBytes Bytes copied per task (rounded up to whole cache lines).
+     * @param strategy How each chunk gets copied.
+     */
+    template<typename E> requires Executor<E>
+    static void copyParallel(E &executor, void* dst, const void* src, size_t bytes,
+                             size_t chunkBytes = SPI_MEMORY_COPY_PARALLEL_CHUNK, CopyStrategy strategy = CopyStrategy::AUTO){
+        chunkBytes = std::max((size_t)CACHE_LINE_SIZE, (chunkBytes + CACHE_LINE_SIZE - 1) & ~((size_t)CACHE_LINE_SIZE - 1));
+        const size_t chunks = (bytes + chunkBytes - 1) / chunkBytes;
+        if(chunks <= 1){
+            copy(dst, src, bytes, strategy);
+            return;
+        }
+        // shared so a task that finishes last may still notify after the caller returned
+        std::shared_ptr<std::atomic<size_t>> remaining = std::make_shared<std::atomic<size_t>>(chunks - 1);
+        uint8_t* d = static_cast<uint8_t*>(dst);
+        const uint8_t* s = static_cast<const uint8_t*>(src);
+        for(size_t chunk=1; chunk < chunks; chunk++){
+            const size_t offset = chunk * chunkBytes;
+            const size_t size = std::min(chunkBytes, bytes - offset);
+            executeOn(executor, Task([remaining, d, s, offset, size, strategy]{
+                copy(d + offset, s + offset, size, strategy);
+                if(remaining->fetch_sub(1, std::memory_order_acq_rel) == 1) remaining->notify_all();
+            }));
+        }
+        copy(d, s, chunkBytes, strategy);
+        size_t current;
+        while((current = remaining->load(std::memory_order_acquire)) != 0)
+            remaining->wait(current, std::memory_order_acquire);
+    }
+
+    /**
+     * Returns the size from which on CopyStrategy::AUTO uses streaming stores.
+     */
+    static size_t getStreamThreshold(){
+        return dispatch().streamMin;
+    }
+
+    /**
+     * Returns the name of the instruction set the kernels use on this CPU.
+     */
+    static const char* simdName(){
+        return dispatch().name;
+    }
+};
+
+
+}
+
+#endif // SPI_MEMORY_COPY_HPP
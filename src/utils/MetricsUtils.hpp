@@ -8,6 +8,7 @@
 #ifndef SPI_METRICS_UTILS_HPP
 #define SPI_METRICS_UTILS_HPP
 
+#include <algorithm>
 #include <cstdint>
 #include <math.h>
 #include <string>
@@ -73,8 +74,8 @@ public:
      * @return std::string Value as string
      */
     static std::string roundToString(double value, size_t digitsAfterComma = 1){
-        size_t factor = 1 << digitsAfterComma;
-        value = std::round(value * (double)factor) / (double)factor;
+        double factor = std::pow(10.0, (double)digitsAfterComma);
+        value = std::round(value * factor) / factor;
         uint64_t intValue = (uint64_t)value;
         double remainder = value - (double)intValue;
         
@@ -88,11 +89,8 @@ public:
         // add remainder
         if(digitsAfterComma > 0){
             result += ".";
-            for(size_t i = 0; i < digitsAfterComma; i++){
-                remainder *= 10;
-                result += std::to_string((uint64_t)remainder);
-                remainder -= (uint64_t)remainder;
-            }
+            std::string digits = std::to_string((uint64_t)std::round(remainder * factor));
+            result += std::string(digitsAfterComma - std::min(digitsAfterComma, digits.length()), '0') + digits;
         }
 
         return result;
@@ -205,6 +203,20 @@ public:
         return roundToString((double)microseconds / (double)prevLimit, digitsAfterComma)+"d";
     }
 
+    /**
+     * Converts a given duration in nanoseconds into a human readable string e.g. 1.2us
+     * 
+     * @param nanoseconds Duration in nanoseconds
+     * @param digitsAfterComma Amount of digits after comma (precision)
+     * @return std::string Human readable string
+     */
+    static std::string nanosecondsToString(int64_t nanoseconds, size_t digitsAfterComma = 1){
+        const uint64_t absNanoseconds = (uint64_t)(nanoseconds < 0 ? -nanoseconds : nanoseconds);
+        if(absNanoseconds < 1000) return std::to_string(nanoseconds)+"ns";
+        if(absNanoseconds < 1000000) return roundToString((double)nanoseconds / 1000.0, digitsAfterComma)+"us";
+        return microsecondsToString(nanoseconds / 1000, digitsAfterComma);
+    }
+
 };
 
 
@@ -0,0 +1,107 @@
+/**
+ * STL compatible allocator that places memory on a given NUMA node and optionally backs it with huge pages.
+ *
+ * @file NumaAllocator.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+
+#ifndef SPI_NUMA_ALLOCATOR_HPP
+#define SPI_NUMA_ALLOCATOR_HPP
+
+#include "./HardwareUtils.hpp"
+
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <type_traits>
+
+namespace spi {
+
+
+
+/**
+ * Allocator that gets its memory from HardwareUtils::allocateMemory().
+ * Can be passed to STL containers, RecycleObjectStore* and the ring based queues.
+ *
+ * IMPORTANT:   every allocation is rounded up to whole pages, only use it for
+ *              buffers and chunks (e.g. std::vector, slabs) and not for single small objects!
+ *
+ * @tparam T Type of the allocated objects.
+ */
+template<typename T>
+class NumaAllocator {
+public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    template<typename U>
+    struct rebind {
+        typedef NumaAllocator<U> other;
+    };
+
+protected:
+    int numaNode;
+    PageSize pageSize;
+    bool populate;
+
+    template<typename U> friend class NumaAllocator;
+
+public:
+
+    /**
+     * Creates an allocator.
+     *
+     * @param numaNode NUMA node the memory should be located on or -1 for the default policy (first touch).
+     * @param pageSize Size of the pages backing the memory.
+     * @param populate If true memory gets faulted in when allocated (otherwise on first access).
+     */
+    NumaAllocator(int numaNode = -1, PageSize pageSize = PageSize::DEFAULT, bool populate = false) noexcept :
+            numaNode(numaNode), pageSize(pageSize), populate(populate) {}
+
+    template<typename U>
+    NumaAllocator(const NumaAllocator<U> &other) noexcept :
+            numaNode(other.numaNode), pageSize(other.pageSize), populate(other.populate) {}
+
+    /**
+     * Returns an allocator for the NUMA node of the calling thread.
+     */
+    static NumaAllocator local(PageSize pageSize = PageSize::DEFAULT, bool populate = false){
+        return NumaAllocator(HardwareUtils::currentNumaNode(), pageSize, populate);
+    }
+
+    T* allocate(size_t count){
+        if(count > std::numeric_limits<size_t>::max() / sizeof(T)) throw std::bad_array_new_length();
+        static_assert(alignof(T) <= 4096, "NumaAllocator only guarantees page alignment");
+        return static_cast<T*>(HardwareUtils::allocateMemory(count * sizeof(T), numaNode, pageSize, populate));
+    }
+
+    void deallocate(T* memory, size_t count) noexcept {
+        HardwareUtils::freeMemory(memory, count * sizeof(T), pageSize);
+    }
+
+    inline int getNumaNode() const noexcept {
+        return numaNode;
+    }
+
+    inline PageSize getPageSize() const noexcept {
+        return pageSize;
+    }
+
+    template<typename U>
+    inline bool operator==(const NumaAllocator<U> &other) const noexcept {
+        return numaNode == other.numaNode && pageSize == other.pageSize;
+    }
+
+    template<typename U>
+    inline bool operator!=(const NumaAllocator<U> &other) const noexcept {
+        return !(*this == other);
+    }
+};
+
+
+
+}
+
+#endif // SPI_NUMA_ALLOCATOR_HPP
@@ -0,0 +1,187 @@
+/**
+ * Common interface for all queue implementations so they can be used (and benchmarked) interchangeably.
+ *
+ * @file QueueAdapter.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+
+#ifndef SPI_QUEUE_ADAPTER_HPP
+#define SPI_QUEUE_ADAPTER_HPP
+
+#include "./QueueAtomic.hpp"
+#include "./QueueLock.hpp"
+#include "./QueueMoodyCamel.hpp"
+#include "./QueueRing.hpp"
+#include "./QueueTwoPartyAtomic.hpp"
+#include "./QueueTwoPartyHighContention.hpp"
+#include "./QueueTwoPartyNoCritical.hpp"
+#include "./QueueTwoPartyRing.hpp"
+
+#include <concepts>
+#include <cstddef>
+
+namespace spi {
+
+
+
+/**
+ * Unified queue interface.
+ *
+ * push() always succeeds (bounded queues wait for space),
+ * pop() returns false if the queue is empty,
+ * pushBulk()/popBulk() return how many elements got pushed/popped,
+ * popAndCheckNext() additionally tells if more elements are left.
+ * multiProducer/multiConsumer tell how many threads may push/pop concurrently,
+ * concurrent tells if pushing and popping may happen on different threads at all.
+ */
+template<typename Q, typename T>
+concept Queue = requires(Q& queue, const T& value, T& result, const T* values, T* results, size_t count, bool& hasMore){
+    queue.push(value);
+    { queue.pop(result) } -> std::convertible_to<bool>;
+    { queue.pushBulk(values, count) } -> std::convertible_to<size_t>;
+    { queue.popBulk(results, count) } -> std::convertible_to<size_t>;
+    { queue.popAndCheckNext(result, hasMore) } -> std::convertible_to<bool>;
+    { Q::multiProducer } -> std::convertible_to<bool>;
+    { Q::multiConsumer } -> std::convertible_to<bool>;
+    { Q::concurrent } -> std::convertible_to<bool>;
+};
+
+
+
+/**
+ * Describes the element type and thread-safety of a queue implementation.
+ * Needs to be specialized for every queue that should be used with QueueAdapter.
+ */
+template<typename Q>
+struct QueueTraits;
+
+template<typename T, bool MultiProducer, bool MultiConsumer, bool Concurrent = true>
+struct BasicQueueTraits {
+    typedef T ValueType;
+    static constexpr bool multiProducer = MultiProducer;
+    static constexpr bool multiConsumer = MultiConsumer;
+    static constexpr bool concurrent = Concurrent;
+};
+
+template<typename T>
+struct QueueTraits<QueueAtomic<T>> : BasicQueueTraits<T, true, true> {};
+
+template<typename T, typename LockType>
+struct QueueTraits<QueueLock<T, LockType>> : BasicQueueTraits<T, true, true> {};
+
+template<typename T, typename LockType>
+struct QueueTraits<QueueLockCustom<T, LockType>> : BasicQueueTraits<T, true, true> {};
+
+template<typename T, typename Traits>
+struct QueueTraits<moodycamel::ConcurrentQueue<T, Traits>> : BasicQueueTraits<T, true, true> {};
+
+template<typename T, typename Allocator>
+struct QueueTraits<QueueRing<T, Allocator>> : BasicQueueTraits<T, true, true> {};
+
+template<typename T>
+struct QueueTraits<QueueTwoPartyAtomic<T>> : BasicQueueTraits<T, false, false> {};
+
+template<typename T>
+struct QueueTraits<QueueTwoPartyHighContention<T>> : BasicQueueTraits<T, true, true> {};
+
+template<typename T>
+struct QueueTraits<QueueTwoPartyNoCritical<T>> : BasicQueueTraits<T, false, false> {};
+
+template<typename T, typename Allocator>
+struct QueueTraits<QueueTwoPartyRing<T, Allocator>> : BasicQueueTraits<T, false, false> {};
+
+
+
+/**
+ * Wraps a queue implementation and exposes the unified Queue interface.
+ * Operations the queue does not offer natively (e.g. bulk operations) are emulated.
+ *
+ * @tparam Q Type of the wrapped queue (requires a QueueTraits specialization).
+ */
+template<typename Q>
+class QueueAdapter {
+public:
+    typedef typename QueueTraits<Q>::ValueType ValueType;
+    static constexpr bool multiProducer = QueueTraits<Q>::multiProducer;
+    static constexpr bool multiConsumer = QueueTraits<Q>::multiConsumer;
+    static constexpr bool concurrent = QueueTraits<Q>::concurrent;
+
+protected:
+    Q& queue;
+
+public:
+
+    QueueAdapter(Q& queue) noexcept : queue(queue) {}
+
+    /**
+     * Returns the wrapped queue.
+     */
+    inline Q& get() noexcept {
+        return queue;
+    }
+
+    inline void push(const ValueType& value){
+        if constexpr (requires { queue.enqueue(value); }) queue.enqueue(value);
+        else queue.push(value);
+    }
+
+    inline bool pop(ValueType& result){
+        if constexpr (requires { queue.try_dequeue(result); }) return queue.try_dequeue(result);
+        else return queue.pop(result);
+    }
+
+    /**
+     * Pushes up to count elements.
+     *
+     * @return Amount of elements that got pushed (less than count only for bounded queues that are full).
+     */
+    inline size_t pushBulk(const ValueType* values, size_t count){
+        if constexpr (requires { queue.push_bulk(values, count); }){
+            return queue.push_bulk(values, count);
+        } else if constexpr (requires { queue.enqueue_bulk(values, count); }){
+            return queue.enqueue_bulk(values, count) ? count : 0;
+        } else {
+            for(size_t i=0; i < count; i++) queue.push(values[i]);
+            return count;
+        }
+    }
+
+    /**
+     * Pops up to max elements.
+     *
+     * @return Amount of elements that got popped (0 if the queue is empty).
+     */
+    inline size_t popBulk(ValueType* results, size_t max){
+        if constexpr (requires { queue.pop_bulk(results, max); }){
+            return queue.pop_bulk(results, max);
+        } else if constexpr (requires { queue.try_dequeue_bulk(results, max); }){
+            return queue.try_dequeue_bulk(results, max);
+        } else {
+            size_t count = 0;
+            while(count < max && queue.pop(results[count])) count++;
+            return count;
+        }
+    }
+
+    /**
+     * Pops an element and tells if more elements are left (only a snapshot under concurrency).
+     */
+    inline bool popAndCheckNext(ValueType& result, bool& hasMore){
+        if constexpr (requires { queue.popAndCheckNext(result, hasMore); }){
+            return queue.popAndCheckNext(result, hasMore);
+        } else if constexpr (requires { queue.size_approx(); }){
+            bool popped = queue.try_dequeue(result);
+            hasMore = queue.size_approx() > 0;
+            return popped;
+        } else {
+            bool popped = queue.pop(result);
+            hasMore = !queue.empty();
+            return popped;
+        }
+    }
+};
+
+
+}
+
+#endif // SPI_QUEUE_ADAPTER_HPP
@@ -1,83 +1,169 @@
 /**
  * Non-blocking thread-safe queue implementation that uses a linked list scheme.
  * 
- * @file Queue.hpp
+ * @file QueueAtomic.hpp
  * @author Luca Vogels (github@luca-vogels.com)
  */
 
 #ifndef SPI_QUEUE_ATOMIC_HPP
 #define SPI_QUEUE_ATOMIC_HPP
 
-#include <atomic>
+#include "./EpochReclamation.hpp"
+#include "./HardwareUtils.hpp"
 
-#include <iostream> // TODO REMOVE
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <utility>
 
 namespace spi {
 
 
+/**
+ * Unbounded queue for any number of producers and consumers.
+ *
+ * Producers append with a single exchange on the tail and link the previous tail afterwards
+ * (wait-free, one allocation per element). Consumers advance the head with a CAS and retire
+ * the old sentinel through EpochReclamation, so a consumer that still reads it never touches freed memory.
+ * An element whose producer did not link it yet is not visible to consumers.
+ */
 template<typename T>
 class QueueAtomic {
 protected:
 
     struct Node {
         T data;
-        Node* next;
+        std::atomic<Node*> next{nullptr};
 
-        Node(T data, Node* next) : data(data), next(next) {}
+        Node() = default;
+        Node(const T &data) : data(data) {}
 
+        template<typename... Args>
+        Node(std::in_place_t, Args&&... args) : data(std::forward<Args>(args)...) {}
     };
 
-    alignas(alignof(Node*)) std::atomic<Node*> head{nullptr};
-    alignas(alignof(Node*)) std::atomic<Node*> tail{nullptr};
+    inline void link(Node* newNode) noexcept {
+        // the previous tail cannot be retired before it got linked, so no guard is needed
+        Node* oldTail = tail.exchange(newNode, std::memory_order_acq_rel);
+        oldTail->next.store(newNode, std::memory_order_release);
+    }
+
+    alignas(CACHE_LINE_SIZE) std::atomic<Node*> head{nullptr}; // sentinel, its next is the oldest element
+    alignas(CACHE_LINE_SIZE) std::atomic<Node*> tail{nullptr};
 
 public:
 
     QueueAtomic(){
-        Node* sentinel = new Node(T(), nullptr);
+        Node* sentinel = new Node();
         head.store(sentinel);
         tail.store(sentinel);
     }
 
+    QueueAtomic(const QueueAtomic&) = delete;
+    QueueAtomic& operator=(const QueueAtomic&) = delete;
+
 
     void push(T data) {
-        Node* newNode = new Node(data, nullptr);
-        while(true){
-            Node* oldTail = tail.load();
-            if(tail.compare_exchange_weak(oldTail, newNode)){
-                oldTail->next = newNode;
-                break;
-            }
-        }
+        link(new Node(std::in_place, std::move(data)));
+    }
+
+    /**
+     * Constructs the element in place in its node (single allocation, no copy or move of the element).
+     */
+    template<typename... Args>
+    void emplace(Args&&... args) {
+        link(new Node(std::in_place, std::forward<Args>(args)...));
     }
 
     bool pop(T& data) {
+        EpochReclamation::Guard guard;
+        Node* oldHead = head.load(std::memory_order_acquire);
         while(true){
-            Node* oldHead = head.load();
-            Node* oldTail = tail.load();
-            Node* firstNode = oldHead->next;
-
-            if(oldHead == oldTail){
-                if(firstNode == nullptr) return false;
-                // Help other threads complete push operation
-                tail.compare_exchange_weak(oldTail, firstNode);
-            } else {
-                if(head.compare_exchange_weak(oldHead, firstNode)){
-                    data = firstNode->data;
-                    delete oldHead;
-                    return true;
-                }
+            Node* firstNode = oldHead->next.load(std::memory_order_acquire);
+            if(firstNode == nullptr) return false;
+            if(head.compare_exchange_weak(oldHead, firstNode, std::memory_order_acq_rel, std::memory_order_acquire)){
+                data = std::move(firstNode->data); // only the consumer that advanced the head reads the element
+                EpochReclamation::retire(oldHead);
+                return true;
             }
         }
     }
 
+    /**
+     * Links nodes for all elements of a range first and appends the whole chain
+     * with a single exchange on the tail.
+     *
+     * @return size_t Amount of elements pushed.
+     */
+    template<std::input_iterator Iterator>
+    size_t push_bulk(Iterator first, Iterator last) {
+        if(first == last) return 0;
+        Node* chainHead = new Node(*first);
+        Node* chainTail = chainHead;
+        size_t count = 1;
+        for(++first; first != last; ++first, ++count){
+            Node* node = new Node(*first);
+            chainTail->next.store(node, std::memory_order_relaxed);
+            chainTail = node;
+        }
+        Node* oldTail = tail.exchange(chainTail, std::memory_order_acq_rel);
+        oldTail->next.store(chainHead, std::memory_order_release); // publishes the whole chain
+        return count;
+    }
+
+    /**
+     * Links nodes for count elements first and appends the whole chain
+     * with a single exchange on the tail.
+     *
+     * @return size_t Amount of elements pushed (always count).
+     */
+    size_t push_bulk(const T* values, size_t count) {
+        return push_bulk(values, values + count);
+    }
+
+    /**
+     * Takes up to max linked elements with a single CAS that moves the head
+     * to the last taken node, which becomes the new sentinel.
+     *
+     * @param out Iterator the popped elements get written to.
+     * @param max Maximum amount of elements to pop.
+     * @return size_t Amount of elements popped (0 if the queue is empty).
+     */
+    template<typename OutputIterator>
+    size_t pop_bulk(OutputIterator out, size_t max) {
+        if(max == 0) return 0;
+        EpochReclamation::Guard guard;
+        Node* oldHead = head.load(std::memory_order_acquire);
+        Node* lastNode;
+        size_t count;
+        do {
+            lastNode = oldHead;
+            count = 0;
+            for(Node* next; count < max && (next = lastNode->next.load(std::memory_order_acquire)) != nullptr; count++)
+                lastNode = next;
+            if(count == 0) return 0;
+        } while(!head.compare_exchange_weak(oldHead, lastNode, std::memory_order_acq_rel, std::memory_order_acquire));
+
+        // nodes up to lastNode belong to this consumer now, lastNode stays as sentinel
+        Node* node = oldHead;
+        for(size_t i=0; i < count; i++, ++out){
+            Node* next = node->next.load(std::memory_order_acquire);
+            *out = std::move(next->data);
+            EpochReclamation::retire(node);
+            node = next;
+        }
+        return count;
+    }
+
     bool empty() {
-        return head.load()->next.load() == nullptr;
+        EpochReclamation::Guard guard;
+        return head.load(std::memory_order_acquire)->next.load(std::memory_order_acquire) == nullptr;
     }
 
     ~QueueAtomic() {
-        Node* h = this->head;
+        Node* h = this->head.load(std::memory_order_relaxed);
         while(h != nullptr) {
-            Node* n = h->next;
+            Node* n = h->next.load(std::memory_order_relaxed);
             delete h;
             h = n;
         }
@@ -90,4 +176,4 @@ public:
 
 }
 
-#endif // SPI_QUEUE_ATOMIC_HPP
\ No newline at end of file
+#endif // SPI_QUEUE_ATOMIC_HPP
@@ -0,0 +1,128 @@
+/**
+ * Wrapper that lets consumers of any queue sleep while it is empty.
+ *
+ * @file QueueBlocking.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+
+#ifndef SPI_QUEUE_BLOCKING_HPP
+#define SPI_QUEUE_BLOCKING_HPP
+
+#include "./Lock.hpp"
+#include "./QueueAdapter.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace spi {
+
+
+/**
+ * Adds blocking pops to a queue. Consumers that find the queue empty park on an EventCount
+ * instead of spinning, producers only wake them if one is actually sleeping.
+ * While the queue is non-empty every call is a plain call of the wrapped queue.
+ * Offers the unified Queue interface, so it can be used wherever a QueueAdapter is used.
+ *
+ * All pushes need to go through the wrapper, otherwise sleeping consumers are not notified.
+ *
+ * @tparam Q Type of the wrapped queue (requires a QueueTraits specialization).
+ */
+template<typename Q>
+class QueueBlocking {
+public:
+    typedef typename QueueAdapter<Q>::ValueType ValueType;
+    static constexpr bool multiProducer = QueueAdapter<Q>::multiProducer;
+    static constexpr bool multiConsumer = QueueAdapter<Q>::multiConsumer;
+    static constexpr bool concurrent = QueueAdapter<Q>::concurrent;
+
+protected:
+    QueueAdapter<Q> queue;
+    EventCount events;
+    std::atomic<bool> closed{false};
+
+public:
+
+    QueueBlocking(Q& queue) noexcept : queue(queue) {}
+
+    /**
+     * Returns the wrapped queue.
+     */
+    inline Q& get() noexcept {
+        return queue.get();
+    }
+
+    inline void push(const ValueType& value){
+        queue.push(value);
+        events.notifyOne();
+    }
+
+    inline size_t pushBulk(const ValueType* values, size_t count){
+        const size_t pushed = queue.pushBulk(values, count);
+        if(pushed > 1) events.notifyAll();
+        else if(pushed == 1) events.notifyOne();
+        return pushed;
+    }
+
+    inline bool pop(ValueType& result){
+        return queue.pop(result);
+    }
+
+    inline size_t popBulk(ValueType* results, size_t max){
+        return queue.popBulk(results, max);
+    }
+
+    inline bool popAndCheckNext(ValueType& result, bool& hasMore){
+        return queue.popAndCheckNext(result, hasMore);
+    }
+
+    /**
+     * Pops an element and sleeps while the queue is empty.
+     *
+     * @return True if an element got popped, false if the queue is empty and got closed.
+     */
+    bool popWait(ValueType& result){
+        if(queue.pop(result)) return true;
+        bool popped = false;
+        events.await([&]{ return (popped = queue.pop(result)) || closed.load(std::memory_order_acquire); });
+        return popped || queue.pop(result);
+    }
+
+    /**
+     * Pops up to max elements and sleeps while the queue is empty.
+     *
+     * @return Amount of elements popped, 0 only if the queue is empty and got closed.
+     */
+    size_t popBulkWait(ValueType* results, size_t max){
+        if(max == 0) return 0;
+        size_t count = queue.popBulk(results, max);
+        if(count > 0) return count;
+        events.await([&]{ return (count = queue.popBulk(results, max)) > 0 || closed.load(std::memory_order_acquire); });
+        return count > 0 ? count : queue.popBulk(results, max);
+    }
+
+    /**
+     * Wakes all sleeping consumers and lets popWait() and popBulkWait() return
+     * once the queue is empty instead of sleeping.
+     */
+    void close() noexcept {
+        closed.store(true, std::memory_order_release);
+        events.notifyAll();
+    }
+
+    bool isClosed() const noexcept {
+        return closed.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Returns the amount of consumers currently sleeping (or about to).
+     */
+    uint32_t getWaiting() const noexcept {
+        return events.getWaiting();
+    }
+};
+
+
+}
+
+#endif // SPI_QUEUE_BLOCKING_HPP
@@ -10,22 +10,37 @@
 
 #include "./Lock.hpp"
 
-#include <queue>
+#include <cstddef>
+#include <iterator>
 #include <mutex>
+#include <queue>
+#include <utility>
 
 namespace spi {
 
 
-template<typename T>
+/**
+ * Queue protected by a lock.
+ *
+ * @tparam T Type of the elements.
+ * @tparam LockType Lock protecting the queue (Lock, TicketLock, MCSLock, std::mutex, ...).
+ */
+template<typename T, typename LockType = Lock>
 class QueueLock {
 protected:
 
-    Lock lock;
+    LockType lock;
     std::queue<T> queue;
 
 public:
 
-    QueueLock(bool reduceCpuUsage) : lock(reduceCpuUsage) {}
+    /**
+     * Creates an empty queue.
+     *
+     * @param lockArgs Arguments passed to the constructor of the lock (e.g. reduceCpuUsage or LockMode for Lock).
+     */
+    template<typename... LockArgs>
+    QueueLock(LockArgs&&... lockArgs) : lock(std::forward<LockArgs>(lockArgs)...) {}
 
     ~QueueLock() noexcept {
         cancelAll();
@@ -69,6 +84,48 @@ public:
         return true;
     }
 
+    /**
+     * Pushes all elements of a range while holding the lock once.
+     *
+     * @return size_t Amount of elements pushed.
+     */
+    template<std::input_iterator Iterator>
+    size_t push_bulk(Iterator first, Iterator last){
+        size_t count = 0;
+        lock.lock();
+        for(; first != last; ++first, ++count) queue.push(*first);
+        lock.unlock();
+        return count;
+    }
+
+    /**
+     * Pushes count elements while holding the lock once.
+     *
+     * @return size_t Amount of elements pushed (always count).
+     */
+    size_t push_bulk(const T* values, size_t count){
+        return push_bulk(values, values + count);
+    }
+
+    /**
+     * Pops up to max elements while holding the lock once.
+     *
+     * @param out Iterator the popped elements get written to.
+     * @param max Maximum amount of elements to pop.
+     * @return size_t Amount of elements popped (0 if the queue is empty).
+     */
+    template<typename OutputIterator>
+    size_t pop_bulk(OutputIterator out, size_t max){
+        size_t count = 0;
+        lock.lock();
+        for(; count < max && !queue.empty(); ++count, ++out){
+            *out = std::move(queue.front());
+            queue.pop();
+        }
+        lock.unlock();
+        return count;
+    }
+
     bool empty() noexcept {
         lock.lock();
         bool result = queue.empty();
@@ -80,7 +137,13 @@ public:
 
 
 
-template<typename T>
+/**
+ * Linked list queue protected by a lock.
+ *
+ * @tparam T Type of the elements.
+ * @tparam LockType Lock protecting the queue (Lock, TicketLock, MCSLock, std::mutex, ...).
+ */
+template<typename T, typename LockType = Lock>
 class QueueLockCustom {
 protected:
 
@@ -91,13 +154,19 @@ protected:
         Node(T data, Node* next) : data(data), next(next) {}
     };
 
-    Lock lock;
+    LockType lock;
     Node* head;
     Node* tail;
 
 public:
 
-    QueueLockCustom(bool reduceCpuUsage) : lock(reduceCpuUsage), head(nullptr), tail(nullptr) {}
+    /**
+     * Creates an empty queue.
+     *
+     * @param lockArgs Arguments passed to the constructor of the lock (e.g. reduceCpuUsage or LockMode for Lock).
+     */
+    template<typename... LockArgs>
+    QueueLockCustom(LockArgs&&... lockArgs) : lock(std::forward<LockArgs>(lockArgs)...), head(nullptr), tail(nullptr) {}
 
     ~QueueLockCustom() noexcept {
         cancelAll();
@@ -159,6 +228,73 @@ public:
         return true;
     }
 
+    /**
+     * Links nodes for all elements of a range before taking the lock,
+     * then appends the whole chain while holding the lock once.
+     *
+     * @return size_t Amount of elements pushed.
+     */
+    template<std::input_iterator Iterator>
+    size_t push_bulk(Iterator first, Iterator last){
+        if(first == last) return 0;
+        Node* chainHead = new Node(*first, nullptr);
+        Node* chainTail = chainHead;
+        size_t count = 1;
+        for(++first; first != last; ++first, ++count){
+            chainTail->next = new Node(*first, nullptr);
+            chainTail = chainTail->next;
+        }
+        lock.lock();
+        if(tail != nullptr) {
+            tail->next = chainHead;
+        } else {
+            head = chainHead;
+        }
+        tail = chainTail;
+        lock.unlock();
+        return count;
+    }
+
+    /**
+     * Links nodes for count elements before taking the lock,
+     * then appends the whole chain while holding the lock once.
+     *
+     * @return size_t Amount of elements pushed (always count).
+     */
+    size_t push_bulk(const T* values, size_t count){
+        return push_bulk(values, values + count);
+    }
+
+    /**
+     * Detaches up to max nodes while holding the lock once,
+     * their elements get moved out and the nodes freed after unlocking.
+     *
+     * @param out Iterator the popped elements get written to.
+     * @param max Maximum amount of elements to pop.
+     * @return size_t Amount of elements popped (0 if the queue is empty).
+     */
+    template<typename OutputIterator>
+    size_t pop_bulk(OutputIterator out, size_t max){
+        if(max == 0) return 0;
+        lock.lock();
+        Node* chain = head;
+        Node* last = nullptr;
+        size_t count = 0;
+        for(Node* node = head; node != nullptr && count < max; node = node->next, count++) last = node;
+        if(last != nullptr){
+            head = last->next;
+            if(head == nullptr) tail = nullptr;
+        }
+        lock.unlock();
+        for(size_t i=0; i < count; i++, ++out){
+            *out = std::move(chain->data);
+            Node* next = chain->next;
+            delete chain;
+            chain = next;
+        }
+        return count;
+    }
+
     bool empty() noexcept {
         lock.lock();
         bool result = head == nullptr;
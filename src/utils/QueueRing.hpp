@@ -1,80 +1,177 @@
 /**
- * Non-blocking thread-safe queue implementation that uses a linked list scheme.
- * 
- * @file Queue.hpp
+ * Bounded non-blocking thread-safe queue implementation that uses a ring buffer scheme.
+ *
+ * @file QueueRing.hpp
  * @author Luca Vogels (github@luca-vogels.com)
  */
 
 #ifndef SPI_QUEUE_RING_HPP
 #define SPI_QUEUE_RING_HPP
 
+#include "./HardwareUtils.hpp"
+
 #include <atomic>
-#include <vector>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
 
 namespace spi {
 
 
-template<typename T>
+/**
+ * Bounded multi-producer/multi-consumer queue that uses a ring buffer scheme.
+ *
+ * Every slot carries its own sequence number that tells producers and consumers
+ * if the slot is free to write or ready to read. Therefore a consumer never
+ * reads a slot before the producer has finished writing it and each operation
+ * only needs a single CAS on either head or tail.
+ *
+ * IMPORTANT:   Capacity gets rounded up to the next power of two.
+ * IMPORTANT:   Fully thread-safe for any amount of pushing and popping threads.
+ *
+ * @tparam T Type of elements stored in the queue.
+ * @tparam Allocator Allocator of the ring buffer (e.g. NumaAllocator).
+ */
+template<typename T, typename Allocator = std::allocator<T>>
 class QueueRing {
 protected:
 
-    std::vector<T> data;
-    std::atomic<size_t> readOffset{0};
-    std::atomic<size_t> writeOffset{0};
-    std::atomic<size_t> count{0};
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Slot> SlotAllocator;
+    typedef std::allocator_traits<SlotAllocator> SlotAllocatorTraits;
 
-public:
+    const size_t capacity;
+    const size_t mask;
+    SlotAllocator allocator;
+    Slot* const slots;
 
-    QueueRing(size_t size){
-        data.resize(size);
-    }
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail{0}; // next position to push to (producers)
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head{0}; // next position to pop from (consumers)
 
+public:
 
-    void push(T data){
-        size_t oldCount = count.load();
-        if(oldCount == this->data.size()) throw std::runtime_error("Queue is full");
-        while(!count.compare_exchange_weak(oldCount, oldCount + 1)){
-            oldCount = count.load();
-            if(oldCount == this->data.size()) throw std::runtime_error("Queue is full");
+    /**
+     * Creates a new bounded queue.
+     *
+     * @param size Minimum amount of elements the queue can hold (rounded up to next power of two).
+     * @param allocator Allocator of the ring buffer.
+     */
+    QueueRing(size_t size, const Allocator &allocator = Allocator()) :
+            capacity(std::bit_ceil(size < 2 ? (size_t)2 : size)), mask(capacity - 1),
+            allocator(allocator), slots(SlotAllocatorTraits::allocate(this->allocator, capacity)) {
+        for(size_t i=0; i < capacity; i++){
+            SlotAllocatorTraits::construct(this->allocator, slots + i);
+            slots[i].sequence.store(i, std::memory_order_relaxed);
         }
+    }
 
-        size_t oldWriteOffset = writeOffset.load();
-        size_t newWriteOffset = (oldWriteOffset + 1) % this->data.size();
-        while(!writeOffset.compare_exchange_weak(oldWriteOffset, newWriteOffset)){
-            oldWriteOffset = writeOffset.load();
-            newWriteOffset = (oldWriteOffset + 1) % this->data.size();
-        }
+    QueueRing(const QueueRing&) = delete;
+    QueueRing& operator=(const QueueRing&) = delete;
 
-        this->data[oldWriteOffset] = data;
+    ~QueueRing() {
+        for(size_t i=0; i < capacity; i++)
+            SlotAllocatorTraits::destroy(allocator, slots + i);
+        SlotAllocatorTraits::deallocate(allocator, slots, capacity);
     }
 
-    bool pop(T& data) noexcept {
-        size_t oldCount = count.load();
-        if(oldCount == 0) return false;
-        while(!count.compare_exchange_weak(oldCount, oldCount - 1)){
-            oldCount = count.load();
-            if(oldCount == 0) return false;
+    /**
+     * Tries to push an element into the queue.
+     *
+     * @param data Element to push.
+     * @return true if pushed, false if the queue is full.
+     */
+    inline bool try_push(T data) noexcept {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        while(true){
+            Slot &slot = slots[pos & mask];
+            const size_t seq = slot.sequence.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if(diff == 0){
+                // slot is free, try to claim it
+                if(tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                    slot.data = std::move(data);
+                    slot.sequence.store(pos + 1, std::memory_order_release); // publish to consumers
+                    return true;
+                }
+            } else if(diff < 0){
+                return false; // slot still holds an element of the previous round -> full
+            } else {
+                pos = tail.load(std::memory_order_relaxed); // another producer was faster
+            }
         }
+    }
 
-        size_t oldReadOffset = readOffset.load();
-        size_t newReadOffset = (oldReadOffset + 1) % this->data.size();
-        while(!readOffset.compare_exchange_weak(oldReadOffset, newReadOffset)){
-            oldReadOffset = readOffset.load();
-            newReadOffset = (oldReadOffset + 1) % this->data.size();
+    /**
+     * Tries to pop an element from the queue.
+     *
+     * @param data Reference the popped element gets written to.
+     * @return true if popped, false if the queue is empty.
+     */
+    inline bool try_pop(T& data) noexcept {
+        size_t pos = head.load(std::memory_order_relaxed);
+        while(true){
+            Slot &slot = slots[pos & mask];
+            const size_t seq = slot.sequence.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if(diff == 0){
+                // slot is ready, try to claim it
+                if(head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                    data = std::move(slot.data);
+                    slot.sequence.store(pos + capacity, std::memory_order_release); // free slot for next round
+                    return true;
+                }
+            } else if(diff < 0){
+                return false; // slot not written yet -> empty
+            } else {
+                pos = head.load(std::memory_order_relaxed); // another consumer was faster
+            }
         }
+    }
 
-        data = this->data[oldReadOffset];
-        return true;
+    /**
+     * Pushes an element into the queue.
+     * If the queue is full the calling thread yields until space is available.
+     *
+     * @param data Element to push.
+     */
+    inline void push(T data) noexcept {
+        while(!try_push(data))
+            std::this_thread::yield();
     }
 
-    bool empty() noexcept {
-        return count.load() == 0;
+    /**
+     * Pops an element from the queue.
+     *
+     * @param data Reference the popped element gets written to.
+     * @return true if popped, false if the queue is empty.
+     */
+    inline bool pop(T& data) noexcept {
+        return try_pop(data);
     }
 
-    ~QueueRing() {
-        
+    /**
+     * Returns if the queue is empty.
+     * Only a snapshot if other threads are pushing or popping concurrently.
+     *
+     * @return true if empty, false otherwise.
+     */
+    bool empty() const noexcept {
+        return head.load(std::memory_order_acquire) >= tail.load(std::memory_order_acquire);
     }
 
+    /**
+     * Returns the maximum amount of elements the queue can hold.
+     *
+     * @return size_t Capacity of the queue.
+     */
+    size_t getCapacity() const noexcept {
+        return capacity;
+    }
 
 };
 
@@ -82,4 +179,4 @@ public:
 
 }
 
-#endif // SPI_QUEUE_RING_HPP
\ No newline at end of file
+#endif // SPI_QUEUE_RING_HPP
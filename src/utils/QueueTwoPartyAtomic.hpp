@@ -9,7 +9,10 @@
 #ifndef SPI_QUEUE_TWOPARTY_HPP
 #define SPI_QUEUE_TWOPARTY_HPP
 
+#include "./HardwareUtils.hpp"
+
 #include <atomic>
+#include <thread>
 
 namespace spi {
 
@@ -34,13 +37,14 @@ protected:
         Node* next = nullptr;
     };
 
-    Node* head; // always keep one element at head
-    Node* tail;
-    std::atomic<size_t> count{1}; // one actually represents zero! (used to optimize pop)
+    alignas(CACHE_LINE_SIZE) Node* head; // always keep one element at head (consumer)
+    Node* recycleTail = nullptr; // optimization to recycle Node instances (used by pop)
 
+    alignas(CACHE_LINE_SIZE) Node* tail; // producer
     Node* recycleHead = nullptr; // optimization to recycle Node instances (used by push)
-    Node* recycleTail = nullptr; // optimization to recycle Node instances (used by pop)
-    std::atomic<size_t> recycleCount{1}; // one actually represents zero! (used to optimize pop)
+
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> count{1}; // one actually represents zero! (used to optimize pop)
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> recycleCount{1}; // one actually represents zero! (used to optimize pop)
 
 public:
 
@@ -78,6 +82,7 @@ public:
         } else {
             newNode = recycleHead;
             recycleHead = recycleHead->next;
+            newNode->next = nullptr; // still points into the recycle list
         }
 
         tail->next = newNode;
@@ -36,11 +36,11 @@ protected:
         Node* next = nullptr;
     };
 
-    Node* head;
-    Node* tail;
+    alignas(CACHE_LINE_SIZE) Node* head;        // consumer
+    Node* recycleTail;                          // consumer
 
-    Node* recycleHead;
-    Node* recycleTail;
+    alignas(CACHE_LINE_SIZE) Node* tail;        // producer
+    Node* recycleHead;                          // producer
 
 public:
 
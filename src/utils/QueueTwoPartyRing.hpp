@@ -0,0 +1,258 @@
+/**
+ * Wait-free bounded queue implementation that uses a ring buffer scheme.
+ * Best performance for a single producer and a single consumer.
+ *
+ * @file QueueTwoPartyRing.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+
+#ifndef SPI_QUEUE_TWOPARTY_RING_HPP
+#define SPI_QUEUE_TWOPARTY_RING_HPP
+
+#include "./HardwareUtils.hpp"
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace spi {
+
+
+
+/**
+ * Bounded queue implementation that uses a contiguous ring buffer.
+ *
+ * Producer and consumer each keep a cached copy of the other side's index
+ * and only reload it if the cached value says the queue is full (producer)
+ * or empty (consumer). Therefore both sides rarely touch the same cache line.
+ * No memory gets allocated after construction.
+ *
+ * IMPORTANT:   this implementation is more performant,
+ *              HOWEVER it is only thread-safe if
+ *              only a single thread for pushing
+ *              and a single thread for popping is allowed!
+ * IMPORTANT:   Capacity gets rounded up to the next power of two.
+ *
+ * @tparam T Type of elements stored in the queue.
+ * @tparam Allocator Allocator of the ring buffer (e.g. NumaAllocator).
+ */
+template<typename T, typename Allocator = std::allocator<T>>
+class QueueTwoPartyRing {
+protected:
+    typedef std::allocator_traits<Allocator> AllocatorTraits;
+
+    const size_t capacity;
+    const size_t mask;
+    Allocator allocator;
+    T* const data;
+
+    // producer side
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> writeIndex{0};
+    size_t cachedReadIndex = 0; // producer's view of readIndex
+
+    // consumer side
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> readIndex{0};
+    size_t cachedWriteIndex = 0; // consumer's view of writeIndex
+
+    /**
+     * Returns how many elements the producer can write without reloading readIndex.
+     */
+    inline size_t freeSlots(size_t write) noexcept {
+        size_t free = capacity - (write - cachedReadIndex);
+        if(free == 0){
+            cachedReadIndex = readIndex.load(std::memory_order_acquire);
+            free = capacity - (write - cachedReadIndex);
+        }
+        return free;
+    }
+
+    /**
+     * Returns how many elements the consumer can read without reloading writeIndex.
+     */
+    inline size_t usedSlots(size_t read) noexcept {
+        size_t used = cachedWriteIndex - read;
+        if(used == 0){
+            cachedWriteIndex = writeIndex.load(std::memory_order_acquire);
+            used = cachedWriteIndex - read;
+        }
+        return used;
+    }
+
+public:
+
+    /**
+     * Creates a new bounded queue.
+     *
+     * @param size Minimum amount of elements the queue can hold (rounded up to next power of two).
+     * @param allocator Allocator of the ring buffer.
+     */
+    QueueTwoPartyRing(size_t size, const Allocator &allocator = Allocator()) :
+            capacity(std::bit_ceil(size < 2 ? (size_t)2 : size)), mask(capacity - 1),
+            allocator(allocator), data(AllocatorTraits::allocate(this->allocator, capacity)) {
+        for(size_t i=0; i < capacity; i++)
+            AllocatorTraits::construct(this->allocator, data + i);
+    }
+
+    QueueTwoPartyRing(const QueueTwoPartyRing&) = delete;
+    QueueTwoPartyRing& operator=(const QueueTwoPartyRing&) = delete;
+
+    ~QueueTwoPartyRing() {
+        for(size_t i=0; i < capacity; i++)
+            AllocatorTraits::destroy(allocator, data + i);
+        AllocatorTraits::deallocate(allocator, data, capacity);
+    }
+
+    /**
+     * Removes all elements from the queue and destroys them
+     * (their slots are left with default constructed elements).
+     * Must be called by the consumer.
+     */
+    void cancelAll() noexcept {
+        const size_t read = readIndex.load(std::memory_order_relaxed);
+        cachedWriteIndex = writeIndex.load(std::memory_order_acquire);
+        for(size_t i=read; i != cachedWriteIndex; i++)
+            data[i & mask] = T();
+        readIndex.store(cachedWriteIndex, std::memory_order_release);
+    }
+
+    /**
+     * Tries to push an element into the queue.
+     *
+     * @param value Element to push.
+     * @return true if pushed, false if the queue is full.
+     */
+    inline bool try_push(T value) noexcept {
+        const size_t write = writeIndex.load(std::memory_order_relaxed);
+        if(freeSlots(write) == 0) return false;
+        data[write & mask] = std::move(value);
+        writeIndex.store(write + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Pushes an element into the queue.
+     * If the queue is full the calling thread yields until space is available.
+     *
+     * @param value Element to push.
+     */
+    inline void push(T value) noexcept {
+        while(!try_push(value))
+            std::this_thread::yield();
+    }
+
+    /**
+     * Pushes up to count elements into the queue and
+     * publishes all of them with a single store.
+     *
+     * @param values Pointer to the elements to push.
+     * @param count Amount of elements to push.
+     * @return size_t Amount of elements actually pushed (less than count if queue became full).
+     */
+    inline size_t push_bulk(const T* values, size_t count) noexcept {
+        const size_t write = writeIndex.load(std::memory_order_relaxed);
+        size_t free = capacity - (write - cachedReadIndex);
+        if(free < count){
+            cachedReadIndex = readIndex.load(std::memory_order_acquire); // try to get more space
+            free = capacity - (write - cachedReadIndex);
+        }
+        const size_t n = count < free ? count : free;
+        for(size_t i=0; i < n; i++)
+            data[(write + i) & mask] = values[i];
+        if(n > 0) writeIndex.store(write + n, std::memory_order_release);
+        return n;
+    }
+
+    /**
+     * Tries to pop an element from the queue.
+     * Does not yield if the queue is empty.
+     *
+     * @param value Reference the popped element gets written to.
+     * @return true if popped, false if the queue is empty.
+     */
+    inline bool try_pop(T& value) noexcept {
+        const size_t read = readIndex.load(std::memory_order_relaxed);
+        if(usedSlots(read) == 0) return false;
+        value = std::move(data[read & mask]);
+        readIndex.store(read + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Pops an element from the queue.
+     *
+     * @param value Reference the popped element gets written to.
+     * @return true if popped, false if the queue is empty.
+     */
+    inline bool pop(T& value) noexcept {
+        return try_pop(value);
+    }
+
+    /**
+     * Pops an element from the queue and tells if there are more elements.
+     *
+     * @param value Reference the popped element gets written to.
+     * @param hasMore Set to true if more elements are available after this pop.
+     * @return true if popped, false if the queue is empty.
+     */
+    inline bool popAndCheckNext(T& value, bool &hasMore) noexcept {
+        const size_t read = readIndex.load(std::memory_order_relaxed);
+        const size_t used = usedSlots(read);
+        if(used == 0){
+            hasMore = false;
+            return false;
+        }
+        value = std::move(data[read & mask]);
+        readIndex.store(read + 1, std::memory_order_release);
+        hasMore = used > 1;
+        return true;
+    }
+
+    /**
+     * Pops up to max elements from the queue and
+     * frees all of their slots with a single store.
+     *
+     * @param values Pointer to where the popped elements get written to.
+     * @param max Maximum amount of elements to pop.
+     * @return size_t Amount of elements actually popped.
+     */
+    inline size_t pop_bulk(T* values, size_t max) noexcept {
+        const size_t read = readIndex.load(std::memory_order_relaxed);
+        size_t used = cachedWriteIndex - read;
+        if(used < max){
+            cachedWriteIndex = writeIndex.load(std::memory_order_acquire); // try to get more elements
+            used = cachedWriteIndex - read;
+        }
+        const size_t n = max < used ? max : used;
+        for(size_t i=0; i < n; i++)
+            values[i] = std::move(data[(read + i) & mask]);
+        if(n > 0) readIndex.store(read + n, std::memory_order_release);
+        return n;
+    }
+
+    /**
+     * Returns if the queue is empty.
+     *
+     * @return true if empty, false otherwise.
+     */
+    bool empty() const noexcept {
+        return readIndex.load(std::memory_order_acquire) == writeIndex.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Returns the maximum amount of elements the queue can hold.
+     *
+     * @return size_t Capacity of the queue.
+     */
+    size_t getCapacity() const noexcept {
+        return capacity;
+    }
+};
+
+
+
+}
+
+#endif // SPI_QUEUE_TWOPARTY_RING_HPP
@@ -0,0 +1,120 @@
+/**
+ * Storage of the RecycleObjectStore implementations that constructs objects
+ * in contiguous cache-line-aligned chunks instead of allocating each object separately.
+ *
+ * @file RecycleObjectSlab.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+#ifndef SPI_RECYCLE_OBJECT_SLAB_HPP
+#define SPI_RECYCLE_OBJECT_SLAB_HPP
+
+#include "./HardwareUtils.hpp"
+
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+/** Default amount of objects per chunk of a RecycleObjectSlab. */
+#ifndef SPI_RECYCLE_OBJECT_SLAB_CHUNK_SIZE
+#define SPI_RECYCLE_OBJECT_SLAB_CHUNK_SIZE 64
+#endif
+
+namespace spi {
+
+
+/**
+ * Grows by allocating chunks that hold a fixed amount of objects.
+ * Objects get constructed in place one after another and are only destructed
+ * together with the slab, therefore pointers and indices stay valid.
+ * An index directly maps to a chunk and an offset within that chunk.
+ *
+ * @tparam T Type of the stored objects.
+ * @tparam Allocator Allocator the chunks get allocated with (e.g. NumaAllocator).
+ */
+template<typename T, typename Allocator = std::allocator<T>>
+class RecycleObjectSlab {
+protected:
+    static constexpr size_t alignment = alignof(T) > CACHE_LINE_SIZE ? alignof(T) : CACHE_LINE_SIZE;
+
+    /** Unit chunks get allocated in so they are aligned to cache lines. */
+    struct alignas(alignment) Line {
+        unsigned char bytes[alignment];
+    };
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Line> LineAllocator;
+
+    const size_t chunkShift;
+    const size_t chunkMask;
+    const size_t linesPerChunk;
+    LineAllocator allocator;
+    std::vector<T*> chunks;
+    size_t count = 0; // constructed objects
+
+public:
+
+    /**
+     * Creates an empty slab.
+     *
+     * @param chunkSize Amount of objects per chunk (rounded up to next power of two).
+     * @param allocator Allocator the chunks get allocated with.
+     */
+    RecycleObjectSlab(size_t chunkSize = SPI_RECYCLE_OBJECT_SLAB_CHUNK_SIZE, const Allocator &allocator = Allocator()) :
+            chunkShift((size_t)std::countr_zero(std::bit_ceil(chunkSize < 1 ? (size_t)1 : chunkSize))),
+            chunkMask(((size_t)1 << chunkShift) - 1),
+            linesPerChunk(((sizeof(T) << chunkShift) + alignment - 1) / alignment),
+            allocator(allocator) {}
+
+    RecycleObjectSlab(const RecycleObjectSlab&) = delete;
+    RecycleObjectSlab& operator=(const RecycleObjectSlab&) = delete;
+
+    ~RecycleObjectSlab(){
+        for(size_t i=0; i < count; i++)
+            get(i)->~T();
+        for(T* chunk : chunks)
+            std::allocator_traits<LineAllocator>::deallocate(allocator, reinterpret_cast<Line*>(chunk), linesPerChunk);
+    }
+
+    /**
+     * Constructs a new object at the end of the slab.
+     *
+     * @param args Arguments passed to the constructor of T.
+     * @return size_t Index of the new object.
+     */
+    template<typename... Args>
+    inline size_t emplace(Args&&... args){
+        if(count == (chunks.size() << chunkShift)){
+            chunks.push_back(reinterpret_cast<T*>(std::allocator_traits<LineAllocator>::allocate(allocator, linesPerChunk)));
+        }
+        ::new(static_cast<void*>(get(count))) T(std::forward<Args>(args)...);
+        return count++;
+    }
+
+    /**
+     * Returns the object at the given index.
+     *
+     * @param index Index returned by emplace().
+     */
+    inline T* get(size_t index) const noexcept {
+        return chunks[index >> chunkShift] + (index & chunkMask);
+    }
+
+    /**
+     * Returns the amount of constructed objects.
+     */
+    inline size_t size() const noexcept {
+        return count;
+    }
+
+    /**
+     * Returns the amount of objects per chunk.
+     */
+    inline size_t getChunkSize() const noexcept {
+        return chunkMask + 1;
+    }
+};
+
+
+}
+#endif // SPI_RECYCLE_OBJECT_SLAB_HPP
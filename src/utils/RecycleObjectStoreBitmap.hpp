@@ -10,68 +10,129 @@
 #ifndef SPI_RECYCLE_OBJECT_STORE_BITMAP_HPP
 #define SPI_RECYCLE_OBJECT_STORE_BITMAP_HPP
 
+#include "./RecycleObjectSlab.hpp"
+
+#include <bit>
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace spi {
 
 
-template<typename T>
+/**
+ * Stores objects in contiguous chunks (RecycleObjectSlab) and keeps track of available ones with a two-level bitmap:
+ * availability has one bit per object and summary has one bit per availability word
+ * that may still have available objects. Acquire finds the first available object with
+ * two bit-scans (std::countr_zero), release sets one bit (two if the word was empty).
+ * Both are O(1) in practice.
+ * 
+ * IMPORTANT: not thread-safe (see RecycleObjectStoreBitmapAtomic).
+ */
+template<typename T, typename Allocator = std::allocator<T>>
 class RecycleObjectStoreBitmap {
 protected:
 typedef uint64_t BitMapEntry;
 
-    std::vector<T*> objects;
-    std::vector<BitMapEntry> availability; // bitmap
+    RecycleObjectSlab<T, Allocator> objects;
+    std::vector<BitMapEntry> availability; // bitmap (bit set if object available)
+    std::vector<BitMapEntry> summary; // bit set if word of availability may not be zero (cleared lazily by acquire)
+    size_t summaryHint = 0; // summary words below this index are zero
 
-    const BitMapEntry bitMapEntrySize = sizeof(BitMapEntry) * 8;
+    static constexpr size_t bitMapEntrySize = sizeof(BitMapEntry) * 8;
+
+    /** Constructs a new object (not available yet) and returns its index. */
+    template<typename... Args>
+    inline size_t create(Args&&... args){
+        const size_t index = objects.emplace(std::forward<Args>(args)...);
+        if(index % bitMapEntrySize == 0){
+            if(availability.size() % bitMapEntrySize == 0){
+                summary.push_back(0);
+            }
+            availability.push_back(0);
+        }
+        return index;
+    }
 
 public:
-    RecycleObjectStoreBitmap() = default;
 
-    ~RecycleObjectStoreBitmap(){
-        for(T *obj : objects){
-            delete obj;
-        }
+    /**
+     * Creates an empty store.
+     *
+     * @param chunkSize Amount of objects that get allocated together (rounded up to next power of two).
+     * @param allocator Allocator the objects get allocated with (e.g. NumaAllocator).
+     */
+    RecycleObjectStoreBitmap(size_t chunkSize = SPI_RECYCLE_OBJECT_SLAB_CHUNK_SIZE, const Allocator &allocator = Allocator()) : objects(chunkSize, allocator) {}
+
+    RecycleObjectStoreBitmap(const RecycleObjectStoreBitmap&) = delete;
+    RecycleObjectStoreBitmap& operator=(const RecycleObjectStoreBitmap&) = delete;
+
+
+    /**
+     * Constructs objects until the store holds at least count objects
+     * and makes them available (e.g. to prewarm the store at startup).
+     *
+     * @param count Amount of objects the store should hold.
+     * @param args Arguments passed to the constructor of each new object.
+     */
+    template<typename... Args>
+    void reserve(size_t count, const Args&... args){
+        while(objects.size() < count)
+            release(create(args...));
     }
 
 
-    inline T* acquire(size_t &index){
-        for(size_t i=0; i < availability.size(); i++){
-            if(availability[i] != 0){
-                for(BitMapEntry b=0; b < bitMapEntrySize; b++){
-                    if(availability[i] & (1 << b)){
-                        availability[i] &= (BitMapEntry) ~((BitMapEntry)1 << b);
-                        index = i * bitMapEntrySize + b;
-                        return objects[index];
-                    }
+    /**
+     * Acquires an available object or constructs a new one if none is available.
+     *
+     * @param index Set to the index of the object that needs to be passed to release().
+     * @param args Arguments passed to the constructor if a new object is needed (recycled objects are returned as they are).
+     * @return T* Acquired object.
+     */
+    template<typename... Args>
+    inline T* acquire(size_t &index, Args&&... args){
+        for(size_t s=summaryHint; s < summary.size(); s++){
+            BitMapEntry sum = summary[s];
+            while(sum != 0){
+                const size_t i = s * bitMapEntrySize + (size_t)std::countr_zero(sum);
+                const BitMapEntry entry = availability[i];
+                if(entry != 0){
+                    summaryHint = s;
+                    index = i * bitMapEntrySize + (size_t)std::countr_zero(entry);
+                    availability[i] = entry & (entry - 1); // clear lowest set bit
+                    return objects.get(index);
                 }
+                sum &= sum - 1; // word i is empty, clear its summary bit lazily
+                summary[s] = sum;
             }
         }
+        summaryHint = summary.size();
 
         // not enough objects available, create a new one
-        objects.push_back(new T());
-        index = objects.size() - 1;
-        size_t b = objects.size() % bitMapEntrySize;
-        if(b == 1){
-            availability.push_back(0);
-        }
-        return objects[index];
+        index = create(std::forward<Args>(args)...);
+        return objects.get(index);
     }
     
 
     inline void release(size_t index){
-        size_t i = index / bitMapEntrySize;
-        size_t b = index % bitMapEntrySize;
-        availability[i] |= (1 << b);
+        const size_t i = index / bitMapEntrySize;
+        const size_t s = i / bitMapEntrySize;
+        const BitMapEntry old = availability[i];
+        availability[i] = old | ((BitMapEntry)1 << (index % bitMapEntrySize));
+        if(old == 0){ // word may not be marked in summary anymore
+            const BitMapEntry bit = (BitMapEntry)1 << (i % bitMapEntrySize);
+            if((summary[s] & bit) == 0) summary[s] |= bit;
+            if(s < summaryHint) summaryHint = s;
+        }
     }
 
     std::string toString(std::function<std::string(T*)> objToStr) const {
         std::string objStr = "";
         for(size_t i=0; i < objects.size(); i++){
-            objStr += ", "+objToStr(objects[i]);
+            objStr += ", "+objToStr(objects.get(i));
         }
         objStr = objStr.empty() ? objStr : objStr.substr(2);
 
@@ -79,7 +140,7 @@ public:
         for(size_t i=0; i < availability.size(); i++){
             availabilityStr += ", ";
             for(BitMapEntry b=0; b < bitMapEntrySize; b++){
-                availabilityStr += (availability[i] & (1 << b)) ? "1" : "0";
+                availabilityStr += (availability[i] & ((BitMapEntry)1 << b)) ? "1" : "0";
             }
         }
         availabilityStr = availabilityStr.empty() ? availabilityStr : availabilityStr.substr(2);
@@ -0,0 +1,178 @@
+/**
+ * RecycleObjectStore stores a fixed amount of objects that can be acquired and released again for reuse
+ * by multiple threads concurrently.
+ * This is much faster than creating and deleting objects all the time.
+ *
+ * @file RecycleObjectStoreBitmapAtomic.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+#ifndef SPI_RECYCLE_OBJECT_STORE_BITMAP_ATOMIC_HPP
+#define SPI_RECYCLE_OBJECT_STORE_BITMAP_ATOMIC_HPP
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace spi {
+
+
+/**
+ * Thread-safe version of RecycleObjectStoreBitmap with a fixed capacity.
+ *
+ * Objects are stored in one contiguous array. Availability is tracked by a two-level
+ * bitmap of atomic words: an object gets claimed with a single fetch_and on its word and
+ * released with a single fetch_or. The summary level only serves as a hint where to look
+ * (bits of empty words get cleared lazily by acquire()),
+ * if it does not lead to an available object all words get checked before giving up.
+ *
+ * IMPORTANT: acquire() returns nullptr if all objects are in use.
+ *
+ * @tparam T Type of the stored objects (must be default constructible).
+ */
+template<typename T>
+class RecycleObjectStoreBitmapAtomic {
+protected:
+typedef uint64_t BitMapEntry;
+
+    static constexpr size_t bitMapEntrySize = sizeof(BitMapEntry) * 8;
+
+    const size_t capacity;
+    const size_t availabilitySize;
+    const size_t summarySize;
+    T* const objects;
+    std::atomic<BitMapEntry>* const availability; // bit set if object available
+    std::atomic<BitMapEntry>* const summary; // bit set if word of availability may not be zero
+    std::atomic<size_t> summaryHint{0}; // summary word to start searching at
+
+    static inline BitMapEntry bitsUpTo(size_t count) noexcept {
+        return count >= bitMapEntrySize ? ~(BitMapEntry)0 : (((BitMapEntry)1 << count) - 1);
+    }
+
+    /** Clears summary bit of word i (called after word i was found empty). */
+    inline void clearSummary(size_t s, size_t i) noexcept {
+        const BitMapEntry bit = (BitMapEntry)1 << (i % bitMapEntrySize);
+        this->summary[s].fetch_and(~bit, std::memory_order_relaxed);
+        if(this->availability[i].load(std::memory_order_acquire) != 0) // released in the meantime
+            this->summary[s].fetch_or(bit, std::memory_order_release);
+    }
+
+    /** Tries to claim an object of word i. */
+    inline T* tryAcquireWord(size_t i, size_t &index) noexcept {
+        BitMapEntry entry = this->availability[i].load(std::memory_order_relaxed);
+        while(entry != 0){
+            const BitMapEntry bit = entry & (~entry + 1); // lowest set bit
+            entry = this->availability[i].fetch_and(~bit, std::memory_order_acquire);
+            if(entry & bit){
+                index = i * bitMapEntrySize + (size_t)std::countr_zero(bit);
+                return &this->objects[index];
+            }
+        }
+        return nullptr;
+    }
+
+    /** Tries to claim an object of the words that summary word s marks as not empty. */
+    inline T* tryAcquireSummary(size_t s, size_t &index) noexcept {
+        BitMapEntry sum = this->summary[s].load(std::memory_order_acquire);
+        while(sum != 0){
+            const size_t i = s * bitMapEntrySize + (size_t)std::countr_zero(sum);
+            T* obj = this->tryAcquireWord(i, index);
+            if(obj != nullptr) return obj;
+            this->clearSummary(s, i); // word is empty, clear its summary bit lazily
+            sum &= sum - 1;
+        }
+        return nullptr;
+    }
+
+public:
+
+    /**
+     * Creates a store holding a fixed amount of objects.
+     *
+     * @param capacity Amount of objects that can be acquired at the same time.
+     */
+    RecycleObjectStoreBitmapAtomic(size_t capacity) :
+            capacity(capacity),
+            availabilitySize((capacity + bitMapEntrySize - 1) / bitMapEntrySize),
+            summarySize((availabilitySize + bitMapEntrySize - 1) / bitMapEntrySize),
+            objects(new T[capacity]),
+            availability(new std::atomic<BitMapEntry>[availabilitySize]),
+            summary(new std::atomic<BitMapEntry>[summarySize]) {
+        for(size_t i=0; i < availabilitySize; i++)
+            availability[i].store(bitsUpTo(capacity - i * bitMapEntrySize), std::memory_order_relaxed);
+        for(size_t s=0; s < summarySize; s++)
+            summary[s].store(bitsUpTo(availabilitySize - s * bitMapEntrySize), std::memory_order_relaxed);
+    }
+
+    RecycleObjectStoreBitmapAtomic(const RecycleObjectStoreBitmapAtomic&) = delete;
+    RecycleObjectStoreBitmapAtomic& operator=(const RecycleObjectStoreBitmapAtomic&) = delete;
+
+    ~RecycleObjectStoreBitmapAtomic(){
+        delete[] objects;
+        delete[] availability;
+        delete[] summary;
+    }
+
+
+    /**
+     * Acquires an available object. Thread-safe.
+     *
+     * @param index Set to the index of the object that needs to be passed to release().
+     * @return T* Acquired object or nullptr if all objects are in use.
+     */
+    inline T* acquire(size_t &index) noexcept {
+        const size_t hint = this->summaryHint.load(std::memory_order_relaxed);
+        for(size_t n=0; n < summarySize; n++){
+            const size_t s = (hint + n) < summarySize ? hint + n : hint + n - summarySize;
+            T* obj = this->tryAcquireSummary(s, index);
+            if(obj != nullptr){
+                if(s != hint) this->summaryHint.store(s, std::memory_order_relaxed);
+                return obj;
+            }
+        }
+
+        // summary bits are updated after the words, check words directly before giving up
+        for(size_t i=0; i < availabilitySize; i++){
+            T* obj = this->tryAcquireWord(i, index);
+            if(obj != nullptr) return obj;
+        }
+        return nullptr;
+    }
+
+
+    /**
+     * Releases an object acquired before. Thread-safe.
+     *
+     * @param index Index returned by acquire().
+     */
+    inline void release(size_t index) noexcept {
+        const size_t i = index / bitMapEntrySize;
+        const size_t s = i / bitMapEntrySize;
+        const BitMapEntry old = this->availability[i].fetch_or((BitMapEntry)1 << (index % bitMapEntrySize), std::memory_order_release);
+        if(old == 0){ // word may not be marked in summary anymore
+            const BitMapEntry bit = (BitMapEntry)1 << (i % bitMapEntrySize);
+            if((this->summary[s].load(std::memory_order_relaxed) & bit) == 0)
+                this->summary[s].fetch_or(bit, std::memory_order_release);
+            if(s < this->summaryHint.load(std::memory_order_relaxed)) this->summaryHint.store(s, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Returns the amount of objects this store holds.
+     */
+    size_t getCapacity() const noexcept {
+        return this->capacity;
+    }
+
+    std::string toString() const {
+        size_t available = 0;
+        for(size_t i=0; i < availabilitySize; i++)
+            available += (size_t)std::popcount(availability[i].load(std::memory_order_relaxed));
+        return "RecycleObjectStoreBitmapAtomic(capacity="+std::to_string(capacity)+"; available="+std::to_string(available)+")";
+    }
+};
+
+
+}
+#endif // SPI_RECYCLE_OBJECT_STORE_BITMAP_ATOMIC_HPP
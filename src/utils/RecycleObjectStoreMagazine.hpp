@@ -0,0 +1,361 @@
+/**
+ * RecycleObjectStore stores a dynamic amount of objects that can be acquired and released again for reuse
+ * by multiple threads concurrently.
+ * This is much faster than creating and deleting objects all the time.
+ *
+ * @file RecycleObjectStoreMagazine.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+#ifndef SPI_RECYCLE_OBJECT_STORE_MAGAZINE_HPP
+#define SPI_RECYCLE_OBJECT_STORE_MAGAZINE_HPP
+
+#include "./RecycleObjectSlab.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** Default amount of objects per magazine of a RecycleObjectStoreMagazine (every thread caches up to two magazines). */
+#ifndef SPI_RECYCLE_OBJECT_STORE_MAGAZINE_SIZE
+#define SPI_RECYCLE_OBJECT_STORE_MAGAZINE_SIZE 32
+#endif
+
+namespace spi {
+
+
+/**
+ * Type independent part of RecycleObjectStoreMagazine that keeps track of
+ * the per-thread caches of all stores a thread has used.
+ */
+class RecycleObjectStoreMagazineBase {
+protected:
+
+    /**
+     * Cache of one thread for one store.
+     * Referenced by the store and by the thread, whoever drops the last reference deletes it.
+     */
+    struct Cache {
+        std::atomic<size_t> refs{2};
+        std::atomic<bool> orphaned{false}; // thread has exited, cache can be adopted by another thread
+        std::atomic<bool> storeAlive{true};
+        virtual ~Cache() = default;
+
+        inline void unref() noexcept {
+            if(this->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+        }
+    };
+
+    /** Caches of the calling thread. */
+    struct Local {
+        uint64_t lastId = 0; // most recently used store
+        Cache* last = nullptr;
+        std::vector<std::pair<uint64_t, Cache*>> entries;
+
+        ~Local(){
+            for(std::pair<uint64_t, Cache*> &entry : this->entries){
+                entry.second->orphaned.store(true, std::memory_order_release);
+                entry.second->unref();
+            }
+        }
+
+        /** Drops caches of stores that no longer exist. */
+        void sweep() noexcept {
+            for(size_t i=0; i < this->entries.size();){
+                if(!this->entries[i].second->storeAlive.load(std::memory_order_acquire)){
+                    this->entries[i].second->unref();
+                    this->entries[i] = this->entries.back();
+                    this->entries.pop_back();
+                } else i++;
+            }
+            this->lastId = 0;
+            this->last = nullptr;
+        }
+    };
+
+    /** Owning thread exits: hand caches back to their stores. */
+    struct Holder {
+        Local* local = nullptr;
+        ~Holder(){
+            current() = nullptr;
+            exited() = true;
+            delete local;
+        }
+    };
+
+    static Local*& current() noexcept {
+        static thread_local Local* local = nullptr; // trivially destructible, stays valid during thread exit
+        return local;
+    }
+
+    static bool& exited() noexcept {
+        static thread_local bool flag = false;
+        return flag;
+    }
+
+    /** Returns the caches of the calling thread or nullptr if the thread is exiting. */
+    static Local* local(){
+        Local* caches = current();
+        if(caches != nullptr || exited()) return caches;
+        static thread_local Holder holder;
+        holder.local = caches = new Local();
+        current() = caches;
+        return caches;
+    }
+
+    static uint64_t nextId() noexcept {
+        static std::atomic<uint64_t> counter{0};
+        return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+};
+
+
+/**
+ * Thread-safe store with a magazine front-end (Bonwick & Adams):
+ *
+ * Every thread caches up to two magazines (stacks of magazineSize objects) and acquires/releases
+ * objects from/to them without any synchronization. Only if both magazines are empty (acquire)
+ * or full (release) a whole magazine gets exchanged with the shared depot which is protected by a mutex.
+ * Therefore a thread caches at most 2 * magazineSize objects and touches the depot
+ * at most once per magazineSize operations.
+ *
+ * Objects may be released by a different thread than the one that acquired them.
+ * Caches of exited threads get adopted by new threads so their objects are not lost.
+ * Objects are stored in contiguous chunks (RecycleObjectSlab).
+ *
+ * @tparam T Type of the stored objects.
+ */
+template<typename T, typename Allocator = std::allocator<T>>
+class RecycleObjectStoreMagazine : protected RecycleObjectStoreMagazineBase {
+protected:
+
+    typedef std::vector<T*> Magazine;
+
+    struct MagazineCache : public Cache {
+        Magazine* loaded;
+        Magazine* previous;
+        MagazineCache(Magazine* loaded, Magazine* previous) noexcept : loaded(loaded), previous(previous) {}
+    };
+
+    const uint64_t id;
+    const size_t magazineSize;
+
+    std::mutex mDepot;
+    RecycleObjectSlab<T, Allocator> objects;
+    std::vector<std::unique_ptr<Magazine>> magazines; // all magazines ever created
+    std::vector<Magazine*> full;
+    std::vector<Magazine*> empty;
+    std::vector<T*> loose; // objects released by exiting threads
+    std::vector<MagazineCache*> caches;
+
+    inline Magazine* newMagazine(){
+        this->magazines.push_back(std::make_unique<Magazine>());
+        this->magazines.back()->reserve(this->magazineSize);
+        return this->magazines.back().get();
+    }
+
+    inline Magazine* emptyMagazine(){
+        if(this->empty.empty()) return this->newMagazine();
+        Magazine* magazine = this->empty.back();
+        this->empty.pop_back();
+        return magazine;
+    }
+
+    /** Takes a full magazine from the depot (or fills one with loose objects), nullptr if none available. */
+    inline Magazine* fullMagazine(){
+        if(!this->full.empty()){
+            Magazine* magazine = this->full.back();
+            this->full.pop_back();
+            return magazine;
+        }
+        if(this->loose.empty()) return nullptr;
+        Magazine* magazine = this->emptyMagazine();
+        while(!this->loose.empty() && magazine->size() < this->magazineSize){
+            magazine->push_back(this->loose.back());
+            this->loose.pop_back();
+        }
+        return magazine;
+    }
+
+    /** Returns the cache of the calling thread or nullptr if the thread is exiting. */
+    MagazineCache* localCache(){
+        Local* thread = local();
+        if(thread == nullptr) return nullptr;
+        if(thread->lastId == this->id) return static_cast<MagazineCache*>(thread->last);
+        for(std::pair<uint64_t, Cache*> &entry : thread->entries){
+            if(entry.first == this->id){
+                thread->lastId = this->id;
+                thread->last = entry.second;
+                return static_cast<MagazineCache*>(entry.second);
+            }
+        }
+
+        // first use by this thread
+        thread->sweep();
+        MagazineCache* cache = nullptr;
+        {
+            std::unique_lock<std::mutex> lDepot(this->mDepot);
+            for(MagazineCache* orphan : this->caches){
+                bool expected = true;
+                if(orphan->orphaned.load(std::memory_order_relaxed) &&
+                        orphan->orphaned.compare_exchange_strong(expected, false, std::memory_order_acquire)){
+                    orphan->refs.fetch_add(1, std::memory_order_relaxed);
+                    cache = orphan;
+                    break;
+                }
+            }
+            if(cache == nullptr){
+                cache = new MagazineCache(this->emptyMagazine(), this->emptyMagazine());
+                this->caches.push_back(cache);
+            }
+        }
+        thread->entries.emplace_back(this->id, cache);
+        thread->lastId = this->id;
+        thread->last = cache;
+        return cache;
+    }
+
+    template<typename... Args>
+    T* acquireSlow(MagazineCache* cache, Args&&... args){
+        std::unique_lock<std::mutex> lDepot(this->mDepot);
+        if(cache == nullptr){ // thread exiting
+            if(this->loose.empty()){
+                Magazine* magazine = this->fullMagazine();
+                if(magazine == nullptr) return this->objects.get(this->objects.emplace(std::forward<Args>(args)...));
+                this->empty.push_back(magazine);
+                this->loose.swap(*magazine);
+            }
+            T* obj = this->loose.back();
+            this->loose.pop_back();
+            return obj;
+        }
+        Magazine* magazine = this->fullMagazine();
+        if(magazine == nullptr) return this->objects.get(this->objects.emplace(std::forward<Args>(args)...));
+        this->empty.push_back(cache->previous);
+        cache->previous = cache->loaded;
+        cache->loaded = magazine;
+        T* obj = magazine->back();
+        magazine->pop_back();
+        return obj;
+    }
+
+    void releaseSlow(MagazineCache* cache, T* obj){
+        std::unique_lock<std::mutex> lDepot(this->mDepot);
+        if(cache == nullptr){ // thread exiting
+            this->loose.push_back(obj);
+            return;
+        }
+        this->full.push_back(cache->previous);
+        cache->previous = cache->loaded;
+        cache->loaded = this->emptyMagazine();
+        cache->loaded->push_back(obj);
+    }
+
+public:
+
+    /**
+     * Creates an empty store.
+     *
+     * @param magazineSize Amount of objects per magazine (every thread caches up to two magazines).
+     * @param chunkSize Amount of objects that get allocated together (rounded up to next power of two).
+     * @param allocator Allocator the objects get allocated with (e.g. NumaAllocator).
+     */
+    RecycleObjectStoreMagazine(size_t magazineSize = SPI_RECYCLE_OBJECT_STORE_MAGAZINE_SIZE, size_t chunkSize = SPI_RECYCLE_OBJECT_SLAB_CHUNK_SIZE, const Allocator &allocator = Allocator()) :
+            id(nextId()), magazineSize(magazineSize < 1 ? 1 : magazineSize), objects(chunkSize, allocator) {}
+
+    RecycleObjectStoreMagazine(const RecycleObjectStoreMagazine&) = delete;
+    RecycleObjectStoreMagazine& operator=(const RecycleObjectStoreMagazine&) = delete;
+
+    /**
+     * Destroys all objects. No thread is allowed to use the store anymore.
+     */
+    ~RecycleObjectStoreMagazine(){
+        for(MagazineCache* cache : this->caches){
+            cache->storeAlive.store(false, std::memory_order_release);
+            cache->unref();
+        }
+    }
+
+
+    /**
+     * Constructs objects until the store holds at least count objects
+     * and puts them into the depot (e.g. to prewarm the store at startup). Thread-safe.
+     *
+     * @param count Amount of objects the store should hold.
+     * @param args Arguments passed to the constructor of each new object.
+     */
+    template<typename... Args>
+    void reserve(size_t count, const Args&... args){
+        std::unique_lock<std::mutex> lDepot(this->mDepot);
+        Magazine* magazine = nullptr;
+        while(this->objects.size() < count){
+            if(magazine == nullptr) magazine = this->emptyMagazine();
+            magazine->push_back(this->objects.get(this->objects.emplace(args...)));
+            if(magazine->size() == this->magazineSize){
+                this->full.push_back(magazine);
+                magazine = nullptr;
+            }
+        }
+        if(magazine != nullptr) this->full.push_back(magazine);
+    }
+
+
+    /**
+     * Acquires an available object or constructs a new one if none is available. Thread-safe.
+     *
+     * @param args Arguments passed to the constructor if a new object is needed (recycled objects are returned as they are).
+     * @return T* Acquired object.
+     */
+    template<typename... Args>
+    inline T* acquire(Args&&... args){
+        MagazineCache* cache = this->localCache();
+        if(cache != nullptr){
+            if(cache->loaded->empty()) std::swap(cache->loaded, cache->previous);
+            if(!cache->loaded->empty()){
+                T* obj = cache->loaded->back();
+                cache->loaded->pop_back();
+                return obj;
+            }
+        }
+        return this->acquireSlow(cache, std::forward<Args>(args)...);
+    }
+
+
+    /**
+     * Releases an object acquired before (by any thread). Thread-safe.
+     *
+     * @param obj Object returned by acquire().
+     */
+    inline void release(T* obj){
+        MagazineCache* cache = this->localCache();
+        if(cache != nullptr){
+            if(cache->loaded->size() == this->magazineSize) std::swap(cache->loaded, cache->previous);
+            if(cache->loaded->size() < this->magazineSize){
+                cache->loaded->push_back(obj);
+                return;
+            }
+        }
+        this->releaseSlow(cache, obj);
+    }
+
+    /**
+     * Returns the amount of objects per magazine.
+     */
+    size_t getMagazineSize() const noexcept {
+        return this->magazineSize;
+    }
+
+    std::string toString(){
+        std::unique_lock<std::mutex> lDepot(this->mDepot);
+        return "RecycleObjectStoreMagazine(objects="+std::to_string(objects.size())+"; fullMagazines="+std::to_string(full.size())+
+                "; threads="+std::to_string(caches.size())+")";
+    }
+};
+
+
+}
+#endif // SPI_RECYCLE_OBJECT_STORE_MAGAZINE_HPP
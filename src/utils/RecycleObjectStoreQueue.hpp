@@ -10,34 +10,63 @@
 #ifndef SPI_RECYCLE_OBJECT_STORE_QUEUE_HPP
 #define SPI_RECYCLE_OBJECT_STORE_QUEUE_HPP
 
+#include "./RecycleObjectSlab.hpp"
+
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <queue>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace spi {
 
 
-template<typename T>
+template<typename T, typename Allocator = std::allocator<T>>
 class RecycleObjectStoreQueue {
 protected:
+    RecycleObjectSlab<T, Allocator> objects;
     std::queue<T*> available;
 
 public:
-    RecycleObjectStoreQueue() = default;
 
-    ~RecycleObjectStoreQueue() noexcept {
-        while(!available.empty()){
-            delete available.front();
-            available.pop();
-        }
+    /**
+     * Creates an empty store.
+     *
+     * @param chunkSize Amount of objects that get allocated together (rounded up to next power of two).
+     * @param allocator Allocator the objects get allocated with (e.g. NumaAllocator).
+     */
+    RecycleObjectStoreQueue(size_t chunkSize = SPI_RECYCLE_OBJECT_SLAB_CHUNK_SIZE, const Allocator &allocator = Allocator()) : objects(chunkSize, allocator) {}
+
+    RecycleObjectStoreQueue(const RecycleObjectStoreQueue&) = delete;
+    RecycleObjectStoreQueue& operator=(const RecycleObjectStoreQueue&) = delete;
+
+
+    /**
+     * Constructs objects until the store holds at least count objects
+     * and makes them available (e.g. to prewarm the store at startup).
+     *
+     * @param count Amount of objects the store should hold.
+     * @param args Arguments passed to the constructor of each new object.
+     */
+    template<typename... Args>
+    void reserve(size_t count, const Args&... args){
+        while(objects.size() < count)
+            available.push(objects.get(objects.emplace(args...)));
     }
 
 
-    inline T* acquire() noexcept {
+    /**
+     * Acquires an available object or constructs a new one if none is available.
+     *
+     * @param args Arguments passed to the constructor if a new object is needed (recycled objects are returned as they are).
+     * @return T* Acquired object.
+     */
+    template<typename... Args>
+    inline T* acquire(Args&&... args){
         if(available.empty()){
-            return new T();
+            return objects.get(objects.emplace(std::forward<Args>(args)...));
         }
         T *obj = available.front();
         available.pop();
@@ -50,7 +79,7 @@ public:
     }
 
     std::string toString() const {
-        return "RecycleObjectStoreQueue(available="+std::to_string(available.size())+")";
+        return "RecycleObjectStoreQueue(objects="+std::to_string(objects.size())+"; available="+std::to_string(available.size())+")";
     }
 };
 
@@ -10,44 +10,75 @@
 #ifndef SPI_RECYCLE_OBJECT_STORE_VECTOR_HPP
 #define SPI_RECYCLE_OBJECT_STORE_VECTOR_HPP
 
+#include "./RecycleObjectSlab.hpp"
+
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace spi {
 
 
-template<typename T>
+template<typename T, typename Allocator = std::allocator<T>>
 class RecycleObjectStoreVector {
 protected:
-    std::vector<T*> objects;
+    RecycleObjectSlab<T, Allocator> objects;
     std::vector<bool> availability;
 
 public:
-    RecycleObjectStoreVector() = default;
 
-    ~RecycleObjectStoreVector(){
-        for(T *obj : objects){
-            delete obj;
+    /**
+     * Creates an empty store.
+     *
+     * @param chunkSize Amount of objects that get allocated together (rounded up to next power of two).
+     * @param allocator Allocator the objects get allocated with (e.g. NumaAllocator).
+     */
+    RecycleObjectStoreVector(size_t chunkSize = SPI_RECYCLE_OBJECT_SLAB_CHUNK_SIZE, const Allocator &allocator = Allocator()) : objects(chunkSize, allocator) {}
+
+    RecycleObjectStoreVector(const RecycleObjectStoreVector&) = delete;
+    RecycleObjectStoreVector& operator=(const RecycleObjectStoreVector&) = delete;
+
+
+    /**
+     * Constructs objects until the store holds at least count objects
+     * and makes them available (e.g. to prewarm the store at startup).
+     *
+     * @param count Amount of objects the store should hold.
+     * @param args Arguments passed to the constructor of each new object.
+     */
+    template<typename... Args>
+    void reserve(size_t count, const Args&... args){
+        while(objects.size() < count){
+            objects.emplace(args...);
+            availability.push_back(true);
         }
     }
 
 
-    inline T* acquire(size_t &index){
+    /**
+     * Acquires an available object or constructs a new one if none is available.
+     *
+     * @param index Set to the index of the object that needs to be passed to release().
+     * @param args Arguments passed to the constructor if a new object is needed (recycled objects are returned as they are).
+     * @return T* Acquired object.
+     */
+    template<typename... Args>
+    inline T* acquire(size_t &index, Args&&... args){
         for(size_t i=0; i < availability.size(); i++){
             if(availability[i]){
                 availability[i] = false;
                 index = i;
-                return objects[index];
+                return objects.get(index);
             }
         }
 
         // not enough objects available, create a new one
-        objects.push_back(new T());
-        index = objects.size() - 1;
+        index = objects.emplace(std::forward<Args>(args)...);
         availability.push_back(false);
-        return objects[index];
+        return objects.get(index);
     }
     
 
@@ -58,7 +89,7 @@ public:
     std::string toString(std::function<std::string(T*)> objToStr) const {
         std::string objStr = "";
         for(size_t i=0; i < objects.size(); i++){
-            objStr += ", "+objToStr(objects[i]);
+            objStr += ", "+objToStr(objects.get(i));
         }
         objStr = objStr.empty() ? objStr : objStr.substr(2);
 
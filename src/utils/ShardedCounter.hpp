@@ -0,0 +1,152 @@
+/**
+ * Counter that is split into cache-line-padded shards so threads on different cores
+ * can update it without bouncing a shared cache line.
+ *
+ * @file ShardedCounter.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+
+#ifndef SPI_SHARDED_COUNTER_HPP
+#define SPI_SHARDED_COUNTER_HPP
+
+#include "./HardwareUtils.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+namespace spi {
+
+
+/**
+ * How a thread picks the shard of a ShardedCounter it updates.
+ */
+enum class ShardSelection {
+    THREAD, // fixed per thread, assigned round-robin on first use (no call per update)
+    CPU,    // CPU the thread currently runs on (best spread if threads are not pinned, costs a sched_getcpu() per update)
+};
+
+
+/**
+ * Integer counter for statistics and bookkeeping that gets updated far more often than it gets read.
+ *
+ * Every update is a relaxed fetch_add on one of several shards that each live on their own cache line,
+ * so threads on different cores do not contend. A read sums up all shards.
+ * Shards of a signed counter may become negative (e.g. a thread increments on one CPU and decrements
+ * on another), only the sum is meaningful.
+ *
+ * @tparam T Integral type of the counter.
+ */
+template<typename T = int64_t>
+class ShardedCounter {
+    static_assert(std::is_integral_v<T>, "ShardedCounter requires an integral type");
+
+protected:
+    struct Shard {
+        alignas(CACHE_LINE_SIZE) std::atomic<T> value{0};
+    };
+
+    std::unique_ptr<Shard[]> shards;
+    size_t mask;
+    ShardSelection selection;
+
+    static size_t threadIndex() noexcept {
+        static std::atomic<size_t> nextIndex{0};
+        thread_local size_t index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+        return index;
+    }
+
+    inline Shard& shard() noexcept {
+        if(selection == ShardSelection::CPU){
+            const int cpu = HardwareUtils::currentCPU();
+            if(cpu >= 0) return shards[(size_t)cpu & mask];
+        }
+        return shards[threadIndex() & mask];
+    }
+
+public:
+
+    /**
+     * @param selection How threads pick the shard they update.
+     * @param shardCount Amount of shards (rounded up to a power of two).
+     *                   If 0 the amount of CPU cores is used.
+     */
+    ShardedCounter(ShardSelection selection = ShardSelection::THREAD, size_t shardCount = 0) : selection(selection) {
+        if(shardCount == 0) shardCount = (size_t)std::max(1, HardwareUtils::getCpuCoreCount());
+        shardCount = std::bit_ceil(shardCount);
+        this->shards = std::make_unique<Shard[]>(shardCount);
+        this->mask = shardCount - 1;
+    }
+
+    ShardedCounter(const ShardedCounter&) = delete;
+    ShardedCounter& operator=(const ShardedCounter&) = delete;
+
+    inline void add(T delta) noexcept {
+        shard().value.fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    inline void sub(T delta) noexcept {
+        shard().value.fetch_sub(delta, std::memory_order_relaxed);
+    }
+
+    inline void increment() noexcept {
+        add(1);
+    }
+
+    inline void decrement() noexcept {
+        sub(1);
+    }
+
+    /**
+     * Sums up all shards without synchronizing with updaters.
+     * Cheap but while updates are in progress the result may be a value the counter never had
+     * (shards are read one after another), once updates stopped it is exact.
+     */
+    T load() const noexcept {
+        T sum = 0;
+        for(size_t i=0; i <= mask; i++) sum += shards[i].value.load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    /**
+     * Sums up all shards until two passes in a row return the same value, so the result includes
+     * every update that happened before the call and is a value the counter actually had
+     * if no update raced with both passes. Reads every shard at least twice and gives up
+     * after maxPasses (returning the last sum) if updates keep changing the counter.
+     */
+    T loadExact(uint32_t maxPasses = 16) const noexcept {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        T previous = load();
+        for(uint32_t pass=1; pass < maxPasses; pass++){
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const T current = load();
+            if(current == previous) break;
+            previous = current;
+        }
+        return previous;
+    }
+
+    /**
+     * Sets the counter to zero (updates racing with the reset may get lost).
+     */
+    void reset() noexcept {
+        for(size_t i=0; i <= mask; i++) shards[i].value.store(0, std::memory_order_relaxed);
+    }
+
+    size_t getShardCount() const noexcept {
+        return mask + 1;
+    }
+
+    ShardSelection getSelection() const noexcept {
+        return selection;
+    }
+};
+
+
+}
+
+#endif // SPI_SHARDED_COUNTER_HPP
@@ -0,0 +1,145 @@
+/**
+ * Move-only callable wrapper with inline storage used for tasks of Thread and ThreadPool.
+ *
+ * @file Task.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+
+#ifndef SPI_TASK_HPP
+#define SPI_TASK_HPP
+
+#include "./InlineStorage.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/** Default amount of bytes a Task can store without allocating memory on the heap. */
+#ifndef SPI_TASK_INLINE_SIZE
+#define SPI_TASK_INLINE_SIZE 64
+#endif
+
+namespace spi {
+
+
+
+/**
+ * Stores a callable together with its arguments and calls it without any arguments.
+ * Replacement for std::function<void()> + std::bind() that:
+ *  - is move-only, therefore callables and arguments can be move-only too,
+ *  - forwards (moves) arguments into the task instead of copying them,
+ *  - stores callables of up to InlineSize bytes inside the object itself
+ *    and only allocates on the heap if the callable is bigger (see InlineStorage).
+ *
+ * Arguments are passed to the callable as lvalues (same as std::bind()).
+ *
+ * @tparam InlineSize Bytes available for storing the callable inline.
+ */
+template<size_t InlineSize = SPI_TASK_INLINE_SIZE>
+class InlineTask {
+protected:
+
+    /** Callable together with the arguments it gets called with. */
+    template<typename Fn, typename... Args>
+    struct Bound {
+        Fn fn;
+        std::tuple<Args...> args;
+
+        template<typename F, typename... A>
+        Bound(F&& fn, A&&... args) : fn(std::forward<F>(fn)), args(std::forward<A>(args)...) {}
+
+        inline void operator()(){
+            std::apply([this](Args&... args){ std::invoke(this->fn, args...); }, this->args);
+        }
+    };
+
+    InlineStorage<void(), InlineSize> callable;
+
+public:
+
+    /**
+     * Creates an empty task.
+     */
+    InlineTask() noexcept = default;
+
+    InlineTask(std::nullptr_t) noexcept {}
+
+    /**
+     * Creates a task that calls fn with the given arguments.
+     *
+     * @param fn Function that should be called.
+     * @param args Arguments to pass to the function (get moved or copied into the task).
+     */
+    template<class Fn, class... Args> requires (!std::is_same_v<std::remove_cvref_t<Fn>, InlineTask> && !std::is_same_v<std::remove_cvref_t<Fn>, std::nullptr_t>)
+    InlineTask(Fn&& fn, Args&&... args){
+        this->emplace(std::forward<Fn>(fn), std::forward<Args>(args)...);
+    }
+
+    InlineTask(InlineTask&& other) noexcept = default;
+    InlineTask& operator=(InlineTask&& other) noexcept = default;
+
+    InlineTask(const InlineTask&) = delete;
+    InlineTask& operator=(const InlineTask&) = delete;
+
+    /**
+     * Replaces the stored callable by fn called with the given arguments.
+     *
+     * @param fn Function that should be called.
+     * @param args Arguments to pass to the function (get moved or copied into the task).
+     */
+    template<class Fn, class... Args>
+    void emplace(Fn&& fn, Args&&... args){
+        if constexpr (sizeof...(Args) == 0){
+            this->callable.template construct<std::decay_t<Fn>>(std::forward<Fn>(fn));
+        } else {
+            this->callable.template construct<Bound<std::decay_t<Fn>, std::decay_t<Args>...>>(std::forward<Fn>(fn), std::forward<Args>(args)...);
+        }
+    }
+
+    /**
+     * Destroys the stored callable (task is empty afterwards).
+     */
+    void reset() noexcept {
+        this->callable.reset();
+    }
+
+    /**
+     * Calls the stored callable.
+     *
+     * @throws std::bad_function_call if the task is empty.
+     */
+    inline void operator()(){
+        this->callable.invoke();
+    }
+
+    /**
+     * Returns if a callable is stored.
+     */
+    explicit operator bool() const noexcept {
+        return this->callable.hasCallable();
+    }
+
+    /**
+     * Returns if a callable of the given type would be stored without allocating memory on the heap.
+     *
+     * @tparam Fn Type of the callable.
+     * @tparam Args Types of the arguments.
+     */
+    template<class Fn, class... Args>
+    static constexpr bool isStoredInline(){
+        if constexpr (sizeof...(Args) == 0) return InlineStorage<void(), InlineSize>::template fitsInline<std::decay_t<Fn>>;
+        else return InlineStorage<void(), InlineSize>::template fitsInline<Bound<std::decay_t<Fn>, std::decay_t<Args>...>>;
+    }
+};
+
+
+/** Task with the default inline storage size (SPI_TASK_INLINE_SIZE). */
+typedef InlineTask<> Task;
+
+
+
+}
+
+#endif // SPI_TASK_HPP
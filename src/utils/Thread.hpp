@@ -8,45 +8,40 @@
 #ifndef SPI_THREAD_HPP
 #define SPI_THREAD_HPP
 
+#include "./Barrier.hpp"
 #include "./HardwareUtils.hpp"
+#include "./LatencyHistogram.hpp"
+#include "./QueueAtomic.hpp"
+#include "./RecycleObjectStoreQueue.hpp"
+#include "./ShardedCounter.hpp"
+#include "./Task.hpp"
+#include "./TimerWheel.hpp"
+#include "./Trace.hpp"
+#include "./WorkStealingDeque.hpp"
 
 #include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <cstdint>
+#include <exception>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <queue>
 #include <thread>
+#include <type_traits>
 #include <unistd.h>
 #include <vector>
 
+/** Every n-th task a worker picks starts the search at a lower priority lane so lower lanes cannot starve. */
+#ifndef SPI_THREAD_POOL_AGING_INTERVAL
+#define SPI_THREAD_POOL_AGING_INTERVAL 16
+#endif
+
 namespace spi {
 class HardwareUtils; // defined in HardwareUtils.hpp
 
-typedef std::function<void()> Task;
-
-class Cancellable {
-protected:
-    bool cancelled = false;
-
-public:
-
-    bool isCancelled(){
-        return this->cancelled;
-    }
-
-    /**
-     * Cancels the running task if it hasn't been executed yet.
-     */
-    void cancel(){
-        this->cancelled = true;
-    }
-};
-
-
-
 class ThreadState {
 public:
     enum Type : uint8_t {
@@ -129,7 +124,7 @@ protected:
 
     struct ThreadData {
         std::thread *thr = nullptr;
-        Task task;
+        std::shared_ptr<Task> task; // shared with Thread object so restarting does not need to copy the task
         std::atomic<ThreadState> state{ThreadState::STARTING};
         bool doDetach = false;
 
@@ -139,7 +134,7 @@ protected:
 
         std::atomic<size_t> references{2}; // one from Thread object and one from std::thread
 
-        ThreadData(Task task, bool doDetach) : task(task), doDetach(doDetach) {
+        ThreadData(std::shared_ptr<Task> task, bool doDetach, const std::vector<size_t> &cpus) : task(std::move(task)), doDetach(doDetach), cpus(cpus) {
             this->thr = new std::thread([this]{ this->execute(); });
             if(doDetach) this->detach();
         }
@@ -200,8 +195,9 @@ protected:
                     CPU_SET(cpu, &cpuset); // specific CPU
             }
 
-            /*if(sched_setaffinity(this->tid, sizeof(cpuset), &cpuset) < 0)
-                Logger::warn("Could not set CPU affinity using sched_setaffinity() for threadId="+std::to_string(this->tid), __FILE__, __LINE__);*/
+            if(sched_setaffinity(this->tid, sizeof(cpuset), &cpuset) < 0){
+                //Logger::warn("Could not set CPU affinity using sched_setaffinity() for threadId="+std::to_string(this->tid), __FILE__, __LINE__);
+            }
         }
 
         void execute(){
@@ -215,7 +211,7 @@ protected:
             ThreadState expected = ThreadState::STARTING;
             this->state.compare_exchange_weak(expected, ThreadState::RUNNING);
 
-            this->task();
+            (*this->task)();
             
             this->state.store(ThreadState::TERMINATED);
             this->_invalidate();
@@ -224,7 +220,7 @@ protected:
     };
 
     ThreadData *current = nullptr; // shared because std::thread still needs access when detached
-    Task defaultTask;
+    std::shared_ptr<Task> defaultTask;
     std::vector<size_t> defaultCpus;
     bool defaultDoDetach = false;
 
@@ -238,7 +234,7 @@ public:
      */
     template <class Fn, class... Args> explicit
     Thread(Fn&& fn, Args&&... args){
-        this->defaultTask = std::bind(fn, args...);
+        this->defaultTask = std::make_shared<Task>(std::forward<Fn>(fn), std::forward<Args>(args)...);
     }
 
     /** Will terminate the thread immediately if still running.
@@ -324,6 +320,32 @@ public:
         }
     }
 
+    /**
+     * Lets the thread run on another CPU that shares the L3 cache with the given CPU
+     * (see CpuTopology::pickCpuSharingL3()) e.g. to place a consumer next to its producer.
+     * Can be set regardless of if thread is running or not.
+     * Overwrites setNumaNode();
+     *
+     * @param cpu CPU the thread should share the L3 cache with or -1 for the CPU of the calling thread
+     * @return int CPU the thread got bound to or -1 if no other CPU shares the L3 cache (thread stays unchanged)
+     */
+    int setCPUSharingL3(int cpu = -1){
+        const int picked = HardwareUtils::pickCpuSharingL3(cpu);
+        if(picked >= 0) this->setCPU(picked);
+        return picked;
+    }
+
+    /**
+     * Lets the thread run on any CPU that shares the L3 cache with the given CPU (including the given CPU).
+     * Can be set regardless of if thread is running or not.
+     * Overwrites setNumaNode();
+     *
+     * @param cpu CPU whose L3 domain the thread should run in
+     */
+    void setL3Domain(int cpu){
+        this->setCPUs(cpu >= 0 ? HardwareUtils::getTopology().getCpusSharingL3((size_t)cpu) : std::vector<size_t>());
+    }
+
     /**
      * Lets the thread run on a specific NUMA node.
      * Can be set regardless of if thread is running or not.
@@ -350,7 +372,7 @@ public:
     void start(){
         if(this->current != nullptr && this->current->thr != nullptr) return;
         if(this->current != nullptr) this->current->_dereference();
-        this->current = new ThreadData(this->defaultTask, this->defaultDoDetach);
+        this->current = new ThreadData(this->defaultTask, this->defaultDoDetach, this->defaultCpus);
     }
 
     
@@ -400,19 +422,13 @@ public:
     /**
      * Runs the given function after a given amount of milliseconds 
      * without blocking the calling thread.
+     * The function runs on the thread of TimerWheel::getShared() so it should not block,
+     * cancelling the returned handle removes it from the wheel.
      * 
      * @param milliseconds Amount of milliseconds after which the function should be executed.
      */
     static std::shared_ptr<Cancellable> runAfter(uint64_t milliseconds, std::function<void()> fn){
-        std::shared_ptr<Cancellable> cancellable = std::make_shared<Cancellable>();
-        Thread thr([milliseconds, fn, cancellable]{
-            if(milliseconds > 0) Thread::sleepMs(milliseconds);
-            if(cancellable->isCancelled()) return;
-            fn();
-        });
-        thr.start();
-        thr.detach(); // so thread object can be deleted while actual thread keeps running
-        return cancellable;
+        return TimerWheel::getShared().schedule(std::chrono::milliseconds(milliseconds), std::move(fn));
     }
 
     /**
@@ -446,9 +462,54 @@ public:
 
 
 
+/**
+ * Priority class of a task submitted to a ThreadPool.
+ */
+enum class TaskPriority : uint8_t {
+    HIGH = 0,   // latency critical (e.g. completing promises of client requests)
+    NORMAL = 1, // same class as tasks submitted without priority
+    LOW = 2,    // background work (e.g. compaction, window flushes)
+};
+
+/** Amount of TaskPriority values (one lane each). */
+constexpr size_t TASK_PRIORITY_COUNT = 3;
+
+
+/**
+ * Statistics of a priority lane of a ThreadPool.
+ */
+struct ThreadPoolLaneStats {
+    uint64_t submitted = 0;
+    uint64_t executed = 0;
+    uint64_t expired = 0;  // picked after their deadline and dropped without running
+    uint64_t rejected = 0; // deadline already passed at submission
+    size_t queued = 0;
+    LatencyHistogram queueLatency; // nanoseconds from submission until a worker picked the task
+};
+
+
+
 /**
  * Creates a pool of worker threads to which 
  * an unlimited amount of tasks can be given.
+ * 
+ * By default all tasks go through one shared queue. Optionally the pool can
+ * use a work-stealing scheduler instead: every worker owns a deque, tasks
+ * submitted by a worker land in its own deque and idle workers steal from
+ * randomly chosen other workers. Tasks submitted from outside the pool go
+ * into an injection queue. A submission wakes at most one sleeping worker.
+ * 
+ * With numaNode=ALL_NUMA_NODES the work-stealing scheduler runs one group of
+ * workers per NUMA node, each pinned to the CPUs of its node. Tasks can be
+ * routed to a node with submitTask(numaNode, fn, args...) and workers only
+ * steal from other nodes once everything on their own node is done.
+ *
+ * Tasks submitted with a TaskPriority (and optionally a deadline) go into one
+ * lock-free lane per priority that both schedulers check before their own queues
+ * (HIGH, then NORMAL together with tasks submitted without priority, then LOW).
+ * Every SPI_THREAD_POOL_AGING_INTERVAL-th pick of a worker starts at a lower lane,
+ * so lower priorities still progress while higher lanes are never empty.
+ * Tasks whose deadline passed are rejected at submission or dropped once picked.
  */
 class ThreadPool {
 protected:
@@ -467,57 +528,254 @@ protected:
 
     std::vector<WorkerThread> workers;
     std::mutex mWorkerThreads;
-    std::atomic<size_t> staleWorkerThreads{0};
 
-    std::queue<Task> tasks;
+    // priority lanes (tasks live in the queue nodes, a submission allocates a single node)
+    struct LaneTask {
+        Task task;
+        std::chrono::steady_clock::time_point enqueued;
+        std::chrono::steady_clock::time_point deadline;
+
+        LaneTask() = default;
+
+        template<class Fn, class... Args>
+        LaneTask(std::chrono::steady_clock::time_point enqueued, std::chrono::steady_clock::time_point deadline, Fn&& fn, Args&& ...args) :
+                task(std::forward<Fn>(fn), std::forward<Args>(args)...), enqueued(enqueued), deadline(deadline) {}
+    };
+
+    struct TaskLane {
+        QueueAtomic<LaneTask> queue;
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> queued{0};
+        ShardedCounter<uint64_t> submitted;
+        ShardedCounter<uint64_t> executed;
+        ShardedCounter<uint64_t> expired;
+        ShardedCounter<uint64_t> rejected;
+        ConcurrentLatencyHistogram latency;
+    };
+
+    /** Latency recorders of a worker thread, one per lane (reused by later workers). */
+    struct LaneRecorders {
+        ConcurrentLatencyHistogram::Recorder* lanes[TASK_PRIORITY_COUNT];
+        uint32_t picks = 0; // for aging
+    };
+
+    TaskLane lanes[TASK_PRIORITY_COUNT];
+    std::vector<LaneRecorders*> allRecorders;
+    std::vector<LaneRecorders*> freeRecorders; // guarded by mRecorders
+    std::mutex mRecorders;
+    ShardedCounter<int64_t> staleWorkerThreads; // statistics only (see getIdleThreadCount), updated by every worker per task
+
+    alignas(CACHE_LINE_SIZE) std::queue<Task> tasks;
     std::mutex mTasks;
     std::condition_variable cvTasks; // used to signal that a new task has been added
     std::condition_variable cvIdle; // used to signal that all tasks have been executed
+    bool stoppingWorkers = false; // guarded by mTasks, lets all workers terminate once the queue is empty
+    std::atomic<int> idleWorkers{0}; // workers not executing a task, submissions neither spawn workers nor (lanes) lock mTasks if there are some
+
+    // work-stealing scheduler
+    struct StealingWorker {
+        Thread* thr = nullptr;
+        WorkStealingDeque<Task> deque;
+        RecycleObjectStoreQueue<Task> recycledTasks; // emptied tasks for reuse (only touched by this worker)
+        size_t node; // index into stealingNodes
+        uint64_t rng; // state for choosing random victims
+        LaneRecorders* recorders = nullptr;
+
+        std::vector<Task*> returnedTasks; // tasks of recycledTasks that got executed by other workers (guarded by mReturned)
+        std::mutex mReturned;
+        std::atomic<size_t> returnedCount{0};
+    };
+
+    /** Workers and injection queue that belong to the same NUMA node. */
+    struct StealingNode {
+        int numaNode = -1; // -1 if workers are not bound to a NUMA node
+        std::vector<size_t> cpus; // CPUs the workers get pinned to (empty if not pinned)
+        std::vector<size_t> workers; // indices into stealingWorkers
+
+        std::queue<Task> injectedTasks; // tasks submitted from outside the pool (guarded by mInjected)
+        std::mutex mInjected;
+        std::atomic<size_t> injectedCount{0};
+
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> sleepingWorkers{0};
+        size_t wakeSignals = 0; // guarded by mPark
+        std::mutex mPark;
+        std::condition_variable cvWake;
+    };
+
+    bool workStealing;
+    std::vector<StealingWorker*> stealingWorkers;
+    std::vector<StealingNode*> stealingNodes;
+    std::atomic<bool> stealingStarted{false};
+    std::atomic<bool> stealingStopping{false};
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> pendingTasks{0}; // submitted but not yet finished
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> nextNode{0}; // round-robin for external submissions
+    std::mutex mIdle;
+
+    inline static thread_local ThreadPool* currentPool = nullptr;
+    inline static thread_local size_t currentWorkerIndex = 0;
+
+    LaneRecorders* acquireLaneRecorders(){
+        std::unique_lock<std::mutex> lRecorders(this->mRecorders);
+        if(!this->freeRecorders.empty()){
+            LaneRecorders* recorders = this->freeRecorders.back();
+            this->freeRecorders.pop_back();
+            return recorders;
+        }
+        LaneRecorders* recorders = new LaneRecorders();
+        for(size_t i=0; i < TASK_PRIORITY_COUNT; i++) recorders->lanes[i] = &this->lanes[i].latency.recorder();
+        this->allRecorders.push_back(recorders);
+        return recorders;
+    }
+
+    void releaseLaneRecorders(LaneRecorders* recorders){
+        std::unique_lock<std::mutex> lRecorders(this->mRecorders);
+        this->freeRecorders.push_back(recorders);
+    }
+
+    inline bool hasLaneTasks() const noexcept {
+        for(const TaskLane &lane : this->lanes)
+            if(lane.queued.load(std::memory_order_acquire) != 0) return true;
+        return false;
+    }
+
+    inline bool popLaneTask(size_t lane, LaneTask &task){
+        TaskLane &l = this->lanes[lane];
+        if(l.queued.load(std::memory_order_acquire) == 0) return false;
+        if(!l.queue.pop(task)) return false;
+        l.queued.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * Returns the lane a worker starts searching at: HIGH, except for every
+     * SPI_THREAD_POOL_AGING_INTERVAL-th pick which starts at the lower lanes in turn.
+     */
+    static inline size_t firstLane(LaneRecorders* recorders) noexcept {
+        const uint32_t picks = ++recorders->picks;
+        if(picks % SPI_THREAD_POOL_AGING_INTERVAL != 0) return 0;
+        return 1 + (picks / SPI_THREAD_POOL_AGING_INTERVAL) % (TASK_PRIORITY_COUNT - 1);
+    }
+
+    /**
+     * Runs a task of a lane or drops it if its deadline passed.
+     */
+    void runLaneTask(size_t lane, LaneTask &task, LaneRecorders* recorders){
+        TaskLane &l = this->lanes[lane];
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if(now > task.deadline){
+            l.expired.increment();
+        } else {
+            recorders->lanes[lane]->record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - task.enqueued).count());
+            {
+                SPI_TRACE_SCOPE("ThreadPool::task");
+                task.task();
+            }
+            l.executed.increment();
+        }
+        task.task.reset();
+    }
+
+    /**
+     * Removes all tasks of the lanes without running them.
+     *
+     * @return size_t Amount of removed tasks.
+     */
+    size_t clearLanes(){
+        size_t count = 0;
+        for(TaskLane &lane : this->lanes){
+            LaneTask task;
+            while(lane.queue.pop(task)){
+                lane.queued.fetch_sub(1, std::memory_order_relaxed);
+                task.task.reset();
+                count++;
+            }
+        }
+        return count;
+    }
 
     /**
      * Function that workers execute
      */
     void workerExecute(WorkerThread me){
-        this->staleWorkerThreads.fetch_add(1);
+        ThreadPool::currentPool = this;
+        LaneRecorders* recorders = this->acquireLaneRecorders();
+        this->staleWorkerThreads.increment();
+        this->idleWorkers.fetch_add(1, std::memory_order_relaxed);
         while(true){
 
             // locks tasks
             std::unique_lock<std::mutex> lTasks(this->mTasks);
 
-            if(this->tasks.empty()) this->cvIdle.notify_all(); // signal that all tasks have been executed
+            if(this->tasks.empty() && !this->hasLaneTasks()) this->cvIdle.notify_all(); // signal that all tasks have been executed
             
             // wait for new tasks
-            if(this->cvTasks.wait_for(lTasks, this->keepAliveMs) != std::cv_status::no_timeout){
-
-                // no timeout, task maybe ready
-                if(!this->tasks.empty()){
-                    this->staleWorkerThreads.fetch_add(-1); // signal that this worker is working (no longer stale)
-                    Task task = this->tasks.front(); // retrieve first element
+            std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with submitTask(priority, deadline, ...): it sees this idle worker or this worker sees its task
+            const bool woken = this->cvTasks.wait_for(lTasks, this->keepAliveMs, [this]{ return !this->tasks.empty() || this->hasLaneTasks() || this->stoppingWorkers; });
+            if(woken && (!this->tasks.empty() || this->hasLaneTasks())){
+
+                // no timeout, task maybe ready (tasks without priority belong to the NORMAL lane)
+                this->idleWorkers.fetch_sub(1, std::memory_order_relaxed);
+                this->staleWorkerThreads.decrement(); // signal that this worker is working (no longer stale)
+                const size_t first = ThreadPool::firstLane(recorders);
+                LaneTask laneTask;
+                bool picked = false;
+                size_t lane = 0;
+                Task task;
+                if(!this->hasLaneTasks() && !this->tasks.empty()){ // only tasks without priority, no lane to search
+                    task = std::move(this->tasks.front()); // retrieve first element
                     this->tasks.pop(); // remove first element
                     lTasks.unlock(); // unlock tasks
+                } else {
+                    lTasks.unlock(); // lanes are lock-free, only the tasks without priority need the lock
+                    for(size_t i=0; i < TASK_PRIORITY_COUNT && !picked && !task; i++){
+                        lane = (first + i) % TASK_PRIORITY_COUNT;
+                        picked = this->popLaneTask(lane, laneTask);
+                        if(!picked && lane == (size_t)TaskPriority::NORMAL){
+                            lTasks.lock();
+                            if(!this->tasks.empty()){
+                                task = std::move(this->tasks.front());
+                                this->tasks.pop();
+                            }
+                            lTasks.unlock();
+                        }
+                    }
+                }
 
-                    // execute tasks
-                    /* TODO REDO try {
-                        task();
-                    } catch (const std::exception &ex){
-                        Logger::error(ex, "Exception occured while executing task", __FILE__, __LINE__);
-                    }*/
+                // execute tasks
+                /* TODO REDO try {
+                    task();
+                } catch (const std::exception &ex){
+                    Logger::error(ex, "Exception occured while executing task", __FILE__, __LINE__);
+                }*/
+                if(picked){
+                    this->runLaneTask(lane, laneTask, recorders);
+                } else if(task){
+                    SPI_TRACE_SCOPE("ThreadPool::task");
                     task(); // TODO REMOVE
+                }
 
-                    this->staleWorkerThreads.fetch_add(1); // signal that this worker is stale
-
-                } else lTasks.unlock();
+                this->staleWorkerThreads.increment(); // signal that this worker is stale
+                this->idleWorkers.fetch_add(1, std::memory_order_relaxed);
 
             } else {
-                // timeout reached, check if this worker can get destructed
+                // timeout reached or pool stopping, check if this worker can get destructed
                 std::unique_lock<std::mutex> lWorkerThreads(this->mWorkerThreads);
 
                 // check if this worker can get destructed
-                if((int)this->workers.size() > this->minThreadsAlive){
+                if(this->stoppingWorkers || (int)this->workers.size() > this->minThreadsAlive){
                     // destruct this worker
-                    this->staleWorkerThreads.fetch_add(-1);
+                    this->staleWorkerThreads.decrement();
+                    this->idleWorkers.fetch_sub(1, std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with submitTask(priority, deadline, ...): it spawns a worker or this worker sees its task
+                    if(this->hasLaneTasks()){
+                        this->staleWorkerThreads.increment();
+                        this->idleWorkers.fetch_add(1, std::memory_order_relaxed);
+                        continue;
+                    }
                     this->workers.erase(std::remove(this->workers.begin(), this->workers.end(), me), this->workers.end());
+                    me.thr->detach(); // cannot join itself
                     delete me.thr;
+                    this->releaseLaneRecorders(recorders);
+                    ThreadPool::currentPool = nullptr;
                     break;
                 }
             }
@@ -528,18 +786,375 @@ protected:
      * Decides if new workers need to be spawned
      */
     void ensureWorkerThreads(){
+        if(this->idleWorkers.load(std::memory_order_relaxed) != 0)
+            return; // do not spawn new threads if there are stale workers (single counter, no lock)
         std::unique_lock<std::mutex> lWorkerThreads(this->mWorkerThreads);
-        if((this->maxThreads > 0 && (int)this->workers.size() >= this->maxThreads) || this->staleWorkerThreads.load() != 0)
-            return; // do not spawn new threads if:  no more threads can be spawned OR there are stale workers
+        if(this->maxThreads > 0 && (int)this->workers.size() >= this->maxThreads)
+            return; // do not spawn new threads if no more threads can be spawned
 
+        std::shared_ptr<Thread*> self = std::make_shared<Thread*>(nullptr); // set before start so worker knows its own thread
         WorkerThread worker;
-        worker.thr = new Thread([this, worker]{ this->workerExecute(worker); });
+        worker.thr = new Thread([this, self]{ this->workerExecute(WorkerThread{*self}); });
+        *self = worker.thr;
+        if(this->numaNode >= 0) worker.thr->setNumaNode(this->numaNode);
         this->workers.push_back(worker);
         worker.thr->start();
     }
 
+    /**
+     * Lets all workers terminate once the shared queue is empty and waits until they did.
+     */
+    void stopWorkerThreads(){
+        {
+            std::unique_lock<std::mutex> lTasks(this->mTasks);
+            this->stoppingWorkers = true;
+        }
+        this->cvTasks.notify_all();
+        while(true){
+            {
+                std::unique_lock<std::mutex> lWorkerThreads(this->mWorkerThreads);
+                if(this->workers.empty()) break;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    /**
+     * Creates the nodes and workers of the work-stealing scheduler (threads are not started yet).
+     */
+    void setupStealingWorkers(){
+        std::vector<int> numaNodes;
+        if(this->numaNode == ThreadPool::ALL_NUMA_NODES){
+            const size_t nodeCount = HardwareUtils::getNumaNodeCount();
+            for(int node=0; numaNodes.size() < nodeCount && node < 1024; node++)
+                if(!HardwareUtils::getCpusOfNumaNode(node).empty()) numaNodes.push_back(node);
+        } else if(this->numaNode >= 0){
+            numaNodes.push_back(this->numaNode);
+        }
+
+        for(int node : numaNodes){
+            std::vector<size_t> cpus = HardwareUtils::getCpusOfNumaNode(node);
+            if(cpus.empty()) continue;
+            StealingNode* stealingNode = new StealingNode();
+            stealingNode->numaNode = node;
+            stealingNode->cpus = cpus;
+            this->stealingNodes.push_back(stealingNode);
+        }
+        if(this->stealingNodes.empty())
+            this->stealingNodes.push_back(new StealingNode()); // no NUMA information -> single unpinned node
+
+        size_t count = this->maxThreads > 0 ? this->maxThreads : std::max(1, HardwareUtils::getCpuCoreCount());
+        count = std::max(count, this->stealingNodes.size()); // at least one worker per node
+        for(size_t i=0; i < count; i++){
+            StealingWorker* worker = new StealingWorker();
+            worker->node = i % this->stealingNodes.size();
+            worker->rng = 0x9E3779B97F4A7C15ull * (uint64_t)(i + 1);
+            this->stealingNodes[worker->node]->workers.push_back(i);
+            this->stealingWorkers.push_back(worker);
+        }
+    }
+
+    /**
+     * Returns the index of the node of the work-stealing scheduler that belongs to the given NUMA node.
+     * 
+     * @return int Index into stealingNodes or -1 if the pool has no workers on that NUMA node.
+     */
+    int stealingNodeIndexOf(int numaNode) const {
+        if(numaNode < 0) return -1;
+        for(size_t i=0; i < this->stealingNodes.size(); i++)
+            if(this->stealingNodes[i]->numaNode == numaNode) return (int)i;
+        return -1;
+    }
+
+    /**
+     * Spawns the workers of the work-stealing scheduler if not running yet.
+     */
+    void ensureStealingWorkers(){
+        if(this->stealingStarted.load(std::memory_order_acquire) && !this->stealingStopping.load(std::memory_order_relaxed)) return;
+        std::unique_lock<std::mutex> lWorkerThreads(this->mWorkerThreads);
+        if(this->stealingStarted.load(std::memory_order_relaxed)){
+            if(!this->stealingStopping.load()) return;
+            this->joinStealingWorkers(); // still retiring after cancelAllTasks(true)
+        }
+        this->stealingStopping.store(false);
+        for(size_t i=0; i < this->stealingWorkers.size(); i++){
+            StealingWorker* worker = this->stealingWorkers[i];
+            worker->thr = new Thread([this, i]{ this->stealingWorkerExecute(i); });
+            worker->thr->setCPUs(this->stealingNodes[worker->node]->cpus);
+            worker->thr->start();
+        }
+        this->stealingStarted.store(true, std::memory_order_release);
+    }
+
+    /**
+     * Stops and joins all workers of the work-stealing scheduler.
+     * Tasks that are still queued remain queued.
+     */
+    void stopStealingWorkers(){
+        std::unique_lock<std::mutex> lWorkerThreads(this->mWorkerThreads);
+        if(!this->stealingStarted.load(std::memory_order_relaxed)) return;
+        this->signalStealingWorkers();
+        this->joinStealingWorkers();
+    }
+
+    /**
+     * Lets all workers of the work-stealing scheduler terminate once they find no task (does not wait for them).
+     * Caller holds mWorkerThreads.
+     */
+    void signalStealingWorkers(){
+        this->stealingStopping.store(true);
+        for(StealingNode* node : this->stealingNodes){
+            std::unique_lock<std::mutex> lPark(node->mPark);
+            node->cvWake.notify_all();
+        }
+    }
+
+    /**
+     * Waits until the signalled workers of the work-stealing scheduler terminated.
+     * Caller holds mWorkerThreads.
+     */
+    void joinStealingWorkers(){
+        for(StealingWorker* worker : this->stealingWorkers){
+            if(ThreadPool::currentPool == this && this->stealingWorkers[ThreadPool::currentWorkerIndex] == worker)
+                worker->thr->detach(); // cannot join itself
+            else
+                worker->thr->join();
+            delete worker->thr;
+            worker->thr = nullptr;
+        }
+        this->stealingStarted.store(false, std::memory_order_release);
+    }
+
+    /**
+     * Wakes up a single sleeping worker of the work-stealing scheduler (if any).
+     * Prefers workers of the given node and only wakes workers of other nodes if none is sleeping there.
+     */
+    inline void wakeStealingWorker(size_t preferredNode){
+        std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with fence in parkStealingWorker()
+        const size_t count = this->stealingNodes.size();
+        for(size_t i=0; i < count; i++){
+            StealingNode* node = this->stealingNodes[(preferredNode + i) % count];
+            if(node->sleepingWorkers.load(std::memory_order_relaxed) == 0) continue;
+            std::unique_lock<std::mutex> lPark(node->mPark);
+            if(node->wakeSignals < node->sleepingWorkers.load(std::memory_order_relaxed))
+                node->wakeSignals++;
+            node->cvWake.notify_one();
+            return;
+        }
+    }
+
+    /**
+     * Returns if any task is queued in the work-stealing scheduler.
+     */
+    bool hasStealingTasks() const {
+        if(this->hasLaneTasks()) return true;
+        for(const StealingNode* node : this->stealingNodes)
+            if(node->injectedCount.load(std::memory_order_acquire) != 0) return true;
+        for(const StealingWorker* worker : this->stealingWorkers)
+            if(!worker->deque.empty()) return true;
+        return false;
+    }
+
+    /**
+     * Pops a task from the injection queue of a node.
+     */
+    Task* popInjectedTask(StealingWorker* me, StealingNode* node){
+        if(node->injectedCount.load(std::memory_order_acquire) == 0) return nullptr;
+        std::unique_lock<std::mutex> lInjected(node->mInjected);
+        if(node->injectedTasks.empty()) return nullptr;
+        Task* task = this->acquireStealingTask(me);
+        *task = std::move(node->injectedTasks.front());
+        node->injectedTasks.pop();
+        node->injectedCount.fetch_sub(1, std::memory_order_release);
+        return task;
+    }
+
+    /**
+     * Steals a task from a random worker of the given node.
+     */
+    Task* stealFromNode(StealingWorker* me, size_t index, const StealingNode* node, size_t &owner){
+        const size_t count = node->workers.size();
+        Task* task;
+        for(int round=0; round < 2; round++){
+            me->rng ^= me->rng << 13; me->rng ^= me->rng >> 7; me->rng ^= me->rng << 17; // xorshift
+            const size_t start = me->rng % count;
+            for(size_t i=0; i < count; i++){
+                const size_t victim = node->workers[(start + i) % count];
+                if(victim == index) continue;
+                if((task = this->stealingWorkers[victim]->deque.steal()) != nullptr){
+                    owner = victim;
+                    return task;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * Finds the next task a worker of the work-stealing scheduler should execute.
+     * Order: own deque, injection queue of own node, other workers of own node,
+     * and only then injection queues and workers of other nodes.
+     * 
+     * @param owner Set to the index of the worker whose recycle store the task belongs to.
+     */
+    Task* findStealingTask(size_t index, size_t &owner){
+        StealingWorker* me = this->stealingWorkers[index];
+        owner = index;
+        Task* task = me->deque.take();
+        if(task != nullptr) return task;
+
+        const size_t count = this->stealingNodes.size();
+        for(size_t i=0; i < count; i++){
+            StealingNode* node = this->stealingNodes[(me->node + i) % count];
+            if((task = this->popInjectedTask(me, node)) != nullptr) return task;
+            if((task = this->stealFromNode(me, index, node, owner)) != nullptr) return task;
+        }
+        return nullptr;
+    }
+
+    /**
+     * Lets a worker of the work-stealing scheduler sleep until new tasks got submitted.
+     */
+    void parkStealingWorker(size_t index){
+        StealingNode* node = this->stealingNodes[this->stealingWorkers[index]->node];
+        node->sleepingWorkers.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with fence in wakeStealingWorker()
+        if(!this->hasStealingTasks() && !this->stealingStopping.load()){
+            std::unique_lock<std::mutex> lPark(node->mPark);
+            node->cvWake.wait(lPark, [this, node]{ return node->wakeSignals > 0 || this->stealingStopping.load(); });
+            if(node->wakeSignals > 0) node->wakeSignals--;
+        }
+        node->sleepingWorkers.fetch_sub(1);
+    }
+
+    /**
+     * Acquires an empty task from the recycle store of a worker (only called by that worker).
+     * Takes back the tasks other workers executed first so the store does not grow with every stolen task.
+     */
+    Task* acquireStealingTask(StealingWorker* me){
+        if(me->returnedCount.load(std::memory_order_relaxed) != 0) this->reclaimReturnedTasks(me);
+        return me->recycledTasks.acquire();
+    }
+
+    /**
+     * Moves the tasks other workers handed back into the recycle store of the worker.
+     */
+    void reclaimReturnedTasks(StealingWorker* worker){
+        std::unique_lock<std::mutex> lReturned(worker->mReturned);
+        for(Task* task : worker->returnedTasks) worker->recycledTasks.release(task);
+        worker->returnedTasks.clear();
+        worker->returnedCount.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * Empties a task and hands it back to the recycle store it belongs to.
+     * 
+     * @param owner Index of the worker whose recycle store the task belongs to.
+     * @param task Executed or cancelled task.
+     */
+    void recycleStealingTask(size_t owner, Task* task){
+        task->reset();
+        StealingWorker* worker = this->stealingWorkers[owner];
+        if(ThreadPool::currentPool == this && ThreadPool::currentWorkerIndex == owner){
+            worker->recycledTasks.release(task);
+            return;
+        }
+        std::unique_lock<std::mutex> lReturned(worker->mReturned); // stolen task, store is only touched by its owner
+        worker->returnedTasks.push_back(task);
+        worker->returnedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Marks tasks of the work-stealing scheduler as done.
+     */
+    inline void finishStealingTasks(size_t count){
+        if(this->pendingTasks.fetch_sub(count, std::memory_order_acq_rel) == count){
+            std::unique_lock<std::mutex> lIdle(this->mIdle);
+            this->cvIdle.notify_all(); // signal that all tasks have been executed
+        }
+    }
+
+    /**
+     * Function that workers of the work-stealing scheduler execute
+     */
+    void stealingWorkerExecute(size_t index){
+        ThreadPool::currentPool = this;
+        ThreadPool::currentWorkerIndex = index;
+        StealingWorker* me = this->stealingWorkers[index];
+        if(me->recorders == nullptr) me->recorders = this->acquireLaneRecorders();
+        while(true){
+            // tasks without priority (own deque, injection queues, stealing) belong to the NORMAL lane
+            const size_t first = ThreadPool::firstLane(me->recorders);
+            Task* task = nullptr;
+            LaneTask laneTask;
+            bool picked = false;
+            size_t lane = 0;
+            size_t owner = index;
+            for(size_t i=0; i < TASK_PRIORITY_COUNT && !picked && task == nullptr; i++){
+                lane = (first + i) % TASK_PRIORITY_COUNT;
+                picked = this->popLaneTask(lane, laneTask);
+                if(!picked && lane == (size_t)TaskPriority::NORMAL) task = this->findStealingTask(index, owner);
+            }
+            if(picked){
+                this->runLaneTask(lane, laneTask, me->recorders);
+                this->finishStealingTasks(1);
+                continue;
+            }
+            if(task != nullptr){
+                {
+                    SPI_TRACE_SCOPE("ThreadPool::task");
+                    (*task)();
+                }
+                this->recycleStealingTask(owner, task);
+                this->finishStealingTasks(1);
+                continue;
+            }
+            if(this->stealingStopping.load()) break;
+            this->parkStealingWorker(index);
+        }
+        ThreadPool::currentPool = nullptr;
+    }
+
+    /**
+     * Hands a task to the work-stealing scheduler.
+     * 
+     * @param node Index of the node that should execute the task or -1 if any node can execute it.
+     * @param fn Function that should be called
+     * @param args Arguments to pass to the function
+     */
+    template <class Fn, class... Args>
+    void submitStealingTask(int node, Fn&& fn, Args&& ...args){
+        this->pendingTasks.fetch_add(1, std::memory_order_relaxed);
+        const bool fromWorker = ThreadPool::currentPool == this;
+        const size_t workerNode = fromWorker ? this->stealingWorkers[ThreadPool::currentWorkerIndex]->node : 0;
+        if(fromWorker && (node < 0 || (size_t)node == workerNode)){
+            StealingWorker* me = this->stealingWorkers[ThreadPool::currentWorkerIndex];
+            Task* task = this->acquireStealingTask(me);
+            task->emplace(std::forward<Fn>(fn), std::forward<Args>(args)...);
+            me->deque.push(task); // local submission
+            node = (int)workerNode;
+        } else {
+            if(node < 0){
+                if(this->stealingNodes.size() == 1){
+                    node = 0;
+                } else if((node = this->stealingNodeIndexOf(HardwareUtils::currentNumaNode())) < 0){
+                    node = (int)(this->nextNode.fetch_add(1, std::memory_order_relaxed) % this->stealingNodes.size());
+                }
+            }
+            StealingNode* target = this->stealingNodes[node];
+            std::unique_lock<std::mutex> lInjected(target->mInjected);
+            target->injectedTasks.emplace(std::forward<Fn>(fn), std::forward<Args>(args)...);
+            target->injectedCount.fetch_add(1, std::memory_order_release);
+        }
+        this->ensureStealingWorkers();
+        this->wakeStealingWorker((size_t)node);
+    }
+
 public:
 
+    /** Passed as numaNode to run a group of workers on every NUMA node. */
+    static constexpr int ALL_NUMA_NODES = -2;
+
     /**
      * Creates a thread pool which a variable amount of worker threads.
      * 
@@ -549,18 +1164,71 @@ public:
      *                   If -1 the maximum hardware concurrency wil be set as limit or 
      *                      if numaNode is defined then the hardware concurrency of the NUMA node is set.
      * @param keepAliveMs Milliseconds how long to keep stale threads alive (if zero then instantly destructed if no more tasks)
-     * @param numaNode NUMA node to assign the worker threads to. If -1 no NUMA optimization.
+     * @param numaNode NUMA node to pin the worker threads to. If -1 no NUMA optimization.
+     *                  If ALL_NUMA_NODES the pool runs a group of workers on every NUMA node (implies workStealing).
+     * @param workStealing If true tasks are scheduled using per-worker deques and work-stealing.
+     *                      In that mode the pool always runs maxThreads workers (hardware concurrency if 0)
+     *                      which are started on the first submission and stay alive until the pool gets destructed,
+     *                      therefore minThreadsAlive and keepAliveMs are ignored.
      */
-    ThreadPool(int minThreadsAlive=0, int maxThreads=-1, size_t keepAliveMs=5000, int numaNode=-1){
-        this->staleWorkerThreads.store(0);
+    ThreadPool(int minThreadsAlive=0, int maxThreads=-1, size_t keepAliveMs=5000, int numaNode=-1, bool workStealing=false){
         this->minThreadsAlive = minThreadsAlive;
         this->maxThreads = maxThreads < 0 ? HardwareUtils::getCpuCoreCount() : maxThreads;
         this->keepAliveMs = std::chrono::milliseconds(keepAliveMs);
         this->numaNode = numaNode;
+        this->workStealing = workStealing || numaNode == ThreadPool::ALL_NUMA_NODES;
+        if(this->workStealing) this->setupStealingWorkers();
     }
 
     ~ThreadPool(){
         cancelAllTasks();
+        if(this->workStealing){
+            this->stopStealingWorkers();
+            for(StealingWorker* worker : this->stealingWorkers){
+                this->reclaimReturnedTasks(worker); // store frees the tasks it holds
+                delete worker;
+            }
+            for(StealingNode* node : this->stealingNodes) delete node;
+        } else {
+            this->stopWorkerThreads();
+        }
+        this->clearLanes();
+        for(LaneRecorders* recorders : this->allRecorders) delete recorders;
+    }
+
+    /**
+     * Returns if this pool uses the work-stealing scheduler.
+     * 
+     * @return true if work-stealing is used, false if all tasks go through one shared queue.
+     */
+    bool isWorkStealing() const {
+        return this->workStealing;
+    }
+
+    /**
+     * Returns if the calling thread is a worker of this pool
+     * (used by executeOn() to run continuations inline).
+     * 
+     * @return true if called from within a task of this pool, false otherwise.
+     */
+    bool runsOnCurrentThread() const noexcept {
+        return ThreadPool::currentPool == this;
+    }
+
+    /**
+     * Returns the NUMA nodes the workers of this pool are pinned to.
+     * 
+     * @return std::vector<int> NUMA nodes (empty if workers are not pinned to NUMA nodes).
+     */
+    std::vector<int> getNumaNodes() const {
+        std::vector<int> nodes;
+        if(this->workStealing){
+            for(const StealingNode* node : this->stealingNodes)
+                if(node->numaNode >= 0) nodes.push_back(node->numaNode);
+        } else if(this->numaNode >= 0){
+            nodes.push_back(this->numaNode);
+        }
+        return nodes;
     }
 
     /**
@@ -569,20 +1237,61 @@ public:
      * @return size_t Amount of running worker threads.
      */
     size_t getCurrentThreadCount(){
+        if(this->workStealing)
+            return this->stealingStarted.load() ? this->stealingWorkers.size() : 0;
         return this->workers.size();
     }
 
+    /**
+     * Returns the amount of worker threads that currently do not execute a task
+     * (shared queue only, a snapshot while tasks get executed).
+     * 
+     * @return size_t Amount of idle worker threads.
+     */
+    size_t getIdleThreadCount() const {
+        return (size_t)std::max<int64_t>(0, this->staleWorkerThreads.load());
+    }
+
     /**
      * Removes pending tasks and closes all threads.
      * Does not block calling thread (use join afterwards to block).
      * 
      * @param immediately If true all threads are interruped and destructed immediately (may cause errors and undefined behavior).
+     *                      Workers of the work-stealing scheduler cannot be interrupted, they terminate after their current task
+     *                      without the caller waiting for them.
      *                      If false (default) currently running tasks will be finished before threads are destructed.
      * 
      */
     void cancelAllTasks(bool immediately = false){
+        if(this->workStealing){
+            if(immediately){ // workers terminate after their current task, joined by the destructor or the next submission
+                std::unique_lock<std::mutex> lWorkerThreads(this->mWorkerThreads);
+                if(this->stealingStarted.load(std::memory_order_relaxed)) this->signalStealingWorkers();
+            }
+            const size_t laneCount = this->clearLanes();
+            if(laneCount > 0) this->finishStealingTasks(laneCount);
+            for(StealingNode* node : this->stealingNodes){
+                std::unique_lock<std::mutex> lInjected(node->mInjected);
+                const size_t count = node->injectedTasks.size();
+                while(!node->injectedTasks.empty()) node->injectedTasks.pop();
+                node->injectedCount.store(0, std::memory_order_release);
+                lInjected.unlock();
+                if(count > 0) this->finishStealingTasks(count);
+            }
+            for(size_t i=0; i < this->stealingWorkers.size(); i++){
+                while(!this->stealingWorkers[i]->deque.empty()){
+                    Task* task = this->stealingWorkers[i]->deque.steal();
+                    if(task != nullptr){
+                        this->recycleStealingTask(i, task);
+                        this->finishStealingTasks(1);
+                    }
+                }
+            }
+            return;
+        }
         std::unique_lock<std::mutex> lTasks(this->mTasks);
         while(!this->tasks.empty()) this->tasks.pop();
+        this->clearLanes();
 
         if(immediately){
             // interrupt all threads (may cause errors and undefined behavior)
@@ -590,7 +1299,8 @@ public:
             for(WorkerThread &worker : this->workers)
                 delete worker.thr;
             this->workers.clear();
-            this->staleWorkerThreads.store(0);
+            this->staleWorkerThreads.reset();
+            this->idleWorkers.store(0, std::memory_order_relaxed);
         }
     }
 
@@ -599,11 +1309,90 @@ public:
      * therefore thread pool is idle.
      */
     void join(){
+        if(this->workStealing){
+            std::unique_lock<std::mutex> lIdle(this->mIdle);
+            this->cvIdle.wait(lIdle, [this]{ return this->pendingTasks.load() == 0; });
+            return;
+        }
         std::unique_lock<std::mutex> lTasks(this->mTasks);
-        while(!this->tasks.empty())
+        while(!this->tasks.empty() || this->hasLaneTasks())
             this->cvIdle.wait(lTasks);
     }
 
+    /**
+     * Calls fn for every index of [begin, end) using the workers of this pool and the calling thread,
+     * and blocks until all calls returned.
+     *
+     * The range is split into chunks of grain indices that get claimed through a shared atomic cursor.
+     * Instead of one task per index (or per chunk) at most one helper task per worker gets submitted,
+     * every helper and the caller claim chunks until the range is exhausted. The caller then waits until all claimed
+     * chunks completed, not for the helpers, so helpers that never run (busy workers, cancelAllTasks()) cannot block it.
+     * If called from within a task of this pool the range runs sequentially on the calling worker
+     * (waiting for helpers could otherwise deadlock if all workers are busy waiting themselves).
+     * The first exception thrown by fn stops the claiming of further chunks and gets rethrown to the caller.
+     *
+     * @tparam Fn Either void(size_t index) or void(size_t chunkBegin, size_t chunkEnd)
+     * @param begin First index
+     * @param end Index after the last one
+     * @param grain Amount of indices per chunk (if 0 the range is split into about four chunks per worker)
+     * @param fn Function that gets called for every index or chunk
+     */
+    template <class Fn>
+    void parallelFor(size_t begin, size_t end, size_t grain, Fn&& fn){
+        if(end <= begin) return;
+        const size_t workerCount = this->workStealing ? this->stealingWorkers.size() :
+                                    (size_t)(this->maxThreads > 0 ? this->maxThreads : std::max(1, HardwareUtils::getCpuCoreCount()));
+        if(grain == 0) grain = std::max<size_t>(1, (end - begin) / ((workerCount + 1) * 4));
+        const size_t chunks = (end - begin - 1) / grain + 1;
+
+        auto runChunk = [&fn](size_t chunkBegin, size_t chunkEnd){
+            if constexpr (std::is_invocable_v<Fn&, size_t, size_t>){
+                fn(chunkBegin, chunkEnd);
+            } else {
+                for(size_t i=chunkBegin; i < chunkEnd; i++) fn(i);
+            }
+        };
+        const size_t helpers = std::min(chunks - 1, workerCount);
+        if(helpers == 0 || ThreadPool::currentPool == this){
+            for(size_t i=begin; i < end; i += std::min(grain, end - i)) runChunk(i, std::min(end, i + grain));
+            return;
+        }
+
+        // shared with the helpers as they may start after the caller returned (then they only see an exhausted range)
+        struct ParallelFor {
+            alignas(CACHE_LINE_SIZE) std::atomic<size_t> next;
+            alignas(CACHE_LINE_SIZE) std::atomic<size_t> remaining; // chunks that did not complete yet
+            size_t end, grain;
+            decltype(runChunk) *run; // only valid while chunks remain
+            std::atomic<bool> failed{false};
+            std::exception_ptr error;
+
+            ParallelFor(size_t begin, size_t end, size_t grain, size_t chunks, decltype(runChunk) *run)
+                : next(begin), remaining(chunks), end(end), grain(grain), run(run) {}
+
+            void work(){
+                size_t chunkBegin;
+                while((chunkBegin = this->next.fetch_add(this->grain, std::memory_order_relaxed)) < this->end){
+                    if(!this->failed.load(std::memory_order_relaxed)){ // after a failure chunks only get counted
+                        try {
+                            (*this->run)(chunkBegin, std::min(this->end, chunkBegin + this->grain));
+                        } catch(...){
+                            if(!this->failed.exchange(true)) this->error = std::current_exception();
+                        }
+                    }
+                    if(this->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) this->remaining.notify_all();
+                }
+            }
+        };
+        std::shared_ptr<ParallelFor> state = std::make_shared<ParallelFor>(begin, end, grain, chunks, &runChunk);
+
+        for(size_t i=0; i < helpers; i++)
+            this->submitTask([state]{ state->work(); });
+        state->work();
+        spinThenPark(state->remaining, [](size_t remaining){ return remaining == 0; });
+        if(state->error) std::rethrow_exception(state->error);
+    }
+
     /**
      * Submits a tasks to the thread pool to be executed.
      * 
@@ -612,16 +1401,113 @@ public:
      * @param fn Function that should be called
      * @param args Arguments to pass to the function
      */
-    template <class Fn, class... Args>
+    template <class Fn, class... Args> requires (!std::is_integral_v<std::remove_cvref_t<Fn>> && !std::is_same_v<std::remove_cvref_t<Fn>, TaskPriority>)
     void submitTask(Fn&& fn, Args&& ...args){
+        if(this->workStealing){
+            this->submitStealingTask(-1, std::forward<Fn>(fn), std::forward<Args>(args)...);
+            return;
+        }
         std::unique_lock<std::mutex> lTasks(this->mTasks);
-        this->tasks.push(std::bind(fn, args...));
+        this->tasks.emplace(std::forward<Fn>(fn), std::forward<Args>(args)...);
         lTasks.unlock(); // unlock tasks
 
         this->ensureWorkerThreads();
         this->cvTasks.notify_all();
     }
 
+    /**
+     * Submits a task to the thread pool that should be executed by a worker of the given NUMA node
+     * (e.g. the node that owns the data the task works on).
+     * Workers of other nodes only execute the task if they have nothing else to do.
+     * If the pool has no workers on that node the task is submitted like with submitTask(fn, args...).
+     * 
+     * @tparam Fn Function that should be called
+     * @tparam Args Arguments to pass to the function
+     * @param numaNode NUMA node that should execute the task
+     * @param fn Function that should be called
+     * @param args Arguments to pass to the function
+     */
+    template <class Fn, class... Args>
+    void submitTask(int numaNode, Fn&& fn, Args&& ...args){
+        if(this->workStealing){
+            this->submitStealingTask(this->stealingNodeIndexOf(numaNode), std::forward<Fn>(fn), std::forward<Args>(args)...);
+            return;
+        }
+        this->submitTask(std::forward<Fn>(fn), std::forward<Args>(args)...);
+    }
+
+    /**
+     * Submits a task to the lane of the given priority.
+     * 
+     * @tparam Fn Function that should be called
+     * @tparam Args Arguments to pass to the function
+     * @param priority Priority class of the task
+     * @param fn Function that should be called
+     * @param args Arguments to pass to the function
+     */
+    template <class Fn, class... Args> requires (!std::is_same_v<std::remove_cvref_t<Fn>, std::chrono::steady_clock::time_point>)
+    void submitTask(TaskPriority priority, Fn&& fn, Args&& ...args){
+        this->submitTask(priority, std::chrono::steady_clock::time_point::max(), std::forward<Fn>(fn), std::forward<Args>(args)...);
+    }
+
+    /**
+     * Submits a task to the lane of the given priority that is only worth running until the given deadline.
+     * If no worker picked the task before the deadline it gets dropped without running.
+     * 
+     * @tparam Fn Function that should be called
+     * @tparam Args Arguments to pass to the function
+     * @param priority Priority class of the task
+     * @param deadline Point in time after which the task must not start anymore
+     * @param fn Function that should be called
+     * @param args Arguments to pass to the function
+     * @return true if the task got queued, false if the deadline already passed (task got rejected)
+     */
+    template <class Fn, class... Args>
+    bool submitTask(TaskPriority priority, std::chrono::steady_clock::time_point deadline, Fn&& fn, Args&& ...args){
+        TaskLane &lane = this->lanes[(size_t)priority];
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if(now > deadline){
+            lane.rejected.increment();
+            return false;
+        }
+        lane.submitted.increment();
+
+        if(this->workStealing){
+            this->pendingTasks.fetch_add(1, std::memory_order_relaxed);
+            lane.queue.emplace(now, deadline, std::forward<Fn>(fn), std::forward<Args>(args)...);
+            lane.queued.fetch_add(1, std::memory_order_release);
+            this->ensureStealingWorkers();
+            const size_t node = ThreadPool::currentPool == this ? this->stealingWorkers[ThreadPool::currentWorkerIndex]->node : 0;
+            this->wakeStealingWorker(node);
+            return true;
+        }
+        lane.queue.emplace(now, deadline, std::forward<Fn>(fn), std::forward<Args>(args)...);
+        lane.queued.fetch_add(1, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with workerExecute(): either a worker sees the task or this sees the worker
+        if(this->idleWorkers.load(std::memory_order_relaxed) != 0){
+            { std::unique_lock<std::mutex> lTasks(this->mTasks); } // worker between checking and waiting would miss the notify
+            this->cvTasks.notify_one(); // a single task needs a single worker
+        }
+        this->ensureWorkerThreads();
+        return true;
+    }
+
+    /**
+     * Returns the statistics of the lane of the given priority.
+     * Can be called while tasks get submitted and executed (values are a snapshot).
+     */
+    ThreadPoolLaneStats getLaneStats(TaskPriority priority) const {
+        const TaskLane &lane = this->lanes[(size_t)priority];
+        ThreadPoolLaneStats stats;
+        stats.submitted = lane.submitted.load();
+        stats.executed = lane.executed.load();
+        stats.expired = lane.expired.load();
+        stats.rejected = lane.rejected.load();
+        stats.queued = lane.queued.load(std::memory_order_relaxed);
+        lane.latency.snapshot(stats.queueLatency);
+        return stats;
+    }
+
 };
 
 
@@ -1,7 +1,7 @@
 /**
  * TimeUtils for handling time related stuff.
  * 
- * @file TimeUtils.cpp
+ * @file TimeUtils.hpp
  * @author Luca Vogels (github@luca-vogels.com)
  */
 
@@ -9,7 +9,20 @@
 #define SPI_TIME_UTILS_HPP
 
 #include <chrono>
+#include <cstdint>
+#include <ctime>
 #include <string>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+/** Milliseconds FastClock spends on calibrating the TSC against std::chrono::steady_clock at first use. */
+#ifndef SPI_FAST_CLOCK_CALIBRATION_MS
+#define SPI_FAST_CLOCK_CALIBRATION_MS 10
+#endif
 
 namespace spi {
 
@@ -233,5 +246,215 @@ public:
 };
 
 
+
+/**
+ * Sources FastClock can read time from.
+ */
+enum class FastClockSource : uint8_t {
+    TSC = 0,                // time stamp counter of the CPU (rdtsc), only used if invariant
+    MONOTONIC = 1,          // clock_gettime(CLOCK_MONOTONIC) served by the vDSO
+};
+
+
+/**
+ * Monotonic clock that is cheap enough to be read per operation (e.g. to time single queue hops).
+ *
+ * On x86 with an invariant TSC ticks() is a single rdtsc instruction and gets converted
+ * into nanoseconds with a multiplication. The TSC gets calibrated once against std::chrono::steady_clock
+ * at first use (takes SPI_FAST_CLOCK_CALIBRATION_MS, call calibrate() early to avoid the delay later)
+ * so nanoseconds of FastClock and steady_clock are comparable.
+ * Otherwise (no invariant TSC or SPI_FAST_CLOCK_NO_TSC defined) clock_gettime(CLOCK_MONOTONIC) is used.
+ *
+ * coarseNanos() is even cheaper but only has a resolution of a few milliseconds (CLOCK_MONOTONIC_COARSE).
+ */
+class FastClock {
+protected:
+
+    __extension__ typedef unsigned __int128 WideInt;
+
+    struct Calibration {
+        FastClockSource source = FastClockSource::MONOTONIC;
+        uint64_t baseTicks = 0;
+        uint64_t baseNanos = 0;
+        uint64_t nanosPerTickFixed = (uint64_t)1 << 32; // nanoseconds per tick as 32.32 fixed point
+        double ticksPerNanosecond = 1.0;
+    };
+
+    static inline uint64_t monotonicNanos() noexcept {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    }
+
+    static inline uint64_t steadyNanos() noexcept {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /** Returns if the CPU has an invariant TSC (constant rate, keeps running in deep sleep states). */
+    static bool hasInvariantTsc() noexcept {
+        #if (defined(__x86_64__) || defined(__i386__)) && !defined(SPI_FAST_CLOCK_NO_TSC)
+        unsigned int eax, ebx, ecx, edx;
+        if(__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 || eax < 0x80000007) return false;
+        if(__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0) return false;
+        return (edx & (1u << 8)) != 0;
+        #else
+        return false;
+        #endif
+    }
+
+    static Calibration measure() noexcept {
+        Calibration result;
+        if(!hasInvariantTsc()) return result;
+        #if defined(__x86_64__) || defined(__i386__)
+        const uint64_t startNanos = steadyNanos();
+        const uint64_t startTicks = __rdtsc();
+        std::this_thread::sleep_for(std::chrono::milliseconds(SPI_FAST_CLOCK_CALIBRATION_MS));
+        const uint64_t endNanos = steadyNanos();
+        const uint64_t endTicks = __rdtsc();
+        if(endTicks <= startTicks || endNanos <= startNanos) return result;
+        result.source = FastClockSource::TSC;
+        result.baseTicks = endTicks;
+        result.baseNanos = endNanos;
+        result.ticksPerNanosecond = (double)(endTicks - startTicks) / (double)(endNanos - startNanos);
+        result.nanosPerTickFixed = (uint64_t)(4294967296.0 / result.ticksPerNanosecond);
+        #endif
+        return result;
+    }
+
+    static const Calibration& calibration() noexcept {
+        static const Calibration instance = measure();
+        return instance;
+    }
+
+public:
+
+    /**
+     * Calibrates the clock if it has not happened yet (otherwise happens at first use).
+     */
+    static void calibrate() noexcept {
+        calibration();
+    }
+
+    /**
+     * Returns the source this clock reads from.
+     */
+    static FastClockSource source() noexcept {
+        return calibration().source;
+    }
+
+    /**
+     * Returns how many ticks happen per nanosecond (1 if the source already counts nanoseconds).
+     */
+    static double ticksPerNanosecond() noexcept {
+        return calibration().ticksPerNanosecond;
+    }
+
+    /**
+     * Returns the current time in ticks of the source (only meaningful relative to other ticks).
+     * Not ordered with surrounding instructions, use ticksOrdered() when timing very short sections.
+     */
+    static inline uint64_t ticks() noexcept {
+        #if defined(__x86_64__) || defined(__i386__)
+        if(calibration().source == FastClockSource::TSC) return __rdtsc();
+        #endif
+        return monotonicNanos();
+    }
+
+    /**
+     * Same as ticks() but waits until all previous instructions have been executed (rdtscp).
+     */
+    static inline uint64_t ticksOrdered() noexcept {
+        #if defined(__x86_64__) || defined(__i386__)
+        if(calibration().source == FastClockSource::TSC){
+            unsigned int aux;
+            return __rdtscp(&aux);
+        }
+        #endif
+        return monotonicNanos();
+    }
+
+    /**
+     * Converts ticks into nanoseconds (same epoch as std::chrono::steady_clock).
+     */
+    static inline uint64_t toNanos(uint64_t ticks) noexcept {
+        const Calibration &c = calibration();
+        if(c.source != FastClockSource::TSC) return ticks;
+        if(ticks >= c.baseTicks) return c.baseNanos + (uint64_t)(((WideInt)(ticks - c.baseTicks) * c.nanosPerTickFixed) >> 32);
+        return c.baseNanos - (uint64_t)(((WideInt)(c.baseTicks - ticks) * c.nanosPerTickFixed) >> 32);
+    }
+
+    /**
+     * Converts ticks into a point in time of std::chrono::steady_clock.
+     */
+    static inline std::chrono::steady_clock::time_point toTimePoint(uint64_t ticks) noexcept {
+        return std::chrono::steady_clock::time_point(std::chrono::nanoseconds(toNanos(ticks)));
+    }
+
+    /**
+     * Returns the current time in nanoseconds (same epoch as std::chrono::steady_clock).
+     */
+    static inline uint64_t nowNanos() noexcept {
+        return toNanos(ticks());
+    }
+
+    /**
+     * Returns the current time in nanoseconds with a resolution of only a few milliseconds
+     * but cheaper than nowNanos() if the TSC is not available (CLOCK_MONOTONIC_COARSE).
+     */
+    static inline uint64_t coarseNanos() noexcept {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    }
+
+
+    /**
+     * Returns the difference between two tick values in nanoseconds.
+     * 
+     * @param from Earlier ticks (gets subtracted from 'until').
+     * @param until Later ticks.
+     * @return int64_t Difference in nanoseconds (if 'from' before 'until' then value positive).
+     */
+    static inline int64_t differenceInNanoseconds(uint64_t from, uint64_t until) noexcept {
+        return (int64_t)(toNanos(until) - toNanos(from));
+    }
+
+    /**
+     * Returns the difference between given ticks and now in nanoseconds (now - from).
+     */
+    static inline int64_t differenceInNanoseconds(uint64_t from) noexcept {
+        return differenceInNanoseconds(from, ticks());
+    }
+
+    /**
+     * Returns the difference between two tick values in microseconds.
+     */
+    static inline int64_t differenceInMicroseconds(uint64_t from, uint64_t until) noexcept {
+        return differenceInNanoseconds(from, until) / 1000;
+    }
+
+    /**
+     * Returns the difference between given ticks and now in microseconds (now - from).
+     */
+    static inline int64_t differenceInMicroseconds(uint64_t from) noexcept {
+        return differenceInMicroseconds(from, ticks());
+    }
+
+    /**
+     * Returns the difference between two tick values in milliseconds.
+     */
+    static inline int64_t differenceInMilliseconds(uint64_t from, uint64_t until) noexcept {
+        return differenceInNanoseconds(from, until) / 1000000;
+    }
+
+    /**
+     * Returns the difference between given ticks and now in milliseconds (now - from).
+     */
+    static inline int64_t differenceInMilliseconds(uint64_t from) noexcept {
+        return differenceInMilliseconds(from, ticks());
+    }
+};
+
+
 }
 #endif // SPI_TIME_UTILS_HPP
\ No newline at end of file
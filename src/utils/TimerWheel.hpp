@@ -0,0 +1,360 @@
+/**
+ * Hierarchical timing wheel that runs delayed functions on a single thread
+ * instead of one sleeping thread per delayed call.
+ *
+ * @file TimerWheel.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+#ifndef SPI_TIMER_WHEEL_HPP
+#define SPI_TIMER_WHEEL_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/** Tick resolution of the wheel shared by Thread::runAfter() in microseconds. */
+#ifndef SPI_TIMER_WHEEL_TICK_US
+#define SPI_TIMER_WHEEL_TICK_US 1000
+#endif
+
+namespace spi {
+
+
+class Cancellable {
+protected:
+    std::atomic<bool> cancelled{false};
+
+public:
+
+    virtual ~Cancellable() = default;
+
+    bool isCancelled() const {
+        return this->cancelled.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Cancels the running task if it hasn't been executed yet.
+     */
+    virtual void cancel(){
+        this->cancelled.store(true, std::memory_order_release);
+    }
+};
+
+
+/**
+ * Timers are kept in LEVELS wheels of SLOTS slots each. Level 0 has one slot per tick,
+ * every further level covers SLOTS times the span of the level below. A timer goes into the
+ * lowest level whose span covers its delay and moves down a level (cascades) once the wheel
+ * below wraps around, so scheduling and cancelling are O(1) and an expiring slot is handled in one batch.
+ *
+ * Expired functions run on the thread that advances the wheel: either the thread owned by the
+ * wheel or whoever calls advance() (e.g. a pool worker), so they should be short and hand
+ * longer work off. Scheduling and cancelling are thread-safe. Handles must not be
+ * cancelled after the wheel got destroyed (timers still pending at that point never run).
+ */
+class TimerWheel {
+public:
+    static constexpr unsigned SLOT_BITS = 8;
+    static constexpr uint64_t SLOTS = 1ull << SLOT_BITS;
+    static constexpr unsigned LEVELS = 4;
+    static constexpr uint64_t SPAN = 1ull << (SLOT_BITS * LEVELS); // ticks covered by all levels
+
+    typedef std::chrono::steady_clock::time_point time_point;
+
+protected:
+
+    class Timer : public Cancellable {
+        friend class TimerWheel;
+    protected:
+        enum State : uint8_t { PENDING, FIRED, DROPPED };
+
+        TimerWheel* wheel;
+        std::function<void()> fn;
+        uint64_t expiry;                    // tick at which the timer expires
+        std::atomic<uint8_t> state{PENDING};
+        Timer* prev = nullptr;              // siblings in the slot (only touched while holding the lock of the wheel)
+        Timer* next = nullptr;
+        uint32_t slot = NO_SLOT;
+        std::shared_ptr<Timer> self;        // keeps the timer alive while it sits in a slot
+
+    public:
+        static constexpr uint32_t NO_SLOT = ~(uint32_t)0;
+
+        Timer(TimerWheel* wheel, std::function<void()> fn, uint64_t expiry) : wheel(wheel), fn(std::move(fn)), expiry(expiry) {}
+
+        /** Removes the timer from its slot right away so it neither runs nor occupies the wheel anymore. */
+        void cancel() override {
+            Cancellable::cancel();
+            uint8_t expected = PENDING;
+            if(this->state.compare_exchange_strong(expected, DROPPED)) this->wheel->remove(this);
+        }
+    };
+
+    const std::chrono::nanoseconds tick;
+    const time_point start;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::array<Timer*, LEVELS * SLOTS> slots{};
+    std::array<size_t, LEVELS> counts{};   // timers per level
+    uint64_t current = 0;                   // next tick that has not been processed yet
+    size_t pending = 0;
+    uint64_t wakeTick = ~(uint64_t)0;       // tick the own thread sleeps until
+    bool stopping = false;
+    std::vector<std::shared_ptr<Timer>> expired; // only used while holding advancing
+    std::mutex advancing;                   // one thread at a time runs expired functions
+    std::thread thread;
+
+    /** Converts a point in time to the first tick at or after it. */
+    inline uint64_t tickAfter(time_point time) const noexcept {
+        if(time <= this->start) return 0;
+        const uint64_t nanos = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(time - this->start).count();
+        return (nanos + (uint64_t)this->tick.count() - 1) / (uint64_t)this->tick.count();
+    }
+
+    /** Converts a point in time to the last tick that passed. */
+    inline uint64_t tickBefore(time_point time) const noexcept {
+        if(time <= this->start) return 0;
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(time - this->start).count() / (uint64_t)this->tick.count();
+    }
+
+    inline void link(Timer* timer, uint32_t slot) noexcept {
+        timer->slot = slot;
+        this->counts[slot / SLOTS]++;
+        timer->prev = nullptr;
+        timer->next = this->slots[slot];
+        if(timer->next != nullptr) timer->next->prev = timer;
+        this->slots[slot] = timer;
+    }
+
+    inline void unlink(Timer* timer) noexcept {
+        if(timer->prev != nullptr) timer->prev->next = timer->next;
+        else this->slots[timer->slot] = timer->next;
+        if(timer->next != nullptr) timer->next->prev = timer->prev;
+        this->counts[timer->slot / SLOTS]--;
+        timer->prev = timer->next = nullptr;
+        timer->slot = Timer::NO_SLOT;
+    }
+
+    /** Puts a timer into the slot of the lowest level that covers its delay (requires the lock). */
+    void insert(Timer* timer) noexcept {
+        const uint64_t delay = timer->expiry > this->current ? timer->expiry - this->current : 0;
+        const uint64_t expiry = this->current + (delay < SPAN ? delay : SPAN - 1); // beyond SPAN: cascades again later
+        unsigned level = 0;
+        while(level + 1 < LEVELS && delay >= (1ull << (SLOT_BITS * (level + 1)))) level++;
+        this->link(timer, (uint32_t)(level * SLOTS + ((expiry >> (SLOT_BITS * level)) & (SLOTS - 1))));
+    }
+
+    void remove(Timer* timer){
+        std::shared_ptr<Timer> keep; // released after unlocking, may be the last reference
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if(timer->slot == Timer::NO_SLOT) return; // already taken out to expire
+        this->unlink(timer);
+        this->pending--;
+        keep = std::move(timer->self);
+    }
+
+    /** Moves the timers of a slot one level down (requires the lock). */
+    void cascade(unsigned level, uint64_t index) noexcept {
+        Timer* timer = this->slots[level * SLOTS + index];
+        this->slots[level * SLOTS + index] = nullptr;
+        while(timer != nullptr){
+            Timer* next = timer->next;
+            this->counts[level]--;
+            this->insert(timer);
+            timer = next;
+        }
+    }
+
+    /**
+     * Returns the first tick at or after current that has to be processed: the next one with timers
+     * in level 0 or at which a non-empty slot of a higher level cascades (requires the lock).
+     */
+    uint64_t nextTick() const noexcept {
+        uint64_t next = ~(uint64_t)0;
+        for(unsigned level=0; level < LEVELS; level++){
+            if(this->counts[level] == 0) continue;
+            const unsigned shift = SLOT_BITS * level;
+            const uint64_t first = (this->current + (1ull << shift) - 1) >> shift; // first block starting at or after current
+            for(uint64_t block = first; block < first + SLOTS; block++){
+                if(this->slots[level * SLOTS + (block & (SLOTS - 1))] != nullptr){
+                    next = std::min(next, block << shift);
+                    break;
+                }
+            }
+        }
+        return next;
+    }
+
+    /** Processes all ticks up to target and collects the expired timers (requires the lock). */
+    void collect(uint64_t target){
+        while(this->current <= target){
+            const uint64_t tick = this->nextTick();
+            if(tick > target){
+                this->current = target + 1;
+                break;
+            }
+            this->current = tick;
+            if((tick & (SLOTS - 1)) == 0){
+                for(unsigned level=1; level < LEVELS; level++){
+                    const uint64_t index = (tick >> (SLOT_BITS * level)) & (SLOTS - 1);
+                    this->cascade(level, index);
+                    if(index != 0) break;
+                }
+            }
+            Timer* timer = this->slots[tick & (SLOTS - 1)];
+            this->slots[tick & (SLOTS - 1)] = nullptr;
+            while(timer != nullptr){
+                Timer* next = timer->next;
+                timer->prev = timer->next = nullptr;
+                timer->slot = Timer::NO_SLOT;
+                this->counts[0]--;
+                this->pending--;
+                this->expired.push_back(std::move(timer->self));
+                timer = next;
+            }
+            this->current = tick + 1;
+        }
+    }
+
+    void loop(){
+        std::unique_lock<std::mutex> lock(this->mutex);
+        while(!this->stopping){
+            this->wakeTick = this->nextTick();
+            if(this->wakeTick == ~(uint64_t)0){
+                this->cv.wait(lock);
+            } else if(this->cv.wait_until(lock, this->start + this->tick * this->wakeTick) == std::cv_status::timeout){
+                lock.unlock();
+                this->advance();
+                lock.lock();
+            }
+        }
+    }
+
+public:
+
+    /**
+     * Creates a wheel.
+     *
+     * @param tick Resolution of the wheel (timers expire at the first tick at or after their deadline).
+     * @param ownThread If true the wheel starts a thread that advances it, otherwise advance() needs to be called regularly.
+     */
+    TimerWheel(std::chrono::nanoseconds tick = std::chrono::microseconds(SPI_TIMER_WHEEL_TICK_US), bool ownThread = true) :
+            tick(tick), start(std::chrono::steady_clock::now()) {
+        if(tick.count() <= 0) throw std::invalid_argument("TimerWheel tick must be positive");
+        if(ownThread) this->thread = std::thread([this]{ this->loop(); });
+    }
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    ~TimerWheel(){
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->cv.notify_all();
+        if(this->thread.joinable()) this->thread.join();
+        std::lock_guard<std::mutex> lock(this->mutex);
+        for(Timer* &head : this->slots){
+            while(head != nullptr){
+                Timer* timer = head;
+                head = timer->next;
+                uint8_t expected = Timer::PENDING;
+                timer->state.compare_exchange_strong(expected, Timer::DROPPED); // later cancel() calls do nothing
+                timer->slot = Timer::NO_SLOT;
+                timer->self.reset();
+            }
+        }
+    }
+
+    /**
+     * Runs a function once the given delay passed.
+     *
+     * @param delay Time after which the function should run.
+     * @param fn Function to run on the thread advancing the wheel.
+     * @return Handle that removes the timer from the wheel if cancelled before it ran.
+     */
+    std::shared_ptr<Cancellable> schedule(std::chrono::nanoseconds delay, std::function<void()> fn){
+        return this->scheduleAt(std::chrono::steady_clock::now() + delay, std::move(fn));
+    }
+
+    /**
+     * Runs a function once the given point in time passed.
+     *
+     * @param deadline Time after which the function should run.
+     * @param fn Function to run on the thread advancing the wheel.
+     * @return Handle that removes the timer from the wheel if cancelled before it ran.
+     */
+    std::shared_ptr<Cancellable> scheduleAt(time_point deadline, std::function<void()> fn){
+        std::shared_ptr<Timer> timer = std::make_shared<Timer>(this, std::move(fn), this->tickAfter(deadline));
+        bool wake;
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            timer->self = timer;
+            this->insert(timer.get());
+            this->pending++;
+            wake = timer->expiry < this->wakeTick;
+            if(wake) this->wakeTick = timer->expiry;
+        }
+        if(wake && this->thread.joinable()) this->cv.notify_one();
+        return timer;
+    }
+
+    /**
+     * Runs the functions of all timers whose deadline passed.
+     *
+     * @param now Current point in time.
+     * @return Amount of functions that ran.
+     */
+    size_t advance(time_point now = std::chrono::steady_clock::now()){
+        std::lock_guard<std::mutex> runLock(this->advancing);
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->collect(this->tickBefore(now));
+        }
+        size_t ran = 0;
+        for(std::shared_ptr<Timer> &timer : this->expired){
+            uint8_t expected = Timer::PENDING;
+            if(timer->state.compare_exchange_strong(expected, Timer::FIRED)){
+                timer->fn();
+                ran++;
+            }
+            timer->fn = nullptr; // releases captured state even if the handle lives on
+        }
+        this->expired.clear();
+        return ran;
+    }
+
+    /** Returns the amount of timers that did not expire and were not cancelled yet. */
+    size_t size(){
+        std::lock_guard<std::mutex> lock(this->mutex);
+        return this->pending;
+    }
+
+    std::chrono::nanoseconds getTick() const noexcept {
+        return this->tick;
+    }
+
+    /**
+     * Returns the wheel used by Thread::runAfter() (ticks every SPI_TIMER_WHEEL_TICK_US, runs on its own thread).
+     * Never destroyed so timers may still be scheduled or cancelled during shutdown.
+     */
+    static TimerWheel& getShared(){
+        static TimerWheel* shared = new TimerWheel();
+        return *shared;
+    }
+};
+
+
+}
+#endif // SPI_TIMER_WHEEL_HPP
@@ -0,0 +1,296 @@
+/**
+ * Lightweight tracing spans for hot paths that get recorded into per-thread
+ * ring buffers and can be dumped in the Chrome trace / Perfetto JSON format.
+ *
+ * Use the SPI_TRACE_* macros so tracing gets removed completely unless SPI_TRACE is defined as 1
+ * (e.g. via cmake -DSPI_TRACE=ON). Span names must be string literals (or otherwise outlive the dump).
+ *
+ * @file Trace.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+
+#ifndef SPI_TRACE_HPP
+#define SPI_TRACE_HPP
+
+#include "./HardwareUtils.hpp"
+#include "./TimeUtils.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+/** If 1 the SPI_TRACE_* macros record events, otherwise they compile to nothing. */
+#ifndef SPI_TRACE
+#define SPI_TRACE 0
+#endif
+
+/** Amount of events every thread keeps (power of two), older events get overwritten. */
+#ifndef SPI_TRACE_BUFFER_SIZE
+#define SPI_TRACE_BUFFER_SIZE 16384
+#endif
+
+namespace spi {
+
+
+
+/**
+ * Event recorded by a trace buffer.
+ */
+struct TraceEvent {
+    enum Phase : uint8_t { BEGIN = 'B', END = 'E', INSTANT = 'i' };
+
+    const char* name;
+    uint64_t ticks;     // FastClock::ticks() when the event happened
+    Phase phase;
+};
+
+
+
+/**
+ * Ring buffer of trace events written by a single thread and read by dumps.
+ * Buffers are never freed but reused by new threads once their thread terminated
+ * (events of the terminated thread get dropped at that point).
+ */
+class TraceBuffer {
+public:
+    static constexpr size_t SIZE = SPI_TRACE_BUFFER_SIZE;
+    static_assert(SIZE > 0 && (SIZE & (SIZE - 1)) == 0, "SPI_TRACE_BUFFER_SIZE must be a power of two");
+
+protected:
+    struct Slot {
+        std::atomic<const char*> name{nullptr};
+        std::atomic<uint64_t> ticksAndPhase{0}; // ticks << 8 | phase
+    };
+
+    Slot slots[SIZE];
+    std::atomic<uint64_t> head{0};      // amount of events ever written
+    std::atomic<uint64_t> threadID{0};
+    std::atomic<bool> inUse{true};
+    TraceBuffer* next = nullptr;
+
+    friend class Tracer;
+
+public:
+
+    /**
+     * Records an event. Must only be called by the thread owning this buffer.
+     */
+    inline void record(const char* name, TraceEvent::Phase phase) noexcept {
+        const uint64_t index = this->head.load(std::memory_order_relaxed);
+        Slot &slot = this->slots[index & (SIZE - 1)];
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.ticksAndPhase.store((FastClock::ticks() << 8) | (uint64_t)phase, std::memory_order_relaxed);
+        this->head.store(index + 1, std::memory_order_release);
+    }
+
+    /**
+     * Returns the thread (HardwareUtils::currentThreadID()) that owns or owned this buffer.
+     */
+    inline uint64_t getThreadID() const noexcept {
+        return this->threadID.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Copies the currently contained events (oldest first).
+     * Events that get overwritten while copying may be inconsistent, dump while the traced code is quiet for exact results.
+     */
+    void collect(std::vector<TraceEvent> &result) const {
+        const uint64_t end = this->head.load(std::memory_order_acquire);
+        const uint64_t start = end > SIZE ? end - SIZE : 0;
+        for(uint64_t i=start; i < end; i++){
+            const Slot &slot = this->slots[i & (SIZE - 1)];
+            const uint64_t ticksAndPhase = slot.ticksAndPhase.load(std::memory_order_relaxed);
+            result.push_back(TraceEvent{slot.name.load(std::memory_order_relaxed), ticksAndPhase >> 8, (TraceEvent::Phase)(ticksAndPhase & 0xFF)});
+        }
+    }
+};
+
+
+
+/**
+ * Global registry of all trace buffers.
+ * Every thread lazily gets its own buffer at its first event, recording is lock-free and wait-free.
+ */
+class Tracer {
+protected:
+    inline static std::atomic<TraceBuffer*> buffers{nullptr};
+    inline static thread_local TraceBuffer* current = nullptr;
+
+    /** Marks the buffer of a thread as reusable once the thread terminates. */
+    struct Releaser {
+        ~Releaser(){
+            if(Tracer::current != nullptr) Tracer::current->inUse.store(false, std::memory_order_release);
+            Tracer::current = nullptr;
+        }
+    };
+
+    static TraceBuffer* acquire(){
+        static thread_local Releaser releaser;
+        (void)releaser;
+        const uint64_t threadID = (uint64_t)HardwareUtils::currentThreadID();
+
+        // reuse buffer of a terminated thread
+        for(TraceBuffer* buffer = buffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next){
+            bool expected = false;
+            if(!buffer->inUse.load(std::memory_order_relaxed) && buffer->inUse.compare_exchange_strong(expected, true, std::memory_order_acq_rel)){
+                buffer->head.store(0, std::memory_order_release);
+                buffer->threadID.store(threadID, std::memory_order_relaxed);
+                return Tracer::current = buffer;
+            }
+        }
+
+        TraceBuffer* buffer = new TraceBuffer();
+        buffer->threadID.store(threadID, std::memory_order_relaxed);
+        TraceBuffer* head = buffers.load(std::memory_order_relaxed);
+        do {
+            buffer->next = head;
+        } while(!buffers.compare_exchange_weak(head, buffer, std::memory_order_release, std::memory_order_relaxed));
+        return Tracer::current = buffer;
+    }
+
+    static void appendEscaped(std::string &out, const char* text){
+        for(; text != nullptr && *text != '\0'; text++){
+            const char c = *text;
+            if(c == '"' || c == '\\'){
+                out += '\\';
+                out += c;
+            } else if((unsigned char)c < 0x20){
+                out += ' ';
+            } else {
+                out += c;
+            }
+        }
+    }
+
+public:
+
+    /**
+     * Returns the trace buffer of the calling thread.
+     */
+    static inline TraceBuffer& local(){
+        TraceBuffer* buffer = Tracer::current;
+        return *(buffer != nullptr ? buffer : acquire());
+    }
+
+    /** Records the begin of a span on the calling thread. */
+    static inline void begin(const char* name){
+        local().record(name, TraceEvent::BEGIN);
+    }
+
+    /** Records the end of the most recently begun span on the calling thread. */
+    static inline void end(const char* name){
+        local().record(name, TraceEvent::END);
+    }
+
+    /** Records an event without duration on the calling thread. */
+    static inline void instant(const char* name){
+        local().record(name, TraceEvent::INSTANT);
+    }
+
+    /**
+     * Removes all recorded events. Must not be called while threads are recording.
+     */
+    static void clear() noexcept {
+        for(TraceBuffer* buffer = buffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next)
+            buffer->head.store(0, std::memory_order_release);
+    }
+
+    /**
+     * Returns all recorded events in the Chrome trace event format (JSON)
+     * that can be opened with chrome://tracing or https://ui.perfetto.dev
+     * End events whose begin already got overwritten are skipped.
+     */
+    static std::string toChromeTraceJson(){
+        const std::string pid = std::to_string(getpid());
+        std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        bool first = true;
+        std::vector<TraceEvent> events;
+        for(TraceBuffer* buffer = buffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next){
+            events.clear();
+            buffer->collect(events);
+            const std::string tid = std::to_string(buffer->getThreadID());
+            size_t depth = 0;
+            for(const TraceEvent &event : events){
+                if(event.phase == TraceEvent::END){
+                    if(depth == 0) continue;
+                    depth--;
+                } else if(event.phase == TraceEvent::BEGIN){
+                    depth++;
+                }
+                const uint64_t ns = FastClock::toNanos(event.ticks);
+                if(!first) out += ',';
+                first = false;
+                out += "{\"name\":\"";
+                appendEscaped(out, event.name);
+                out += "\",\"ph\":\"";
+                out += (char)event.phase;
+                out += "\",\"ts\":" + std::to_string(ns / 1000) + "." + std::to_string(1000 + ns % 1000).substr(1);
+                out += ",\"pid\":" + pid + ",\"tid\":" + tid;
+                if(event.phase == TraceEvent::INSTANT) out += ",\"s\":\"t\"";
+                out += '}';
+            }
+        }
+        out += "]}";
+        return out;
+    }
+
+    /**
+     * Writes all recorded events in the Chrome trace event format into a file.
+     *
+     * @return True if the file has been written successfully.
+     */
+    static bool dump(const std::string &path){
+        std::ofstream file(path, std::ios::out | std::ios::trunc);
+        if(!file.is_open()) return false;
+        file << toChromeTraceJson();
+        return file.good();
+    }
+};
+
+
+
+/**
+ * Records a span from construction until destruction on the calling thread.
+ */
+class TraceScope {
+protected:
+    const char* name;
+
+public:
+    inline explicit TraceScope(const char* name) : name(name) {
+        Tracer::begin(name);
+    }
+
+    inline ~TraceScope(){
+        Tracer::end(this->name);
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+};
+
+
+
+}
+
+
+#define SPI_TRACE_CONCAT_INNER(a, b) a##b
+#define SPI_TRACE_CONCAT(a, b) SPI_TRACE_CONCAT_INNER(a, b)
+
+#if SPI_TRACE
+#define SPI_TRACE_SCOPE(name) ::spi::TraceScope SPI_TRACE_CONCAT(spiTraceScope, __LINE__)(name)
+#define SPI_TRACE_BEGIN(name) ::spi::Tracer::begin(name)
+#define SPI_TRACE_END(name) ::spi::Tracer::end(name)
+#define SPI_TRACE_INSTANT(name) ::spi::Tracer::instant(name)
+#else
+#define SPI_TRACE_SCOPE(name) ((void)0)
+#define SPI_TRACE_BEGIN(name) ((void)0)
+#define SPI_TRACE_END(name) ((void)0)
+#define SPI_TRACE_INSTANT(name) ((void)0)
+#endif
+
+#endif // SPI_TRACE_HPP
@@ -1,3 +1,6 @@
+#ifndef SPI_TUPLE_HPP
+#define SPI_TUPLE_HPP
+
 #include <atomic>
 #include <cstdint>
 
@@ -8,6 +11,10 @@ protected:
 
 public:
 
+    Tuple() : value(0) {
+
+    }
+
     Tuple(uint32_t value) : value(value){
 
     }
@@ -20,9 +27,25 @@ public:
         value = other.value;
     }
 
+    Tuple& operator=(const Tuple &other){
+        value = other.value;
+        return *this;
+    }
+
+    Tuple& operator=(Tuple &&other){
+        value = other.value;
+        return *this;
+    }
+
+
+    uint32_t getValue() const {
+        return value;
+    }
 
     void doSomething() {
         value++;
     }
 
-};
\ No newline at end of file
+};
+
+#endif // SPI_TUPLE_HPP
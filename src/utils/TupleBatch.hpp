@@ -0,0 +1,436 @@
+/**
+ * Column layout for batches of tuples together with selection bitmaps
+ * so filters can evaluate their predicates on whole batches (SIMD if possible).
+ *
+ * @file TupleBatch.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+
+#ifndef SPI_TUPLE_BATCH_HPP
+#define SPI_TUPLE_BATCH_HPP
+
+#include "./Tuple.hpp"
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SPI_TUPLE_BATCH_X86 1
+#include <immintrin.h>
+#endif
+
+namespace spi {
+
+
+
+/**
+ * Comparison a FlowValueCompare expression performs.
+ */
+enum class FlowCompare : uint8_t {
+    LESS,
+    LESS_EQUAL,
+    GREATER,
+    GREATER_EQUAL,
+    EQUAL,
+    NOT_EQUAL,
+};
+
+
+
+/**
+ * Kernels that evaluate comparisons on a column and compact columns by a selection bitmap.
+ * Selection bitmaps store one bit per row (bit i % 64 of word i / 64), bits beyond the row count are zero.
+ * The kernels get selected once depending on what the CPU supports (AVX-512, AVX2 or scalar).
+ */
+class TupleBatchKernels {
+protected:
+    typedef void (*CompareKernel)(const uint32_t* values, size_t count, FlowCompare op, uint32_t offset, uint32_t constant, uint64_t* selection);
+    typedef size_t (*CompactKernel)(uint32_t* values, size_t count, const uint64_t* selection);
+
+    static inline bool compareScalar(uint32_t value, FlowCompare op, uint32_t constant){
+        switch(op){
+            case FlowCompare::LESS: return value < constant;
+            case FlowCompare::LESS_EQUAL: return value <= constant;
+            case FlowCompare::GREATER: return value > constant;
+            case FlowCompare::GREATER_EQUAL: return value >= constant;
+            case FlowCompare::EQUAL: return value == constant;
+            case FlowCompare::NOT_EQUAL: return value != constant;
+        }
+        return false;
+    }
+
+    template<FlowCompare OP>
+    static void compareColumnScalar(const uint32_t* values, size_t count, uint32_t offset, uint32_t constant, uint64_t* selection){
+        for(size_t word=0; word * 64 < count; word++){
+            const size_t end = std::min((size_t)64, count - word * 64);
+            const uint32_t* v = values + word * 64;
+            uint64_t bits = 0;
+            for(size_t i=0; i < end; i++) bits |= (uint64_t)compareScalar(v[i] - offset, OP, constant) << i;
+            selection[word] = bits;
+        }
+    }
+
+    static void compareScalarKernel(const uint32_t* values, size_t count, FlowCompare op, uint32_t offset, uint32_t constant, uint64_t* selection){
+        switch(op){
+            case FlowCompare::LESS: compareColumnScalar<FlowCompare::LESS>(values, count, offset, constant, selection); break;
+            case FlowCompare::LESS_EQUAL: compareColumnScalar<FlowCompare::LESS_EQUAL>(values, count, offset, constant, selection); break;
+            case FlowCompare::GREATER: compareColumnScalar<FlowCompare::GREATER>(values, count, offset, constant, selection); break;
+            case FlowCompare::GREATER_EQUAL: compareColumnScalar<FlowCompare::GREATER_EQUAL>(values, count, offset, constant, selection); break;
+            case FlowCompare::EQUAL: compareColumnScalar<FlowCompare::EQUAL>(values, count, offset, constant, selection); break;
+            case FlowCompare::NOT_EQUAL: compareColumnScalar<FlowCompare::NOT_EQUAL>(values, count, offset, constant, selection); break;
+        }
+    }
+
+    static size_t compactScalarKernel(uint32_t* values, size_t count, const uint64_t* selection){
+        size_t kept = 0;
+        for(size_t word=0; word * 64 < count; word++){
+            uint64_t bits = selection[word];
+            if(bits == ~0ull && kept == word * 64){ // nothing removed so far, whole word stays in place
+                kept += 64;
+                continue;
+            }
+            while(bits != 0){
+                values[kept++] = values[word * 64 + (size_t)__builtin_ctzll(bits)];
+                bits &= bits - 1;
+            }
+        }
+        return kept;
+    }
+
+
+    #ifdef SPI_TUPLE_BATCH_X86
+    __attribute__((target("avx2")))
+    static void compareAVX2Kernel(const uint32_t* values, size_t count, FlowCompare op, uint32_t offset, uint32_t constant, uint64_t* selection){
+        const __m256i sign = _mm256_set1_epi32((int)0x80000000u);
+        const __m256i off = _mm256_set1_epi32((int)offset);
+        const __m256i c = _mm256_xor_si256(_mm256_set1_epi32((int)constant), sign);
+        const bool invert = op == FlowCompare::LESS_EQUAL || op == FlowCompare::GREATER_EQUAL || op == FlowCompare::NOT_EQUAL;
+        const size_t vectorized = count & ~(size_t)63;
+        for(size_t word=0; word * 64 < vectorized; word++){
+            uint64_t bits = 0;
+            for(size_t group=0; group < 8; group++){
+                const __m256i v = _mm256_xor_si256(_mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(values + word * 64 + group * 8)), off), sign);
+                __m256i m;
+                if(op == FlowCompare::EQUAL || op == FlowCompare::NOT_EQUAL) m = _mm256_cmpeq_epi32(v, c);
+                else if(op == FlowCompare::GREATER || op == FlowCompare::LESS_EQUAL) m = _mm256_cmpgt_epi32(v, c);
+                else m = _mm256_cmpgt_epi32(c, v);
+                bits |= (uint64_t)(uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(m)) << (group * 8);
+            }
+            selection[word] = invert ? ~bits : bits;
+        }
+        if(vectorized < count) compareScalarKernel(values + vectorized, count - vectorized, op, offset, constant, selection + vectorized / 64);
+    }
+
+    __attribute__((target("avx512f")))
+    static void compareAVX512Kernel(const uint32_t* values, size_t count, FlowCompare op, uint32_t offset, uint32_t constant, uint64_t* selection){
+        const __m512i off = _mm512_set1_epi32((int)offset);
+        const __m512i c = _mm512_set1_epi32((int)constant);
+        const size_t vectorized = count & ~(size_t)63;
+        for(size_t word=0; word * 64 < vectorized; word++){
+            uint64_t bits = 0;
+            for(size_t group=0; group < 4; group++){
+                const __m512i v = _mm512_sub_epi32(_mm512_loadu_si512((const void*)(values + word * 64 + group * 16)), off);
+                __mmask16 m;
+                switch(op){
+                    case FlowCompare::LESS: m = _mm512_cmp_epu32_mask(v, c, _MM_CMPINT_LT); break;
+                    case FlowCompare::LESS_EQUAL: m = _mm512_cmp_epu32_mask(v, c, _MM_CMPINT_LE); break;
+                    case FlowCompare::GREATER: m = _mm512_cmp_epu32_mask(v, c, _MM_CMPINT_NLE); break;
+                    case FlowCompare::GREATER_EQUAL: m = _mm512_cmp_epu32_mask(v, c, _MM_CMPINT_NLT); break;
+                    case FlowCompare::EQUAL: m = _mm512_cmp_epu32_mask(v, c, _MM_CMPINT_EQ); break;
+                    default: m = _mm512_cmp_epu32_mask(v, c, _MM_CMPINT_NE); break;
+                }
+                bits |= (uint64_t)m << (group * 16);
+            }
+            selection[word] = bits;
+        }
+        if(vectorized < count) compareScalarKernel(values + vectorized, count - vectorized, op, offset, constant, selection + vectorized / 64);
+    }
+
+    __attribute__((target("avx512f")))
+    static size_t compactAVX512Kernel(uint32_t* values, size_t count, const uint64_t* selection){
+        size_t kept = 0;
+        for(size_t word=0; word * 64 < count; word++){
+            uint64_t bits = selection[word];
+            for(size_t group=0; group < 4 && word * 64 + group * 16 < count; group++, bits >>= 16){
+                const __mmask16 m = (__mmask16)(bits & 0xFFFF);
+                if(m == 0) continue;
+                const uint32_t* src = values + word * 64 + group * 16;
+                const size_t available = std::min((size_t)16, count - (word * 64 + group * 16));
+                const __mmask16 load = (__mmask16)((1u << available) - 1);
+                const __m512i v = _mm512_maskz_loadu_epi32(load, (const void*)src);
+                const size_t selected = (size_t)__builtin_popcount(m);
+                _mm512_mask_storeu_epi32((void*)(values + kept), (__mmask16)((1u << selected) - 1), _mm512_maskz_compress_epi32(m, v));
+                kept += selected;
+            }
+        }
+        return kept;
+    }
+    #endif
+
+
+    struct Dispatch {
+        CompareKernel compare = &compareScalarKernel;
+        CompactKernel compact = &compactScalarKernel;
+        const char* name = "scalar";
+
+        Dispatch(){
+            #ifdef SPI_TUPLE_BATCH_X86
+            __builtin_cpu_init();
+            if(__builtin_cpu_supports("avx512f")){
+                compare = &compareAVX512Kernel;
+                compact = &compactAVX512Kernel;
+                name = "AVX-512";
+            } else if(__builtin_cpu_supports("avx2")){
+                compare = &compareAVX2Kernel;
+                name = "AVX2";
+            }
+            #endif
+        }
+    };
+
+    static const Dispatch& dispatch(){
+        static const Dispatch instance;
+        return instance;
+    }
+
+public:
+
+    /**
+     * Sets bit i of the selection if "(values[i] - offset) OP constant" is true (unsigned arithmetic).
+     *
+     * @param selection Bitmap with at least (count + 63) / 64 words.
+     */
+    static inline void compare(const uint32_t* values, size_t count, FlowCompare op, uint32_t offset, uint32_t constant, uint64_t* selection){
+        dispatch().compare(values, count, op, offset, constant, selection);
+    }
+
+    /**
+     * Moves the selected values to the front (keeps their order).
+     *
+     * @return size_t Amount of selected values.
+     */
+    static inline size_t compact(uint32_t* values, size_t count, const uint64_t* selection){
+        return dispatch().compact(values, count, selection);
+    }
+
+    /**
+     * Returns the name of the instruction set the kernels use on this CPU.
+     */
+    static const char* simdName(){
+        return dispatch().name;
+    }
+};
+
+
+
+/**
+ * Batch of tuples stored column by column (one array per tuple field).
+ */
+class TupleBatch {
+protected:
+    std::vector<uint32_t> values;     // Tuple::getValue() of every row
+    std::vector<uint32_t> rows;       // optional position of every row in the batch it originates from
+    std::vector<uint64_t> selection;  // scratch bitmap for filters
+    std::vector<uint64_t> scratch;    // second scratch bitmap (e.g. for composed expressions)
+    size_t count = 0;
+    bool tracked = false;             // true if rows is maintained
+
+public:
+
+    /**
+     * Creates an empty batch that can hold the given amount of tuples.
+     */
+    explicit TupleBatch(size_t capacity = 0){
+        this->reserve(capacity);
+    }
+
+    /** Makes sure the batch can hold the given amount of tuples. */
+    void reserve(size_t capacity){
+        if(capacity <= this->values.size()) return;
+        this->values.resize(capacity);
+        this->rows.resize(capacity);
+        this->selection.resize((capacity + 63) / 64);
+        this->scratch.resize((capacity + 63) / 64);
+    }
+
+    inline size_t size() const noexcept {
+        return this->count;
+    }
+
+    inline size_t capacity() const noexcept {
+        return this->values.size();
+    }
+
+    inline bool empty() const noexcept {
+        return this->count == 0;
+    }
+
+    inline void clear() noexcept {
+        this->count = 0;
+        this->tracked = false;
+    }
+
+    /** Replaces the content of the batch with the given tuples (grows the batch if needed). */
+    void assign(const Tuple* tuples, size_t count){
+        this->reserve(count);
+        for(size_t i=0; i < count; i++) this->values[i] = tuples[i].getValue();
+        this->count = count;
+        this->tracked = false;
+    }
+
+    /** Appends a tuple (grows the batch if needed). */
+    void append(const Tuple &tuple){
+        if(this->count == this->values.size()) this->reserve(std::max((size_t)64, this->count * 2));
+        this->values[this->count++] = tuple.getValue();
+    }
+
+    /**
+     * Appends a tuple and remembers its position in the batch it originates from (see rowColumn()).
+     * Either all or no rows of a batch must be appended with their position.
+     */
+    void append(const Tuple &tuple, uint32_t row){
+        if(this->count == this->values.size()) this->reserve(std::max((size_t)64, this->count * 2));
+        this->rows[this->count] = row;
+        this->values[this->count++] = tuple.getValue();
+        this->tracked = true;
+    }
+
+    /** Writes the rows of the batch as tuples into the given array (needs room for size() tuples). */
+    void materialize(Tuple* tuples) const {
+        for(size_t i=0; i < this->count; i++) tuples[i] = Tuple(this->values[i]);
+    }
+
+    /** Returns the tuple of a row. */
+    inline Tuple operator[](size_t row) const {
+        return Tuple(this->values[row]);
+    }
+
+    /** Returns the column of Tuple::getValue() (size() rows). */
+    inline uint32_t* valueColumn() noexcept {
+        return this->values.data();
+    }
+
+    inline const uint32_t* valueColumn() const noexcept {
+        return this->values.data();
+    }
+
+    /**
+     * Returns the original position of every row (survives compact()) or nullptr if
+     * the rows were not appended with their position.
+     */
+    inline const uint32_t* rowColumn() const noexcept {
+        return this->tracked ? this->rows.data() : nullptr;
+    }
+
+    /** Returns the selection bitmap filters can evaluate their predicates into ((capacity() + 63) / 64 words). */
+    inline uint64_t* selectionBitmap() noexcept {
+        return this->selection.data();
+    }
+
+    /** Returns a second bitmap of the same size (e.g. to combine multiple predicates). */
+    inline uint64_t* scratchBitmap() noexcept {
+        return this->scratch.data();
+    }
+
+    /**
+     * Only keeps the rows whose bit is set in the given selection bitmap (order is preserved).
+     *
+     * @return size_t Amount of remaining rows.
+     */
+    size_t compact(const uint64_t* selection){
+        if(this->tracked) TupleBatchKernels::compact(this->rows.data(), this->count, selection);
+        this->count = TupleBatchKernels::compact(this->values.data(), this->count, selection);
+        return this->count;
+    }
+};
+
+
+
+/**
+ * Expression that can be evaluated on a whole column at once.
+ * Sets bit i of the selection (see TupleBatchKernels) for every row i that fulfills the expression.
+ */
+template<typename E>
+concept FlowColumnExpression = requires(const E& expression, const uint32_t* values, size_t count, uint64_t* selection){
+    expression.evaluate(values, count, selection);
+};
+
+
+/**
+ * Evaluates an expression row by row on a value column into a selection bitmap.
+ */
+template<typename E>
+inline void flowEvaluateRows(const E& expression, const uint32_t* values, size_t count, uint64_t* selection){
+    for(size_t word=0; word * 64 < count; word++){
+        const size_t end = std::min((size_t)64, count - word * 64);
+        uint64_t bits = 0;
+        for(size_t i=0; i < end; i++) bits |= (uint64_t)(bool)expression(Tuple(values[word * 64 + i])) << i;
+        selection[word] = bits;
+    }
+}
+
+
+/**
+ * Evaluates an expression on the value column of a batch into a selection bitmap.
+ * Column expressions evaluate the whole column (SIMD), other expressions get called per row.
+ */
+template<typename E>
+inline void flowEvaluate(const E& expression, const uint32_t* values, size_t count, uint64_t* selection){
+    if constexpr (FlowColumnExpression<E>){
+        expression.evaluate(values, count, selection);
+    } else {
+        flowEvaluateRows(expression, values, count, selection);
+    }
+}
+
+
+
+/**
+ * Expression that compares Tuple::getValue() with a constant and can be evaluated with SIMD on whole batches.
+ */
+struct FlowValueCompare {
+    FlowCompare op;
+    uint32_t constant;
+
+    inline bool operator()(const Tuple &tuple) const {
+        switch(this->op){
+            case FlowCompare::LESS: return tuple.getValue() < this->constant;
+            case FlowCompare::LESS_EQUAL: return tuple.getValue() <= this->constant;
+            case FlowCompare::GREATER: return tuple.getValue() > this->constant;
+            case FlowCompare::GREATER_EQUAL: return tuple.getValue() >= this->constant;
+            case FlowCompare::EQUAL: return tuple.getValue() == this->constant;
+            case FlowCompare::NOT_EQUAL: return tuple.getValue() != this->constant;
+        }
+        return false;
+    }
+
+    inline void evaluate(const uint32_t* values, size_t count, uint64_t* selection) const {
+        TupleBatchKernels::compare(values, count, this->op, 0, this->constant, selection);
+    }
+};
+
+
+/**
+ * Expression that checks if Tuple::getValue() lies within [min, max] and can be evaluated with SIMD on whole batches.
+ */
+struct FlowValueRange {
+    uint32_t min;
+    uint32_t max;
+
+    inline bool operator()(const Tuple &tuple) const {
+        return tuple.getValue() - this->min <= this->max - this->min;
+    }
+
+    inline void evaluate(const uint32_t* values, size_t count, uint64_t* selection) const {
+        TupleBatchKernels::compare(values, count, FlowCompare::LESS_EQUAL, this->min, this->max - this->min, selection);
+    }
+};
+
+
+
+}
+
+#endif // SPI_TUPLE_BATCH_HPP
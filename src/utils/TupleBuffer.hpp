@@ -0,0 +1,350 @@
+/**
+ * Variable-size tuple payloads that are handed off between operators without copying
+ * or allocating. Buffers come from size classes of pooled blocks and are reference counted intrusively.
+ *
+ * @file TupleBuffer.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+#ifndef SPI_TUPLE_BUFFER_HPP
+#define SPI_TUPLE_BUFFER_HPP
+
+#include "./HardwareUtils.hpp"
+#include "./MemoryCopy.hpp"
+#include "./RecycleObjectStoreMagazine.hpp"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+/** Capacity of the smallest size class of a TupleBufferPool in bytes (power of two). */
+#ifndef SPI_TUPLE_BUFFER_MIN_SIZE
+#define SPI_TUPLE_BUFFER_MIN_SIZE 64
+#endif
+
+/** Amount of size classes of a TupleBufferPool (each doubles the capacity, larger buffers are not pooled). */
+#ifndef SPI_TUPLE_BUFFER_SIZE_CLASSES
+#define SPI_TUPLE_BUFFER_SIZE_CLASSES 18
+#endif
+
+namespace spi {
+
+class TupleBuffer;
+class TupleBufferPool;
+
+
+/**
+ * Header and payload of a buffer. Blocks of a size class get recycled together with their payload,
+ * so once a pool is warm acquiring a buffer neither allocates nor touches the payload.
+ */
+class TupleBufferBlock {
+protected:
+    friend class TupleBuffer;
+    friend class TupleBufferPool;
+
+    static constexpr uint32_t UNPOOLED = ~(uint32_t)0;
+
+    std::atomic<uint32_t> refs{0};
+    bool shared = false;                // only written while a single handle exists
+    uint32_t sizeClass;
+    size_t capacity;
+    size_t size = 0;
+    TupleBufferPool* pool;
+    unsigned char* payload;
+
+public:
+
+    TupleBufferBlock(TupleBufferPool* pool, uint32_t sizeClass, size_t capacity) :
+            sizeClass(sizeClass), capacity(capacity), pool(pool),
+            payload(static_cast<unsigned char*>(::operator new(capacity, std::align_val_t(CACHE_LINE_SIZE)))) {}
+
+    TupleBufferBlock(const TupleBufferBlock&) = delete;
+    TupleBufferBlock& operator=(const TupleBufferBlock&) = delete;
+
+    ~TupleBufferBlock(){
+        ::operator delete(payload, std::align_val_t(CACHE_LINE_SIZE));
+    }
+};
+
+
+/**
+ * Hands out blocks of power of two size classes (SPI_TUPLE_BUFFER_MIN_SIZE doubled up to
+ * SPI_TUPLE_BUFFER_SIZE_CLASSES times). Every size class is a RecycleObjectStoreMagazine,
+ * so threads acquire and release blocks from their own magazines. Requests larger than
+ * the largest size class get an unpooled block that is freed on release. Thread-safe.
+ * The pool needs to outlive all buffers acquired from it.
+ */
+class TupleBufferPool {
+protected:
+    friend class TupleBuffer;
+
+    typedef RecycleObjectStoreMagazine<TupleBufferBlock> Store;
+
+    std::array<std::unique_ptr<Store>, SPI_TUPLE_BUFFER_SIZE_CLASSES> stores;
+
+    static constexpr size_t MIN_SHIFT = (size_t)std::countr_zero((size_t)SPI_TUPLE_BUFFER_MIN_SIZE);
+    static_assert(std::has_single_bit((size_t)SPI_TUPLE_BUFFER_MIN_SIZE), "SPI_TUPLE_BUFFER_MIN_SIZE needs to be a power of two");
+
+    /** Returns the size class of the given capacity or UNPOOLED if it is too large. */
+    static inline uint32_t sizeClassOf(size_t capacity) noexcept {
+        if(capacity <= SPI_TUPLE_BUFFER_MIN_SIZE) return 0;
+        const size_t sizeClass = (size_t)std::bit_width(capacity - 1) - MIN_SHIFT;
+        return sizeClass < SPI_TUPLE_BUFFER_SIZE_CLASSES ? (uint32_t)sizeClass : TupleBufferBlock::UNPOOLED;
+    }
+
+    inline TupleBufferBlock* acquireBlock(size_t capacity){
+        const uint32_t sizeClass = sizeClassOf(capacity);
+        if(sizeClass == TupleBufferBlock::UNPOOLED) return new TupleBufferBlock(this, sizeClass, capacity);
+        return this->stores[sizeClass]->acquire(this, sizeClass, getClassCapacity(sizeClass));
+    }
+
+    inline void releaseBlock(TupleBufferBlock* block){
+        block->size = 0;
+        block->shared = false;
+        if(block->sizeClass == TupleBufferBlock::UNPOOLED){
+            delete block;
+        } else {
+            this->stores[block->sizeClass]->release(block);
+        }
+    }
+
+public:
+
+    /**
+     * Creates an empty pool.
+     *
+     * @param magazineSize Amount of blocks per magazine of each size class.
+     * @param chunkSize Amount of block headers that get allocated together.
+     */
+    TupleBufferPool(size_t magazineSize = SPI_RECYCLE_OBJECT_STORE_MAGAZINE_SIZE, size_t chunkSize = SPI_RECYCLE_OBJECT_SLAB_CHUNK_SIZE){
+        for(std::unique_ptr<Store> &store : this->stores)
+            store = std::make_unique<Store>(magazineSize, chunkSize);
+    }
+
+    TupleBufferPool(const TupleBufferPool&) = delete;
+    TupleBufferPool& operator=(const TupleBufferPool&) = delete;
+
+    /**
+     * Acquires a buffer with room for at least the given amount of bytes.
+     * The buffer is empty and owned by a single handle. Thread-safe.
+     *
+     * @param capacity Minimum amount of bytes the buffer can hold.
+     */
+    inline TupleBuffer acquire(size_t capacity);
+
+    /**
+     * Acquires a buffer and copies the given bytes into it (see MemoryCopy::copy()). Thread-safe.
+     *
+     * @param data Bytes to copy.
+     * @param size Amount of bytes to copy.
+     */
+    inline TupleBuffer copyOf(const void* data, size_t size);
+
+    /**
+     * Constructs blocks of the size class of the given capacity until at least count exist
+     * (e.g. to prewarm the pool so the first tuples do not allocate).
+     *
+     * @param capacity Capacity whose size class should be prewarmed (needs to be pooled).
+     * @param count Amount of blocks the size class should hold.
+     */
+    void reserve(size_t capacity, size_t count){
+        const uint32_t sizeClass = sizeClassOf(capacity);
+        if(sizeClass == TupleBufferBlock::UNPOOLED)
+            throw std::invalid_argument("TupleBufferPool capacity "+std::to_string(capacity)+" exceeds largest size class "+
+                                        std::to_string(getMaxPooledSize()));
+        this->stores[sizeClass]->reserve(count, this, sizeClass, getClassCapacity(sizeClass));
+    }
+
+    /**
+     * Returns the capacity of buffers of the given size class.
+     */
+    static constexpr size_t getClassCapacity(uint32_t sizeClass) noexcept {
+        return (size_t)SPI_TUPLE_BUFFER_MIN_SIZE << sizeClass;
+    }
+
+    /**
+     * Returns the largest capacity that still gets pooled.
+     */
+    static constexpr size_t getMaxPooledSize() noexcept {
+        return getClassCapacity(SPI_TUPLE_BUFFER_SIZE_CLASSES - 1);
+    }
+};
+
+
+/**
+ * Handle to a pooled buffer with an intrusive reference count.
+ *
+ * A buffer starts out owned by a single operator at a time. Handing it to the next operator
+ * (move, or copy followed by dropping the old handle) only needs plain loads and stores on
+ * the count because the queue between the operators already orders the accesses.
+ * Before a buffer fans out to several consumers that may run concurrently, the current owner
+ * calls share() once; from then on the count is updated with atomic read-modify-writes.
+ * The block returns to its pool when the last handle is dropped.
+ */
+class TupleBuffer {
+protected:
+    friend class TupleBufferPool;
+
+    TupleBufferBlock* block = nullptr;
+
+    explicit TupleBuffer(TupleBufferBlock* block) noexcept : block(block) {
+        block->refs.store(1, std::memory_order_relaxed);
+    }
+
+    inline void retain() const noexcept {
+        if(this->block->shared){
+            this->block->refs.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            this->block->refs.store(this->block->refs.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+
+    inline void drop() noexcept {
+        TupleBufferBlock* b = this->block;
+        if(b == nullptr) return;
+        this->block = nullptr;
+        if(b->shared){
+            if(b->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+        } else {
+            const uint32_t refs = b->refs.load(std::memory_order_relaxed);
+            if(refs != 1){
+                b->refs.store(refs - 1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        b->pool->releaseBlock(b);
+    }
+
+public:
+
+    /** Creates a handle that does not reference any buffer. */
+    TupleBuffer() noexcept = default;
+
+    TupleBuffer(const TupleBuffer &other) noexcept : block(other.block) {
+        if(this->block != nullptr) this->retain();
+    }
+
+    TupleBuffer(TupleBuffer &&other) noexcept : block(other.block) {
+        other.block = nullptr;
+    }
+
+    TupleBuffer& operator=(const TupleBuffer &other) noexcept {
+        if(this->block != other.block){
+            if(other.block != nullptr) other.retain();
+            this->drop();
+            this->block = other.block;
+        }
+        return *this;
+    }
+
+    TupleBuffer& operator=(TupleBuffer &&other) noexcept {
+        if(this != &other){
+            this->drop();
+            this->block = other.block;
+            other.block = nullptr;
+        }
+        return *this;
+    }
+
+    ~TupleBuffer(){
+        this->drop();
+    }
+
+    /**
+     * Switches the reference count to atomic updates so handles of this buffer can be
+     * copied and dropped by several threads concurrently. Needs to be called by the only
+     * thread holding handles before the buffer fans out. Stays shared until it is recycled.
+     */
+    inline TupleBuffer& share() noexcept {
+        if(this->block != nullptr) this->block->shared = true;
+        return *this;
+    }
+
+    /**
+     * Makes sure this handle is the only one referencing its buffer by copying the
+     * payload into a new buffer of the same pool if necessary (copy-on-write).
+     */
+    inline TupleBuffer& detach(){
+        if(this->block != nullptr && this->block->refs.load(std::memory_order_acquire) != 1){
+            *this = this->block->pool->copyOf(this->block->payload, this->block->size);
+        }
+        return *this;
+    }
+
+    /** Releases the referenced buffer (if any). */
+    inline void reset() noexcept {
+        this->drop();
+    }
+
+    /**
+     * Sets the amount of used bytes.
+     *
+     * @param size Amount of used bytes (at most getCapacity()).
+     */
+    inline void resize(size_t size){
+        if(size > this->getCapacity())
+            throw std::length_error("TupleBuffer size "+std::to_string(size)+" exceeds capacity "+std::to_string(this->getCapacity()));
+        this->block->size = size;
+    }
+
+    inline unsigned char* data() noexcept {
+        return this->block->payload;
+    }
+
+    inline const unsigned char* data() const noexcept {
+        return this->block->payload;
+    }
+
+    /** Returns the amount of used bytes. */
+    inline size_t size() const noexcept {
+        return this->block == nullptr ? 0 : this->block->size;
+    }
+
+    /** Returns the amount of bytes the buffer can hold. */
+    inline size_t getCapacity() const noexcept {
+        return this->block == nullptr ? 0 : this->block->capacity;
+    }
+
+    /** Returns the amount of handles referencing this buffer (only exact while no other thread holds one). */
+    inline uint32_t useCount() const noexcept {
+        return this->block == nullptr ? 0 : this->block->refs.load(std::memory_order_acquire);
+    }
+
+    inline bool isShared() const noexcept {
+        return this->block != nullptr && this->block->shared;
+    }
+
+    inline bool isPooled() const noexcept {
+        return this->block != nullptr && this->block->sizeClass != TupleBufferBlock::UNPOOLED;
+    }
+
+    explicit operator bool() const noexcept {
+        return this->block != nullptr;
+    }
+
+    bool operator==(const TupleBuffer &other) const noexcept {
+        return this->block == other.block;
+    }
+};
+
+
+inline TupleBuffer TupleBufferPool::acquire(size_t capacity){
+    return TupleBuffer(this->acquireBlock(capacity));
+}
+
+inline TupleBuffer TupleBufferPool::copyOf(const void* data, size_t size){
+    TupleBuffer buffer(this->acquireBlock(size));
+    if(size > 0) MemoryCopy::copy(buffer.data(), data, size); // streams payloads larger than the cache
+    buffer.block->size = size;
+    return buffer;
+}
+
+
+}
+#endif // SPI_TUPLE_BUFFER_HPP
@@ -0,0 +1,174 @@
+/**
+ * Lock-free work-stealing deque (Chase-Lev) used by the scheduler of ThreadPool.
+ *
+ * @file WorkStealingDeque.hpp
+ * @author Luca Vogels (github@luca-vogels.com)
+ */
+
+#ifndef SPI_WORK_STEALING_DEQUE_HPP
+#define SPI_WORK_STEALING_DEQUE_HPP
+
+#include "./HardwareUtils.hpp"
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace spi {
+
+
+
+/**
+ * Unbounded Chase-Lev deque that stores pointers.
+ *
+ * The owner thread pushes and takes elements at the bottom (LIFO) without any
+ * atomic read-modify-write in the common case. Any other thread can steal
+ * elements from the top (FIFO) which needs a single CAS.
+ *
+ * If the buffer is full the owner replaces it by a buffer of twice the size.
+ * Old buffers are kept until the deque gets destructed because thieves may
+ * still read from them.
+ *
+ * IMPORTANT:   push() and take() must only be called by the owner thread!
+ *              steal() and empty() can be called by any thread.
+ *
+ * @tparam T Type the stored pointers point to.
+ */
+template<typename T>
+class WorkStealingDeque {
+protected:
+
+    struct Buffer {
+        const int64_t capacity;
+        const int64_t mask;
+        std::atomic<T*>* const elements;
+
+        Buffer(int64_t capacity) : capacity(capacity), mask(capacity - 1), elements(new std::atomic<T*>[capacity]) {}
+
+        ~Buffer(){
+            delete[] elements;
+        }
+
+        inline T* get(int64_t index) const noexcept {
+            return elements[index & mask].load(std::memory_order_relaxed);
+        }
+
+        inline void put(int64_t index, T* value) noexcept {
+            elements[index & mask].store(value, std::memory_order_relaxed);
+        }
+    };
+
+    alignas(CACHE_LINE_SIZE) std::atomic<int64_t> top{0};    // thieves
+    alignas(CACHE_LINE_SIZE) std::atomic<int64_t> bottom{0}; // owner
+    std::atomic<Buffer*> buffer;
+    std::vector<Buffer*> retired; // only touched by owner
+
+    Buffer* grow(Buffer* old, int64_t b, int64_t t){
+        Buffer* next = new Buffer(old->capacity * 2);
+        for(int64_t i=t; i < b; i++)
+            next->put(i, old->get(i));
+        this->retired.push_back(old);
+        this->buffer.store(next, std::memory_order_release);
+        return next;
+    }
+
+public:
+
+    /**
+     * Creates a new deque.
+     *
+     * @param initialCapacity Amount of elements before the buffer needs to grow (rounded up to next power of two).
+     */
+    WorkStealingDeque(size_t initialCapacity = 256) : buffer(new Buffer((int64_t)std::bit_ceil(initialCapacity < 2 ? (size_t)2 : initialCapacity))) {}
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    ~WorkStealingDeque(){
+        delete this->buffer.load(std::memory_order_relaxed);
+        for(Buffer* old : this->retired) delete old;
+    }
+
+    /**
+     * Pushes an element at the bottom. Only the owner is allowed to call this.
+     *
+     * @param value Element to push.
+     */
+    void push(T* value){
+        const int64_t b = this->bottom.load(std::memory_order_relaxed);
+        const int64_t t = this->top.load(std::memory_order_acquire);
+        Buffer* buf = this->buffer.load(std::memory_order_relaxed);
+        if(b - t > buf->capacity - 1)
+            buf = this->grow(buf, b, t);
+        buf->put(b, value);
+        std::atomic_thread_fence(std::memory_order_release);
+        this->bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Takes the most recently pushed element from the bottom.
+     * Only the owner is allowed to call this.
+     *
+     * @return T* Element or nullptr if the deque is empty.
+     */
+    T* take() noexcept {
+        const int64_t b = this->bottom.load(std::memory_order_relaxed) - 1;
+        Buffer* buf = this->buffer.load(std::memory_order_relaxed);
+        this->bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = this->top.load(std::memory_order_relaxed);
+
+        if(t > b){
+            this->bottom.store(b + 1, std::memory_order_relaxed); // was empty
+            return nullptr;
+        }
+
+        T* value = buf->get(b);
+        if(t == b){
+            // last element, race against thieves
+            if(!this->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                value = nullptr;
+            this->bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return value;
+    }
+
+    /**
+     * Steals the oldest element from the top. Can be called by any thread.
+     *
+     * @return T* Element or nullptr if the deque is empty or another thread was faster.
+     */
+    T* steal() noexcept {
+        int64_t t = this->top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const int64_t b = this->bottom.load(std::memory_order_acquire);
+        if(t >= b) return nullptr;
+
+        Buffer* buf = this->buffer.load(std::memory_order_acquire);
+        T* value = buf->get(t);
+        if(!this->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr; // lost race
+        return value;
+    }
+
+    /**
+     * Returns if the deque is empty.
+     * Only a snapshot if other threads are pushing or stealing concurrently.
+     *
+     * @return true if empty, false otherwise.
+     */
+    bool empty() const noexcept {
+        const int64_t t = this->top.load(std::memory_order_acquire);
+        const int64_t b = this->bottom.load(std::memory_order_acquire);
+        return t >= b;
+    }
+
+};
+
+
+
+}
+
+#endif // SPI_WORK_STEALING_DEQUE_HPP